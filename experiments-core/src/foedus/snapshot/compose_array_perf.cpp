@@ -123,6 +123,7 @@ ErrorStack execute(
     log_array,
     1,
     &work_memory,
+    nullptr,
     Epoch(1),
     root_page
   };
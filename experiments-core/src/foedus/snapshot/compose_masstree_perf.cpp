@@ -115,6 +115,7 @@ ErrorStack execute(
     log_masstree,
     1,
     &work_memory,
+    nullptr,
     Epoch(1),
     root_page
   };
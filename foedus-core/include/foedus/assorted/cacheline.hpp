@@ -65,7 +65,7 @@ inline void prefetch_cacheline(const void* address) {
  */
 inline void prefetch_cachelines(const void* address, int cacheline_count) {
   for (int i = 0; i < cacheline_count; ++i) {
-    const void* shifted = reinterpret_cast<const char*>(address) + kCachelineSize * cacheline_count;
+    const void* shifted = reinterpret_cast<const char*>(address) + kCachelineSize * i;
     prefetch_cacheline(shifted);
   }
 }
@@ -78,7 +78,7 @@ inline void prefetch_cachelines(const void* address, int cacheline_count) {
  */
 inline void prefetch_l2(const void* address, int cacheline_count) {
   for (int i = 0; i < cacheline_count; ++i) {
-    const void* shifted = reinterpret_cast<const char*>(address) + kCachelineSize * cacheline_count;
+    const void* shifted = reinterpret_cast<const char*>(address) + kCachelineSize * i;
     prefetch_cacheline(shifted);  // this also works for L2/L3
   }
 }
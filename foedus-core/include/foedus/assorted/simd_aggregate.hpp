@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#ifndef FOEDUS_ASSORTED_SIMD_AGGREGATE_HPP_
+#define FOEDUS_ASSORTED_SIMD_AGGREGATE_HPP_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "foedus/assorted/simd_search.hpp"
+
+/**
+ * @file foedus/assorted/simd_aggregate.hpp
+ * @ingroup ASSORTED
+ * @brief Count/sum/min/max and scatter-add kernels over a field in an array of structs.
+ * @details
+ * These are used to aggregate a primitive field of array-storage records, which are laid out
+ * with a fixed stride in each page. Like simd_search.hpp, each kernel has a scalar version and
+ * AVX2/AVX-512 versions that gather the field directly from the structs, and the best version
+ * is picked once at runtime. The same get_simd_level() applies to both files.
+ *
+ * Only 64-bit types (int64_t, uint64_t, double) are supported, which is what counters in
+ * OLAP-style queries usually are. Sums wrap around on overflow for integers.
+ * The scatter-add kernel is the write-side counterpart, used to apply many increments to
+ * records in a page at once. It uses gather/scatter in AVX-512, and gather only in AVX2.
+ * For double, the vectorized versions add values in a different order, so the sum might differ
+ * from the scalar version in the last bits. NaN is not supported.
+ */
+
+namespace foedus {
+namespace assorted {
+
+/**
+ * @brief Running aggregate of a field, which the kernels update.
+ * @ingroup ASSORTED
+ * @details
+ * min_ and max_ are meaningful only when count_ > 0.
+ */
+template <typename T>
+struct SimdAggregate {
+  SimdAggregate() { clear(); }
+
+  void clear() {
+    count_ = 0;
+    sum_ = 0;
+    min_ = std::numeric_limits<T>::max();
+    max_ = std::numeric_limits<T>::is_integer
+      ? std::numeric_limits<T>::min()
+      : -std::numeric_limits<T>::max();
+  }
+  /** Adds the values aggregated in the other object to this object. */
+  void merge(const SimdAggregate<T>& other) {
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min<T>(min_, other.min_);
+    max_ = std::max<T>(max_, other.max_);
+  }
+
+  /** Number of values aggregated so far. */
+  uint64_t  count_;
+  T         sum_;
+  T         min_;
+  T         max_;
+};
+
+/**
+ * @brief Aggregates base[0], base[stride], ..., base[(count - 1) * stride] into out.
+ * @ingroup ASSORTED
+ * @param[in] base address of the 0-th element. No alignment requirement.
+ * @param[in] stride distance from i-th element to (i+1)-th element in number of elements.
+ * @param[in] count number of elements to aggregate
+ * @param[in,out] out the values are added to this aggregate
+ */
+void simd_aggregate_strided(
+  const int64_t* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<int64_t>* out);
+/**
+ * @brief uint64_t version of simd_aggregate_strided().
+ * @ingroup ASSORTED
+ */
+void simd_aggregate_strided(
+  const uint64_t* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<uint64_t>* out);
+/**
+ * @brief double version of simd_aggregate_strided().
+ * @ingroup ASSORTED
+ */
+void simd_aggregate_strided(
+  const double* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<double>* out);
+
+/**
+ * @brief Same as simd_aggregate_strided(), but always uses the given instruction set.
+ * @ingroup ASSORTED
+ * @details
+ * Only for testing and benchmarking. If the CPU doesn't support the level, this falls back
+ * to the best supported one.
+ */
+void simd_aggregate_strided_with(
+  SimdLevel level,
+  const int64_t* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<int64_t>* out);
+/**
+ * @brief uint64_t version of simd_aggregate_strided_with().
+ * @ingroup ASSORTED
+ */
+void simd_aggregate_strided_with(
+  SimdLevel level,
+  const uint64_t* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<uint64_t>* out);
+/**
+ * @brief double version of simd_aggregate_strided_with().
+ * @ingroup ASSORTED
+ */
+void simd_aggregate_strided_with(
+  SimdLevel level,
+  const double* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<double>* out);
+
+/**
+ * @brief Does base[indexes[i] * stride] += addenda[i] for each i in [0, count).
+ * @ingroup ASSORTED
+ * @param[in,out] base address of the 0-th element. No alignment requirement.
+ * @param[in] stride distance from i-th element to (i+1)-th element in number of elements.
+ * Must be positive.
+ * @param[in] indexes element ordinals to add to. They must be distinct.
+ * @param[in] addenda values to add
+ * @param[in] count number of elements to add to
+ */
+void simd_add_scattered(
+  int64_t* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const int64_t* addenda,
+  uint32_t count);
+/**
+ * @brief uint64_t version of simd_add_scattered().
+ * @ingroup ASSORTED
+ */
+void simd_add_scattered(
+  uint64_t* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const uint64_t* addenda,
+  uint32_t count);
+/**
+ * @brief double version of simd_add_scattered().
+ * @ingroup ASSORTED
+ */
+void simd_add_scattered(
+  double* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const double* addenda,
+  uint32_t count);
+
+/**
+ * @brief Same as simd_add_scattered(), but always uses the given instruction set.
+ * @ingroup ASSORTED
+ * @details
+ * Only for testing and benchmarking, like simd_aggregate_strided_with().
+ */
+void simd_add_scattered_with(
+  SimdLevel level,
+  int64_t* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const int64_t* addenda,
+  uint32_t count);
+/**
+ * @brief double version of simd_add_scattered_with().
+ * @ingroup ASSORTED
+ */
+void simd_add_scattered_with(
+  SimdLevel level,
+  double* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const double* addenda,
+  uint32_t count);
+
+}  // namespace assorted
+}  // namespace foedus
+
+#endif  // FOEDUS_ASSORTED_SIMD_AGGREGATE_HPP_
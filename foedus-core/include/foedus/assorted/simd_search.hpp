@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#ifndef FOEDUS_ASSORTED_SIMD_SEARCH_HPP_
+#define FOEDUS_ASSORTED_SIMD_SEARCH_HPP_
+
+#include <stdint.h>
+
+#include "foedus/assert_nd.hpp"
+#include "foedus/compiler.hpp"
+
+/**
+ * @file foedus/assorted/simd_search.hpp
+ * @ingroup ASSORTED
+ * @brief Search kernels over small arrays of 64-bit integers, vectorized when the CPU allows.
+ * @details
+ * These are used to search key slices and separators in Masstree pages, which are the innermost
+ * loops of point lookups. Each method has a scalar version and AVX2/AVX-512 versions.
+ * The best version is picked \e once at runtime via CPUID (gcc's __builtin_cpu_supports),
+ * so the library itself is still compiled without -mavx2 and runs on any x86_64/AArch64 machine.
+ * On AArch64 or non-gcc compilers, we always use the scalar version.
+ *
+ * The detected level is cached in a constant-initialized global, and the search methods are
+ * inlined into the caller as a switch on it. The switch always takes the same branch, so it
+ * costs far less than an indirect call, and it's safe to call them from static initializers.
+ *
+ * All methods compare values as \b unsigned 64-bit integers, which is what KeySlice needs.
+ * They never read array[to] or beyond, so it's safe to use them on a page whose tail is being
+ * concurrently modified, as far as the caller's own protocol (eg page version) allows it.
+ */
+
+namespace foedus {
+namespace assorted {
+
+/**
+ * @brief Instruction set used by the search kernels.
+ * @ingroup ASSORTED
+ */
+enum SimdLevel {
+  /** Plain C++ loop. */
+  kSimdScalar = 0,
+  /** 4 lanes per instruction. */
+  kSimdAvx2 = 1,
+  /** 8 lanes per instruction, masked loads for the remainder. */
+  kSimdAvx512 = 2,
+};
+
+/**
+ * The detected SimdLevel, or -1 until detect_and_cache_simd_level() runs.
+ * Don't use this directly. Use get_simd_level().
+ */
+extern int8_t simd_level_cache;
+
+/**
+ * Detects the SimdLevel via CPUID and caches it in simd_level_cache.
+ * Concurrent calls are fine as they write the same value.
+ */
+SimdLevel detect_and_cache_simd_level();
+
+/**
+ * @returns the instruction set the search kernels use in this process, detected via CPUID.
+ * @ingroup ASSORTED
+ */
+inline SimdLevel get_simd_level() {
+  const int8_t level = simd_level_cache;
+  if (UNLIKELY(level < 0)) {
+    return detect_and_cache_simd_level();
+  }
+  return static_cast<SimdLevel>(level);
+}
+
+/**
+ * @returns human-readable name of the level.
+ * @ingroup ASSORTED
+ */
+const char* to_simd_level_string(SimdLevel level);
+
+/**
+ * @name Kernels of each instruction set
+ * Called only by the inline methods below after checking get_simd_level().
+ * The AVX versions fall back to the scalar code where they are not compiled.
+ */
+/// @{
+inline uint16_t find_first_equal_scalar(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  for (uint16_t i = from; i < to; ++i) {
+    if (array[i] == value) {
+      return i;
+    }
+  }
+  return to;
+}
+inline uint16_t find_first_greater_scalar(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  for (uint16_t i = from; i < to; ++i) {
+    if (array[i] > value) {
+      return i;
+    }
+  }
+  return to;
+}
+inline uint16_t find_first_equal_strided_scalar(
+  const uint64_t* base,
+  int32_t stride,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  for (uint16_t i = from; i < to; ++i) {
+    if (base[static_cast<int64_t>(i) * stride] == value) {
+      return i;
+    }
+  }
+  return to;
+}
+uint16_t find_first_equal_avx2(const uint64_t* array, uint16_t from, uint16_t to, uint64_t value);
+uint16_t find_first_equal_avx512(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value);
+uint16_t find_first_greater_avx2(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value);
+uint16_t find_first_greater_avx512(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value);
+uint16_t find_first_equal_strided_avx2(
+  const uint64_t* base,
+  int32_t stride,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value);
+uint16_t find_first_equal_strided_avx512(
+  const uint64_t* base,
+  int32_t stride,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value);
+/// @}
+
+/**
+ * @brief Finds the first element that is equal to the given value.
+ * @ingroup ASSORTED
+ * @param[in] array the array to search. No alignment requirement.
+ * @param[in] from the first index to check (inclusive)
+ * @param[in] to the last index to check (exclusive)
+ * @param[in] value value to find
+ * @return the smallest i in [from, to) such that array[i] == value, or \e to if not found.
+ */
+inline uint16_t simd_find_first_equal(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  ASSERT_ND(from <= to);
+  switch (get_simd_level()) {
+  case kSimdAvx512:
+    return find_first_equal_avx512(array, from, to, value);
+  case kSimdAvx2:
+    return find_first_equal_avx2(array, from, to, value);
+  default:
+    return find_first_equal_scalar(array, from, to, value);
+  }
+}
+
+/**
+ * @brief Finds the first element that is strictly larger than the given value.
+ * @ingroup ASSORTED
+ * @param[in] array the array to search. No alignment requirement.
+ * @param[in] from the first index to check (inclusive)
+ * @param[in] to the last index to check (exclusive)
+ * @param[in] value value to compare
+ * @return the smallest i in [from, to) such that array[i] > value, or \e to if not found.
+ * @details
+ * When the array is sorted, this is the upper-bound of the value.
+ */
+inline uint16_t simd_find_first_greater(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  ASSERT_ND(from <= to);
+  switch (get_simd_level()) {
+  case kSimdAvx512:
+    return find_first_greater_avx512(array, from, to, value);
+  case kSimdAvx2:
+    return find_first_greater_avx2(array, from, to, value);
+  default:
+    return find_first_greater_scalar(array, from, to, value);
+  }
+}
+
+/**
+ * @brief Strided version of simd_find_first_equal() for a field in an array of structs.
+ * @ingroup ASSORTED
+ * @param[in] base address of the 0-th element. Must be 8-byte aligned.
+ * @param[in] stride distance from i-th element to (i+1)-th element in number of uint64_t.
+ * Might be negative, eg for slots that grow backward from the end of a page.
+ * @param[in] from the first index to check (inclusive)
+ * @param[in] to the last index to check (exclusive)
+ * @param[in] value value to find
+ * @return the smallest i in [from, to) such that base[i * stride] == value, or \e to if not found.
+ * @details
+ * The vectorized versions use gather instructions, so they don't need a separate
+ * contiguous copy of the field.
+ */
+inline uint16_t simd_find_first_equal_strided(
+  const uint64_t* base,
+  int32_t stride,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  ASSERT_ND(from <= to);
+  switch (get_simd_level()) {
+  case kSimdAvx512:
+    return find_first_equal_strided_avx512(base, stride, from, to, value);
+  case kSimdAvx2:
+    return find_first_equal_strided_avx2(base, stride, from, to, value);
+  default:
+    return find_first_equal_strided_scalar(base, stride, from, to, value);
+  }
+}
+
+/**
+ * @brief Same as simd_find_first_equal(), but always uses the given instruction set.
+ * @ingroup ASSORTED
+ * @details
+ * Only for testing and benchmarking. If the CPU doesn't support the level, this falls back
+ * to the best supported one.
+ */
+uint16_t simd_find_first_equal_with(
+  SimdLevel level,
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value);
+
+/**
+ * @brief Same as simd_find_first_greater(), but always uses the given instruction set.
+ * @ingroup ASSORTED
+ * @copydetails simd_find_first_equal_with()
+ */
+uint16_t simd_find_first_greater_with(
+  SimdLevel level,
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value);
+
+/**
+ * @brief Same as simd_find_first_equal_strided(), but always uses the given instruction set.
+ * @ingroup ASSORTED
+ * @copydetails simd_find_first_equal_with()
+ */
+uint16_t simd_find_first_equal_strided_with(
+  SimdLevel level,
+  const uint64_t* base,
+  int32_t stride,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value);
+
+}  // namespace assorted
+}  // namespace foedus
+
+#endif  // FOEDUS_ASSORTED_SIMD_SEARCH_HPP_
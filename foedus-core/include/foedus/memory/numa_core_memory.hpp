@@ -50,6 +50,7 @@ class NumaCoreMemory CXX11_FINAL : public DefaultInitializable {
     char* sysxct_workspace_memory_;
     char* xct_pointer_access_memory_;
     char* xct_page_version_memory_;
+    char* xct_range_access_memory_;
     char* xct_read_access_memory_;
     char* xct_write_access_memory_;
     char* xct_lock_free_read_access_memory_;
@@ -148,6 +149,7 @@ class NumaCoreMemory CXX11_FINAL : public DefaultInitializable {
    * To reduce # of TLB entries, we pack several small things to this 2MB.
    * \li (used in Xct) PointerAccess(16b) * 1k : 16kb
    * \li (used in Xct) PageVersionAccess(16b) * 1k : 16kb
+   * \li (used in Xct) RangeXctAccess(40b) * 1k : 40kb
    * \li (used in Xct) ReadXctAccess(32b) * 32k :1024kb
    * \li (used in Xct) WriteXctAccess(40b) * 8k : 320kb
    * \li (used in Xct) LockFreeReadXctAccess(32b) * 128 : 4kb
@@ -405,6 +405,12 @@ class LogReducer final : public MapReduceBase {
    * multiple times for one compose().
    */
   memory::AlignedMemory   writer_intermediate_memory_;
+  /**
+   * Given to composers as Composer::ComposeArguments::reusable_memory_.
+   * Initially empty. Once a composer gives back its working buffer, it is reused in the
+   * following storages and snapshots without re-allocation.
+   */
+  memory::AlignedMemory   composer_reusable_memory_;
 
   /**
    * How many buffers written out as a temporary file.
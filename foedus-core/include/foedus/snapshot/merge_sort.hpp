@@ -521,14 +521,16 @@ inline bool is_hash_log_type(uint16_t log_type) {
     log_type == log::kLogCodeHashOverwrite
     || log_type == log::kLogCodeHashInsert
     || log_type == log::kLogCodeHashDelete
-    || log_type == log::kLogCodeHashUpdate;
+    || log_type == log::kLogCodeHashUpdate
+    || log_type == log::kLogCodeHashIncrement;
 }
 inline bool is_masstree_log_type(uint16_t log_type) {
   return
     log_type == log::kLogCodeMasstreeInsert
     || log_type == log::kLogCodeMasstreeDelete
     || log_type == log::kLogCodeMasstreeUpdate
-    || log_type == log::kLogCodeMasstreeOverwrite;
+    || log_type == log::kLogCodeMasstreeOverwrite
+    || log_type == log::kLogCodeMasstreeResize;
 }
 
 inline MergeSort::GroupifyResult MergeSort::groupify(uint32_t begin, uint32_t limit) const {
@@ -127,9 +127,11 @@ struct SnapshotManagerControlBlock {
     snapshot_wakeup_.initialize();
     snapshot_children_wakeup_.initialize();
     gleaner_.initialize();
+    snapshot_mutex_.initialize();
     requested_snapshot_epoch_.store(Epoch::kEpochInvalid);
   }
   void uninitialize() {
+    snapshot_mutex_.uninitialize();
     gleaner_.uninitialize();
   }
 
@@ -190,6 +192,15 @@ struct SnapshotManagerControlBlock {
    */
   soc::SharedPolling              snapshot_children_wakeup_;
 
+  /**
+   * Held by the snapshot thread from log gleaning until it drops volatile pages, which is
+   * most of the time a snapshot takes.
+   * Metadata operations that change the shape of a storage, such as ArrayStorage::extend(),
+   * take this mutex so that the partitioners, composers, and volatile-page dropping see a fixed
+   * shape. They thus wait for the snapshot in progress, if any.
+   */
+  soc::SharedMutex                snapshot_mutex_;
+
   /** Gleaner-related variables */
   LogGleanerControlBlock          gleaner_;
 };
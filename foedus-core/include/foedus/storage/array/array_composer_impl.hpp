@@ -29,6 +29,8 @@
 #include "foedus/snapshot/fwd.hpp"
 #include "foedus/storage/composer.hpp"
 #include "foedus/storage/page.hpp"
+#include "foedus/storage/record.hpp"
+#include "foedus/storage/storage_id.hpp"
 #include "foedus/storage/array/array_id.hpp"
 #include "foedus/storage/array/array_route.hpp"
 #include "foedus/storage/array/array_storage.hpp"
@@ -78,6 +80,12 @@ class ArrayComposer final {
     DualPagePointer* pointer,
     ArrayPage* volatile_page);
   bool is_to_keep_volatile(uint16_t level);
+  /**
+   * Moves the volatile page we are keeping to its owner node if it is elsewhere.
+   * Transactions are paused while we drop volatile pages, so no one is looking at the page.
+   * @see ArrayPlacement
+   */
+  void migrate_to_owner(const Composer::DropVolatilesArguments& args, DualPagePointer* pointer);
   /** Used only from drop_root_volatile. Drop every volatile page. */
   void drop_all_recurse(
     const Composer::DropVolatilesArguments& args,
@@ -101,6 +109,28 @@ struct ArrayRootInfoPage final {
     - kInteriorFanout * sizeof(SnapshotPagePointer)];
 };
 
+/** Max number of records in a leaf page, which is when the payload is empty */
+const uint16_t kMaxRecordsInLeaf = kDataSize / kRecordOverhead;
+/** Max number of (payload_offset, type) pairs ArrayComposeContext aggregates per page */
+const uint16_t kMaxIncrementGroups = 4;
+
+/**
+ * Increments on one field of records in a leaf page, added up per record.
+ * Only for 64-bit integers, which assorted::simd_add_scattered() supports and whose sums do not
+ * depend on the order of additions. Others are rare in counters anyway.
+ * indexes_ are increasing because logs come in offset order.
+ */
+struct ArrayIncrementGroup {
+  uint16_t  payload_offset_;
+  ValueType value_type_;
+  /** Number of records in this group */
+  uint16_t  count_;
+  /** Ordinals of the records in the page */
+  uint16_t  indexes_[kMaxRecordsInLeaf];
+  /** Sum of addenda for each record. int64_t or uint64_t depending on value_type_ */
+  uint64_t  addenda_[kMaxRecordsInLeaf];
+};
+
 /**
  * ArrayComposer's compose() implementation separated from the class itself.
  * It's a complicated method, so worth being its own class.
@@ -125,8 +155,20 @@ class ArrayComposeContext {
    * apply the range of logs in a tight loop.
    * this needs to access the logs themselves, which might cause L1 cache miss.
    * the fetch method ameriolates it by pararell prefetching for this number.
+   * Increments of 64-bit integers are not applied one by one. We add them up per record and
+   * field in increment_groups_, then apply them at the end with SIMD. Doubles are applied
+   * one by one because adding them up first might round differently.
    */
   void apply_batch(uint64_t cur, uint64_t next);
+  /**
+   * Adds the increment log to increment_groups_.
+   * @return false if we can't, in which case the caller applies it on its own.
+   */
+  bool stage_increment(uint16_t index, const ArrayIncrementLogType* log);
+  /** Applies and removes increments staged for the record. Called before other logs on it */
+  void flush_staged_increments(uint16_t index, Record* record);
+  /** Applies all staged increments to the leaf page, and clears increment_groups_ */
+  void apply_staged_increments(ArrayPage* leaf);
 
   /**
    * separate and trivial implementation of execute() for when the array has only one page.
@@ -146,12 +188,22 @@ class ArrayComposeContext {
 
   /**
    * creates empty snapshot pages that didn't receive any logs during the initial snapshot.
-   * We have to create snapshot pages even for such pages only for initial snapshot.
+   * We have to create snapshot pages even for such pages only for initial snapshot, or for the
+   * range added by ArrayStorage::extend() since the previous snapshot.
+   * In the latter case, this also rewrites the previous right-most pages to widen them.
    */
   ErrorCode create_empty_pages(ArrayOffset from, ArrayOffset to);
   ErrorCode create_empty_pages_recurse(ArrayOffset from, ArrayOffset to, ArrayPage* page);
-  ErrorCode create_empty_intermediate_page(ArrayPage* parent, uint16_t index, ArrayRange range);
-  ErrorCode create_empty_leaf_page(ArrayPage* parent, uint16_t index, ArrayRange range);
+  /**
+   * Makes cur_path_[parent's level - 1] the index-th child of the parent, reading the page from
+   * the previous snapshot or creating an empty page if the previous snapshot doesn't have it.
+   */
+  ErrorCode switch_child_page(ArrayPage* parent, uint16_t index, const ArrayRange& range);
+  /**
+   * Creates the root pages above the previous root when ArrayStorage::extend() has added levels
+   * since the previous snapshot. The previous root becomes the first child.
+   */
+  ErrorCode init_new_root_pages();
 
   /** call this before obtaining a new intermediate page */
   ErrorCode expand_intermediate_pool_if_needed() ALWAYS_INLINE;
@@ -174,6 +226,8 @@ class ArrayComposeContext {
 
   /** dump everything in main buffer (intermediate pages are kept) */
   ErrorCode dump_leaf_pages();
+  /** Whether the child page doesn't exist in the previous snapshot nor in this snapshot */
+  bool is_empty_child(const ArrayPage* parent, uint16_t index) const;
   /** used only in debug mode */
   bool verify_cur_path() const;
   bool verify_snapshot_pointer(storage::SnapshotPagePointer pointer);
@@ -184,6 +238,12 @@ class ArrayComposeContext {
     return ArrayRange(begin, begin + offset_intervals_[0], storage_.get_array_size());
   }
   bool is_initial_snapshot() const { return previous_root_page_pointer_ == 0; }
+  /** Whether ArrayStorage::extend() has been called since the previous snapshot */
+  bool is_extended() const {
+    return !is_initial_snapshot() && previous_array_size_ < storage_.get_array_size();
+  }
+  /** Whether we leave never-written pages out of the snapshot. See ArrayMetadata::sparse_ */
+  bool is_sparse() const { return storage_.get_array_metadata()->is_sparse(); }
 
   uint16_t get_root_children() const;
 
@@ -202,6 +262,19 @@ class ArrayComposeContext {
   const uint16_t                  payload_size_;
   const uint8_t                   levels_;
   const SnapshotPagePointer       previous_root_page_pointer_;
+  /** Size of the array in the previous snapshot. 0 if this is the initial snapshot. */
+  const ArrayOffset               previous_array_size_;
+  /** Levels of the array in the previous snapshot. 0 if this is the initial snapshot. */
+  const uint8_t                   previous_levels_;
+  /**
+   * We have to make sure all pages in [fill_from_, array size) exist in this snapshot even
+   * if they receive no logs. 0 in initial snapshot, the last offset of the previous snapshot
+   * if the array has been extended since then (so that we widen the previous right-most pages),
+   * and the array size (nothing to fill) otherwise.
+   * A sparse array never fills empty pages. Only the widening might happen, and
+   * create_empty_pages() skips pages that don't exist.
+   */
+  const ArrayOffset               fill_from_;
 
   /**
    * The offset interval a single page represents in each level. index=level.
@@ -241,6 +314,10 @@ class ArrayComposeContext {
    * create empty pages in this partition.
    */
   const ArrayPartitionerData* partitioning_data_;
+
+  /** Increments staged in apply_batch() */
+  ArrayIncrementGroup       increment_groups_[kMaxIncrementGroups];
+  uint16_t                  increment_groups_count_;
 };
 
 static_assert(sizeof(ArrayRootInfoPage) == kPageSize, "incorrect sizeof(RootInfoPage)");
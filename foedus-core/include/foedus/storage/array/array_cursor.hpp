@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#ifndef FOEDUS_STORAGE_ARRAY_ARRAY_CURSOR_HPP_
+#define FOEDUS_STORAGE_ARRAY_ARRAY_CURSOR_HPP_
+
+#include <stdint.h>
+
+#include <iosfwd>
+
+#include "foedus/assert_nd.hpp"
+#include "foedus/compiler.hpp"
+#include "foedus/cxx11.hpp"
+#include "foedus/error_code.hpp"
+#include "foedus/assorted/simd_aggregate.hpp"
+#include "foedus/storage/record.hpp"
+#include "foedus/storage/array/array_id.hpp"
+#include "foedus/storage/array/array_storage.hpp"
+#include "foedus/storage/array/fwd.hpp"
+#include "foedus/thread/fwd.hpp"
+#include "foedus/xct/fwd.hpp"
+
+namespace foedus {
+namespace storage {
+namespace array {
+/**
+ * @brief A cursor to scan a range of records in an array storage, one leaf page at a time.
+ * @ingroup ARRAY
+ * @details
+ * Records in an array leaf page are laid out back to back with a fixed stride.
+ * Instead of returning records one by one, this cursor gives the records of each leaf page
+ * in the range as a span: get_record_count() records from get_payload(0), each
+ * get_record_stride() bytes apart. The cursor walks the leaf pages in offset order, remembering
+ * the interior pages on the way, so moving to the next leaf page usually needs no new lookup
+ * from the root.
+ *
+ * @par Example
+ * @code{.cpp}
+ * ... (begin xct, etc)
+ * ArrayCursor cursor(context, storage);
+ * CHECK_ERROR_CODE(cursor.open(ArrayRange(from, to)));
+ * while (cursor.is_valid_page()) {
+ *   for (uint16_t i = 0; i < cursor.get_record_count(); ++i) {
+ *     const char* payload = cursor.get_payload(i);  // offset = get_page_range().begin_ + i
+ *     ...
+ *   }
+ *   CHECK_ERROR_CODE(cursor.next_page());
+ * }
+ * ... (commit xct, etc)
+ * @endcode
+ *
+ * @par Aggregates
+ * aggregate_page() and aggregate() compute count/sum/min/max of a 64-bit primitive field
+ * in the payload with the kernels in simd_aggregate.hpp. They gather the field directly from
+ * the page, so a query like the total of a counter over all records runs at memory bandwidth.
+ *
+ * @par Isolation level
+ * The cursor follows the same protocol as ArrayStorage::get_record_payload(). It reads
+ * volatile pages where they exist, and snapshot pages elsewhere.
+ * \li kSerializable: when the cursor moves to a volatile page, every record in the span is added
+ * to the read-set. A scan over many records thus needs a large read-set (see
+ * XctOptions::max_read_set_size_). Following a snapshot pointer adds it to the pointer set.
+ * \li kSnapshot: same as kSerializable, but without read-set. It waits for records being written.
+ * \li kDirtyRead: no read-set nor waits.
+ *
+ * @par Sparse arrays
+ * In an array with ArrayMetadata::sparse_, the cursor skips the pages that don't exist.
+ * All records in them have ArrayMetadata::default_value_. Thus, get_page_range() of the next page
+ * might not start where the previous one ended, and aggregates cover only existing pages.
+ * The pointer set protects the skipped pages in kSerializable.
+ *
+ * @par Lifetime of returned pointers
+ * get_payload() points to the page. The pointers are valid only until the next call to
+ * next_page(). Payloads in volatile pages might be concurrently modified, which kSerializable
+ * transactions will find at pre-commit.
+ */
+class ArrayCursor CXX11_FINAL {
+ public:
+  ArrayCursor(thread::Thread* context, const ArrayStorage& storage);
+  ~ArrayCursor();
+
+  thread::Thread*     get_context() const { return context_; }
+  const ArrayStorage& get_storage() const { return storage_; }
+
+  /** Opens the cursor on all records of the storage. */
+  ErrorCode open();
+  /**
+   * @brief Opens the cursor on the given range of records and moves to its first leaf page.
+   * @param[in] range Offsets to scan. Must be within the array size.
+   */
+  ErrorCode open(const ArrayRange& range);
+
+  /** @returns whether the cursor is now on a page. false after the last page. */
+  bool      is_valid_page() const ALWAYS_INLINE { return cur_page_ != CXX11_NULLPTR; }
+
+  /** Moves on to the next leaf page in the range. */
+  ErrorCode next_page();
+
+  /** @returns the range given to open() */
+  const ArrayRange& get_range() const { return range_; }
+
+  /** @returns the offsets of the records in the current page that are within the range. */
+  const ArrayRange& get_page_range() const ALWAYS_INLINE {
+    ASSERT_ND(is_valid_page());
+    return cur_range_;
+  }
+  /** @returns the number of records in the current span. */
+  uint16_t  get_record_count() const ALWAYS_INLINE {
+    ASSERT_ND(is_valid_page());
+    return cur_range_.end_ - cur_range_.begin_;
+  }
+  /** @returns whether the current page is a snapshot page. */
+  bool      is_snapshot_page() const;
+  /** @returns byte distance from a record to the next record in the page. */
+  uint16_t  get_record_stride() const ALWAYS_INLINE { return record_stride_; }
+  /**
+   * @returns the payload of the index-th record in the span, whose offset is
+   * get_page_range().begin_ + index.
+   */
+  const char* get_payload(uint16_t index) const ALWAYS_INLINE {
+    ASSERT_ND(is_valid_page());
+    ASSERT_ND(index < get_record_count());
+    return cur_records_ + static_cast<uint32_t>(index) * record_stride_ + kRecordOverhead;
+  }
+
+  /**
+   * @brief Adds the field of all records in the current span to the aggregate.
+   * @param[in] payload_offset byte position of the field in the payload
+   * @param[in,out] out The aggregate to update
+   * @tparam T int64_t, uint64_t, or double
+   * @pre payload_offset + sizeof(T) <= payload size
+   */
+  template <typename T>
+  void      aggregate_page(uint16_t payload_offset, assorted::SimdAggregate<T>* out) const {
+    ASSERT_ND(is_valid_page());
+    ASSERT_ND(payload_offset + sizeof(T) <= payload_size_);
+    ASSERT_ND(record_stride_ % sizeof(T) == 0);
+    const T* base = reinterpret_cast<const T*>(get_payload(0) + payload_offset);
+    const int32_t stride = record_stride_ / sizeof(T);
+    assorted::simd_aggregate_strided(base, stride, get_record_count(), out);
+  }
+
+  /**
+   * @brief Adds the field of all records from the current page to the end of the range.
+   * @details
+   * The cursor is invalid after this method.
+   * @copydetails aggregate_page()
+   */
+  template <typename T>
+  ErrorCode aggregate(uint16_t payload_offset, assorted::SimdAggregate<T>* out) {
+    while (is_valid_page()) {
+      aggregate_page(payload_offset, out);
+      CHECK_ERROR_CODE(next_page());
+    }
+    return kErrorCodeOk;
+  }
+
+  friend std::ostream& operator<<(std::ostream& o, const ArrayCursor& v);
+
+ private:
+  /** Moves to the first existing leaf page at or after the offset, or invalidates the cursor. */
+  ErrorCode move_to(ArrayOffset offset);
+  /**
+   * Sets the pages in path_ so that path_[0] is the leaf page that contains the offset.
+   * We reuse interior pages in path_ that contain the offset.
+   * In a sparse array, if the page doesn't exist, we advance the offset to the next page that
+   * exists, or to the end of the range if none.
+   */
+  ErrorCode locate_leaf(ArrayOffset* offset);
+  /** Sets the span in the leaf page we have just moved to, and observes the records in it. */
+  ErrorCode enter_page(ArrayOffset offset);
+
+  thread::Thread* const     context_;
+  xct::Xct* const           xct_;
+  ArrayStorage              storage_;
+  const uint16_t            payload_size_;
+  /** kRecordOverhead + align8(payload_size_) */
+  const uint16_t            record_stride_;
+  const uint8_t             levels_;
+  /** Whether we call on_record_read() for records in volatile pages. False in kDirtyRead. */
+  const bool                observe_records_;
+
+  ArrayRange                range_;
+
+  /// Everything below is the state of this cursor.
+
+  /**
+   * path_[level] is the page in the level that contains the current leaf page.
+   * path_[0] is the current leaf page, path_[levels_ - 1] is the root page.
+   */
+  ArrayPage*                path_[kMaxLevels];
+  /** The leaf page we are now reading. nullptr when the cursor is done. */
+  ArrayPage*                cur_page_;
+  /** Offsets of the current span. */
+  ArrayRange                cur_range_;
+  /** Address of the first record of the current span. */
+  const char*               cur_records_;
+};
+
+}  // namespace array
+}  // namespace storage
+}  // namespace foedus
+#endif  // FOEDUS_STORAGE_ARRAY_ARRAY_CURSOR_HPP_
@@ -64,6 +64,25 @@ struct ArrayCreateLogType : public log::StorageLogType {
   friend std::ostream& operator<<(std::ostream& o, const ArrayCreateLogType& v);
 };
 
+/**
+ * @brief Log type of EXTEND ARRAY STORAGE operation.
+ * @ingroup ARRAY LOGTYPE
+ * @details
+ * This log corresponds to ArrayStorage::extend() operation.
+ * Like ArrayCreateLogType, this is a metadata log. Restart redoes it before record-wise logs
+ * of the storage are gleaned, so the logs in the grown range have their pages.
+ *
+ * This log type is infrequently triggered, so no optimization. All methods defined in cpp.
+ */
+struct ArrayExtendLogType : public log::StorageLogType {
+  LOG_TYPE_NO_CONSTRUCT(ArrayExtendLogType)
+  ArrayOffset     new_array_size_;
+
+  void apply_storage(Engine* engine, StorageId storage_id);
+  void assert_valid();
+  friend std::ostream& operator<<(std::ostream& o, const ArrayExtendLogType& v);
+};
+
 /**
  * @brief A base class for ArrayOverwriteLogType/ArrayIncrementLogType.
  * @ingroup ARRAY LOGTYPE
@@ -143,35 +162,6 @@ struct ArrayOverwriteLogType : public ArrayCommonUpdateLogType {
   friend std::ostream& operator<<(std::ostream& o, const ArrayOverwriteLogType& v);
 };
 
-/** Used in ArrayIncrementLogType. */
-enum ValueType {
-  kUnknown = 0,
-  kI8 = 1,
-  kI16,
-  kI32,
-  kU8,
-  kU16,
-  kU32,
-  kFloat,
-  kBool,
-  // above are 32bits or less, below are 64 bits
-  kI64,
-  kU64,
-  kDouble,
-};
-template <typename T> ValueType to_value_type();
-template <> inline ValueType to_value_type<bool>() { return kBool; }
-template <> inline ValueType to_value_type<int8_t>() { return kI8; }
-template <> inline ValueType to_value_type<int16_t>() { return kI16; }
-template <> inline ValueType to_value_type<int32_t>() { return kI32; }
-template <> inline ValueType to_value_type<int64_t>() { return kI64; }
-template <> inline ValueType to_value_type<uint8_t>() { return kU8; }
-template <> inline ValueType to_value_type<uint16_t>() { return kU16; }
-template <> inline ValueType to_value_type<uint32_t>() { return kU32; }
-template <> inline ValueType to_value_type<uint64_t>() { return kU64; }
-template <> inline ValueType to_value_type<float>() { return kFloat; }
-template <> inline ValueType to_value_type<double>() { return kDouble ; }
-
 /**
  * @brief Log type of array-storage's increment operation.
  * @ingroup ARRAY LOGTYPE
@@ -33,6 +33,28 @@
 namespace foedus {
 namespace storage {
 namespace array {
+/**
+ * @brief Which NUMA node allocates the volatile pages of an array storage.
+ * @ingroup ARRAY
+ * @details
+ * Except kArrayPlacementFirstTouch, every page below the root page has an \e owner node,
+ * determined by the direct child of the root page (bucket) the page belongs to.
+ * Volatile pages are created on the owner node, and snapshots move volatile pages they keep
+ * to the owner node. The root page is not placed.
+ * @see ArrayMetadata::placement_
+ */
+enum ArrayPlacement {
+  /** Pages are allocated on the node of the thread that first needs them. The default. */
+  kArrayPlacementFirstTouch = 0,
+  /** Buckets are split into as many contiguous ranges as NUMA nodes, in ascending order. */
+  kArrayPlacementRange = 1,
+  /**
+   * Buckets follow the partitions ArrayPartitioner designed in the latest snapshot, which are
+   * also the nodes that compose the snapshot pages. Same as kArrayPlacementRange until then.
+   */
+  kArrayPlacementPartitioner = 2,
+};
+
 /**
  * @brief Metadata of an array storage.
  * @ingroup ARRAY
@@ -45,8 +67,11 @@ struct ArrayMetadata CXX11_FINAL : public Metadata {
     : Metadata(0, kArrayStorage, ""),
     payload_size_(0),
     snapshot_drop_volatile_pages_threshold_(kDefaultSnapshotDropVolatilePagesThreshold),
-    padding_(0),
-    array_size_(0) {}
+    sparse_(0),
+    placement_(kArrayPlacementFirstTouch),
+    padding2_(0),
+    array_size_(0),
+    default_value_(0) {}
   ArrayMetadata(
     StorageId id,
     const StorageName& name,
@@ -55,18 +80,29 @@ struct ArrayMetadata CXX11_FINAL : public Metadata {
     : Metadata(id, kArrayStorage, name),
     payload_size_(payload_size),
     snapshot_drop_volatile_pages_threshold_(kDefaultSnapshotDropVolatilePagesThreshold),
-    padding_(0),
-    array_size_(array_size) {
+    sparse_(0),
+    placement_(kArrayPlacementFirstTouch),
+    padding2_(0),
+    array_size_(array_size),
+    default_value_(0) {
   }
   /** This one is for newly creating a storage. */
   ArrayMetadata(const StorageName& name, uint16_t payload_size, ArrayOffset array_size)
     : Metadata(0, kArrayStorage, name),
     payload_size_(payload_size),
     snapshot_drop_volatile_pages_threshold_(kDefaultSnapshotDropVolatilePagesThreshold),
-    padding_(0),
-    array_size_(array_size) {
+    sparse_(0),
+    placement_(kArrayPlacementFirstTouch),
+    padding2_(0),
+    array_size_(array_size),
+    default_value_(0) {
   }
 
+  /** @returns whether never-written pages of this storage stay null. See sparse_. */
+  bool                is_sparse() const { return sparse_ != 0; }
+  /** @returns whether volatile pages of this storage have owner nodes. See placement_. */
+  bool                has_placement() const { return placement_ != kArrayPlacementFirstTouch; }
+
   std::string describe() const;
   friend std::ostream& operator<<(std::ostream& o, const ArrayMetadata& v);
 
@@ -80,9 +116,32 @@ struct ArrayMetadata CXX11_FINAL : public Metadata {
    * If it doesn't, the user (you) chooses the right value per storage.
    */
   uint16_t            snapshot_drop_volatile_pages_threshold_;
-  uint32_t            padding_;  // to make valgrind happy
+  /**
+   * Whether this storage is sparse. 0 (default) means no.
+   * A sparse array never creates a page just because a transaction read it. Pages that have
+   * not received a write stay null in both volatile and snapshot trees, and their records read
+   * as default_value_. Snapshots don't write out such pages either.
+   * This is recommended for large arrays of which only a small fraction is ever written.
+   * A non-sparse array instead creates such pages on the first access and in the initial
+   * snapshot, which makes reads a little faster.
+   */
+  uint8_t             sparse_;
+  /**
+   * Where volatile pages of this storage are allocated, one of ArrayPlacement.
+   * kArrayPlacementFirstTouch (default) is fine for most arrays. Arrays accessed by
+   * partition, eg per warehouse, should specify one of the others to avoid remote accesses.
+   */
+  uint8_t             placement_;
+  uint16_t            padding2_;  // to make valgrind happy
   /** Size of this array */
   ArrayOffset         array_size_;
+  /**
+   * The payload of records that have never been written.
+   * Every 8 bytes of such a payload is this value, and a payload size that is not a multiple of
+   * 8 takes the leading bytes of the last 8 bytes. The default is 0, all-zero payloads.
+   * This applies to non-sparse arrays, too.
+   */
+  uint64_t            default_value_;
 };
 
 struct ArrayMetadataSerializer CXX11_FINAL : public virtual MetadataSerializer {
@@ -71,21 +71,35 @@ class ArrayPage final {
   uint8_t             get_level()         const   { return level_; }
   const ArrayRange&   get_array_range()   const   { return array_range_; }
 
-  /** Called only when this page is initialized. */
+  /**
+   * Called only when this page is initialized.
+   * Payloads in a leaf page are filled with default_value (see ArrayMetadata::default_value_).
+   */
   void                initialize_snapshot_page(
     Epoch initial_epoch,
     StorageId storage_id,
     SnapshotPagePointer page_id,
     uint16_t payload_size,
     uint8_t level,
-    const ArrayRange& array_range);
+    const ArrayRange& array_range,
+    uint64_t default_value);
   void                initialize_volatile_page(
     Epoch initial_epoch,
     StorageId storage_id,
     VolatilePagePointer page_id,
     uint16_t payload_size,
     uint8_t level,
-    const ArrayRange& array_range);
+    const ArrayRange& array_range,
+    uint64_t default_value);
+
+  /**
+   * Widens the range of a right-most page when the array grows.
+   * @see ArrayStorage::extend()
+   */
+  void                extend_array_range(ArrayOffset new_end) {
+    ASSERT_ND(new_end >= array_range_.end_);
+    array_range_.end_ = new_end;
+  }
 
   // Record accesses
   const Record*  get_leaf_record(uint16_t record, uint16_t payload_size) const ALWAYS_INLINE {
@@ -131,15 +145,37 @@ class ArrayPage final {
    * The offset range this node is in charge of. Mainly for sanity checking.
    * If this page is right-most (eg root page), the end is the array's size,
    * which might be smaller than the range it can physically contain.
+   * The end of a right-most page grows when the array is extended.
    */
   ArrayRange          array_range_;   // +16 -> 64
 
-  // All variables up to here are immutable after the array storage is created.
+  // All variables up to here are immutable after the array storage is created,
+  // except array_range_.end_ of right-most pages (see extend_array_range()).
 
   /** Dynamic records in this page. */
   Data                data_;
 };
 
+/**
+ * @brief Copies a part of the payload of never-written records.
+ * @ingroup ARRAY
+ * @param[in] default_value ArrayMetadata::default_value_
+ * @param[in] payload_offset The first byte position in the payload to copy
+ * @param[in] payload_count Bytes to copy
+ * @param[out] out Receives payload_count bytes
+ */
+inline void fill_default_payload(
+  uint64_t default_value,
+  uint16_t payload_offset,
+  uint16_t payload_count,
+  void* out) {
+  const char* pattern = reinterpret_cast<const char*>(&default_value);
+  char* casted = reinterpret_cast<char*>(out);
+  for (uint16_t i = 0; i < payload_count; ++i) {
+    casted[i] = pattern[(payload_offset + i) % sizeof(default_value)];
+  }
+}
+
 /**
  * volatile page initialize callback for ArrayPage.
  * @ingroup ARRAY
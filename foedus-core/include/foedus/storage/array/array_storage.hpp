@@ -101,6 +101,34 @@ class ArrayStorage CXX11_FINAL : public Storage<ArrayStorageControlBlock> {
   /** Returns the number of levels. */
   uint8_t     get_levels() const;
 
+  /**
+   * @brief Grows this array to the given size.
+   * @param[in] new_array_size the new number of records in this array.
+   * @param[out] commit_epoch The epoch when the extend has happened.
+   * @pre new_array_size >= get_array_size()
+   * @pre new_array_size <= kMaxArrayOffset
+   * @post new_array_size == get_array_size()
+   * @details
+   * Records [get_array_size(), new_array_size) are added as zero-filled records.
+   * Existing records are neither moved nor copied. This method widens the pages on the path
+   * to the current last record, and adds new root pages on top of the current root page if the
+   * array needs more levels. So, it takes a short time regardless of the array size.
+   * Like dropping volatile pages in snapshot, this method pauses new transactions for a moment
+   * while it replaces the root page.
+   *
+   * Just like SequentialStorage::truncate(), this is a metadata operation that
+   * starts and ends its own meta-transaction. So it does NOT receive a Thread context.
+   * This method blocks while a snapshot is in progress, which might take seconds or more in
+   * a large database. Snapshots design partitions, compose pages, and drop volatile pages based
+   * on the shape of the array, so this method can't change the shape in the meantime.
+   * Transactions are not blocked during the wait. Only the caller of this method is.
+   * The next snapshot of this storage reshapes the snapshot pages to the new size.
+   * If new_array_size == get_array_size(), this method does nothing (not an error).
+   */
+  ErrorStack  extend(ArrayOffset new_array_size, Epoch* commit_epoch);
+  /** Redoes extend() during restart. */
+  void        apply_extend(const ArrayExtendLogType& the_log);
+
   /**
    * @brief Retrieves one record of the given offset in this array storage.
    * @param[in] context Thread context
@@ -27,6 +27,7 @@
 #include "foedus/cxx11.hpp"
 #include "foedus/fwd.hpp"
 #include "foedus/assorted/const_div.hpp"
+#include "foedus/cache/fwd.hpp"
 #include "foedus/memory/fwd.hpp"
 #include "foedus/soc/shared_memory_repo.hpp"
 #include "foedus/storage/fwd.hpp"
@@ -76,8 +77,31 @@ struct ArrayStorageControlBlock final {
    * which might be smaller than the range it can physically contain.
    */
   uint64_t            intervals_[8];
+
+  /**
+   * The array size of the tree pointed by meta_.root_snapshot_page_id_, 0 if there is no
+   * snapshot of this storage yet. This is smaller than meta_.array_size_ iff the array has been
+   * extended since the latest snapshot, in which case the next snapshot has to reshape the tree.
+   * @see ArrayStorage::extend()
+   */
+  ArrayOffset         snapshot_array_size_;
+
+  /**
+   * Whether placement_owners_ is set. Only for kArrayPlacementPartitioner.
+   * False until a snapshot designs partitions of this storage, and after extend() changes the
+   * direct children of the root page.
+   */
+  bool                placement_owners_valid_;
+  /**
+   * The owner node of each direct child of the root page in kArrayPlacementPartitioner.
+   * ArrayPartitioner copies its design here.
+   */
+  thread::ThreadGroupId placement_owners_[kInteriorFanout];
 };
 
+/** Returns the number of levels an array of the given size needs. */
+uint8_t calculate_levels(ArrayOffset array_size, uint16_t payload_size);
+
 /**
  * @brief Pimpl object of ArrayStorage.
  * @ingroup ARRAY
@@ -103,6 +127,29 @@ class ArrayStoragePimpl final {
   ErrorStack  create(const Metadata& metadata);
   ErrorStack  load(const StorageControlBlock& snapshot_block);
   ErrorStack  load_empty();
+  /** Sets intervals_ from route_finder_ for the given number of levels. */
+  void        set_intervals(uint8_t levels);
+
+  /** @see ArrayStorage::extend() */
+  ErrorStack  extend(ArrayOffset new_array_size, Epoch* commit_epoch);
+  /**
+   * @brief Grows the volatile tree and publishes the new size.
+   * @details
+   * Called from extend(), from restart, and from load() when the latest snapshot of this
+   * storage was taken before extend(). Does nothing if the array is already that large.
+   */
+  ErrorStack  apply_extend(ArrayOffset new_array_size);
+  /**
+   * Makes sure the page pointed by the pointer has a volatile version, installing it from the
+   * snapshot page or as an empty page of the given level/range if needed. Used by apply_extend().
+   * In a sparse array, a page that doesn't exist stays so, and out receives nullptr.
+   */
+  ErrorStack  ensure_volatile_page(
+    cache::SnapshotFileSet* fileset,
+    DualPagePointer* pointer,
+    uint8_t level,
+    const ArrayRange& range,
+    ArrayPage** out);
 
   void        report_page_distribution();
 
@@ -115,6 +162,14 @@ class ArrayStoragePimpl final {
   }
   uint16_t    get_payload_size() const { return get_meta().payload_size_; }
   ArrayOffset get_array_size() const { return get_meta().array_size_; }
+  bool        is_sparse() const { return get_meta().is_sparse(); }
+  uint64_t    get_default_value() const { return get_meta().default_value_; }
+  /**
+   * Returns the node that should hold volatile pages that contain the given offset.
+   * @pre get_meta().has_placement()
+   * @see ArrayPlacement
+   */
+  thread::ThreadGroupId get_owner_node(ArrayOffset offset) const;
   ErrorCode   get_root_page(thread::Thread* context, bool for_write, ArrayPage** out) ALWAYS_INLINE;
   ErrorStack  verify_single_thread(thread::Thread* context);
   ErrorStack  verify_single_thread(thread::Thread* context, ArrayPage* page);
@@ -138,6 +193,10 @@ class ArrayStoragePimpl final {
     ArrayPage* page);
 
   // all per-record APIs are called so frequently, so returns ErrorCode rather than ErrorStack
+  /**
+   * In a sparse array, out receives nullptr if the record is in a page that doesn't exist.
+   * The record then has the default payload (see fill_default_payload()).
+   */
   ErrorCode   locate_record_for_read(
     thread::Thread* context,
     ArrayOffset offset,
@@ -222,6 +281,7 @@ class ArrayStoragePimpl final {
     T value,
     uint16_t payload_offset);
 
+  /** In a sparse array, out receives nullptr if the leaf page doesn't exist. */
   ErrorCode   lookup_for_read(
     thread::Thread* context,
     ArrayOffset offset,
@@ -275,6 +335,7 @@ class ArrayStoragePimpl final {
    */
   static std::vector<uint64_t> calculate_offset_intervals(uint8_t levels, uint16_t payload);
 
+  /** In a sparse array, out receives nullptr if !for_write and the page doesn't exist. */
   ErrorCode follow_pointer(
     thread::Thread* context,
     bool in_snapshot,
@@ -283,6 +344,16 @@ class ArrayStoragePimpl final {
     ArrayPage** out,
     const ArrayPage* parent,
     uint16_t index_in_parent) ALWAYS_INLINE;
+  /**
+   * Installs a volatile page for the null volatile pointer on the owner node of the page,
+   * if it is not the node of this thread. Otherwise, or if the owner node has no free pages,
+   * does nothing and lets follow_page_pointer() allocate it from our node as usual.
+   */
+  ErrorCode install_owner_volatile_page(
+    thread::Thread* context,
+    DualPagePointer* pointer,
+    const ArrayPage* parent,
+    uint16_t index_in_parent);
   ErrorCode follow_pointers_for_read_batch(
     thread::Thread* context,
     uint16_t batch_size,
@@ -311,9 +382,17 @@ inline ErrorCode ArrayStoragePimpl::follow_pointer(
   uint16_t index_in_parent) {
   ASSERT_ND(!in_snapshot || !for_write);  // if we are modifying, we must be in volatile world
   ASSERT_ND(!parent->is_leaf());
+  // A sparse array doesn't create a page to read it. The pointer set protects the null pointer.
+  const bool tolerate_null_page = !for_write && is_sparse();
+  // follow_page_pointer() would create the volatile page on our node. Place it on the owner.
+  if (UNLIKELY(pointer->volatile_pointer_.is_null() && get_meta().has_placement())) {
+    if (for_write || (!tolerate_null_page && !in_snapshot && pointer->snapshot_pointer_ == 0)) {
+      CHECK_ERROR_CODE(install_owner_volatile_page(context, pointer, parent, index_in_parent));
+    }
+  }
   CHECK_ERROR_CODE(context->follow_page_pointer(
     array_volatile_page_init,  // array might have null pointer. in that case create empty new page
-    false,  // if both volatile/snapshot null, create a new volatile (logically all-zero)
+    tolerate_null_page,  // if both null, create a new volatile (logically all-default)
     for_write,
     !in_snapshot,  // if we are already in snapshot world, no need to take more pointer set
     pointer,
@@ -323,7 +402,10 @@ inline ErrorCode ArrayStoragePimpl::follow_pointer(
 
 #ifndef NDEBUG
   ArrayPage* page = *out;
-  ASSERT_ND(page != nullptr);
+  ASSERT_ND(page != nullptr || tolerate_null_page);
+  if (page == nullptr) {
+    return kErrorCodeOk;
+  }
   ASSERT_ND(page->get_level() + 1U == parent->get_level());
   if (page->is_leaf()) {
     xct::XctId xct_id = page->get_leaf_record(0, get_payload_size())->owner_id_.xct_id_;
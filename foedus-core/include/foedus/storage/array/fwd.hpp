@@ -27,6 +27,8 @@ namespace storage {
 namespace array {
 struct  ArrayCommonUpdateLogType;
 struct  ArrayCreateLogType;
+class   ArrayCursor;
+struct  ArrayExtendLogType;
 struct  ArrayIncrementLogType;
 struct  ArrayMetadata;
 struct  ArrayOverwriteLogType;
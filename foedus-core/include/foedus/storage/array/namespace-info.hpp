@@ -34,8 +34,8 @@
  * Array storage allows very few data operations.
  * \li \b Reads a record or a range of records.
  * \li \b Overwrites a record.
- * \li Reads a \b range of records in batched fashion. (Not implemented so far, just loop over it.
- * This might be useful for a big array of really small records to avoid function call overheads.)
+ * \li Reads a \b range of records, one leaf page at a time, with ArrayCursor. It can also
+ * aggregate a primitive field over the range with vectorized kernels.
  *
  * In other words, the following operations are \b NOT supported.
  * \li \b Inserts or \b Deletes a record because all records always exist in an array storage
@@ -103,6 +103,13 @@ class Composer CXX11_FINAL {
     uint32_t                          log_streams_count_;
     /** Working memory to be used in this method. Automatically expand if needed. */
     memory::AlignedMemory*            work_memory_;
+    /**
+     * Memory the caller keeps across storages and snapshots so that a composer doesn't allocate
+     * its large working buffer for each compose(). A composer may take it over (eg
+     * HashTmpBin::steal_memory()), but must give it back before returning.
+     * Might be null. Empty until some composer gives back its memory.
+     */
+    memory::AlignedMemory*            reusable_memory_;
     /**
      * All log entries in this inputs are assured to be after this epoch.
      * Also, it is assured to be within 2^16 from this epoch.
@@ -203,6 +210,17 @@ class Composer CXX11_FINAL {
     bool  padding_[3];
   };
 
+  /**
+   * @brief Prepares drop_volatiles() while transactions are still running.
+   * @details
+   * The snapshot calls this for each storage it modified, right before pausing transactions
+   * for drop_volatiles(). Most storages have nothing to do here. A storage that needs heavy
+   * work to install the new snapshot does the bulk of it here so that the pause stays short.
+   * Concurrent transactions keep modifying volatile pages meanwhile, so drop_volatiles() must
+   * still pick up what changed since then.
+   */
+  ErrorStack prepare_drop_volatiles(const snapshot::Snapshot& new_snapshot);
+
   /**
    * @brief Drops volatile pages that have not been modified since the snapshotted epoch.
    * @details
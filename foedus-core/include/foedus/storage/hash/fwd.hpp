@@ -29,12 +29,18 @@ struct  ComposedBins;
 struct  ComposedBinsBuffer;
 struct  ComposedBinsMergedStream;
 struct  DataPageBloomFilter;
+struct  DefragBin;
 struct  HashCombo;
 class   HashComposer;
 struct  HashComposedBinsPage;
 struct  HashCreateLogType;
+class   HashCursor;
+struct  HashDefragStatistics;
 class   HashDataPage;
 struct  HashDeleteLogType;
+class   HashHotDirectoryPage;
+class   HashHotDirectoryRootPage;
+struct  HashIncrementLogType;
 struct  HashInsertLogType;
 class   HashIntermediatePage;
 class   HashPartitioner;
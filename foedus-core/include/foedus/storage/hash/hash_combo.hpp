@@ -51,6 +51,8 @@ struct HashCombo {
   BloomFilterFingerprint  fingerprint_;
   IntermediateRoute       route_;
 
+  /** Leaves everything uninitialized. Only for arrays of combos, such as in batched lookups. */
+  HashCombo() {}
   HashCombo(const void* key, uint16_t key_length, const HashMetadata& meta);
 
   friend std::ostream& operator<<(std::ostream& o, const HashCombo& v);
@@ -54,6 +54,24 @@ namespace hash {
  * @section HASH_COMPOSE_RESULTS HashRootInfoPage as the results
  * @copydetails foedus::storage::hash::HashRootInfoPage
  *
+ * @section HASH_COMPOSE_RESIZE Resizing snapshot
+ * When HashStorage::request_resize() is pending, the snapshot writes out the storage with the
+ * requested number of bins while transactions keep using the current bins.
+ * The logs and the previous snapshot are still in the current layout, and each of their bins
+ * is a contiguous range of 2^k bins in the new layout. So, compose() reads bins exactly as usual
+ * and just writes each of them out as 2^k bins. The difference is that it must rewrite \e all
+ * bins of the previous snapshot, so the partitioner sends all logs to one reducer.
+ * construct_root() then builds a new root page from scratch.
+ *
+ * Records modified after the snapshot epoch exist only in the volatile pages of the current
+ * layout, so they must be carried to the volatile pages of the new layout. This is done in two
+ * steps to keep the pause of transactions short:
+ *  \li prepare_drop_volatiles(), before the pause: builds a volatile tree of the new layout
+ * on the new snapshot, splitting each old bin with newer records into its 2^k new bins in
+ * one pass. Transactions keep running, so it copies records optimistically.
+ *  \li drop_root_volatile(), in the pause: repeats the same only for records modified since
+ * the first step began, which touches few bins, then switches the root pointer.
+ *
  * @note
  * This is a private implementation-details of \ref HASH, thus file name ends with _impl.
  * Do not include this header from a client program. There is no case client program needs to
@@ -69,6 +87,7 @@ class HashComposer final {
   ErrorStack construct_root(const Composer::ConstructRootArguments& args);
 
 
+  ErrorStack            prepare_drop_volatiles(const snapshot::Snapshot& new_snapshot);
   Composer::DropResult  drop_volatiles(const Composer::DropVolatilesArguments& args);
   void                  drop_root_volatile(const Composer::DropVolatilesArguments& args);
 
@@ -111,10 +130,14 @@ class HashComposer final {
     const Composer::DropVolatilesArguments& args,
     DualPagePointer* child_pointer,
     uint8_t parent_level,
+    cache::SnapshotFileSet* fileset,
+    HashIntermediatePage* io_page,
     Composer::DropResult *result);
   Composer::DropResult drop_volatiles_recurse(
     const Composer::DropVolatilesArguments& args,
-    DualPagePointer* pointer);
+    DualPagePointer* pointer,
+    cache::SnapshotFileSet* fileset,
+    HashIntermediatePage* io_page);
 
   /**
    * @returns if the given bin data pages contain any information later than the given
@@ -132,6 +155,57 @@ class HashComposer final {
   void drop_all_recurse(
     const Composer::DropVolatilesArguments& args,
     DualPagePointer* pointer);
+
+  /** Working memory to move records from the old layout to the new layout. */
+  struct ResizeContext;
+  /**
+   * Used only from prepare_drop_volatiles after a resizing snapshot.
+   * Builds a volatile tree of the new layout on the new snapshot, moving records modified after
+   * the snapshot epoch to the new bins, while transactions keep modifying the old one.
+   * @see HASH_COMPOSE_RESIZE
+   */
+  ErrorStack prepare_resized_volatiles(const snapshot::Snapshot& new_snapshot);
+  /**
+   * Used only from drop_root_volatile after a resizing snapshot.
+   * Moves records modified since prepare_resized_volatiles(), drops all volatile pages of the
+   * old layout, then switches the storage to the new layout.
+   * @see HASH_COMPOSE_RESIZE
+   */
+  ErrorStack switch_to_resized_snapshot(const Composer::DropVolatilesArguments& args);
+  /** Visits volatile pages in the old layout to move records newer than the given epoch. */
+  ErrorStack move_newer_records_recurse(
+    ResizeContext* context,
+    HashIntermediatePage* old_page,
+    Epoch since);
+  /**
+   * Moves records newer than the given epoch from a bin in the old layout. This reads the bin
+   * only once, collecting the records for all of its 2^k bins in the new layout.
+   */
+  ErrorStack move_newer_records_bin(
+    ResizeContext* context,
+    VolatilePagePointer old_head,
+    Epoch since);
+  /**
+   * Rebuilds a bin in the new layout, applying records collected from the old layout
+   * (ResizeContext::groups_ in [group_begin, group_end)) to its current volatile pages if any,
+   * otherwise to its pages in the new snapshot.
+   */
+  ErrorStack rebuild_new_bin(
+    ResizeContext* context,
+    HashBin bin,
+    uint16_t numa_node,
+    uint32_t group_begin,
+    uint32_t group_end);
+  /**
+   * Makes sure the new volatile tree has volatile intermediate pages down to the given bin.
+   * @param[out] out the level-0 volatile page that contains the bin.
+   */
+  ErrorStack volatilize_path_to_bin(
+    HashIntermediatePage* root,
+    HashBin bin,
+    uint16_t numa_node,
+    cache::SnapshotFileSet* fileset,
+    HashIntermediatePage** out);
 };
 
 /**
@@ -146,19 +220,35 @@ class HashComposeContext {
     snapshot::MergeSort*              merge_sort,
     snapshot::SnapshotWriter*         snapshot_writer,
     cache::SnapshotFileSet*           previous_snapshot_files,
+    memory::AlignedMemory*            reusable_memory,
     Page*                             root_info_page);
+  /** Gives back the memory of cur_bin_table_ to reusable_memory_ if it is given. */
+  ~HashComposeContext();
 
   ErrorStack execute();
 
  private:
+  enum Constants {
+    /** Max number of previous-snapshot data pages we read in one I/O. */
+    kReadAheadPages = 32,
+  };
+
   /**
    * Apply the range of logs that are all of cur_bin_ in a tight loop.
-   * Well, the implementation of this method is not so batched so far, but it can be later.
+   * Logs are fetched a few at a time, and we prefetch their buckets in cur_bin_table_
+   * before applying them.
    */
   ErrorCode apply_batch(uint64_t cur, uint64_t next);
 
   ErrorStack finalize();
 
+  /**
+   * In resizing_ mode, opens and closes every bin of the previous snapshot before the given bin
+   * that we haven't visited yet. Otherwise does nothing.
+   * @pre cur_bin_ == kCurBinNotOpened
+   */
+  ErrorStack rewrite_unvisited_bins(HashBin upto);
+
   /** dump everything in main buffer (intermediate pages are kept) */
   ErrorCode dump_data_pages();
 
@@ -213,12 +303,33 @@ class HashComposeContext {
    * @post cur_bin_ == kCurBinNotOpened
    */
   ErrorStack              close_cur_bin();
+  /**
+   * Writes out records in cur_bin_table_ that belong to the given bin of the new snapshot.
+   * Unless resizing_, the bin is cur_bin_ itself, and all records belong to it.
+   * In resizing_ mode, a bin without any live record is skipped.
+   */
+  ErrorCode               write_out_bin(HashBin bin);
   /**
    * Loads data pages in previous snapshot and initializes cur_bin_table_ with the existing records.
    * @pre cur_bin_ == kCurBinNotOpened
    * @post cur_bin_ == bin
    */
   ErrorStack              open_cur_bin(HashBin bin);
+  /**
+   * Returns the data page of the given page ID in previous snapshot, reading it if it's not
+   * in the read-ahead window.
+   * When we read, we also read the following pages up to the head page of the furthest bin
+   * we will open soon (bins before read_ahead_upto_ in cur_path_[0]) in the same I/O.
+   * Consecutive bins are mostly consecutive pages in the snapshot file, so this turns many
+   * one-page reads into a few sequential reads.
+   * @param[in] bin The bin we are opening. We look ahead from the next bin.
+   * @param[in] page_id Page ID of a data page of the bin in previous snapshot
+   * @param[out] out the page, which is valid until the next call of this method
+   */
+  ErrorCode               read_previous_data_page(
+    HashBin bin,
+    SnapshotPagePointer page_id,
+    HashDataPage** out);
 
   ///////////////////////////////////////////////////////////////
   //// HashComposedBinsPage (intermediate) related methods
@@ -227,7 +338,7 @@ class HashComposeContext {
   ErrorStack              init_intermediates();
   /** @returns the head of linked-list for each direct child in the root page. */
   HashComposedBinsPage*   get_intermediate_head(uint8_t root_index) const {
-    ASSERT_ND(root_index < storage_.get_root_children());
+    ASSERT_ND(root_index < root_children_);
     return intermediate_base_ + root_index;
   }
   /** @returns the tail of linked-list for each direct child in the root page. */
@@ -277,6 +388,8 @@ class HashComposeContext {
   const HashStorage               storage_;
   snapshot::SnapshotWriter* const snapshot_writer_;
   cache::SnapshotFileSet*  const  previous_snapshot_files_;
+  /** Memory given by the caller to back cur_bin_table_. Might be null. */
+  memory::AlignedMemory* const    reusable_memory_;
   /** The final output of the compose() call */
   HashRootInfoPage* const         root_info_page_;
 
@@ -288,6 +401,19 @@ class HashComposeContext {
   const uint16_t                  numa_node_;
   const HashBin                   total_bin_count_;
   const SnapshotPagePointer       previous_root_page_pointer_;
+  /**
+   * Whether this snapshot grows the number of bins of the storage.
+   * In that case, levels_, bin_bits_, bin_shifts_, root_children_, and total_bin_count_ are
+   * about the new layout we write out, while the previous snapshot and the sort-keys of logs
+   * are in the current layout, which is described in the following previous_xxx_ variables.
+   * @see HASH_COMPOSE_RESIZE
+   */
+  const bool                      resizing_;
+  const uint8_t                   previous_levels_;
+  const uint8_t                   previous_bin_shifts_;
+  const HashBin                   previous_bin_count_;
+  /** Each bin in the previous layout becomes 2^split_bits_ bins. 0 unless resizing_ */
+  const uint8_t                   split_bits_;
 
   /** just because we use it frequently... */
   const memory::GlobalVolatilePageResolver& volatile_resolver_;
@@ -309,13 +435,13 @@ class HashComposeContext {
   /**
    * cur_path_[n] is invalid where n is less than this value.
    * In other words, cur_path_[n] is non-existent in previous snapshot when that is the case.
-   * If this value is levels_, even root (levels_ - 1) is invalid, meaning no previous snapshot.
+   * If this value is previous_levels_, even root is invalid, meaning no previous snapshot.
    */
   uint8_t                         cur_path_lowest_level_;
 
   /**
    * The bin range of cur_path_[cur_path_lowest_level_].
-   * If cur_path_lowest_level_ == levels_, (0,0), but this value shouldn't be used in that case.
+   * If cur_path_lowest_level_ == previous_levels_, (0,0), but this value shouldn't be used then.
    */
   HashBinRange                    cur_path_valid_range_;
 
@@ -327,14 +453,25 @@ class HashComposeContext {
    */
   HashBin                         cur_bin_;
   const HashBin                   kCurBinNotOpened = (1ULL << kHashMaxBinBits);
+  /** Used only in resizing_ mode. The smallest bin we haven't opened yet. */
+  HashBin                         next_unvisited_bin_;
 
   /**
    * Small hashtable of records being modified in cur_bin_.
    */
   HashTmpBin                      cur_bin_table_;
 
-  /** Just memory of one-page to read data pages in previous snapshot */
-  memory::AlignedMemory           data_page_io_memory_;
+  /** kReadAheadPages pages to read data pages in previous snapshot */
+  memory::AlignedMemory           read_ahead_memory_;
+  /** Page ID of the first page in read_ahead_memory_. 0 if nothing is read yet. */
+  SnapshotPagePointer             read_ahead_begin_;
+  /** Number of pages in read_ahead_memory_, which are [read_ahead_begin_, +count). */
+  uint32_t                        read_ahead_count_;
+  /**
+   * We will open only bins below this value while processing the current batch of logs,
+   * so we don't read ahead data pages of bins beyond it.
+   */
+  HashBin                         read_ahead_upto_;
 
   /**
    * Points to the HashComposedBinsPage to which we will add cur_bin_ data pages when they are done.
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#ifndef FOEDUS_STORAGE_HASH_HASH_CURSOR_HPP_
+#define FOEDUS_STORAGE_HASH_HASH_CURSOR_HPP_
+
+#include <stdint.h>
+
+#include <iosfwd>
+
+#include "foedus/assert_nd.hpp"
+#include "foedus/compiler.hpp"
+#include "foedus/cxx11.hpp"
+#include "foedus/error_code.hpp"
+#include "foedus/assorted/assorted_func.hpp"
+#include "foedus/storage/fwd.hpp"
+#include "foedus/storage/page.hpp"
+#include "foedus/storage/storage_id.hpp"
+#include "foedus/storage/hash/fwd.hpp"
+#include "foedus/storage/hash/hash_id.hpp"
+#include "foedus/storage/hash/hash_record_location.hpp"
+#include "foedus/storage/hash/hash_storage.hpp"
+#include "foedus/thread/fwd.hpp"
+#include "foedus/xct/fwd.hpp"
+#include "foedus/xct/xct_id.hpp"
+
+namespace foedus {
+namespace storage {
+namespace hash {
+/**
+ * @brief A cursor to scan all records in a range of hash bins.
+ * @ingroup HASH
+ * @details
+ * Hash storage has no key order, so the only scan is over bins. This cursor returns records
+ * in the order of bins, and in the physical order within each bin.
+ *
+ * @par Example
+ * @code{.cpp}
+ * ... (begin xct, etc)
+ * HashCursor cursor(context, storage);
+ * CHECK_ERROR_CODE(cursor.open());
+ * while (cursor.is_valid_record()) {
+ *   const char* key = cursor.get_key();
+ *   const char* payload = cursor.get_payload();
+ *   ...
+ *   CHECK_ERROR_CODE(cursor.next());
+ * }
+ * ... (commit xct, etc)
+ * @endcode
+ *
+ * @par Parallel scan
+ * get_partition_range() splits the bins into ranges for each worker. Each worker opens its
+ * own cursor on its range. The ranges are aligned to level-0 intermediate pages, so no two
+ * workers read the same intermediate page.
+ *
+ * @par Snapshot pages
+ * Bins without volatile pages are read from snapshot pages. The cursor looks ahead in the
+ * level-0 intermediate page and reads the heads of up to Thread::kMaxFindPagesBatch such bins
+ * in one find_or_read_snapshot_pages_batch() call. Consecutive bins are mostly consecutive
+ * pages in the snapshot file, so this is a large sequential read in most cases.
+ *
+ * @par Isolation level
+ * The cursor follows the isolation level of the current transaction.
+ * \li kSnapshot: reads only the latest snapshot, starting from the snapshot root page.
+ * Volatile pages are never read, so no concurrency control is needed.
+ * \li kSerializable: reads volatile pages where they exist, and snapshot pages elsewhere.
+ * Each returned (or skipped as deleted) record is added to the read-set. The tail page of each
+ * volatile bin is added to the page-version set, and a null volatile pointer we skip over is
+ * added to the pointer set. Hence, concurrent inserts into the range are caught at pre-commit.
+ * Other volatile pages we pass are also added to the page-version set as of when we entered them,
+ * because HashStorage::defrag_volatile_bins() might append copies of their records to the bin.
+ * \li kDirtyRead: same as kSerializable without any of the protections.
+ *
+ * @par Lifetime of returned pointers
+ * get_key() and get_payload() point to the page, like MasstreeCursor. They are valid only until
+ * the next call to next(). The payload of a volatile record might be concurrently modified,
+ * which kSerializable transactions will find at pre-commit.
+ */
+class HashCursor CXX11_FINAL {
+ public:
+  HashCursor(thread::Thread* context, const HashStorage& storage);
+  ~HashCursor();
+
+  thread::Thread*     get_context() const { return context_; }
+  const HashStorage&  get_storage() const { return storage_; }
+
+  /**
+   * @brief Splits all bins of the storage into ranges for a parallel scan.
+   * @param[in] storage The hash storage to scan
+   * @param[in] partition The range to return, 0 to partitions - 1.
+   * @param[in] partitions Number of ranges.
+   * @details
+   * Range boundaries are aligned to kHashIntermediatePageFanout bins except for the end of
+   * the last range. When there are fewer such units than partitions, some ranges are empty.
+   */
+  static HashBinRange get_partition_range(
+    const HashStorage& storage,
+    uint32_t partition,
+    uint32_t partitions);
+
+  /** Opens the cursor on all bins of the storage. */
+  ErrorCode open();
+  /**
+   * @brief Opens the cursor on the given range of bins and moves to its first record.
+   * @param[in] range Bins to scan. Must be within the bins of the storage.
+   */
+  ErrorCode open(const HashBinRange& range);
+
+  /** @returns whether the cursor is now on a record. false after the last record. */
+  bool      is_valid_record() const ALWAYS_INLINE { return cur_page_ != CXX11_NULLPTR; }
+
+  /** Moves on to the next record. */
+  ErrorCode next();
+
+  /** @returns the range given to open() */
+  const HashBinRange& get_range() const { return range_; }
+
+  HashBin     get_bin() const ALWAYS_INLINE {
+    ASSERT_ND(is_valid_record());
+    return cur_bin_;
+  }
+  HashValue   get_hash() const ALWAYS_INLINE {
+    ASSERT_ND(is_valid_record());
+    return hash_;
+  }
+  const char* get_key() const ALWAYS_INLINE {
+    ASSERT_ND(is_valid_record());
+    return location_.record_;
+  }
+  uint16_t    get_key_length() const ALWAYS_INLINE {
+    ASSERT_ND(is_valid_record());
+    return location_.key_length_;
+  }
+  const char* get_payload() const ALWAYS_INLINE {
+    ASSERT_ND(is_valid_record());
+    return location_.record_ + location_.get_aligned_key_length();
+  }
+  uint16_t    get_payload_length() const ALWAYS_INLINE {
+    ASSERT_ND(is_valid_record());
+    return location_.cur_payload_length_;
+  }
+  /** @returns the XID of the record as of the read. */
+  xct::XctId  get_xct_id() const ALWAYS_INLINE {
+    ASSERT_ND(is_valid_record());
+    return location_.observed_;
+  }
+
+  friend std::ostream& operator<<(std::ostream& o, const HashCursor& v);
+
+ private:
+  enum Constants {
+    /** Same as Thread::kMaxFindPagesBatch */
+    kBatchSize = 32,
+  };
+
+  /** Moves on to the first valid record at or after cur_page_/cur_slot_, or next bins. */
+  ErrorCode proceed();
+  /** Sets cur_page_ to the head page of cur_bin_, or nullptr if the bin is empty. */
+  ErrorCode open_bin();
+  /** Sets leaf_ to the level-0 intermediate page that contains cur_bin_. */
+  ErrorCode locate_leaf();
+  /** Reads snapshot head pages of bins from cur_bin_ in the current leaf_. */
+  ErrorCode read_snapshot_batch();
+  /**
+   * Moves on to the next page in the bin after checking that no record was inserted
+   * to cur_page_. Sets cur_page_ to nullptr at the end of the bin.
+   */
+  ErrorCode next_page();
+  /** Takes the status (if volatile) and the record count of cur_page_ we have just moved to. */
+  void      enter_page();
+
+  thread::Thread* const     context_;
+  xct::Xct* const           xct_;
+  HashStorage               storage_;
+  /** Whether we read only snapshot pages. True in kSnapshot isolation level. */
+  const bool                snapshot_only_;
+  /** Whether we take read-set, page-version set, and pointer set. */
+  const bool                serializable_;
+
+  HashBinRange              range_;
+
+  /// Everything below is the state of this cursor.
+
+  /** The bin we are now reading. range_.end_ when the cursor is done. */
+  HashBin                   cur_bin_;
+  /**
+   * The level-0 intermediate page that contains cur_bin_. It might be either a volatile or
+   * snapshot page. nullptr when the sub-tree doesn't exist, then leaf_range_ is the range
+   * of the sub-tree.
+   */
+  HashIntermediatePage*     leaf_;
+  HashBinRange              leaf_range_;
+
+  /** The bins [batch_range_) whose snapshot head pages are in batch_pages_. */
+  HashBinRange              batch_range_;
+  /** Snapshot head page of each bin in batch_range_. nullptr if we don't read the snapshot */
+  Page*                     batch_pages_[kBatchSize];
+
+  /** The data page we are now reading. nullptr at the end of the bin or cursor. */
+  HashDataPage*             cur_page_;
+  /** The slot we are now reading in cur_page_. */
+  DataPageSlotIndex         cur_slot_;
+  /** The record count of cur_page_ as of when we read its slots. */
+  uint16_t                  cur_record_count_;
+  /** The page status of cur_page_ as of when we entered it. Only for volatile pages. */
+  PageVersionStatus         cur_page_status_;
+  HashValue                 hash_;
+  RecordLocation            location_;
+};
+
+}  // namespace hash
+}  // namespace storage
+}  // namespace foedus
+#endif  // FOEDUS_STORAGE_HASH_HASH_CURSOR_HPP_
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#ifndef FOEDUS_STORAGE_HASH_HASH_DEFRAG_IMPL_HPP_
+#define FOEDUS_STORAGE_HASH_HASH_DEFRAG_IMPL_HPP_
+
+#include <stdint.h>
+
+#include "foedus/epoch.hpp"
+#include "foedus/error_code.hpp"
+#include "foedus/storage/storage_id.hpp"
+#include "foedus/storage/hash/fwd.hpp"
+#include "foedus/storage/hash/hash_id.hpp"
+#include "foedus/thread/fwd.hpp"
+#include "foedus/xct/sysxct_functor.hpp"
+
+namespace foedus {
+namespace storage {
+namespace hash {
+
+/**
+ * @brief A system transaction to rewrite the volatile pages of one hash bin into fewer pages.
+ * @ingroup HASH
+ * @see SYSXCT
+ * @details
+ * Records in volatile data pages are never physically removed. Deleted records stay as
+ * logically-deleted slots, and moved records leave their old slots behind. Until the snapshot
+ * drops the volatile pages, a bin with insert/delete churn thus grows a longer chain with
+ * saturated bloom filters. This sysxct copies the live records of the chain into a new chain
+ * and switches the bin to it.
+ *
+ * Locks taken in this sysxct (in order of taking):
+ * \li Page-locks of all pages in the chain. Only the tail page is contended, by inserts.
+ * \li Record-locks of all records that are not moved yet, page by page.
+ * This is the same order as ReserveRecords (page-lock of the target, then the record-lock).
+ *
+ * After taking the locks, it does the following:
+ * \li Copies records that are not moved into new pages, with their XIDs. Deleted records are
+ * dropped only if they were deleted before drop_before_. Otherwise, a new record of the same
+ * key might get a smaller XID than the deletion within the same epoch, and the log gleaner
+ * would apply the two in the wrong order. The new pages are grabbed from the node of this
+ * thread, like other page creations.
+ * \li Links the new chain after the old tail. The old pages are thus finalized.
+ * \li Marks all old records as moved. A transaction that read or wrote an old record
+ * tracks it to the copy by following the chain, just like a record moved by expansion.
+ * Dropped records have no copy. Tracking them fails and the transaction aborts, which is
+ * only conservative because the key is absent either way.
+ * \li Switches the pointer in the level-0 intermediate page to the new head.
+ * \li Marks the old pages as moved and retired, and hands them to
+ * Thread::collect_retired_volatile_page(), which returns them to the pool a few epochs later.
+ * The status change of the old pages also aborts transactions that took them in the
+ * page-version set, such as miss-searches and serializable HashCursor.
+ *
+ * This sysxct does nothing when it turns out not worth it (see is_worth_defrag()), or when
+ * the chain is too long to lock everything in one sysxct.
+ */
+struct DefragBin final : public xct::SysxctFunctor {
+  enum Constants {
+    /** We don't defragment chains longer than this. */
+    kMaxPages = 64,
+    /** We don't defragment chains with more records than this. Page locks + record locks
+     * must fit in the sysxct lock list. */
+    kMaxRecords = 900,
+  };
+
+  /** Thread context */
+  thread::Thread* const         context_;
+  /** The level-0 intermediate page that points to the bin */
+  HashIntermediatePage* const   parent_;
+  /** Index of the bin in parent_ */
+  const uint16_t                index_in_parent_;
+  /**
+   * Root pages of the hot-key directory in each node, to invalidate entries of old records.
+   * Might be null
+   */
+  HashHotDirectoryRootPage* const* directories_;
+  /** Number of elements in directories_ */
+  const uint16_t                directory_count_;
+  /** Deleted records whose XID epoch is older than this are dropped */
+  const Epoch                   drop_before_;
+
+  /** [Out] Whether this sysxct has switched the bin to a new chain */
+  bool                          out_defragmented_;
+  /** [Out] Pages in the old chain */
+  uint16_t                      out_old_pages_;
+  /** [Out] Pages in the new chain */
+  uint16_t                      out_new_pages_;
+  /** [Out] Deleted records not copied to the new chain */
+  uint16_t                      out_dropped_records_;
+
+  DefragBin(
+    thread::Thread* context,
+    HashIntermediatePage* parent,
+    uint16_t index_in_parent,
+    HashHotDirectoryRootPage* const* directories,
+    uint16_t directory_count,
+    Epoch drop_before)
+    : xct::SysxctFunctor(),
+      context_(context),
+      parent_(parent),
+      index_in_parent_(index_in_parent),
+      directories_(directories),
+      directory_count_(directory_count),
+      drop_before_(drop_before),
+      out_defragmented_(false),
+      out_old_pages_(0),
+      out_new_pages_(0),
+      out_dropped_records_(0) {
+  }
+  virtual ErrorCode run(xct::SysxctWorkspace* sysxct_workspace) override;
+
+  /**
+   * @brief Tells if the chain from the given head page is worth defragmenting.
+   * @details
+   * Yes if the remaining records fit in fewer pages, or if at least half of the records are
+   * moved or to be dropped, which makes the bloom filters useless. Without locks, this is just
+   * a hint to skip most bins cheaply. run() checks it again after locking.
+   */
+  static bool is_worth_defrag(thread::Thread* context, HashDataPage* head, Epoch drop_before);
+
+ private:
+  /** Copies the remaining records in the old pages to the new pages and links them */
+  void      build_chain(
+    uint16_t old_count,
+    HashDataPage* const* old_pages,
+    uint16_t new_count,
+    HashDataPage* const* new_pages);
+  /** Empties the hot-key directory entries that point to records in the page */
+  void      invalidate_directories(const HashDataPage* page) const;
+};
+
+}  // namespace hash
+}  // namespace storage
+}  // namespace foedus
+#endif  // FOEDUS_STORAGE_HASH_HASH_DEFRAG_IMPL_HPP_
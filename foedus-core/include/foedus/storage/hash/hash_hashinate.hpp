@@ -60,6 +60,27 @@ HashValue hashinate(const void *key, uint16_t key_length);
 template <typename T>
 HashValue hashinate(T key);
 
+/**
+ * @brief Calculates hash value of a key in a prefix-partitioned hash storage.
+ * @param[in] key Arbitrary byte array
+ * @param[in] key_length Byte length of the key
+ * @param[in] prefix_length Byte length of the key prefix, such as the tenant-ID of a composite
+ * key. If the key is shorter than this, the whole key is the prefix.
+ * @param[in] prefix_bits How many most significant bits come from the prefix.
+ * @ingroup HASH
+ * @details
+ * The most significant prefix_bits bits are those of the hash value of the prefix, and the
+ * remaining bits are those of hashinate(key, key_length). As bins are decided by the most
+ * significant bits, keys of the same prefix fall into consecutive bins.
+ * Same as hashinate(key, key_length) if prefix_length or prefix_bits is 0.
+ * @see HashMetadata::prefix_length_
+ */
+HashValue hashinate_prefixed(
+  const void *key,
+  uint16_t key_length,
+  uint16_t prefix_length,
+  uint8_t prefix_bits);
+
 /**
  * @brief Byte size of bloom filter in each HashDataPage.
  * @ingroup HASH
@@ -96,6 +117,34 @@ const HashValue kHashDataPageBloomFilterIndexMask = (1U << kHashDataPageBloomFil
  */
 const uint8_t kHashDataPageBloomFilterHashes = 3;
 
+/**
+ * @brief Maximum value of HashMetadata::prefix_bits_.
+ * @ingroup HASH
+ * @details
+ * The remaining bits always come from the full key, which includes all bits used for the
+ * bloom filter fingerprint. Otherwise keys of the same prefix would share their fingerprints.
+ */
+const uint8_t kHashMaxPrefixBits
+  = 64U - kHashDataPageBloomFilterHashes * kHashDataPageBloomFilterIndexSize;
+
+/**
+ * @brief Bits of a hash value that are always the same as hashinate(key, key_length)
+ * whether the storage is prefix-partitioned or not.
+ * @ingroup HASH
+ */
+const HashValue kHashFullKeyBitsMask = (1ULL << (64U - kHashMaxPrefixBits)) - 1ULL;
+
+/**
+ * @brief Tells if the hash value might be that of the key in some hash storage.
+ * @ingroup HASH
+ * @details
+ * Without the metadata, we can check only the bits that never come from the key prefix.
+ * Only for assertions.
+ */
+inline bool is_hash_of_key(HashValue hash, const void *key, uint16_t key_length) {
+  return ((hash ^ hashinate(key, key_length)) & kHashFullKeyBitsMask) == 0;
+}
+
 /**
  * @brief A fingerprint for bloom filter in each HashDataPage.
  * @ingroup HASH
@@ -148,17 +197,21 @@ struct DataPageBloomFilter CXX11_FINAL {
     std::memset(values_, 0, sizeof(values_));
   }
 
-  /** @return whether this page \e might contain the fingerprint */
+  /**
+   * @return whether this page \e might contain the fingerprint
+   * @details
+   * Branch-free. We AND all bits rather than returning at the first zero bit, so that the
+   * CPU issues the loads together and doesn't mispredict on the result of each bit.
+   */
   inline bool contains(const BloomFilterFingerprint& fingerprint) const ALWAYS_INLINE {
+    uint32_t result = 1U;
     for (uint8_t k = 0; k < kHashDataPageBloomFilterHashes; ++k) {
       ASSERT_ND(fingerprint.indexes_[k] < kHashDataPageBloomFilterBits);
-      uint8_t byte_index = fingerprint.indexes_[k] / 8U;
+      uint16_t byte_index = fingerprint.indexes_[k] / 8U;
       uint8_t bit_index = fingerprint.indexes_[k] % 8U;
-      if ((values_[byte_index] & (1U << bit_index)) == 0) {
-        return false;
-      }
+      result &= values_[byte_index] >> bit_index;
     }
-    return true;
+    return result & 1U;
   }
 
   /** Adds the fingerprint to this bloom filter. This must be called with page lock */
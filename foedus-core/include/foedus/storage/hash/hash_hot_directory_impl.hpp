@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#ifndef FOEDUS_STORAGE_HASH_HASH_HOT_DIRECTORY_IMPL_HPP_
+#define FOEDUS_STORAGE_HASH_HASH_HOT_DIRECTORY_IMPL_HPP_
+
+#include <stdint.h>
+
+#include <iosfwd>
+
+#include "foedus/assert_nd.hpp"
+#include "foedus/compiler.hpp"
+#include "foedus/assorted/cacheline.hpp"
+#include "foedus/storage/page.hpp"
+#include "foedus/storage/storage_id.hpp"
+#include "foedus/storage/hash/fwd.hpp"
+#include "foedus/storage/hash/hash_id.hpp"
+
+namespace foedus {
+namespace storage {
+namespace hash {
+
+/**
+ * @brief A page of the volatile directory that maps the full hash value of hot keys directly to
+ * their slots in volatile data pages.
+ * @ingroup HASH
+ * @details
+ * A lookup in hash storage follows the root page, intermediate pages, and then the data pages
+ * of the bin, which are several dependent cache misses. When a small set of keys receives most
+ * of the accesses, this directory lets us skip all of them for those keys.
+ *
+ * @par Enabling
+ * The directory is optional and per-storage. HashMetadata::hot_directory_ is the number of
+ * directory pages per NUMA node. Each node has its own directory, grabbed from its volatile page
+ * pool so that lookups never go to a remote node. Each replica is filled by the accesses from
+ * its own node. HashHotDirectoryRootPage lists the directory pages of a node.
+ *
+ * @par Structure
+ * Each page has kBuckets buckets. Each bucket is one cacheline of kWays entries, so a lookup
+ * reads only one cacheline in the directory page. The page and the bucket in it are chosen by
+ * low bits of the hash value (bins use high bits). See get_page_index().
+ * When a bucket is full, a random entry is replaced. In other words, this is a lossy cache,
+ * not an index. A key not in the directory is just located as usual.
+ *
+ * @par Admission
+ * A record found in a volatile page is added when the page is hot according to its
+ * PageHeader::hotness_ and the hot-threshold of the transaction (Thread::is_hot_page()).
+ *
+ * @par Concurrency
+ * Entries are read and written without locks. An entry might be torn or stale, so the caller
+ * must always verify the slot it points to (a data page that is not moved, same storage, bin,
+ * hash, and key, and the record not moved) before using it. Records in volatile data pages
+ * never move to another slot except by setting the moved bit. The pages are freed while
+ * transactions are paused to drop volatile pages, when we clear all directories, or a few
+ * epochs after DefragBin retires them, when the page might be reused for anything. DefragBin
+ * marks the page as moved and invalidates entries to its records, but an entry might be
+ * admitted again by a concurrent reader, hence the verification of the page itself.
+ * A verified entry always points to the one and only non-moved record of the key.
+ */
+class HashHotDirectoryPage final {
+ public:
+  enum Constants {
+    /** Entries per bucket. */
+    kWays = 4,
+    /** Buckets in a page. The first cacheline is for the header. */
+    kBuckets = (kPageSize - assorted::kCachelineSize) / assorted::kCachelineSize,
+  };
+
+  /** One entry. location_ == 0 means empty. */
+  struct Entry {
+    HashValue hash_;
+    /** VolatilePagePointer of the data page in lower 48 bits, slot index in higher 16 bits. */
+    uint64_t  location_;
+  };
+  /** One cacheline of entries. */
+  struct Bucket {
+    Entry     entries_[kWays];
+  };
+
+  // No instantiation. Always reinterpret-cast from a volatile page.
+  HashHotDirectoryPage() = delete;
+  HashHotDirectoryPage(const HashHotDirectoryPage& other) = delete;
+  HashHotDirectoryPage& operator=(const HashHotDirectoryPage& other) = delete;
+
+  void initialize_volatile_page(StorageId storage_id, VolatilePagePointer page_id);
+  /** Empties all entries. Used while no transaction is running. */
+  void clear();
+
+  PageHeader&         header() { return header_; }
+  const PageHeader&   header() const { return header_; }
+
+  static uint64_t     to_location(VolatilePagePointer page, DataPageSlotIndex index) {
+    ASSERT_ND(page.word < (1ULL << 48));
+    ASSERT_ND(!page.is_null());
+    return (static_cast<uint64_t>(index) << 48) | page.word;
+  }
+  static VolatilePagePointer extract_page(uint64_t location) {
+    return construct_volatile_page_pointer(location & ((1ULL << 48) - 1ULL));
+  }
+  static DataPageSlotIndex   extract_index(uint64_t location) {
+    return static_cast<DataPageSlotIndex>(location >> 48);
+  }
+
+  /**
+   * @returns which of the directory pages of a node holds the entry of the given hash value.
+   * The bucket in the page is the lower bits modulo kBuckets, so we use the bits above it.
+   */
+  static uint16_t     get_page_index(HashValue hash, uint16_t page_count) ALWAYS_INLINE {
+    ASSERT_ND(page_count > 0);
+    return static_cast<uint16_t>(((hash & 0xFFFFFFFFULL) / kBuckets) % page_count);
+  }
+
+  /**
+   * @returns the location of the given hash value, or 0 if not in the directory.
+   * The result is just a hint. See the class comment.
+   */
+  uint64_t  lookup(HashValue hash) const ALWAYS_INLINE {
+    const Bucket& bucket = buckets_[get_bucket_index(hash)];
+    for (uint16_t i = 0; i < kWays; ++i) {
+      const uint64_t location = bucket.entries_[i].location_;
+      if (location != 0 && bucket.entries_[i].hash_ == hash) {
+        return location;
+      }
+    }
+    return 0;
+  }
+  /**
+   * Adds or updates the entry of the given hash value.
+   * @param[in] victim_rnd a random value to choose the entry to replace when the bucket is full
+   */
+  void      admit(HashValue hash, uint64_t location, uint32_t victim_rnd);
+  /** Empties the entry of the given hash value if it still has the given location. */
+  void      invalidate(HashValue hash, uint64_t location);
+
+  /** @returns the number of non-empty entries. Only for debugging and testing. */
+  uint32_t  count_entries() const;
+
+  friend std::ostream& operator<<(std::ostream& o, const HashHotDirectoryPage& v);
+
+ private:
+  static uint16_t get_bucket_index(HashValue hash) ALWAYS_INLINE {
+    return static_cast<uint16_t>((hash & 0xFFFFFFFFULL) % kBuckets);
+  }
+
+  PageHeader  header_;
+  char        header_pad_[assorted::kCachelineSize - sizeof(PageHeader)];
+  Bucket      buckets_[kBuckets];
+};
+
+static_assert(
+  sizeof(HashHotDirectoryPage::Bucket) == assorted::kCachelineSize,
+  "incorrect sizeof(HashHotDirectoryPage::Bucket)");
+static_assert(sizeof(HashHotDirectoryPage) == kPageSize, "incorrect sizeof(HashHotDirectoryPage)");
+
+/**
+ * @brief Lists the HashHotDirectoryPage that make up the hot-key directory of a NUMA node.
+ * @ingroup HASH
+ * @details
+ * One HashHotDirectoryPage holds only kBuckets * kWays entries, which is too few for
+ * a large storage. So, each node has HashMetadata::hot_directory_ directory pages, and this page
+ * points to them. All of them are grabbed from the node's volatile pool when the storage is
+ * created or loaded, and they never change until it is dropped. Hence, the pointers here are
+ * read without any synchronization, and the cachelines of this page stay in the CPU cache
+ * as long as the directory is used.
+ */
+class HashHotDirectoryRootPage final {
+ public:
+  enum Constants {
+    /** Max number of directory pages in a node. The first cacheline is for the header. */
+    kMaxPages = (kPageSize - assorted::kCachelineSize) / sizeof(VolatilePagePointer),
+  };
+
+  // No instantiation. Always reinterpret-cast from a volatile page.
+  HashHotDirectoryRootPage() = delete;
+  HashHotDirectoryRootPage(const HashHotDirectoryRootPage& other) = delete;
+  HashHotDirectoryRootPage& operator=(const HashHotDirectoryRootPage& other) = delete;
+
+  void initialize_volatile_page(StorageId storage_id, VolatilePagePointer page_id);
+
+  PageHeader&         header() { return header_; }
+  const PageHeader&   header() const { return header_; }
+
+  uint16_t            get_page_count() const { return page_count_; }
+  VolatilePagePointer get_page(uint16_t index) const {
+    ASSERT_ND(index < page_count_);
+    return pages_[index];
+  }
+  /** Adds a directory page. Used only while the directory is being created. */
+  void                append_page(VolatilePagePointer page) {
+    ASSERT_ND(page_count_ < kMaxPages);
+    pages_[page_count_] = page;
+    ++page_count_;
+  }
+
+  /** @returns the directory page that holds the entry of the given hash value */
+  VolatilePagePointer get_page_for(HashValue hash) const ALWAYS_INLINE {
+    return pages_[HashHotDirectoryPage::get_page_index(hash, page_count_)];
+  }
+
+  friend std::ostream& operator<<(std::ostream& o, const HashHotDirectoryRootPage& v);
+
+ private:
+  PageHeader          header_;
+  uint16_t            page_count_;
+  char                header_pad_[
+    assorted::kCachelineSize - sizeof(PageHeader) - sizeof(uint16_t)];
+  VolatilePagePointer pages_[kMaxPages];
+};
+
+static_assert(
+  sizeof(HashHotDirectoryRootPage) == kPageSize,
+  "incorrect sizeof(HashHotDirectoryRootPage)");
+static_assert(
+  HashHotDirectoryRootPage::kMaxPages >= 255U,
+  "HashMetadata::hot_directory_ might not fit in HashHotDirectoryRootPage");
+
+}  // namespace hash
+}  // namespace storage
+}  // namespace foedus
+#endif  // FOEDUS_STORAGE_HASH_HASH_HOT_DIRECTORY_IMPL_HPP_
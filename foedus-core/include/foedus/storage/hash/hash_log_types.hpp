@@ -119,7 +119,7 @@ struct HashCommonLogType : public log::RecordLogType {
     payload_count_ = payload_count;
     bin_bits_ = bin_bits;
     reserved_ = 0;
-    ASSERT_ND(hash == hashinate(key, key_length));
+    ASSERT_ND(is_hash_of_key(hash, key, key_length));
     hash_ = hash;
 
     std::memcpy(aligned_data_, key, key_length);
@@ -141,7 +141,7 @@ struct HashCommonLogType : public log::RecordLogType {
 #ifndef NDEBUG
   void assert_record_and_log_keys(xct::RwLockableXctId* owner_id, const char* data) const {
     const char* log_key = get_key();
-    ASSERT_ND(hash_ == hashinate(log_key, key_length_));
+    ASSERT_ND(is_hash_of_key(hash_, log_key, key_length_));
     uint16_t log_key_length_aligned = get_key_length_aligned();
 
     // In HashDataPage::Slot, offset_ etc comes after owner_id. Let's do sanity checks.
@@ -163,8 +163,9 @@ struct HashCommonLogType : public log::RecordLogType {
     ASSERT_ND(header_.log_type_code_ == log::kLogCodeHashOverwrite
       || header_.log_type_code_ == log::kLogCodeHashInsert
       || header_.log_type_code_ == log::kLogCodeHashDelete
-      || header_.log_type_code_ == log::kLogCodeHashUpdate);
-    ASSERT_ND(hash_ == hashinate(get_key(), key_length_));
+      || header_.log_type_code_ == log::kLogCodeHashUpdate
+      || header_.log_type_code_ == log::kLogCodeHashIncrement);
+    ASSERT_ND(is_hash_of_key(hash_, get_key(), key_length_));
   }
 
   /**
@@ -180,8 +181,8 @@ struct HashCommonLogType : public log::RecordLogType {
     const HashCommonLogType* right) ALWAYS_INLINE {
     ASSERT_ND(left->header_.storage_id_ == right->header_.storage_id_);
     ASSERT_ND(left->bin_bits_ == right->bin_bits_);
-    ASSERT_ND(left->hash_ == hashinate(left->get_key(), left->key_length_));
-    ASSERT_ND(right->hash_ == hashinate(right->get_key(), right->key_length_));
+    ASSERT_ND(is_hash_of_key(left->hash_, left->get_key(), left->key_length_));
+    ASSERT_ND(is_hash_of_key(right->hash_, right->get_key(), right->key_length_));
     if (left == right) {
       return 0;
     }
@@ -431,6 +432,179 @@ struct HashOverwriteLogType : public HashCommonLogType {
   friend std::ostream& operator<<(std::ostream& o, const HashOverwriteLogType& v);
 };
 
+/**
+ * @brief Log type of hash-storage's increment operation.
+ * @ingroup HASH LOGTYPE
+ * @details
+ * This is similar to overwrite, but different in a sense that this can do value-increment
+ * without relying on the current value, like ArrayIncrementLogType.
+ * The addendum is stored as an 8-byte payload in the common layout, and its type is in
+ * reserved_. Unlike overwrite, payload_count_ is always 8 and does not tell the size of the
+ * incremented value. Use get_value_type() instead.
+ */
+struct HashIncrementLogType : public HashCommonLogType {
+  LOG_TYPE_NO_CONSTRUCT(HashIncrementLogType)
+
+  static uint16_t calculate_log_length(uint16_t key_length) ALWAYS_INLINE {
+    return HashCommonLogType::calculate_log_length(key_length, sizeof(uint64_t));
+  }
+
+  template <typename T>
+  void            populate(
+    StorageId   storage_id,
+    const void* key,
+    uint16_t    key_length,
+    uint8_t     bin_bits,
+    HashValue   hash,
+    T           addendum,
+    uint16_t    payload_offset) {
+    log::LogCode type = log::kLogCodeHashIncrement;
+    uint64_t addendum_64 = 0;
+    std::memcpy(&addendum_64, &addendum, sizeof(T));
+    populate_base(
+      type,
+      storage_id,
+      key,
+      key_length,
+      bin_bits,
+      hash,
+      &addendum_64,
+      payload_offset,
+      sizeof(addendum_64));
+    reserved_ = to_value_type<T>();
+  }
+
+  ValueType       get_value_type() const ALWAYS_INLINE { return static_cast<ValueType>(reserved_); }
+  void*           get_addendum() { return ASSUME_ALIGNED(get_payload(), 8U); }
+  const void*     get_addendum() const { return ASSUME_ALIGNED(get_payload(), 8U); }
+
+  /** @returns the byte size of the incremented value in the record */
+  static uint16_t get_value_size(ValueType type) ALWAYS_INLINE {
+    switch (type) {
+      case kI8:
+      case kU8:
+      case kBool:
+        return 1U;
+      case kI16:
+      case kU16:
+        return 2U;
+      case kI32:
+      case kU32:
+      case kFloat:
+        return 4U;
+      default:
+        return 8U;
+    }
+  }
+
+  /** Adds the addendum of the given type to the destination. */
+  static void     add_value(ValueType type, void* destination, const void* addendum) ALWAYS_INLINE {
+    switch (type) {
+      case kI8:
+        add_typed<int8_t>(destination, addendum);
+        break;
+      case kI16:
+        add_typed<int16_t>(destination, addendum);
+        break;
+      case kI32:
+        add_typed<int32_t>(destination, addendum);
+        break;
+      case kBool:
+      case kU8:
+        add_typed<uint8_t>(destination, addendum);
+        break;
+      case kU16:
+        add_typed<uint16_t>(destination, addendum);
+        break;
+      case kU32:
+        add_typed<uint32_t>(destination, addendum);
+        break;
+      case kFloat:
+        add_typed<float>(destination, addendum);
+        break;
+      case kI64:
+        add_typed<int64_t>(destination, addendum);
+        break;
+      case kU64:
+        add_typed<uint64_t>(destination, addendum);
+        break;
+      case kDouble:
+        add_typed<double>(destination, addendum);
+        break;
+      default:
+        ASSERT_ND(false);
+        break;
+    }
+  }
+
+  void            apply_record(
+    thread::Thread* /*context*/,
+    StorageId /*storage_id*/,
+    xct::RwLockableXctId* owner_id,
+    char* data) const ALWAYS_INLINE {
+    ASSERT_ND(!owner_id->xct_id_.is_deleted());
+    ASSERT_ND(!owner_id->xct_id_.is_next_layer());
+    ASSERT_ND(!owner_id->xct_id_.is_moved());
+    assert_record_and_log_keys(owner_id, data);
+
+#ifndef NDEBUG
+    uint16_t* lengthes = reinterpret_cast<uint16_t*>(owner_id + 1);
+    ASSERT_ND(payload_offset_ + get_value_size(get_value_type()) <= lengthes[3]);
+#endif  // NDEBUG
+
+    // payload_offset might not be aligned, so add_typed() goes through memcpy.
+    add_value(get_value_type(), data + get_key_length_aligned() + payload_offset_, get_addendum());
+  }
+
+  /**
+   * Whether apply_record() can be applied to the record now.
+   * HashStorage::increment_record_oneshot() takes no read-set, so the transaction checks this
+   * under the record lock at pre-commit instead.
+   */
+  bool            is_applicable(const xct::RwLockableXctId* owner_id) const ALWAYS_INLINE {
+    const uint16_t* lengthes = reinterpret_cast<const uint16_t*>(owner_id + 1);
+    return !owner_id->xct_id_.is_deleted()
+      && payload_offset_ + get_value_size(get_value_type()) <= lengthes[3];
+  }
+
+  /**
+   * A special optimization for increment logs in log gleaner.
+   * Two increment logs on the same key can be merged to reduce # of log entries.
+   * @pre header_.storage_id_ == other.header_.storage_id_
+   * @pre same key, get_value_type() and payload_offset_
+   */
+  void            merge(const HashIncrementLogType& other) ALWAYS_INLINE {
+    ASSERT_ND(header_.storage_id_ == other.header_.storage_id_);
+    ASSERT_ND(hash_ == other.hash_);
+    ASSERT_ND(reserved_ == other.reserved_);
+    ASSERT_ND(payload_offset_ == other.payload_offset_);
+    add_value(get_value_type(), get_addendum(), other.get_addendum());
+  }
+
+  void            assert_valid() ALWAYS_INLINE {
+    assert_valid_generic();
+    assert_type();
+    ASSERT_ND(header_.log_length_ == calculate_log_length(key_length_));
+    ASSERT_ND(payload_count_ == sizeof(uint64_t));
+    ASSERT_ND(get_value_type() != kUnknown);
+    ASSERT_ND(get_value_type() <= kDouble);
+    ASSERT_ND(header_.get_type() == log::kLogCodeHashIncrement);
+  }
+
+  friend std::ostream& operator<<(std::ostream& o, const HashIncrementLogType& v);
+
+ private:
+  template <typename T>
+  static void     add_typed(void* destination, const void* addendum) {
+    T value;
+    T added;
+    std::memcpy(&value, destination, sizeof(T));
+    std::memcpy(&added, addendum, sizeof(T));
+    value += added;
+    std::memcpy(destination, &value, sizeof(T));
+  }
+};
+
 }  // namespace hash
 }  // namespace storage
 }  // namespace foedus
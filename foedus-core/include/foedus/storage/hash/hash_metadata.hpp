@@ -28,6 +28,7 @@
 #include "foedus/storage/metadata.hpp"
 #include "foedus/storage/storage_id.hpp"
 #include "foedus/storage/hash/fwd.hpp"
+#include "foedus/storage/hash/hash_hashinate.hpp"
 #include "foedus/storage/hash/hash_id.hpp"
 
 namespace foedus {
@@ -39,13 +40,19 @@ namespace hash {
  */
 struct HashMetadata CXX11_FINAL : public Metadata {
   HashMetadata()
-    : Metadata(0, kHashStorage, ""), bin_bits_(kHashMinBinBits), pad1_(0), pad2_(0), pad3_(0) {}
+    : Metadata(0, kHashStorage, ""), bin_bits_(kHashMinBinBits), resize_bin_bits_(0),
+      snapshot_bin_bits_(0), hot_directory_(0), prefix_length_(0),
+      prefix_bits_(0), pad3_(0) {}
   HashMetadata(StorageId id, const StorageName& name, uint8_t bin_bits)
-    : Metadata(id, kHashStorage, name), bin_bits_(bin_bits), pad1_(0), pad2_(0), pad3_(0) {
+    : Metadata(id, kHashStorage, name), bin_bits_(bin_bits), resize_bin_bits_(0),
+      snapshot_bin_bits_(0), hot_directory_(0), prefix_length_(0),
+      prefix_bits_(0), pad3_(0) {
   }
   /** This one is for newly creating a storage. */
   HashMetadata(const StorageName& name, uint8_t bin_bits = kHashMinBinBits)
-    : Metadata(0, kHashStorage, name), bin_bits_(bin_bits), pad1_(0), pad2_(0), pad3_(0) {
+    : Metadata(0, kHashStorage, name), bin_bits_(bin_bits), resize_bin_bits_(0),
+      snapshot_bin_bits_(0), hot_directory_(0), prefix_length_(0),
+      prefix_bits_(0), pad3_(0) {
   }
 
   /**
@@ -64,6 +71,22 @@ struct HashMetadata CXX11_FINAL : public Metadata {
   uint8_t   get_bin_shifts() const { return 64U - bin_bits_; }
   HashBin   extract_bin(HashValue hash) const { return hash >> get_bin_shifts(); }
 
+  /** @returns whether hash values come partially from a key prefix. See prefix_length_. */
+  bool      is_prefix_partitioned() const { return prefix_length_ != 0 && prefix_bits_ != 0; }
+  /** @returns the hash value of the key in this storage */
+  HashValue hashinate_key(const void* key, uint16_t key_length) const {
+    return hashinate_prefixed(key, key_length, prefix_length_, prefix_bits_);
+  }
+  /**
+   * @brief Returns the bins that contain all keys of the given prefix.
+   * @param[in] prefix Key prefix of prefix_length_ bytes, such as a tenant-ID.
+   * @details
+   * Keys of the prefix are only in the returned bins, so HashCursor::open() on the range
+   * scans all of them. The range is 2^(bin_bits_ - prefix_bits_) bins.
+   * All bins if !is_prefix_partitioned().
+   */
+  HashBinRange get_prefix_bin_range(const void* prefix) const;
+
   std::string describe() const;
   friend std::ostream& operator<<(std::ostream& o, const HashMetadata& v);
 
@@ -74,10 +97,52 @@ struct HashMetadata CXX11_FINAL : public Metadata {
    */
   uint8_t   bin_bits_;
 
+  /**
+   * The bin_bits_ requested by HashStorage::request_resize(), or 0 if no resize is pending.
+   * The resize is carried out by the next snapshot that contains logs of this storage.
+   * @invariant resize_bin_bits_ == 0 || bin_bits_ < resize_bin_bits_ <= kHashMaxBinBits
+   */
+  uint8_t   resize_bin_bits_;
+  /**
+   * Non-zero only while root_snapshot_page_id_ points to a snapshot composed with a different
+   * number of bins than bin_bits_, which happens between the end of a resizing snapshot and
+   * the moment its volatile pages are switched over. load() adopts this value if it sees one.
+   */
+  uint8_t   snapshot_bin_bits_;
+
+  /**
+   * Number of hot-key directory pages per NUMA node. 0 (default) disables the directory.
+   * The directory maps hot keys directly to their records in volatile pages, skipping the
+   * intermediate pages in lookups of such keys. Each page holds up to 252 keys, so set this to
+   * about (expected number of hot keys) / 200 to leave room for collisions.
+   * The pages are grabbed from the volatile pool of each node when the storage is created or
+   * loaded, plus one page per node that lists them.
+   * @see HashHotDirectoryPage
+   */
+  uint8_t   hot_directory_;
+
+  /**
+   * Byte length of the key prefix that decides which bins the key falls into, such as the
+   * tenant-ID of (tenant-ID, ID) composite keys. 0 (default) hashes the whole key as usual.
+   * Keys shorter than this use the whole key as the prefix.
+   * Records are still matched by the full key. Only their hash values and bins change.
+   * @see hashinate_prefixed()
+   */
+  uint16_t  prefix_length_;
+  /**
+   * Number of the most significant bits of hash values that come from the key prefix.
+   * Keys of the same prefix fall into the same 2^(bin_bits_ - prefix_bits_) consecutive bins,
+   * hence the same intermediate pages, the same NUMA node of them, and the same partition in
+   * the log gleaner. This does not depend on bin_bits_, so resizing keeps them together.
+   * Ignored if prefix_length_ is 0. HashStorage creation and HashStorage::request_resize()
+   * reject the metadata unless at least one bit of the bins comes from the full key.
+   * @invariant prefix_bits_ <= kHashMaxPrefixBits
+   * @invariant !is_prefix_partitioned() || prefix_bits_ < bin_bits_
+   */
+  uint8_t   prefix_bits_;
+
   // just for valgrind when this metadata is written to file. ggr
-  uint8_t   pad1_;
-  uint16_t  pad2_;
-  uint32_t  pad3_;
+  uint8_t   pad3_;
 };
 
 struct HashMetadataSerializer CXX11_FINAL : public virtual MetadataSerializer {
@@ -368,7 +368,7 @@ class HashDataPage final {
    * or they have been moved.
    * @return index of the slot that has the key. kSlotNotFound if not found (including
    * the case where an exactly-matched record's TID says it's "moved").
-   * @invariant hash == hashinate(key, key_length)
+   * @invariant hash == HashMetadata::hashinate_key(key, key_length)
    * @details
    * If you have acquired record_count in a protected way (after a page lock, which you still keep)
    * then this method is an exact search. Otherwise, a concurrent thread might be now inserting,
@@ -400,7 +400,7 @@ class HashDataPage final {
     uint16_t key_length) const {
     ASSERT_ND(index < get_record_count());  // record count purely increasing
     const Slot& slot = get_slot(index);
-    ASSERT_ND(hashinate(record_from_offset(slot.offset_), slot.key_length_) == slot.hash_);
+    ASSERT_ND(is_hash_of_key(slot.hash_, record_from_offset(slot.offset_), slot.key_length_));
     // quick check first
     if (slot.hash_ != hash || slot.key_length_ != key_length) {
       return false;
@@ -495,6 +495,8 @@ inline void HashDataPage::create_record_in_snapshot(
   const void* payload = ASSUME_ALIGNED(payload_arg, 8U);
   DataPageSlotIndex index = get_record_count();
   Slot& slot = get_slot(index);
+  // the lock must be valid when this page is copied to a volatile page
+  slot.tid_.reset();
   slot.tid_.xct_id_ = xct_id;
   slot.offset_ = next_offset();
   slot.hash_ = hash;
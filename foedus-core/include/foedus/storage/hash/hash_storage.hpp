@@ -17,6 +17,8 @@
  */
 #ifndef FOEDUS_STORAGE_HASH_HASH_STORAGE_HPP_
 #define FOEDUS_STORAGE_HASH_HASH_STORAGE_HPP_
+#include <stdint.h>
+
 #include <iosfwd>
 #include <string>
 
@@ -36,6 +38,30 @@
 namespace foedus {
 namespace storage {
 namespace hash {
+/**
+ * @brief Output of HashStorage::defrag_volatile_bins().
+ * @ingroup HASH
+ */
+struct HashDefragStatistics {
+  HashDefragStatistics()
+    : examined_bins_(0),
+      defragmented_bins_(0),
+      skipped_bins_(0),
+      freed_pages_(0),
+      dropped_records_(0) {}
+
+  /** Bins that have volatile pages in the range */
+  uint64_t  examined_bins_;
+  /** Bins switched to new chains */
+  uint64_t  defragmented_bins_;
+  /** Bins that looked worth it but were not defragmented, eg because of contention */
+  uint64_t  skipped_bins_;
+  /** Old pages retired minus new pages */
+  uint64_t  freed_pages_;
+  /** Deleted records that did not survive */
+  uint64_t  dropped_records_;
+};
+
 /**
  * @brief Represents a key-value store based on a dense and regular hash.
  * @ingroup HASH
@@ -81,7 +107,8 @@ class HashStorage CXX11_FINAL : public Storage<HashStorageControlBlock> {
    * a larger slot index in the same page or somewhere in next-page linked-list.
    * Further, we keep the full key in the original place.
    * So, tracking the moved record is fairly simple and efficient.
-   * Also, no chance of cannot-track case.
+   * The only cannot-track case is a deleted record dropped by defrag_volatile_bins(),
+   * for which the transaction conservatively aborts.
    */
   xct::TrackMovedRecordResult track_moved_record(
     xct::RwLockableXctId* old_address,
@@ -90,6 +117,55 @@ class HashStorage CXX11_FINAL : public Storage<HashStorageControlBlock> {
   ErrorStack  verify_single_thread(Engine* engine);
   ErrorStack  verify_single_thread(thread::Thread* context);
 
+  /**
+   * @brief Requests to grow the number of hash bins to 2^new_bin_bits without stopping
+   * transactions.
+   * @param[in] new_bin_bits The new value of bin_bits_. Must be larger than the current one.
+   * @details
+   * This method merely records the request in the metadata and returns immediately.
+   * Transactions keep running on the current bins. The resize is carried out by the next
+   * snapshot that contains logs of this storage:
+   * \li The composer splits every bin of the previous snapshot into its 2^(new-old) child bins,
+   * merging the logs as usual. Because bins are the high bits of the hash, the child bins of
+   * a bin are contiguous, so this is a single sequential pass over the previous snapshot.
+   * \li When the snapshot drops volatile pages, which happens while accepting new transactions
+   * is paused anyway, the storage switches to the new snapshot and moves the records modified
+   * after the snapshot epoch to the new volatile bins.
+   *
+   * Until the switch, get_bin_bits() and the other layout accessors return the current values.
+   * HashCombo objects obtained before the switch must not be reused after it.
+   * The request survives restart because it is a part of the metadata.
+   */
+  ErrorStack  request_resize(uint8_t new_bin_bits);
+
+  /**
+   * @brief Rewrites volatile bins whose pages are mostly moved or deleted records into
+   * fewer pages, without stopping transactions.
+   * @param[in] context Thread to run the system transactions on
+   * @param[in] range Bins to examine. Must be within the bins of the storage.
+   * @param[out] stat What happened
+   * @details
+   * Volatile data pages only grow until the next snapshot drops them. Deleted records stay as
+   * logically deleted slots, and expanded records leave their old slots, so a bin with
+   * insert/delete churn has a longer chain with more false positives in the bloom filters.
+   * This method examines each bin in the range without locks, and runs DefragBin for bins that
+   * look worth it. Each DefragBin is a system transaction that copies the surviving records
+   * into a new chain and retires the old pages, which return to the page pool a few epochs
+   * later. Deleted records are dropped unless they were deleted in the current epoch.
+   *
+   * There is no background thread to call this method. Call it from a maintenance task,
+   * for example one proc per NUMA node, each with its own range from
+   * HashCursor::get_partition_range(). The new pages are on the node of the calling thread.
+   * Concurrent transactions that read or wrote the old records keep running. They track the
+   * moved records at pre-commit, or abort if they depended on a dropped record or the structure
+   * of the old chain.
+   * @pre !context->is_running_xct(), because the system transactions run by themselves.
+   */
+  ErrorCode   defrag_volatile_bins(
+    thread::Thread* context,
+    const HashBinRange& range,
+    HashDefragStatistics* stat);
+
   /**
    * Resets all volatile pages' temperature stat to be zero in this storage.
    * Used only in HCC-branch.
@@ -110,9 +186,6 @@ class HashStorage CXX11_FINAL : public Storage<HashStorageControlBlock> {
     uint32_t max_pages = 1024U);
 
   //// Hash table API
-  // TASK(Hideaki) Add primitive-optimized versions and increment versions.
-  // Low priority. Most costs are from page-traversal and hashinate.
-
 
   /**
    * Prepares a set of information that are used in many places, extracted from the given key.
@@ -184,6 +257,35 @@ class HashStorage CXX11_FINAL : public Storage<HashStorageControlBlock> {
     uint16_t* payload_capacity,
     bool read_only);
 
+  /**
+   * @brief Retrieves complete payloads of many keys at once.
+   * @param[in] context Thread context
+   * @param[in] batch_size Number of keys
+   * @param[in] keys keys[i] is the i-th key
+   * @param[in] key_lengths Byte size of each key
+   * @param[out] payloads Buffer to receive the payload of each key
+   * @param[in,out] payload_capacities Same as payload_capacity of get_record() for each key
+   * @param[out] results Result of each key. kErrorCodeOk, kErrorCodeStrKeyNotFound, or
+   * kErrorCodeStrTooSmallPayloadBuffer, just like get_record().
+   * @param[in] read_only Same as get_record()
+   * @return Any other error, such as a race abort. Then results are undefined.
+   * @details
+   * Same as get_record() for each key, but faster for multi-gets that touch many bins.
+   * We hash all keys first, then descend the intermediate pages for all keys level by level,
+   * prefetching the next page of every key before touching any of them.
+   * This overlaps the cache misses of different keys rather than serializing them.
+   * Keys are processed in chunks of HashStoragePimpl::kBatchMax.
+   */
+  ErrorCode get_record_batch(
+    thread::Thread* context,
+    uint16_t batch_size,
+    const void* const* keys,
+    const uint16_t* key_lengths,
+    void* const* payloads,
+    uint16_t* payload_capacities,
+    ErrorCode* results,
+    bool read_only);
+
   /**
    * @brief Retrieves a part of the given key in this hash storage.
    * @param[in] context Thread context
@@ -584,6 +686,58 @@ class HashStorage CXX11_FINAL : public Storage<HashStorageControlBlock> {
     const HashCombo& combo,
     PAYLOAD* value,
     uint16_t payload_offset);
+
+  /**
+   * @brief For increments without the current value, this is more efficient.
+   * @param[in] context Thread context
+   * @param[in] key Arbitrary length of key.
+   * @param[in] key_length Byte size of key.
+   * @param[in] value addendum
+   * @param[in] payload_offset We increment the value at this byte position of the record.
+   * @pre payload_offset + sizeof(PAYLOAD) must be within the record's actual payload size
+   * (returns kErrorCodeStrTooShortPayload if not)
+   * @tparam PAYLOAD primitive type of the payload. all integers and floats are allowed.
+   * @details
+   * Unlike increment_record(), this doesn't read the current value nor return the value after
+   * addition. It writes a compact HashIncrementLogType, which the log gleaner composes
+   * (and merges with other increments on the same key) without full payload images.
+   * Like ArrayStorage::increment_record_oneshot(), this takes no read-set on the record, so
+   * concurrent oneshot increments on one key don't abort each other. A hash record might be
+   * deleted or shrunk concurrently, so pre-commit instead checks that the record exists and is
+   * long enough while it holds the record lock. If the record is already missing or too short
+   * here, this falls back to a logical search, which protects the returned error as usual.
+   */
+  template <typename PAYLOAD>
+  inline ErrorCode increment_record_oneshot(
+    thread::Thread* context,
+    const void* key,
+    uint16_t key_length,
+    PAYLOAD value,
+    uint16_t payload_offset) {
+    HashCombo c(combo(key, key_length));
+    return increment_record_oneshot(context, key, key_length, c, value, payload_offset);
+  }
+
+  /** Overlord to receive key as a primitive type. */
+  template <typename KEY, typename PAYLOAD>
+  inline ErrorCode increment_record_oneshot(
+    thread::Thread* context,
+    KEY key,
+    PAYLOAD value,
+    uint16_t payload_offset) {
+    HashCombo c(combo<KEY>(&key));
+    return increment_record_oneshot(context, &key, sizeof(key), c, value, payload_offset);
+  }
+
+  /** If you have already computed HashCombo, use this. */
+  template <typename PAYLOAD>
+  ErrorCode       increment_record_oneshot(
+    thread::Thread* context,
+    const void* key,
+    uint16_t key_length,
+    const HashCombo& combo,
+    PAYLOAD value,
+    uint16_t payload_offset);
 };
 }  // namespace hash
 }  // namespace storage
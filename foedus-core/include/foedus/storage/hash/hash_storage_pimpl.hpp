@@ -25,12 +25,14 @@
 #include "foedus/attachable.hpp"
 #include "foedus/compiler.hpp"
 #include "foedus/cxx11.hpp"
+#include "foedus/epoch.hpp"
 #include "foedus/fwd.hpp"
 #include "foedus/assorted/assorted_func.hpp"
 #include "foedus/assorted/const_div.hpp"
 #include "foedus/cache/fwd.hpp"
 #include "foedus/memory/fwd.hpp"
 #include "foedus/soc/shared_memory_repo.hpp"
+#include "foedus/soc/soc_id.hpp"
 #include "foedus/storage/fwd.hpp"
 #include "foedus/storage/storage.hpp"
 #include "foedus/storage/storage_id.hpp"
@@ -80,7 +82,30 @@ struct HashStorageControlBlock final {
    * At least 1, and surely within 8 levels.
    */
   uint8_t             levels_;
-  char                padding_[7];
+  /**
+   * The bin_bits the ongoing snapshot composes this storage with, latched from
+   * HashMetadata::resize_bin_bits_ when the partitioner is designed. 0 if the ongoing snapshot
+   * does not resize this storage.
+   * @see foedus::storage::hash::HashStorage::request_resize()
+   */
+  uint8_t             composing_bin_bits_;
+  char                padding_[2];
+  /**
+   * When resized_root_ is not null, records modified after this epoch in the volatile pages of
+   * the current layout might be missing in resized_root_.
+   */
+  Epoch               resized_since_;
+  /**
+   * The volatile root page of the new layout, which HashComposer builds before the snapshot
+   * pauses transactions. Null unless the ongoing snapshot resizes this storage.
+   * @see HASH_COMPOSE_RESIZE
+   */
+  VolatilePagePointer resized_root_;
+  /**
+   * The HashHotDirectoryRootPage of each NUMA node, which lists the directory pages of the node.
+   * All null unless HashMetadata::hot_directory_. Only the first soc_count entries are used.
+   */
+  VolatilePagePointer hot_directories_[soc::kMaxSocs];
 };
 
 /**
@@ -92,6 +117,11 @@ struct HashStorageControlBlock final {
  */
 class HashStoragePimpl final : public Attachable<HashStorageControlBlock> {
  public:
+  enum Constants {
+    /** If you want more than this, you should loop. HashStorage should take care of it. */
+    kBatchMax = 32,
+  };
+
   HashStoragePimpl() : Attachable<HashStorageControlBlock>() {}
   explicit HashStoragePimpl(HashStorage* storage)
     : Attachable<HashStorageControlBlock>(
@@ -116,11 +146,32 @@ class HashStoragePimpl final : public Attachable<HashStorageControlBlock> {
   xct::TrackMovedRecordResult track_moved_record(
     xct::RwLockableXctId* old_address,
     xct::WriteXctAccess* write_set);
+  /** @see foedus::storage::hash::HashStorage::defrag_volatile_bins() */
+  ErrorCode   defrag_volatile_bins(
+    thread::Thread* context,
+    const HashBinRange& range,
+    HashDefragStatistics* stat);
+  /** Subroutine of defrag_volatile_bins() for the sub-tree of a volatile intermediate page */
+  ErrorCode   defrag_volatile_bins_recurse(
+    thread::Thread* context,
+    HashIntermediatePage* page,
+    const HashBinRange& range,
+    Epoch drop_before,
+    HashHotDirectoryRootPage* const* directories,
+    uint16_t directory_count,
+    HashDefragStatistics* stat);
+
+  /**
+   * Follows the chain from the page to find the moved record of the key.
+   * When may_be_dropped, the record was a deleted one, which DefragBin might have dropped
+   * without a copy. Then failing to find it is not an error.
+   */
   xct::TrackMovedRecordResult track_moved_record_search(
     HashDataPage* page,
     const void* key,
     uint16_t key_length,
-    const HashCombo& combo);
+    const HashCombo& combo,
+    bool may_be_dropped);
 
   /** These are defined in hash_storage_verify.cpp */
   ErrorStack  verify_single_thread(Engine* engine);
@@ -156,6 +207,31 @@ class HashStoragePimpl final : public Attachable<HashStorageControlBlock> {
   ErrorStack  create(const HashMetadata& metadata);
   ErrorStack  load(const StorageControlBlock& snapshot_block);
   ErrorStack  drop();
+  /** @see foedus::storage::hash::HashStorage::request_resize() */
+  ErrorStack  request_resize(uint8_t new_bin_bits);
+  /** Checks if partitioner_data_memory_mb_ can accomodate the given number of hash bins. */
+  ErrorStack  check_partitioner_memory(const HashMetadata& metadata) const;
+  /** Checks if prefix_bits_ is within kHashMaxPrefixBits and less than bin_bits_. */
+  ErrorStack  check_prefix_options(const HashMetadata& metadata) const;
+
+  /**
+   * Grabs and initializes the hot-key directory pages of each node if
+   * HashMetadata::hot_directory_. Releases what it grabbed if it fails.
+   */
+  ErrorCode   create_hot_directories();
+  /** Returns the hot-key directory pages to the page pools. */
+  void        release_hot_directories();
+  /**
+   * Empties the hot-key directory of every node.
+   * Must be called whenever volatile data pages of this storage are freed, while no transaction
+   * is running. Otherwise entries might point to reused pages.
+   */
+  void        clear_hot_directories();
+  /**
+   * @returns the hot-key directory page for the hash value in the node of the given thread,
+   * or nullptr if disabled
+   */
+  HashHotDirectoryPage* get_hot_directory(thread::Thread* context, HashValue hash) const;
 
   bool                exists()    const { return control_block_->exists(); }
   StorageId           get_id()    const { return control_block_->meta_.id_; }
@@ -175,6 +251,16 @@ class HashStoragePimpl final : public Attachable<HashStorageControlBlock> {
     void* payload,
     uint16_t* payload_capacity,
     bool read_only);
+  /** @see foedus::storage::hash::HashStorage::get_record_batch() */
+  ErrorCode   get_record_batch(
+    thread::Thread* context,
+    uint16_t batch_size,
+    const void* const* keys,
+    const uint16_t* key_lengths,
+    void* const* payloads,
+    uint16_t* payload_capacities,
+    ErrorCode* results,
+    bool read_only);
 
   /** @see foedus::storage::hash::HashStorage::get_record_primitive() */
   template <typename PAYLOAD>
@@ -284,6 +370,16 @@ class HashStoragePimpl final : public Attachable<HashStorageControlBlock> {
     PAYLOAD* value,
     uint16_t payload_offset);
 
+  /** @see foedus::storage::hash::HashStorage::increment_record_oneshot() */
+  template <typename PAYLOAD>
+  ErrorCode   increment_record_oneshot(
+    thread::Thread* context,
+    const void* key,
+    uint16_t key_length,
+    const HashCombo& combo,
+    PAYLOAD value,
+    uint16_t payload_offset);
+
   /**
    * Retrieves the root page of this storage.
    */
@@ -335,6 +431,25 @@ class HashStoragePimpl final : public Attachable<HashStorageControlBlock> {
     bool for_write,
     const HashCombo& combo,
     HashDataPage** bin_head);
+  /**
+   * @brief Batched version of locate_bin().
+   * @param[in] context Thread context
+   * @param[in] for_write Whether we are seeking the bins to modify
+   * @param[in] batch_size Number of combos. kBatchMax or less.
+   * @param[in] combos Hash values of the keys
+   * @param[out] bin_heads Head page of each bin, or nullptr just like locate_bin()
+   * @details
+   * All keys are at the same depth, so we descend one level at a time for all of them.
+   * Each page is prefetched one round before we touch it, so the cache misses of different
+   * keys overlap instead of stalling one after another. The returned data pages are prefetched
+   * too, both their header/bloom-filter and the last slots.
+   */
+  ErrorCode   locate_bin_batch(
+    thread::Thread* context,
+    bool for_write,
+    uint16_t batch_size,
+    const HashCombo* combos,
+    HashDataPage** bin_heads);
 
   /**
    * @brief Usually follows locate_bin to locate the exact physical record for the key, or
@@ -420,6 +535,47 @@ class HashStoragePimpl final : public Attachable<HashStorageControlBlock> {
       result);
   }
 
+  /**
+   * @brief locate_bin() + locate_record_logical() for operations that need an existing record.
+   * @param[in] context Thread context
+   * @param[in] for_write Whether we are reading these pages to modify
+   * @param[in] physical_only If true, we skip observing XID and registering readset.
+   * See locate_record().
+   * @param[in] key The searching key.
+   * @param[in] key_length Byte length of the searching key.
+   * @param[in] combo Hash values.
+   * @param[out] result Information on the found slot. Not found if the bin doesn't exist, too.
+   * @details
+   * If the storage has the hot-key directory and this is not a snapshot transaction, this first
+   * looks for the record in the directory of this node, skipping all intermediate and preceding
+   * data pages when it hits. Otherwise, this locates the record as usual, and then adds it to
+   * the directory if its page is hot.
+   * In either case, the result is protected in the same way as the usual locate_record().
+   */
+  ErrorCode   locate_existing_record(
+    thread::Thread* context,
+    bool for_write,
+    bool physical_only,
+    const void* key,
+    uint16_t key_length,
+    const HashCombo& combo,
+    RecordLocation* result);
+  /**
+   * Subroutine of locate_existing_record() to check the slot the hot-key directory points to.
+   * @param[out] hit whether the slot is the non-moved record of the key. If so, result is
+   * populated and protected as usual.
+   */
+  ErrorCode   locate_record_in_hot_directory(
+    thread::Thread* context,
+    bool for_write,
+    bool physical_only,
+    HashHotDirectoryPage* directory,
+    const void* key,
+    uint16_t key_length,
+    const HashCombo& combo,
+    RecordLocation* result,
+    bool* hit);
+
   /** Simpler version of locate_record for when we are in snapshot world. */
   ErrorCode locate_record_in_snapshot(
     thread::Thread* context,
@@ -25,7 +25,9 @@
 #include "foedus/compiler.hpp"
 #include "foedus/cxx11.hpp"
 #include "foedus/assorted/assorted_func.hpp"
+#include "foedus/assorted/cacheline.hpp"
 #include "foedus/memory/aligned_memory.hpp"
+#include "foedus/storage/storage_id.hpp"
 #include "foedus/storage/hash/fwd.hpp"
 #include "foedus/storage/hash/hash_hashinate.hpp"
 #include "foedus/storage/hash/hash_id.hpp"
@@ -213,6 +215,25 @@ class HashTmpBin CXX11_FINAL {
     return buckets_[bucket];
   }
 
+  /**
+   * Prefetches the bucket of the given hash value to hide the cache miss in the following
+   * data manipulation. The composer calls this for a batch of logs before applying them.
+   * @see prefetch_bucket_head()
+   */
+  void        prefetch_bucket(HashValue hash) const ALWAYS_INLINE {
+    assorted::prefetch_cacheline(buckets_ + extract_bucket(hash));
+  }
+  /**
+   * Prefetches the first record in the bucket of the given hash value, if any.
+   * This reads the bucket, so call it a while after prefetch_bucket() for the same hash.
+   */
+  void        prefetch_bucket_head(HashValue hash) const ALWAYS_INLINE {
+    RecordIndex head = buckets_[extract_bucket(hash)];
+    if (head) {
+      assorted::prefetch_cacheline(records_ + head);
+    }
+  }
+
   //// Data manipulation methods
 
   /**
@@ -257,6 +278,22 @@ class HashTmpBin CXX11_FINAL {
     uint16_t payload_offset,
     uint16_t payload_count);
 
+  /**
+   * @brief Adds the addendum to a primitive value in the record of the given key.
+   * @details
+   * This is the counterpart of HashIncrementLogType. Like overwrite_record(),
+   * if there is no existing record of the key, or such a record is already logically deleted,
+   * this method returns an error (kErrorCodeStrKeyNotFound). Mustn't happen either.
+   */
+  ErrorCode increment_record(
+    xct::XctId xct_id,
+    const void* key,
+    uint16_t key_length,
+    HashValue hash,
+    ValueType value_type,
+    const void* addendum,
+    uint16_t payload_offset);
+
   /**
    * @brief Updates a record of the given key with the given payload, which might change length.
    * @details
@@ -273,6 +310,22 @@ class HashTmpBin CXX11_FINAL {
     const void* payload,
     uint16_t payload_length);
 
+  /**
+   * @brief Makes the record of the given key exactly the given image, whatever it was before.
+   * @details
+   * Unlike other methods, this receives the resulting state of a record rather than an operation.
+   * The xct_id might be logically deleted, in which case we keep the record as a deleted record,
+   * even if there was no record of the key, so that the deletion can be replayed on another
+   * HashTmpBin. This is used to bring records in volatile pages into another layout of bins.
+   */
+  ErrorCode replace_record(
+    xct::XctId xct_id,
+    const void* key,
+    uint16_t key_length,
+    HashValue hash,
+    const void* payload,
+    uint16_t payload_length);
+
   friend std::ostream& operator<<(std::ostream& o, const HashTmpBin& v);
 
  private:
@@ -81,6 +81,24 @@
  * The idea is almost the same, but here the tracking is much simpler. Just follow the
  * linked list.
  *
+ * @section HASH_DEFRAG Defragmenting volatile bins
+ * As records are never physically removed from volatile data pages, a bin with many deletes
+ * or expansions keeps growing until the next snapshot drops its volatile pages.
+ * HashStorage::defrag_volatile_bins() rewrites such bins online. It copies the surviving records
+ * to a new chain after the old tail, marks the old records as moved, switches the bin, and
+ * retires the old pages (see DefragBin). In other words, it is just a bulk version of the
+ * record migration above, so transactions handle it with the same moved-bit protocol.
+ *
+ * @section HASH_PREFIX Prefix-partitioned hash storages
+ * By default, the hash value of a key is the hash of the entire key, so keys that share a
+ * logical partition, such as (tenant-ID, ID), are scattered over all bins.
+ * With HashMetadata::prefix_length_ and HashMetadata::prefix_bits_, the most significant bits of
+ * the hash value come from only the key prefix (see hashinate_prefixed()). Keys of one prefix
+ * then fall into consecutive bins, hence into the same intermediate pages, the same partition
+ * in the log gleaner, and the NUMA node of the thread that created their pages.
+ * HashMetadata::get_prefix_bin_range() gives the bins, for example to scan one tenant with
+ * HashCursor. Records are still matched by their full keys.
+ *
  * @par History note, or a tombstone
  * We initially considered a bit more fancy hash storages (namely Cuckoo Hashing), but
  * we didn't see enough benefits to justify its limitations (eg, how to structure snapshot pages
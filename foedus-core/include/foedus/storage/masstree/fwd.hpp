@@ -38,6 +38,7 @@ class   MasstreePage;
 class   MasstreePartitioner;
 struct  MasstreePartitionerData;
 struct  MasstreePartitionerInDesignData;
+struct  MasstreeResizeLogType;
 class   MasstreeStorage;
 struct  MasstreeStorageControlBlock;
 class   MasstreeStorageFactory;
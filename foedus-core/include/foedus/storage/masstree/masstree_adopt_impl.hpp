@@ -60,8 +60,7 @@ namespace masstree {
  * Locks taken in this sysxct:
  * \li Page-lock of the parent page and old page (will be retied).
  *
- * So far this sysxct adopts only one child at a time.
- * TASK(Hideaki): Probably it helps by delaying and batching several adoptions.
+ * This sysxct adopts only one child at a time. See AdoptBatch for a batched version.
  * @see SplitIntermediate
  */
 struct Adopt final : public xct::SysxctFunctor {
@@ -86,6 +85,13 @@ struct Adopt final : public xct::SysxctFunctor {
   }
   virtual ErrorCode run(xct::SysxctWorkspace* sysxct_workspace) override;
 
+  /**
+   * The main logic of this sysxct after taking the locks.
+   * AdoptBatch directly invokes this.
+   * @pre parent_ and old_ are locked
+   */
+  ErrorCode adopt_impl();
+
   ErrorCode adopt_case_a(
     uint16_t minipage_index,
     uint16_t pointer_index);
@@ -95,6 +101,60 @@ struct Adopt final : public xct::SysxctFunctor {
     uint16_t pointer_index);
 };
 
+/**
+ * @brief A system transaction to adopt foster twins of many children into their parent.
+ * @ingroup MASSTREE
+ * @see SYSXCT
+ * @see Adopt
+ * @details
+ * Adopt locks the parent page for each child. After many splits, eg during a bulk load,
+ * an intermediate page has many moved children. This sysxct locks the parent and
+ * all of the given children in one shot, then adopts them one by one with the same logic
+ * as Adopt.
+ * MasstreeStorage::adopt_foster_twins() uses this as a deferred, batched maintenance step.
+ *
+ * This stops when the parent page turns out to be moved, including the case where an
+ * adoption splits the parent. Children that turn out to be retired (already adopted) are
+ * skipped.
+ *
+ * Locks taken in this sysxct:
+ * \li Page-lock of the parent page and the old pages (will be retired).
+ */
+struct AdoptBatch final : public xct::SysxctFunctor {
+  enum Constants {
+    /** Max number of children in one sysxct */
+    kMaxBatch = 32,
+  };
+
+  /** Thread context */
+  thread::Thread* const           context_;
+  /** The parent page that currently points to the old pages */
+  MasstreeIntermediatePage* const parent_;
+  /**
+   * The old pages that were split, whose foster-twins are being adopted.
+   * @pre olds_[i]->is_moved()
+   */
+  MasstreePage* const* const      olds_;
+  /** Number of old pages. At most kMaxBatch */
+  const uint16_t                  old_count_;
+  /** [Out] Number of old pages this sysxct adopted */
+  uint16_t                        out_adopted_count_;
+
+  AdoptBatch(
+    thread::Thread* context,
+    MasstreeIntermediatePage* parent,
+    MasstreePage* const* olds,
+    uint16_t old_count)
+    : xct::SysxctFunctor(),
+      context_(context),
+      parent_(parent),
+      olds_(olds),
+      old_count_(old_count),
+      out_adopted_count_(0) {
+  }
+  virtual ErrorCode run(xct::SysxctWorkspace* sysxct_workspace) override;
+};
+
 }  // namespace masstree
 }  // namespace storage
 }  // namespace foedus
@@ -461,6 +461,17 @@ class MasstreeComposeContext {
    * This one is so-so common. Anyway this one is simple as there is no page split/merge.
    */
   ErrorStack  execute_overwrite_group(uint32_t from, uint32_t to);
+  /**
+   * execute() invokes this to process a number of contiguous resize-logs.
+   * Same as execute_update_group(), no optimization so far.
+   */
+  ErrorStack  execute_resize_group(uint32_t from, uint32_t to);
+  /**
+   * Applies a resize-log to the tail record of the last level, which must be the key of the log.
+   * If the record is physically too small for the new payload, we remove the tail record and
+   * append a new one just like update-logs.
+   */
+  void        execute_resize_tail(const MasstreeResizeLogType* entry);
 
   /** When the main buffer of writer has no page, appends a dummy page for easier debugging. */
   void        write_dummy_page_zero();
@@ -74,6 +74,20 @@ namespace masstree {
  */
 class MasstreeCursor CXX11_FINAL {
  public:
+  enum SearchType {
+    kForwardInclusive = 0,
+    kForwardExclusive,
+    kBackwardInclusive,
+    kBackwardExclusive,
+  };
+  enum KeyCompareResult {
+    kCurKeySmaller,
+    kCurKeyEquals,
+    kCurKeyLarger,
+    // the following two are only when cur key points to next layer. instead, no equals for layer
+    kCurKeyBeingsWith,
+    kCurKeyContains,
+  };
   /**
    * @brief Represents one page in the current search path from layer0-root.
    * @details
@@ -131,6 +145,14 @@ class MasstreeCursor CXX11_FINAL {
     /** only when stable_ indicates that this page is a moved page */
     MovedPageSearchStatus moved_page_search_status_;
 
+    /**
+     * Result of comparing the route prefix (slices before layer_) with the end key.
+     * Prefix slices never change while this route is in the stack, so we compare them only
+     * once in push_route(). kCurKeyEquals means we have to compare the in-layer part.
+     * Undefined if the end key is supremum.
+     */
+    KeyCompareResult end_key_prefix_compare_;
+
     /**
      * Upto which separator we are done. only for interior.
      * If forward search, we followed a pointer before this separator.
@@ -161,20 +183,6 @@ class MasstreeCursor CXX11_FINAL {
     bool    was_stably_moved() const { return stable_.is_moved(); }
     void setup_order();
   };
-  enum SearchType {
-    kForwardInclusive = 0,
-    kForwardExclusive,
-    kBackwardInclusive,
-    kBackwardExclusive,
-  };
-  enum KeyCompareResult {
-    kCurKeySmaller,
-    kCurKeyEquals,
-    kCurKeyLarger,
-    // the following two are only when cur key points to next layer. instead, no equals for layer
-    kCurKeyBeingsWith,
-    kCurKeyContains,
-  };
   enum Constants {
     kMaxRecords = kBorderPageMaxSlots,
     kMaxRoutes = kPageSize / sizeof(Route),
@@ -304,6 +312,48 @@ class MasstreeCursor CXX11_FINAL {
    */
   ErrorCode next();
 
+  /**
+   * @brief One record returned by next_batch().
+   * @details
+   * Like get_payload() etc, pointers point to the data page. They are valid until the end of
+   * the transaction, but the values might be concurrently modified. Serializability is
+   * guaranteed at commit as usual.
+   */
+  struct BatchRecord {
+    /** get_key_in_layer_slice(). The prefix slices are get_cur_route_prefix_slices(). */
+    KeySlice      slice_;
+    /** get_key_length() */
+    KeyLength     key_length_;
+    /** get_key_suffix(). Meaningful only when the key is longer than the in-layer slice. */
+    const char*   suffix_;
+    /** get_payload() */
+    const char*   payload_;
+    /** get_payload_length() */
+    PayloadLength payload_length_;
+  };
+
+  /**
+   * @brief Returns the current record and following records in one call.
+   * @param[in] max_count at most this number of records are returned
+   * @param[out] records receives the records. must be at least max_count length.
+   * @param[out] count number of records returned. 0 iff !is_valid_record() when called.
+   * @details
+   * This is equivalent to calling get_xxx() and next() max_count times, but it is meant for
+   * scans over a bounded prefix, such as time-series keys (entity, timestamp) or normalized keys.
+   * All records returned in one call share the same route prefix, so only the in-layer slice
+   * and suffix vary. Read get_cur_route_prefix_slices() \e before calling this method if you
+   * need the prefix. When the cursor moves into another prefix (next or previous layer), this
+   * method stops there and returns fewer records than max_count. The record after the last
+   * returned one becomes the current record, so you can keep calling this method while
+   * is_valid_record().
+   *
+   * Within a border page, this reads the following slots in one pass and checks the page
+   * version once for all of them, instead of going through next() for each record.
+   * It falls back to next() at page boundaries, next layers, the end slice, and when the
+   * page was split during the pass.
+   */
+  ErrorCode next_batch(uint16_t max_count, BatchRecord* records, uint16_t* count);
+
 
   ErrorCode delete_record();
 
@@ -396,6 +446,12 @@ class MasstreeCursor CXX11_FINAL {
   /** full native-endian key of current search. allocated in transaction's local work memory */
   KeySlice*   search_key_slices_;
 
+  /**
+   * Incremented whenever cur_route_prefix_slices_ changes. next_batch() uses it to detect that
+   * the cursor moved to another prefix.
+   */
+  uint32_t    route_prefix_version_;
+
   /** stable version of teh current border page as of copying cur_page_. */
   PageVersionStatus cur_page_stable_;
 
@@ -407,15 +463,31 @@ class MasstreeCursor CXX11_FINAL {
    * It takes a stable version of the page and pushes it to the routes_.
    */
   ErrorCode push_route(MasstreePage* page);
+  /**
+   * Calculates the slice range (both inclusive) this cursor might read in the page,
+   * which we protect via xct::RangeXctAccess. low > high if it reads nothing.
+   * The prefix slices up to the page's layer must be already set.
+   */
+  void      extract_route_range(const MasstreePage* page, KeySlice* low, KeySlice* high) const;
+  /** @returns whether the key has the same prefix slices as the route up to the layer */
+  bool      is_in_route_prefix(const KeySlice* key_slices, KeyLength key_length, Layer layer) const;
   /**
    * This is now a logical operation that might add lock/readset.
    * You can't use this method to "peek" cur record. Be careful!
    */
   ErrorCode fetch_cur_record_logical(MasstreeBorderPage* page, SlotIndex record);
+  /**
+   * Subroutine of next_batch(). Appends the records after the current one in the current
+   * border page, and makes the last appended record the current record.
+   * Does nothing if the current route is not a border page.
+   */
+  ErrorCode next_batch_in_page(uint16_t max_count, BatchRecord* records, uint16_t* count);
   void      check_end_key();
   bool      is_cur_key_next_layer() const { return cur_key_location_.observed_.is_next_layer(); }
   KeyCompareResult compare_cur_key_aginst_search_key(KeySlice slice, uint8_t layer) const;
   KeyCompareResult compare_cur_key_aginst_end_key() const;
+  /** Compares the route prefix up to the layer with the end key, used to set up Route. */
+  KeyCompareResult compare_route_prefix_against_end_key(Layer layer) const;
   KeyCompareResult compare_cur_key(
     KeySlice slice,
     uint8_t layer,
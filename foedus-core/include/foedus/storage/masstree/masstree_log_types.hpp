@@ -472,6 +472,77 @@ struct MasstreeOverwriteLogType : public MasstreeCommonLogType {
   friend std::ostream& operator<<(std::ostream& o, const MasstreeOverwriteLogType& v);
 };
 
+/**
+ * @brief Log type of masstree-storage's extend/truncate/replace operations.
+ * @ingroup MASSTREE LOGTYPE
+ * @details
+ * This log keeps the first payload_offset_ bytes of the payload as they are, writes
+ * payload_count_ bytes after them, and changes the payload length to
+ * payload_offset_ + payload_count_. The three operations differ only in the offset.
+ * \li extend_record(): payload_offset_ is the current payload length.
+ * \li truncate_record(): payload_offset_ is the new payload length, payload_count_ is 0.
+ * \li replace_record(): payload_offset_ is 0.
+ *
+ * Unlike MasstreeUpdateLogType, this log contains only the changed part of the payload.
+ * The record must be already spacious enough for the new payload length as of taking the
+ * write-set. Physical length never decreases, so it holds until apply_record().
+ */
+struct MasstreeResizeLogType : public MasstreeCommonLogType {
+  LOG_TYPE_NO_CONSTRUCT(MasstreeResizeLogType)
+
+  void            populate(
+    StorageId   storage_id,
+    const void* key,
+    KeyLength   key_length,
+    const void* payload,
+    PayloadLength payload_offset,
+    PayloadLength payload_count) ALWAYS_INLINE {
+    log::LogCode type = log::kLogCodeMasstreeResize;
+    ASSERT_ND(key_length > 0U);
+    ASSERT_ND(payload_offset + payload_count <= kMaxPayloadLength);
+    populate_base(type, storage_id, key, key_length, payload, payload_offset, payload_count);
+  }
+
+  /** Payload length after applying this log. */
+  PayloadLength   get_new_payload_length() const ALWAYS_INLINE {
+    return payload_offset_ + payload_count_;
+  }
+
+  void            apply_record(
+    thread::Thread* /*context*/,
+    StorageId /*storage_id*/,
+    xct::RwLockableXctId* owner_id,
+    char* data) const ALWAYS_INLINE {
+    RecordAddresses addresses = apply_record_prepare(owner_id, data);
+    ASSERT_ND(!owner_id->xct_id_.is_deleted());
+    // The offset was checked against the record as of the access. However, another resize of
+    // the same record in the same transaction might have shrunk it before this log is applied.
+    // In that case the gap is filled with zeros, just like extending with zeros.
+    const PayloadLength cur_length = *addresses.record_payload_count_;
+    if (cur_length < payload_offset_) {
+      std::memset(addresses.record_payload_ + cur_length, 0, payload_offset_ - cur_length);
+    }
+    const PayloadLength new_length = get_new_payload_length();
+    if (payload_count_ > 0U) {
+      std::memcpy(addresses.record_payload_ + payload_offset_, get_payload(), payload_count_);
+    }
+    // Keep the payload zero-padded to 8 bytes just like records made by insert/update logs.
+    const PayloadLength aligned_length = assorted::align8(new_length);
+    if (aligned_length != new_length) {
+      std::memset(addresses.record_payload_ + new_length, 0, aligned_length - new_length);
+    }
+    *addresses.record_payload_count_ = new_length;
+  }
+
+  void            assert_valid() const ALWAYS_INLINE {
+    assert_valid_generic();
+    ASSERT_ND(header_.log_length_ == calculate_log_length(key_length_, payload_count_));
+    ASSERT_ND(header_.get_type() == log::kLogCodeMasstreeResize);
+  }
+
+  friend std::ostream& operator<<(std::ostream& o, const MasstreeResizeLogType& v);
+};
+
 
 }  // namespace masstree
 }  // namespace storage
@@ -31,6 +31,7 @@
 #include "foedus/fwd.hpp"
 #include "foedus/assorted/assorted_func.hpp"
 #include "foedus/assorted/cacheline.hpp"
+#include "foedus/assorted/simd_search.hpp"
 #include "foedus/memory/fwd.hpp"
 #include "foedus/storage/page.hpp"
 #include "foedus/storage/record.hpp"
@@ -283,16 +284,14 @@ class MasstreeIntermediatePage final : public MasstreePage {
     }
     /**
     * @brief Navigates a searching key-slice to one of pointers in this mini-page.
+    * @details
+    * Separators are sorted, so this is the first separator larger than the slice.
+    * @see assorted::simd_find_first_greater()
     */
     uint8_t find_pointer(KeySlice slice) const ALWAYS_INLINE {
       uint8_t key_count = key_count_;
       ASSERT_ND(key_count <= kMaxIntermediateMiniSeparators);
-      for (uint8_t i = 0; i < key_count; ++i) {
-        if (slice < separators_[i]) {
-          return i;
-        }
-      }
-      return key_count;
+      return assorted::simd_find_first_greater(separators_, 0, key_count, slice);
     }
   };
 
@@ -308,16 +307,12 @@ class MasstreeIntermediatePage final : public MasstreePage {
 
   /**
    * @brief Navigates a searching key-slice to one of the mini pages in this page.
+   * @see MiniPage::find_pointer()
    */
   uint8_t find_minipage(KeySlice slice) const ALWAYS_INLINE {
     uint8_t key_count = get_key_count();
     ASSERT_ND(key_count <= kMaxIntermediateSeparators);
-    for (uint8_t i = 0; i < key_count; ++i) {
-      if (slice < separators_[i]) {
-        return i;
-      }
-    }
-    return key_count;
+    return assorted::simd_find_first_greater(separators_, 0, key_count, slice);
   }
   MiniPage&         get_minipage(uint8_t index) ALWAYS_INLINE { return mini_pages_[index]; }
   const MiniPage&   get_minipage(uint8_t index) const ALWAYS_INLINE { return mini_pages_[index]; }
@@ -806,6 +801,18 @@ class MasstreeBorderPage final : public MasstreePage {
     ASSERT_ND(index < kBorderPageMaxSlots);
     slices_[index] = slice;
   }
+  /**
+   * @returns the first index in [from_index, to_index) whose slice is the given slice,
+   * or to_index if not found.
+   * This is the building block of find_key() and its variants. Vectorized if the CPU allows.
+   */
+  SlotIndex find_next_slice(
+    SlotIndex from_index,
+    SlotIndex to_index,
+    KeySlice slice) const ALWAYS_INLINE {
+    ASSERT_ND(to_index <= kBorderPageMaxSlots);
+    return assorted::simd_find_first_equal(slices_, from_index, to_index, slice);
+  }
   DataOffset get_offset_in_bytes(SlotIndex index) const ALWAYS_INLINE {
     return get_slot(index)->lengthes_.components.offset_;
   }
@@ -918,6 +925,18 @@ class MasstreeBorderPage final : public MasstreePage {
    * layer pointer. Unlike set_next_layer, this shrinks the payload part.
    */
   void    replace_next_layer_snapshot(SnapshotPagePointer pointer);
+  /**
+   * Appends a record of a normalized key at the end of a volatile page that is not yet
+   * reachable from any other thread. This is used only from the bulk loader, so no race.
+   * @pre !header_.snapshot_
+   * @pre slice is larger than all slices in this page
+   * @pre can_accomodate(get_key_count(), sizeof(KeySlice), payload_count)
+   */
+  void    append_record_bulk(
+    xct::XctId initial_owner_id,
+    KeySlice slice,
+    const void* payload,
+    PayloadLength payload_count);
 
   /**
    * Copy the initial record that will be the only record for a new root page.
@@ -982,6 +1001,29 @@ class MasstreeBorderPage final : public MasstreePage {
     Engine* engine,
     xct::RwLockableXctId* old_address);
 
+  /**
+   * @brief Tells whether a record whose slice is in the range has been added to this page.
+   * @param[in] from_index we check records from this index. The key count we observed.
+   * @param[in] low inclusive beginning of the slice range
+   * @param[in] high inclusive end of the slice range
+   * @param[in] own_locks current lock list of the verifying transaction
+   * @details
+   * The core of the phantom protection via xct::RangeXctAccess.
+   * Because keys are immutable and the key count only increases in a volatile page unless
+   * the page is moved, checking the records after from_index is enough.
+   * We ignore a new record that is only reserved and not locked by anyone. Its inserter
+   * has not started precommit, so it will lock the record and change the XID after us.
+   * A reserved record locked by another transaction is being inserted by a transaction that
+   * might serialize before us, so it counts as new. A record we locked ourselves is our own
+   * insert.
+   * @see StorageManager::verify_range_access()
+   */
+  bool has_new_record_in_range(
+    SlotIndex from_index,
+    KeySlice low,
+    KeySlice high,
+    const xct::CurrentLockList* own_locks) const;
+
   /** @returns whether the length information seems okay. used only for assertions. */
   bool verify_slot_lengthes(SlotIndex index) const;
 
@@ -1129,11 +1171,9 @@ inline SlotIndex MasstreeBorderPage::find_key(
   // one slice might be used for up to 10 keys, length 0 to 8 and pointer to next layer.
   if (remainder <= sizeof(KeySlice)) {
     // then we are looking for length 0-8 only.
-    for (SlotIndex i = 0; i < key_count; ++i) {
-      const KeySlice rec_slice = get_slice(i);
-      if (LIKELY(slice != rec_slice)) {
-        continue;
-      }
+    for (SlotIndex i = find_next_slice(0, key_count, slice);
+          i < key_count;
+          i = find_next_slice(i + 1U, key_count, slice)) {
       // no suffix nor next layer, so just compare length. if not match, continue
       const KeyLength klen = get_remainder_length(i);
       if (klen == remainder) {
@@ -1142,12 +1182,9 @@ inline SlotIndex MasstreeBorderPage::find_key(
     }
   } else {
     // then we are only looking for length>8.
-    for (SlotIndex i = 0; i < key_count; ++i) {
-      const KeySlice rec_slice = get_slice(i);
-      if (LIKELY(slice != rec_slice)) {
-        continue;
-      }
-
+    for (SlotIndex i = find_next_slice(0, key_count, slice);
+          i < key_count;
+          i = find_next_slice(i + 1U, key_count, slice)) {
       if (does_point_to_layer(i)) {
         // as it points to next layer, no need to check suffix. We are sure this is it.
         // so far we don't delete layers, so in this case the record is always valid.
@@ -1185,10 +1222,11 @@ inline SlotIndex MasstreeBorderPage::find_key_normalized(
   if (from_index == 0) {  // we don't need prefetching in second time
     prefetch_additional_if_needed(to_index);
   }
-  for (SlotIndex i = from_index; i < to_index; ++i) {
-    const KeySlice rec_slice = get_slice(i);
+  for (SlotIndex i = find_next_slice(from_index, to_index, slice);
+        i < to_index;
+        i = find_next_slice(i + 1U, to_index, slice)) {
     const KeyLength klen = get_remainder_length(i);
-    if (UNLIKELY(slice == rec_slice && klen == sizeof(KeySlice))) {
+    if (UNLIKELY(klen == sizeof(KeySlice))) {
       return i;
     }
   }
@@ -1208,11 +1246,9 @@ inline MasstreeBorderPage::FindKeyForReserveResult MasstreeBorderPage::find_key_
     prefetch_additional_if_needed(to_index);
   }
   if (remainder <= sizeof(KeySlice)) {
-    for (SlotIndex i = from_index; i < to_index; ++i) {
-      const KeySlice rec_slice = get_slice(i);
-      if (LIKELY(slice != rec_slice)) {
-        continue;
-      }
+    for (SlotIndex i = find_next_slice(from_index, to_index, slice);
+          i < to_index;
+          i = find_next_slice(i + 1U, to_index, slice)) {
       const KeyLength klen = get_remainder_length(i);
       if (klen == remainder) {
         ASSERT_ND(!does_point_to_layer(i));
@@ -1220,12 +1256,9 @@ inline MasstreeBorderPage::FindKeyForReserveResult MasstreeBorderPage::find_key_
       }
     }
   } else {
-    for (SlotIndex i = from_index; i < to_index; ++i) {
-      const KeySlice rec_slice = get_slice(i);
-      if (LIKELY(slice != rec_slice)) {
-        continue;
-      }
-
+    for (SlotIndex i = find_next_slice(from_index, to_index, slice);
+          i < to_index;
+          i = find_next_slice(i + 1U, to_index, slice)) {
       const bool next_layer = does_point_to_layer(i);
       const KeyLength klen = get_remainder_length(i);
 
@@ -1261,8 +1294,11 @@ inline MasstreeBorderPage::FindKeyForReserveResult MasstreeBorderPage::find_key_
   ASSERT_ND(remainder <= kMaxKeyLength);
   // Remember, unlike other cases above, there are no worry on concurrency.
   const SlotIndex key_count = get_key_count();
+  // Slices are sorted, so we can skip all records whose slices are smaller in one shot.
+  const SlotIndex first_candidate
+    = slice == 0 ? 0 : assorted::simd_find_first_greater(slices_, 0, key_count, slice - 1U);
   if (remainder <= sizeof(KeySlice)) {
-    for (SlotIndex i = 0; i < key_count; ++i) {
+    for (SlotIndex i = first_candidate; i < key_count; ++i) {
       const KeySlice rec_slice = get_slice(i);
       if (rec_slice < slice) {
         continue;
@@ -1283,7 +1319,7 @@ inline MasstreeBorderPage::FindKeyForReserveResult MasstreeBorderPage::find_key_
       }
     }
   } else {
-    for (SlotIndex i = 0; i < key_count; ++i) {
+    for (SlotIndex i = first_candidate; i < key_count; ++i) {
       const KeySlice rec_slice = get_slice(i);
       if (rec_slice < slice) {
         continue;
@@ -1444,6 +1480,44 @@ inline void MasstreeBorderPage::append_next_layer_snapshot(
   set_key_count(index + 1U);
 }
 
+inline void MasstreeBorderPage::append_record_bulk(
+  xct::XctId initial_owner_id,
+  KeySlice slice,
+  const void* payload,
+  PayloadLength payload_count) {
+  ASSERT_ND(!header().snapshot_);
+  const SlotIndex index = get_key_count();
+  const KeyLength kRemainder = sizeof(KeySlice);
+  ASSERT_ND(index == 0 || get_slice(index - 1U) < slice);
+  ASSERT_ND(can_accomodate(index, kRemainder, payload_count));
+  ASSERT_ND(next_offset_ % 8 == 0);
+  const DataOffset record_size = to_record_length(kRemainder, payload_count);
+  const DataOffset offset = next_offset_;
+  set_slice(index, slice);
+  // Nobody else sees this page yet, so no worry on race.
+  Slot* slot = get_new_slot(index);
+  slot->lengthes_.components.offset_ = offset;
+  slot->lengthes_.components.unused_ = 0;
+  slot->lengthes_.components.physical_record_length_ = record_size;
+  slot->lengthes_.components.payload_length_ = payload_count;
+  slot->original_physical_record_length_ = record_size;
+  slot->remainder_length_ = kRemainder;
+  slot->original_offset_ = offset;
+  next_offset_ += record_size;
+
+  slot->tid_.lock_.reset();
+  slot->tid_.xct_id_ = initial_owner_id;
+  // normalized keys have no suffix, so the payload starts at the beginning of the record.
+  char* record = get_record_from_offset(offset);
+  if (payload_count > 0) {
+    std::memcpy(record, payload, payload_count);
+  }
+  if (record_size > payload_count) {
+    std::memset(record + payload_count, 0, record_size - payload_count);
+  }
+  set_key_count(index + 1U);
+}
+
 inline void MasstreeBorderPage::replace_next_layer_snapshot(SnapshotPagePointer pointer) {
   ASSERT_ND(header().snapshot_);  // this is used only from snapshot composer
   ASSERT_ND(get_key_count() > 0);
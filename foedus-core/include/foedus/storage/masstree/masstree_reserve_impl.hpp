@@ -51,8 +51,8 @@ namespace masstree {
  * \li Page-lock of the target page.
  * \li Record-lock of an existing, matching record. Only when we have to expand the record.
  *
- * So far this sysxct installs only one physical record at a time.
- * TASK(Hideaki): Probably it helps by batching several records.
+ * This sysxct installs only one physical record at a time.
+ * See ReserveRecordsBatch for a batched version for normalized keys.
  */
 struct ReserveRecords final : public xct::SysxctFunctor {
   /** Thread context */
@@ -111,6 +111,64 @@ struct ReserveRecords final : public xct::SysxctFunctor {
   virtual ErrorCode run(xct::SysxctWorkspace* sysxct_workspace) override;
 };
 
+/**
+ * @brief A system transaction to reserve physical records of many normalized keys in
+ * a border page at once.
+ * @ingroup MASSTREE
+ * @see SYSXCT
+ * @see ReserveRecords
+ * @details
+ * Bulk inserts of sorted keys hit the same border page for many keys in a row.
+ * ReserveRecords takes the page-lock for each of them, while this sysxct takes it once
+ * and reserves as many of the keys as the page can accommodate.
+ * Used by MasstreeStorage::insert_record_normalized_batch().
+ *
+ * The keys are processed in the given order. This sysxct stops at the first key that:
+ * \li is out of the fences of the page,
+ * \li exists in the page, but its record is physically too short, or
+ * \li needs a page-split to be accommodated.
+ *
+ * The caller handles such a key with ReserveRecords/SplitBorder, and then continues with the
+ * following keys. out_reserved_count_ tells the number of leading keys that surely have
+ * physical records with enough payload space in the page, including already existing records.
+ * It is zero when the page turns out to be moved.
+ *
+ * Locks taken in this sysxct:
+ * \li Page-lock of the target page.
+ */
+struct ReserveRecordsBatch final : public xct::SysxctFunctor {
+  /** Thread context */
+  thread::Thread* const       context_;
+  /** The page to install new physical records. Must be in the first layer */
+  MasstreeBorderPage* const   target_;
+  /** The keys. Sorted keys make the most out of this sysxct, but not mandatory */
+  const KeySlice* const       keys_;
+  /** Number of keys */
+  const uint16_t              key_count_;
+  /** Minimal required length of the payload of every key */
+  const PayloadLength         payload_count_;
+  /**
+   * [Out] Number of leading keys that have physical records in the page.
+   */
+  uint16_t                    out_reserved_count_;
+
+  ReserveRecordsBatch(
+    thread::Thread* context,
+    MasstreeBorderPage* target,
+    const KeySlice* keys,
+    uint16_t key_count,
+    PayloadLength payload_count)
+    : xct::SysxctFunctor(),
+      context_(context),
+      target_(target),
+      keys_(keys),
+      key_count_(key_count),
+      payload_count_(payload_count),
+      out_reserved_count_(0) {
+  }
+  virtual ErrorCode run(xct::SysxctWorkspace* sysxct_workspace) override;
+};
+
 }  // namespace masstree
 }  // namespace storage
 }  // namespace foedus
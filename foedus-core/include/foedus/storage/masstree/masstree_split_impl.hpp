@@ -112,7 +112,10 @@ struct SplitBorder final : public xct::SysxctFunctor {
     KeySlice largest_slice_;
     /**
     * This will be the new foster fence.
-    * Ideally, # of records below and above this are same.
+    * For random inserts, # of records below and above this are same.
+    * For sequential or interleaved-sequential inserts, this is at a boundary of key ranges
+    * that are filled sequentially, and for append-heavy inserts, most records go below this.
+    * @see decide_strategy()
     */
     KeySlice mid_slice_;
   };
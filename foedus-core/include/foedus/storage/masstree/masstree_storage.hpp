@@ -120,6 +120,16 @@ class MasstreeStorage CXX11_FINAL : public Storage<MasstreeStorageControlBlock>
     xct::RwLockableXctId* old_address,
     xct::WriteXctAccess* write_set);
 
+  /**
+   * @copydoc foedus::storage::StorageManager::verify_range_access()
+   * @note Masstree takes range sets in volatile border pages, both in cursors and in point
+   * queries that didn't find the key. low_/high_ are KeySlice in the layer of the page.
+   * We abort if the page is split after the access, not tracking where the range went.
+   */
+  bool verify_range_access(
+    const xct::RangeXctAccess& access,
+    const xct::CurrentLockList* own_locks);
+
   //// Masstree API
 
   // get_record() methods
@@ -236,6 +246,50 @@ class MasstreeStorage CXX11_FINAL : public Storage<MasstreeStorageControlBlock>
     PayloadLength payload_offset,
     bool read_only);
 
+  /**
+   * @brief Retrieves entire records of many keys in one call.
+   * @param[in] context Thread context
+   * @param[in] batch_size Number of keys. Any number is fine, but each group of
+   * MasstreeStoragePimpl::kBatchMax keys are looked up together.
+   * @param[in] keys Keys to look for, size=batch_size
+   * @param[in] key_lengths Byte size of each key, size=batch_size
+   * @param[out] payloads Buffers to receive the payload of each record, size=batch_size
+   * @param[in,out] payload_capacities Same as get_record()'s payload_capacity, size=batch_size
+   * @param[out] results Result of each key, size=batch_size. kErrorCodeOk,
+   * kErrorCodeStrKeyNotFound, or kErrorCodeStrTooSmallPayloadBuffer.
+   * @param[in] read_only Same as get_record()
+   * @return Errors that are not specific to a key, such as race aborts. When this returns an
+   * error, results and payloads are undefined.
+   * @details
+   * Semantically equivalent to calling get_record() for each key, except that an individual
+   * key's failure does not stop the others. The keys are looked up together, one page at a
+   * time for each key, so that cache misses of different keys overlap.
+   * This pays off when the keys are independent each other, eg secondary-index joins.
+   */
+  ErrorCode   get_record_batch(
+    thread::Thread* context,
+    uint16_t batch_size,
+    const void* const* keys,
+    const KeyLength* key_lengths,
+    void* const* payloads,
+    PayloadLength* payload_capacities,
+    ErrorCode* results,
+    bool read_only);
+
+  /**
+   * @brief Retrieves entire records of many primitive keys in one call.
+   * @see get_record_batch()
+   * @see get_record_normalized()
+   */
+  ErrorCode   get_record_normalized_batch(
+    thread::Thread* context,
+    uint16_t batch_size,
+    const KeySlice* keys,
+    void* const* payloads,
+    PayloadLength* payload_capacities,
+    ErrorCode* results,
+    bool read_only);
+
   // insert_record() methods
 
   /**
@@ -322,6 +376,51 @@ class MasstreeStorage CXX11_FINAL : public Storage<MasstreeStorageControlBlock>
     return insert_record_normalized(context, key, CXX11_NULLPTR, 0U);
   }
 
+  /**
+   * @brief Inserts new records of many primitive keys in one call.
+   * @param[in] context Thread context
+   * @param[in] batch_size Number of keys. Any number is fine.
+   * @param[in] keys Keys to insert, size=batch_size. Ascending keys are the most efficient.
+   * @param[in] payloads Value of each key, size=batch_size
+   * @param[in] payload_count Length of every payload.
+   * @param[out] results Result of each key, size=batch_size. kErrorCodeOk or
+   * kErrorCodeStrKeyAlreadyExists.
+   * @param[in] physical_payload_hint Same as insert_record_normalized()
+   * @return Errors that are not specific to a key, such as race aborts. When this returns an
+   * error, results are undefined.
+   * @details
+   * Semantically equivalent to calling insert_record_normalized() for each key, except that an
+   * existing key does not stop the others. Physical records of the keys that fall in the same
+   * border page are reserved in one system transaction, taking the page-lock only once.
+   * This pays off for bulk loads of sorted keys.
+   */
+  ErrorCode   insert_record_normalized_batch(
+    thread::Thread* context,
+    uint16_t batch_size,
+    const KeySlice* keys,
+    const void* const* payloads,
+    PayloadLength payload_count,
+    ErrorCode* results,
+    PayloadLength physical_payload_hint);
+
+  /** Same as above, but without \e physical_payload_hint */
+  ErrorCode   insert_record_normalized_batch(
+    thread::Thread* context,
+    uint16_t batch_size,
+    const KeySlice* keys,
+    const void* const* payloads,
+    PayloadLength payload_count,
+    ErrorCode* results) ALWAYS_INLINE {
+    return insert_record_normalized_batch(
+      context,
+      batch_size,
+      keys,
+      payloads,
+      payload_count,
+      results,
+      payload_count);
+  }
+
   // delete_record() methods
 
   /**
@@ -535,7 +634,101 @@ class MasstreeStorage CXX11_FINAL : public Storage<MasstreeStorageControlBlock>
     PAYLOAD* value,
     PayloadLength payload_offset);
 
-  // TODO(Hideaki): Extend/shrink/update methods for payload. A bit faster than delete + insert.
+  // extend_record()/truncate_record()/replace_record() methods
+
+  /**
+   * @brief Appends the given data to the payload of one existing record in this Masstree.
+   * @param[in] context Thread context
+   * @param[in] key Arbitrary length of key that is lexicographically (big-endian) evaluated.
+   * @param[in] key_length Byte size of key.
+   * @param[in] payload We copy from this buffer. Must be at least payload_count.
+   * @param[in] payload_count How many bytes we append.
+   * @param[in] physical_payload_hint When the record has to be expanded, we reserve this size
+   * for the payload. Giving a larger value than the new payload length avoids expanding the
+   * record again in later extensions. Ignored if smaller than the new payload length.
+   * @details
+   * Unlike delete + insert or upsert, this emits only one log that contains only the appended
+   * data. If the record is physically large enough, we just write to it. Otherwise, we expand
+   * the record in the page using the free space in the page, which might split the page.
+   * When the key does not exist, this returns kErrorCodeStrKeyNotFound.
+   * When the new payload is longer than kMaxPayloadLength, this returns
+   * kErrorCodeStrTooLongPayload.
+   */
+  ErrorCode   extend_record(
+    thread::Thread* context,
+    const void* key,
+    KeyLength key_length,
+    const void* payload,
+    PayloadLength payload_count,
+    PayloadLength physical_payload_hint = 0);
+
+  /**
+   * @brief Appends the given data to the payload of one existing record of the given primitive key.
+   * @see extend_record()
+   */
+  ErrorCode   extend_record_normalized(
+    thread::Thread* context,
+    KeySlice key,
+    const void* payload,
+    PayloadLength payload_count,
+    PayloadLength physical_payload_hint = 0);
+
+  /**
+   * @brief Shrinks the payload of one existing record in this Masstree.
+   * @param[in] context Thread context
+   * @param[in] key Arbitrary length of key that is lexicographically (big-endian) evaluated.
+   * @param[in] key_length Byte size of key.
+   * @param[in] payload_count The new payload length.
+   * @details
+   * The physical space of the record stays the same, so later extend_record() can reuse it.
+   * When payload_count is larger than the current payload length, this returns
+   * kErrorCodeStrTooShortPayload.
+   */
+  ErrorCode   truncate_record(
+    thread::Thread* context,
+    const void* key,
+    KeyLength key_length,
+    PayloadLength payload_count);
+
+  /**
+   * @brief Shrinks the payload of one existing record of the given primitive key.
+   * @see truncate_record()
+   */
+  ErrorCode   truncate_record_normalized(
+    thread::Thread* context,
+    KeySlice key,
+    PayloadLength payload_count);
+
+  /**
+   * @brief Replaces the whole payload of one existing record in this Masstree.
+   * @param[in] context Thread context
+   * @param[in] key Arbitrary length of key that is lexicographically (big-endian) evaluated.
+   * @param[in] key_length Byte size of key.
+   * @param[in] payload New payload.
+   * @param[in] payload_count New payload length, which can differ from the current one.
+   * @param[in] physical_payload_hint Same as extend_record().
+   * @details
+   * Unlike upsert_record(), this never inserts a record. When the key does not exist, this
+   * returns kErrorCodeStrKeyNotFound.
+   */
+  ErrorCode   replace_record(
+    thread::Thread* context,
+    const void* key,
+    KeyLength key_length,
+    const void* payload,
+    PayloadLength payload_count,
+    PayloadLength physical_payload_hint = 0);
+
+  /**
+   * @brief Replaces the whole payload of one existing record of the given primitive key.
+   * @see replace_record()
+   */
+  ErrorCode   replace_record_normalized(
+    thread::Thread* context,
+    KeySlice key,
+    const void* payload,
+    PayloadLength payload_count,
+    PayloadLength physical_payload_hint = 0);
 
   ErrorStack  verify_single_thread(thread::Thread* context);
 
@@ -608,6 +801,54 @@ class MasstreeStorage CXX11_FINAL : public Storage<MasstreeStorageControlBlock>
     uint32_t desired_count,
     bool disable_no_record_split = true);
 
+  /**
+   * @brief Adopts foster twins left by page splits into their parents in batches.
+   * @param[in] context Thread context
+   * @param[out] adopted_count Number of adopted pages
+   * @details
+   * This is a physical-only maintenance method that does nothing logically.
+   * Transactions adopt foster twins opportunistically while they traverse the tree,
+   * but they skip contended pages and adopt one child at a time.
+   * This method walks all volatile intermediate pages in all layers, and adopts all moved
+   * children of each intermediate page in one system transaction (AdoptBatch).
+   * Call it after a bulk load or periodically from a maintenance thread.
+   * One call adopts one level of foster twins. Foster twins that are moved again are adopted
+   * in the next call.
+   */
+  ErrorStack  adopt_foster_twins(thread::Thread* context, uint32_t* adopted_count);
+
+  /**
+   * @brief Loads records of normalized keys into an empty storage, building pages bottom-up.
+   * @param[in] context Thread context. It must not be running a transaction.
+   * @param[in] count Number of records to load
+   * @param[in] keys Normalized keys without duplicates. Sorted input is the fastest, but
+   * not required.
+   * @param[in] payloads Payloads of all records, contiguous. The i-th record's payload starts
+   * at payloads + i * payload_count.
+   * @param[in] payload_count Length of each payload
+   * @details
+   * Unlike inserting records one by one, this method does not traverse the tree nor split pages.
+   * It fills border pages as much as possible, builds intermediate pages on top of them,
+   * and installs the result under the first root. Each border page is logged as one
+   * committed insert transaction, so bulk-loaded records are durable and snapshotted as usual.
+   * Pages are fully packed, so the first insert into a bulk-loaded page causes a split.
+   *
+   * Unsorted keys are sorted with one thread per NUMA node. Border pages are range-partitioned
+   * to NUMA nodes, and one thread per node builds its range on its own node's memory.
+   * Logs are written by the calling thread, and the few intermediate pages are built on the
+   * calling thread's node.
+   * @pre The storage is empty, it has no snapshot, and no other thread accesses it
+   * during this method.
+   * @return kErrorCodeStrMasstreeNotEmpty if the storage is not empty,
+   * kErrorCodeInvalidParameter if keys are not unique.
+   */
+  ErrorStack  bulk_load_normalized(
+    thread::Thread* context,
+    uint64_t count,
+    const KeySlice* keys,
+    const void* payloads,
+    PayloadLength payload_count);
+
   /**
    * @param[in] layer B-trie layer most border pages would be in.
    * @param[in] key_length estimated byte size of each key
@@ -97,6 +97,16 @@ struct MasstreeStorageControlBlock final {
  */
 class MasstreeStoragePimpl final : public Attachable<MasstreeStorageControlBlock> {
  public:
+  enum Constants {
+    /** If you want more than this, you should loop. MasstreeStorage should take care of it. */
+    kBatchMax = 16,
+    /**
+     * Same for reserve_record_normalized_batch(). Larger because the point is to fill up
+     * a border page in one sysxct.
+     */
+    kReserveBatchMax = 64,
+  };
+
   MasstreeStoragePimpl() : Attachable<MasstreeStorageControlBlock>() {}
   explicit MasstreeStoragePimpl(MasstreeStorage* storage)
     : Attachable<MasstreeStorageControlBlock>(
@@ -133,6 +143,31 @@ class MasstreeStoragePimpl final : public Attachable<MasstreeStorageControlBlock
     bool      for_writes,
     KeySlice  slice,
     MasstreeBorderPage** border) ALWAYS_INLINE;
+  /** @returns whether find_border_physical() can stop at this page */
+  static bool is_border_reached(const MasstreePage* page) ALWAYS_INLINE;
+  /**
+   * Protects the lack of the slice in the border page when a point query didn't find the key.
+   * Concurrent inserts to the page do not abort us unless they have the same slice.
+   * @param[in] observed page version as of observed_key_count
+   * @param[in] observed_key_count the key count we searched the page with
+   */
+  static ErrorCode add_key_to_range_set(
+    xct::Xct* cur_xct,
+    const MasstreeBorderPage* border,
+    PageVersionStatus observed,
+    SlotIndex observed_key_count,
+    KeySlice slice) ALWAYS_INLINE;
+  /**
+   * One step of find_border_physical(). Moves the page to the foster twin or the child page
+   * that contains the slice and prefetches it. The page stays the same if a concurrent
+   * split requires a local retry.
+   * @pre !is_border_reached(*page)
+   */
+  ErrorCode find_border_physical_step(
+    thread::Thread* context,
+    bool      for_writes,
+    KeySlice  slice,
+    MasstreePage** page) ALWAYS_INLINE;
 
   /** Identifies page and record for the key */
   ErrorCode locate_record(
@@ -148,6 +183,35 @@ class MasstreeStoragePimpl final : public Attachable<MasstreeStorageControlBlock
     bool for_writes,
     RecordLocation* result);
 
+  /**
+   * @brief Batched version of locate_record().
+   * @param[out] results locations of the keys. Each of them is populated only when the
+   * corresponding result_codes is kErrorCodeOk.
+   * @param[out] result_codes kErrorCodeOk or kErrorCodeStrKeyNotFound for each key.
+   * @return Errors that are not specific to a key, such as race aborts.
+   * @pre batch_size <= kBatchMax
+   * @details
+   * Instead of descending the tree for one key after another, this descends for all keys
+   * together one page at a time, prefetching the next page of each key (AMAC-style group
+   * lookup). Cache misses of different keys thus overlap each other.
+   */
+  ErrorCode locate_record_batch(
+    thread::Thread* context,
+    uint16_t batch_size,
+    const void* const* keys,
+    const KeyLength* key_lengths,
+    bool for_writes,
+    RecordLocation* results,
+    ErrorCode* result_codes);
+  /** Batched version of locate_record_normalized(). @copydetails locate_record_batch() */
+  ErrorCode locate_record_normalized_batch(
+    thread::Thread* context,
+    uint16_t batch_size,
+    const KeySlice* keys,
+    bool for_writes,
+    RecordLocation* results,
+    ErrorCode* result_codes);
+
   /**
    * Like locate_record(), this is also a logical operation.
    */
@@ -165,6 +229,24 @@ class MasstreeStoragePimpl final : public Attachable<MasstreeStorageControlBlock
     PayloadLength physical_payload_hint,
     RecordLocation* result);
 
+  /**
+   * @brief Batched version of reserve_record_normalized().
+   * @param[out] results locations of the keys. All of them are found as in reserve_record().
+   * @pre batch_size <= kReserveBatchMax
+   * @details
+   * Runs ReserveRecordsBatch for each run of keys that fall in the same border page,
+   * so sorted keys pay only one page-lock for each page rather than for each key.
+   * A key the sysxct could not reserve (record expansion or page split needed) goes through
+   * reserve_record_normalized().
+   */
+  ErrorCode reserve_record_normalized_batch(
+    thread::Thread* context,
+    uint16_t batch_size,
+    const KeySlice* keys,
+    PayloadLength payload_count,
+    PayloadLength physical_payload_hint,
+    RecordLocation* results);
+
   /** implementation of get_record family. use with locate_record() */
   ErrorCode retrieve_general(
     thread::Thread* context,
@@ -229,6 +311,29 @@ class MasstreeStoragePimpl final : public Attachable<MasstreeStorageControlBlock
     PAYLOAD* value,
     PayloadLength payload_offset);
 
+  /**
+   * @brief implementation of extend/truncate/replace_record family.
+   * @param[in] be_key big-endian key. When key_length is 8, we use the normalized methods.
+   * @param[in] append whether we append to the current payload. If true, payload_offset
+   * is ignored and the current payload length is used instead.
+   * @param[in] payload_offset bytes before this offset are kept as they are.
+   * It must be at most the current payload length.
+   * @param[in] physical_payload_hint reserved payload size if we need to expand the record.
+   * @details
+   * This locates the existing record, makes sure the record is physically large enough for the
+   * new payload, then emits a MasstreeResizeLogType. Expanding the record is a physical-only
+   * operation by ReserveRecords, which keeps the TID, so it doesn't invalidate our read-set.
+   */
+  ErrorCode resize_general(
+    thread::Thread* context,
+    const void* be_key,
+    KeyLength key_length,
+    bool append,
+    const void* payload,
+    PayloadLength payload_offset,
+    PayloadLength payload_count,
+    PayloadLength physical_payload_hint);
+
   /** These are defined in masstree_storage_verify.cpp */
   ErrorStack verify_single_thread(thread::Thread* context);
   ErrorStack verify_single_thread_layer(
@@ -314,6 +419,9 @@ class MasstreeStoragePimpl final : public Attachable<MasstreeStorageControlBlock
   xct::TrackMovedRecordResult track_moved_record(
     xct::RwLockableXctId* old_address,
     xct::WriteXctAccess* write_set) ALWAYS_INLINE;
+  bool verify_range_access(
+    const xct::RangeXctAccess& access,
+    const xct::CurrentLockList* own_locks) ALWAYS_INLINE;
 
   /** Defined in masstree_storage_peek.cpp */
   ErrorCode     peek_volatile_page_boundaries(
@@ -346,6 +454,51 @@ class MasstreeStoragePimpl final : public Attachable<MasstreeStorageControlBlock
     thread::Thread* context,
     uint32_t* out);
 
+  /** Defined in masstree_storage_fatify.cpp */
+  ErrorStack    adopt_foster_twins(thread::Thread* context, uint32_t* adopted_count);
+  /** Adopts moved children of the page and its descendants, including next layers. */
+  ErrorCode     adopt_foster_twins_recurse(
+    thread::Thread* context,
+    MasstreePage* page,
+    uint32_t* adopted_count);
+  /** Runs AdoptBatch for the given children, then clears the array */
+  ErrorCode     adopt_foster_twins_flush(
+    thread::Thread* context,
+    MasstreeIntermediatePage* parent,
+    MasstreePage** olds,
+    uint16_t* old_count,
+    uint32_t* adopted_count);
+
+  /** Defined in masstree_storage_bulk_load.cpp */
+  ErrorStack    bulk_load_normalized(
+    thread::Thread* context,
+    uint64_t count,
+    const KeySlice* keys,
+    const void* payloads,
+    PayloadLength payload_count);
+  /**
+   * Sorts the bulk-loaded keys. Each NUMA node sorts one run in parallel, and then the runs are
+   * merged. Leaves order empty if the keys are already sorted.
+   * @return kErrorCodeInvalidParameter if there are duplicate keys.
+   */
+  ErrorStack    bulk_load_sort(uint64_t count, const KeySlice* keys, std::vector<uint64_t>* order);
+  /**
+   * Returns the only border page in the volatile tree if this storage has no record at all,
+   * otherwise null.
+   */
+  MasstreeBorderPage* get_bulk_load_target(thread::Thread* context, MasstreeIntermediatePage* root);
+  /**
+   * Fills a new intermediate page with the given children. The page is not yet reachable from
+   * other threads, so no race.
+   */
+  static void   fill_intermediate_bulk(
+    MasstreeIntermediatePage* page,
+    uint32_t child_count,
+    const KeySlice* child_low_fences,
+    const VolatilePagePointer* child_pointers);
+  /** Stamps the records in the new page with a new XctId and publishes their insert logs. */
+  void          publish_bulk_load_logs(thread::Thread* context, MasstreeBorderPage* page);
+
   static ErrorCode check_next_layer_bit(xct::XctId observed) ALWAYS_INLINE;
 };
 static_assert(sizeof(MasstreeStoragePimpl) <= kPageSize, "MasstreeStoragePimpl is too large");
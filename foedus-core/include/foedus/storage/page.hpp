@@ -53,6 +53,8 @@ enum PageType {
   kHashIntermediatePageType = 6,
   kHashDataPageType = 7,
   kHashComposedBinsPageType = 8,
+  kHashHotDirectoryPageType = 9,
+  kHashHotDirectoryRootPageType = 10,
   kDummyLastPageType,
 };
 
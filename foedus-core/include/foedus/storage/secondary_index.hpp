@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#ifndef FOEDUS_STORAGE_SECONDARY_INDEX_HPP_
+#define FOEDUS_STORAGE_SECONDARY_INDEX_HPP_
+#include <stdint.h>
+
+#include "foedus/proc/proc_id.hpp"
+#include "foedus/storage/storage_id.hpp"
+
+/**
+ * @file foedus/storage/secondary_index.hpp
+ * @brief Definitions for secondary indexes maintained by StorageManager.
+ * @ingroup STORAGE
+ * @details
+ * A secondary index is a Masstree storage (the \e index) whose records are derived from the
+ * records of another Masstree storage (the \e base). A user-registered procedure,
+ * the \e extractor, computes the secondary key of a base record. Each base record that has a
+ * secondary key is represented by exactly one index record:
+ *  \li Key: the secondary key immediately followed by the base key. Appending the base key makes
+ * index keys unique even when many base records share the same secondary key.
+ *  \li Payload: the base key, so that readers can look up the base record without parsing keys.
+ *
+ * Hence, a lookup on secondary key K is a Masstree scan from K (inclusive) to the next possible
+ * key after K, when all secondary keys have the same length.
+ * @see StorageManager::register_secondary_index()
+ */
+namespace foedus {
+namespace storage {
+
+/**
+ * @brief Registration of a secondary index, stored in the shared memory of StorageManager.
+ * @ingroup STORAGE
+ * @details
+ * The registration is \b not durable, just like procedures themselves. Nothing about it is
+ * logged or snapshotted, only the index storage is. After restart, the application must register
+ * the index again and call StorageManager::finish_secondary_index_build() before relying on it,
+ * because transactions that ran before the registration did not maintain the index.
+ *
+ * Entries are read without lock by transactions maintaining indexes. Modifications take
+ * StorageManager's mod_lock_ and make version_ odd while they are writing the entry, so that
+ * readers retry instead of seeing a half-written entry. This allows reusing unregistered entries.
+ */
+struct SecondaryIndex {
+  enum Constants {
+    /** Max number of secondary indexes registered at the same time. */
+    kMaxSecondaryIndexes = 32,
+  };
+  enum State {
+    /** Not registered. The entry can be reused. */
+    kFree = 0,
+    /**
+     * Registered, but the index might not contain all base records yet. Transactions maintain
+     * the index, tolerating index records that already exist or do not exist.
+     */
+    kBuilding = 1,
+    /** The index exactly corresponds to the base. Transactions maintain it strictly. */
+    kReady = 2,
+  };
+
+  /** Incremented before and after each modification. Odd while being modified. */
+  uint32_t        version_;
+  /** One of State */
+  uint32_t        state_;
+  /** The indexed storage. */
+  StorageId       base_id_;
+  /** The Masstree storage that holds index records. */
+  StorageId       index_id_;
+  /** Name of the extractor procedure. */
+  proc::ProcName  extractor_;
+
+  bool is_valid() const { return state_ != kFree; }
+  bool is_building() const { return state_ == kBuilding; }
+};
+
+/**
+ * @brief The input_buffer_ given to an extractor procedure.
+ * @ingroup STORAGE
+ * @details
+ * An extractor procedure receives a pointer to this object as proc::ProcArguments::input_buffer_
+ * and writes the secondary key of the base record to output_buffer_, setting output_used_ to
+ * its length. Setting output_used_ to 0 means the record has no secondary key (not indexed),
+ * which allows partial indexes. The extractor runs in the caller's thread and transaction,
+ * so it must not access storages nor block. key_ and payload_ point to the caller's buffers
+ * and are valid only during the call.
+ */
+struct SecondaryIndexExtractorInput {
+  /** The indexed storage */
+  StorageId   base_id_;
+  /** The index storage. One extractor can serve several indexes by looking at this */
+  StorageId   index_id_;
+  /** The base key */
+  const void* key_;
+  /** The base payload */
+  const void* payload_;
+  /** Byte length of key_ */
+  uint16_t    key_length_;
+  /** Byte length of payload_ */
+  uint16_t    payload_count_;
+};
+
+}  // namespace storage
+}  // namespace foedus
+#endif  // FOEDUS_STORAGE_SECONDARY_INDEX_HPP_
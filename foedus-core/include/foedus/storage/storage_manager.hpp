@@ -22,6 +22,7 @@
 #include "foedus/cxx11.hpp"
 #include "foedus/fwd.hpp"
 #include "foedus/initializable.hpp"
+#include "foedus/proc/proc_id.hpp"
 #include "foedus/snapshot/fwd.hpp"
 #include "foedus/storage/fwd.hpp"
 #include "foedus/storage/storage_id.hpp"
@@ -248,6 +249,163 @@ class StorageManager CXX11_FINAL : public virtual Initializable {
     xct::RwLockableXctId* old_address,
     xct::WriteXctAccess* write_set);
 
+  /**
+   * @brief Verifies a range set at precommit.
+   * @param[in] access the range set entry to verify
+   * @param[in] own_locks the current lock list of the verifying transaction. Records locked
+   * in it are our own inserts, which are not phantoms.
+   * @return whether no one has inserted a record in the range since the access.
+   * @details
+   * Called from precommit for each xct::RangeXctAccess. As the meaning of the range is
+   * storage-specific, this delegates to the storage type. Only Masstree takes range sets so far.
+   */
+  bool verify_range_access(
+    const xct::RangeXctAccess& access,
+    const xct::CurrentLockList* own_locks);
+
+  /**
+   * @brief Registers a Masstree storage as a secondary index of another storage.
+   * @param[in] base_id The indexed storage, which must be a Masstree.
+   * @param[in] index_id The Masstree storage to store index records. Usually an empty storage.
+   * @param[in] extractor Name of the procedure that computes secondary keys.
+   * See SecondaryIndexExtractorInput for its contract.
+   * @details
+   * From this point on, apply_secondary_index_insert() and its siblings maintain the index in the
+   * caller's transactions. The application calls one of them for each write to the base.
+   * Once the index is ready, precommit aborts a transaction that made more writes to the base than
+   * such calls with kErrorCodeXctSecondaryIndexNotMaintained, so a forgotten call does not leave
+   * the index stale. Existing base records are not indexed by this method.
+   * Call build_secondary_index() for them, which can run concurrently with the maintenance,
+   * then finish_secondary_index_build(). Until then, the index is in the \e building state and
+   * might miss some base records.
+   * The extractor must be registered in every SOC that maintains the index. This method fails
+   * with kErrorCodeProcNotFound if it is not registered in this SOC.
+   *
+   * \b The \b registration \b is \b not \b durable. Only the index storage is logged and
+   * snapshotted. After restart, register the index again and call finish_secondary_index_build()
+   * (no need to call build_secondary_index() again) before relying on the index.
+   * Transactions that run before the registration do not maintain the index.
+   * @see foedus/storage/secondary_index.hpp
+   */
+  ErrorStack  register_secondary_index(
+    StorageId base_id,
+    StorageId index_id,
+    const proc::ProcName& extractor);
+
+  /**
+   * @brief Removes all secondary index registrations where the given storage is either the base
+   * or the index. This does not drop any storage. drop_storage() implicitly calls this.
+   */
+  void        unregister_secondary_indexes(StorageId id);
+
+  /**
+   * @brief Inserts index records for a new base record into all secondary indexes of the base.
+   * @param[in] context Thread context, which must be in a transaction.
+   * @param[in] base_id ID of the base storage
+   * @param[in] key Key of the base record
+   * @param[in] key_length Byte length of key
+   * @param[in] payload Payload of the base record
+   * @param[in] payload_count Byte length of payload
+   * @details
+   * Call this in the same transaction that inserts the base record, so that the base record and
+   * its index records are committed or aborted together. Each call also counts as maintenance
+   * of one base write for verify_secondary_index_maintenance(). This does nothing else if the base
+   * storage has no secondary index, which costs only a scan of a few registration entries.
+   */
+  ErrorCode   apply_secondary_index_insert(
+    thread::Thread* context,
+    StorageId base_id,
+    const void* key,
+    uint16_t key_length,
+    const void* payload,
+    uint16_t payload_count);
+
+  /**
+   * @brief Deletes index records of a base record from all secondary indexes of the base.
+   * @details
+   * Same as apply_secondary_index_insert() except this deletes. The payload must be the one
+   * before the deletion because the extractor needs it to compute the secondary keys.
+   */
+  ErrorCode   apply_secondary_index_delete(
+    thread::Thread* context,
+    StorageId base_id,
+    const void* key,
+    uint16_t key_length,
+    const void* payload,
+    uint16_t payload_count);
+
+  /**
+   * @brief Maintains secondary indexes for a base record whose payload changes.
+   * @details
+   * Index records are replaced only in indexes whose secondary key actually changed, so
+   * an update that does not touch indexed columns adds nothing to the write set.
+   */
+  ErrorCode   apply_secondary_index_update(
+    thread::Thread* context,
+    StorageId base_id,
+    const void* key,
+    uint16_t key_length,
+    const void* old_payload,
+    uint16_t old_payload_count,
+    const void* new_payload,
+    uint16_t new_payload_count);
+
+  /**
+   * @brief Checks that a transaction maintained secondary indexes for its writes.
+   * @return whether the transaction called apply_secondary_index_insert() or its siblings
+   * at least as many times as it wrote to storages that have a ready secondary index.
+   * @details
+   * Called from precommit of read-write transactions, which then aborts with
+   * kErrorCodeXctSecondaryIndexNotMaintained. This costs nothing when no index is registered.
+   * Indexes in the building state are not checked because finish_secondary_index_build()
+   * catches up with such writes.
+   */
+  bool        verify_secondary_index_maintenance(const xct::Xct& xct) const;
+
+  /**
+   * @brief Populates a registered secondary index from the existing records of its base.
+   * @param[in] context Thread context, which must  NOT be in a transaction.
+   * @param[in] index_id ID of the index storage, which must be registered beforehand.
+   * @param[in] partition Which partition of the base storage this thread scans.
+   * @param[in] partition_count Number of threads that build this index concurrently.
+   * @details
+   * The key space of the base storage is divided into partition_count ranges based on the
+   * boundaries of its volatile pages, and this method scans only one of them. Hence, the usual
+   * way is to impersonate partition_count threads, one per NUMA node with
+   * thread::ThreadPool::impersonate_on_numa_node(), each of which calls this method with its own
+   * partition. The scan runs in many small transactions, so other
+   * transactions keep running meanwhile and maintain the index as usual.
+   * Index records that already exist (because a concurrent transaction inserted them) are
+   * skipped.
+   * After all partitions are built, call finish_secondary_index_build().
+   */
+  ErrorStack  build_secondary_index(
+    thread::Thread* context,
+    StorageId index_id,
+    uint16_t partition,
+    uint16_t partition_count);
+
+  /**
+   * @brief Makes a secondary index in the building state consistent with its base and
+   * switches it to the ready state.
+   * @param[in] context Thread context, which must  NOT be in a transaction.
+   * @param[in] index_id ID of the index storage, which must be registered beforehand.
+   * @details
+   * Transactions that began before register_secondary_index() might have modified the base
+   * without maintaining the index, and build_secondary_index() might have scanned the base
+   * before they committed. This method waits for such transactions to finish, then scans
+   * the base to insert missing index records and scans the index to delete index records
+   * whose base record is gone or has a different secondary key. Meanwhile, other transactions
+   * keep running and maintain the index. From then on, they maintain it strictly, returning
+   * errors on a missing or duplicate index record.
+   * Unlike build_secondary_index(), this scans the whole base and index in the calling thread.
+   * Transactions need engine threads, and the storage manager does not impersonate them on its
+   * own. Hence, the parallel part of an online build is build_secondary_index(), which the
+   * application runs on one impersonated thread per NUMA node, for example with
+   * thread::ThreadPool::impersonate_on_numa_node().
+   */
+  ErrorStack  finish_secondary_index_build(thread::Thread* context, StorageId index_id);
+
   /** Returns pimpl object. Use this only if you know what you are doing. */
   StorageManagerPimpl* get_pimpl() { return pimpl_; }
 
@@ -17,6 +17,7 @@
  */
 #ifndef FOEDUS_STORAGE_STORAGE_MANAGER_PIMPL_HPP_
 #define FOEDUS_STORAGE_STORAGE_MANAGER_PIMPL_HPP_
+#include <cstring>
 #include <map>
 #include <mutex>
 #include <string>
@@ -29,6 +30,7 @@
 #include "foedus/soc/shared_memory_repo.hpp"
 #include "foedus/soc/shared_mutex.hpp"
 #include "foedus/storage/fwd.hpp"
+#include "foedus/storage/secondary_index.hpp"
 #include "foedus/storage/storage.hpp"
 #include "foedus/storage/storage_id.hpp"
 #include "foedus/storage/storage_manager.hpp"
@@ -44,6 +46,15 @@ struct StorageManagerControlBlock {
 
   void initialize() {
     mod_lock_.initialize();
+    secondary_index_count_ = 0;
+    for (uint32_t i = 0; i < SecondaryIndex::kMaxSecondaryIndexes; ++i) {
+      SecondaryIndex* entry = secondary_indexes_ + i;
+      entry->version_ = 0;
+      entry->state_ = SecondaryIndex::kFree;
+      entry->base_id_ = 0;
+      entry->index_id_ = 0;
+      entry->extractor_ = proc::ProcName();
+    }
   }
   void uninitialize() {
     mod_lock_.uninitialize();
@@ -61,6 +72,30 @@ struct StorageManagerControlBlock {
    * This value +1 would be the ID of the storage created next.
    */
   StorageId               largest_storage_id_;
+
+  /**
+   * Number of entries ever used in secondary_indexes_, which only grows. Modifications take
+   * mod_lock_. Readers (transactions applying index maintenance) read it without lock.
+   */
+  uint32_t                secondary_index_count_;
+  /** Registered secondary indexes. Unregistered entries become kFree and are reused. */
+  SecondaryIndex          secondary_indexes_[SecondaryIndex::kMaxSecondaryIndexes];
+};
+
+/**
+ * @brief An extractor procedure resolved in this process.
+ * @details
+ * proc::Proc is a function pointer, so it is valid only in the process that resolved it.
+ * Hence this is a process-local cache, not in shared memory. version_ is the
+ * SecondaryIndex::version_ of the registration the procedure was resolved for, 0 if empty,
+ * kFilling while a thread is filling it.
+ */
+struct CachedExtractor {
+  enum Constants {
+    kFilling = 1,
+  };
+  uint32_t    version_;
+  proc::Proc  proc_;
 };
 
 /**
@@ -73,7 +108,9 @@ struct StorageManagerControlBlock {
 class StorageManagerPimpl final : public DefaultInitializable {
  public:
   StorageManagerPimpl() = delete;
-  explicit StorageManagerPimpl(Engine* engine) : engine_(engine) {}
+  explicit StorageManagerPimpl(Engine* engine) : engine_(engine) {
+    std::memset(extractor_cache_, 0, sizeof(extractor_cache_));
+  }
   ErrorStack  initialize_once() override;
   ErrorStack  initialize_read_latest_snapshot();
   ErrorStack  uninitialize_once() override;
@@ -111,8 +148,54 @@ class StorageManagerPimpl final : public DefaultInitializable {
     StorageId storage_id,
     xct::RwLockableXctId* old_address,
     xct::WriteXctAccess *write);
+  bool        verify_range_access(
+    const xct::RangeXctAccess& access,
+    const xct::CurrentLockList* own_locks);
   ErrorStack  clone_all_storage_metadata(snapshot::SnapshotMetadata *metadata);
 
+  // Secondary indexes. Defined in storage_manager_secondary_index.cpp
+  ErrorStack  register_secondary_index(
+    StorageId base_id,
+    StorageId index_id,
+    const proc::ProcName& extractor);
+  void        unregister_secondary_indexes(StorageId id);
+  ErrorCode   apply_secondary_index_insert(
+    thread::Thread* context,
+    StorageId base_id,
+    const void* key,
+    uint16_t key_length,
+    const void* payload,
+    uint16_t payload_count);
+  ErrorCode   apply_secondary_index_delete(
+    thread::Thread* context,
+    StorageId base_id,
+    const void* key,
+    uint16_t key_length,
+    const void* payload,
+    uint16_t payload_count);
+  ErrorCode   apply_secondary_index_update(
+    thread::Thread* context,
+    StorageId base_id,
+    const void* key,
+    uint16_t key_length,
+    const void* old_payload,
+    uint16_t old_payload_count,
+    const void* new_payload,
+    uint16_t new_payload_count);
+  bool        verify_secondary_index_maintenance(const xct::Xct& xct) const;
+  ErrorStack  build_secondary_index(
+    thread::Thread* context,
+    StorageId index_id,
+    uint16_t partition,
+    uint16_t partition_count);
+  ErrorStack  finish_secondary_index_build(thread::Thread* context, StorageId index_id);
+  /** Copies the entry at the slot without lock. False if it's free or not of the base. */
+  bool        read_secondary_index(uint32_t slot, StorageId base_id, SecondaryIndex* out) const;
+  /** Looks up a registration by the index storage, taking mod_lock_. */
+  ErrorStack  find_secondary_index(StorageId index_id, uint32_t* slot, SecondaryIndex* out);
+  /** Returns the extractor of the registration at the slot, resolving it at the first use. */
+  ErrorCode   resolve_extractor(uint32_t slot, const SecondaryIndex& index, proc::Proc* out);
+
   uint32_t    get_max_storages() const;
 
   Engine* const           engine_;
@@ -133,6 +216,9 @@ class StorageManagerPimpl final : public DefaultInitializable {
    * This is why get_storage(string) is more expensive.
    */
   storage::StorageId*     storage_name_sort_;
+
+  /** Extractors of secondary indexes in this process. Index is the slot in secondary_indexes_ */
+  CachedExtractor         extractor_cache_[SecondaryIndex::kMaxSecondaryIndexes];
 };
 
 static_assert(
@@ -38,6 +38,7 @@ struct  McsRwAsyncMapping;
 struct  McsWwLock;
 struct  McsWwBlock;
 struct  PointerAccess;
+struct  RangeXctAccess;
 struct  ReadXctAccess;
 class   RetrospectiveLockList;
 struct  RwLockableXctId;
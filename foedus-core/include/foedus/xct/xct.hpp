@@ -60,6 +60,7 @@ class Xct {
   enum Constants {
     kMaxPointerSets = 1024,
     kMaxPageVersionSets = 1024,
+    kMaxRangeSets = 1024,
   };
 
   Xct(Engine* engine, thread::Thread* context, thread::ThreadId thread_id);
@@ -85,10 +86,12 @@ class Xct {
     isolation_level_ = isolation_level;
     pointer_set_size_ = 0;
     page_version_set_size_ = 0;
+    range_set_size_ = 0;
     read_set_size_ = 0;
     write_set_size_ = 0;
     lock_free_read_set_size_ = 0;
     lock_free_write_set_size_ = 0;
+    secondary_index_maintenance_count_ = 0;
     *mcs_block_current_ = 0;
     *mcs_rw_async_mapping_current_ = 0;
     local_work_memory_cur_ = 0;
@@ -153,17 +156,30 @@ class Xct {
   thread::ThreadId    get_thread_id() const { return thread_id_; }
   uint32_t            get_pointer_set_size() const { return pointer_set_size_; }
   uint32_t            get_page_version_set_size() const { return page_version_set_size_; }
+  uint32_t            get_range_set_size() const { return range_set_size_; }
   uint32_t            get_read_set_size() const { return read_set_size_; }
   uint32_t            get_write_set_size() const { return write_set_size_; }
   uint32_t            get_lock_free_read_set_size() const { return lock_free_read_set_size_; }
   uint32_t            get_lock_free_write_set_size() const { return lock_free_write_set_size_; }
   const PointerAccess*   get_pointer_set() const { return pointer_set_; }
   const PageVersionAccess*  get_page_version_set() const { return page_version_set_; }
+  const RangeXctAccess*     get_range_set() const { return range_set_; }
   ReadXctAccess*      get_read_set()  { return read_set_; }
   WriteXctAccess*     get_write_set() { return write_set_; }
+  const WriteXctAccess* get_write_set() const { return write_set_; }
   LockFreeReadXctAccess* get_lock_free_read_set() { return lock_free_read_set_; }
   LockFreeWriteXctAccess* get_lock_free_write_set() { return lock_free_write_set_; }
 
+  /**
+   * Number of base-storage writes this transaction reported to
+   * storage::StorageManager::apply_secondary_index_insert() and its siblings.
+   * Precommit compares it with the writes to storages that have a ready secondary index.
+   */
+  uint32_t  get_secondary_index_maintenance_count() const {
+    return secondary_index_maintenance_count_;
+  }
+  void      increment_secondary_index_maintenance_count() { ++secondary_index_maintenance_count_; }
+
 
   /**
    * @brief Called while a successful commit of xct to issue a new xct id.
@@ -225,6 +241,28 @@ class Xct {
     const storage::PageVersion* version_address,
     storage::PageVersionStatus observed);
 
+  /**
+   * @brief Add the given key range in a page to the range set of this transaction.
+   * @param[in] storage_id the storage the page belongs to
+   * @param[in] version_address address of the page version of the page
+   * @param[in] observed page version as of reading the key count
+   * @param[in] observed_key_count number of records in the page we have seen
+   * @param[in] low inclusive beginning of the range (storage-specific)
+   * @param[in] high inclusive end of the range (storage-specific)
+   * @details
+   * This is a finer-grained version of add_to_page_version_set() to protect the lack of
+   * records in the given range. Concurrent inserts to the page do not abort this transaction
+   * as far as their keys are outside of the range.
+   * @see RangeXctAccess
+   */
+  ErrorCode           add_to_range_set(
+    storage::StorageId storage_id,
+    const storage::PageVersion* version_address,
+    storage::PageVersionStatus observed,
+    uint16_t observed_key_count,
+    uint64_t low,
+    uint64_t high);
+
   /**
    * @brief The general logic invoked for every record read.
    * @param[in] intended_for_write Hints whether the record will be written after this read
@@ -517,6 +555,12 @@ class Xct {
   PageVersionAccess*  page_version_set_;
   uint32_t            page_version_set_size_;
 
+  RangeXctAccess*     range_set_;
+  uint32_t            range_set_size_;
+
+  /** @see get_secondary_index_maintenance_count() */
+  uint32_t            secondary_index_maintenance_count_;
+
   /**
    * CLL (current-lock-list) of this thread.
    * @see foedus::xct::CurrentLockList
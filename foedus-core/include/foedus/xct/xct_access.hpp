@@ -79,6 +79,44 @@ struct PageVersionAccess {
   storage::PageVersionStatus observed_;
 };
 
+/**
+ * @brief Represents a key range read in a page during a transaction.
+ * @ingroup XCT
+ * @details
+ * This is a finer-grained alternative of PageVersionAccess to protect the \e lack of records,
+ * or phantoms. PageVersionAccess aborts the transaction whenever anything happens to the page.
+ * This one remembers the number of records in the page and the range of keys we were
+ * interested in. At precommit, we check only the records that were added to the page after
+ * the access. Only when one of them is in the range, we abort the transaction.
+ *
+ * The meaning of the range is storage-specific. So far only \ref MASSTREE uses this, where
+ * low_ and high_ are KeySlice in the layer of the border page.
+ * Precommit asks the storage to verify it via StorageManager::verify_range_access().
+ * @par POD
+ * This is a POD struct. Default destructor/copy-constructor/assignment operator work fine.
+ */
+struct RangeXctAccess {
+  friend std::ostream& operator<<(std::ostream& o, const RangeXctAccess& v);
+
+  /** The storage we accessed. */
+  storage::StorageId          storage_id_;
+
+  /** Number of records in the page as of the access. */
+  uint16_t                    observed_key_count_;
+
+  /** Value of the page version as of the access. */
+  storage::PageVersionStatus  observed_;
+
+  /** Address to the page version. The page itself is to_page(address_). */
+  const storage::PageVersion* address_;
+
+  /** Inclusive beginning of the range. */
+  uint64_t                    low_;
+
+  /** Inclusive end of the range. */
+  uint64_t                    high_;
+};
+
 /** Base of ReadXctAccess and WriteXctAccess. No virtual anything. POD. */
 struct RecordXctAccess {
   /** The storage we accessed. */
@@ -187,6 +187,8 @@ class XctManagerPimpl final : public DefaultInitializable {
   bool        precommit_xct_verify_pointer_set(thread::Thread* context);
   /** Returns false if there is any page version conflict */
   bool        precommit_xct_verify_page_version_set(thread::Thread* context);
+  /** Returns false if there is any new record in the ranges we have read */
+  bool        precommit_xct_verify_range_set(thread::Thread* context);
   /**
    * @brief Phase 3 of precommit_xct()
    * @param[in] context thread context
@@ -0,0 +1,709 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include "foedus/assorted/simd_aggregate.hpp"
+
+// Same conditions as simd_search.cpp.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#define FOEDUS_SIMD_AGGREGATE_X86
+#include <immintrin.h>
+#if defined(__clang__) || (__GNUC__ >= 5)
+#define FOEDUS_SIMD_AGGREGATE_AVX512
+#endif  // defined(__clang__) || (__GNUC__ >= 5)
+#endif  // defined(__x86_64__) && defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "foedus/assert_nd.hpp"
+
+namespace foedus {
+namespace assorted {
+namespace {
+
+/**
+ * Kernel for 64-bit integers. Values are XOR-ed with bias before min/max, so that the same
+ * signed comparison works for unsigned values with bias = the sign bit. min/max are returned
+ * in the biased domain. The sum is not affected by the bias.
+ */
+typedef void (*IntAggregateFunc)(
+  const int64_t* base,
+  int32_t stride,
+  uint32_t count,
+  int64_t bias,
+  int64_t* sum,
+  int64_t* min,
+  int64_t* max);
+typedef void (*DoubleAggregateFunc)(
+  const double* base,
+  int32_t stride,
+  uint32_t count,
+  double* sum,
+  double* min,
+  double* max);
+
+/**
+ * Kernels of simd_add_scattered(). Signed and unsigned integers share the same kernel because
+ * wrap-around additions are same in both.
+ */
+typedef void (*IntAddFunc)(
+  int64_t* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const int64_t* addenda,
+  uint32_t count);
+typedef void (*DoubleAddFunc)(
+  double* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const double* addenda,
+  uint32_t count);
+
+const int64_t kSignBit = std::numeric_limits<int64_t>::min();
+const int64_t kInt64Min = std::numeric_limits<int64_t>::min();
+const int64_t kInt64Max = std::numeric_limits<int64_t>::max();
+const double kDoubleMax = std::numeric_limits<double>::max();
+
+////////////////////////////////////////////////////////////////////////////////
+///
+///      Scalar versions
+///
+////////////////////////////////////////////////////////////////////////////////
+void aggregate_int_scalar(
+  const int64_t* base,
+  int32_t stride,
+  uint32_t count,
+  int64_t bias,
+  int64_t* sum,
+  int64_t* min,
+  int64_t* max) {
+  // unsigned arithmetic so that overflows wrap around without undefined behavior
+  uint64_t total = 0;
+  int64_t cur_min = kInt64Max;
+  int64_t cur_max = kInt64Min;
+  for (uint32_t i = 0; i < count; ++i) {
+    const int64_t value = base[static_cast<int64_t>(i) * stride];
+    total += static_cast<uint64_t>(value);
+    cur_min = std::min<int64_t>(cur_min, value ^ bias);
+    cur_max = std::max<int64_t>(cur_max, value ^ bias);
+  }
+  *sum = static_cast<int64_t>(total);
+  *min = cur_min;
+  *max = cur_max;
+}
+
+void aggregate_double_scalar(
+  const double* base,
+  int32_t stride,
+  uint32_t count,
+  double* sum,
+  double* min,
+  double* max) {
+  double total = 0;
+  double cur_min = kDoubleMax;
+  double cur_max = -kDoubleMax;
+  for (uint32_t i = 0; i < count; ++i) {
+    const double value = base[static_cast<int64_t>(i) * stride];
+    total += value;
+    cur_min = std::min<double>(cur_min, value);
+    cur_max = std::max<double>(cur_max, value);
+  }
+  *sum = total;
+  *min = cur_min;
+  *max = cur_max;
+}
+
+void add_int_scalar(
+  int64_t* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const int64_t* addenda,
+  uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    // in unsigned to wrap around
+    int64_t* target = base + static_cast<int64_t>(indexes[i]) * stride;
+    *reinterpret_cast<uint64_t*>(target) += static_cast<uint64_t>(addenda[i]);
+  }
+}
+
+void add_double_scalar(
+  double* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const double* addenda,
+  uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    base[static_cast<int64_t>(indexes[i]) * stride] += addenda[i];
+  }
+}
+
+#ifdef FOEDUS_SIMD_AGGREGATE_X86
+////////////////////////////////////////////////////////////////////////////////
+///
+///      AVX2 versions
+///
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx2")))
+void aggregate_int_avx2(
+  const int64_t* base,
+  int32_t stride,
+  uint32_t count,
+  int64_t bias,
+  int64_t* sum,
+  int64_t* min,
+  int64_t* max) {
+  const __m256i biases = _mm256_set1_epi64x(bias);
+  const __m256i steps = _mm256_set1_epi64x(static_cast<int64_t>(stride) * 4);
+  __m256i indexes = _mm256_set_epi64x(
+    static_cast<int64_t>(stride) * 3,
+    static_cast<int64_t>(stride) * 2,
+    stride,
+    0);
+  __m256i sums = _mm256_setzero_si256();
+  __m256i mins = _mm256_set1_epi64x(kInt64Max);
+  __m256i maxs = _mm256_set1_epi64x(kInt64Min);
+  const long long* gather_base = reinterpret_cast<const long long*>(base);  // NOLINT(runtime/int)
+  uint32_t i = 0;
+  for (; i + 4U <= count; i += 4U) {
+    const __m256i values = _mm256_i64gather_epi64(gather_base, indexes, 8);
+    sums = _mm256_add_epi64(sums, values);
+    // AVX2 has no 64-bit min/max. Blend by the result of the signed comparison.
+    const __m256i biased = _mm256_xor_si256(values, biases);
+    mins = _mm256_blendv_epi8(mins, biased, _mm256_cmpgt_epi64(mins, biased));
+    maxs = _mm256_blendv_epi8(maxs, biased, _mm256_cmpgt_epi64(biased, maxs));
+    indexes = _mm256_add_epi64(indexes, steps);
+  }
+
+  int64_t lane_sums[4];
+  int64_t lane_mins[4];
+  int64_t lane_maxs[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_sums), sums);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_mins), mins);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_maxs), maxs);
+  int64_t rest_sum;
+  int64_t rest_min;
+  int64_t rest_max;
+  aggregate_int_scalar(
+    base + static_cast<int64_t>(i) * stride,
+    stride,
+    count - i,
+    bias,
+    &rest_sum,
+    &rest_min,
+    &rest_max);
+  uint64_t total = static_cast<uint64_t>(rest_sum);
+  for (uint16_t lane = 0; lane < 4U; ++lane) {
+    total += static_cast<uint64_t>(lane_sums[lane]);
+    rest_min = std::min<int64_t>(rest_min, lane_mins[lane]);
+    rest_max = std::max<int64_t>(rest_max, lane_maxs[lane]);
+  }
+  *sum = static_cast<int64_t>(total);
+  *min = rest_min;
+  *max = rest_max;
+}
+
+__attribute__((target("avx2")))
+void aggregate_double_avx2(
+  const double* base,
+  int32_t stride,
+  uint32_t count,
+  double* sum,
+  double* min,
+  double* max) {
+  const __m256i steps = _mm256_set1_epi64x(static_cast<int64_t>(stride) * 4);
+  __m256i indexes = _mm256_set_epi64x(
+    static_cast<int64_t>(stride) * 3,
+    static_cast<int64_t>(stride) * 2,
+    stride,
+    0);
+  __m256d sums = _mm256_setzero_pd();
+  __m256d mins = _mm256_set1_pd(kDoubleMax);
+  __m256d maxs = _mm256_set1_pd(-kDoubleMax);
+  uint32_t i = 0;
+  for (; i + 4U <= count; i += 4U) {
+    const __m256d values = _mm256_i64gather_pd(base, indexes, 8);
+    sums = _mm256_add_pd(sums, values);
+    mins = _mm256_min_pd(mins, values);
+    maxs = _mm256_max_pd(maxs, values);
+    indexes = _mm256_add_epi64(indexes, steps);
+  }
+
+  double lane_sums[4];
+  double lane_mins[4];
+  double lane_maxs[4];
+  _mm256_storeu_pd(lane_sums, sums);
+  _mm256_storeu_pd(lane_mins, mins);
+  _mm256_storeu_pd(lane_maxs, maxs);
+  double rest_sum;
+  double rest_min;
+  double rest_max;
+  aggregate_double_scalar(
+    base + static_cast<int64_t>(i) * stride,
+    stride,
+    count - i,
+    &rest_sum,
+    &rest_min,
+    &rest_max);
+  double total = 0;
+  for (uint16_t lane = 0; lane < 4U; ++lane) {
+    total += lane_sums[lane];
+    rest_min = std::min<double>(rest_min, lane_mins[lane]);
+    rest_max = std::max<double>(rest_max, lane_maxs[lane]);
+  }
+  *sum = total + rest_sum;
+  *min = rest_min;
+  *max = rest_max;
+}
+
+/** Loads 4 element ordinals and converts them to 64-bit element positions */
+__attribute__((target("avx2")))
+inline __m256i to_positions_avx2(const uint16_t* indexes, __m256i strides) {
+  const __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(indexes));
+  return _mm256_mul_epu32(_mm256_cvtepu16_epi64(packed), strides);
+}
+
+__attribute__((target("avx2")))
+void add_int_avx2(
+  int64_t* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const int64_t* addenda,
+  uint32_t count) {
+  const __m256i strides = _mm256_set1_epi64x(stride);
+  const long long* gather_base = reinterpret_cast<const long long*>(base);  // NOLINT(runtime/int)
+  uint32_t i = 0;
+  for (; i + 4U <= count; i += 4U) {
+    const __m256i positions = to_positions_avx2(indexes + i, strides);
+    const __m256i values = _mm256_i64gather_epi64(gather_base, positions, 8);
+    const __m256i added = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(addenda + i));
+    // AVX2 has no scatter. Store lane by lane.
+    int64_t lane_positions[4];
+    int64_t lane_sums[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_positions), positions);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_sums), _mm256_add_epi64(values, added));
+    for (uint16_t lane = 0; lane < 4U; ++lane) {
+      base[lane_positions[lane]] = lane_sums[lane];
+    }
+  }
+  add_int_scalar(base, stride, indexes + i, addenda + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void add_double_avx2(
+  double* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const double* addenda,
+  uint32_t count) {
+  const __m256i strides = _mm256_set1_epi64x(stride);
+  uint32_t i = 0;
+  for (; i + 4U <= count; i += 4U) {
+    const __m256i positions = to_positions_avx2(indexes + i, strides);
+    const __m256d values = _mm256_i64gather_pd(base, positions, 8);
+    int64_t lane_positions[4];
+    double lane_sums[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_positions), positions);
+    _mm256_storeu_pd(lane_sums, _mm256_add_pd(values, _mm256_loadu_pd(addenda + i)));
+    for (uint16_t lane = 0; lane < 4U; ++lane) {
+      base[lane_positions[lane]] = lane_sums[lane];
+    }
+  }
+  add_double_scalar(base, stride, indexes + i, addenda + i, count - i);
+}
+
+#ifdef FOEDUS_SIMD_AGGREGATE_AVX512
+////////////////////////////////////////////////////////////////////////////////
+///
+///      AVX-512 versions
+///
+////////////////////////////////////////////////////////////////////////////////
+inline __mmask8 tail_mask(uint32_t remaining) {
+  return remaining >= 8U ? 0xFF : static_cast<__mmask8>((1U << remaining) - 1U);
+}
+
+__attribute__((target("avx512f")))
+void aggregate_int_avx512(
+  const int64_t* base,
+  int32_t stride,
+  uint32_t count,
+  int64_t bias,
+  int64_t* sum,
+  int64_t* min,
+  int64_t* max) {
+  const __m512i biases = _mm512_set1_epi64(bias);
+  const __m512i steps = _mm512_set1_epi64(static_cast<int64_t>(stride) * 8);
+  const int64_t s = stride;
+  __m512i indexes = _mm512_set_epi64(s * 7, s * 6, s * 5, s * 4, s * 3, s * 2, s, 0);
+  __m512i sums = _mm512_setzero_si512();
+  __m512i mins = _mm512_set1_epi64(kInt64Max);
+  __m512i maxs = _mm512_set1_epi64(kInt64Min);
+  for (uint32_t i = 0; i < count; i += 8U) {
+    // Masked-out lanes are neither gathered nor aggregated.
+    const __mmask8 mask = tail_mask(count - i);
+    const __m512i values = _mm512_mask_i64gather_epi64(
+      _mm512_setzero_si512(),
+      mask,
+      indexes,
+      base,
+      8);
+    sums = _mm512_mask_add_epi64(sums, mask, sums, values);
+    const __m512i biased = _mm512_xor_si512(values, biases);
+    mins = _mm512_mask_min_epi64(mins, mask, mins, biased);
+    maxs = _mm512_mask_max_epi64(maxs, mask, maxs, biased);
+    indexes = _mm512_add_epi64(indexes, steps);
+  }
+
+  int64_t lane_sums[8];
+  int64_t lane_mins[8];
+  int64_t lane_maxs[8];
+  _mm512_storeu_si512(lane_sums, sums);
+  _mm512_storeu_si512(lane_mins, mins);
+  _mm512_storeu_si512(lane_maxs, maxs);
+  uint64_t total = 0;
+  int64_t cur_min = kInt64Max;
+  int64_t cur_max = kInt64Min;
+  for (uint16_t lane = 0; lane < 8U; ++lane) {
+    total += static_cast<uint64_t>(lane_sums[lane]);
+    cur_min = std::min<int64_t>(cur_min, lane_mins[lane]);
+    cur_max = std::max<int64_t>(cur_max, lane_maxs[lane]);
+  }
+  *sum = static_cast<int64_t>(total);
+  *min = cur_min;
+  *max = cur_max;
+}
+
+__attribute__((target("avx512f")))
+void aggregate_double_avx512(
+  const double* base,
+  int32_t stride,
+  uint32_t count,
+  double* sum,
+  double* min,
+  double* max) {
+  const __m512i steps = _mm512_set1_epi64(static_cast<int64_t>(stride) * 8);
+  const int64_t s = stride;
+  __m512i indexes = _mm512_set_epi64(s * 7, s * 6, s * 5, s * 4, s * 3, s * 2, s, 0);
+  __m512d sums = _mm512_setzero_pd();
+  __m512d mins = _mm512_set1_pd(kDoubleMax);
+  __m512d maxs = _mm512_set1_pd(-kDoubleMax);
+  for (uint32_t i = 0; i < count; i += 8U) {
+    const __mmask8 mask = tail_mask(count - i);
+    const __m512d values = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), mask, indexes, base, 8);
+    sums = _mm512_mask_add_pd(sums, mask, sums, values);
+    mins = _mm512_mask_min_pd(mins, mask, mins, values);
+    maxs = _mm512_mask_max_pd(maxs, mask, maxs, values);
+    indexes = _mm512_add_epi64(indexes, steps);
+  }
+
+  double lane_sums[8];
+  double lane_mins[8];
+  double lane_maxs[8];
+  _mm512_storeu_pd(lane_sums, sums);
+  _mm512_storeu_pd(lane_mins, mins);
+  _mm512_storeu_pd(lane_maxs, maxs);
+  double total = 0;
+  double cur_min = kDoubleMax;
+  double cur_max = -kDoubleMax;
+  for (uint16_t lane = 0; lane < 8U; ++lane) {
+    total += lane_sums[lane];
+    cur_min = std::min<double>(cur_min, lane_mins[lane]);
+    cur_max = std::max<double>(cur_max, lane_maxs[lane]);
+  }
+  *sum = total;
+  *min = cur_min;
+  *max = cur_max;
+}
+
+/** Loads 8 element ordinals and converts them to 64-bit element positions */
+__attribute__((target("avx512f")))
+inline __m512i to_positions_avx512(const uint16_t* indexes, __m512i strides) {
+  // All-lane masks just to avoid the undefined-source versions, which older gcc complains about.
+  const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indexes));
+  return _mm512_maskz_mul_epu32(0xFF, _mm512_maskz_cvtepu16_epi64(0xFF, packed), strides);
+}
+
+__attribute__((target("avx512f")))
+void add_int_avx512(
+  int64_t* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const int64_t* addenda,
+  uint32_t count) {
+  const __m512i strides = _mm512_set1_epi64(stride);
+  uint32_t i = 0;
+  for (; i + 8U <= count; i += 8U) {
+    const __m512i positions = to_positions_avx512(indexes + i, strides);
+    const __m512i values = _mm512_mask_i64gather_epi64(
+      _mm512_setzero_si512(),
+      0xFF,
+      positions,
+      base,
+      8);
+    const __m512i sums = _mm512_add_epi64(values, _mm512_loadu_si512(addenda + i));
+    // indexes are distinct, so lanes never conflict in the scatter.
+    _mm512_i64scatter_epi64(base, positions, sums, 8);
+  }
+  add_int_scalar(base, stride, indexes + i, addenda + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+void add_double_avx512(
+  double* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const double* addenda,
+  uint32_t count) {
+  const __m512i strides = _mm512_set1_epi64(stride);
+  uint32_t i = 0;
+  for (; i + 8U <= count; i += 8U) {
+    const __m512i positions = to_positions_avx512(indexes + i, strides);
+    const __m512d values = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), 0xFF, positions, base, 8);
+    const __m512d sums = _mm512_add_pd(values, _mm512_loadu_pd(addenda + i));
+    _mm512_i64scatter_pd(base, positions, sums, 8);
+  }
+  add_double_scalar(base, stride, indexes + i, addenda + i, count - i);
+}
+#endif  // FOEDUS_SIMD_AGGREGATE_AVX512
+#endif  // FOEDUS_SIMD_AGGREGATE_X86
+
+////////////////////////////////////////////////////////////////////////////////
+///
+///      Runtime dispatch
+///
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * Like simd_search.hpp, we pick the kernel per call from get_simd_level().
+ * One switch per call is negligible as each call aggregates a whole page.
+ */
+SimdLevel supported_level(SimdLevel requested) {
+  const SimdLevel detected = get_simd_level();
+  return requested <= detected ? requested : detected;
+}
+
+IntAggregateFunc to_int_func(SimdLevel level) {
+  switch (level) {
+#ifdef FOEDUS_SIMD_AGGREGATE_X86
+#ifdef FOEDUS_SIMD_AGGREGATE_AVX512
+  case kSimdAvx512:
+    return aggregate_int_avx512;
+#endif  // FOEDUS_SIMD_AGGREGATE_AVX512
+  case kSimdAvx2:
+    return aggregate_int_avx2;
+#endif  // FOEDUS_SIMD_AGGREGATE_X86
+  default:
+    return aggregate_int_scalar;
+  }
+}
+
+DoubleAggregateFunc to_double_func(SimdLevel level) {
+  switch (level) {
+#ifdef FOEDUS_SIMD_AGGREGATE_X86
+#ifdef FOEDUS_SIMD_AGGREGATE_AVX512
+  case kSimdAvx512:
+    return aggregate_double_avx512;
+#endif  // FOEDUS_SIMD_AGGREGATE_AVX512
+  case kSimdAvx2:
+    return aggregate_double_avx2;
+#endif  // FOEDUS_SIMD_AGGREGATE_X86
+  default:
+    return aggregate_double_scalar;
+  }
+}
+
+IntAddFunc to_int_add_func(SimdLevel level) {
+  switch (level) {
+#ifdef FOEDUS_SIMD_AGGREGATE_X86
+#ifdef FOEDUS_SIMD_AGGREGATE_AVX512
+  case kSimdAvx512:
+    return add_int_avx512;
+#endif  // FOEDUS_SIMD_AGGREGATE_AVX512
+  case kSimdAvx2:
+    return add_int_avx2;
+#endif  // FOEDUS_SIMD_AGGREGATE_X86
+  default:
+    return add_int_scalar;
+  }
+}
+
+DoubleAddFunc to_double_add_func(SimdLevel level) {
+  switch (level) {
+#ifdef FOEDUS_SIMD_AGGREGATE_X86
+#ifdef FOEDUS_SIMD_AGGREGATE_AVX512
+  case kSimdAvx512:
+    return add_double_avx512;
+#endif  // FOEDUS_SIMD_AGGREGATE_AVX512
+  case kSimdAvx2:
+    return add_double_avx2;
+#endif  // FOEDUS_SIMD_AGGREGATE_X86
+  default:
+    return add_double_scalar;
+  }
+}
+
+template <typename T>
+void aggregate_int(
+  IntAggregateFunc func,
+  int64_t bias,
+  const T* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<T>* out) {
+  ASSERT_ND(out);
+  if (count == 0) {
+    return;
+  }
+  int64_t sum;
+  int64_t min;
+  int64_t max;
+  func(reinterpret_cast<const int64_t*>(base), stride, count, bias, &sum, &min, &max);
+  SimdAggregate<T> result;
+  result.count_ = count;
+  result.sum_ = static_cast<T>(sum);
+  result.min_ = static_cast<T>(min ^ bias);
+  result.max_ = static_cast<T>(max ^ bias);
+  out->merge(result);
+}
+
+void aggregate_double(
+  DoubleAggregateFunc func,
+  const double* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<double>* out) {
+  ASSERT_ND(out);
+  if (count == 0) {
+    return;
+  }
+  SimdAggregate<double> result;
+  result.count_ = count;
+  func(base, stride, count, &result.sum_, &result.min_, &result.max_);
+  out->merge(result);
+}
+
+}  // namespace
+
+void simd_aggregate_strided(
+  const int64_t* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<int64_t>* out) {
+  aggregate_int(to_int_func(get_simd_level()), 0, base, stride, count, out);
+}
+
+void simd_aggregate_strided(
+  const uint64_t* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<uint64_t>* out) {
+  aggregate_int(to_int_func(get_simd_level()), kSignBit, base, stride, count, out);
+}
+
+void simd_aggregate_strided(
+  const double* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<double>* out) {
+  aggregate_double(to_double_func(get_simd_level()), base, stride, count, out);
+}
+
+void simd_aggregate_strided_with(
+  SimdLevel level,
+  const int64_t* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<int64_t>* out) {
+  aggregate_int(to_int_func(supported_level(level)), 0, base, stride, count, out);
+}
+
+void simd_aggregate_strided_with(
+  SimdLevel level,
+  const uint64_t* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<uint64_t>* out) {
+  aggregate_int(to_int_func(supported_level(level)), kSignBit, base, stride, count, out);
+}
+
+void simd_aggregate_strided_with(
+  SimdLevel level,
+  const double* base,
+  int32_t stride,
+  uint32_t count,
+  SimdAggregate<double>* out) {
+  aggregate_double(to_double_func(supported_level(level)), base, stride, count, out);
+}
+
+void simd_add_scattered(
+  int64_t* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const int64_t* addenda,
+  uint32_t count) {
+  ASSERT_ND(stride > 0);
+  to_int_add_func(get_simd_level())(base, stride, indexes, addenda, count);
+}
+
+void simd_add_scattered(
+  uint64_t* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const uint64_t* addenda,
+  uint32_t count) {
+  ASSERT_ND(stride > 0);
+  to_int_add_func(get_simd_level())(
+    reinterpret_cast<int64_t*>(base),
+    stride,
+    indexes,
+    reinterpret_cast<const int64_t*>(addenda),
+    count);
+}
+
+void simd_add_scattered(
+  double* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const double* addenda,
+  uint32_t count) {
+  ASSERT_ND(stride > 0);
+  to_double_add_func(get_simd_level())(base, stride, indexes, addenda, count);
+}
+
+void simd_add_scattered_with(
+  SimdLevel level,
+  int64_t* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const int64_t* addenda,
+  uint32_t count) {
+  ASSERT_ND(stride > 0);
+  to_int_add_func(supported_level(level))(base, stride, indexes, addenda, count);
+}
+
+void simd_add_scattered_with(
+  SimdLevel level,
+  double* base,
+  int32_t stride,
+  const uint16_t* indexes,
+  const double* addenda,
+  uint32_t count) {
+  ASSERT_ND(stride > 0);
+  to_double_add_func(supported_level(level))(base, stride, indexes, addenda, count);
+}
+
+}  // namespace assorted
+}  // namespace foedus
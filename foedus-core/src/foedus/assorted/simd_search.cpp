@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include "foedus/assorted/simd_search.hpp"
+
+// See armv8_support.hpp. [...]mintrin.h is not there on AArch64, and ICC doesn't understand
+// per-function target attributes in the way we use them. Scalar only in those environments.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#define FOEDUS_SIMD_SEARCH_X86
+#include <immintrin.h>
+// AVX-512 intrinsics with target attributes need gcc 5 or later (or clang).
+#if defined(__clang__) || (__GNUC__ >= 5)
+#define FOEDUS_SIMD_SEARCH_AVX512
+#endif  // defined(__clang__) || (__GNUC__ >= 5)
+#endif  // defined(__x86_64__) && defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#include <stdint.h>
+
+#include "foedus/assert_nd.hpp"
+
+namespace foedus {
+namespace assorted {
+
+typedef uint16_t (*SearchFunc)(const uint64_t* array, uint16_t from, uint16_t to, uint64_t value);
+typedef uint16_t (*StridedSearchFunc)(
+  const uint64_t* base,
+  int32_t stride,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value);
+
+#ifdef FOEDUS_SIMD_SEARCH_X86
+////////////////////////////////////////////////////////////////////////////////
+///
+///      AVX2 versions
+///
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * AVX2 has only signed 64-bit comparison. Flipping the sign bit of both operands
+ * makes a signed comparison equivalent to the unsigned one.
+ */
+const uint64_t kSignBit = 1ULL << 63;
+
+__attribute__((target("avx2")))
+uint16_t find_first_equal_avx2(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  const __m256i needle = _mm256_set1_epi64x(static_cast<int64_t>(value));
+  uint16_t i = from;
+  for (; i + 4U <= to; i += 4U) {
+    const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(array + i));
+    const __m256i cmp = _mm256_cmpeq_epi64(values, needle);
+    const int mask = _mm256_movemask_pd(_mm256_castsi256_pd(cmp));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  for (; i < to; ++i) {
+    if (array[i] == value) {
+      return i;
+    }
+  }
+  return to;
+}
+
+__attribute__((target("avx2")))
+uint16_t find_first_greater_avx2(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  const __m256i sign = _mm256_set1_epi64x(static_cast<int64_t>(kSignBit));
+  const __m256i needle = _mm256_set1_epi64x(static_cast<int64_t>(value ^ kSignBit));
+  uint16_t i = from;
+  for (; i + 4U <= to; i += 4U) {
+    const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(array + i));
+    const __m256i cmp = _mm256_cmpgt_epi64(_mm256_xor_si256(values, sign), needle);
+    const int mask = _mm256_movemask_pd(_mm256_castsi256_pd(cmp));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  for (; i < to; ++i) {
+    if (array[i] > value) {
+      return i;
+    }
+  }
+  return to;
+}
+
+__attribute__((target("avx2")))
+uint16_t find_first_equal_strided_avx2(
+  const uint64_t* base,
+  int32_t stride,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  const __m256i needle = _mm256_set1_epi64x(static_cast<int64_t>(value));
+  const int64_t step = static_cast<int64_t>(stride) * 4;
+  __m256i indexes = _mm256_set_epi64x(
+    (static_cast<int64_t>(from) + 3) * stride,
+    (static_cast<int64_t>(from) + 2) * stride,
+    (static_cast<int64_t>(from) + 1) * stride,
+    static_cast<int64_t>(from) * stride);
+  const __m256i steps = _mm256_set1_epi64x(step);
+  const long long* gather_base = reinterpret_cast<const long long*>(base);  // NOLINT(runtime/int)
+  uint16_t i = from;
+  for (; i + 4U <= to; i += 4U) {
+    const __m256i values = _mm256_i64gather_epi64(gather_base, indexes, 8);
+    const __m256i cmp = _mm256_cmpeq_epi64(values, needle);
+    const int mask = _mm256_movemask_pd(_mm256_castsi256_pd(cmp));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+    indexes = _mm256_add_epi64(indexes, steps);
+  }
+  for (; i < to; ++i) {
+    if (base[static_cast<int64_t>(i) * stride] == value) {
+      return i;
+    }
+  }
+  return to;
+}
+
+#else  // FOEDUS_SIMD_SEARCH_X86
+// get_simd_level() never returns these levels here. Defined only to be linked.
+uint16_t find_first_equal_avx2(const uint64_t* array, uint16_t from, uint16_t to, uint64_t value) {
+  return find_first_equal_scalar(array, from, to, value);
+}
+uint16_t find_first_greater_avx2(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  return find_first_greater_scalar(array, from, to, value);
+}
+uint16_t find_first_equal_strided_avx2(
+  const uint64_t* base,
+  int32_t stride,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  return find_first_equal_strided_scalar(base, stride, from, to, value);
+}
+#endif  // FOEDUS_SIMD_SEARCH_X86
+
+#ifdef FOEDUS_SIMD_SEARCH_AVX512
+////////////////////////////////////////////////////////////////////////////////
+///
+///      AVX-512 versions
+///
+////////////////////////////////////////////////////////////////////////////////
+/** Masked loads don't fault on masked-out lanes, so the remainder needs no scalar loop. */
+inline __mmask8 tail_mask(uint16_t remaining) {
+  return remaining >= 8U ? 0xFF : static_cast<__mmask8>((1U << remaining) - 1U);
+}
+
+__attribute__((target("avx512f")))
+uint16_t find_first_equal_avx512(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  const __m512i needle = _mm512_set1_epi64(static_cast<int64_t>(value));
+  for (uint16_t i = from; i < to; i += 8U) {
+    const __mmask8 load_mask = tail_mask(to - i);
+    const __m512i values = _mm512_maskz_loadu_epi64(load_mask, array + i);
+    const __mmask8 mask = _mm512_mask_cmpeq_epu64_mask(load_mask, values, needle);
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return to;
+}
+
+__attribute__((target("avx512f")))
+uint16_t find_first_greater_avx512(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  const __m512i needle = _mm512_set1_epi64(static_cast<int64_t>(value));
+  for (uint16_t i = from; i < to; i += 8U) {
+    const __mmask8 load_mask = tail_mask(to - i);
+    const __m512i values = _mm512_maskz_loadu_epi64(load_mask, array + i);
+    const __mmask8 mask = _mm512_mask_cmpgt_epu64_mask(load_mask, values, needle);
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return to;
+}
+__attribute__((target("avx512f")))
+uint16_t find_first_equal_strided_avx512(
+  const uint64_t* base,
+  int32_t stride,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  const __m512i needle = _mm512_set1_epi64(static_cast<int64_t>(value));
+  const __m512i steps = _mm512_set1_epi64(static_cast<int64_t>(stride) * 8);
+  const int64_t first = static_cast<int64_t>(from) * stride;
+  __m512i indexes = _mm512_set_epi64(
+    first + 7 * stride,
+    first + 6 * stride,
+    first + 5 * stride,
+    first + 4 * stride,
+    first + 3 * stride,
+    first + 2 * stride,
+    first + stride,
+    first);
+  for (uint16_t i = from; i < to; i += 8U) {
+    // Masked-out lanes are not gathered, so we never touch elements at or beyond "to".
+    const __mmask8 load_mask = tail_mask(to - i);
+    const __m512i values = _mm512_mask_i64gather_epi64(
+      _mm512_setzero_si512(),
+      load_mask,
+      indexes,
+      base,
+      8);
+    const __mmask8 mask = _mm512_mask_cmpeq_epu64_mask(load_mask, values, needle);
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+    indexes = _mm512_add_epi64(indexes, steps);
+  }
+  return to;
+}
+#else  // FOEDUS_SIMD_SEARCH_AVX512
+// get_simd_level() never returns kSimdAvx512 here. Defined only to be linked.
+uint16_t find_first_equal_avx512(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  return find_first_equal_scalar(array, from, to, value);
+}
+uint16_t find_first_greater_avx512(
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  return find_first_greater_scalar(array, from, to, value);
+}
+uint16_t find_first_equal_strided_avx512(
+  const uint64_t* base,
+  int32_t stride,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  return find_first_equal_strided_scalar(base, stride, from, to, value);
+}
+#endif  // FOEDUS_SIMD_SEARCH_AVX512
+
+////////////////////////////////////////////////////////////////////////////////
+///
+///      Runtime dispatch
+///
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+SimdLevel detect_simd_level() {
+#ifdef FOEDUS_SIMD_SEARCH_X86
+  // This might be called from a static initializer, before gcc's own constructor fills
+  // __cpu_model.
+  __builtin_cpu_init();
+#ifdef FOEDUS_SIMD_SEARCH_AVX512
+  if (__builtin_cpu_supports("avx512f")) {
+    return kSimdAvx512;
+  }
+#endif  // FOEDUS_SIMD_SEARCH_AVX512
+  if (__builtin_cpu_supports("avx2")) {
+    return kSimdAvx2;
+  }
+#endif  // FOEDUS_SIMD_SEARCH_X86
+  return kSimdScalar;
+}
+
+/** Returns the given level if supported, otherwise the best supported level. */
+SimdLevel supported_level(SimdLevel requested) {
+  const SimdLevel detected = detect_simd_level();
+  return requested <= detected ? requested : detected;
+}
+
+SearchFunc to_find_first_equal_func(SimdLevel level) {
+  switch (level) {
+#ifdef FOEDUS_SIMD_SEARCH_X86
+#ifdef FOEDUS_SIMD_SEARCH_AVX512
+  case kSimdAvx512:
+    return find_first_equal_avx512;
+#endif  // FOEDUS_SIMD_SEARCH_AVX512
+  case kSimdAvx2:
+    return find_first_equal_avx2;
+#endif  // FOEDUS_SIMD_SEARCH_X86
+  default:
+    return find_first_equal_scalar;
+  }
+}
+
+SearchFunc to_find_first_greater_func(SimdLevel level) {
+  switch (level) {
+#ifdef FOEDUS_SIMD_SEARCH_X86
+#ifdef FOEDUS_SIMD_SEARCH_AVX512
+  case kSimdAvx512:
+    return find_first_greater_avx512;
+#endif  // FOEDUS_SIMD_SEARCH_AVX512
+  case kSimdAvx2:
+    return find_first_greater_avx2;
+#endif  // FOEDUS_SIMD_SEARCH_X86
+  default:
+    return find_first_greater_scalar;
+  }
+}
+
+StridedSearchFunc to_find_first_equal_strided_func(SimdLevel level) {
+  switch (level) {
+#ifdef FOEDUS_SIMD_SEARCH_X86
+#ifdef FOEDUS_SIMD_SEARCH_AVX512
+  case kSimdAvx512:
+    return find_first_equal_strided_avx512;
+#endif  // FOEDUS_SIMD_SEARCH_AVX512
+  case kSimdAvx2:
+    return find_first_equal_strided_avx2;
+#endif  // FOEDUS_SIMD_SEARCH_X86
+  default:
+    return find_first_equal_strided_scalar;
+  }
+}
+
+}  // namespace
+
+// Constant-initialized, so there is no initialization-order issue.
+int8_t simd_level_cache = -1;
+
+SimdLevel detect_and_cache_simd_level() {
+  const SimdLevel level = detect_simd_level();
+  simd_level_cache = static_cast<int8_t>(level);
+  return level;
+}
+
+const char* to_simd_level_string(SimdLevel level) {
+  switch (level) {
+  case kSimdAvx2:
+    return "AVX2";
+  case kSimdAvx512:
+    return "AVX-512";
+  default:
+    return "Scalar";
+  }
+}
+
+uint16_t simd_find_first_equal_with(
+  SimdLevel level,
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  ASSERT_ND(from <= to);
+  return to_find_first_equal_func(supported_level(level))(array, from, to, value);
+}
+
+uint16_t simd_find_first_greater_with(
+  SimdLevel level,
+  const uint64_t* array,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  ASSERT_ND(from <= to);
+  return to_find_first_greater_func(supported_level(level))(array, from, to, value);
+}
+
+uint16_t simd_find_first_equal_strided_with(
+  SimdLevel level,
+  const uint64_t* base,
+  int32_t stride,
+  uint16_t from,
+  uint16_t to,
+  uint64_t value) {
+  ASSERT_ND(from <= to);
+  return to_find_first_equal_strided_func(supported_level(level))(base, stride, from, to, value);
+}
+
+}  // namespace assorted
+}  // namespace foedus
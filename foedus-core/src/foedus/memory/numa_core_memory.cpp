@@ -66,6 +66,7 @@ uint64_t NumaCoreMemory::calculate_local_small_memory_size(const EngineOptions&
   memory_size += static_cast<uint64_t>(options.thread_.thread_count_per_group_) << 12;
   memory_size += sizeof(xct::SysxctWorkspace);
   memory_size += sizeof(xct::PageVersionAccess) * xct::Xct::kMaxPageVersionSets;
+  memory_size += sizeof(xct::RangeXctAccess) * xct::Xct::kMaxRangeSets;
   memory_size += sizeof(xct::PointerAccess) * xct::Xct::kMaxPointerSets;
   const xct::XctOptions& xct_opt = options.xct_;
   const uint16_t nodes = options.thread_.group_count_;
@@ -114,6 +115,8 @@ ErrorStack NumaCoreMemory::initialize_once() {
   memory += sizeof(xct::SysxctWorkspace);
   small_thread_local_memory_pieces_.xct_page_version_memory_ = memory;
   memory += sizeof(xct::PageVersionAccess) * xct::Xct::kMaxPageVersionSets;
+  small_thread_local_memory_pieces_.xct_range_access_memory_ = memory;
+  memory += sizeof(xct::RangeXctAccess) * xct::Xct::kMaxRangeSets;
   small_thread_local_memory_pieces_.xct_pointer_access_memory_ = memory;
   memory += sizeof(xct::PointerAccess) * xct::Xct::kMaxPointerSets;
   small_thread_local_memory_pieces_.xct_read_access_memory_ = memory;
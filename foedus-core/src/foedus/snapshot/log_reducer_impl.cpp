@@ -122,6 +122,7 @@ ErrorStack LogReducer::initialize_once() {
 ErrorStack LogReducer::uninitialize_once() {
   ErrorStackBatch batch;
   batch.emprace_back(previous_snapshot_files_.uninitialize());
+  composer_reusable_memory_.release_block();
   writer_intermediate_memory_.release_block();
   writer_pool_memory_.release_block();
   dump_io_buffer_.release_block();
@@ -638,6 +639,7 @@ ErrorStack LogReducer::merge_sort() {
       context.tmp_sorted_buffer_array_,
       context.tmp_sorted_buffer_count_,
       &composer_work_memory,
+      &composer_reusable_memory_,
       parent_.get_base_epoch(),
       root_info_page};
     CHECK_ERROR(composer.compose(args));
@@ -354,6 +354,12 @@ ErrorStack SnapshotManagerPimpl::handle_snapshot_triggered(Snapshot *new_snapsho
   // this holds the pointer to new root page.
   std::map<storage::StorageId, storage::SnapshotPagePointer> new_root_page_pointers;
 
+  // Excludes metadata operations that change the shape of storages, such as
+  // ArrayStorage::extend(), from the moment partitioners look at the shape until we drop
+  // volatile pages based on it. Composers, the metadata file, and drop_volatile_pages() must all
+  // see the same shape, so the window can't be shorter than this.
+  soc::SharedMutexScope snapshot_scope(&control_block_->snapshot_mutex_);
+
   // Log gleaners design partitioning and do scatter-gather to consume the logs.
   // This will create snapshot files at each partition and tell us the new root pages of
   // each storage.
@@ -367,6 +373,7 @@ ErrorStack SnapshotManagerPimpl::handle_snapshot_triggered(Snapshot *new_snapsho
 
   // install pointers to snapshot pages and drop volatile pages.
   CHECK_ERROR(drop_volatile_pages(*new_snapshot, new_root_page_pointers));
+  snapshot_scope.unlock();
 
   Epoch new_snapshot_epoch = new_snapshot->valid_until_epoch_;
   ASSERT_ND(new_snapshot_epoch.is_valid() &&
@@ -488,6 +495,13 @@ fs::Path SnapshotManagerPimpl::get_snapshot_metadata_file_path(SnapshotId snapsh
 ErrorStack SnapshotManagerPimpl::drop_volatile_pages(
   const Snapshot& new_snapshot,
   const std::map<storage::StorageId, storage::SnapshotPagePointer>& new_root_page_pointers) {
+  // Some storages do heavy work to install the new snapshot, eg a resized hash storage.
+  // They do most of it here, before we pause transactions.
+  for (const auto& it : new_root_page_pointers) {
+    storage::Composer composer(engine_, it.first);
+    CHECK_ERROR(composer.prepare_drop_volatiles(new_snapshot));
+  }
+
   // To speed up, we parallelize this process per node, and use the same partitioning scheme.
   LOG(INFO) << "Dropping volatile pointers...";
 
@@ -580,6 +594,16 @@ ErrorStack SnapshotManagerPimpl::drop_volatile_pages(
     LOG(INFO) << "As a result, we dropped " << dropped_count << " pages from storage-" << id;
   }
 
+  // Return the pages dropped above to the pools. Otherwise they are leaked.
+  for (uint16_t node = 0; node < soc_count; ++node) {
+    memory::PagePoolOffsetChunk* chunk = dropped_chunks + node;
+    if (!chunk->empty()) {
+      memory::PagePool* volatile_pool
+        = engine_->get_memory_manager()->get_node_memory(node)->get_volatile_pool();
+      volatile_pool->release(chunk->size(), chunk);
+    }
+    ASSERT_ND(chunk->empty());
+  }
 
   engine_->get_xct_manager()->resume_accepting_xct();
 
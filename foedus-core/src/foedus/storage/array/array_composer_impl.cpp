@@ -28,12 +28,15 @@
 #include "foedus/engine.hpp"
 #include "foedus/engine_options.hpp"
 #include "foedus/assorted/assorted_func.hpp"
+#include "foedus/assorted/simd_aggregate.hpp"
 #include "foedus/cache/snapshot_file_set.hpp"
 #include "foedus/debugging/stop_watch.hpp"
 #include "foedus/fs/direct_io_file.hpp"
 #include "foedus/log/common_log_types.hpp"
 #include "foedus/memory/aligned_memory.hpp"
 #include "foedus/memory/engine_memory.hpp"
+#include "foedus/memory/numa_node_memory.hpp"
+#include "foedus/memory/page_pool.hpp"
 #include "foedus/memory/page_resolver.hpp"
 #include "foedus/savepoint/savepoint_manager.hpp"
 #include "foedus/snapshot/merge_sort.hpp"
@@ -123,10 +126,18 @@ ErrorStack ArrayComposer::construct_root(const Composer::ConstructRootArguments&
       root_interval *= kInteriorFanout;
     }
     ArrayRange range(0, root_interval, storage_.get_array_size());
-    if (page_id != 0) {
+    // if extend() has added levels since the previous snapshot, the previous root is no longer
+    // the root. compose() has put it under the new root.
+    const ArrayOffset previous_array_size = storage_.get_control_block()->snapshot_array_size_;
+    if (page_id != 0 && calculate_levels(previous_array_size, payload_size) == levels) {
       WRAP_ERROR_CODE(args.previous_snapshot_files_->read_page(page_id, root_page));
       ASSERT_ND(root_page->header().storage_id_ == storage_id_);
       ASSERT_ND(root_page->header().page_id_ == page_id);
+      ASSERT_ND(root_page->get_level() == levels - 1U);
+      if (root_page->get_array_range() != range) {
+        ASSERT_ND(root_page->get_array_range().end_ == previous_array_size);
+        root_page->extend_array_range(range.end_);
+      }
       ASSERT_ND(root_page->get_array_range() == range);
       root_page->header().page_id_ = new_page_id;
     } else {
@@ -136,7 +147,8 @@ ErrorStack ArrayComposer::construct_root(const Composer::ConstructRootArguments&
         new_page_id,
         payload_size,
         levels - 1,
-        range);
+        range,
+        storage_.get_array_metadata()->default_value_);
     }
 
     uint64_t child_interval = root_interval / kInteriorFanout;
@@ -164,9 +176,10 @@ ErrorStack ArrayComposer::construct_root(const Composer::ConstructRootArguments&
     }
 
     // even in initial snapshot, all pointers must be set because we create empty pages
-    // even if some sub-tree receives no logs.
+    // even if some sub-tree receives no logs. Except a sparse array, which omits them.
     for (uint16_t j = 0; j < root_children; ++j) {
-      ASSERT_ND(root_page->get_interior_record(j).snapshot_pointer_ != 0);
+      ASSERT_ND(storage_.get_array_metadata()->is_sparse()
+        || root_page->get_interior_record(j).snapshot_pointer_ != 0);
     }
 
     WRAP_ERROR_CODE(args.snapshot_writer_->dump_pages(0, 1));
@@ -174,6 +187,7 @@ ErrorStack ArrayComposer::construct_root(const Composer::ConstructRootArguments&
     // AFTER writing out the root page, install the pointer to new root page
     storage_.get_control_block()->root_page_pointer_.snapshot_pointer_ = new_page_id;
     storage_.get_control_block()->meta_.root_snapshot_page_id_ = new_page_id;
+    storage_.get_control_block()->snapshot_array_size_ = storage_.get_array_size();
   }
   return kRetOk;
 }
@@ -205,7 +219,16 @@ ArrayComposeContext::ArrayComposeContext(
     root_info_page_(reinterpret_cast<ArrayRootInfoPage*>(root_info_page)),
     payload_size_(storage_.get_payload_size()),
     levels_(storage_.get_levels()),
-    previous_root_page_pointer_(storage_.get_metadata()->root_snapshot_page_id_) {
+    previous_root_page_pointer_(storage_.get_metadata()->root_snapshot_page_id_),
+    previous_array_size_(storage_.get_control_block()->snapshot_array_size_),
+    previous_levels_(
+      previous_array_size_ == 0 ? 0 : calculate_levels(previous_array_size_, payload_size_)),
+    fill_from_(
+      is_extended() ? previous_array_size_ - 1U
+        : ((is_initial_snapshot() && !is_sparse()) ? 0 : storage_.get_array_size())) {
+  ASSERT_ND(is_initial_snapshot() == (previous_array_size_ == 0));
+  ASSERT_ND(previous_array_size_ <= storage_.get_array_size());
+  ASSERT_ND(previous_levels_ <= levels_);
   LookupRouteFinder route_finder(levels_, payload_size_);
   offset_intervals_[0] = route_finder.get_records_in_leaf();
   for (uint8_t level = 1; level < levels_; ++level) {
@@ -215,6 +238,7 @@ ArrayComposeContext::ArrayComposeContext(
 
   allocated_pages_ = 0;
   allocated_intermediates_ = 0;
+  increment_groups_count_ = 0;
   page_base_ = reinterpret_cast<ArrayPage*>(snapshot_writer_->get_page_base());
   max_pages_ = snapshot_writer_->get_page_size();
   intermediate_base_ = reinterpret_cast<ArrayPage*>(snapshot_writer_->get_intermediate_base());
@@ -296,7 +320,10 @@ ErrorStack ArrayComposeContext::execute() {
   PartitionId partition = snapshot_writer_->get_numa_node();
   ASSERT_ND(partitioning_data_);
   for (uint16_t i = 0; i < children; ++i) {
-    if (!partitioning_data_->partitionable_ || partitioning_data_->bucket_owners_[i] == partition) {
+    if (is_sparse()) {
+      continue;  // any pointer might be null
+    } else if (!partitioning_data_->partitionable_
+      || partitioning_data_->bucket_owners_[i] == partition) {
       ASSERT_ND(root_info_page_->pointers_[i] != 0);
     } else {
       ASSERT_ND((!is_initial_snapshot() && root_info_page_->pointers_[i] != 0)
@@ -324,21 +351,100 @@ void ArrayComposeContext::apply_batch(uint64_t cur, uint64_t next) {
         = reinterpret_cast<const ArrayCommonUpdateLogType*>(logs[i]);
       ASSERT_ND(range.contains(log->offset_));
       uint16_t index = log->offset_ - range.begin_;
-      Record* record = leaf->get_leaf_record(index, payload_size_);
       if (log->header_.get_type() == log::kLogCodeArrayOverwrite) {
         const ArrayOverwriteLogType* casted
           = reinterpret_cast<const ArrayOverwriteLogType*>(log);
+        Record* record = leaf->get_leaf_record(index, payload_size_);
+        flush_staged_increments(index, record);
         casted->apply_record(nullptr, storage_id_, &record->owner_id_, record->payload_);
       } else {
         ASSERT_ND(log->header_.get_type() == log::kLogCodeArrayIncrement);
         const ArrayIncrementLogType* casted
           = reinterpret_cast<const ArrayIncrementLogType*>(log);
+        // Adding up doubles before applying them might round differently from applying them
+        // one by one, which is what transactions did. So, we stage only integers.
+        const bool integer_64b = casted->is_64b_type() && casted->get_value_type() != kDouble;
+        if (integer_64b && stage_increment(index, casted)) {
+          continue;
+        }
+        Record* record = leaf->get_leaf_record(index, payload_size_);
+        flush_staged_increments(index, record);
         casted->apply_record(nullptr, storage_id_, &record->owner_id_, record->payload_);
       }
     }
     cur += fetched;
     ASSERT_ND(cur <= next);
   }
+  apply_staged_increments(leaf);
+}
+
+bool ArrayComposeContext::stage_increment(uint16_t index, const ArrayIncrementLogType* log) {
+  const uint16_t payload_offset = log->payload_offset_;
+  const ValueType value_type = log->get_value_type();
+  ASSERT_ND(value_type == kI64 || value_type == kU64);
+  ArrayIncrementGroup* group = nullptr;
+  for (uint16_t i = 0; i < increment_groups_count_; ++i) {
+    ArrayIncrementGroup* cur = increment_groups_ + i;
+    if (cur->payload_offset_ == payload_offset && cur->value_type_ == value_type) {
+      group = cur;
+    } else if (cur->count_ > 0 && cur->indexes_[cur->count_ - 1U] == index
+      && cur->payload_offset_ < payload_offset + 8U
+      && payload_offset < cur->payload_offset_ + 8U) {
+      // another type staged on overlapping bytes of this record. we must keep the order.
+      return false;
+    }
+  }
+  if (group == nullptr) {
+    if (increment_groups_count_ >= kMaxIncrementGroups) {
+      return false;
+    }
+    group = increment_groups_ + increment_groups_count_;
+    ++increment_groups_count_;
+    group->payload_offset_ = payload_offset;
+    group->value_type_ = value_type;
+    group->count_ = 0;
+  }
+
+  if (group->count_ > 0 && group->indexes_[group->count_ - 1U] == index) {
+    // same record as the previous log. just add up the addendum.
+    // signed or not, the bits are same because integer sums wrap around.
+    add_to<uint64_t>(group->addenda_ + group->count_ - 1U, log->addendum_64());
+  } else {
+    ASSERT_ND(group->count_ == 0 || group->indexes_[group->count_ - 1U] < index);
+    ASSERT_ND(group->count_ < kMaxRecordsInLeaf);
+    group->indexes_[group->count_] = index;
+    std::memcpy(group->addenda_ + group->count_, log->addendum_64(), sizeof(uint64_t));
+    ++group->count_;
+  }
+  return true;
+}
+
+void ArrayComposeContext::flush_staged_increments(uint16_t index, Record* record) {
+  for (uint16_t i = 0; i < increment_groups_count_; ++i) {
+    ArrayIncrementGroup* group = increment_groups_ + i;
+    if (group->count_ == 0 || group->indexes_[group->count_ - 1U] != index) {
+      continue;
+    }
+    char* field = record->payload_ + group->payload_offset_;
+    add_to<uint64_t>(field, group->addenda_ + group->count_ - 1U);
+    --group->count_;
+  }
+}
+
+void ArrayComposeContext::apply_staged_increments(ArrayPage* leaf) {
+  const int32_t stride = (kRecordOverhead + assorted::align8(payload_size_)) / sizeof(uint64_t);
+  char* payloads = leaf->get_leaf_record(0, payload_size_)->payload_;
+  for (uint16_t i = 0; i < increment_groups_count_; ++i) {
+    ArrayIncrementGroup* group = increment_groups_ + i;
+    ASSERT_ND(group->value_type_ == kI64 || group->value_type_ == kU64);
+    assorted::simd_add_scattered(
+      reinterpret_cast<uint64_t*>(payloads + group->payload_offset_),
+      stride,
+      group->indexes_,
+      group->addenda_,
+      group->count_);
+  }
+  increment_groups_count_ = 0;
 }
 
 ErrorStack ArrayComposeContext::execute_single_level_array() {
@@ -372,6 +478,7 @@ ErrorStack ArrayComposeContext::execute_single_level_array() {
   // further, we install the only snapshot pointer now.
   storage_.get_control_block()->meta_.root_snapshot_page_id_ = page_id;
   storage_.get_control_block()->root_page_pointer_.snapshot_pointer_ = page_id;
+  storage_.get_control_block()->snapshot_array_size_ = storage_.get_array_size();
   return kRetOk;
 }
 
@@ -384,10 +491,11 @@ ErrorStack ArrayComposeContext::finalize() {
   ASSERT_ND(levels_ > 1U);
 
   ArrayRange last_range = cur_path_[0]->get_array_range();
-  if (is_initial_snapshot() && last_range.end_ < storage_.get_array_size()) {
-    VLOG(0) << "Need to fill out empty pages in initial snapshot of array-" << storage_id_
-      << ", from " << last_range.end_ << " to the end of array";
-    WRAP_ERROR_CODE(create_empty_pages(last_range.end_, storage_.get_array_size()));
+  ArrayOffset fill_begin = std::max<ArrayOffset>(last_range.end_, fill_from_);
+  if (fill_begin < storage_.get_array_size()) {
+    VLOG(0) << "Need to fill out empty pages in array-" << storage_id_
+      << ", from " << fill_begin << " to the end of array";
+    WRAP_ERROR_CODE(create_empty_pages(fill_begin, storage_.get_array_size()));
   }
 
   // flush the main buffer. now we finalized all leaf pages
@@ -451,9 +559,11 @@ ErrorStack ArrayComposeContext::finalize() {
     snapshot::SnapshotId snapshot_id = extract_snapshot_id_from_snapshot_pointer(page_id);
 
     if (!partitioning_data_->partitionable_ || partitioning_data_->bucket_owners_[j] == partition) {
-      ASSERT_ND(page_id != 0);
+      ASSERT_ND(page_id != 0 || is_sparse());
       // okay, this is a page this node is responsible for.
-      if (snapshot_id == snapshot_id_) {
+      if (page_id == 0) {
+        // a sparse array that has never received logs in this subtree.
+      } else if (snapshot_id == snapshot_id_) {
         // we already have snapshot pointers because it points to leaf pages. (2 level array)
         // the pointer is already valid as a snapshot pointer
         ASSERT_ND(extract_numa_node_from_snapshot_pointer(page_id)
@@ -472,10 +582,12 @@ ErrorStack ArrayComposeContext::finalize() {
         // then, it's a page in previous snapshots we didn't modify
         ASSERT_ND(!is_initial_snapshot());
         ASSERT_ND(snapshot_id != snapshot_id_);
+        ASSERT_ND(previous_levels_ == levels_);
       }
       root_info_page_->pointers_[j] = pointer.snapshot_pointer_;
     } else {
-      ASSERT_ND((!is_initial_snapshot() && page_id != 0 && snapshot_id != snapshot_id_)
+      ASSERT_ND(is_sparse()
+        || (!is_initial_snapshot() && page_id != 0 && snapshot_id != snapshot_id_)
         || (is_initial_snapshot() && page_id == 0));
     }
   }
@@ -499,14 +611,14 @@ ErrorStack ArrayComposeContext::initialize(ArrayOffset initial_offset) {
   // First, load or create the root page.
   CHECK_ERROR(init_root_page());
 
-  // If an initial snapshot, we have to create empty pages first.
-  if (is_initial_snapshot()) {
-    ArrayRange leaf_range = to_leaf_range(initial_offset);
-    VLOG(0) << "Need to fill out empty pages in initial snapshot of array-" << storage_id_
-      << ", upto " << leaf_range.end_;
-    WRAP_ERROR_CODE(create_empty_pages(0, leaf_range.end_));
-    ASSERT_ND(cur_path_[0]);
-    ASSERT_ND(cur_path_[0]->get_array_range() == leaf_range);
+  // If an initial snapshot or the array has been extended, we have to create empty pages first.
+  ArrayRange leaf_range = to_leaf_range(initial_offset);
+  if (fill_from_ < leaf_range.end_) {
+    VLOG(0) << "Need to fill out empty pages in array-" << storage_id_
+      << ", from " << fill_from_ << " upto " << leaf_range.end_;
+    WRAP_ERROR_CODE(create_empty_pages(fill_from_, leaf_range.end_));
+    ASSERT_ND(is_sparse() || cur_path_[0]);
+    ASSERT_ND(is_sparse() || cur_path_[0]->get_array_range() == leaf_range);
   }
   return kRetOk;
 }
@@ -519,13 +631,45 @@ ErrorStack ArrayComposeContext::init_root_page() {
   ASSERT_ND(allocated_intermediates_ == 0);
   allocated_intermediates_ = 1;
 
-  WRAP_ERROR_CODE(read_or_init_page(previous_root_page_pointer_, 0, level, range, page));
-  cur_path_[level] = page;
+  if (is_initial_snapshot() || previous_levels_ == levels_) {
+    WRAP_ERROR_CODE(read_or_init_page(previous_root_page_pointer_, 0, level, range, page));
+    cur_path_[level] = page;
+  } else {
+    // extend() added levels since the previous snapshot. the previous root is now a descendant.
+    WRAP_ERROR_CODE(read_or_init_page(0, 0, level, range, page));
+    cur_path_[level] = page;
+    WRAP_ERROR_CODE(init_new_root_pages());
+  }
   return kRetOk;
 }
 
+ErrorCode ArrayComposeContext::init_new_root_pages() {
+  ASSERT_ND(is_extended());
+  ASSERT_ND(previous_levels_ > 0);
+  ASSERT_ND(previous_levels_ < levels_);
+  // the new levels have only one page each in the previous range: the left-most one.
+  for (uint8_t level = levels_ - 2U; level >= previous_levels_; --level) {
+    CHECK_ERROR_CODE(expand_intermediate_pool_if_needed());
+    ArrayPage* parent = cur_path_[level + 1U];
+    ArrayPage* page = intermediate_base_ + allocated_intermediates_;
+    SnapshotPagePointer new_page_id = allocated_intermediates_;
+    ++allocated_intermediates_;
+    ArrayRange range(0, offset_intervals_[level], storage_.get_array_size());
+    CHECK_ERROR_CODE(read_or_init_page(0, new_page_id, level, range, page));
+    parent->get_interior_record(0).snapshot_pointer_ = new_page_id;
+    cur_path_[level] = page;
+  }
+
+  // and the previous root is the left-most child of the lowest new page.
+  // switch_child_page() will read it from the previous snapshot and widen it.
+  cur_path_[previous_levels_]->get_interior_record(0).snapshot_pointer_
+    = previous_root_page_pointer_;
+  return kErrorCodeOk;
+}
+
 ErrorCode ArrayComposeContext::create_empty_pages(ArrayOffset from, ArrayOffset to) {
-  ASSERT_ND(is_initial_snapshot());  // this must be called only at initial snapshot
+  ASSERT_ND(is_initial_snapshot() || is_extended());
+  ASSERT_ND(!is_sparse() || is_extended());
   ASSERT_ND(levels_ > 1U);  // single-page array is handled separately, and no need for this func.
   ASSERT_ND(from < to);
   ASSERT_ND(to <= storage_.get_array_size());
@@ -555,26 +699,15 @@ ErrorCode ArrayComposeContext::create_empty_pages(ArrayOffset from, ArrayOffset
   for (uint16_t i = first_child; i < children; ++i) {
     if (partitioning_data_->partitionable_ && partitioning_data_->bucket_owners_[i] != partition) {
       continue;
+    } else if (is_sparse() && is_empty_child(page, i)) {
+      continue;
     }
 
-    // are we filling out empty pages in order?
-    ASSERT_ND(i == first_child || page->get_interior_record(i).snapshot_pointer_ == 0);
-
     ArrayRange child_range(i * interval, (i + 1U) * interval, storage_.get_array_size());
-    if (page->get_interior_record(i).snapshot_pointer_ == 0) {
-      if (child_level > 0) {
-        CHECK_ERROR_CODE(create_empty_intermediate_page(page, i, child_range));
-        ASSERT_ND(extract_snapshot_id_from_snapshot_pointer(
-          cur_path_[child_level]->header().page_id_) == snapshot::kNullSnapshotId);
-      } else {
-        CHECK_ERROR_CODE(create_empty_leaf_page(page, i, child_range));
-        ASSERT_ND(extract_snapshot_id_from_snapshot_pointer(
-          cur_path_[child_level]->header().page_id_) == snapshot_id_);
-      }
-    }
-
+    CHECK_ERROR_CODE(switch_child_page(page, i, child_range));
     ASSERT_ND(cur_path_[child_level]);
-    page->get_interior_record(i).snapshot_pointer_ = cur_path_[child_level]->header().page_id_;
+    ASSERT_ND(page->get_interior_record(i).snapshot_pointer_
+      == cur_path_[child_level]->header().page_id_);
     if (child_level > 0) {
       CHECK_ERROR_CODE(create_empty_pages_recurse(from, to, cur_path_[child_level]));
     }
@@ -611,28 +744,19 @@ ErrorCode ArrayComposeContext::create_empty_pages_recurse(
   }
   ASSERT_ND(children <= kInteriorFanout);
 
-  // we assume this method is called in order, thus null-pointer means the pages we should fill out.
+  // we assume this method is called in order, so only the first child might be already visited.
   for (uint16_t i = first_child; i < children; ++i) {
-    ASSERT_ND(i == first_child || page->get_interior_record(i).snapshot_pointer_ == 0);
     ArrayRange child_range(
       page_range.begin_ + i * interval,
       page_range.begin_ + (i + 1U) * interval,
       page_range.end_);
-
-    if (page->get_interior_record(i).snapshot_pointer_ == 0) {
-      if (child_level > 0) {
-        CHECK_ERROR_CODE(create_empty_intermediate_page(page, i, child_range));
-        ASSERT_ND(extract_snapshot_id_from_snapshot_pointer(
-          cur_path_[child_level]->header().page_id_) == snapshot::kNullSnapshotId);
-      } else {
-        CHECK_ERROR_CODE(create_empty_leaf_page(page, i, child_range));
-        ASSERT_ND(extract_snapshot_id_from_snapshot_pointer(
-          cur_path_[child_level]->header().page_id_) == snapshot_id_);
-      }
+    if (is_sparse() && is_empty_child(page, i)) {
+      continue;
     }
-
+    CHECK_ERROR_CODE(switch_child_page(page, i, child_range));
     ASSERT_ND(cur_path_[child_level]);
-    page->get_interior_record(i).snapshot_pointer_ = cur_path_[child_level]->header().page_id_;
+    ASSERT_ND(page->get_interior_record(i).snapshot_pointer_
+      == cur_path_[child_level]->header().page_id_);
     if (child_level > 0) {
       CHECK_ERROR_CODE(create_empty_pages_recurse(from, to, cur_path_[child_level]));
     }
@@ -641,6 +765,15 @@ ErrorCode ArrayComposeContext::create_empty_pages_recurse(
   return kErrorCodeOk;
 }
 
+bool ArrayComposeContext::is_empty_child(const ArrayPage* parent, uint16_t index) const {
+  const uint8_t level = parent->get_level() - 1U;
+  if (cur_path_[level] != nullptr && parent->get_interior_record(index).snapshot_pointer_
+      == cur_path_[level]->header().page_id_) {
+    return false;  // we are in the page
+  }
+  return parent->get_interior_record(index).snapshot_pointer_ == 0;
+}
+
 ErrorCode ArrayComposeContext::dump_leaf_pages() {
   CHECK_ERROR_CODE(snapshot_writer_->dump_pages(0, allocated_pages_));
   ASSERT_ND(snapshot_writer_->get_next_page_id()
@@ -651,45 +784,50 @@ ErrorCode ArrayComposeContext::dump_leaf_pages() {
   return kErrorCodeOk;
 }
 
-ErrorCode ArrayComposeContext::create_empty_intermediate_page(
+ErrorCode ArrayComposeContext::switch_child_page(
   ArrayPage* parent,
   uint16_t index,
-  ArrayRange range) {
-  ASSERT_ND(parent->get_level() > 1U);
+  const ArrayRange& range) {
+  ASSERT_ND(parent->get_level() > 0);
+  const uint8_t level = parent->get_level() - 1U;
   DualPagePointer& pointer = parent->get_interior_record(index);
-  ASSERT_ND(pointer.is_both_null());
-  uint8_t level = parent->get_level() - 1U;
-  CHECK_ERROR_CODE(expand_intermediate_pool_if_needed());
-  ArrayPage* page = intermediate_base_ + allocated_intermediates_;
-  SnapshotPagePointer new_page_id = allocated_intermediates_;
-  ++allocated_intermediates_;
-  CHECK_ERROR_CODE(read_or_init_page(0, new_page_id, level, range, page));
+  ASSERT_ND(pointer.volatile_pointer_.is_null());
+  if (cur_path_[level] != nullptr && cur_path_[level]->get_array_range().begin_ == range.begin_) {
+    // we are already in the page
+    ASSERT_ND(pointer.snapshot_pointer_ == cur_path_[level]->header().page_id_);
+    return kErrorCodeOk;
+  }
 
-  cur_path_[level] = page;
-  return kErrorCodeOk;
-}
+  // the previous snapshot has all pages in its range (unless sparse), and no page beyond it
+  SnapshotPagePointer old_page_id = pointer.snapshot_pointer_;
+  ASSERT_ND(old_page_id == 0 || range.begin_ < previous_array_size_);
+  ASSERT_ND(old_page_id != 0 || is_sparse() || range.begin_ >= previous_array_size_);
+
+  ArrayPage* page;
+  SnapshotPagePointer new_page_id;
+  if (level > 0U) {
+    // we switched an intermediate page
+    CHECK_ERROR_CODE(expand_intermediate_pool_if_needed());
+    page = intermediate_base_ + allocated_intermediates_;
+    new_page_id = allocated_intermediates_;
+    ++allocated_intermediates_;
+  } else {
+    // we switched a leaf page. in this case, we might have to flush the buffer
+    if (allocated_pages_ >= max_pages_) {
+      CHECK_ERROR_CODE(dump_leaf_pages());
+      ASSERT_ND(allocated_pages_ == 0);
+    }
 
-ErrorCode ArrayComposeContext::create_empty_leaf_page(
-  ArrayPage* parent,
-  uint16_t index,
-  ArrayRange range) {
-  ASSERT_ND(parent->get_level() == 1U);
-  DualPagePointer& pointer = parent->get_interior_record(index);
-  ASSERT_ND(pointer.is_both_null());
-  if (allocated_pages_ >= max_pages_) {
-    CHECK_ERROR_CODE(dump_leaf_pages());
-    ASSERT_ND(allocated_pages_ == 0);
+    // remember, we can finalize the page ID of leaf pages at this point
+    page = page_base_ + allocated_pages_;
+    new_page_id = snapshot_writer_->get_next_page_id() + allocated_pages_;
+    ASSERT_ND(verify_snapshot_pointer(new_page_id));
+    ++allocated_pages_;
   }
-
-  // remember, we can finalize the page ID of leaf pages at this point
-  ArrayPage* page = page_base_ + allocated_pages_;
-  SnapshotPagePointer new_page_id = snapshot_writer_->get_next_page_id() + allocated_pages_;
-  ASSERT_ND(verify_snapshot_pointer(new_page_id));
-  ++allocated_pages_;
-  CHECK_ERROR_CODE(read_or_init_page(0, new_page_id, 0, range, page));
+  CHECK_ERROR_CODE(read_or_init_page(old_page_id, new_page_id, level, range, page));
+  ASSERT_ND(page->header().page_id_ == new_page_id);
   pointer.snapshot_pointer_ = new_page_id;
-
-  cur_path_[0] = page;
+  cur_path_[level] = page;
   return kErrorCodeOk;
 }
 
@@ -716,9 +854,10 @@ ErrorCode ArrayComposeContext::update_cur_path(ArrayOffset next_offset) {
 
   ArrayRange next_range = to_leaf_range(next_offset);
   ArrayOffset jump_from = cur_path_[0] == nullptr ? 0 : cur_path_[0]->get_array_range().end_;
+  jump_from = std::max<ArrayOffset>(jump_from, fill_from_);
   ArrayOffset jump_to = next_range.begin_;
-  if (jump_to > jump_from && is_initial_snapshot()) {
-    VLOG(0) << "Need to fill out empty pages in initial snapshot of array-" << storage_id_
+  if (jump_to > jump_from) {
+    VLOG(0) << "Need to fill out empty pages in array-" << storage_id_
       << ", from " << jump_from << " to " << jump_to;
     CHECK_ERROR_CODE(create_empty_pages(jump_from, jump_to));
   }
@@ -744,39 +883,7 @@ ErrorCode ArrayComposeContext::update_cur_path(ArrayOffset next_offset) {
       parent_range.begin_ + i * interval,
       parent_range.begin_ + (i + 1U) * interval,
       parent_range.end_);
-
-    DualPagePointer& pointer = parent->get_interior_record(i);
-    ASSERT_ND(pointer.volatile_pointer_.is_null());
-    SnapshotPagePointer old_page_id = pointer.snapshot_pointer_;
-    ASSERT_ND((!is_initial_snapshot() && old_page_id != 0)
-      || (is_initial_snapshot() && old_page_id == 0));
-
-    ArrayPage* page;
-    SnapshotPagePointer new_page_id;
-    if (level > 0U) {
-      // we switched an intermediate page
-      CHECK_ERROR_CODE(expand_intermediate_pool_if_needed());
-      page = intermediate_base_ + allocated_intermediates_;
-      new_page_id = allocated_intermediates_;
-      ++allocated_intermediates_;
-      CHECK_ERROR_CODE(read_or_init_page(old_page_id, new_page_id, level, child_range, page));
-    } else {
-      // we switched a leaf page. in this case, we might have to flush the buffer
-      if (allocated_pages_ >= max_pages_) {
-        CHECK_ERROR_CODE(dump_leaf_pages());
-        ASSERT_ND(allocated_pages_ == 0);
-      }
-
-      // remember, we can finalize the page ID of leaf pages at this point
-      page = page_base_ + allocated_pages_;
-      new_page_id = snapshot_writer_->get_next_page_id() + allocated_pages_;
-      ASSERT_ND(verify_snapshot_pointer(new_page_id));
-      ++allocated_pages_;
-      CHECK_ERROR_CODE(read_or_init_page(old_page_id, new_page_id, level, child_range, page));
-    }
-    ASSERT_ND(page->header().page_id_ == new_page_id);
-    pointer.snapshot_pointer_ = new_page_id;
-    cur_path_[level] = page;
+    CHECK_ERROR_CODE(switch_child_page(parent, i, child_range));
   }
   ASSERT_ND(verify_cur_path());
   return kErrorCodeOk;
@@ -795,17 +902,26 @@ inline ErrorCode ArrayComposeContext::read_or_init_page(
     ASSERT_ND(page->header().storage_id_ == storage_id_);
     ASSERT_ND(page->header().page_id_ == old_page_id);
     ASSERT_ND(page->get_level() == level);
+    if (page->get_array_range() != range) {
+      // this was a right-most page in the previous snapshot. extend() has widened it since then.
+      ASSERT_ND(is_extended());
+      ASSERT_ND(page->get_array_range().begin_ == range.begin_);
+      ASSERT_ND(page->get_array_range().end_ == previous_array_size_);
+      ASSERT_ND(range.end_ > previous_array_size_);
+      page->extend_array_range(range.end_);
+    }
     ASSERT_ND(page->get_array_range() == range);
     page->header().page_id_ = new_page_id;
   } else {
-    ASSERT_ND(is_initial_snapshot());
+    ASSERT_ND(is_initial_snapshot() || is_extended() || is_sparse());
     page->initialize_snapshot_page(
       system_initial_epoch_,
       storage_id_,
       new_page_id,
       payload_size_,
       level,
-      range);
+      range,
+      storage_.get_array_metadata()->default_value_);
   }
   return kErrorCodeOk;
 }
@@ -957,7 +1073,9 @@ Composer::DropResult ArrayComposer::drop_volatiles(const Composer::DropVolatiles
   for (uint16_t i = 0; i < kInteriorFanout; ++i) {
     DualPagePointer& child_pointer = volatile_page->get_interior_record(i);
     if (!child_pointer.volatile_pointer_.is_null()) {
-      ASSERT_ND(child_pointer.snapshot_pointer_ != 0);
+      // in a sparse array, the subtree might have received its first write after this snapshot.
+      // such a subtree has no snapshot page. we let partition-0 check it.
+      ASSERT_ND(child_pointer.snapshot_pointer_ != 0 || storage_.get_array_metadata()->is_sparse());
       uint16_t partition = extract_numa_node_from_snapshot_pointer(child_pointer.snapshot_pointer_);
       if (!args.partitioned_drop_ || partition == args.my_partition_) {
         result.combine(drop_volatiles_recurse(args, &child_pointer));
@@ -1077,6 +1195,9 @@ Composer::DropResult ArrayComposer::drop_volatiles_intermediate(
   } else {
     DVLOG(1) << "Couldn't drop an intermediate page that has a recent modification in child";
   }
+  if (!result.dropped_all_) {
+    migrate_to_owner(args, pointer);
+  }
   ASSERT_ND(!result.dropped_all_ || pointer->volatile_pointer_.is_null());
   return result;
 }
@@ -1091,6 +1212,7 @@ inline Composer::DropResult ArrayComposer::drop_volatiles_leaf(
   if (is_to_keep_volatile(volatile_page->get_level())) {
     DVLOG(2) << "Exempted";
     result.dropped_all_ = false;
+    migrate_to_owner(args, pointer);
     return result;
   }
 
@@ -1109,9 +1231,45 @@ inline Composer::DropResult ArrayComposer::drop_volatiles_leaf(
   if (result.dropped_all_) {
     args.drop(engine_, pointer->volatile_pointer_);
     pointer->volatile_pointer_.clear();
+  } else {
+    migrate_to_owner(args, pointer);
   }
   return result;
 }
+
+void ArrayComposer::migrate_to_owner(
+  const Composer::DropVolatilesArguments& args,
+  DualPagePointer* pointer) {
+  if (!storage_.get_array_metadata()->has_placement()) {
+    return;
+  }
+  const VolatilePagePointer old_pointer = pointer->volatile_pointer_;
+  ASSERT_ND(!old_pointer.is_null());
+  ArrayPage* old_page = resolve_volatile(old_pointer);
+  ASSERT_ND(old_page->get_level() + 1U < storage_.get_levels());  // never the root page
+  ArrayStoragePimpl pimpl(engine_, storage_.get_control_block());
+  const thread::ThreadGroupId owner = pimpl.get_owner_node(old_page->get_array_range().begin_);
+  if (old_pointer.get_numa_node() == owner) {
+    return;
+  }
+
+  memory::PagePool* pool
+    = engine_->get_memory_manager()->get_node_memory(owner)->get_volatile_pool();
+  memory::PagePoolOffset offset;
+  if (pool->grab_one(&offset) != kErrorCodeOk) {
+    // it stays there. we will try again in next snapshot.
+    DVLOG(0) << "Owner node-" << static_cast<int>(owner) << " has no free page to migrate to";
+    return;
+  }
+  VolatilePagePointer new_pointer;
+  new_pointer.set(owner, offset);
+  Page* new_page = pool->get_resolver().resolve_offset_newpage(offset);
+  std::memcpy(new_page, old_page, kPageSize);
+  new_page->get_header().page_id_ = new_pointer.word;
+  pointer->volatile_pointer_ = new_pointer;
+  args.drop(engine_, old_pointer);
+}
+
 inline bool ArrayComposer::is_to_keep_volatile(uint16_t level) {
   uint16_t threshold = storage_.get_array_metadata()->snapshot_drop_volatile_pages_threshold_;
   uint16_t array_levels = storage_.get_levels();
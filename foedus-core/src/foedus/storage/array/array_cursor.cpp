@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include "foedus/storage/array/array_cursor.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+
+#include "foedus/assorted/assorted_func.hpp"
+#include "foedus/storage/array/array_page_impl.hpp"
+#include "foedus/storage/array/array_route.hpp"
+#include "foedus/storage/array/array_storage_pimpl.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/xct/xct.hpp"
+
+namespace foedus {
+namespace storage {
+namespace array {
+
+ArrayCursor::ArrayCursor(thread::Thread* context, const ArrayStorage& storage)
+  : context_(context),
+    xct_(&context->get_current_xct()),
+    storage_(storage),
+    payload_size_(storage.get_payload_size()),
+    record_stride_(kRecordOverhead + assorted::align8(storage.get_payload_size())),
+    levels_(storage.get_levels()),
+    observe_records_(xct_->get_isolation_level() != xct::kDirtyRead) {
+  ASSERT_ND(xct_->is_active());
+  ASSERT_ND(levels_ > 0);
+  ASSERT_ND(levels_ <= kMaxLevels);
+  std::memset(path_, 0, sizeof(path_));
+  cur_page_ = nullptr;
+  cur_records_ = nullptr;
+}
+
+ArrayCursor::~ArrayCursor() {
+}
+
+ErrorCode ArrayCursor::open() {
+  return open(ArrayRange(0, storage_.get_array_size()));
+}
+
+ErrorCode ArrayCursor::open(const ArrayRange& range) {
+  if (range.begin_ > range.end_ || range.end_ > storage_.get_array_size()) {
+    return kErrorCodeInvalidParameter;
+  }
+  range_ = range;
+  std::memset(path_, 0, sizeof(path_));
+  cur_page_ = nullptr;
+  cur_range_ = ArrayRange();
+  cur_records_ = nullptr;
+  if (range_.begin_ == range_.end_) {
+    return kErrorCodeOk;
+  }
+
+  ArrayStoragePimpl pimpl(&storage_);
+  CHECK_ERROR_CODE(pimpl.get_root_page(context_, false, &path_[levels_ - 1U]));
+  return move_to(range_.begin_);
+}
+
+ErrorCode ArrayCursor::next_page() {
+  if (!is_valid_page()) {
+    return kErrorCodeOk;
+  }
+  const ArrayOffset offset = cur_range_.end_;
+  if (offset >= range_.end_) {
+    cur_page_ = nullptr;
+    cur_records_ = nullptr;
+    return kErrorCodeOk;
+  }
+  return move_to(offset);
+}
+
+ErrorCode ArrayCursor::move_to(ArrayOffset offset) {
+  ASSERT_ND(offset < range_.end_);
+  CHECK_ERROR_CODE(locate_leaf(&offset));
+  if (offset >= range_.end_) {
+    // the rest of the range is in pages that don't exist.
+    cur_page_ = nullptr;
+    cur_records_ = nullptr;
+    return kErrorCodeOk;
+  }
+  return enter_page(offset);
+}
+
+bool ArrayCursor::is_snapshot_page() const {
+  ASSERT_ND(is_valid_page());
+  return cur_page_->header().snapshot_;
+}
+
+ErrorCode ArrayCursor::locate_leaf(ArrayOffset* offset) {
+  const ArrayStorageControlBlock* control_block = storage_.get_control_block();
+  ArrayStoragePimpl pimpl(&storage_);
+  while (*offset < range_.end_) {
+    ASSERT_ND(path_[levels_ - 1U]);
+    ASSERT_ND(path_[levels_ - 1U]->get_array_range().contains(*offset));
+    // Climb up to the lowest page we can reuse. Usually the parent of the previous leaf.
+    uint8_t level = 0;
+    while (path_[level] == nullptr || !path_[level]->get_array_range().contains(*offset)) {
+      ++level;
+      ASSERT_ND(level < levels_);
+    }
+
+    const LookupRoute route = control_block->route_finder_.find_route(*offset);
+    for (; level > 0; --level) {
+      ArrayPage* parent = path_[level];
+      const uint16_t index = route.route[level];
+      CHECK_ERROR_CODE(pimpl.follow_pointer(
+        context_,
+        parent->header().snapshot_,
+        false,
+        &parent->get_interior_record(index),
+        &path_[level - 1U],
+        parent,
+        index));
+      if (path_[level - 1U] == nullptr) {
+        break;
+      }
+    }
+    if (level == 0) {
+      ASSERT_ND(path_[0]->is_leaf());
+      ASSERT_ND(path_[0]->get_array_range().contains(*offset));
+      return kErrorCodeOk;
+    }
+
+    // A sparse array doesn't have this child page. Skip all records in it.
+    ASSERT_ND(storage_.get_array_metadata()->is_sparse());
+    const uint64_t interval = control_block->intervals_[level - 1U];
+    const ArrayOffset child_begin
+      = path_[level]->get_array_range().begin_ + route.route[level] * interval;
+    *offset = child_begin + interval;
+  }
+  return kErrorCodeOk;
+}
+
+ErrorCode ArrayCursor::enter_page(ArrayOffset offset) {
+  cur_page_ = path_[0];
+  const ArrayRange& page_range = cur_page_->get_array_range();
+  ASSERT_ND(page_range.contains(offset));
+  cur_range_ = ArrayRange(offset, std::min<ArrayOffset>(page_range.end_, range_.end_));
+  const uint16_t first = offset - page_range.begin_;
+  Record* first_record = cur_page_->get_leaf_record(first, payload_size_);
+  cur_records_ = reinterpret_cast<const char*>(first_record);
+
+  if (!cur_page_->header().snapshot_ && observe_records_) {
+    // Same as get_record_payload(). All of them BEFORE the caller reads any payload.
+    const uint16_t count = get_record_count();
+    for (uint16_t i = 0; i < count; ++i) {
+      Record* record = cur_page_->get_leaf_record(first + i, payload_size_);
+      CHECK_ERROR_CODE(xct_->on_record_read(false, &record->owner_id_));
+    }
+  }
+  return kErrorCodeOk;
+}
+
+std::ostream& operator<<(std::ostream& o, const ArrayCursor& v) {
+  o << "<ArrayCursor>" << std::endl;
+  o << "  " << v.storage_ << std::endl;
+  o << "  <range_begin_>" << v.range_.begin_ << "</range_begin_>" << std::endl;
+  o << "  <range_end_>" << v.range_.end_ << "</range_end_>" << std::endl;
+  o << "  <observe_records_>" << v.observe_records_ << "</observe_records_>" << std::endl;
+  o << "  <cur_page_>" << v.cur_page_ << "</cur_page_>" << std::endl;
+  o << "  <cur_range_begin_>" << v.cur_range_.begin_ << "</cur_range_begin_>" << std::endl;
+  o << "  <cur_range_end_>" << v.cur_range_.end_ << "</cur_range_end_>" << std::endl;
+  o << "</ArrayCursor>";
+  return o;
+}
+
+}  // namespace array
+}  // namespace storage
+}  // namespace foedus
@@ -50,6 +50,23 @@ std::ostream& operator<<(std::ostream& o, const ArrayCreateLogType& v) {
   return o;
 }
 
+void ArrayExtendLogType::apply_storage(Engine* engine, StorageId storage_id) {
+  ArrayStorage array(engine, storage_id);
+  array.apply_extend(*this);
+}
+
+void ArrayExtendLogType::assert_valid() {
+  ASSERT_ND(header_.log_length_ == sizeof(ArrayExtendLogType));
+  ASSERT_ND(header_.get_type() == log::get_log_code<ArrayExtendLogType>());
+}
+std::ostream& operator<<(std::ostream& o, const ArrayExtendLogType& v) {
+  o << "<ArrayExtendLog>"
+    << "<storage_id_>" << v.header_.storage_id_ << "</storage_id_>"
+    << "<new_array_size_>" << v.new_array_size_ << "</new_array_size_>"
+    << "</ArrayExtendLog>";
+  return o;
+}
+
 std::ostream& operator<<(std::ostream& o, const ArrayOverwriteLogType& v) {
   o << "<ArrayOverwriteLog>"
     << "<offset_>" << v.offset_ << "</offset_>"
@@ -43,6 +43,19 @@ ErrorStack ArrayMetadataSerializer::load(tinyxml2::XMLElement* element) {
     "snapshot_drop_volatile_pages_threshold_",
     &data_casted_->snapshot_drop_volatile_pages_threshold_))
   CHECK_ERROR(get_element(element, "array_size_", &data_casted_->array_size_))
+  CHECK_ERROR(get_element<uint8_t>(element, "sparse_", &data_casted_->sparse_, true, 0))
+  CHECK_ERROR(get_element<uint64_t>(
+    element,
+    "default_value_",
+    &data_casted_->default_value_,
+    true,
+    0))
+  CHECK_ERROR(get_element<uint8_t>(
+    element,
+    "placement_",
+    &data_casted_->placement_,
+    true,
+    kArrayPlacementFirstTouch))
   return kRetOk;
 }
 
@@ -55,6 +68,21 @@ ErrorStack ArrayMetadataSerializer::save(tinyxml2::XMLElement* element) const {
     "",
     data_casted_->snapshot_drop_volatile_pages_threshold_));
   CHECK_ERROR(add_element(element, "array_size_", "", data_casted_->array_size_));
+  CHECK_ERROR(add_element(
+    element,
+    "sparse_",
+    "Whether never-written pages stay null. 0 means no",
+    data_casted_->sparse_));
+  CHECK_ERROR(add_element(
+    element,
+    "default_value_",
+    "Every 8 bytes of never-written payloads",
+    data_casted_->default_value_));
+  CHECK_ERROR(add_element(
+    element,
+    "placement_",
+    "Where volatile pages are allocated. 0: first-touch, 1: range, 2: partitioner",
+    data_casted_->placement_));
   return kRetOk;
 }
 
@@ -35,7 +35,8 @@ void ArrayPage::initialize_snapshot_page(
   SnapshotPagePointer page_id,
   uint16_t payload_size,
   uint8_t level,
-  const ArrayRange& array_range) {
+  const ArrayRange& array_range,
+  uint64_t default_value) {
   ASSERT_ND(initial_epoch.is_valid());
   std::memset(this, 0, kPageSize);
   header_.init_snapshot(page_id, storage_id, kArrayPageType);
@@ -48,6 +49,9 @@ void ArrayPage::initialize_snapshot_page(
       auto* rec = get_leaf_record(i, payload_size);
       rec->owner_id_.lock_.reset();
       rec->owner_id_.xct_id_.set_epoch(initial_epoch);
+      if (default_value != 0) {
+        fill_default_payload(default_value, 0, payload_size, rec->payload_);
+      }
     }
   }
 }
@@ -58,7 +62,8 @@ void ArrayPage::initialize_volatile_page(
   VolatilePagePointer page_id,
   uint16_t payload_size,
   uint8_t level,
-  const ArrayRange& array_range) {
+  const ArrayRange& array_range,
+  uint64_t default_value) {
   ASSERT_ND(initial_epoch.is_valid());
   std::memset(this, 0, kPageSize);
   header_.init_volatile(page_id, storage_id, kArrayPageType);
@@ -71,6 +76,9 @@ void ArrayPage::initialize_volatile_page(
       auto* rec = get_leaf_record(i, payload_size);
       rec->owner_id_.lock_.reset();
       rec->owner_id_.xct_id_.set_epoch(initial_epoch);
+      if (default_value != 0) {
+        fill_default_payload(default_value, 0, payload_size, rec->payload_);
+      }
     }
   }
 }
@@ -113,7 +121,8 @@ void array_volatile_page_init(const VolatilePageInitArguments& args) {
     args.page_id,
     storage.get_payload_size(),
     child_level,
-    child_range);
+    child_range,
+    cb->meta_.default_value_);
 }
 
 }  // namespace array
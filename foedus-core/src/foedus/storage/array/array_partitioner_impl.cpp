@@ -20,11 +20,13 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <cstring>
 #include <ostream>
 #include <vector>
 
 #include "foedus/engine.hpp"
 #include "foedus/engine_options.hpp"
+#include "foedus/assorted/atomic_fences.hpp"
 #include "foedus/debugging/stop_watch.hpp"
 #include "foedus/log/common_log_types.hpp"
 #include "foedus/memory/aligned_memory.hpp"
@@ -32,6 +34,7 @@
 #include "foedus/storage/partitioner.hpp"
 #include "foedus/storage/storage_manager.hpp"
 #include "foedus/storage/array/array_log_types.hpp"
+#include "foedus/storage/array/array_metadata.hpp"
 #include "foedus/storage/array/array_page_impl.hpp"
 #include "foedus/storage/array/array_storage.hpp"
 #include "foedus/storage/array/array_storage_pimpl.hpp"
@@ -95,6 +98,21 @@ ErrorStack ArrayPartitioner::design_partition(
     return kRetOk;
   }
 
+  if (control_block->snapshot_array_size_ != 0
+    && control_block->snapshot_array_size_ != data_->array_size_) {
+    // The array has been extended since the previous snapshot. This snapshot reshapes the
+    // right-most pages and maybe adds root pages above the previous root, which is easy only
+    // when one composer sees the whole tree. So we don't partition this time.
+    LOG(INFO) << "Array-storage-" << id_ << " has been extended from "
+      << control_block->snapshot_array_size_ << " to " << data_->array_size_ << " records"
+      << " since the previous snapshot. This snapshot doesn't partition it.";
+    data_->bucket_owners_[0] = 0;
+    data_->partitionable_ = false;
+    data_->bucket_size_ = data_->array_size_;
+    metadata_->valid_ = true;
+    return kRetOk;
+  }
+
   data_->partitionable_ = true;
   ASSERT_ND(storage.get_levels() >= 2U);
 
@@ -131,19 +149,39 @@ ErrorStack ArrayPartitioner::design_partition(
 
   // two paths. first path simply sees volatile/snapshot pointer and determines owner.
   // second path addresses excessive assignments, off loading them to needy ones.
+  // A sparse array might have only a few populated children. Balancing by the number of
+  // children would then leave all the real work to a few partitions, so we balance only
+  // populated children, and spread empty ones round-robin without counting them.
+  const bool sparse = storage.get_array_metadata()->is_sparse();
+  uint16_t populated_children = direct_children;
+  if (sparse) {
+    populated_children = 0;
+    for (uint16_t child = 0; child < direct_children; ++child) {
+      if (!root_page->get_interior_record(child).is_both_null()) {
+        ++populated_children;
+      }
+    }
+  }
   std::vector<uint16_t> counts(total_partitions, 0);
-  const uint16_t excessive_count = (direct_children / total_partitions) + 1;
+  const uint16_t excessive_count = (populated_children / total_partitions) + 1;
   std::vector<uint16_t> excessive_children;
   for (uint16_t child = 0; child < direct_children; ++child) {
     const DualPagePointer &pointer = root_page->get_interior_record(child);
+    if (sparse && pointer.is_both_null()) {
+      data_->bucket_owners_[child] = child % total_partitions;
+      continue;
+    }
     PartitionId partition;
     if (!pointer.volatile_pointer_.is_null()) {
       partition = pointer.volatile_pointer_.get_numa_node();
-    } else {
+    } else if (pointer.snapshot_pointer_ != 0) {
       // if no volatile page, see snapshot page owner.
       partition = extract_numa_node_from_snapshot_pointer(pointer.snapshot_pointer_);
-      // this ignores the case where neither snapshot/volatile page is there.
-      // however, as we create all pages at ArrayStorage::create(), this so far never happens.
+    } else {
+      // neither snapshot/volatile page is there, eg a range no one has touched since
+      // ArrayStorage::extend(). Anyone can take it, so let the second path decide.
+      excessive_children.push_back(child);
+      continue;
     }
     ASSERT_ND(partition < total_partitions);
     if (counts[partition] >= excessive_count) {
@@ -168,6 +206,17 @@ ErrorStack ArrayPartitioner::design_partition(
     data_->bucket_owners_[child] = most_needy;
   }
 
+  // kArrayPlacementPartitioner places volatile pages where we compose their snapshot pages.
+  // Transactions might be reading the owners now, but an old owner is just a worse placement.
+  if (storage.get_array_metadata()->placement_ == kArrayPlacementPartitioner) {
+    std::memcpy(
+      control_block->placement_owners_,
+      data_->bucket_owners_,
+      sizeof(control_block->placement_owners_));
+    assorted::memory_fence_release();
+    control_block->placement_owners_valid_ = true;
+  }
+
   metadata_->valid_ = true;
   return kRetOk;
 }
@@ -290,11 +339,13 @@ uint32_t compact_logs(const Partitioner::SortBatchArguments& args, SortEntry* en
         // If we check further, Log 3 can eliminate Log 1. However, the check is expensive..
       } else {
         // two increment logs of same type/offset can be merged into one.
+        // except doubles, whose sum might round differently from adding them one by one.
         ASSERT_ND(prev_p->header_.get_type() == log::kLogCodeArrayIncrement);
         const ArrayIncrementLogType* prev = reinterpret_cast<const ArrayIncrementLogType*>(prev_p);
         ArrayIncrementLogType* next = reinterpret_cast<ArrayIncrementLogType*>(next_p);
         if (prev->value_type_ == next->value_type_
-          && prev->payload_offset_ == next->payload_offset_) {
+          && prev->payload_offset_ == next->payload_offset_
+          && prev->get_value_type() != kDouble) {
           // add up the prev's addendum to next, then delete prev.
           next->merge(*prev);
           --result_count;
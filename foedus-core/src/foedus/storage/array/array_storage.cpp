@@ -21,7 +21,9 @@
 #include <string>
 
 #include "foedus/engine.hpp"
+#include "foedus/error_stack.hpp"
 #include "foedus/storage/storage_manager.hpp"
+#include "foedus/storage/array/array_log_types.hpp"
 #include "foedus/storage/array/array_storage_pimpl.hpp"
 
 namespace foedus {
@@ -57,6 +59,15 @@ ErrorStack ArrayStorage::load(const StorageControlBlock& snapshot_block) {
   return ArrayStoragePimpl(this).load(snapshot_block);
 }
 
+ErrorStack ArrayStorage::extend(ArrayOffset new_array_size, Epoch* commit_epoch) {
+  return ArrayStoragePimpl(this).extend(new_array_size, commit_epoch);
+}
+
+void ArrayStorage::apply_extend(const ArrayExtendLogType& the_log) {
+  // this method is called only during restart. we can't proceed without the grown pages.
+  COERCE_ERROR(ArrayStoragePimpl(this).apply_extend(the_log.new_array_size_));
+}
+
 std::ostream& operator<<(std::ostream& o, const ArrayStorage& v) {
   o << "<ArrayStorage>"
     << "<id>" << v.get_id() << "</id>"
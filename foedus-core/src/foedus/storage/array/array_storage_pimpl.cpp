@@ -19,15 +19,22 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "foedus/engine.hpp"
 #include "foedus/assorted/assorted_func.hpp"
 #include "foedus/assorted/cacheline.hpp"
+#include "foedus/assorted/raw_atomics.hpp"
 #include "foedus/cache/snapshot_file_set.hpp"
 #include "foedus/debugging/stop_watch.hpp"
+#include "foedus/log/log_manager.hpp"
 #include "foedus/log/log_type.hpp"
+#include "foedus/log/meta_log_buffer.hpp"
 #include "foedus/log/thread_log_buffer.hpp"
 #include "foedus/memory/engine_memory.hpp"
 #include "foedus/memory/memory_id.hpp"
@@ -35,6 +42,9 @@
 #include "foedus/memory/page_pool.hpp"
 #include "foedus/savepoint/savepoint_manager.hpp"
 #include "foedus/snapshot/snapshot.hpp"
+#include "foedus/snapshot/snapshot_manager.hpp"
+#include "foedus/snapshot/snapshot_manager_pimpl.hpp"
+#include "foedus/soc/shared_mutex.hpp"
 #include "foedus/storage/record.hpp"
 #include "foedus/storage/storage_manager.hpp"
 #include "foedus/storage/storage_manager_pimpl.hpp"
@@ -191,9 +201,8 @@ std::vector<uint64_t> ArrayStoragePimpl::calculate_required_pages(
   return pages;
 }
 
-uint8_t calculate_levels(const ArrayMetadata &metadata) {
-  uint64_t array_size = metadata.array_size_;
-  uint16_t payload = assorted::align8(metadata.payload_size_);
+uint8_t calculate_levels(ArrayOffset array_size, uint16_t payload_size) {
+  uint16_t payload = assorted::align8(payload_size);
   uint64_t records_per_page = kDataSize / (payload + kRecordOverhead);
   uint8_t levels = 1;
   for (uint64_t pages = assorted::int_div_ceil(array_size, records_per_page);
@@ -204,6 +213,10 @@ uint8_t calculate_levels(const ArrayMetadata &metadata) {
   return levels;
 }
 
+uint8_t calculate_levels(const ArrayMetadata &metadata) {
+  return calculate_levels(metadata.array_size_, metadata.payload_size_);
+}
+
 void ArrayStoragePimpl::release_pages_recursive(
   const memory::GlobalVolatilePageResolver& resolver,
   memory::PageReleaseBatch* batch,
@@ -251,6 +264,36 @@ std::vector<uint64_t> ArrayStoragePimpl::calculate_offset_intervals(
   return offset_intervals;
 }
 
+void ArrayStoragePimpl::set_intervals(uint8_t levels) {
+  ASSERT_ND(levels <= kMaxLevels);
+  // The owners of kArrayPlacementPartitioner are per direct child of the root page, which
+  // we are (re)defining now. Until the next snapshot designs them, we follow ranges.
+  control_block_->placement_owners_valid_ = false;
+  control_block_->intervals_[0] = control_block_->route_finder_.get_records_in_leaf();
+  for (uint16_t level = 1; level < levels; ++level) {
+    control_block_->intervals_[level] = control_block_->intervals_[level - 1U] * kInteriorFanout;
+  }
+}
+
+thread::ThreadGroupId ArrayStoragePimpl::get_owner_node(ArrayOffset offset) const {
+  ASSERT_ND(get_meta().has_placement());
+  ASSERT_ND(offset < get_array_size());
+  const uint16_t levels = get_levels();
+  const uint16_t nodes = engine_->get_soc_count();
+  if (levels == 1U || nodes == 1U) {
+    return 0;
+  }
+  const uint64_t bucket_size = control_block_->intervals_[levels - 2U];
+  const uint64_t bucket = offset / bucket_size;
+  ASSERT_ND(bucket < kInteriorFanout);
+  if (get_meta().placement_ == kArrayPlacementPartitioner
+    && control_block_->placement_owners_valid_) {
+    return control_block_->placement_owners_[bucket];
+  }
+  const uint64_t buckets = assorted::int_div_ceil(get_array_size(), bucket_size);
+  return bucket * nodes / buckets;
+}
+
 ErrorStack ArrayStoragePimpl::load_empty() {
   const uint16_t levels = calculate_levels(control_block_->meta_);
   const uint32_t payload_size = control_block_->meta_.payload_size_;
@@ -263,10 +306,8 @@ ErrorStack ArrayStoragePimpl::load_empty() {
   control_block_->root_page_pointer_.snapshot_pointer_ = 0;
   control_block_->root_page_pointer_.volatile_pointer_.word = 0;
   control_block_->meta_.root_snapshot_page_id_ = 0;
-  control_block_->intervals_[0] = control_block_->route_finder_.get_records_in_leaf();
-  for (uint16_t level = 1; level < levels; ++level) {
-    control_block_->intervals_[level] = control_block_->intervals_[level - 1U] * kInteriorFanout;
-  }
+  control_block_->snapshot_array_size_ = 0;
+  set_intervals(levels);
 
   VolatilePagePointer volatile_pointer;
   ArrayPage* volatile_root;
@@ -280,7 +321,8 @@ ErrorStack ArrayStoragePimpl::load_empty() {
     volatile_pointer,
     payload_size,
     levels - 1U,
-    ArrayRange(0, array_size));
+    ArrayRange(0, array_size),
+    get_default_value());
   control_block_->root_page_pointer_.volatile_pointer_ = volatile_pointer;
   return kRetOk;
 }
@@ -302,9 +344,7 @@ ErrorStack ArrayStoragePimpl::load(const StorageControlBlock& snapshot_block) {
   control_block_->meta_ = static_cast<const ArrayMetadata&>(snapshot_block.meta_);
   const ArrayMetadata& meta = control_block_->meta_;
   ASSERT_ND(meta.root_snapshot_page_id_ != 0);
-  const uint16_t levels = calculate_levels(meta);
-  control_block_->levels_ = levels;
-  control_block_->route_finder_ = LookupRouteFinder(levels, get_payload_size());
+  const ArrayOffset array_size = meta.array_size_;
   control_block_->root_page_pointer_.snapshot_pointer_ = meta.root_snapshot_page_id_;
   control_block_->root_page_pointer_.volatile_pointer_.word = 0;
 
@@ -323,6 +363,25 @@ ErrorStack ArrayStoragePimpl::load(const StorageControlBlock& snapshot_block) {
       &volatile_root));
     control_block_->root_page_pointer_.volatile_pointer_ = volatile_pointer;
     CHECK_ERROR(fileset.uninitialize());
+
+    // If the array was extended after the latest snapshot of this storage, the snapshot pages
+    // are still in the old shape. We load it as the old array, then extend it again.
+    const ArrayPage* casted = reinterpret_cast<const ArrayPage*>(volatile_root);
+    const ArrayOffset snapshot_array_size = casted->get_array_range().end_;
+    ASSERT_ND(casted->get_array_range().begin_ == 0);
+    ASSERT_ND(snapshot_array_size <= array_size);
+    const uint16_t levels = calculate_levels(snapshot_array_size, get_payload_size());
+    ASSERT_ND(casted->get_level() + 1U == levels);
+    control_block_->meta_.array_size_ = snapshot_array_size;
+    control_block_->snapshot_array_size_ = snapshot_array_size;
+    control_block_->levels_ = levels;
+    control_block_->route_finder_ = LookupRouteFinder(levels, get_payload_size());
+    set_intervals(levels);
+    if (snapshot_array_size < array_size) {
+      LOG(INFO) << "The latest snapshot of array-storage-" << get_id() << " has only "
+        << snapshot_array_size << " records. Extending it to " << array_size;
+      CHECK_ERROR(apply_extend(array_size));
+    }
   } else {
     LOG(INFO) << "Loading an empty array-storage-" << get_meta();
     CHECK_ERROR(load_empty());
@@ -333,6 +392,283 @@ ErrorStack ArrayStoragePimpl::load(const StorageControlBlock& snapshot_block) {
   return kRetOk;
 }
 
+ErrorStack ArrayStoragePimpl::extend(ArrayOffset new_array_size, Epoch* commit_epoch) {
+  LOG(INFO) << "Extending " << get_meta().name_ << " to " << new_array_size
+    << " records. old size=" << get_array_size();
+  if (!exists()) {
+    return ERROR_STACK_MSG(kErrorCodeInvalidParameter, "The array-storage doesn't exist");
+  } else if (new_array_size > kMaxArrayOffset
+    || calculate_levels(new_array_size, get_payload_size()) > kMaxLevels) {
+    LOG(ERROR) << "extend() was called with a too large size: " << new_array_size;
+    return ERROR_STACK(kErrorCodeStrTooLargeArray);
+  }
+
+  // Snapshots assume that the shape of the tree doesn't change from partitioning until they
+  // drop volatile pages. This waits for such a snapshot, if any, to finish, which might take
+  // long. This also serializes concurrent extend() calls.
+  soc::SharedMutexScope snapshot_scope(
+    &engine_->get_snapshot_manager()->get_pimpl()->control_block_->snapshot_mutex_);
+  if (new_array_size < get_array_size()) {
+    LOG(ERROR) << "extend() can't shrink an array. current size=" << get_array_size();
+    return ERROR_STACK(kErrorCodeInvalidParameter);
+  } else if (new_array_size == get_array_size()) {
+    LOG(INFO) << "Already extended to " << new_array_size;
+    return kRetOk;
+  }
+
+  // Like drop_volatile_pages() in snapshot, we pause transaction executions while we change
+  // the root page and the number of levels. Otherwise every lookup would have to check whether
+  // the root page it read matches the number of levels it read.
+  xct::XctManager* xct_manager = engine_->get_xct_manager();
+  xct_manager->pause_accepting_xct();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));  // almost forever in OLTP xcts.
+
+  // Log this operation as a metadata operation. We get a commit_epoch here.
+  {
+    char log_buffer[sizeof(ArrayExtendLogType)];
+    std::memset(log_buffer, 0, sizeof(log_buffer));
+    ArrayExtendLogType* the_log = reinterpret_cast<ArrayExtendLogType*>(log_buffer);
+    the_log->header_.storage_id_ = get_id();
+    the_log->header_.log_type_code_ = log::get_log_code<ArrayExtendLogType>();
+    the_log->header_.log_length_ = sizeof(ArrayExtendLogType);
+    the_log->new_array_size_ = new_array_size;
+    engine_->get_log_manager()->get_meta_buffer()->commit(the_log, commit_epoch);
+  }
+
+  // Then, apply it. The new size will be written out in next snapshot.
+  // Until that, REDO-operation will re-apply that after crash.
+  ErrorStack result = apply_extend(new_array_size);
+  xct_manager->resume_accepting_xct();
+  if (result.is_error()) {
+    // The log is already durable, so restart will redo it. We just report the error.
+    LOG(ERROR) << "Failed to extend array-storage-" << get_id() << ". " << result;
+    return result;
+  }
+  LOG(INFO) << "Extended. levels=" << static_cast<int>(get_levels());
+  return kRetOk;
+}
+
+ErrorStack ArrayStoragePimpl::apply_extend(ArrayOffset new_array_size) {
+  const ArrayOffset old_array_size = get_array_size();
+  if (new_array_size <= old_array_size) {
+    LOG(INFO) << "array-storage-" << get_id() << " already has " << old_array_size << " records";
+    return kRetOk;
+  }
+  ASSERT_ND(old_array_size > 0);
+  const uint16_t payload_size = get_payload_size();
+  const uint8_t old_levels = get_levels();
+  const uint8_t new_levels = calculate_levels(new_array_size, payload_size);
+  ASSERT_ND(old_levels <= new_levels);
+  ASSERT_ND(new_levels <= kMaxLevels);
+
+  // First, we obtain all pages we need so that an error leaves the array as it was.
+  // The path to the last record in the old array consists of the only pages whose ranges are
+  // cut by the old size. We make them volatile to widen them.
+  cache::SnapshotFileSet fileset(engine_);
+  CHECK_ERROR(fileset.initialize());
+  UninitializeGuard fileset_guard(&fileset, UninitializeGuard::kWarnIfUninitializeError);
+  const ArrayOffset last_offset = old_array_size - 1U;
+  ArrayPage* path[kMaxLevels];
+  std::memset(path, 0, sizeof(path));
+  CHECK_ERROR(ensure_volatile_page(
+    &fileset,
+    &control_block_->root_page_pointer_,
+    old_levels - 1U,
+    ArrayRange(0, old_array_size),
+    path + old_levels - 1U));
+  ASSERT_ND(path[old_levels - 1U]);  // the root page always exists
+  // In a sparse array, the path ends where a page doesn't exist. Nothing to widen below it.
+  for (uint8_t level = old_levels - 1U; level > 0 && path[level]; --level) {
+    const ArrayRange range = path[level]->get_array_range();
+    ASSERT_ND(range.contains(last_offset));
+    const uint64_t child_interval = control_block_->intervals_[level - 1U];
+    const uint16_t index = (last_offset - range.begin_) / child_interval;
+    const ArrayOffset child_begin = range.begin_ + index * child_interval;
+    CHECK_ERROR(ensure_volatile_page(
+      &fileset,
+      &path[level]->get_interior_record(index),
+      level - 1U,
+      ArrayRange(child_begin, child_begin + child_interval, old_array_size),
+      path + level - 1U));
+  }
+  CHECK_ERROR(fileset.uninitialize());
+
+  // If we need more levels, we add new root pages on top of the current root.
+  // Every lookup goes through all of them, just like the current root, so they are not owned by
+  // any node in the placement policy. We put them on the node of the current root page, which
+  // is node-0, or the node of the snapshot file if the root was loaded from a snapshot page.
+  // This keeps the top of the tree together instead of following the node that calls us.
+  memory::EngineMemory* memory = engine_->get_memory_manager();
+  const thread::ThreadGroupId root_node
+    = control_block_->root_page_pointer_.volatile_pointer_.get_numa_node();
+  VolatilePagePointer new_pointers[kMaxLevels];
+  ArrayPage* new_pages[kMaxLevels];
+  for (uint8_t level = old_levels; level < new_levels; ++level) {
+    ErrorStack grab_error = memory->grab_one_volatile_page(
+      root_node,
+      new_pointers + level,
+      reinterpret_cast<Page**>(new_pages + level));
+    if (grab_error.is_error()) {
+      for (uint8_t grabbed = old_levels; grabbed < level; ++grabbed) {
+        memory->get_node_memory(new_pointers[grabbed].get_numa_node())->get_volatile_pool()
+          ->release_one(new_pointers[grabbed].get_offset());
+      }
+      return grab_error;
+    }
+  }
+
+  // No error path below. Intervals of existing levels don't change, so we just add new ones.
+  set_intervals(new_levels);
+  for (uint8_t level = 0; level < old_levels; ++level) {
+    if (path[level] == nullptr) {
+      ASSERT_ND(is_sparse());
+      continue;
+    }
+    const ArrayRange range = path[level]->get_array_range();
+    ASSERT_ND(path[level]->get_level() == level);
+    ASSERT_ND(range.end_ == old_array_size);
+    path[level]->extend_array_range(std::min<ArrayOffset>(
+      range.begin_ + control_block_->intervals_[level],
+      new_array_size));
+  }
+
+  // Each new root page has the previous root as its first child.
+  const Epoch initial_epoch = engine_->get_savepoint_manager()->get_initial_current_epoch();
+  DualPagePointer child = control_block_->root_page_pointer_;
+  for (uint8_t level = old_levels; level < new_levels; ++level) {
+    new_pages[level]->initialize_volatile_page(
+      initial_epoch,
+      get_id(),
+      new_pointers[level],
+      payload_size,
+      level,
+      ArrayRange(0, control_block_->intervals_[level], new_array_size),
+      get_default_value());
+    new_pages[level]->get_interior_record(0) = child;
+    child.volatile_pointer_ = new_pointers[level];
+    child.snapshot_pointer_ = 0;
+  }
+  control_block_->root_page_pointer_.volatile_pointer_ = child.volatile_pointer_;
+
+  // The root snapshot page, if any, is now stale. We don't let anyone follow it until the next
+  // snapshot installs a new one. meta_.root_snapshot_page_id_ stays so that the next snapshot
+  // can start from the previous snapshot pages.
+  control_block_->root_page_pointer_.snapshot_pointer_ = 0;
+  control_block_->levels_ = new_levels;
+  control_block_->route_finder_ = LookupRouteFinder(new_levels, payload_size);
+  control_block_->meta_.array_size_ = new_array_size;
+  assorted::memory_fence_release();
+  LOG(INFO) << "array-storage-" << get_id() << " now has " << new_array_size << " records in "
+    << static_cast<int>(new_levels) << " levels";
+  return kRetOk;
+}
+
+ErrorStack ArrayStoragePimpl::ensure_volatile_page(
+  cache::SnapshotFileSet* fileset,
+  DualPagePointer* pointer,
+  uint8_t level,
+  const ArrayRange& range,
+  ArrayPage** out) {
+  memory::EngineMemory* memory = engine_->get_memory_manager();
+  VolatilePagePointer cur_pointer = pointer->volatile_pointer_;
+  if (cur_pointer.is_null() && pointer->snapshot_pointer_ == 0 && is_sparse()) {
+    *out = nullptr;
+    return kRetOk;
+  } else if (cur_pointer.is_null()) {
+    Page* new_page;
+    if (pointer->snapshot_pointer_ != 0) {
+      CHECK_ERROR(memory->load_one_volatile_page(
+        fileset,
+        pointer->snapshot_pointer_,
+        &cur_pointer,
+        &new_page));
+    } else {
+      // The root page stays on node-0. Others go to the owner node if the storage has one.
+      thread::ThreadGroupId node = 0;
+      if (get_meta().has_placement() && level + 1U < get_levels()) {
+        node = get_owner_node(range.begin_);
+      }
+      CHECK_ERROR(memory->grab_one_volatile_page(node, &cur_pointer, &new_page));
+      reinterpret_cast<ArrayPage*>(new_page)->initialize_volatile_page(
+        engine_->get_savepoint_manager()->get_initial_current_epoch(),
+        get_id(),
+        cur_pointer,
+        get_payload_size(),
+        level,
+        range,
+        get_default_value());
+    }
+    // transactions are paused or not started yet, so no one is racing with us.
+    pointer->volatile_pointer_ = cur_pointer;
+  }
+  *out = reinterpret_cast<ArrayPage*>(
+    memory->get_global_volatile_page_resolver().resolve_offset(cur_pointer));
+  ASSERT_ND(!(*out)->header().snapshot_);
+  ASSERT_ND((*out)->get_level() == level);
+  ASSERT_ND((*out)->get_array_range() == range);
+  return kRetOk;
+}
+
+
+ErrorCode ArrayStoragePimpl::install_owner_volatile_page(
+  thread::Thread* context,
+  DualPagePointer* pointer,
+  const ArrayPage* parent,
+  uint16_t index_in_parent) {
+  ASSERT_ND(get_meta().has_placement());
+  ASSERT_ND(!parent->header().snapshot_);
+  ASSERT_ND(!parent->is_leaf());
+  const ArrayOffset child_begin = parent->get_array_range().begin_
+    + index_in_parent * control_block_->intervals_[parent->get_level() - 1U];
+  const thread::ThreadGroupId owner = get_owner_node(child_begin);
+  if (owner == context->get_numa_node()) {
+    return kErrorCodeOk;
+  }
+
+  memory::PagePool* pool
+    = engine_->get_memory_manager()->get_node_memory(owner)->get_volatile_pool();
+  memory::PagePoolOffset offset;
+  if (pool->grab_one(&offset) != kErrorCodeOk) {
+    DVLOG(0) << "Owner node-" << static_cast<int>(owner) << " has no free page. We take ours";
+    return kErrorCodeOk;
+  }
+  VolatilePagePointer new_pointer;
+  new_pointer.set(owner, offset);
+  Page* new_page = pool->get_resolver().resolve_offset_newpage(offset);
+  if (pointer->snapshot_pointer_ != 0) {
+    Page* snapshot_page;
+    ErrorCode read_error = context->find_or_read_a_snapshot_page(
+      pointer->snapshot_pointer_,
+      &snapshot_page);
+    if (read_error != kErrorCodeOk) {
+      pool->release_one(offset);
+      return read_error;
+    }
+    std::memcpy(new_page, snapshot_page, kPageSize);
+    ASSERT_ND(new_page->get_header().snapshot_);
+    new_page->get_header().snapshot_ = false;
+    new_page->get_header().page_id_ = new_pointer.word;
+  } else {
+    VolatilePageInitArguments args = {
+      context,
+      new_pointer,
+      new_page,
+      reinterpret_cast<const Page*>(parent),
+      index_in_parent
+    };
+    array_volatile_page_init(args);
+  }
+
+  uint64_t expected = 0;
+  if (!assorted::raw_atomic_compare_exchange_strong<uint64_t>(
+    &pointer->volatile_pointer_.word,
+    &expected,
+    new_pointer.word)) {
+    // someone else has installed it. we follow theirs.
+    pool->release_one(offset);
+  }
+  return kErrorCodeOk;
+}
 
 inline ErrorCode ArrayStoragePimpl::locate_record_for_read(
   thread::Thread* context,
@@ -344,7 +680,11 @@ inline ErrorCode ArrayStoragePimpl::locate_record_for_read(
   uint16_t index = 0;
   ArrayPage* page = nullptr;
   CHECK_ERROR_CODE(lookup_for_read(context, offset, &page, &index, snapshot_record));
-  ASSERT_ND(page);
+  if (page == nullptr) {
+    ASSERT_ND(is_sparse());
+    *out = nullptr;
+    return kErrorCodeOk;
+  }
   ASSERT_ND(page->is_leaf());
   ASSERT_ND(page->get_array_range().contains(offset));
   ASSERT_ND(page->get_leaf_record(0, get_payload_size())->owner_id_.xct_id_.is_valid());
@@ -379,6 +719,10 @@ inline ErrorCode ArrayStoragePimpl::get_record(
   Record *record = nullptr;
   bool snapshot_record;
   CHECK_ERROR_CODE(locate_record_for_read(context, offset, &record, &snapshot_record));
+  if (record == nullptr) {
+    fill_default_payload(get_default_value(), payload_offset, payload_count, payload);
+    return kErrorCodeOk;
+  }
   CHECK_ERROR_CODE(context->get_current_xct().on_record_read(false, &record->owner_id_));
   std::memcpy(payload, record->payload_ + payload_offset, payload_count);
   return kErrorCodeOk;
@@ -394,6 +738,10 @@ ErrorCode ArrayStoragePimpl::get_record_primitive(
   Record *record = nullptr;
   bool snapshot_record;
   CHECK_ERROR_CODE(locate_record_for_read(context, offset, &record, &snapshot_record));
+  if (record == nullptr) {
+    fill_default_payload(get_default_value(), payload_offset, sizeof(T), payload);
+    return kErrorCodeOk;
+  }
   CHECK_ERROR_CODE(context->get_current_xct().on_record_read(false, &record->owner_id_));
   char* ptr = record->payload_ + payload_offset;
   *payload = *reinterpret_cast<const T*>(ptr);
@@ -407,6 +755,12 @@ inline ErrorCode ArrayStoragePimpl::get_record_payload(
   Record *record = nullptr;
   bool snapshot_record;
   CHECK_ERROR_CODE(locate_record_for_read(context, offset, &record, &snapshot_record));
+  if (record == nullptr) {
+    // We have to return a pointer to the payload, so we create the page in this case.
+    ASSERT_ND(is_sparse());
+    CHECK_ERROR_CODE(locate_record_for_write(context, offset, &record));
+    snapshot_record = false;
+  }
   xct::Xct& current_xct = context->get_current_xct();
   if (!snapshot_record &&
     current_xct.get_isolation_level() != xct::kDirtyRead) {
@@ -559,6 +913,13 @@ inline ErrorCode ArrayStoragePimpl::lookup_for_read(
       &current_page,
       current_page,
       route.route[level]));
+    if (current_page == nullptr) {
+      ASSERT_ND(is_sparse());
+      *out = nullptr;
+      *index = route.route[0];
+      *snapshot_page = in_snapshot;
+      return kErrorCodeOk;
+    }
     in_snapshot = current_page->header().snapshot_;
   }
   ASSERT_ND(current_page->is_leaf());
@@ -682,6 +1043,17 @@ inline ErrorCode ArrayStoragePimpl::get_record_primitive_batch(
   const ArrayOffset* offset_batch,
   T* payload_batch) {
   ASSERT_ND(batch_size <= kBatchMax);
+  if (is_sparse()) {
+    // follow_page_pointers_for_read_batch() can't skip null pages. a sparse array reads one by one
+    for (uint8_t i = 0; i < batch_size; ++i) {
+      CHECK_ERROR_CODE(get_record_primitive<T>(
+        context,
+        offset_batch[i],
+        payload_batch + i,
+        payload_offset));
+    }
+    return kErrorCodeOk;
+  }
   Record* record_batch[kBatchMax];
   bool snapshot_record_batch[kBatchMax];
   CHECK_ERROR_CODE(locate_record_for_read_batch(
@@ -720,6 +1092,13 @@ inline ErrorCode ArrayStoragePimpl::get_record_payload_batch(
   const ArrayOffset* offset_batch,
   const void** payload_batch) {
   ASSERT_ND(batch_size <= kBatchMax);
+  if (is_sparse()) {
+    // same as above
+    for (uint8_t i = 0; i < batch_size; ++i) {
+      CHECK_ERROR_CODE(get_record_payload(context, offset_batch[i], payload_batch + i));
+    }
+    return kErrorCodeOk;
+  }
   Record* record_batch[kBatchMax];
   bool snapshot_record_batch[kBatchMax];
   CHECK_ERROR_CODE(locate_record_for_read_batch(
@@ -1019,6 +1398,14 @@ ErrorCode ArrayStoragePimpl::follow_pointers_for_read_batch(
     ASSERT_ND(!parents[i]->is_leaf());
     ASSERT_ND(in_snapshot[i] == parents[i]->header().snapshot_);
     pointers[i] = &parents[i]->get_interior_record(index_in_parents[i]);
+    // this creates a page only when both pointers are null. see follow_pointer()
+    if (UNLIKELY(pointers[i]->is_both_null() && !in_snapshot[i] && get_meta().has_placement())) {
+      CHECK_ERROR_CODE(install_owner_volatile_page(
+        context,
+        pointers[i],
+        parents[i],
+        index_in_parents[i]));
+    }
   }
 
 #ifndef NDEBUG
@@ -1083,6 +1470,13 @@ ErrorCode ArrayStoragePimpl::follow_pointers_for_write_batch(
     ASSERT_ND(!parents[i]->is_leaf());
     ASSERT_ND(!parents[i]->header().snapshot_);
     pointers[i] = &parents[i]->get_interior_record(index_in_parents[i]);
+    if (UNLIKELY(pointers[i]->volatile_pointer_.is_null() && get_meta().has_placement())) {
+      CHECK_ERROR_CODE(install_owner_volatile_page(
+        context,
+        pointers[i],
+        parents[i],
+        index_in_parents[i]));
+    }
   }
 
 #ifndef NDEBUG
@@ -80,6 +80,14 @@ ErrorStack Composer::construct_root(const ConstructRootArguments& args) {
   }
 }
 
+ErrorStack Composer::prepare_drop_volatiles(const snapshot::Snapshot& new_snapshot) {
+  switch (storage_type_) {
+    case kHashStorage: return hash::HashComposer(this).prepare_drop_volatiles(new_snapshot);
+    default:
+      return kRetOk;
+  }
+}
+
 Composer::DropResult Composer::drop_volatiles(const DropVolatilesArguments& args) {
   switch (storage_type_) {
     case kArrayStorage:  return array::ArrayComposer(this).drop_volatiles(args);
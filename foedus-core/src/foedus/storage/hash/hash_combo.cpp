@@ -28,7 +28,7 @@ namespace storage {
 namespace hash {
 HashCombo::HashCombo(const void* key, uint16_t key_length, const HashMetadata& meta) {
   uint8_t bin_shifts = meta.get_bin_shifts();
-  hash_ = hashinate(key, key_length);
+  hash_ = meta.hashinate_key(key, key_length);
   bin_ = hash_ >> bin_shifts;
   fingerprint_ = DataPageBloomFilter::extract_fingerprint(hash_);
   route_ = IntermediateRoute::construct(bin_);
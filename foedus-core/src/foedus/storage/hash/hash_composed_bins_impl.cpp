@@ -60,7 +60,12 @@ ErrorCode ComposedBinsBuffer::next_pages() {
     cursor_buffer_ = 0;
     cursor_bin_ = 0;
     cursor_bin_count_ = buffer_[0].bin_count_;
-    ASSERT_ND(cursor_bin_count_ > 0);
+    if (UNLIKELY(cursor_bin_count_ == 0)) {
+      // A sub-tree without any composed bin still has one (empty) page. It has nothing to give.
+      ASSERT_ND(total_pages_ == 1U);
+      buffer_pos_ = total_pages_;
+      buffer_count_ = 0;
+    }
   } else {
     buffer_pos_ = total_pages_;
     buffer_count_ = 0;
@@ -25,11 +25,13 @@
 #include <ostream>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "foedus/engine.hpp"
 #include "foedus/engine_options.hpp"
 #include "foedus/assorted/assorted_func.hpp"
+#include "foedus/assorted/atomic_fences.hpp"
 #include "foedus/cache/snapshot_file_set.hpp"
 #include "foedus/debugging/stop_watch.hpp"
 #include "foedus/fs/direct_io_file.hpp"
@@ -51,6 +53,7 @@
 #include "foedus/storage/hash/hash_storage.hpp"
 #include "foedus/storage/hash/hash_storage_pimpl.hpp"
 #include "foedus/thread/numa_thread_scope.hpp"
+#include "foedus/xct/xct_manager.hpp"
 
 namespace foedus {
 namespace storage {
@@ -81,6 +84,27 @@ inline HashIntermediatePage* resolve_intermediate_impl(
   return ret;
 }
 
+/**
+ * bin_bits of the snapshot we are composing. It differs from the storage's current bin_bits
+ * only when this snapshot is resizing the storage.
+ * @see HASH_COMPOSE_RESIZE
+ */
+inline uint8_t get_composed_bin_bits(const HashStorage& storage) {
+  const uint8_t composing = storage.get_control_block()->composing_bin_bits_;
+  if (composing != 0) {
+    ASSERT_ND(composing > storage.get_bin_bits());
+    return composing;
+  }
+  return storage.get_bin_bits();
+}
+inline uint8_t get_composed_levels(const HashStorage& storage) {
+  return bins_to_level(1ULL << get_composed_bin_bits(storage));
+}
+inline uint16_t get_composed_root_children(const HashStorage& storage) {
+  const uint8_t levels = get_composed_levels(storage);
+  return assorted::int_div_ceil(1ULL << get_composed_bin_bits(storage), kHashMaxBins[levels - 1U]);
+}
+
 ///////////////////////////////////////////////////////////////////////
 ///
 ///  HashComposer methods
@@ -113,6 +137,7 @@ ErrorStack HashComposer::compose(const Composer::ComposeArguments& args) {
     &merge_sort,
     args.snapshot_writer_,
     args.previous_snapshot_files_,
+    args.reusable_memory_,
     args.root_info_page_);
   CHECK_ERROR(context.execute());
 
@@ -131,12 +156,19 @@ ErrorStack HashComposer::construct_root(const Composer::ConstructRootArguments&
 
   // compose() created root_info_pages that contain pointers to fill in the root page,
   // so we just find non-zero entry and copy it to root page.
-  const uint8_t levels = storage_.get_levels();
+  const uint8_t levels = get_composed_levels(storage_);
+  const bool resizing = storage_.get_control_block()->composing_bin_bits_ != 0;
 
   HashIntermediatePage* root_page = reinterpret_cast<HashIntermediatePage*>(
     args.gleaner_resource_->tmp_root_page_memory_.get_block());
   SnapshotPagePointer old_root_page_id = storage_.get_metadata()->root_snapshot_page_id_;
-  if (old_root_page_id != 0) {
+  if (resizing) {
+    // The reducer has rewritten all bins in the new layout. Nothing to inherit from old root.
+    LOG(INFO) << to_string() << " construct_root() resizing to "
+      << static_cast<int>(get_composed_bin_bits(storage_)) << " bin-bits. levels="
+      << static_cast<int>(levels);
+    root_page->initialize_snapshot_page(storage_id_, 0, levels - 1U, 0);
+  } else if (old_root_page_id != 0) {
     WRAP_ERROR_CODE(args.previous_snapshot_files_->read_page(old_root_page_id, root_page));
     ASSERT_ND(root_page->header().storage_id_ == storage_id_);
     ASSERT_ND(root_page->header().page_id_ == old_root_page_id);
@@ -196,16 +228,23 @@ ErrorStack HashComposer::construct_root(const Composer::ConstructRootArguments&
   ASSERT_ND(args.snapshot_writer_->get_next_page_id() == new_root_page_id + 1ULL);
 
   *args.new_root_page_pointer_ = new_root_page_id;
-  // AFTER writing out the root page, install the pointer to new root page
-  storage_.get_control_block()->root_page_pointer_.snapshot_pointer_ = new_root_page_id;
-  storage_.get_control_block()->meta_.root_snapshot_page_id_ = new_root_page_id;
+  HashStorageControlBlock* cb = storage_.get_control_block();
+  if (resizing) {
+    // Transactions still use the current layout, so the root pointer must not change yet.
+    // drop_volatiles() installs it while transactions are paused. see switch_to_resized_snapshot()
+    cb->meta_.snapshot_bin_bits_ = cb->composing_bin_bits_;
+  } else {
+    // AFTER writing out the root page, install the pointer to new root page
+    cb->root_page_pointer_.snapshot_pointer_ = new_root_page_id;
+  }
+  cb->meta_.root_snapshot_page_id_ = new_root_page_id;
   return kRetOk;
 }
 
 ErrorStack HashComposer::construct_root_single_level(
   const Composer::ConstructRootArguments& args,
   HashIntermediatePage* root_page) {
-  ASSERT_ND(storage_.get_levels() == 1U);
+  ASSERT_ND(get_composed_levels(storage_) == 1U);
   LOG(INFO) << to_string() << " construct_root() Single-level path";
   snapshot::SnapshotId new_snapshot_id = args.snapshot_writer_->get_snapshot_id();
 
@@ -214,7 +253,7 @@ ErrorStack HashComposer::construct_root_single_level(
   HashComposedBinsPage* buffer = reinterpret_cast<HashComposedBinsPage*>(
     args.gleaner_resource_->writer_pool_memory_.get_block());  // whatever memory. just 1 thread.
   uint32_t buffer_pages = args.gleaner_resource_->writer_pool_memory_.get_size() / kPageSize;
-  uint16_t root_children = storage_.get_root_children();
+  uint16_t root_children = get_composed_root_children(storage_);
   ASSERT_ND(buffer_pages > root_children);
   for (uint32_t i = 0; i < args.root_info_pages_count_; ++i) {
     const HashRootInfoPage* casted
@@ -261,7 +300,8 @@ ErrorStack HashComposer::construct_root_multi_level(
   uint16_t numa_node,
   HashIntermediatePage* root_page) {
   const uint16_t nodes = engine_->get_soc_count();
-  const uint16_t root_children = storage_.get_root_children();
+  const uint8_t levels = get_composed_levels(storage_);
+  const uint16_t root_children = get_composed_root_children(storage_);
   ASSERT_ND(numa_node < nodes);
   thread::NumaThreadScope numa_scope(numa_node);
 
@@ -353,7 +393,7 @@ ErrorStack HashComposer::construct_root_multi_level(
       WRAP_ERROR_CODE(snapshot_writer->dump_pages(0, writer_buffer_pos));
 
       // higher-levels need to set page IDs because we couldn't know their page IDs back then.
-      if (storage_.get_levels() == 2U) {
+      if (levels == 2U) {
         // 2-level means root's child is level-0 page, thus no "higher-level".
         ASSERT_ND(writer_higher_buffer_pos == 0);
       } else {
@@ -362,7 +402,7 @@ ErrorStack HashComposer::construct_root_multi_level(
           = reinterpret_cast<HashIntermediatePage*>(snapshot_writer->get_intermediate_base());
         // the first page is always the root-child because we open it first
         HashIntermediatePage* root_child = higher_base + 0;
-        ASSERT_ND(root_child->get_level() == storage_.get_levels() - 2U);
+        ASSERT_ND(root_child->get_level() == levels - 2U);
         ASSERT_ND(root_page->get_pointer(index).snapshot_pointer_ == 0);
         // and this is the highest level for this sub-tree, so there is no pointer to this page.
         // hence, page_id==0 means null.
@@ -411,6 +451,7 @@ ErrorStack HashComposer::construct_root_multi_level(
   if (numa_node != 0) {
     snapshot_writer_to_delete.get()->close();
   }
+  CHECK_ERROR(fileset.uninitialize());
 
   VLOG(0) << to_string() << " construct_root() child thread numa_node-" << numa_node << " done";
   return kRetOk;
@@ -438,6 +479,7 @@ HashComposeContext::HashComposeContext(
   snapshot::MergeSort*              merge_sort,
   snapshot::SnapshotWriter*         snapshot_writer,
   cache::SnapshotFileSet*           previous_snapshot_files,
+  memory::AlignedMemory*            reusable_memory,
   Page*                             root_info_page)
   : engine_(engine),
     merge_sort_(merge_sort),
@@ -447,15 +489,21 @@ HashComposeContext::HashComposeContext(
     storage_(engine, storage_id_),
     snapshot_writer_(snapshot_writer),
     previous_snapshot_files_(previous_snapshot_files),
+    reusable_memory_(reusable_memory),
     root_info_page_(reinterpret_cast<HashRootInfoPage*>(root_info_page)),
     partitionable_(engine_->get_soc_count() > 1U),
-    levels_(storage_.get_levels()),
-    bin_bits_(storage_.get_bin_bits()),
-    bin_shifts_(storage_.get_bin_shifts()),
-    root_children_(storage_.get_root_children()),
+    levels_(get_composed_levels(storage_)),
+    bin_bits_(get_composed_bin_bits(storage_)),
+    bin_shifts_(64U - bin_bits_),
+    root_children_(get_composed_root_children(storage_)),
     numa_node_(snapshot_writer->get_numa_node()),
-    total_bin_count_(storage_.get_bin_count()),
+    total_bin_count_(1ULL << bin_bits_),
     previous_root_page_pointer_(storage_.get_metadata()->root_snapshot_page_id_),
+    resizing_(bin_bits_ != storage_.get_bin_bits()),
+    previous_levels_(storage_.get_levels()),
+    previous_bin_shifts_(storage_.get_bin_shifts()),
+    previous_bin_count_(storage_.get_bin_count()),
+    split_bits_(bin_bits_ - storage_.get_bin_bits()),
     volatile_resolver_(engine->get_memory_manager()->get_global_volatile_page_resolver()) {
   cur_path_memory_.alloc(
     kPageSize * kHashMaxLevels,
@@ -463,17 +511,21 @@ HashComposeContext::HashComposeContext(
     memory::AlignedMemory::kNumaAllocOnnode,
     numa_node_);
   cur_path_ = reinterpret_cast<HashIntermediatePage*>(cur_path_memory_.get_block());
-  cur_path_lowest_level_ = levels_;
+  cur_path_lowest_level_ = previous_levels_;
   cur_path_valid_range_ = HashBinRange(0, 0);
 
   cur_bin_ = kCurBinNotOpened;
+  next_unvisited_bin_ = 0;
   cur_intermediate_tail_ = nullptr;
 
-  data_page_io_memory_.alloc(
-    kPageSize,
+  read_ahead_memory_.alloc(
+    kPageSize * kReadAheadPages,
     kPageSize,
     memory::AlignedMemory::kNumaAllocOnnode,
     numa_node_);
+  read_ahead_begin_ = 0;
+  read_ahead_count_ = 0;
+  read_ahead_upto_ = 0;
 
   allocated_pages_ = 0;
   allocated_intermediates_ = 0;
@@ -484,14 +536,25 @@ HashComposeContext::HashComposeContext(
   max_intermediates_ = snapshot_writer_->get_intermediate_size();
 }
 
+HashComposeContext::~HashComposeContext() {
+  if (reusable_memory_ && cur_bin_table_.get_records_capacity() > 0) {
+    cur_bin_table_.give_memory(reusable_memory_);
+  }
+}
+
 ErrorStack HashComposeContext::execute() {
   // Initializations
   std::memset(root_info_page_, 0, kPageSize);
   root_info_page_->header().storage_id_ = storage_id_;
   CHECK_ERROR(init_intermediates());
   CHECK_ERROR(init_cur_path());
-  WRAP_ERROR_CODE(cur_bin_table_.create_memory(numa_node_));  // TASK(Hideaki) reuse memory
-  cur_bin_table_.clean();
+  if (reusable_memory_ && !reusable_memory_->is_null()) {
+    // reuse the memory of previous compose() in this reducer. steal_memory() cleans it up.
+    cur_bin_table_.steal_memory(reusable_memory_);
+  } else {
+    WRAP_ERROR_CODE(cur_bin_table_.create_memory(numa_node_));
+    cur_bin_table_.clean();
+  }
   VLOG(0) << "HashComposer-" << storage_id_ << " initialization done. processing...";
 
   bool processed_any = false;
@@ -504,15 +567,20 @@ ErrorStack HashComposeContext::execute() {
     }
     processed_any = true;
     const snapshot::MergeSort::SortEntry* sort_entries = merge_sort_->get_sort_entries();
+    if (count > 0) {
+      // in resizing_ mode, we open all bins anyway.
+      read_ahead_upto_ = resizing_ ? previous_bin_count_ : sort_entries[count - 1U].get_key() + 1U;
+    }
     uint64_t cur = 0;
     while (cur < count) {
       HashBin head_bin = sort_entries[cur].get_key();
-      ASSERT_ND(head_bin < storage_.get_bin_count());
+      ASSERT_ND(head_bin < previous_bin_count_);
       if (cur_bin_ != head_bin) {
         // now we have to finalize the previous bin and switch to a new bin!
         ASSERT_ND(cur_bin_ == kCurBinNotOpened || cur_bin_ < head_bin);  // sorted by bins
         CHECK_ERROR(close_cur_bin());
         ASSERT_ND(cur_bin_ == kCurBinNotOpened);
+        CHECK_ERROR(rewrite_unvisited_bins(head_bin));
         CHECK_ERROR(open_cur_bin(head_bin));
         ASSERT_ND(cur_bin_ == head_bin);
       }
@@ -543,17 +611,26 @@ ErrorStack HashComposeContext::execute() {
 }
 
 ErrorCode HashComposeContext::apply_batch(uint64_t cur, uint64_t next) {
-  // TASK(Hideaki) prefetching in hash composer.
   const uint16_t kFetchSize = 8;
   const log::RecordLogType* logs[kFetchSize];
   while (cur < next) {
     uint16_t desired = std::min<uint16_t>(kFetchSize, next - cur);
     uint16_t fetched = merge_sort_->fetch_logs(cur, desired, logs);
+    // fetch_logs() prefetched the logs. Until they arrive, prefetch the buckets, then
+    // the head records in the buckets, so that the cache misses overlap.
+    for (uint16_t i = 0; i < kFetchSize && LIKELY(i < fetched); ++i) {
+      const HashCommonLogType* log = reinterpret_cast<const HashCommonLogType*>(logs[i]);
+      cur_bin_table_.prefetch_bucket(log->hash_);
+    }
+    for (uint16_t i = 0; i < kFetchSize && LIKELY(i < fetched); ++i) {
+      const HashCommonLogType* log = reinterpret_cast<const HashCommonLogType*>(logs[i]);
+      cur_bin_table_.prefetch_bucket_head(log->hash_);
+    }
     for (uint16_t i = 0; i < kFetchSize && LIKELY(i < fetched); ++i) {
       const HashCommonLogType* log = reinterpret_cast<const HashCommonLogType*>(logs[i]);
       log->assert_type();
       HashValue hash = log->hash_;
-      ASSERT_ND(cur_bin_ == (hash >> storage_.get_bin_shifts()));
+      ASSERT_ND(cur_bin_ == (hash >> previous_bin_shifts_));
       if (log->header_.get_type() == log::kLogCodeHashOverwrite) {
         CHECK_ERROR_CODE(cur_bin_table_.overwrite_record(
           log->header_.xct_id_,
@@ -571,6 +648,16 @@ ErrorCode HashComposeContext::apply_batch(uint64_t cur, uint64_t next) {
           hash,
           log->get_payload(),
           log->payload_count_));
+      } else if (log->header_.get_type() == log::kLogCodeHashIncrement) {
+        const HashIncrementLogType* casted = reinterpret_cast<const HashIncrementLogType*>(log);
+        CHECK_ERROR_CODE(cur_bin_table_.increment_record(
+          log->header_.xct_id_,
+          log->get_key(),
+          log->key_length_,
+          hash,
+          casted->get_value_type(),
+          casted->get_addendum(),
+          log->payload_offset_));
       } else if (log->header_.get_type() == log::kLogCodeHashUpdate) {
         CHECK_ERROR_CODE(cur_bin_table_.update_record(
           log->header_.xct_id_,
@@ -581,8 +668,11 @@ ErrorCode HashComposeContext::apply_batch(uint64_t cur, uint64_t next) {
           log->payload_count_));
       } else {
         ASSERT_ND(log->header_.get_type() == log::kLogCodeHashDelete);
+        // the xct_id in log header doesn't have the delete-flag, which the record must have.
+        xct::XctId xct_id = log->header_.xct_id_;
+        xct_id.set_deleted();
         CHECK_ERROR_CODE(cur_bin_table_.delete_record(
-          log->header_.xct_id_,
+          xct_id,
           log->get_key(),
           log->key_length_,
           hash));
@@ -596,6 +686,7 @@ ErrorCode HashComposeContext::apply_batch(uint64_t cur, uint64_t next) {
 
 ErrorStack HashComposeContext::finalize() {
   CHECK_ERROR(close_cur_bin());
+  CHECK_ERROR(rewrite_unvisited_bins(previous_bin_count_));
 
   // flush the main buffer. now we finalized all data pages
   if (allocated_pages_ > 0) {
@@ -604,9 +695,12 @@ ErrorStack HashComposeContext::finalize() {
   }
 
   // as soon as we flush out all data pages, we can install snapshot pointers to them.
-  // this is just about data pages (head pages in each bin), not intermediate pages
-  uint64_t installed_count = 0;
-  CHECK_ERROR(install_snapshot_data_pages(&installed_count));
+  // this is just about data pages (head pages in each bin), not intermediate pages.
+  // When resizing, the volatile pages are in the old layout. drop_volatiles() replaces them.
+  if (!resizing_) {
+    uint64_t installed_count = 0;
+    CHECK_ERROR(install_snapshot_data_pages(&installed_count));
+  }
 
   // then dump out HashComposedBinsPage.
   // we stored them in a separate buffer, and now finally we can get their page IDs.
@@ -637,6 +731,22 @@ ErrorStack HashComposeContext::finalize() {
   return kRetOk;
 }
 
+ErrorStack HashComposeContext::rewrite_unvisited_bins(HashBin upto) {
+  ASSERT_ND(cur_bin_ == kCurBinNotOpened);
+  if (!resizing_ || is_initial_snapshot()) {
+    return kRetOk;
+  }
+
+  // The new snapshot must contain all records of the previous snapshot, so we rewrite
+  // bins that received no logs, too. Empty bins are cheap because open_cur_bin() reads nothing.
+  ASSERT_ND(upto <= previous_bin_count_);
+  while (next_unvisited_bin_ < upto) {
+    CHECK_ERROR(open_cur_bin(next_unvisited_bin_));
+    CHECK_ERROR(close_cur_bin());
+  }
+  return kRetOk;
+}
+
 ErrorCode HashComposeContext::dump_data_pages() {
   CHECK_ERROR_CODE(snapshot_writer_->dump_pages(0, allocated_pages_));
   ASSERT_ND(snapshot_writer_->get_next_page_id()
@@ -679,24 +789,24 @@ SnapshotPagePointer HashComposeContext::get_cur_path_bin_head(HashBin bin) const
     return 0;
   }
   ASSERT_ND(cur_path_[0].get_bin_range().contains(bin));
-  uint16_t index = bin - cur_path_[0].get_bin_range().end_;
+  uint16_t index = bin - cur_path_[0].get_bin_range().begin_;
   return cur_path_[0].get_pointer(index).snapshot_pointer_;
 }
 
 ErrorStack HashComposeContext::init_cur_path() {
   if (previous_root_page_pointer_ == 0) {
     ASSERT_ND(is_initial_snapshot());
-    std::memset(cur_path_, 0, kPageSize * levels_);
-    cur_path_lowest_level_ = levels_;
-    cur_path_valid_range_ = HashBinRange(0, kHashMaxBins[levels_]);
+    std::memset(cur_path_, 0, kPageSize * previous_levels_);
+    cur_path_lowest_level_ = previous_levels_;
+    cur_path_valid_range_ = HashBinRange(0, kHashMaxBins[previous_levels_]);
   } else {
     ASSERT_ND(!is_initial_snapshot());
-    HashIntermediatePage* root = get_cur_path_page(levels_ - 1U);
+    HashIntermediatePage* root = get_cur_path_page(previous_levels_ - 1U);
     WRAP_ERROR_CODE(previous_snapshot_files_->read_page(previous_root_page_pointer_, root));
     ASSERT_ND(root->header().storage_id_ == storage_id_);
     ASSERT_ND(root->header().page_id_ == previous_root_page_pointer_);
-    ASSERT_ND(root->get_level() + 1U == levels_);
-    ASSERT_ND(root->get_bin_range() == HashBinRange(0ULL, kHashMaxBins[levels_]));
+    ASSERT_ND(root->get_level() + 1U == previous_levels_);
+    ASSERT_ND(root->get_bin_range() == HashBinRange(0ULL, kHashMaxBins[previous_levels_]));
     cur_path_lowest_level_ = root->get_level();
     cur_path_valid_range_ = root->get_bin_range();
 
@@ -712,7 +822,7 @@ ErrorStack HashComposeContext::init_cur_path() {
         ASSERT_ND(child->header().storage_id_ == storage_id_);
         ASSERT_ND(child->header().page_id_ == pointer);
         ASSERT_ND(child->get_level() + 1U == parent->get_level());
-        ASSERT_ND(child->get_bin_range() == HashBinRange(0ULL, parent->get_level()));
+        ASSERT_ND(child->get_bin_range() == HashBinRange(0ULL, kHashMaxBins[parent->get_level()]));
         cur_path_lowest_level_ = child->get_level();
         cur_path_valid_range_ = child->get_bin_range();
         parent = child;
@@ -727,7 +837,7 @@ inline ErrorCode HashComposeContext::update_cur_path_if_needed(HashBin bin) {
 
   // Even when LIKELY mis-predicts, the penalty is amortized by the page-read cost.
   if (LIKELY(is_initial_snapshot()
-    || levels_ == 1U
+    || previous_levels_ == 1U
     || (cur_path_valid_range_.contains(bin) && cur_path_lowest_level_ == 0))) {
     return kErrorCodeOk;
   }
@@ -737,13 +847,14 @@ inline ErrorCode HashComposeContext::update_cur_path_if_needed(HashBin bin) {
 
 ErrorCode HashComposeContext::update_cur_path(HashBin bin) {
   ASSERT_ND(!is_initial_snapshot());
-  ASSERT_ND(!cur_path_valid_range_.contains(bin));
-  ASSERT_ND(levels_ > 1U);  // otherwise no page switch should happen
+  // cur_path_valid_range_ might contain bin when the lowest page had a null child pointer.
+  ASSERT_ND(previous_levels_ > 1U);  // otherwise no page switch should happen
   ASSERT_ND(verify_cur_path());
 
   // goes up until cur_path_valid_range_.contains(bin)
   while (!cur_path_valid_range_.contains(bin)) {
-    ASSERT_ND(cur_path_lowest_level_ + 1U < levels_);  // otherwise even root doesn't contain it
+    // otherwise even root doesn't contain it
+    ASSERT_ND(cur_path_lowest_level_ + 1U < previous_levels_);
     ++cur_path_lowest_level_;
     cur_path_valid_range_ = get_cur_path_lowest()->get_bin_range();
     ASSERT_ND(get_cur_path_lowest()->get_bin_range() == cur_path_valid_range_);
@@ -755,7 +866,7 @@ ErrorCode HashComposeContext::update_cur_path(HashBin bin) {
 #ifndef NDEBUG
   // route[level+1] is the ordinal in intermediate page of the level+1, pointing to the child.
   // thus cur_path[level] should have that pointer as its page ID.
-  for (uint8_t level = cur_path_lowest_level_; level + 1U < levels_; ++level) {
+  for (uint8_t level = cur_path_lowest_level_; level + 1U < previous_levels_; ++level) {
     SnapshotPagePointer child_id = get_cur_path_page(level)->header().page_id_;
     HashIntermediatePage* parent = get_cur_path_page(level + 1U);
     ASSERT_ND(parent->get_pointer(route.route[level + 1U]).snapshot_pointer_ == child_id);
@@ -770,7 +881,7 @@ ErrorCode HashComposeContext::update_cur_path(HashBin bin) {
       // the page doesn't exist in previous snapshot. that's fine.
       break;
     } else {
-      HashIntermediatePage* child = get_cur_path_page(cur_path_lowest_level_ + 1U);
+      HashIntermediatePage* child = get_cur_path_page(cur_path_lowest_level_ - 1U);
       CHECK_ERROR_CODE(previous_snapshot_files_->read_page(pointer, child));
       ASSERT_ND(child->header().storage_id_ == storage_id_);
       ASSERT_ND(child->header().page_id_ == pointer);
@@ -789,12 +900,12 @@ ErrorCode HashComposeContext::update_cur_path(HashBin bin) {
 
 bool HashComposeContext::verify_cur_path() const {
   if (is_initial_snapshot()) {
-    ASSERT_ND(cur_path_lowest_level_ == levels_);
+    ASSERT_ND(cur_path_lowest_level_ == previous_levels_);
   } else {
-    ASSERT_ND(cur_path_lowest_level_ < levels_);
+    ASSERT_ND(cur_path_lowest_level_ < previous_levels_);
   }
   for (uint8_t level = cur_path_lowest_level_; level < kHashMaxLevels; ++level) {
-    if (level >= levels_) {
+    if (level >= previous_levels_) {
       ASSERT_ND(cur_path_[level].header().page_id_ == 0);
       continue;
     }
@@ -831,17 +942,53 @@ ErrorStack HashComposeContext::close_cur_bin() {
     LOG(WARNING) << "A hash bin has more than 1000 records?? That's an unexpected usage."
       << " There is either a skew or mis-sizing.";
   }
-  uint64_t remaining_buffer = allocated_pages_ - max_pages_;
-  if (UNLIKELY(remaining_buffer < physical_records)) {  // super-conservative. one-record per page.
-    WRAP_ERROR_CODE(dump_data_pages());
+  // Each output bin needs its head page even if it has no records.
+  const uint64_t required_pages = physical_records + (1ULL << split_bits_);
+  ASSERT_ND(allocated_pages_ <= max_pages_);
+  if (UNLIKELY(allocated_pages_ > 0 && max_pages_ - allocated_pages_ < required_pages)) {
+    WRAP_ERROR_CODE(dump_data_pages());  // super-conservative. one-record per page.
+  }
+
+  if (!resizing_) {
+    WRAP_ERROR_CODE(write_out_bin(cur_bin_));
+  } else {
+    // cur_bin_ becomes a contiguous range of bins in the new layout. We write out only those
+    // that have live records, visiting them in ascending order as append_to_intermediate needs.
+    const HashBin end = (cur_bin_ + 1ULL) << split_bits_;
+    HashBin next = cur_bin_ << split_bits_;
+    const uint32_t begin_record = cur_bin_table_.get_first_record();
+    const uint32_t end_record = cur_bin_table_.get_records_consumed();
+    while (true) {
+      HashBin lowest = end;
+      for (uint32_t i = begin_record; i < end_record; ++i) {
+        const HashTmpBin::Record* record = cur_bin_table_.get_record(i);
+        if (record->xct_id_.is_deleted()) {
+          continue;
+        }
+        const HashBin bin = record->hash_ >> bin_shifts_;
+        ASSERT_ND(bin >> split_bits_ == cur_bin_);
+        if (bin >= next && bin < lowest) {
+          lowest = bin;
+        }
+      }
+      if (lowest == end) {
+        break;
+      }
+      WRAP_ERROR_CODE(write_out_bin(lowest));
+      next = lowest + 1U;
+    }
   }
 
+  cur_bin_ = kCurBinNotOpened;
+  return kRetOk;
+}
+
+ErrorCode HashComposeContext::write_out_bin(HashBin bin) {
+  ASSERT_ND(bin >> split_bits_ == cur_bin_);
   const SnapshotPagePointer base_pointer = snapshot_writer_->get_next_page_id();
   HashDataPage* head_page = page_base_ + allocated_pages_;
   SnapshotPagePointer head_page_id = base_pointer + allocated_pages_;
-  const uint8_t bin_bits = storage_.get_bin_bits();
-  const uint8_t bin_shifts = storage_.get_bin_shifts();
-  head_page->initialize_snapshot_page(storage_id_, head_page_id, cur_bin_, bin_bits, bin_shifts);
+  head_page->initialize_snapshot_page(storage_id_, head_page_id, bin, bin_bits_, bin_shifts_);
   ++allocated_pages_;
   ASSERT_ND(allocated_pages_ <= max_pages_);
 
@@ -850,17 +997,20 @@ ErrorStack HashComposeContext::close_cur_bin() {
   const uint32_t end = cur_bin_table_.get_records_consumed();
   for (uint32_t i = begin; i < end; ++i) {
     HashTmpBin::Record* record = cur_bin_table_.get_record(i);
-    ASSERT_ND(cur_bin_ == (record->hash_ >> storage_.get_bin_shifts()));
+    ASSERT_ND(cur_bin_ == (record->hash_ >> previous_bin_shifts_));
     if (record->xct_id_.is_deleted()) {
       continue;
     }
+    if (resizing_ && (record->hash_ >> bin_shifts_) != bin) {
+      continue;
+    }
     uint16_t available = cur_page->available_space();
     uint16_t required = cur_page->required_space(record->key_length_, record->payload_length_);
     if (available < required) {
       // move on to next page
       SnapshotPagePointer page_id = base_pointer + allocated_pages_;
       HashDataPage* next_page = page_base_ + allocated_pages_;
-      next_page->initialize_snapshot_page(storage_id_, page_id, cur_bin_, bin_bits, bin_shifts);
+      next_page->initialize_snapshot_page(storage_id_, page_id, bin, bin_bits_, bin_shifts_);
       cur_page->next_page_address()->snapshot_pointer_ = page_id;
       cur_page = next_page;
 
@@ -879,11 +1029,8 @@ ErrorStack HashComposeContext::close_cur_bin() {
       record->payload_length_);
   }
 
-  // finally, register the head page in intermediate page. the bin is now closed.
-  WRAP_ERROR_CODE(append_to_intermediate(head_page_id, cur_bin_));
-  cur_bin_ = kCurBinNotOpened;
-
-  return kRetOk;
+  // finally, register the head page in intermediate page.
+  return append_to_intermediate(head_page_id, bin);
 }
 
 ErrorStack HashComposeContext::open_cur_bin(HashBin bin) {
@@ -896,9 +1043,8 @@ ErrorStack HashComposeContext::open_cur_bin(HashBin bin) {
   // Load-up the cur_bin_table_ with existing records in previous snapshot
   SnapshotPagePointer page_id = get_cur_path_bin_head(bin);
   while (page_id) {
-    HashDataPage* page = reinterpret_cast<HashDataPage*>(data_page_io_memory_.get_block());
-    // hopefully, most of this read will be sequential. so underlying HW will pre-fetch and cache
-    WRAP_ERROR_CODE(previous_snapshot_files_->read_page(page_id, page));
+    HashDataPage* page;
+    WRAP_ERROR_CODE(read_previous_data_page(bin, page_id, &page));
     ASSERT_ND(page->header().storage_id_ == storage_id_);
     ASSERT_ND(page->header().page_id_ == page_id);
     ASSERT_ND(page->get_bin() == bin);
@@ -922,9 +1068,52 @@ ErrorStack HashComposeContext::open_cur_bin(HashBin bin) {
   }
 
   cur_bin_ = bin;
+  next_unvisited_bin_ = bin + 1U;
   return kRetOk;
 }
 
+ErrorCode HashComposeContext::read_previous_data_page(
+  HashBin bin,
+  SnapshotPagePointer page_id,
+  HashDataPage** out) {
+  ASSERT_ND(page_id != 0);
+  ASSERT_ND(verify_old_pointer(page_id));
+  HashDataPage* base = reinterpret_cast<HashDataPage*>(read_ahead_memory_.get_block());
+  if (page_id >= read_ahead_begin_ && page_id < read_ahead_begin_ + read_ahead_count_) {
+    *out = base + (page_id - read_ahead_begin_);
+    return kErrorCodeOk;
+  }
+
+  // Not in the window. Let's see how far the head pages of the following bins are.
+  // Pages of one bin are contiguous and bins are written in order, so most of them follow.
+  // All pages between two pages of the same snapshot file exist, so we can read them at once.
+  uint32_t count = 1;
+  if (cur_path_lowest_level_ == 0) {
+    const HashBinRange range = cur_path_[0].get_bin_range();
+    ASSERT_ND(range.contains(bin));
+    const HashBin end = std::min<HashBin>(range.end_, read_ahead_upto_);
+    for (HashBin b = bin + 1U; b < end; ++b) {
+      SnapshotPagePointer head = cur_path_[0].get_pointer(b - range.begin_).snapshot_pointer_;
+      if (head == 0 || head <= page_id) {
+        continue;  // empty bin, or written in another snapshot (another file).
+      } else if (head >= page_id + kReadAheadPages) {
+        break;
+      }
+      ASSERT_ND(extract_snapshot_id_from_snapshot_pointer(head)
+        == extract_snapshot_id_from_snapshot_pointer(page_id));
+      ASSERT_ND(extract_numa_node_from_snapshot_pointer(head)
+        == extract_numa_node_from_snapshot_pointer(page_id));
+      count = head - page_id + 1U;
+    }
+  }
+
+  CHECK_ERROR_CODE(previous_snapshot_files_->read_pages(page_id, count, base));
+  read_ahead_begin_ = page_id;
+  read_ahead_count_ = count;
+  *out = base;
+  return kErrorCodeOk;
+}
+
 ///////////////////////////////////////////////////////////////////////
 ///
 ///  HashComposedBinsPage (snapshot's intermediate) related methods
@@ -934,7 +1123,7 @@ ErrorStack HashComposeContext::init_intermediates() {
   ASSERT_ND(allocated_intermediates_ == 0);
   ASSERT_ND(intermediate_base_
     == reinterpret_cast<HashComposedBinsPage*>(snapshot_writer_->get_intermediate_base()));
-  uint16_t count = storage_.get_root_children();
+  uint16_t count = root_children_;
   if (max_intermediates_ < count) {
     return ERROR_STACK_MSG(kErrorCodeInternalError, "max_intermediates weirdly too small");
   }
@@ -1164,6 +1353,19 @@ ErrorStack HashComposeContext::install_snapshot_data_pages_root_child(
 /////////////////////////////////////////////////////////////////////////////
 Composer::DropResult HashComposer::drop_volatiles(const Composer::DropVolatilesArguments& args) {
   Composer::DropResult result(args);
+  HashStorageControlBlock* cb = storage_.get_control_block();
+  // Hot-key directories might point to data pages we are dropping. No transaction is running
+  // now, so we just empty them. Each thread of a partitioned drop does it, which is harmless.
+  HashStorage storage(engine_, storage_id_);
+  HashStoragePimpl(&storage).clear_hot_directories();
+  if (cb->meta_.snapshot_bin_bits_ != 0) {
+    // This snapshot resized the storage, so all volatile pages are in the old layout.
+    // We replace all of them in drop_root_volatile(), which is called because we report that
+    // we dropped everything. Just install the new root here. No transaction is running now.
+    LOG(INFO) << to_string() << " was resized in this snapshot. Will switch to the new root";
+    cb->root_page_pointer_.snapshot_pointer_ = cb->meta_.root_snapshot_page_id_;
+    return result;
+  }
   if (storage_.get_hash_metadata()->keeps_all_volatile_pages()) {
     LOG(INFO) << "Keep-all-volatile: Storage-" << storage_.get_name()
       << " is configured to keep all volatile pages.";
@@ -1186,15 +1388,42 @@ Composer::DropResult HashComposer::drop_volatiles(const Composer::DropVolatilesA
   uint16_t count = storage_.get_root_children();
   uint8_t root_level = volatile_page->get_level();
   ASSERT_ND(root_level + 1U == storage_.get_levels());
+
+  // Composer installs new snapshot pointers only to data pages. Before dropping an intermediate
+  // page, its parent must point to the intermediate page in the new snapshot, so we read them.
+  cache::SnapshotFileSet fileset(engine_);
+  COERCE_ERROR(fileset.initialize());
+  UninitializeGuard fileset_guard(&fileset, UninitializeGuard::kWarnIfUninitializeError);
+  memory::AlignedMemory io_memory;
+  HashIntermediatePage* root_image = nullptr;
+  HashIntermediatePage* io_page = nullptr;
+  if (root_level > 0) {
+    io_memory.alloc(
+      kPageSize * 2U,
+      kPageSize,
+      memory::AlignedMemory::kNumaAllocOnnode,
+      args.my_partition_);
+    root_image = reinterpret_cast<HashIntermediatePage*>(io_memory.get_block());
+    io_page = root_image + 1;
+    COERCE_ERROR_CODE(fileset.read_page(root_pointer->snapshot_pointer_, root_image));
+    ASSERT_ND(root_image->get_level() == root_level);
+  }
+
   for (uint16_t i = 0; i < count; ++i) {
     DualPagePointer& child_pointer = volatile_page->get_pointer(i);
-    if (!child_pointer.volatile_pointer_.is_null() && child_pointer.snapshot_pointer_ != 0) {
-      uint16_t partition = extract_numa_node_from_snapshot_pointer(child_pointer.snapshot_pointer_);
+    SnapshotPagePointer snapshot_pointer = child_pointer.snapshot_pointer_;
+    if (root_image) {
+      snapshot_pointer = root_image->get_pointer(i).snapshot_pointer_;
+    }
+    if (!child_pointer.volatile_pointer_.is_null() && snapshot_pointer != 0) {
+      uint16_t partition = extract_numa_node_from_snapshot_pointer(snapshot_pointer);
       if (!args.partitioned_drop_ || partition == args.my_partition_) {
-        drop_volatiles_child(args, &child_pointer, root_level, &result);
+        child_pointer.snapshot_pointer_ = snapshot_pointer;
+        drop_volatiles_child(args, &child_pointer, root_level, &fileset, io_page, &result);
       }
     }
   }
+  COERCE_ERROR(fileset.uninitialize());
   // root page is kept at this point in this case. we need to check with other threads
   return result;
 }
@@ -1203,9 +1432,11 @@ void HashComposer::drop_volatiles_child(
   const Composer::DropVolatilesArguments& args,
   DualPagePointer* child_pointer,
   uint8_t parent_level,
+  cache::SnapshotFileSet* fileset,
+  HashIntermediatePage* io_page,
   Composer::DropResult *result) {
   if (parent_level > 0) {
-    result->combine(drop_volatiles_recurse(args, child_pointer));
+    result->combine(drop_volatiles_recurse(args, child_pointer, fileset, io_page));
   } else {
     if (can_drop_volatile_bin(
       child_pointer->volatile_pointer_,
@@ -1221,6 +1452,10 @@ void HashComposer::drop_volatiles_child(
 }
 
 void HashComposer::drop_root_volatile(const Composer::DropVolatilesArguments& args) {
+  if (storage_.get_hash_metadata()->snapshot_bin_bits_ != 0) {
+    COERCE_ERROR(switch_to_resized_snapshot(args));
+    return;
+  }
   if (storage_.get_hash_metadata()->keeps_all_volatile_pages()) {
     LOG(INFO) << "Oh, but keep-all-volatile is on. Storage-" << storage_.get_name()
       << " is configured to keep all volatile pages.";
@@ -1279,7 +1514,9 @@ void HashComposer::drop_volatile_entire_bin(
 
 inline Composer::DropResult HashComposer::drop_volatiles_recurse(
   const Composer::DropVolatilesArguments& args,
-  DualPagePointer* pointer) {
+  DualPagePointer* pointer,
+  cache::SnapshotFileSet* fileset,
+  HashIntermediatePage* io_page) {
   ASSERT_ND(pointer->snapshot_pointer_ == 0
     || extract_snapshot_id_from_snapshot_pointer(pointer->snapshot_pointer_)
         != snapshot::kNullSnapshotId);
@@ -1293,10 +1530,21 @@ inline Composer::DropResult HashComposer::drop_volatiles_recurse(
   // In that case, we must keep this volatile page, too.
   // Intermediate volatile page is kept iff there are no child volatile pages.
   uint8_t this_level = page->get_level();
+  if (this_level > 0 && pointer->snapshot_pointer_ != 0) {
+    // Same as drop_volatiles(). Children are intermediate pages, so get their new pointers.
+    COERCE_ERROR_CODE(fileset->read_page(pointer->snapshot_pointer_, io_page));
+    ASSERT_ND(io_page->get_level() == this_level);
+    for (uint16_t i = 0; i < kHashIntermediatePageFanout; ++i) {
+      DualPagePointer* child_pointer = page->get_pointer_address(i);
+      if (!child_pointer->volatile_pointer_.is_null()) {
+        child_pointer->snapshot_pointer_ = io_page->get_pointer(i).snapshot_pointer_;
+      }
+    }
+  }
   for (uint16_t i = 0; i < kHashIntermediatePageFanout; ++i) {
     DualPagePointer* child_pointer = page->get_pointer_address(i);
     if (!child_pointer->volatile_pointer_.is_null()) {
-      drop_volatiles_child(args, child_pointer, this_level, &result);
+      drop_volatiles_child(args, child_pointer, this_level, fileset, io_page, &result);
     }
   }
   if (result.dropped_all_) {
@@ -1344,6 +1592,445 @@ inline bool HashComposer::is_to_keep_volatile(uint16_t level) {
   return level + 2U > storage_.get_levels();  // TASK(Hideaki) should be a config
 }
 
+/////////////////////////////////////////////////////////////////////////////
+///
+///  Switching to a resized snapshot
+///
+/////////////////////////////////////////////////////////////////////////////
+/** Copies a page image made by create_record_in_snapshot() to a new volatile page. */
+inline ErrorStack append_volatile_data_page(
+  Engine* engine,
+  const HashDataPage* image,
+  uint16_t numa_node,
+  VolatilePagePointer* head,
+  HashDataPage** tail) {
+  ASSERT_ND(image->header().snapshot_);
+  VolatilePagePointer new_pointer;
+  Page* new_page;
+  CHECK_ERROR(engine->get_memory_manager()->grab_one_volatile_page(
+    numa_node,
+    &new_pointer,
+    &new_page));
+  std::memcpy(new_page, image, kPageSize);
+  new_page->get_header().snapshot_ = false;
+  new_page->get_header().page_id_ = new_pointer.word;
+  HashDataPage* casted = reinterpret_cast<HashDataPage*>(new_page);
+  if (*tail == nullptr) {
+    *head = new_pointer;
+  } else {
+    ASSERT_ND((*tail)->get_bin() == casted->get_bin());
+    (*tail)->next_page_address()->volatile_pointer_ = new_pointer;
+  }
+  *tail = casted;
+  return kRetOk;
+}
+
+/**
+ * Copies the key and payload of a record in a volatile page that transactions might be
+ * modifying right now. Retries until it observes the same xct_id before and after the copy.
+ * @return the xct_id of the copied image
+ */
+inline xct::XctId copy_volatile_record(
+  const HashDataPage* page,
+  DataPageSlotIndex index,
+  char* buffer,
+  uint16_t* payload_length) {
+  const HashDataPage::Slot& slot = page->get_slot(index);
+  const char* data = page->record_from_offset(slot.offset_);
+  const uint16_t aligned_key_length = slot.get_aligned_key_length();
+  while (true) {
+    const xct::XctId before = slot.tid_.xct_id_.spin_while_being_written();
+    assorted::memory_fence_acquire();
+    *payload_length = slot.payload_length_;
+    std::memcpy(buffer, data, aligned_key_length + *payload_length);
+    assorted::memory_fence_acquire();
+    if (slot.tid_.xct_id_ == before) {
+      return before;
+    }
+  }
+}
+
+struct HashComposer::ResizeContext {
+  explicit ResizeContext(Engine* engine)
+    : fileset_(engine),
+      io_page_(nullptr),
+      record_buffer_(nullptr),
+      new_root_(nullptr),
+      drop_args_(nullptr),
+      all_targets_(false),
+      moved_records_(0) {}
+
+  ErrorStack initialize() {
+    CHECK_ERROR(fileset_.initialize());
+    io_memory_.alloc(kPageSize * 2U, kPageSize, memory::AlignedMemory::kNumaAllocOnnode, 0);
+    io_page_ = reinterpret_cast<HashDataPage*>(io_memory_.get_block());
+    record_buffer_ = reinterpret_cast<char*>(io_memory_.get_block()) + kPageSize;
+    WRAP_ERROR_CODE(old_records_.create_memory(0));
+    old_records_.clean();
+    WRAP_ERROR_CODE(new_records_.create_memory(0));
+    new_records_.clean();
+    return kRetOk;
+  }
+
+  cache::SnapshotFileSet  fileset_;
+  memory::AlignedMemory   io_memory_;
+  HashDataPage*           io_page_;
+  /** A record copied from a volatile page */
+  char*                   record_buffer_;
+  /** Records moved from one bin of the old layout */
+  HashTmpBin              old_records_;
+  /** Records of one bin of the new layout */
+  HashTmpBin              new_records_;
+  /** Bins of the new layout to rebuild for the current bin of the old layout. */
+  std::vector< HashBin >  targets_;
+  /** Pairs of a bin of the new layout and a record in old_records_, sorted */
+  std::vector< std::pair<HashBin, HashTmpBin::RecordIndex> > groups_;
+  /** The volatile root page of the new layout */
+  HashIntermediatePage*   new_root_;
+  /** To drop volatile pages of the new layout we rebuild. Null before the pause. */
+  const Composer::DropVolatilesArguments* drop_args_;
+  /** Whether to volatilize all bins that receive records, even old ones. keep-all-volatile. */
+  bool                    all_targets_;
+  uint64_t                moved_records_;
+};
+
+ErrorStack HashComposer::prepare_drop_volatiles(const snapshot::Snapshot& new_snapshot) {
+  if (storage_.get_hash_metadata()->snapshot_bin_bits_ == 0) {
+    return kRetOk;  // only resizing needs preparation
+  }
+  return prepare_resized_volatiles(new_snapshot);
+}
+
+ErrorStack HashComposer::prepare_resized_volatiles(const snapshot::Snapshot& new_snapshot) {
+  HashStorageControlBlock* cb = storage_.get_control_block();
+  const HashMetadata* meta = &cb->meta_;
+  const uint8_t new_bin_bits = meta->snapshot_bin_bits_;
+  ASSERT_ND(new_bin_bits > meta->bin_bits_);
+  ASSERT_ND(cb->resized_root_.is_null());
+  LOG(INFO) << to_string() << " preparing volatile pages for " << static_cast<int>(new_bin_bits)
+    << " bin-bits...";
+  debugging::StopWatch watch;
+
+  // Transactions keep modifying the volatile pages while we read them. A record modified after
+  // we read it gets the epoch current at its commit, which is at least the current epoch minus
+  // one unless the commit takes a whole epoch (almost forever in OLTP xcts). Those records are
+  // moved again in the pause.
+  Epoch since = engine_->get_xct_manager()->get_current_global_epoch().one_less().one_less();
+  since.store_max(new_snapshot.valid_until_epoch_);
+
+  ResizeContext context(engine_);
+  CHECK_ERROR(context.initialize());
+  UninitializeGuard fileset_guard(&context.fileset_, UninitializeGuard::kWarnIfUninitializeError);
+  VolatilePagePointer new_root_pointer;
+  CHECK_ERROR(engine_->get_memory_manager()->load_one_volatile_page(
+    &context.fileset_,
+    meta->root_snapshot_page_id_,
+    &new_root_pointer,
+    reinterpret_cast<Page**>(&context.new_root_)));
+  ASSERT_ND(context.new_root_->get_level() + 1U == bins_to_level(1ULL << new_bin_bits));
+  context.all_targets_ = meta->keeps_all_volatile_pages();
+
+  // Records modified after the snapshot exist only in the volatile pages of the old layout.
+  HashIntermediatePage* old_root = resolve_intermediate(cb->root_page_pointer_.volatile_pointer_);
+  if (old_root) {
+    CHECK_ERROR(move_newer_records_recurse(&context, old_root, new_snapshot.valid_until_epoch_));
+  }
+  cb->resized_since_ = since;
+  cb->resized_root_ = new_root_pointer;
+
+  CHECK_ERROR(context.fileset_.uninitialize());
+  watch.stop();
+  LOG(INFO) << to_string() << " prepared volatile pages for " << (1ULL << new_bin_bits)
+    << " bins in " << watch.elapsed_ms() << "ms. moved_records=" << context.moved_records_;
+  return kRetOk;
+}
+
+ErrorStack HashComposer::switch_to_resized_snapshot(
+  const Composer::DropVolatilesArguments& args) {
+  HashStorageControlBlock* cb = storage_.get_control_block();
+  HashMetadata* meta = &cb->meta_;
+  const uint8_t new_bin_bits = meta->snapshot_bin_bits_;
+  ASSERT_ND(new_bin_bits > meta->bin_bits_);
+  ASSERT_ND(cb->root_page_pointer_.snapshot_pointer_ == meta->root_snapshot_page_id_);
+  if (cb->resized_root_.is_null()) {
+    LOG(WARNING) << to_string() << " was not prepared for resizing. Doing it in the pause";
+    CHECK_ERROR(prepare_resized_volatiles(args.snapshot_));
+  }
+  LOG(INFO) << to_string() << " switching from " << static_cast<int>(meta->bin_bits_) << " to "
+    << static_cast<int>(new_bin_bits) << " bin-bits...";
+  debugging::StopWatch watch;
+
+  // Only records modified since prepare_resized_volatiles() began, which are in few bins.
+  ResizeContext context(engine_);
+  CHECK_ERROR(context.initialize());
+  UninitializeGuard fileset_guard(&context.fileset_, UninitializeGuard::kWarnIfUninitializeError);
+  context.new_root_ = resolve_intermediate(cb->resized_root_);
+  context.drop_args_ = &args;
+  HashIntermediatePage* old_root = resolve_intermediate(cb->root_page_pointer_.volatile_pointer_);
+  if (old_root) {
+    CHECK_ERROR(move_newer_records_recurse(&context, old_root, cb->resized_since_));
+    drop_all_recurse(args, &cb->root_page_pointer_);
+  }
+  ASSERT_ND(cb->root_page_pointer_.volatile_pointer_.is_null());
+
+  // Now switch. No transaction is running, so just make sure the root pointer comes last.
+  meta->bin_bits_ = new_bin_bits;
+  meta->snapshot_bin_bits_ = 0;
+  if (meta->resize_bin_bits_ <= new_bin_bits) {
+    meta->resize_bin_bits_ = 0;
+  }
+  cb->bin_count_ = 1ULL << new_bin_bits;
+  cb->levels_ = bins_to_level(cb->bin_count_);
+  cb->composing_bin_bits_ = 0;
+  assorted::memory_fence_release();
+  cb->root_page_pointer_.volatile_pointer_ = cb->resized_root_;
+  cb->resized_root_.clear();
+  cb->resized_since_ = INVALID_EPOCH;
+
+  CHECK_ERROR(context.fileset_.uninitialize());
+  watch.stop();
+  LOG(INFO) << to_string() << " switched to " << cb->bin_count_ << " bins in "
+    << watch.elapsed_ms() << "ms. moved_records=" << context.moved_records_;
+  return kRetOk;
+}
+
+ErrorStack HashComposer::move_newer_records_recurse(
+  ResizeContext* context,
+  HashIntermediatePage* old_page,
+  Epoch since) {
+  const uint8_t level = old_page->get_level();
+  for (uint16_t i = 0; i < kHashIntermediatePageFanout; ++i) {
+    VolatilePagePointer pointer = old_page->get_pointer(i).volatile_pointer_;
+    if (pointer.is_null()) {
+      continue;
+    }
+    if (level > 0) {
+      CHECK_ERROR(move_newer_records_recurse(context, resolve_intermediate(pointer), since));
+    } else {
+      CHECK_ERROR(move_newer_records_bin(context, pointer, since));
+    }
+  }
+  return kRetOk;
+}
+
+ErrorStack HashComposer::move_newer_records_bin(
+  ResizeContext* context,
+  VolatilePagePointer old_head,
+  Epoch since) {
+  const uint8_t new_bin_shifts = 64U - storage_.get_hash_metadata()->snapshot_bin_bits_;
+  HashTmpBin* old_records = &context->old_records_;
+  old_records->clean_quick();
+  context->targets_.clear();
+
+  // Read the bin just once, collecting records for all bins in the new layout.
+  for (HashDataPage* page = resolve_data(old_head);
+        page;
+        page = resolve_data(page->next_page().volatile_pointer_)) {
+    // Transactions might be appending records. Slots below the count we read are complete.
+    const uint16_t record_count = page->get_record_count();
+    assorted::memory_fence_acquire();
+    for (uint16_t i = 0; i < record_count; ++i) {
+      const HashDataPage::Slot& slot = page->get_slot(i);
+      const HashBin bin = slot.hash_ >> new_bin_shifts;
+      const xct::XctId observed = slot.tid_.xct_id_.spin_while_being_written();
+      if (observed.is_moved()) {
+        continue;
+      } else if (observed.get_epoch() <= since) {
+        if (context->all_targets_) {
+          context->targets_.push_back(bin);
+        }
+        continue;
+      }
+      uint16_t payload_length;
+      const xct::XctId xct_id = copy_volatile_record(
+        page,
+        i,
+        context->record_buffer_,
+        &payload_length);
+      if (xct_id.is_moved()) {
+        continue;
+      }
+      WRAP_ERROR_CODE(old_records->replace_record(
+        xct_id,
+        context->record_buffer_,
+        slot.key_length_,
+        slot.hash_,
+        context->record_buffer_ + slot.get_aligned_key_length(),
+        payload_length));
+      context->targets_.push_back(bin);
+    }
+  }
+  if (context->targets_.empty()) {
+    return kRetOk;  // the new snapshot has everything in this bin
+  }
+
+  std::vector< HashBin >* targets = &context->targets_;
+  std::sort(targets->begin(), targets->end());
+  targets->erase(std::unique(targets->begin(), targets->end()), targets->end());
+  std::vector< std::pair<HashBin, HashTmpBin::RecordIndex> >* groups = &context->groups_;
+  groups->clear();
+  const HashTmpBin::RecordIndex records_end = old_records->get_records_consumed();
+  for (HashTmpBin::RecordIndex i = old_records->get_first_record(); i < records_end; ++i) {
+    groups->emplace_back(old_records->get_record(i)->hash_ >> new_bin_shifts, i);
+  }
+  std::sort(groups->begin(), groups->end());
+
+  const uint16_t numa_node = old_head.get_numa_node();
+  uint32_t group_begin = 0;
+  for (HashBin bin : *targets) {
+    uint32_t group_end = group_begin;
+    while (group_end < groups->size() && (*groups)[group_end].first == bin) {
+      ++group_end;
+    }
+    CHECK_ERROR(rebuild_new_bin(context, bin, numa_node, group_begin, group_end));
+    group_begin = group_end;
+  }
+  ASSERT_ND(group_begin == groups->size());
+  return kRetOk;
+}
+
+ErrorStack HashComposer::rebuild_new_bin(
+  ResizeContext* context,
+  HashBin bin,
+  uint16_t numa_node,
+  uint32_t group_begin,
+  uint32_t group_end) {
+  const uint8_t new_bin_bits = storage_.get_hash_metadata()->snapshot_bin_bits_;
+  const uint8_t new_bin_shifts = 64U - new_bin_bits;
+  HashIntermediatePage* leaf;
+  CHECK_ERROR(volatilize_path_to_bin(
+    context->new_root_,
+    bin,
+    numa_node,
+    &context->fileset_,
+    &leaf));
+  DualPagePointer* pointer = leaf->get_pointer_address(bin - leaf->get_bin_range().begin_);
+
+  // Current records of the bin, from its volatile pages if we have built them before.
+  HashTmpBin* table = &context->new_records_;
+  HashDataPage* io_page = context->io_page_;
+  table->clean_quick();
+  if (!pointer->volatile_pointer_.is_null()) {
+    ASSERT_ND(context->drop_args_);
+    for (HashDataPage* page = resolve_data(pointer->volatile_pointer_);
+          page;
+          page = resolve_data(page->next_page().volatile_pointer_)) {
+      ASSERT_ND(page->get_bin() == bin);
+      for (uint16_t i = 0; i < page->get_record_count(); ++i) {
+        const HashDataPage::Slot& slot = page->get_slot(i);
+        const char* data = page->record_from_offset(slot.offset_);
+        WRAP_ERROR_CODE(table->replace_record(
+          slot.tid_.xct_id_,
+          data,
+          slot.key_length_,
+          slot.hash_,
+          data + slot.get_aligned_key_length(),
+          slot.payload_length_));
+      }
+    }
+    drop_volatile_entire_bin(*context->drop_args_, pointer);
+  } else {
+    for (SnapshotPagePointer page_id = pointer->snapshot_pointer_; page_id != 0;) {
+      WRAP_ERROR_CODE(context->fileset_.read_page(page_id, io_page));
+      ASSERT_ND(io_page->get_bin() == bin);
+      for (uint16_t i = 0; i < io_page->get_record_count(); ++i) {
+        const HashDataPage::Slot& slot = io_page->get_slot(i);
+        const char* data = io_page->record_from_offset(slot.offset_);
+        WRAP_ERROR_CODE(table->insert_record(
+          slot.tid_.xct_id_,
+          data,
+          slot.key_length_,
+          slot.hash_,
+          data + slot.get_aligned_key_length(),
+          slot.payload_length_));
+      }
+      page_id = io_page->next_page().snapshot_pointer_;
+    }
+  }
+
+  // Then the newer records from the old layout
+  for (uint32_t i = group_begin; i < group_end; ++i) {
+    HashTmpBin::Record* record = context->old_records_.get_record(context->groups_[i].second);
+    ASSERT_ND((record->hash_ >> new_bin_shifts) == bin);
+    WRAP_ERROR_CODE(table->replace_record(
+      record->xct_id_,
+      record->get_key(),
+      record->key_length_,
+      record->hash_,
+      record->get_payload(),
+      record->payload_length_));
+    ++context->moved_records_;
+  }
+
+  // Write them out as volatile pages. We keep deleted records so that their xct_id remain.
+  VolatilePagePointer head;
+  head.clear();
+  HashDataPage* tail = nullptr;
+  io_page->initialize_snapshot_page(storage_id_, 0, bin, new_bin_bits, new_bin_shifts);
+  const HashTmpBin::RecordIndex records_end = table->get_records_consumed();
+  for (HashTmpBin::RecordIndex i = table->get_first_record(); i < records_end; ++i) {
+    HashTmpBin::Record* record = table->get_record(i);
+    if (io_page->available_space()
+      < io_page->required_space(record->key_length_, record->payload_length_)) {
+      CHECK_ERROR(append_volatile_data_page(engine_, io_page, numa_node, &head, &tail));
+      io_page->initialize_snapshot_page(storage_id_, 0, bin, new_bin_bits, new_bin_shifts);
+    }
+    io_page->create_record_in_snapshot(
+      record->xct_id_,
+      record->hash_,
+      DataPageBloomFilter::extract_fingerprint(record->hash_),
+      record->get_key(),
+      record->key_length_,
+      record->get_payload(),
+      record->payload_length_);
+  }
+  CHECK_ERROR(append_volatile_data_page(engine_, io_page, numa_node, &head, &tail));
+  pointer->volatile_pointer_ = head;
+  return kRetOk;
+}
+
+ErrorStack HashComposer::volatilize_path_to_bin(
+  HashIntermediatePage* root,
+  HashBin bin,
+  uint16_t numa_node,
+  cache::SnapshotFileSet* fileset,
+  HashIntermediatePage** out) {
+  memory::EngineMemory* memory = engine_->get_memory_manager();
+  IntermediateRoute route = IntermediateRoute::construct(bin);
+  HashIntermediatePage* page = root;
+  while (page->get_level() > 0) {
+    const uint8_t level = page->get_level();
+    const uint8_t index = route.route[level];
+    DualPagePointer* pointer = page->get_pointer_address(index);
+    if (pointer->volatile_pointer_.is_null()) {
+      VolatilePagePointer child_pointer;
+      Page* child;
+      if (pointer->snapshot_pointer_ != 0) {
+        CHECK_ERROR(memory->load_one_volatile_page(
+          fileset,
+          pointer->snapshot_pointer_,
+          &child_pointer,
+          &child));
+      } else {
+        CHECK_ERROR(memory->grab_one_volatile_page(numa_node, &child_pointer, &child));
+        HashBin begin = page->get_bin_range().begin_ + index * kHashMaxBins[level];
+        reinterpret_cast<HashIntermediatePage*>(child)->initialize_volatile_page(
+          storage_id_,
+          child_pointer,
+          page,
+          level - 1U,
+          begin);
+      }
+      pointer->volatile_pointer_ = child_pointer;
+    }
+    page = resolve_intermediate(pointer->volatile_pointer_);
+    ASSERT_ND(page->get_level() + 1U == level);
+    ASSERT_ND(page->get_bin_range().contains(bin));
+  }
+  *out = page;
+  return kRetOk;
+}
+
 }  // namespace hash
 }  // namespace storage
 }  // namespace foedus
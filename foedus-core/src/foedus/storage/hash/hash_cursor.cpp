@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include "foedus/storage/hash/hash_cursor.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+
+#include "foedus/assorted/atomic_fences.hpp"
+#include "foedus/storage/hash/hash_page_impl.hpp"
+#include "foedus/storage/hash/hash_storage_pimpl.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/xct/xct.hpp"
+
+namespace foedus {
+namespace storage {
+namespace hash {
+
+HashCursor::HashCursor(thread::Thread* context, const HashStorage& storage)
+  : context_(context),
+    xct_(&context->get_current_xct()),
+    storage_(storage),
+    snapshot_only_(xct_->get_isolation_level() == xct::kSnapshot),
+    serializable_(xct_->get_isolation_level() == xct::kSerializable) {
+  ASSERT_ND(xct_->is_active());
+  cur_bin_ = 0;
+  leaf_ = nullptr;
+  std::memset(batch_pages_, 0, sizeof(batch_pages_));
+  cur_page_ = nullptr;
+  cur_slot_ = 0;
+  cur_record_count_ = 0;
+  hash_ = 0;
+  location_.clear();
+}
+
+HashCursor::~HashCursor() {
+}
+
+HashBinRange HashCursor::get_partition_range(
+  const HashStorage& storage,
+  uint32_t partition,
+  uint32_t partitions) {
+  ASSERT_ND(partitions > 0);
+  ASSERT_ND(partition < partitions);
+  const HashBin bin_count = storage.get_bin_count();
+  const uint64_t units = assorted::int_div_ceil(bin_count, kHashIntermediatePageFanout);
+  const uint64_t begin_unit = units * partition / partitions;
+  const uint64_t end_unit = units * (partition + 1U) / partitions;
+  return HashBinRange(
+    std::min<HashBin>(bin_count, begin_unit * kHashIntermediatePageFanout),
+    std::min<HashBin>(bin_count, end_unit * kHashIntermediatePageFanout));
+}
+
+ErrorCode HashCursor::open() {
+  return open(HashBinRange(0, storage_.get_bin_count()));
+}
+
+ErrorCode HashCursor::open(const HashBinRange& range) {
+  if (range.begin_ > range.end_ || range.end_ > storage_.get_bin_count()) {
+    return kErrorCodeInvalidParameter;
+  }
+  range_ = range;
+  cur_bin_ = range.begin_;
+  leaf_ = nullptr;
+  leaf_range_ = HashBinRange();
+  batch_range_ = HashBinRange();
+  cur_page_ = nullptr;
+  location_.clear();
+  if (range_.begin_ == range_.end_) {
+    return kErrorCodeOk;
+  }
+
+  CHECK_ERROR_CODE(open_bin());
+  return proceed();
+}
+
+ErrorCode HashCursor::next() {
+  if (!is_valid_record()) {
+    return kErrorCodeOk;
+  }
+  ++cur_slot_;
+  return proceed();
+}
+
+ErrorCode HashCursor::proceed() {
+  while (true) {
+    if (cur_page_ == nullptr) {
+      // done with this bin
+      ++cur_bin_;
+      if (cur_bin_ >= range_.end_) {
+        cur_bin_ = range_.end_;
+        location_.clear();
+        return kErrorCodeOk;
+      }
+      CHECK_ERROR_CODE(open_bin());
+      continue;
+    }
+
+    const bool snapshot_page = cur_page_->header().snapshot_;
+    for (; cur_slot_ < cur_record_count_; ++cur_slot_) {
+      if (snapshot_page) {
+        location_.populate_physical(cur_page_, cur_slot_);
+      } else {
+        CHECK_ERROR_CODE(location_.populate_logical(xct_, cur_page_, cur_slot_, false));
+        if (location_.observed_.is_moved()) {
+          // The record now lives in a later slot or page of the same bin. We will see it there.
+          continue;
+        }
+      }
+      if (location_.observed_.is_deleted()) {
+        // Protected by the read set just like get_record().
+        continue;
+      }
+      hash_ = cur_page_->get_slot(cur_slot_).hash_;
+      return kErrorCodeOk;
+    }
+
+    CHECK_ERROR_CODE(next_page());
+  }
+}
+
+ErrorCode HashCursor::open_bin() {
+  ASSERT_ND(range_.contains(cur_bin_));
+  cur_page_ = nullptr;
+  cur_slot_ = 0;
+  cur_record_count_ = 0;
+  if (!leaf_range_.contains(cur_bin_)) {
+    CHECK_ERROR_CODE(locate_leaf());
+  }
+  ASSERT_ND(leaf_range_.contains(cur_bin_));
+  if (leaf_ == nullptr) {
+    return kErrorCodeOk;  // the whole sub-tree is empty. locate_leaf() took the pointer set.
+  }
+
+  const uint16_t index = cur_bin_ - leaf_range_.begin_;
+  DualPagePointer& pointer = leaf_->get_pointer(index);
+  HashDataPage* page = nullptr;
+  if (!leaf_->header().snapshot_) {
+    VolatilePagePointer volatile_pointer = pointer.volatile_pointer_;
+    if (!volatile_pointer.is_null()) {
+      page = context_->resolve_cast<HashDataPage>(volatile_pointer);
+    } else if (serializable_) {
+      // Same as follow_page_bin_head(). Someone might volatilize the bin before we commit.
+      CHECK_ERROR_CODE(xct_->add_to_pointer_set(&pointer.volatile_pointer_, volatile_pointer));
+    }
+  }
+
+  if (page == nullptr) {
+    if (!batch_range_.contains(cur_bin_)) {
+      CHECK_ERROR_CODE(read_snapshot_batch());
+    }
+    page = reinterpret_cast<HashDataPage*>(batch_pages_[cur_bin_ - batch_range_.begin_]);
+  }
+
+  cur_page_ = page;
+  if (page) {
+    ASSERT_ND(page->get_bin() == cur_bin_);
+    enter_page();
+  }
+  return kErrorCodeOk;
+}
+
+void HashCursor::enter_page() {
+  if (!cur_page_->header().snapshot_) {
+    // must be taken BEFORE reading the records. See next_page().
+    cur_page_status_ = cur_page_->header().page_version_.status_;
+    assorted::memory_fence_acquire();
+  }
+  cur_record_count_ = cur_page_->get_record_count();
+}
+
+ErrorCode HashCursor::locate_leaf() {
+  leaf_ = nullptr;
+  batch_range_ = HashBinRange();
+  HashStoragePimpl pimpl(&storage_);
+  HashIntermediatePage* page;
+  if (snapshot_only_) {
+    const DualPagePointer& root_pointer = storage_.get_control_block()->root_page_pointer_;
+    SnapshotPagePointer root_id = root_pointer.snapshot_pointer_;
+    if (root_id == 0) {
+      // no snapshot yet. nothing to read in any bin.
+      leaf_range_ = HashBinRange(0, kHashMaxBins[storage_.get_levels()]);
+      return kErrorCodeOk;
+    }
+    CHECK_ERROR_CODE(context_->find_or_read_a_snapshot_page(
+      root_id,
+      reinterpret_cast<Page**>(&page)));
+  } else {
+    CHECK_ERROR_CODE(pimpl.get_root_page(context_, false, &page));
+  }
+
+  while (page->get_level() > 0) {
+    const HashBinRange& range = page->get_bin_range();
+    const uint8_t level = page->get_level();
+    ASSERT_ND(range.contains(cur_bin_));
+    const uint16_t index = (cur_bin_ - range.begin_) / kHashMaxBins[level];
+    Page* child;
+    CHECK_ERROR_CODE(pimpl.follow_page(context_, false, page, index, &child));
+    if (child == nullptr) {
+      if (serializable_ && !page->header().snapshot_) {
+        VolatilePagePointer null_pointer;
+        null_pointer.clear();
+        CHECK_ERROR_CODE(xct_->add_to_pointer_set(
+          &page->get_pointer(index).volatile_pointer_,
+          null_pointer));
+      }
+      const HashBin begin = range.begin_ + index * kHashMaxBins[level];
+      leaf_range_ = HashBinRange(begin, begin + kHashMaxBins[level]);
+      return kErrorCodeOk;
+    }
+    page = reinterpret_cast<HashIntermediatePage*>(child);
+  }
+
+  leaf_ = page;
+  leaf_range_ = page->get_bin_range();
+  ASSERT_ND(leaf_range_.contains(cur_bin_));
+  return kErrorCodeOk;
+}
+
+ErrorCode HashCursor::read_snapshot_batch() {
+  ASSERT_ND(leaf_);
+  ASSERT_ND(leaf_range_.contains(cur_bin_));
+  const HashBin end = std::min<HashBin>(
+    std::min<HashBin>(leaf_range_.end_, range_.end_),
+    cur_bin_ + kBatchSize);
+  batch_range_ = HashBinRange(cur_bin_, end);
+
+  const bool volatile_leaf = !leaf_->header().snapshot_;
+  SnapshotPagePointer page_ids[kBatchSize];
+  uint16_t positions[kBatchSize];
+  Page* pages[kBatchSize];
+  uint16_t count = 0;
+  for (HashBin bin = batch_range_.begin_; bin < batch_range_.end_; ++bin) {
+    const uint16_t pos = bin - batch_range_.begin_;
+    batch_pages_[pos] = nullptr;
+    const DualPagePointer& pointer = leaf_->get_pointer(bin - leaf_range_.begin_);
+    // Bins with volatile pages don't need snapshot pages. Volatile bins are complete copies.
+    if (pointer.snapshot_pointer_ == 0
+      || (volatile_leaf && !pointer.volatile_pointer_.is_null())) {
+      continue;
+    }
+    page_ids[count] = pointer.snapshot_pointer_;
+    positions[count] = pos;
+    ++count;
+  }
+
+  if (count > 0) {
+    CHECK_ERROR_CODE(context_->find_or_read_snapshot_pages_batch(count, page_ids, pages));
+    for (uint16_t i = 0; i < count; ++i) {
+      batch_pages_[positions[i]] = pages[i];
+    }
+  }
+  return kErrorCodeOk;
+}
+
+ErrorCode HashCursor::next_page() {
+  ASSERT_ND(cur_page_);
+  ASSERT_ND(cur_slot_ == cur_record_count_);
+  DualPagePointer* next_page = cur_page_->next_page_address();
+  if (cur_page_->header().snapshot_) {
+    ASSERT_ND(next_page->volatile_pointer_.is_null());
+    SnapshotPagePointer page_id = next_page->snapshot_pointer_;
+    cur_page_ = nullptr;
+    if (page_id != 0) {
+      CHECK_ERROR_CODE(context_->find_or_read_a_snapshot_page(
+        page_id,
+        reinterpret_cast<Page**>(&cur_page_)));
+    }
+  } else {
+    // Same protocol as locate_record(). We never move on to the next page without
+    // confirming that no record was inserted to this page in the meantime.
+    PageVersionStatus page_status = cur_page_->header().page_version_.status_;
+    assorted::memory_fence_acquire();
+    uint16_t record_count_again = cur_page_->get_record_count();
+    if (UNLIKELY(record_count_again != cur_record_count_)) {
+      ASSERT_ND(record_count_again > cur_record_count_);
+      cur_record_count_ = record_count_again;
+      return kErrorCodeOk;  // proceed() reads the new records, then comes back here
+    }
+    if (UNLIKELY(!page_status.has_next_page() && !next_page->volatile_pointer_.is_null())) {
+      assorted::memory_fence_acquire();
+      return kErrorCodeOk;  // a new page was just installed. retry
+    }
+
+    if (next_page->volatile_pointer_.is_null()) {
+      if (serializable_) {
+        // This is the tail page. Inserts into this bin will change its version.
+        CHECK_ERROR_CODE(xct_->add_to_page_version_set(
+          &cur_page_->header().page_version_,
+          page_status));
+      }
+      cur_page_ = nullptr;
+    } else {
+      if (serializable_) {
+        // DefragBin might have copied the records of this page to a new chain after the tail,
+        // which we would read again. It changes the version of all pages in the old chain.
+        CHECK_ERROR_CODE(xct_->add_to_page_version_set(
+          &cur_page_->header().page_version_,
+          cur_page_status_));
+      }
+      cur_page_ = context_->resolve_cast<HashDataPage>(next_page->volatile_pointer_);
+    }
+  }
+
+  cur_slot_ = 0;
+  cur_record_count_ = 0;
+  if (cur_page_) {
+    ASSERT_ND(cur_page_->get_bin() == cur_bin_);
+    enter_page();
+  }
+  return kErrorCodeOk;
+}
+
+std::ostream& operator<<(std::ostream& o, const HashCursor& v) {
+  o << "<HashCursor>" << std::endl;
+  o << "  " << v.storage_ << std::endl;
+  o << "  <range>" << v.range_ << "</range>" << std::endl;
+  o << "  <snapshot_only_>" << v.snapshot_only_ << "</snapshot_only_>" << std::endl;
+  o << "  <serializable_>" << v.serializable_ << "</serializable_>" << std::endl;
+  o << "  <cur_bin_>" << v.cur_bin_ << "</cur_bin_>" << std::endl;
+  o << "  <leaf_range_>" << v.leaf_range_ << "</leaf_range_>" << std::endl;
+  o << "  <batch_range_>" << v.batch_range_ << "</batch_range_>" << std::endl;
+  o << "  <cur_page_>" << v.cur_page_ << "</cur_page_>" << std::endl;
+  o << "  <cur_slot_>" << v.cur_slot_ << "</cur_slot_>" << std::endl;
+  o << "  <cur_record_count_>" << v.cur_record_count_ << "</cur_record_count_>" << std::endl;
+  o << "</HashCursor>";
+  return o;
+}
+
+}  // namespace hash
+}  // namespace storage
+}  // namespace foedus
@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include "foedus/storage/hash/hash_defrag_impl.hpp"
+
+#include <glog/logging.h>
+
+#include <cstring>
+
+#include "foedus/assert_nd.hpp"
+#include "foedus/compiler.hpp"
+#include "foedus/assorted/atomic_fences.hpp"
+#include "foedus/memory/numa_core_memory.hpp"
+#include "foedus/storage/page.hpp"
+#include "foedus/storage/hash/hash_hashinate.hpp"
+#include "foedus/storage/hash/hash_hot_directory_impl.hpp"
+#include "foedus/storage/hash/hash_page_impl.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/xct/xct_id.hpp"
+
+namespace foedus {
+namespace storage {
+namespace hash {
+
+namespace {
+/** What the chain looks like now, and what it would look like after defragmentation */
+struct ChainPlan {
+  uint16_t  records_;
+  /** Moved records and records to drop */
+  uint16_t  dead_records_;
+  uint16_t  old_pages_;
+  uint16_t  new_pages_;
+
+  bool      is_worth() const {
+    return new_pages_ < old_pages_ || (dead_records_ > 0 && dead_records_ * 2U >= records_);
+  }
+};
+
+inline bool is_dropped(const xct::XctId& xid, Epoch drop_before) {
+  return xid.is_deleted() && xid.get_epoch() < drop_before;
+}
+
+/** @returns false if the chain is longer than DefragBin::kMaxPages */
+bool collect_chain(
+  thread::Thread* context,
+  HashDataPage* head,
+  HashDataPage** pages,
+  uint16_t* count) {
+  *count = 0;
+  for (HashDataPage* page = head; page;) {
+    if (*count >= DefragBin::kMaxPages) {
+      return false;
+    }
+    pages[*count] = page;
+    ++(*count);
+    const VolatilePagePointer next = page->next_page().volatile_pointer_;
+    page = next.is_null() ? nullptr : context->resolve_cast<HashDataPage>(next);
+  }
+  return true;
+}
+
+/**
+ * Packs the remaining records in the same way as DefragBin::build_chain().
+ * With locks, this is exact. Without locks, this is an estimate.
+ */
+ChainPlan plan_chain(uint16_t count, HashDataPage* const* pages, Epoch drop_before) {
+  ChainPlan plan;
+  plan.records_ = 0;
+  plan.dead_records_ = 0;
+  plan.old_pages_ = count;
+  plan.new_pages_ = 1;  // we keep at least one page so that the bin stays volatile
+  uint16_t space = kHashDataPageDataSize;
+  for (uint16_t p = 0; p < count; ++p) {
+    const HashDataPage* page = pages[p];
+    const uint16_t records = page->get_record_count();
+    for (DataPageSlotIndex i = 0; i < records; ++i) {
+      const HashDataPage::Slot& slot = page->get_slot(i);
+      const xct::XctId xid = slot.tid_.xct_id_;
+      ++plan.records_;
+      if (xid.is_moved() || is_dropped(xid, drop_before)) {
+        ++plan.dead_records_;
+        continue;
+      }
+      const uint16_t required = slot.physical_record_length_ + sizeof(HashDataPage::Slot);
+      if (required > space) {
+        ++plan.new_pages_;
+        space = kHashDataPageDataSize;
+      }
+      space -= required;
+    }
+  }
+  return plan;
+}
+
+}  // namespace
+
+bool DefragBin::is_worth_defrag(thread::Thread* context, HashDataPage* head, Epoch drop_before) {
+  ASSERT_ND(!head->header().snapshot_);
+  HashDataPage* pages[kMaxPages];
+  uint16_t count;
+  if (!collect_chain(context, head, pages, &count)) {
+    return false;
+  }
+  const ChainPlan plan = plan_chain(count, pages, drop_before);
+  return plan.records_ <= kMaxRecords && plan.is_worth();
+}
+
+ErrorCode DefragBin::run(xct::SysxctWorkspace* sysxct_workspace) {
+  out_defragmented_ = false;
+  out_old_pages_ = 0;
+  out_new_pages_ = 0;
+  out_dropped_records_ = 0;
+  ASSERT_ND(parent_->get_level() == 0);
+  DualPagePointer* pointer = parent_->get_pointer_address(index_in_parent_);
+  const VolatilePagePointer head_id = pointer->volatile_pointer_;
+  if (head_id.is_null()) {
+    return kErrorCodeOk;
+  }
+
+  HashDataPage* old_pages[kMaxPages];
+  uint16_t old_count;
+  HashDataPage* head = context_->resolve_cast<HashDataPage>(head_id);
+  if (!collect_chain(context_, head, old_pages, &old_count)) {
+    DVLOG(0) << "The chain is too long to defragment in one sysxct. Skipped";
+    return kErrorCodeOk;
+  }
+
+  // Lock all pages. This blocks inserts and record expansions, which lock the tail page.
+  Page* page_locks[kMaxPages];  // copied because the sysxct sorts the array
+  std::memcpy(page_locks, old_pages, sizeof(Page*) * old_count);
+  CHECK_ERROR_CODE(context_->sysxct_batch_page_locks(sysxct_workspace, old_count, page_locks));
+  // Someone might have appended a page or switched the bin before we locked them.
+  // Otherwise, the chain is now fixed because a next-page pointer never changes once set.
+  if (pointer->volatile_pointer_.word != head_id.word
+    || !old_pages[old_count - 1]->next_page().volatile_pointer_.is_null()) {
+    DVLOG(0) << "Rare. The chain has changed before locking. Retry the sysxct";
+    return kErrorCodeXctRaceAbort;
+  }
+  if (plan_chain(old_count, old_pages, drop_before_).records_ > kMaxRecords) {
+    DVLOG(0) << "The chain has too many records to defragment in one sysxct. Skipped";
+    return kErrorCodeOk;
+  }
+
+  // Then lock all records that are not moved yet. Records don't move while we have the page
+  // locks except the deleted/undeleted status, which we finalize by the record locks.
+  // Slots grow backward, so we list them from the last one to get ascending addresses.
+  for (uint16_t p = 0; p < old_count; ++p) {
+    HashDataPage* page = old_pages[p];
+    xct::RwLockableXctId* record_locks[kMaxRecords];
+    uint32_t lock_count = 0;
+    for (DataPageSlotIndex i = page->get_record_count(); i > 0;) {
+      --i;
+      xct::RwLockableXctId* tid = &page->get_slot(i).tid_;
+      if (!tid->xct_id_.is_moved()) {
+        record_locks[lock_count] = tid;
+        ++lock_count;
+      }
+    }
+    if (lock_count > 0) {
+      CHECK_ERROR_CODE(context_->sysxct_batch_record_locks(
+        sysxct_workspace,
+        page->get_volatile_page_id(),
+        lock_count,
+        record_locks));
+    }
+  }
+
+  const ChainPlan plan = plan_chain(old_count, old_pages, drop_before_);
+  if (!plan.is_worth()) {
+    return kErrorCodeOk;
+  }
+
+  // Nothing fails after we grab the pages.
+  HashDataPage* new_pages[kMaxPages];
+  memory::NumaCoreMemory* memory = context_->get_thread_memory();
+  for (uint16_t i = 0; i < plan.new_pages_; ++i) {
+    const VolatilePagePointer new_pointer = memory->grab_free_volatile_page_pointer();
+    if (UNLIKELY(new_pointer.is_null())) {
+      for (uint16_t j = 0; j < i; ++j) {
+        memory->release_free_volatile_page(new_pages[j]->get_volatile_page_id().get_offset());
+      }
+      return kErrorCodeMemoryNoFreePages;
+    }
+    new_pages[i] = context_->resolve_newpage_cast<HashDataPage>(new_pointer);
+    const Page* new_parent = (i == 0)
+      ? reinterpret_cast<const Page*>(parent_)
+      : reinterpret_cast<const Page*>(new_pages[i - 1]);
+    new_pages[i]->initialize_volatile_page(
+      head->header().storage_id_,
+      new_pointer,
+      new_parent,
+      head->get_bin(),
+      head->get_bin_shifts());
+  }
+  build_chain(old_count, old_pages, plan.new_pages_, new_pages);
+
+  // Publish the new chain after the old tail, so that those who are following the old chain
+  // see all records.
+  HashDataPage* old_tail = old_pages[old_count - 1];
+  assorted::memory_fence_release();  // so that others don't see uninitialized pages
+  old_tail->next_page().volatile_pointer_ = new_pages[0]->get_volatile_page_id();
+  assorted::memory_fence_release();  // so that others don't have "where's the next page" issue
+  old_tail->header().page_version_.set_has_next_page();
+
+  // Now the copies are reachable. Mark the originals as moved.
+  for (uint16_t p = 0; p < old_count; ++p) {
+    HashDataPage* page = old_pages[p];
+    const uint16_t records = page->get_record_count();
+    for (DataPageSlotIndex i = 0; i < records; ++i) {
+      xct::RwLockableXctId* tid = &page->get_slot(i).tid_;
+      if (!tid->xct_id_.is_moved()) {
+        ASSERT_ND(tid->is_keylocked());
+        tid->xct_id_.set_moved();
+      }
+    }
+  }
+
+  // Then switch the bin. Nobody else modifies a non-null bin pointer while we lock the head.
+  assorted::memory_fence_release();
+  pointer->volatile_pointer_ = new_pages[0]->get_volatile_page_id();
+  assorted::memory_fence_release();
+
+  // Finally, retire the old pages. They are still readable until all threads move on.
+  for (uint16_t p = 0; p < old_count; ++p) {
+    HashDataPage* page = old_pages[p];
+    invalidate_directories(page);
+    page->header().page_version_.set_moved();
+    page->header().page_version_.set_retired();
+    context_->collect_retired_volatile_page(page->get_volatile_page_id());
+  }
+
+  out_defragmented_ = true;
+  out_old_pages_ = old_count;
+  out_new_pages_ = plan.new_pages_;
+  return kErrorCodeOk;
+}
+
+void DefragBin::build_chain(
+  uint16_t old_count,
+  HashDataPage* const* old_pages,
+  uint16_t new_count,
+  HashDataPage* const* new_pages) {
+  // The new pages are still private. No fences or atomics needed until we publish them.
+  const HashDataPage* head = old_pages[0];
+  for (uint16_t i = 0; i < new_count; ++i) {
+    new_pages[i]->header().hotness_ = head->header().hotness_;
+    new_pages[i]->header().stat_last_updater_node_ = head->header().stat_last_updater_node_;
+    if (i + 1U < new_count) {
+      new_pages[i]->next_page().volatile_pointer_ = new_pages[i + 1U]->get_volatile_page_id();
+      new_pages[i]->header().page_version_.status_.set_has_next_page();
+    }
+  }
+
+  uint16_t cur = 0;
+  for (uint16_t p = 0; p < old_count; ++p) {
+    const HashDataPage* page = old_pages[p];
+    const uint16_t records = page->get_record_count();
+    for (DataPageSlotIndex i = 0; i < records; ++i) {
+      const HashDataPage::Slot& slot = page->get_slot(i);
+      const xct::XctId xid = slot.tid_.xct_id_;
+      if (xid.is_moved()) {
+        continue;
+      } else if (is_dropped(xid, drop_before_)) {
+        ++out_dropped_records_;
+        continue;
+      }
+
+      const uint16_t required = slot.physical_record_length_ + sizeof(HashDataPage::Slot);
+      if (new_pages[cur]->available_space() < required) {
+        ++cur;
+        ASSERT_ND(cur < new_count);
+      }
+      HashDataPage* new_page = new_pages[cur];
+      const DataPageSlotIndex index = new_page->get_record_count();
+      HashDataPage::Slot& new_slot = new_page->get_new_slot(index);
+      new_slot.offset_ = new_page->next_offset();
+      new_slot.physical_record_length_ = slot.physical_record_length_;
+      new_slot.key_length_ = slot.key_length_;
+      new_slot.payload_length_ = slot.payload_length_;
+      new_slot.hash_ = slot.hash_;
+      std::memcpy(
+        new_page->record_from_offset(new_slot.offset_),
+        page->record_from_offset(slot.offset_),
+        slot.physical_record_length_);
+      new_slot.tid_.reset();
+      new_slot.tid_.xct_id_ = xid;
+      new_page->bloom_filter().add(DataPageBloomFilter::extract_fingerprint(slot.hash_));
+      new_page->header().increment_key_count();
+    }
+  }
+  ASSERT_ND(cur + 1U == new_count);
+}
+
+void DefragBin::invalidate_directories(const HashDataPage* page) const {
+  if (directory_count_ == 0) {
+    return;
+  }
+  const VolatilePagePointer page_id = page->get_volatile_page_id();
+  const uint16_t records = page->get_record_count();
+  for (DataPageSlotIndex i = 0; i < records; ++i) {
+    const uint64_t location = HashHotDirectoryPage::to_location(page_id, i);
+    const HashValue hash = page->get_slot(i).hash_;
+    for (uint16_t d = 0; d < directory_count_; ++d) {
+      HashHotDirectoryPage* directory
+        = context_->resolve_cast<HashHotDirectoryPage>(directories_[d]->get_page_for(hash));
+      directory->invalidate(hash, location);
+    }
+  }
+}
+
+}  // namespace hash
+}  // namespace storage
+}  // namespace foedus
@@ -19,9 +19,11 @@
 
 #include <xxhash.h>
 
+#include <algorithm>
 #include <ostream>
 #include <string>
 
+#include "foedus/assert_nd.hpp"
 #include "foedus/assorted/assorted_func.hpp"
 
 namespace foedus {
@@ -32,6 +34,21 @@ HashValue hashinate(const void *key, uint16_t key_length) {
   return ::XXH64(key, key_length, kXxhashKeySeed);
 }
 
+HashValue hashinate_prefixed(
+  const void *key,
+  uint16_t key_length,
+  uint16_t prefix_length,
+  uint8_t prefix_bits) {
+  ASSERT_ND(prefix_bits <= kHashMaxPrefixBits);
+  const HashValue full_hash = hashinate(key, key_length);
+  if (prefix_length == 0 || prefix_bits == 0) {
+    return full_hash;
+  }
+  const HashValue prefix_hash = hashinate(key, std::min(prefix_length, key_length));
+  const HashValue prefix_mask = ~0ULL << (64U - prefix_bits);
+  return (prefix_hash & prefix_mask) | (full_hash & ~prefix_mask);
+}
+
 /**
  * @brief Calculates hash value for a primitive type.
  * @param[in] key Primitive key to hash
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include "foedus/storage/hash/hash_hot_directory_impl.hpp"
+
+#include <cstring>
+#include <ostream>
+
+#include "foedus/assorted/assorted_func.hpp"
+#include "foedus/assorted/atomic_fences.hpp"
+#include "foedus/assorted/raw_atomics.hpp"
+
+namespace foedus {
+namespace storage {
+namespace hash {
+
+void HashHotDirectoryPage::initialize_volatile_page(
+  StorageId storage_id,
+  VolatilePagePointer page_id) {
+  std::memset(this, 0, kPageSize);
+  header_.init_volatile(page_id, storage_id, kHashHotDirectoryPageType);
+}
+
+void HashHotDirectoryRootPage::initialize_volatile_page(
+  StorageId storage_id,
+  VolatilePagePointer page_id) {
+  std::memset(this, 0, kPageSize);
+  header_.init_volatile(page_id, storage_id, kHashHotDirectoryRootPageType);
+}
+
+void HashHotDirectoryPage::clear() {
+  std::memset(buckets_, 0, sizeof(buckets_));
+}
+
+void HashHotDirectoryPage::admit(HashValue hash, uint64_t location, uint32_t victim_rnd) {
+  ASSERT_ND(location != 0);
+  Bucket& bucket = buckets_[get_bucket_index(hash)];
+  Entry* target = nullptr;
+  for (uint16_t i = 0; i < kWays; ++i) {
+    if (bucket.entries_[i].location_ != 0 && bucket.entries_[i].hash_ == hash) {
+      target = bucket.entries_ + i;
+      break;
+    }
+  }
+  if (target == nullptr) {
+    for (uint16_t i = 0; i < kWays; ++i) {
+      if (bucket.entries_[i].location_ == 0) {
+        target = bucket.entries_ + i;
+        break;
+      }
+    }
+  }
+  if (target == nullptr) {
+    target = bucket.entries_ + (victim_rnd % kWays);
+  }
+  if (target->hash_ == hash && target->location_ == location) {
+    return;
+  }
+
+  // Empty the entry first so that readers less likely pair the new hash with the old location.
+  // They might still do so, which is why the caller always verifies the slot.
+  target->location_ = 0;
+  assorted::memory_fence_release();
+  target->hash_ = hash;
+  assorted::memory_fence_release();
+  target->location_ = location;
+}
+
+void HashHotDirectoryPage::invalidate(HashValue hash, uint64_t location) {
+  Bucket& bucket = buckets_[get_bucket_index(hash)];
+  for (uint16_t i = 0; i < kWays; ++i) {
+    Entry* entry = bucket.entries_ + i;
+    if (entry->location_ == location && entry->hash_ == hash) {
+      uint64_t expected = location;
+      assorted::raw_atomic_compare_exchange_strong<uint64_t>(&entry->location_, &expected, 0);
+      return;
+    }
+  }
+}
+
+uint32_t HashHotDirectoryPage::count_entries() const {
+  uint32_t count = 0;
+  for (uint16_t b = 0; b < kBuckets; ++b) {
+    for (uint16_t i = 0; i < kWays; ++i) {
+      if (buckets_[b].entries_[i].location_ != 0) {
+        ++count;
+      }
+    }
+  }
+  return count;
+}
+
+std::ostream& operator<<(std::ostream& o, const HashHotDirectoryPage& v) {
+  o << "<HashHotDirectoryPage>";
+  o << std::endl << v.header_;
+  for (uint16_t b = 0; b < HashHotDirectoryPage::kBuckets; ++b) {
+    for (uint16_t i = 0; i < HashHotDirectoryPage::kWays; ++i) {
+      const HashHotDirectoryPage::Entry& entry = v.buckets_[b].entries_[i];
+      if (entry.location_ != 0) {
+        o << std::endl << "  <Entry bucket=\"" << b << "\" hash=\""
+          << assorted::Hex(entry.hash_, 16) << "\" page=\""
+          << HashHotDirectoryPage::extract_page(entry.location_) << "\" index=\""
+          << HashHotDirectoryPage::extract_index(entry.location_) << "\" />";
+      }
+    }
+  }
+  o << "</HashHotDirectoryPage>";
+  return o;
+}
+
+std::ostream& operator<<(std::ostream& o, const HashHotDirectoryRootPage& v) {
+  o << "<HashHotDirectoryRootPage>";
+  o << std::endl << v.header_;
+  for (uint16_t i = 0; i < v.page_count_; ++i) {
+    o << std::endl << "  <Page>" << v.pages_[i] << "</Page>";
+  }
+  o << "</HashHotDirectoryRootPage>";
+  return o;
+}
+
+}  // namespace hash
+}  // namespace storage
+}  // namespace foedus
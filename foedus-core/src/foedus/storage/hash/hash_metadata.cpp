@@ -21,6 +21,7 @@
 #include <sstream>
 #include <string>
 
+#include "foedus/assert_nd.hpp"
 #include "foedus/externalize/externalizable.hpp"
 
 namespace foedus {
@@ -39,12 +40,67 @@ std::ostream& operator<<(std::ostream& o, const HashMetadata& v) {
 ErrorStack HashMetadataSerializer::load(tinyxml2::XMLElement* element) {
   CHECK_ERROR(load_base(element));
   CHECK_ERROR(get_element(element, "bin_bits_", &data_casted_->bin_bits_))
+  CHECK_ERROR(get_element<uint8_t>(
+    element,
+    "resize_bin_bits_",
+    &data_casted_->resize_bin_bits_,
+    true,
+    0))
+  CHECK_ERROR(get_element<uint8_t>(
+    element,
+    "snapshot_bin_bits_",
+    &data_casted_->snapshot_bin_bits_,
+    true,
+    0))
+  CHECK_ERROR(get_element<uint8_t>(
+    element,
+    "hot_directory_",
+    &data_casted_->hot_directory_,
+    true,
+    0))
+  CHECK_ERROR(get_element<uint16_t>(
+    element,
+    "prefix_length_",
+    &data_casted_->prefix_length_,
+    true,
+    0))
+  CHECK_ERROR(get_element<uint8_t>(
+    element,
+    "prefix_bits_",
+    &data_casted_->prefix_bits_,
+    true,
+    0))
   return kRetOk;
 }
 
 ErrorStack HashMetadataSerializer::save(tinyxml2::XMLElement* element) const {
   CHECK_ERROR(save_base(element));
   CHECK_ERROR(add_element(element, "bin_bits_", "", data_casted_->bin_bits_));
+  CHECK_ERROR(add_element(
+    element,
+    "resize_bin_bits_",
+    "Bin bits requested by request_resize(). 0 if none",
+    data_casted_->resize_bin_bits_));
+  CHECK_ERROR(add_element(
+    element,
+    "snapshot_bin_bits_",
+    "Bin bits of the root snapshot page if it differs from bin_bits_. Otherwise 0",
+    data_casted_->snapshot_bin_bits_));
+  CHECK_ERROR(add_element(
+    element,
+    "hot_directory_",
+    "Hot-key directory pages per NUMA node. 0 disables it",
+    data_casted_->hot_directory_));
+  CHECK_ERROR(add_element(
+    element,
+    "prefix_length_",
+    "Bytes of the key prefix that decides bins. 0 hashes the whole key",
+    data_casted_->prefix_length_));
+  CHECK_ERROR(add_element(
+    element,
+    "prefix_bits_",
+    "Most significant bits of hash values that come from the key prefix",
+    data_casted_->prefix_bits_));
   return kRetOk;
 }
 
@@ -68,6 +124,18 @@ void HashMetadata::set_capacity(uint64_t expected_records, double preferred_reco
   ASSERT_ND(bin_bits_ <= kHashMaxBinBits);
 }
 
+HashBinRange HashMetadata::get_prefix_bin_range(const void* prefix) const {
+  if (!is_prefix_partitioned()) {
+    return HashBinRange(0, get_bin_count());
+  }
+  ASSERT_ND(prefix_bits_ <= kHashMaxPrefixBits);
+  ASSERT_ND(prefix_bits_ < bin_bits_);
+  const HashValue prefix_hash = hashinate(prefix, prefix_length_);
+  const uint64_t prefix_value = prefix_hash >> (64U - prefix_bits_);
+  const uint8_t shifts = bin_bits_ - prefix_bits_;
+  return HashBinRange(prefix_value << shifts, (prefix_value + 1ULL) << shifts);
+}
+
 
 }  // namespace hash
 }  // namespace storage
@@ -104,9 +104,8 @@ void HashDataPage::assert_entries_impl() const {
       const HashDataPage::Slot* pre = get_slot_address(i - 1);
       ASSERT_ND(slot->offset_ == pre->offset_ + pre->physical_record_length_);
     }
-    HashValue hash = hashinate(record_from_offset(slot->offset_), slot->key_length_);
-    ASSERT_ND(slot->hash_ == hash);
-    HashBin bin = hash >> bin_shifts;
+    ASSERT_ND(is_hash_of_key(slot->hash_, record_from_offset(slot->offset_), slot->key_length_));
+    HashBin bin = slot->hash_ >> bin_shifts;
     ASSERT_ND(bin_ == bin);
 
     correct_filter.add(DataPageBloomFilter::extract_fingerprint(slot->hash_));
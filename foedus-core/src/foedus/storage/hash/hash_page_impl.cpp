@@ -26,6 +26,7 @@
 
 #include "foedus/assert_nd.hpp"
 #include "foedus/engine.hpp"
+#include "foedus/assorted/simd_search.hpp"
 #include "foedus/memory/engine_memory.hpp"
 #include "foedus/memory/numa_core_memory.hpp"
 #include "foedus/memory/numa_node_memory.hpp"
@@ -111,7 +112,7 @@ DataPageSlotIndex HashDataPage::search_key_physical(
   DataPageSlotIndex record_count,
   DataPageSlotIndex check_from) const {
   // invariant checks
-  ASSERT_ND(hash == hashinate(key, key_length));
+  ASSERT_ND(is_hash_of_key(hash, key, key_length));
   ASSERT_ND(DataPageBloomFilter::extract_fingerprint(hash) == fingerprint);
   ASSERT_ND(record_count <= get_record_count());  // it must be increasing.
 
@@ -135,10 +136,19 @@ DataPageSlotIndex HashDataPage::search_key_physical(
     return kSlotNotFound;
   }
 
-  // then most likely this page contains it. let's check one by one.
+  // then most likely this page contains it. Find slots with the same full hash in a vectorized
+  // way. Slots grow backward from the end of the page, so hash_ of i-th slot is at
+  // hashes[-i * kSlotStride].
+  const int32_t kSlotStride = sizeof(Slot) / sizeof(HashValue);
+  const HashValue* hashes = &get_slot(0).hash_;
   for (uint16_t i = check_from; i < record_count; ++i) {
+    i = assorted::simd_find_first_equal_strided(hashes, -kSlotStride, i, record_count, hash);
+    if (i == record_count) {
+      break;
+    }
     const Slot& s = get_slot(i);
-    if (LIKELY(s.hash_ != hash) || s.key_length_ != key_length) {
+    ASSERT_ND(s.hash_ == hash);
+    if (s.key_length_ != key_length) {
       continue;
     }
     // At this point, we don't take read-set (this is a physical search).
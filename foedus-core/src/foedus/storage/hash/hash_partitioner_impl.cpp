@@ -20,6 +20,7 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <cstring>
 #include <ostream>
 #include <thread>
 #include <vector>
@@ -88,6 +89,20 @@ ErrorStack HashPartitioner::design_partition(
   data_->partitionable_ = node_count > 1U;
   data_->total_bin_count_ = total_bin_count;
 
+  // Latch the resize request for this snapshot. The composer and drop_volatiles refer to this
+  // latched value rather than the metadata, which might be concurrently modified.
+  const uint8_t resize_bin_bits = control_block->meta_.resize_bin_bits_;
+  if (resize_bin_bits > storage.get_bin_bits()) {
+    LOG(INFO) << "Hash-storage-" << id_ << " will be resized to bin_bits="
+      << static_cast<int>(resize_bin_bits) << " in this snapshot";
+    control_block->composing_bin_bits_ = resize_bin_bits;
+    // A resize rewrites every bin of the previous snapshot, including those without logs.
+    // Someone must visit them all, so we let one reducer do everything in this snapshot.
+    data_->partitionable_ = false;
+  } else {
+    control_block->composing_bin_bits_ = 0;
+  }
+
   if (!data_->partitionable_) {
     // No partitioning needed. We don't even allocate memory for bin_owners_ in this case
     metadata_->valid_ = true;
@@ -239,10 +254,15 @@ void prepare_sort_entries(
   SortEntry* entries) {
   // CPU profile of partition_hash_perf: ??%.
   const Epoch base_epoch = args.base_epoch_;
+  const uint8_t bin_bits = 64U - bin_shifts;
   for (uint32_t i = 0; i < args.logs_count_; ++i) {
-    const HashCommonLogType* log_entry = reinterpret_cast<const HashCommonLogType*>(
+    HashCommonLogType* log_entry = reinterpret_cast<HashCommonLogType*>(
       args.log_buffer_.resolve(args.log_positions_[i]));
     log_entry->assert_type();
+    // Logs written before the storage switched to more bins carry the old bin_bits.
+    // The reducer sorts logs by the bin_bits in them, so we align them with this snapshot.
+    ASSERT_ND(log_entry->bin_bits_ <= bin_bits);
+    log_entry->bin_bits_ = bin_bits;
     Epoch epoch = log_entry->header_.xct_id_.get_epoch();
     ASSERT_ND(epoch.subtract(base_epoch) < (1U << 16));
     uint16_t compressed_epoch = epoch.subtract(base_epoch);
@@ -256,74 +276,113 @@ void prepare_sort_entries(
   }
 }
 
+/**
+ * How many preceding logs in the same bin compact_logs() checks for the same key.
+ * Logs of other keys in the same bin are interleaved by xct order, so checking only the
+ * immediately previous log would miss most compaction on hot keys that share a bin.
+ */
+const uint32_t kCompactLookback = 16U;
+
+/** @returns whether the two logs are on the same key */
+inline bool is_same_key(const HashCommonLogType* left, const HashCommonLogType* right) {
+  return left->hash_ == right->hash_
+    && left->key_length_ == right->key_length_
+    && std::memcmp(left->get_key(), right->get_key(), left->key_length_) == 0;
+}
+
+/**
+ * Tries to absorb prev into next, which is a later log on the same key.
+ * @returns whether prev is no longer needed
+ * @details
+ * We don't have to consider all combinations of insert/delete/overwrite.
+ * We compact only cases where the record surely exists before prev and after next:
+ * \li An update replaces the entire payload of whatever overwrite/update/increment before it.
+ * \li An overwrite supersedes an overwrite or increment whose data region it covers.
+ * \li Two increments of the same type/offset are merged into next.
+ * Insert/delete logs are never compacted because they flip the deleted flag.
+ */
+inline bool compact_log_pair(const HashCommonLogType* prev, HashCommonLogType* next) {
+  const log::LogCode prev_type = prev->header_.get_type();
+  const log::LogCode next_type = next->header_.get_type();
+  if (prev_type == log::kLogCodeHashInsert || prev_type == log::kLogCodeHashDelete) {
+    return false;
+  }
+
+  if (next_type == log::kLogCodeHashUpdate) {
+    return true;
+  } else if (next_type == log::kLogCodeHashOverwrite) {
+    uint16_t prev_begin = prev->payload_offset_;
+    uint16_t prev_end;
+    if (prev_type == log::kLogCodeHashOverwrite) {
+      prev_end = prev_begin + prev->payload_count_;
+    } else if (prev_type == log::kLogCodeHashIncrement) {
+      const HashIncrementLogType* casted = reinterpret_cast<const HashIncrementLogType*>(prev);
+      prev_end = prev_begin + HashIncrementLogType::get_value_size(casted->get_value_type());
+    } else {
+      return false;  // overwrite after update. we don't know the update's payload is covered.
+    }
+    uint16_t next_begin = next->payload_offset_;
+    uint16_t next_end = next_begin + next->payload_count_;
+    return next_begin <= prev_begin && next_end >= prev_end;
+  } else if (next_type == log::kLogCodeHashIncrement && prev_type == log::kLogCodeHashIncrement) {
+    const HashIncrementLogType* prev_casted = reinterpret_cast<const HashIncrementLogType*>(prev);
+    HashIncrementLogType* next_casted = reinterpret_cast<HashIncrementLogType*>(next);
+    if (prev_casted->get_value_type() == next_casted->get_value_type()
+      && prev->payload_offset_ == next->payload_offset_) {
+      // add up the prev's addendum to next, then delete prev.
+      next_casted->merge(*prev_casted);
+      return true;
+    }
+  }
+  return false;
+}
+
 /** subroutine of sort_batch */
 // __attribute__ ((noinline))  // was useful to forcibly show it on cpu profile. nothing more.
 uint32_t compact_logs(
   uint8_t /*bin_shifts*/,
   const Partitioner::SortBatchArguments& args,
   SortEntry* entries) {
-  // TASK(Hideaki) mapper side compaction.
-  // Unlike array, we have to consider all combinations of insert/delete/overwrite.
-  // Also needs to exactly compare keys. We probably need to store hashes in log to make it worth.
-  for (uint32_t i = 0; i < args.logs_count_; ++i) {
-    args.output_buffer_[i] = entries[i].get_position();
-  }
-  return args.logs_count_;
-/*
-  // CPU profile of partition_hash_perf: ??%.
+  // Unlike array, logs on the same key are not necessarily adjacent after sorting because we
+  // sort by bin. So, we look back a few logs in the same bin for the latest log on the same key.
+  // Logs on other keys are independent, so removing the older log from the middle is safe.
   uint32_t result_count = 1;
   args.output_buffer_[0] = entries[0].get_position();
   HashBin prev_bin = entries[0].get_bin();
+  uint32_t bin_begin = 0;  // where the current bin starts in output_buffer_
   for (uint32_t i = 1; i < args.logs_count_; ++i) {
-    // compact the logs if the same offset appears in a row, and covers the same data region.
-    // because we sorted it by offset and then ordinal, later logs can overwrite the earlier one.
     HashBin cur_bin = entries[i].get_bin();
+    snapshot::BufferPosition cur_position = entries[i].get_position();
     if (UNLIKELY(cur_bin == prev_bin)) {
-      const log::RecordLogType* prev_p = args.log_buffer_.resolve(entries[i - 1].get_position());
-      log::RecordLogType* next_p = args.log_buffer_.resolve(entries[i].get_position());
-      if (prev_p->header_.log_type_code_ != next_p->header_.log_type_code_) {
-        // increment log can be superseded by overwrite log,
-        // overwrite log can be merged with increment log.
-        // however, these usecases are probably much less frequent than the following.
-        // so, we don't compact this case so far.
-      } else if (prev_p->header_.get_type() == log::kLogCodeHashOverwrite) {
-        // two overwrite logs might be compacted
-        const HashOverwriteLogType* prev = reinterpret_cast<const HashOverwriteLogType*>(prev_p);
-        const HashOverwriteLogType* next = reinterpret_cast<const HashOverwriteLogType*>(next_p);
-        // is the data region same or superseded?
-        uint16_t prev_begin = prev->payload_offset_;
-        uint16_t prev_end = prev_begin + prev->payload_count_;
-        uint16_t next_begin = next->payload_offset_;
-        uint16_t next_end = next_begin + next->payload_count_;
-        if (next_begin <= prev_begin && next_end >= prev_end) {
-          --result_count;
+      HashCommonLogType* next = reinterpret_cast<HashCommonLogType*>(
+        args.log_buffer_.resolve(cur_position));
+      uint32_t lookback_end = bin_begin;
+      if (result_count - bin_begin > kCompactLookback) {
+        lookback_end = result_count - kCompactLookback;
+      }
+      for (uint32_t j = result_count; j > lookback_end; --j) {
+        const HashCommonLogType* prev = reinterpret_cast<const HashCommonLogType*>(
+          args.log_buffer_.resolve(args.output_buffer_[j - 1U]));
+        if (!is_same_key(prev, next)) {
+          continue;
         }
-
-        // the logic checks data range against only the previous entry.
-        // we might have a situation where 3 or more log entries have the same hash offset
-        // and the data regions are like following
-        // Log 1: [4, 8) bytes, Log 2: [8, 12) bytes, Log 3: [4, 8) bytes
-        // If we check further, Log 3 can eliminate Log 1. However, the check is expensive..
-      } else {
-        // two increment logs of same type/offset can be merged into one.
-        ASSERT_ND(prev_p->header_.get_type() == log::kLogCodeHashIncrement);
-        const HashIncrementLogType* prev = reinterpret_cast<const HashIncrementLogType*>(prev_p);
-        HashIncrementLogType* next = reinterpret_cast<HashIncrementLogType*>(next_p);
-        if (prev->value_type_ == next->value_type_
-          && prev->payload_offset_ == next->payload_offset_) {
-          // add up the prev's addendum to next, then delete prev.
-          next->merge(*prev);
+        if (compact_log_pair(prev, next)) {
+          std::memmove(
+            args.output_buffer_ + j - 1U,
+            args.output_buffer_ + j,
+            sizeof(snapshot::BufferPosition) * (result_count - j));
           --result_count;
         }
+        break;  // only the latest log on the key matters
       }
     } else {
       prev_bin = cur_bin;
+      bin_begin = result_count;
     }
-    args.output_buffer_[result_count] = entries[i].get_position();
+    args.output_buffer_[result_count] = cur_position;
     ++result_count;
   }
   return result_count;
-  */
 }
 
 void HashPartitioner::sort_batch(const Partitioner::SortBatchArguments& args) const {
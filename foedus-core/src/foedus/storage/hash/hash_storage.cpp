@@ -77,6 +77,11 @@ ErrorStack  HashStorage::drop() {
 
 const HashMetadata* HashStorage::get_hash_metadata() const  { return &control_block_->meta_; }
 
+ErrorStack HashStorage::request_resize(uint8_t new_bin_bits) {
+  HashStoragePimpl pimpl(this);
+  return pimpl.request_resize(new_bin_bits);
+}
+
 ErrorCode HashStorage::get_record(
   thread::Thread* context,
   const void* key,
@@ -96,6 +101,35 @@ ErrorCode HashStorage::get_record(
     read_only);
 }
 
+ErrorCode HashStorage::get_record_batch(
+  thread::Thread* context,
+  uint16_t batch_size,
+  const void* const* keys,
+  const uint16_t* key_lengths,
+  void* const* payloads,
+  uint16_t* payload_capacities,
+  ErrorCode* results,
+  bool read_only) {
+  HashStoragePimpl pimpl(this);
+  for (uint16_t cur = 0; cur < batch_size;) {
+    uint16_t chunk = batch_size - cur;
+    if (chunk > HashStoragePimpl::kBatchMax) {
+      chunk = HashStoragePimpl::kBatchMax;
+    }
+    CHECK_ERROR_CODE(pimpl.get_record_batch(
+      context,
+      chunk,
+      &keys[cur],
+      &key_lengths[cur],
+      &payloads[cur],
+      &payload_capacities[cur],
+      &results[cur],
+      read_only));
+    cur += chunk;
+  }
+  return kErrorCodeOk;
+}
+
 ErrorCode HashStorage::get_record_part(
   thread::Thread* context,
   const void* key,
@@ -244,6 +278,24 @@ ErrorCode HashStorage::increment_record(
     payload_offset);
 }
 
+template <typename PAYLOAD>
+ErrorCode HashStorage::increment_record_oneshot(
+  thread::Thread* context,
+  const void* key,
+  uint16_t key_length,
+  const HashCombo& combo,
+  PAYLOAD value,
+  uint16_t payload_offset) {
+  HashStoragePimpl pimpl(this);
+  return pimpl.increment_record_oneshot(
+    context,
+    key,
+    key_length,
+    combo,
+    value,
+    payload_offset);
+}
+
 std::ostream& operator<<(std::ostream& o, const HashStorage& v) {
   o << "<HashStorage>"
     << "<id>" << v.get_id() << "</id>"
@@ -270,6 +322,14 @@ ErrorStack HashStorage::verify_single_thread(thread::Thread* context) {
   return pimpl.verify_single_thread(context);
 }
 
+ErrorCode HashStorage::defrag_volatile_bins(
+  thread::Thread* context,
+  const HashBinRange& range,
+  HashDefragStatistics* stat) {
+  HashStoragePimpl pimpl(this);
+  return pimpl.defrag_volatile_bins(context, range, stat);
+}
+
 ErrorStack HashStorage::hcc_reset_all_temperature_stat() {
   HashStoragePimpl pimpl(this);
   return pimpl.hcc_reset_all_temperature_stat();
@@ -314,6 +374,15 @@ INSTANTIATE_ALL_NUMERIC_TYPES(EXPIN_3);
     x* value, \
     uint16_t payload_offset)
 INSTANTIATE_ALL_NUMERIC_TYPES(EXPIN_5);
+
+#define EXPIN_6(x) template ErrorCode HashStorage::increment_record_oneshot< x > \
+  (thread::Thread* context, \
+    const void* key, \
+    uint16_t key_length, \
+    const HashCombo& combo, \
+    x value, \
+    uint16_t payload_offset)
+INSTANTIATE_ALL_NUMERIC_TYPES(EXPIN_6);
 // @endcond
 
 
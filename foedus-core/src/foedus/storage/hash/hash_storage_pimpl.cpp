@@ -40,7 +40,9 @@
 #include "foedus/storage/storage_manager.hpp"
 #include "foedus/storage/storage_manager_pimpl.hpp"
 #include "foedus/storage/hash/hash_combo.hpp"
+#include "foedus/storage/hash/hash_defrag_impl.hpp"
 #include "foedus/storage/hash/hash_hashinate.hpp"
+#include "foedus/storage/hash/hash_hot_directory_impl.hpp"
 #include "foedus/storage/hash/hash_id.hpp"
 #include "foedus/storage/hash/hash_log_types.hpp"
 #include "foedus/storage/hash/hash_metadata.hpp"
@@ -58,6 +60,7 @@ namespace hash {
 
 ErrorStack HashStoragePimpl::drop() {
   LOG(INFO) << "Uninitializing an hash-storage " << get_name();
+  release_hot_directories();
 
   if (!control_block_->root_page_pointer_.volatile_pointer_.is_null()) {
     // release volatile pages
@@ -79,23 +82,15 @@ ErrorStack HashStoragePimpl::create(const HashMetadata& metadata) {
     return ERROR_STACK(kErrorCodeStrAlreadyExists);
   }
 
-  // hash-specific check.
-  // Due to the current design of hash_partitioner, we spend hashbins bytes
-  // out of the partitioner memory.
-  uint64_t required_partitioner_bytes = metadata.get_bin_count() + 4096ULL;
-  uint64_t partitioner_bytes
-    = engine_->get_options().storage_.partitioner_data_memory_mb_ * (1ULL << 20);
-  // we don't bother checking other storages' consumption. the config might later change anyways.
-  // Instead, leave a bit of margin (25%) for others.
-  if (partitioner_bytes < required_partitioner_bytes * 1.25) {
-    std::stringstream str;
-    str << metadata << ".\n"
-      << "To accomodate this number of hash bins, partitioner_data_memory_mb_ must be"
-      << " at least " << (required_partitioner_bytes * 1.25 / (1ULL << 20));
-    return ERROR_STACK_MSG(kErrorCodeStrHashBinsTooMany, str.str().c_str());
-  }
+  CHECK_ERROR(check_prefix_options(metadata));
+  CHECK_ERROR(check_partitioner_memory(metadata));
 
   control_block_->meta_ = metadata;
+  control_block_->meta_.resize_bin_bits_ = 0;
+  control_block_->meta_.snapshot_bin_bits_ = 0;
+  control_block_->composing_bin_bits_ = 0;
+  control_block_->resized_since_ = INVALID_EPOCH;
+  control_block_->resized_root_.clear();
   LOG(INFO) << "Newly creating an hash-storage " << get_name();
   control_block_->bin_count_ = 1ULL << get_bin_bits();
   control_block_->levels_ = bins_to_level(control_block_->bin_count_);
@@ -126,15 +121,90 @@ ErrorStack HashStoragePimpl::create(const HashMetadata& metadata) {
     control_block_->levels_ - 1U,
     0);
   root_page->assert_range();
+  WRAP_ERROR_CODE(create_hot_directories());
 
   LOG(INFO) << "Newly created an hash-storage " << get_name();
   control_block_->status_ = kExists;
   return kRetOk;
 }
 
+ErrorStack HashStoragePimpl::check_partitioner_memory(const HashMetadata& metadata) const {
+  // hash-specific check.
+  // Due to the current design of hash_partitioner, we spend hashbins bytes
+  // out of the partitioner memory.
+  uint64_t required_partitioner_bytes = metadata.get_bin_count() + 4096ULL;
+  uint64_t partitioner_bytes
+    = engine_->get_options().storage_.partitioner_data_memory_mb_ * (1ULL << 20);
+  // we don't bother checking other storages' consumption. the config might later change anyways.
+  // Instead, leave a bit of margin (25%) for others.
+  if (partitioner_bytes < required_partitioner_bytes * 1.25) {
+    std::stringstream str;
+    str << metadata << ".\n"
+      << "To accomodate this number of hash bins, partitioner_data_memory_mb_ must be"
+      << " at least " << (required_partitioner_bytes * 1.25 / (1ULL << 20));
+    return ERROR_STACK_MSG(kErrorCodeStrHashBinsTooMany, str.str().c_str());
+  }
+  return kRetOk;
+}
+
+ErrorStack HashStoragePimpl::check_prefix_options(const HashMetadata& metadata) const {
+  if (!metadata.is_prefix_partitioned()) {
+    return kRetOk;
+  }
+  // If the prefix took all bits of the bins, each prefix would get just one bin, possibly
+  // shared with other prefixes, and its keys would pile up in that bin with nothing left to
+  // spread them. We thus require at least one bin bit that comes from the full key.
+  if (metadata.prefix_bits_ > kHashMaxPrefixBits || metadata.prefix_bits_ >= metadata.bin_bits_) {
+    LOG(ERROR) << "prefix_bits_ must be " << static_cast<int>(kHashMaxPrefixBits) << " or less"
+      << " and less than bin_bits_: " << metadata;
+    return ERROR_STACK(kErrorCodeStrHashInvalidOption);
+  }
+  return kRetOk;
+}
+
+ErrorStack HashStoragePimpl::request_resize(uint8_t new_bin_bits) {
+  if (!exists()) {
+    return ERROR_STACK_MSG(kErrorCodeInvalidParameter, "The hash-storage doesn't exist");
+  }
+  if (new_bin_bits <= get_bin_bits() || new_bin_bits > kHashMaxBinBits) {
+    LOG(ERROR) << "Hash-storage " << get_name() << " can only grow its bin_bits from "
+      << static_cast<int>(get_bin_bits()) << " up to " << static_cast<int>(kHashMaxBinBits)
+      << ". requested=" << static_cast<int>(new_bin_bits);
+    return ERROR_STACK(kErrorCodeInvalidParameter);
+  }
+
+  HashMetadata resized = get_meta();
+  resized.bin_bits_ = new_bin_bits;
+  CHECK_ERROR(check_partitioner_memory(resized));
+  CHECK_ERROR(check_prefix_options(resized));
+
+  // The snapshot thread latches this value when it designs partitions. Until then, we can
+  // freely overwrite it. A request that arrives after the latch waits for the next snapshot.
+  control_block_->meta_.resize_bin_bits_ = new_bin_bits;
+  assorted::memory_fence_release();
+  LOG(INFO) << "Hash-storage " << get_name() << " will grow its bin_bits from "
+    << static_cast<int>(get_bin_bits()) << " to " << static_cast<int>(new_bin_bits)
+    << " at the next snapshot";
+  return kRetOk;
+}
+
 ErrorStack HashStoragePimpl::load(const StorageControlBlock& snapshot_block) {
   control_block_->meta_ = static_cast<const HashMetadata&>(snapshot_block.meta_);
-  const HashMetadata& meta = control_block_->meta_;
+  HashMetadata& meta = control_block_->meta_;
+  if (meta.snapshot_bin_bits_ != 0) {
+    // The previous run took a resizing snapshot but didn't switch over its volatile pages.
+    // The snapshot is complete by itself, so we just adopt its layout.
+    LOG(INFO) << "Hash-storage " << meta.name_ << " adopts the resized bin_bits "
+      << static_cast<int>(meta.snapshot_bin_bits_) << " of the root snapshot page";
+    meta.bin_bits_ = meta.snapshot_bin_bits_;
+    meta.snapshot_bin_bits_ = 0;
+  }
+  if (meta.resize_bin_bits_ <= meta.bin_bits_) {
+    meta.resize_bin_bits_ = 0;
+  }
+  control_block_->composing_bin_bits_ = 0;
+  control_block_->resized_since_ = INVALID_EPOCH;
+  control_block_->resized_root_.clear();
   control_block_->bin_count_ = 1ULL << get_bin_bits();
   control_block_->levels_ = bins_to_level(control_block_->bin_count_);
   control_block_->root_page_pointer_.snapshot_pointer_ = meta.root_snapshot_page_id_;
@@ -155,6 +225,7 @@ ErrorStack HashStoragePimpl::load(const StorageControlBlock& snapshot_block) {
     &volatile_pointer,
     reinterpret_cast<Page**>(&volatile_root)));
   control_block_->root_page_pointer_.volatile_pointer_ = volatile_pointer;
+  WRAP_ERROR_CODE(create_hot_directories());
 
   CHECK_ERROR(fileset.uninitialize());
 
@@ -163,6 +234,127 @@ ErrorStack HashStoragePimpl::load(const StorageControlBlock& snapshot_block) {
   return kRetOk;
 }
 
+ErrorCode HashStoragePimpl::create_hot_directories() {
+  std::memset(control_block_->hot_directories_, 0, sizeof(control_block_->hot_directories_));
+  const uint16_t page_count = get_meta().hot_directory_;
+  if (page_count == 0) {
+    return kErrorCodeOk;
+  }
+
+  // pages for each node, so that lookups never go to a remote node.
+  const uint16_t nodes = engine_->get_options().thread_.group_count_;
+  for (uint16_t node = 0; node < nodes; ++node) {
+    memory::PagePool* pool
+      = engine_->get_memory_manager()->get_node_memory(node)->get_volatile_pool();
+    const memory::LocalPageResolver& resolver = pool->get_resolver();
+    memory::PagePoolOffset root_offset;
+    ErrorCode code = pool->grab_one(&root_offset);
+    if (code != kErrorCodeOk) {
+      release_hot_directories();
+      return code;
+    }
+    VolatilePagePointer root_pointer = combine_volatile_page_pointer(node, root_offset);
+    HashHotDirectoryRootPage* root = reinterpret_cast<HashHotDirectoryRootPage*>(
+      resolver.resolve_offset_newpage(root_offset));
+    root->initialize_volatile_page(get_id(), root_pointer);
+    control_block_->hot_directories_[node] = root_pointer;
+
+    // the root page knows the pages grabbed so far, so release_hot_directories() can clean up.
+    for (uint16_t i = 0; i < page_count; ++i) {
+      memory::PagePoolOffset offset;
+      code = pool->grab_one(&offset);
+      if (code != kErrorCodeOk) {
+        release_hot_directories();
+        return code;
+      }
+      VolatilePagePointer pointer = combine_volatile_page_pointer(node, offset);
+      HashHotDirectoryPage* page = reinterpret_cast<HashHotDirectoryPage*>(
+        resolver.resolve_offset_newpage(offset));
+      page->initialize_volatile_page(get_id(), pointer);
+      root->append_page(pointer);
+    }
+  }
+  LOG(INFO) << "Created hot-key directories of hash-storage " << get_name() << " in "
+    << nodes << " nodes, " << page_count << " pages each";
+  return kErrorCodeOk;
+}
+
+void HashStoragePimpl::release_hot_directories() {
+  const uint16_t nodes = engine_->get_options().thread_.group_count_;
+  for (uint16_t node = 0; node < nodes; ++node) {
+    VolatilePagePointer root_pointer = control_block_->hot_directories_[node];
+    if (!root_pointer.is_null()) {
+      ASSERT_ND(root_pointer.get_numa_node() == node);
+      memory::PagePool* pool
+        = engine_->get_memory_manager()->get_node_memory(node)->get_volatile_pool();
+      const HashHotDirectoryRootPage* root = reinterpret_cast<const HashHotDirectoryRootPage*>(
+        pool->get_resolver().resolve_offset(root_pointer.get_offset()));
+      ASSERT_ND(root->header().get_page_type() == kHashHotDirectoryRootPageType);
+      for (uint16_t i = 0; i < root->get_page_count(); ++i) {
+        ASSERT_ND(root->get_page(i).get_numa_node() == node);
+        pool->release_one(root->get_page(i).get_offset());
+      }
+      pool->release_one(root_pointer.get_offset());
+    }
+  }
+  std::memset(control_block_->hot_directories_, 0, sizeof(control_block_->hot_directories_));
+}
+
+void HashStoragePimpl::clear_hot_directories() {
+  const memory::GlobalVolatilePageResolver& resolver
+    = engine_->get_memory_manager()->get_global_volatile_page_resolver();
+  const uint16_t nodes = engine_->get_options().thread_.group_count_;
+  for (uint16_t node = 0; node < nodes; ++node) {
+    VolatilePagePointer root_pointer = control_block_->hot_directories_[node];
+    if (!root_pointer.is_null()) {
+      const HashHotDirectoryRootPage* root
+        = reinterpret_cast<const HashHotDirectoryRootPage*>(resolver.resolve_offset(root_pointer));
+      for (uint16_t i = 0; i < root->get_page_count(); ++i) {
+        HashHotDirectoryPage* page
+          = reinterpret_cast<HashHotDirectoryPage*>(resolver.resolve_offset(root->get_page(i)));
+        ASSERT_ND(page->header().get_page_type() == kHashHotDirectoryPageType);
+        page->clear();
+      }
+    }
+  }
+}
+
+HashHotDirectoryPage* HashStoragePimpl::get_hot_directory(
+  thread::Thread* context,
+  HashValue hash) const {
+  VolatilePagePointer root_pointer = control_block_->hot_directories_[context->get_numa_node()];
+  if (root_pointer.is_null()) {
+    return nullptr;
+  }
+  // Both pages are in this node
+  const HashHotDirectoryRootPage* root
+    = context->resolve_cast<HashHotDirectoryRootPage>(root_pointer.get_offset());
+  return context->resolve_cast<HashHotDirectoryPage>(root->get_page_for(hash).get_offset());
+}
+
+/**
+ * The last step of get_record() and get_record_batch() after they locate the record.
+ * Here, we do NOT have to do another optimistic-read protocol because we already took
+ * the owner_id into read-set. If this read is corrupted, we will be aware of it at commit time.
+ */
+inline ErrorCode copy_record_payload(
+  const RecordLocation& location,
+  void* payload,
+  uint16_t* payload_capacity) {
+  uint16_t payload_length = location.cur_payload_length_;
+  if (payload_length > *payload_capacity) {
+    // buffer too small
+    DVLOG(0) << "buffer too small??" << payload_length << ":" << *payload_capacity;
+    *payload_capacity = payload_length;
+    return kErrorCodeStrTooSmallPayloadBuffer;
+  }
+
+  *payload_capacity = payload_length;
+  uint16_t key_offset = location.get_aligned_key_length();
+  std::memcpy(payload, location.record_ + key_offset, payload_length);
+  return kErrorCodeOk;
+}
+
 ErrorCode HashStoragePimpl::get_record(
   thread::Thread* context,
   const void* key,
@@ -171,39 +363,67 @@ ErrorCode HashStoragePimpl::get_record(
   void* payload,
   uint16_t* payload_capacity,
   bool read_only) {
-  HashDataPage* bin_head;
-  CHECK_ERROR_CODE(locate_bin(context, !read_only, combo, &bin_head));
-  if (!bin_head) {
-    return kErrorCodeStrKeyNotFound;  // protected by pointer set, so we are done
-  }
   RecordLocation location;
-  CHECK_ERROR_CODE(locate_record_logical(
+  CHECK_ERROR_CODE(locate_existing_record(
     context,
     !read_only,
     false,
-    0,
     key,
     key_length,
     combo,
-    bin_head,
     &location));
   if (!location.is_found()) {
-    return kErrorCodeStrKeyNotFound;  // protected by page version set, so we are done
+    // protected by pointer set (no bin) or page version set, so we are done
+    return kErrorCodeStrKeyNotFound;
+  } else if (location.observed_.is_deleted()) {
+    return kErrorCodeStrKeyNotFound;  // protected by the read set
   }
 
-  // here, we do NOT have to do another optimistic-read protocol because we already took
-  // the owner_id into read-set. If this read is corrupted, we will be aware of it at commit time.
-  uint16_t payload_length = location.cur_payload_length_;
-  if (payload_length > *payload_capacity) {
-    // buffer too small
-    DVLOG(0) << "buffer too small??" << payload_length << ":" << *payload_capacity;
-    *payload_capacity = payload_length;
-    return kErrorCodeStrTooSmallPayloadBuffer;
+  return copy_record_payload(location, payload, payload_capacity);
+}
+
+ErrorCode HashStoragePimpl::get_record_batch(
+  thread::Thread* context,
+  uint16_t batch_size,
+  const void* const* keys,
+  const uint16_t* key_lengths,
+  void* const* payloads,
+  uint16_t* payload_capacities,
+  ErrorCode* results,
+  bool read_only) {
+  ASSERT_ND(batch_size <= kBatchMax);
+  // Hash everything first. This needs only the keys, so it doesn't wait for any cache miss.
+  HashCombo combos[kBatchMax];
+  for (uint16_t i = 0; i < batch_size; ++i) {
+    combos[i] = HashCombo(keys[i], key_lengths[i], get_meta());
   }
 
-  *payload_capacity = payload_length;
-  uint16_t key_offset = location.get_aligned_key_length();
-  std::memcpy(payload, location.record_ + key_offset, payload_length);
+  HashDataPage* bin_heads[kBatchMax];
+  CHECK_ERROR_CODE(locate_bin_batch(context, !read_only, batch_size, combos, bin_heads));
+
+  // The data pages of all keys are being prefetched. Resolve them one by one.
+  for (uint16_t i = 0; i < batch_size; ++i) {
+    if (!bin_heads[i]) {
+      results[i] = kErrorCodeStrKeyNotFound;  // protected by pointer set
+      continue;
+    }
+    RecordLocation location;
+    CHECK_ERROR_CODE(locate_record_logical(
+      context,
+      !read_only,
+      false,
+      0,
+      keys[i],
+      key_lengths[i],
+      combos[i],
+      bin_heads[i],
+      &location));
+    if (!location.is_found() || location.observed_.is_deleted()) {
+      results[i] = kErrorCodeStrKeyNotFound;  // protected by page version set or read set
+    } else {
+      results[i] = copy_record_payload(location, payloads[i], &payload_capacities[i]);
+    }
+  }
   return kErrorCodeOk;
 }
 
@@ -216,24 +436,20 @@ ErrorCode HashStoragePimpl::get_record_part(
   uint16_t payload_offset,
   uint16_t payload_count,
   bool read_only) {
-  HashDataPage* bin_head;
-  CHECK_ERROR_CODE(locate_bin(context, !read_only, combo, &bin_head));
-  if (!bin_head) {
-    return kErrorCodeStrKeyNotFound;  // protected by pointer set, so we are done
-  }
   RecordLocation location;
-  CHECK_ERROR_CODE(locate_record_logical(
+  CHECK_ERROR_CODE(locate_existing_record(
     context,
     !read_only,
     false,
-    0,
     key,
     key_length,
     combo,
-    bin_head,
     &location));
   if (!location.is_found()) {
-    return kErrorCodeStrKeyNotFound;  // protected by page version set, so we are done
+    // protected by pointer set (no bin) or page version set, so we are done
+    return kErrorCodeStrKeyNotFound;
+  } else if (location.observed_.is_deleted()) {
+    return kErrorCodeStrKeyNotFound;  // protected by the read set
   }
 
   uint16_t payload_length = location.cur_payload_length_;
@@ -358,19 +574,14 @@ ErrorCode HashStoragePimpl::delete_record(
   const void* key,
   uint16_t key_length,
   const HashCombo& combo) {
-  HashDataPage* bin_head;
-  CHECK_ERROR_CODE(locate_bin(context, true, combo, &bin_head));
-  ASSERT_ND(bin_head);
   RecordLocation location;
-  CHECK_ERROR_CODE(locate_record_logical(
+  CHECK_ERROR_CODE(locate_existing_record(
     context,
     true,
     false,
-    0,
     key,
     key_length,
     combo,
-    bin_head,
     &location));
 
   if (!location.is_found()) {
@@ -507,19 +718,14 @@ ErrorCode HashStoragePimpl::overwrite_record(
   const void* payload,
   uint16_t payload_offset,
   uint16_t payload_count) {
-  HashDataPage* bin_head;
-  CHECK_ERROR_CODE(locate_bin(context, true, combo, &bin_head));
-  ASSERT_ND(bin_head);
   RecordLocation location;
-  CHECK_ERROR_CODE(locate_record_logical(
+  CHECK_ERROR_CODE(locate_existing_record(
     context,
     true,
     false,
-    0,
     key,
     key_length,
     combo,
-    bin_head,
     &location));
 
   if (!location.is_found()) {
@@ -558,19 +764,14 @@ ErrorCode HashStoragePimpl::increment_record(
   const HashCombo& combo,
   PAYLOAD* value,
   uint16_t payload_offset) {
-  HashDataPage* bin_head;
-  CHECK_ERROR_CODE(locate_bin(context, true, combo, &bin_head));
-  ASSERT_ND(bin_head);
   RecordLocation location;
-  CHECK_ERROR_CODE(locate_record_logical(
+  CHECK_ERROR_CODE(locate_existing_record(
     context,
     true,
     false,
-    0,
     key,
     key_length,
     combo,
-    bin_head,
     &location));
 
   if (!location.is_found()) {
@@ -604,6 +805,67 @@ ErrorCode HashStoragePimpl::increment_record(
   return register_record_write_log(context, location, log_entry);
 }
 
+template <typename PAYLOAD>
+ErrorCode HashStoragePimpl::increment_record_oneshot(
+  thread::Thread* context,
+  const void* key,
+  uint16_t key_length,
+  const HashCombo& combo,
+  PAYLOAD value,
+  uint16_t payload_offset) {
+  // Unlike increment_record(), we don't read the current value. Neither do we take a read-set
+  // to protect the existence of the record, otherwise concurrent increments on a hot key abort
+  // each other. Pre-commit checks the existence and payload length under the record lock.
+  // See HashIncrementLogType::is_applicable(). The log is applied as an addition at commit
+  // time, and merged with other increments in the log gleaner.
+  RecordLocation location;
+  CHECK_ERROR_CODE(locate_existing_record(
+    context,
+    true,
+    true,
+    key,
+    key_length,
+    combo,
+    &location));
+
+  if (UNLIKELY(!location.is_found()
+    || location.observed_.is_deleted()
+    || location.cur_payload_length_ < payload_offset + sizeof(PAYLOAD))) {
+    // We are returning an error, which must be protected. Redo it as a logical search.
+    CHECK_ERROR_CODE(locate_existing_record(
+      context,
+      true,
+      false,
+      key,
+      key_length,
+      combo,
+      &location));
+    if (!location.is_found()) {
+      return kErrorCodeStrKeyNotFound;  // protected by page version set, so we are done
+    } else if (location.observed_.is_deleted()) {
+      return kErrorCodeStrKeyNotFound;  // protected by the read set
+    } else if (location.cur_payload_length_ < payload_offset + sizeof(PAYLOAD)) {
+      LOG(WARNING) << "short record " << combo;  // probably this is a rare error. so warn.
+      return kErrorCodeStrTooShortPayload;  // protected by the read set
+    }
+    // Someone has just revived the record. We have a read-set on it now, which is fine.
+  }
+
+  uint16_t log_length = HashIncrementLogType::calculate_log_length(key_length);
+  HashIncrementLogType* log_entry = reinterpret_cast<HashIncrementLogType*>(
+    context->get_thread_log_buffer().reserve_new_log(log_length));
+  log_entry->populate<PAYLOAD>(
+    get_id(),
+    key,
+    key_length,
+    get_bin_bits(),
+    combo.hash_,
+    value,
+    payload_offset);
+
+  return register_record_write_log(context, location, log_entry);
+}
+
 ErrorCode HashStoragePimpl::get_root_page(
   thread::Thread* context,
   bool for_write,
@@ -886,6 +1148,186 @@ ErrorCode HashStoragePimpl::locate_bin(
   return kErrorCodeOk;
 }
 
+ErrorCode HashStoragePimpl::locate_bin_batch(
+  thread::Thread* context,
+  bool for_write,
+  uint16_t batch_size,
+  const HashCombo* combos,
+  HashDataPage** bin_heads) {
+  ASSERT_ND(batch_size <= kBatchMax);
+  HashIntermediatePage* root;
+  CHECK_ERROR_CODE(get_root_page(context, for_write, &root));
+  ASSERT_ND(root);
+  xct::Xct& current_xct = context->get_current_xct();
+  const uint8_t root_level = root->get_level();
+
+  // parents[i] is the page we follow next for i-th key, or nullptr if we are done with it.
+  HashIntermediatePage* parents[kBatchMax];
+  for (uint16_t i = 0; i < batch_size; ++i) {
+    parents[i] = root;
+    bin_heads[i] = nullptr;
+    assorted::prefetch_cacheline(&root->get_pointer(combos[i].route_.route[root_level]));
+  }
+
+  // One level for all keys at a time. By the time we come back to a key, its page has arrived.
+  for (int16_t level = root_level; level >= 0; --level) {
+    for (uint16_t i = 0; i < batch_size; ++i) {
+      HashIntermediatePage* parent = parents[i];
+      if (!parent) {
+        continue;
+      }
+      ASSERT_ND(parent->get_level() == level);
+      uint16_t index = combos[i].route_.route[level];
+      Page* next;
+      CHECK_ERROR_CODE(follow_page(context, for_write, parent, index, &next));
+      if (!next) {
+        // Same as locate_bin()
+        ASSERT_ND(!for_write);
+        if (!parent->header().snapshot_
+          && current_xct.get_isolation_level() == xct::kSerializable) {
+          VolatilePagePointer volatile_null;
+          volatile_null.clear();
+          CHECK_ERROR_CODE(
+            current_xct.add_to_pointer_set(
+              &parent->get_pointer(index).volatile_pointer_,
+              volatile_null));
+        }
+        parents[i] = nullptr;
+      } else if (level == 0) {
+        HashDataPage* bin_head = reinterpret_cast<HashDataPage*>(next);
+        ASSERT_ND(bin_head->get_bin() == combos[i].bin_);
+        bin_heads[i] = bin_head;
+        parents[i] = nullptr;
+        // header and bloom filter, then the first slots at the end of the page
+        assorted::prefetch_cachelines(bin_head, 2);
+        assorted::prefetch_cacheline(bin_head->get_slot_address(0));
+      } else {
+        HashIntermediatePage* child = reinterpret_cast<HashIntermediatePage*>(next);
+        parents[i] = child;
+        assorted::prefetch_cacheline(&child->get_pointer(combos[i].route_.route[level - 1]));
+      }
+    }
+  }
+
+  return kErrorCodeOk;
+}
+
+ErrorCode HashStoragePimpl::locate_existing_record(
+  thread::Thread* context,
+  bool for_write,
+  bool physical_only,
+  const void* key,
+  uint16_t key_length,
+  const HashCombo& combo,
+  RecordLocation* result) {
+  HashHotDirectoryPage* directory = nullptr;
+  if (UNLIKELY(get_meta().hot_directory_)
+    && context->get_current_xct().get_isolation_level() != xct::kSnapshot) {
+    directory = get_hot_directory(context, combo.hash_);
+    if (directory) {
+      bool hit;
+      CHECK_ERROR_CODE(locate_record_in_hot_directory(
+        context,
+        for_write,
+        physical_only,
+        directory,
+        key,
+        key_length,
+        combo,
+        result,
+        &hit));
+      if (hit) {
+        return kErrorCodeOk;
+      }
+    }
+  }
+
+  HashDataPage* bin_head;
+  CHECK_ERROR_CODE(locate_bin(context, for_write, combo, &bin_head));
+  if (!bin_head) {
+    ASSERT_ND(!for_write);
+    result->clear();  // protected by pointer set
+    return kErrorCodeOk;
+  }
+  CHECK_ERROR_CODE(locate_record(
+    context,
+    for_write,
+    physical_only,
+    false,
+    0,
+    key,
+    key_length,
+    combo,
+    bin_head,
+    result));
+
+  if (directory
+    && result->is_found()
+    && !result->page_->header().snapshot_
+    && context->is_hot_page(reinterpret_cast<Page*>(result->page_))) {
+    VolatilePagePointer page_id = construct_volatile_page_pointer(result->page_->header().page_id_);
+    directory->admit(
+      combo.hash_,
+      HashHotDirectoryPage::to_location(page_id, result->index_),
+      context->get_lock_rnd().next_uint32());
+  }
+  return kErrorCodeOk;
+}
+
+ErrorCode HashStoragePimpl::locate_record_in_hot_directory(
+  thread::Thread* context,
+  bool for_write,
+  bool physical_only,
+  HashHotDirectoryPage* directory,
+  const void* key,
+  uint16_t key_length,
+  const HashCombo& combo,
+  RecordLocation* result,
+  bool* hit) {
+  *hit = false;
+  const uint64_t location = directory->lookup(combo.hash_);
+  if (location == 0) {
+    return kErrorCodeOk;
+  }
+
+  // The entry is just a hint. Check everything about the slot.
+  // The page might have been retired by DefragBin and even reused for something else,
+  // see HashHotDirectoryPage. It is still a page in the volatile pool, so we can read it.
+  HashDataPage* page
+    = context->resolve_cast<HashDataPage>(HashHotDirectoryPage::extract_page(location));
+  const DataPageSlotIndex index = HashHotDirectoryPage::extract_index(location);
+  ASSERT_ND(!page->header().snapshot_);
+  if (page->header().get_page_type() != kHashDataPageType
+    || page->header().page_version_.is_moved()) {
+    directory->invalidate(combo.hash_, location);
+    return kErrorCodeOk;
+  }
+  if (page->header().storage_id_ != get_id()
+    || page->get_bin() != combo.bin_
+    || index >= page->get_record_count()
+    || !page->compare_slot_key(index, combo.hash_, key, key_length)) {
+    return kErrorCodeOk;
+  }
+
+  if (physical_only) {
+    result->populate_physical(page, index);
+  } else {
+    CHECK_ERROR_CODE(result->populate_logical(
+      &context->get_current_xct(),
+      page,
+      index,
+      for_write));
+  }
+  if (UNLIKELY(result->observed_.is_moved())) {
+    // the record is now in a later page of the bin. the usual path will find it.
+    directory->invalidate(combo.hash_, location);
+    result->clear();
+    return kErrorCodeOk;
+  }
+  *hit = true;
+  return kErrorCodeOk;
+}
+
 ErrorCode HashStoragePimpl::locate_record_in_snapshot(
   thread::Thread* context,
   const void* key,
@@ -1096,6 +1538,111 @@ ErrorCode HashStoragePimpl::locate_record_reserve_physical(
   return kErrorCodeOk;
 }
 
+ErrorCode HashStoragePimpl::defrag_volatile_bins(
+  thread::Thread* context,
+  const HashBinRange& range,
+  HashDefragStatistics* stat) {
+  ASSERT_ND(!context->is_running_xct());
+  ASSERT_ND(range.end_ <= get_bin_count());
+  *stat = HashDefragStatistics();
+  const VolatilePagePointer root_id = control_block_->root_page_pointer_.volatile_pointer_;
+  if (root_id.is_null() || range.length() == 0) {
+    return kErrorCodeOk;
+  }
+
+  const memory::GlobalVolatilePageResolver& resolver
+    = engine_->get_memory_manager()->get_global_volatile_page_resolver();
+  HashHotDirectoryRootPage* directories[soc::kMaxSocs];
+  uint16_t directory_count = 0;
+  const uint16_t nodes = engine_->get_options().thread_.group_count_;
+  for (uint16_t node = 0; node < nodes; ++node) {
+    VolatilePagePointer pointer = control_block_->hot_directories_[node];
+    if (!pointer.is_null()) {
+      directories[directory_count]
+        = reinterpret_cast<HashHotDirectoryRootPage*>(resolver.resolve_offset(pointer));
+      ++directory_count;
+    }
+  }
+
+  // Records deleted in the current epoch might be followed by an insert of the same key with
+  // a smaller XID in the same epoch. We keep them. See DefragBin.
+  const Epoch drop_before = engine_->get_xct_manager()->get_current_global_epoch();
+  HashIntermediatePage* root = context->resolve_cast<HashIntermediatePage>(root_id);
+  CHECK_ERROR_CODE(defrag_volatile_bins_recurse(
+    context,
+    root,
+    range,
+    drop_before,
+    directories,
+    directory_count,
+    stat));
+  DVLOG(0) << "Defragmented " << stat->defragmented_bins_ << " out of "
+    << stat->examined_bins_ << " volatile bins of " << get_name() << " in " << range
+    << ". freed pages=" << stat->freed_pages_ << ", dropped records=" << stat->dropped_records_;
+  return kErrorCodeOk;
+}
+
+ErrorCode HashStoragePimpl::defrag_volatile_bins_recurse(
+  thread::Thread* context,
+  HashIntermediatePage* page,
+  const HashBinRange& range,
+  Epoch drop_before,
+  HashHotDirectoryRootPage* const* directories,
+  uint16_t directory_count,
+  HashDefragStatistics* stat) {
+  ASSERT_ND(!page->header().snapshot_);
+  const uint8_t level = page->get_level();
+  const HashBinRange& page_range = page->get_bin_range();
+  for (uint16_t i = 0; i < kHashIntermediatePageFanout; ++i) {
+    const HashBin begin = page_range.begin_ + i * kHashMaxBins[level];
+    const HashBinRange child_range(begin, begin + kHashMaxBins[level]);
+    if (child_range.end_ <= range.begin_) {
+      continue;
+    } else if (child_range.begin_ >= range.end_) {
+      break;
+    }
+    const VolatilePagePointer pointer = page->get_pointer(i).volatile_pointer_;
+    if (pointer.is_null()) {
+      continue;
+    }
+
+    if (level > 0) {
+      HashIntermediatePage* child = context->resolve_cast<HashIntermediatePage>(pointer);
+      CHECK_ERROR_CODE(defrag_volatile_bins_recurse(
+        context,
+        child,
+        range,
+        drop_before,
+        directories,
+        directory_count,
+        stat));
+      continue;
+    }
+
+    ++stat->examined_bins_;
+    HashDataPage* head = context->resolve_cast<HashDataPage>(pointer);
+    if (!DefragBin::is_worth_defrag(context, head, drop_before)) {
+      continue;
+    }
+    DefragBin functor(context, page, i, directories, directory_count, drop_before);
+    const ErrorCode code = context->run_nested_sysxct(&functor, 5U);
+    if (code == kErrorCodeXctRaceAbort) {
+      // The bin is busy. We will have another chance.
+      ++stat->skipped_bins_;
+      continue;
+    }
+    CHECK_ERROR_CODE(code);
+    if (functor.out_defragmented_) {
+      ++stat->defragmented_bins_;
+      stat->freed_pages_ += functor.out_old_pages_ - functor.out_new_pages_;
+      stat->dropped_records_ += functor.out_dropped_records_;
+    } else {
+      ++stat->skipped_bins_;
+    }
+  }
+  return kErrorCodeOk;
+}
+
 xct::TrackMovedRecordResult HashStoragePimpl::track_moved_record(
   xct::RwLockableXctId* old_address,
   xct::WriteXctAccess* write_set) {
@@ -1129,14 +1676,17 @@ xct::TrackMovedRecordResult HashStoragePimpl::track_moved_record(
   DataPageSlotIndex old_index = slot_origin - old_slot - 1;
   ASSERT_ND(page->get_slot_address(old_index) == old_slot);
 
-  return track_moved_record_search(page, key, key_length, combo);
+  // A deleted record might have been dropped by DefragBin, leaving no copy behind.
+  const bool may_be_dropped = old_address->xct_id_.is_deleted();
+  return track_moved_record_search(page, key, key_length, combo, may_be_dropped);
 }
 
 xct::TrackMovedRecordResult HashStoragePimpl::track_moved_record_search(
   HashDataPage* page,
   const void* key,
   uint16_t key_length,
-  const HashCombo& combo) {
+  const HashCombo& combo,
+  bool may_be_dropped) {
   const memory::GlobalVolatilePageResolver& resolver
     = engine_->get_memory_manager()->get_global_volatile_page_resolver();
   RecordLocation result;
@@ -1172,9 +1722,14 @@ xct::TrackMovedRecordResult HashStoragePimpl::track_moved_record_search(
       continue;
     }
     if (next_page->volatile_pointer_.is_null()) {
-      // This shouldn't happen as far as we flip moved bit after installing the new record
-      LOG(WARNING) << "no next page?? but we didn't find the moved record in this page";
       assorted::memory_fence_acquire();
+      if (next_page->volatile_pointer_.is_null() && may_be_dropped) {
+        // The deleted record was dropped by defragmentation. Conservatively abort.
+        DVLOG(1) << "The moved deleted record has no copy. It was dropped by DefragBin";
+        return xct::TrackMovedRecordResult();
+      }
+      // Otherwise this shouldn't happen as far as we flip moved bit after installing the new record
+      LOG(WARNING) << "no next page?? but we didn't find the moved record in this page";
       if (next_page->volatile_pointer_.is_null()) {
         LOG(ERROR) << "Unexpected error, failed to track moved record in hash storage."
           << " This should not happen. hash combo=" << combo;
@@ -1197,6 +1752,15 @@ xct::TrackMovedRecordResult HashStoragePimpl::track_moved_record_search(
   x* value, \
   uint16_t payload_offset)
 INSTANTIATE_ALL_NUMERIC_TYPES(EXPIN_5I);
+
+#define EXPIN_6I(x) template ErrorCode HashStoragePimpl::increment_record_oneshot< x > \
+  (thread::Thread* context, \
+  const void* key, \
+  uint16_t key_length, \
+  const HashCombo& combo, \
+  x value, \
+  uint16_t payload_offset)
+INSTANTIATE_ALL_NUMERIC_TYPES(EXPIN_6I);
 // @endcond
 
 }  // namespace hash
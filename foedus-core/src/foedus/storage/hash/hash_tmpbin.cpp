@@ -23,6 +23,7 @@
 #include <string>
 
 #include "foedus/assorted/assorted_func.hpp"
+#include "foedus/storage/hash/hash_log_types.hpp"
 
 namespace foedus {
 namespace storage {
@@ -131,7 +132,7 @@ ErrorCode HashTmpBin::insert_record(
   const void* payload,
   uint16_t payload_length) {
   ASSERT_ND(!xct_id.is_deleted());
-  ASSERT_ND(hashinate(key, key_length) == hash);
+  ASSERT_ND(is_hash_of_key(hash, key, key_length));
   SearchResult result = search_bucket(key, key_length, hash);
   if (result.found_ == 0) {
     RecordIndex new_index;
@@ -170,7 +171,7 @@ ErrorCode HashTmpBin::delete_record(
   uint16_t key_length,
   HashValue hash) {
   ASSERT_ND(xct_id.is_deleted());
-  ASSERT_ND(hashinate(key, key_length) == hash);
+  ASSERT_ND(is_hash_of_key(hash, key, key_length));
   SearchResult result = search_bucket(key, key_length, hash);
   if (UNLIKELY(result.found_ == 0)) {
     DLOG(WARNING) << "HashTmpBin::delete_record() hit KeyNotFound case 1. This must not"
@@ -200,7 +201,7 @@ ErrorCode HashTmpBin::overwrite_record(
   uint16_t payload_offset,
   uint16_t payload_count) {
   ASSERT_ND(!xct_id.is_deleted());
-  ASSERT_ND(hashinate(key, key_length) == hash);
+  ASSERT_ND(is_hash_of_key(hash, key, key_length));
   SearchResult result = search_bucket(key, key_length, hash);
   if (UNLIKELY(result.found_ == 0)) {
     DLOG(WARNING) << "HashTmpBin::overwrite_record() hit KeyNotFound case 1. This must not"
@@ -226,6 +227,43 @@ ErrorCode HashTmpBin::overwrite_record(
   return kErrorCodeOk;
 }
 
+ErrorCode HashTmpBin::increment_record(
+  xct::XctId xct_id,
+  const void* key,
+  uint16_t key_length,
+  HashValue hash,
+  ValueType value_type,
+  const void* addendum,
+  uint16_t payload_offset) {
+  ASSERT_ND(!xct_id.is_deleted());
+  ASSERT_ND(is_hash_of_key(hash, key, key_length));
+  SearchResult result = search_bucket(key, key_length, hash);
+  if (UNLIKELY(result.found_ == 0)) {
+    DLOG(WARNING) << "HashTmpBin::increment_record() hit KeyNotFound case 1. This must not"
+      << " happen except unit testcases.";
+    return kErrorCodeStrKeyNotFound;
+  } else {
+    Record* record = get_record(result.found_);
+    ASSERT_ND(record->hash_ == hash);
+    if (UNLIKELY(record->xct_id_.is_deleted())) {
+      DLOG(WARNING) << "HashTmpBin::increment_record() hit KeyNotFound case 2. This must not"
+        << " happen except unit testcases.";
+      return kErrorCodeStrKeyNotFound;
+    } else if (UNLIKELY(record->payload_length_
+        < payload_offset + HashIncrementLogType::get_value_size(value_type))) {
+      DLOG(WARNING) << "HashTmpBin::increment_record() hit TooShortPayload case. This must not"
+        << " happen except unit testcases.";
+      return kErrorCodeStrTooShortPayload;
+    }
+    // one xct might increment the same record many times, all with the same xct_id.
+    ASSERT_ND(record->xct_id_.compare_epoch_and_orginal(xct_id) <= 0);
+    record->xct_id_ = xct_id;
+    HashIncrementLogType::add_value(value_type, record->get_payload() + payload_offset, addendum);
+  }
+
+  return kErrorCodeOk;
+}
+
 ErrorCode HashTmpBin::update_record(
   xct::XctId xct_id,
   const void* key,
@@ -234,7 +272,7 @@ ErrorCode HashTmpBin::update_record(
   const void* payload,
   uint16_t payload_length) {
   ASSERT_ND(!xct_id.is_deleted());
-  ASSERT_ND(hashinate(key, key_length) == hash);
+  ASSERT_ND(is_hash_of_key(hash, key, key_length));
   SearchResult result = search_bucket(key, key_length, hash);
   if (UNLIKELY(result.found_ == 0)) {
     DLOG(WARNING) << "HashTmpBin::update_record() hit KeyNotFound case 1. This must not"
@@ -256,6 +294,36 @@ ErrorCode HashTmpBin::update_record(
   return kErrorCodeOk;
 }
 
+ErrorCode HashTmpBin::replace_record(
+  xct::XctId xct_id,
+  const void* key,
+  uint16_t key_length,
+  HashValue hash,
+  const void* payload,
+  uint16_t payload_length) {
+  ASSERT_ND(!xct_id.is_moved());
+  ASSERT_ND(is_hash_of_key(hash, key, key_length));
+  SearchResult result = search_bucket(key, key_length, hash);
+  if (result.found_ == 0) {
+    if (!xct_id.is_deleted()) {
+      return insert_record(xct_id, key, key_length, hash, payload, payload_length);
+    }
+    // Remember the deletion, too. The bin that receives this image might have the key.
+    xct::XctId live_id = xct_id;
+    live_id.set_notdeleted();
+    CHECK_ERROR_CODE(insert_record(live_id, key, key_length, hash, payload, payload_length));
+    result = search_bucket(key, key_length, hash);
+    ASSERT_ND(result.found_ != 0);
+  }
+
+  Record* record = get_record(result.found_);
+  ASSERT_ND(record->hash_ == hash);
+  ASSERT_ND(record->xct_id_.compare_epoch_and_orginal(xct_id) <= 0);
+  record->xct_id_ = xct_id;
+  record->set_payload(payload, payload_length);
+  return kErrorCodeOk;
+}
+
 
 inline HashTmpBin::SearchResult HashTmpBin::search_bucket(
   const void* key,
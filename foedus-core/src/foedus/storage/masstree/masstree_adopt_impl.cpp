@@ -39,7 +39,12 @@ ErrorCode Adopt::run(xct::SysxctWorkspace* sysxct_workspace) {
   pages[0] = reinterpret_cast<Page*>(parent_);
   pages[1] = reinterpret_cast<Page*>(old_);
   CHECK_ERROR_CODE(context_->sysxct_batch_page_locks(sysxct_workspace, 2, pages));
+  return adopt_impl();
+}
 
+ErrorCode Adopt::adopt_impl() {
+  ASSERT_ND(parent_->is_locked());
+  ASSERT_ND(old_->is_locked());
   // After the above lock, we check status of the pages
   if (parent_->is_moved()) {
     VLOG(0) << "Interesting. concurrent thread has already split this node?";
@@ -209,6 +214,38 @@ ErrorCode Adopt::adopt_case_b(
   return kErrorCodeOk;
 }
 
+ErrorCode AdoptBatch::run(xct::SysxctWorkspace* sysxct_workspace) {
+  ASSERT_ND(old_count_ <= kMaxBatch);
+  ASSERT_ND(!parent_->header().snapshot_);
+  out_adopted_count_ = 0;
+
+  // Lock pages in one shot.
+  Page* pages[kMaxBatch + 1U];
+  pages[0] = reinterpret_cast<Page*>(parent_);
+  for (uint16_t i = 0; i < old_count_; ++i) {
+    ASSERT_ND(!olds_[i]->header().snapshot_);
+    ASSERT_ND(olds_[i]->is_moved());
+    pages[i + 1U] = reinterpret_cast<Page*>(olds_[i]);
+  }
+  CHECK_ERROR_CODE(context_->sysxct_batch_page_locks(sysxct_workspace, old_count_ + 1U, pages));
+
+  for (uint16_t i = 0; i < old_count_; ++i) {
+    if (parent_->is_moved()) {
+      // Concurrent thread or the previous adoption has split the parent. Leave the rest.
+      DVLOG(1) << "Parent split while batched adoption. adopted=" << out_adopted_count_;
+      break;
+    } else if (olds_[i]->is_retired()) {
+      continue;
+    }
+    Adopt adopt(context_, parent_, olds_[i]);
+    CHECK_ERROR_CODE(adopt.adopt_impl());
+    if (olds_[i]->is_retired()) {
+      ++out_adopted_count_;
+    }
+  }
+  return kErrorCodeOk;
+}
+
 }  // namespace masstree
 }  // namespace storage
 }  // namespace foedus
@@ -426,6 +426,8 @@ ErrorStack MasstreeComposeContext::execute() {
           CHECK_ERROR(execute_delete_group(cur, cur + group.count_));
         } else if (log_type == log::kLogCodeMasstreeUpdate) {
           CHECK_ERROR(execute_update_group(cur, cur + group.count_));
+        } else if (log_type == log::kLogCodeMasstreeResize) {
+          CHECK_ERROR(execute_resize_group(cur, cur + group.count_));
         } else {
           ASSERT_ND(log_type == log::kLogCodeMasstreeOverwrite);
           CHECK_ERROR(execute_overwrite_group(cur, cur + group.count_));
@@ -455,8 +457,9 @@ ErrorStack MasstreeComposeContext::execute_same_key_group(uint32_t from, uint32_
   }
   // As these logs are on the same key, we check which logs can be nullified.
 
-  // Let's say I:Insert, U:Update, D:Delete, O:Overwrite
+  // Let's say I:Insert, U:Update, D:Delete, O:Overwrite, R:Resize
   // overwrite: this is the easiest one that is nullified by following delete/update.
+  // resize: same as overwrite. It depends on the preceding payload, so it's never merged.
   // insert: if there is following delete, everything in-between disappear, including insert/delete.
   // update: nullified by following delete/update
   // delete: strongest. never nullified except the insert-delete pairing.
@@ -468,9 +471,10 @@ ErrorStack MasstreeComposeContext::execute_same_key_group(uint32_t from, uint32_
   // As a consequence, we can compact every sequence of logs for the same key into:
   // - Special case. One delete, nothing else. The old page contains a record of the key.
   // - Case A. The old page contains a record of the key:
-  //   Zero or one update, followed by zero or more overwrites ("[U]?O*").
+  //   Zero or one update, followed by zero or more overwrites/resizes ("[U]?[OR]*").
   // - Case B. The old page does not contain a record of the key:
-  //   One insert, followed by zero or one update, followed by zero or more overwrites ("I[U]?O*").
+  //   One insert, followed by zero or one update, followed by zero or more overwrites/resizes
+  //   ("I[U]?[OR]*").
 
   // Conversion examples..
   // Case A1: OODIOUO => DIOUO (nullified everything before D)
@@ -521,7 +525,8 @@ ErrorStack MasstreeComposeContext::execute_same_key_group(uint32_t from, uint32_
           break;
         default:
           ASSERT_ND(log_type_j == log::kLogCodeMasstreeUpdate
-            || log_type_j == log::kLogCodeMasstreeOverwrite);
+            || log_type_j == log::kLogCodeMasstreeOverwrite
+            || log_type_j == log::kLogCodeMasstreeResize);
           ASSERT_ND((!starts_with_insert && insert_count == delete_count)
             || (starts_with_insert && insert_count == delete_count + 1U));
           break;
@@ -589,6 +594,10 @@ ErrorStack MasstreeComposeContext::execute_same_key_group(uint32_t from, uint32_
       next_to_check = next + 1U;
       last_active_delete = to;
     }
+  } else if (starts_with_insert) {
+    // I,,, without any delete. The first insert stays active.
+    last_active_insert = from;
+    next_to_check = from + 1U;
   }
 
   // From now on, we are sure there is no more delete or insert.
@@ -613,15 +622,16 @@ ErrorStack MasstreeComposeContext::execute_same_key_group(uint32_t from, uint32_
         is_last_active_update_merged = false;
       }
     } else {
-      // Overwrites are just skipped.
-      ASSERT_ND(log_type == log::kLogCodeMasstreeOverwrite);
+      // Overwrites and resizes are just skipped.
+      ASSERT_ND(log_type == log::kLogCodeMasstreeOverwrite
+        || log_type == log::kLogCodeMasstreeResize);
       ASSERT_ND(starts_with_insert || last_active_insert != to);
     }
   }
 
   // After these conversions, the only remaining log patterns are:
-  //   a) "IO*"  : the data page doesn't have the key.
-  //   b) "U?O*" : the data page already has the key.
+  //   a) "I[OR]*"  : the data page doesn't have the key.
+  //   b) "U?[OR]*" : the data page already has the key.
   ASSERT_ND(last_active_delete == to);
   uint32_t cur = from;
   if (last_active_insert != to || last_active_update != to) {
@@ -659,8 +669,9 @@ ErrorStack MasstreeComposeContext::execute_same_key_group(uint32_t from, uint32_
 
     // Process the I/U as usual. This also makes sure that the tail-record is the key.
   } else {
-    ASSERT_ND(log::kLogCodeMasstreeOverwrite == merge_sort_->get_log_type_from_sort_position(cur));
-    // All logs are overwrites.
+    ASSERT_ND(log::kLogCodeMasstreeOverwrite == merge_sort_->get_log_type_from_sort_position(cur)
+      || log::kLogCodeMasstreeResize == merge_sort_->get_log_type_from_sort_position(cur));
+    // All logs are overwrites/resizes.
     // Even in this case, we must process the first log as usual so that
     // the tail-record in the tail page points to the record.
   }
@@ -671,7 +682,7 @@ ErrorStack MasstreeComposeContext::execute_same_key_group(uint32_t from, uint32_
     return kRetOk;
   }
 
-  // All the followings are overwrites.
+  // All the followings are overwrites/resizes.
   // Process the remaining overwrites in a tight loop.
   // We made sure sure the tail-record in the tail page points to the record.
   PathLevel* last = get_last_level();
@@ -684,6 +695,16 @@ ErrorStack MasstreeComposeContext::execute_same_key_group(uint32_t from, uint32_
   char* record = page->get_record(index);
 
   for (uint32_t i = cur; i < to; ++i) {
+    if (merge_sort_->get_log_type_from_sort_position(i) == log::kLogCodeMasstreeResize) {
+      // This might re-append the record, so we have to retrieve the tail record again.
+      execute_resize_tail(
+        reinterpret_cast<const MasstreeResizeLogType*>(merge_sort_->resolve_sort_position(i)));
+      last = get_last_level();
+      page = as_border(get_page(last->tail_));
+      index = page->get_key_count() - 1;
+      record = page->get_record(index);
+      continue;
+    }
     const MasstreeOverwriteLogType* casted =
       reinterpret_cast<const MasstreeOverwriteLogType*>(merge_sort_->resolve_sort_position(i));
     ASSERT_ND(casted->header_.get_type() == log::kLogCodeMasstreeOverwrite);
@@ -691,8 +712,9 @@ ErrorStack MasstreeComposeContext::execute_same_key_group(uint32_t from, uint32_
 
     // Also, we look for a chance to ignore redundant overwrites.
     // If next overwrite log covers the same or more data range, we can skip the log.
+    // A resize log has the same layout and overwrites or truncates everything after its offset.
     // Ideally, we should have removed such logs back in mappers.
-    if (i < to) {
+    if (i + 1U < to) {
       const MasstreeOverwriteLogType* next =
         reinterpret_cast<const MasstreeOverwriteLogType*>(
           merge_sort_->resolve_sort_position(i + 1U));
@@ -1033,6 +1055,66 @@ ErrorStack MasstreeComposeContext::execute_overwrite_group(uint32_t from, uint32
   return kRetOk;
 }
 
+ErrorStack MasstreeComposeContext::execute_resize_group(uint32_t from, uint32_t to) {
+  for (uint32_t i = from; i < to; ++i) {
+    CHECK_ERROR(execute_a_log(i));
+  }
+  return kRetOk;
+}
+
+void MasstreeComposeContext::execute_resize_tail(const MasstreeResizeLogType* entry) {
+  ASSERT_ND(entry->header_.get_type() == log::kLogCodeMasstreeResize);
+  PathLevel* last = get_last_level();
+  ASSERT_ND(get_page(last->tail_)->is_border());
+  MasstreeBorderPage* page = as_border(get_page(last->tail_));
+  ASSERT_ND(page->get_key_count() > 0);
+  const SlotIndex index = page->get_key_count() - 1;
+  const char* key = entry->get_key();
+  const KeyLength key_length = entry->key_length_;
+  ASSERT_ND(!page->does_point_to_layer(index));
+  ASSERT_ND(page->equal_key(index, key, key_length));
+
+  const PayloadLength new_length = entry->get_new_payload_length();
+  if (page->get_max_payload_length(index) >= new_length) {
+    // Snapshot records have no extra space except padding, but truncates and small extends fit.
+    // We don't use apply_record() here. It assumes a locked volatile record.
+    char* record_payload = page->get_record_payload(index);
+    const PayloadLength cur_length = page->get_payload_length(index);
+    if (cur_length < entry->payload_offset_) {
+      std::memset(record_payload + cur_length, 0, entry->payload_offset_ - cur_length);
+    }
+    std::memcpy(
+      record_payload + entry->payload_offset_,
+      entry->get_payload(),
+      entry->payload_count_);
+    const PayloadLength aligned_length = assorted::align8(new_length);
+    if (aligned_length != new_length) {
+      std::memset(record_payload + new_length, 0, aligned_length - new_length);
+    }
+    page->get_slot(index)->lengthes_.components.payload_length_ = new_length;
+    return;
+  }
+
+  // Same as update. Physically delete the tail record and append a new one.
+  // The old record region is left as it is, so we can copy from it after deleting.
+  char payload[kMaxPayloadLength];
+  const PayloadLength kept_length
+    = std::min<PayloadLength>(page->get_payload_length(index), entry->payload_offset_);
+  std::memcpy(payload, page->get_record_payload(index), kept_length);
+  std::memset(payload + kept_length, 0, entry->payload_offset_ - kept_length);
+  std::memcpy(payload + entry->payload_offset_, entry->get_payload(), entry->payload_count_);
+  page->set_key_count(index);
+  const KeyLength skip = last->layer_ * kSliceLen;
+  append_border(
+    normalize_be_bytes_full_aligned(key + skip),
+    entry->header_.xct_id_,
+    key_length - skip,
+    key + skip + kSliceLen,
+    new_length,
+    payload,
+    last);
+}
+
 inline ErrorStack MasstreeComposeContext::execute_a_log(uint32_t cur) {
   ASSERT_ND(cur < merge_sort_->get_current_count());
 
@@ -1091,7 +1173,10 @@ inline ErrorStack MasstreeComposeContext::execute_a_log(uint32_t cur) {
   }
 
   // Now we are sure the tail of the last level is the only relevant record. process the log.
-  if (entry->header_.get_type() == log::kLogCodeMasstreeOverwrite) {
+  if (entry->header_.get_type() == log::kLogCodeMasstreeResize) {
+    // [Resize] in-place if the record is spacious enough, otherwise same as update
+    execute_resize_tail(reinterpret_cast<const MasstreeResizeLogType*>(entry));
+  } else if (entry->header_.get_type() == log::kLogCodeMasstreeOverwrite) {
     // [Overwrite] simply reuse log.apply
     SlotIndex index = key_count - 1;
     ASSERT_ND(!page->does_point_to_layer(index));
@@ -58,6 +58,7 @@ MasstreeCursor::MasstreeCursor(MasstreeStorage storage, thread::Thread* context)
 
   cur_route_prefix_slices_ = nullptr;
   cur_route_prefix_be_ = nullptr;
+  route_prefix_version_ = 0;
 
   cur_key_length_ = 0;
   cur_key_owner_id_address = nullptr;
@@ -203,6 +204,132 @@ ErrorCode MasstreeCursor::next() {
   return kErrorCodeOk;
 }
 
+ErrorCode MasstreeCursor::next_batch(uint16_t max_count, BatchRecord* records, uint16_t* count) {
+  ASSERT_ND(!should_skip_cur_route_);
+  *count = 0;
+  if (max_count == 0 || !is_valid_record()) {
+    return kErrorCodeOk;
+  }
+
+  // All records we return must share the prefix as of the call. As soon as next() moves to
+  // another layer or to another prefix in the same layer, we stop there.
+  const Layer layer = cur_route()->layer_;
+  const uint32_t prefix_version = route_prefix_version_;
+  while (true) {
+    ASSERT_ND(!is_cur_key_next_layer());
+    BatchRecord* record = records + (*count);
+    record->slice_ = cur_key_in_layer_slice_;
+    record->key_length_ = cur_key_length_;
+    record->suffix_ = cur_key_suffix_;
+    record->payload_ = cur_payload_;
+    record->payload_length_ = cur_payload_length_;
+    ++(*count);
+
+    // Take the following records in this border page in one pass. next() then handles
+    // whatever the pass left: page boundaries, next layers, and the end key.
+    if (*count < max_count) {
+      CHECK_ERROR_CODE(next_batch_in_page(max_count, records, count));
+    }
+    CHECK_ERROR_CODE(next());
+    if (*count >= max_count
+      || !is_valid_record()
+      || prefix_version != route_prefix_version_
+      || layer != cur_route()->layer_) {
+      break;
+    }
+  }
+  return kErrorCodeOk;
+}
+
+ErrorCode MasstreeCursor::next_batch_in_page(
+  uint16_t max_count,
+  BatchRecord* records,
+  uint16_t* count) {
+  Route* route = cur_route();
+  if (!route->page_->is_border() || route->was_stably_moved()) {
+    return kErrorCodeOk;
+  }
+  MasstreeBorderPage* page = reinterpret_cast<MasstreeBorderPage*>(route->page_);
+  const Layer layer = route->layer_;
+
+  // A record whose slice is the end slice needs the full key comparison. We leave it to next().
+  // If the route prefix differs from the end key, the current record being valid means
+  // all records in this page are before the end key.
+  const bool bounded = !is_end_key_supremum() && route->end_key_prefix_compare_ == kCurKeyEquals;
+  const KeySlice end_slice = bounded ? end_key_slices_[layer] : 0;
+
+  const uint16_t initial_count = *count;
+  SlotIndex index = route->index_;
+  SlotIndex last_index = route->index_;
+  SlotIndex last_record = kBorderPageMaxSlots;
+  xct::XctId last_observed;
+  xct::ReadXctAccess* last_readset = nullptr;
+  while (*count < max_count) {
+    index = forward_cursor_ ? index + 1U : index - 1U;
+    if (index >= route->key_count_) {  // also a 'negative' check
+      break;
+    }
+    const SlotIndex record = route->get_original_index(index);
+    const KeySlice slice = page->get_slice(record);
+    if (bounded && (forward_cursor_ ? slice >= end_slice : slice <= end_slice)) {
+      break;
+    }
+    xct::XctId observed;
+    xct::ReadXctAccess* readset = nullptr;
+    CHECK_ERROR_CODE(current_xct_->on_record_read(
+      for_writes_,
+      page->get_owner_id(record),
+      &observed,
+      &readset,
+      true,
+      true));
+    if (observed.is_moved() || observed.is_next_layer()) {
+      break;
+    } else if (observed.is_deleted()) {
+      continue;
+    }
+    BatchRecord* out = records + (*count);
+    out->slice_ = slice;
+    out->key_length_ = layer * sizeof(KeySlice) + page->get_remainder_length(record);
+    out->suffix_ = page->get_record(record);
+    out->payload_ = page->get_record_payload(record);
+    out->payload_length_ = page->get_payload_length(record);
+    ++(*count);
+    last_index = index;
+    last_record = record;
+    last_observed = observed;
+    last_readset = readset;
+  }
+
+  if (last_record == kBorderPageMaxSlots) {
+    return kErrorCodeOk;
+  }
+
+  // One version check for the whole pass. If the page was split or restructured meanwhile,
+  // we discard the pass and let next() walk the page record by record.
+  assorted::memory_fence_acquire();
+  if (!route->snapshot_ && page->get_version().status_ != route->stable_) {
+    DVLOG(0) << "Border page changed during next_batch(). falling back to next()";
+    *count = initial_count;
+    return kErrorCodeOk;
+  }
+
+  // Make the last record we returned the current record, as if we called next() up to it.
+  route->index_ = last_index;
+  cur_key_owner_id_address = page->get_owner_id(last_record);
+  cur_key_in_layer_remainder_ = page->get_remainder_length(last_record);
+  cur_key_in_layer_slice_ = page->get_slice(last_record);
+  cur_key_length_ = layer * sizeof(KeySlice) + cur_key_in_layer_remainder_;
+  cur_key_location_.page_ = page;
+  cur_key_location_.index_ = last_record;
+  cur_key_location_.observed_ = last_observed;
+  cur_key_location_.readset_ = last_readset;
+  cur_key_suffix_ = page->get_record(last_record);
+  cur_payload_length_ = page->get_payload_length(last_record);
+  cur_payload_ = page->get_record_payload(last_record);
+  return kErrorCodeOk;
+}
+
 inline ErrorCode MasstreeCursor::proceed_route() {
   ASSERT_ND(!should_skip_cur_route_);  // must be controlled in the caller (open/next)
   if (cur_route()->page_->is_border()) {
@@ -217,13 +344,13 @@ ErrorCode MasstreeCursor::proceed_route_border() {
   ASSERT_ND(!route->was_stably_moved());
   ASSERT_ND(route->page_->is_border());
   // 20160330 Hideaki : No need to do the early abort here. Disabled.
-  // Serializability is anyway guaranteed by key-count check at commit time.
+  // Serializability is anyway guaranteed by the range set (key-count check) at commit time.
   // Now that we have MOCC implemented, there is a benefit to not abort here.
   // If we move on and reach the commit phase, we will know the full read/write sets
   // and construct RLL for next run. We thus should move on here.
   // if (UNLIKELY(route->page_->get_version().status_ != route->stable_)) {
   //   // something has changed in this page.
-  //   // TASK(Hideaki) until we implement range lock, we have to roll back in this case.
+  //   // until we implemented range lock, we had to roll back in this case.
   //   return kErrorCodeXctRaceAbort;
   // }
   // PageVersionStatus stable = route->stable_;
@@ -429,6 +556,7 @@ inline ErrorCode MasstreeCursor::proceed_next_layer() {
   Layer layer = page->get_layer();
   KeySlice record_slice = page->get_slice(route->get_cur_original_index());
   cur_route_prefix_slices_[layer] = record_slice;
+  ++route_prefix_version_;
   assorted::write_bigendian<KeySlice>(
     record_slice,
     cur_route_prefix_be_ + (layer * sizeof(KeySlice)));
@@ -626,6 +754,9 @@ ErrorCode MasstreeCursor::push_route(MasstreePage* page) {
     route.index_mini_ = kMaxRecords;  // must be set shortly after this method
     route.snapshot_ = page->header().snapshot_;
     route.layer_ = page->get_layer();
+    if (!is_end_key_supremum()) {
+      route.end_key_prefix_compare_ = compare_route_prefix_against_end_key(route.layer_);
+    }
     if (is_border && !route.was_stably_moved()) {
       route.setup_order();
       assorted::memory_fence_acquire();
@@ -640,7 +771,7 @@ ErrorCode MasstreeCursor::push_route(MasstreePage* page) {
   }
 
   ++route_count_;
-  // We don't need to take a page into the page version set unless we need to lock a range in it.
+  // We don't need to take a page into the range set unless we need to lock a range in it.
   // We thus need it only for border pages. Even if an interior page changes, splits, whatever,
   // the pre-existing border pages are already responsible for the searched key regions.
   // this is an outstanding difference from original masstree/silo protocol.
@@ -648,7 +779,62 @@ ErrorCode MasstreeCursor::push_route(MasstreePage* page) {
   if (!is_border || page->header().snapshot_ || route.was_stably_moved()) {
     return kErrorCodeOk;
   }
-  return current_xct_->add_to_page_version_set(&page->header().page_version_, route.stable_);
+  // Unlike page version set, we lock only the part of the page this cursor might read.
+  // Concurrent inserts out of the range don't abort us.
+  KeySlice low;
+  KeySlice high;
+  extract_route_range(page, &low, &high);
+  if (low > high) {
+    return kErrorCodeOk;  // this cursor won't read anything from this page
+  }
+  return current_xct_->add_to_range_set(
+    storage_.get_id(),
+    page->get_version_address(),
+    route.stable_,
+    route.key_count_,
+    low,
+    high);
+}
+
+inline bool MasstreeCursor::is_in_route_prefix(
+  const KeySlice* key_slices,
+  KeyLength key_length,
+  Layer layer) const {
+  // The key must have full slices up to this layer and an in-layer part.
+  // This also rules out extremum (kKeyLengthExtremum == 0).
+  if (key_length <= layer * sizeof(KeySlice)) {
+    return false;
+  }
+  for (Layer i = 0; i < layer; ++i) {
+    if (key_slices[i] != cur_route_prefix_slices_[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline void MasstreeCursor::extract_route_range(
+  const MasstreePage* page,
+  KeySlice* low,
+  KeySlice* high) const {
+  // Start from the fences, then narrow it down with the search/end keys if they are in the
+  // same B-trie path. Slices are monotonic to keys, so a key between the search/end keys
+  // always has a slice between their slices. Otherwise, we conservatively lock the whole page.
+  const Layer layer = page->get_layer();
+  *low = page->get_low_fence();
+  *high = page->get_high_fence();
+
+  // lower/upper bound of this cursor. search key is the lower bound in forward cursor
+  const KeySlice* lower_slices = forward_cursor_ ? search_key_slices_ : end_key_slices_;
+  const KeyLength lower_length = forward_cursor_ ? search_key_length_ : end_key_length_;
+  const KeySlice* upper_slices = forward_cursor_ ? end_key_slices_ : search_key_slices_;
+  const KeyLength upper_length = forward_cursor_ ? end_key_length_ : search_key_length_;
+  if (is_in_route_prefix(lower_slices, lower_length, layer)) {
+    *low = std::max<KeySlice>(*low, lower_slices[layer]);
+  }
+  if (is_in_route_prefix(upper_slices, upper_length, layer)) {
+    *high = std::min<KeySlice>(*high, upper_slices[layer]);
+  }
 }
 
 inline ErrorCode MasstreeCursor::follow_foster_border(KeySlice slice) {
@@ -777,17 +963,9 @@ inline MasstreeCursor::KeyCompareResult MasstreeCursor::compare_cur_key_aginst_s
   return compare_cur_key(slice, layer, search_key_, search_key_length_);
 }
 
-inline MasstreeCursor::KeyCompareResult MasstreeCursor::compare_cur_key_aginst_end_key() const {
-  if (is_end_key_supremum()) {
-    return forward_cursor_ ? kCurKeySmaller : kCurKeyLarger;
-  }
-
-  ASSERT_ND(!is_cur_key_next_layer());
-  const Layer layer = cur_route()->layer_;
-
-  // TASK(Hideaki): We don't have to compare prefixes each time.
-  // We can remember whether the end_key is trivially satisfied in route.
-  // So far we compare each time... let's see what CPU profile says.
+inline MasstreeCursor::KeyCompareResult MasstreeCursor::compare_route_prefix_against_end_key(
+  Layer layer) const {
+  ASSERT_ND(!is_end_key_supremum());
   for (Layer i = 0; i < layer && sizeof(KeySlice) * i < end_key_length_; ++i) {
     if (end_key_slices_[i] > cur_route_prefix_slices_[i]) {
       return kCurKeySmaller;
@@ -799,13 +977,30 @@ inline MasstreeCursor::KeyCompareResult MasstreeCursor::compare_cur_key_aginst_e
   // For example, end-key="123456", layer=1. end_key_slices_[0] was incomplete.
   // We know cur_route_prefix_slices_[0] was "123456  " (space as \0). So it's actually different.
   if (sizeof(KeySlice) * layer > end_key_length_) {
-    ASSERT_ND(cur_key_length_ > end_key_length_);
     if (is_forward_cursor()) {
       return kCurKeyLarger;
     } else {
       return kCurKeySmaller;
     }
   }
+  // all prefix slices were exactly the same. caller has to compare in-layer slice and suffix
+  return kCurKeyEquals;
+}
+
+inline MasstreeCursor::KeyCompareResult MasstreeCursor::compare_cur_key_aginst_end_key() const {
+  if (is_end_key_supremum()) {
+    return forward_cursor_ ? kCurKeySmaller : kCurKeyLarger;
+  }
+
+  ASSERT_ND(!is_cur_key_next_layer());
+  const Route* route = cur_route();
+  const Layer layer = route->layer_;
+
+  // Prefix slices don't change while we are in this route. We compared them in push_route().
+  ASSERT_ND(route->end_key_prefix_compare_ == compare_route_prefix_against_end_key(layer));
+  if (route->end_key_prefix_compare_ != kCurKeyEquals) {
+    return route->end_key_prefix_compare_;
+  }
 
   // okay, all prefix slices were exactly the same.
   // We have to compare in-layer slice and suffix
@@ -1148,6 +1343,7 @@ ErrorCode MasstreeCursor::locate_next_layer() {
   Layer layer = border->get_layer();
   KeySlice record_slice = border->get_slice(route->get_cur_original_index());
   cur_route_prefix_slices_[layer] = record_slice;
+  ++route_prefix_version_;
   assorted::write_bigendian<KeySlice>(
     record_slice,
     cur_route_prefix_be_ + (layer * sizeof(KeySlice)));
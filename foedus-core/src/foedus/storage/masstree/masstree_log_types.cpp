@@ -91,6 +91,17 @@ std::ostream& operator<<(std::ostream& o, const MasstreeOverwriteLogType& v) {
   return o;
 }
 
+std::ostream& operator<<(std::ostream& o, const MasstreeResizeLogType& v) {
+  o << "<MasstreeResizeLogType>"
+    << "<key_length_>" << v.key_length_ << "</key_length_>"
+    << "<key_>" << assorted::Top(v.get_key(), v.key_length_) << "</key_>"
+    << "<payload_offset_>" << v.payload_offset_ << "</payload_offset_>"
+    << "<payload_count_>" << v.payload_count_ << "</payload_count_>"
+    << "<payload_>" << assorted::Top(v.get_payload(), v.payload_count_) << "</payload_>"
+    << "</MasstreeResizeLogType>";
+  return o;
+}
+
 }  // namespace masstree
 }  // namespace storage
 }  // namespace foedus
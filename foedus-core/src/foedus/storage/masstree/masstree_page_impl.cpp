@@ -36,6 +36,7 @@
 #include "foedus/storage/storage_manager.hpp"
 #include "foedus/storage/masstree/masstree_log_types.hpp"
 #include "foedus/thread/thread.hpp"
+#include "foedus/xct/retrospective_lock_list.hpp"
 #include "foedus/xct/xct.hpp"
 #include "foedus/xct/xct_access.hpp"
 #include "foedus/xct/xct_manager.hpp"
@@ -531,6 +532,64 @@ MasstreeBorderPage* MasstreeBorderPage::track_foster_child(
   return cur_page;
 }
 
+/** @returns whether the lock list holds a write lock on the record, ie it's our own insert */
+inline bool is_locked_by(
+  const xct::CurrentLockList* locks,
+  const xct::RwLockableXctId* owner_id) {
+  const xct::UniversalLockId lock_id = xct::to_universal_lock_id(
+    locks->get_volatile_page_resolver(),
+    reinterpret_cast<uintptr_t>(owner_id));
+  const xct::LockListPosition pos = locks->binary_search(lock_id);
+  return pos != xct::kLockListPositionInvalid
+    && locks->get_entry(pos)->taken_mode_ == xct::kWriteLock;
+}
+
+bool MasstreeBorderPage::has_new_record_in_range(
+  SlotIndex from_index,
+  KeySlice low,
+  KeySlice high,
+  const xct::CurrentLockList* own_locks) const {
+  ASSERT_ND(!header().snapshot_);
+  ASSERT_ND(low <= high);
+  const SlotIndex key_count = get_key_count();
+  ASSERT_ND(from_index <= key_count);
+  // slices are installed before key_count is incremented.
+  assorted::memory_fence_acquire();
+  for (SlotIndex i = from_index; i < key_count; ++i) {
+    const KeySlice slice = get_slice(i);
+    if (slice < low || slice > high) {
+      continue;
+    }
+    // Same as get_initial_xid() in masstree_reserve_impl.cpp. No one has inserted it yet.
+    const xct::RwLockableXctId* owner_id = get_owner_id(i);
+    const xct::XctId xid = owner_id->xct_id_;
+    if (xid.is_deleted()
+      && !xid.is_being_written()
+      && !xid.is_moved()
+      && !xid.is_next_layer()
+      && xid.get_ordinal() == 0
+      && xid.get_epoch_int() == Epoch::kEpochInitialCurrent) {
+      // Inserters lock the record before they change the XID and unlock it after.
+      // If it's still unlocked and the XID is still the initial one after we see the lock,
+      // the inserter hasn't started precommit yet.
+      assorted::memory_fence_acquire();
+      const bool locked = owner_id->is_keylocked();
+      assorted::memory_fence_acquire();
+      if (owner_id->xct_id_ != xid) {
+        DVLOG(1) << "A new record in range was just inserted. index=" << i;
+        return true;
+      } else if (!locked || is_locked_by(own_locks, owner_id)) {
+        continue;
+      }
+      DVLOG(1) << "A new record in range is being inserted by another xct. index=" << i;
+      return true;
+    }
+    DVLOG(1) << "Found a new record in range. index=" << i << ", slice=" << slice;
+    return true;
+  }
+  return false;
+}
+
 xct::TrackMovedRecordResult MasstreeBorderPage::track_moved_record(
   Engine* engine,
   xct::RwLockableXctId* owner_address,
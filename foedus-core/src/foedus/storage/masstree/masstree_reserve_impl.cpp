@@ -224,6 +224,55 @@ ErrorCode ReserveRecords::run(xct::SysxctWorkspace* sysxct_workspace) {
   return kErrorCodeOk;
 }
 
+ErrorCode ReserveRecordsBatch::run(xct::SysxctWorkspace* sysxct_workspace) {
+  out_reserved_count_ = 0;
+  ASSERT_ND(!target_->header().snapshot_);
+  ASSERT_ND(target_->get_layer() == 0);
+  CHECK_ERROR_CODE(context_->sysxct_page_lock(sysxct_workspace, reinterpret_cast<Page*>(target_)));
+  ASSERT_ND(target_->is_locked());
+  if (target_->is_moved()) {
+    DVLOG(0) << "Interesting. this page has been split";
+    return kErrorCodeOk;
+  }
+  ASSERT_ND(!target_->is_retired());
+
+  // The page-lock is held throughout the loop, so key-count and keys don't change except by us.
+  xct::XctId initial_id = get_initial_xid();
+  initial_id.set_deleted();
+  for (uint16_t i = 0; i < key_count_; ++i) {
+    const KeySlice key = keys_[i];
+    if (!target_->within_fences(key)) {
+      break;
+    }
+    const SlotIndex key_count = target_->get_key_count();
+    const SlotIndex index = target_->find_key_normalized(0, key_count, key);
+    if (index != kBorderPageMaxSlots) {
+      if (target_->get_max_payload_length(index) < payload_count_) {
+        break;  // needs record expansion. leave it to ReserveRecords
+      }
+    } else if (target_->can_accomodate(key_count, sizeof(KeySlice), payload_count_)) {
+      target_->reserve_record_space(
+        key_count,
+        initial_id,
+        key,
+        nullptr,
+        sizeof(KeySlice),
+        payload_count_);
+      // same as ReserveRecords. increment key count AFTER installing the key.
+      assorted::memory_fence_release();
+      target_->increment_key_count();
+    } else {
+      break;  // needs split
+    }
+    ++out_reserved_count_;
+  }
+
+  ASSERT_ND(!target_->is_moved());
+  ASSERT_ND(!target_->is_retired());
+  target_->assert_entries();
+  return kErrorCodeOk;
+}
+
 }  // namespace masstree
 }  // namespace storage
 }  // namespace foedus
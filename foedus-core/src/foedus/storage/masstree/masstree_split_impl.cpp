@@ -20,9 +20,9 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <cstdlib>
 
 #include "foedus/assert_nd.hpp"
-#include "foedus/assorted/uniform_random.hpp"
 #include "foedus/debugging/rdtsc_watch.hpp"
 #include "foedus/storage/masstree/masstree_page_impl.hpp"
 #include "foedus/thread/thread.hpp"
@@ -143,6 +143,37 @@ ErrorCode SplitBorder::run(xct::SysxctWorkspace* sysxct_workspace) {
   return kErrorCodeOk;
 }
 
+/** A slice in the page and the order it was inserted. Slots are in insertion order. */
+struct SplitSortEntry {
+  KeySlice  slice_;
+  SlotIndex index_;
+  bool operator<(const SplitSortEntry& rhs) const {
+    return slice_ < rhs.slice_ || (slice_ == rhs.slice_ && index_ < rhs.index_);
+  }
+};
+
+/**
+ * Returns the position in sorted entries closest to the given position where the slice differs
+ * from the previous entry, or count if there is no such position.
+ * Same slices must be in the same page, so only such positions can be the separator.
+ */
+SlotIndex find_separator_position(
+  const SplitSortEntry* sorted,
+  SlotIndex count,
+  SlotIndex desired) {
+  ASSERT_ND(desired > 0);
+  for (SlotIndex distance = 0; distance < count; ++distance) {
+    if (desired + distance < count
+      && sorted[desired + distance].slice_ != sorted[desired + distance - 1U].slice_) {
+      return desired + distance;
+    } else if (distance < desired - 1U
+      && sorted[desired - distance - 1U].slice_ != sorted[desired - distance - 2U].slice_) {
+      return desired - distance - 1U;
+    }
+  }
+  return count;
+}
+
 void SplitBorder::decide_strategy(SplitBorder::SplitStrategy* out) const {
   ASSERT_ND(target_->is_locked());
   const SlotIndex key_count = target_->get_key_count();
@@ -170,134 +201,92 @@ void SplitBorder::decide_strategy(SplitBorder::SplitStrategy* out) const {
     return;
   }
 
-  for (SlotIndex i = 1; i < key_count; ++i) {
-    const KeySlice this_slice = target_->get_slice(i);
-    out->smallest_slice_ = std::min<KeySlice>(this_slice, out->smallest_slice_);
-    out->largest_slice_ = std::max<KeySlice>(this_slice, out->largest_slice_);
-  }
-
   ASSERT_ND(key_count >= 2U);  // because it's not consecutive, there must be at least 2 records.
 
-  {
-    // even if not, there is another easy case where two "tides" mix in this page;
-    // one tide from left sequentially inserts keys while another tide from right also sequentially
-    // inserts keys that are larger than left tide. This usually happens at the boundary of
-    // two largely independent partitions (eg multiple threads inserting keys of their partition).
-    // In that case, we should cleanly separate the two tides by picking the smallest key from
-    // right-tide as the separator.
-    KeySlice tides_max[2];
-    KeySlice second_tide_min = kInfimumSlice;
-    bool first_tide_broken = false;
-    bool both_tides_broken = false;
-    tides_max[0] = target_->get_slice(0);
-    // for example, consider the following case:
-    //   1 2 32 33 3 4 34 x
-    // There are two tides 1- and 32-. We detect them as follows.
-    // We initially consider 1,2,32,33 as the first tide because they are sequential.
-    // Then, "3" breaks the first tide. We then consider 1- and 32- as the two tides.
-    // If x breaks the tide again, we give up.
-    for (SlotIndex i = 1; i < key_count; ++i) {
-      // look for "tide breaker" that is smaller than the max of the tide.
-      // as soon as we found two of them (meaning 3 tides or more), we give up.
-      KeySlice slice = target_->get_slice(i);
-      if (!first_tide_broken)  {
-        if (slice >= tides_max[0]) {
-          tides_max[0] = slice;
-          continue;  // ok!
-        } else {
-          // let's find where a second tide starts.
-          first_tide_broken = true;
-          SlotIndex first_breaker;
-          for (first_breaker = 0; first_breaker < i; ++first_breaker) {
-            const KeySlice breaker_slice = target_->get_slice(first_breaker);
-            if (breaker_slice > slice) {
-              break;
-            }
-          }
-          ASSERT_ND(first_breaker < i);
-          tides_max[0] = slice;
-          ASSERT_ND(second_tide_min == kInfimumSlice);
-          second_tide_min = target_->get_slice(first_breaker);
-          tides_max[1] = target_->get_slice(i - 1);
-          ASSERT_ND(tides_max[0] < tides_max[1]);
-          ASSERT_ND(tides_max[0] < second_tide_min);
-          ASSERT_ND(second_tide_min <= tides_max[1]);
-        }
-      } else {
-        if (slice < second_tide_min && slice >= tides_max[0]) {
-          tides_max[0] = slice;
-          continue;  // fine, in the first tide
-        } else if (slice >= tides_max[1]) {
-          tides_max[1] = slice;  // okay, in the second tide
-        } else {
-          DVLOG(2) << "Oops, third tide. not the easy case";
-          both_tides_broken = true;
-          break;
-        }
-      }
+  // Slots are in insertion order, so the page itself tells us its recent insert pattern.
+  // We sort the slices, remembering when each of them was inserted.
+  SplitSortEntry sorted[kBorderPageMaxSlots];
+  for (SlotIndex i = 0; i < key_count; ++i) {
+    sorted[i].slice_ = target_->get_slice(i);
+    sorted[i].index_ = i;
+  }
+  std::sort(sorted, sorted + key_count);
+  out->smallest_slice_ = sorted[0].slice_;
+  out->largest_slice_ = sorted[key_count - 1U].slice_;
+
+  // A "tide" is a key range that has been filled sequentially, for example by one client that
+  // appends its own ascending keys. In key order, a new tide begins wherever a key was inserted
+  // before its left neighbor. For example, consider the following insertions:
+  //   1 2 32 33 3 4 34
+  // In key order, the insertion orders are 0 1 4 5 | 2 3 6, so there are two tides 1- and 32-.
+  // Random inserts make a new tide every other key or so.
+  SlotIndex tide_starts[kBorderPageMaxSlots];
+  SlotIndex tide_count = 0;
+  for (SlotIndex i = 1; i < key_count; ++i) {
+    if (sorted[i].index_ < sorted[i - 1U].index_ && sorted[i].slice_ != sorted[i - 1U].slice_) {
+      tide_starts[tide_count] = i;
+      ++tide_count;
     }
+  }
 
-    // Already sorted? (seems consecutive_inserts_ has some false positives)
-    if (!first_tide_broken) {
-      if (!disable_no_record_split_ && trigger_ > out->largest_slice_) {
-        out->no_record_split_ = true;
-        DVLOG(1) << "Obviously no record split. key_count=" << static_cast<int>(key_count);
-        out->mid_slice_ = out->largest_slice_ + 1;
-      } else {
-        if (disable_no_record_split_ && trigger_ > out->largest_slice_) {
-          DVLOG(1) << "No-record split was possible, but disable_no_record_split specified."
-            << " simply splitting in half...";
-        }
-        DVLOG(1) << "Breaks a sequential page. key_count=" << static_cast<int>(key_count);
-        out->mid_slice_ = target_->get_slice(key_count / 2);
+  // Already sorted? (seems consecutive_inserts_ has some false positives)
+  if (tide_count == 0) {
+    if (!disable_no_record_split_ && trigger_ > out->largest_slice_) {
+      out->no_record_split_ = true;
+      DVLOG(1) << "Obviously no record split. key_count=" << static_cast<int>(key_count);
+      out->mid_slice_ = out->largest_slice_ + 1;
+    } else {
+      if (disable_no_record_split_ && trigger_ > out->largest_slice_) {
+        DVLOG(1) << "No-record split was possible, but disable_no_record_split specified."
+          << " simply splitting in half...";
       }
-      return;
+      DVLOG(1) << "Breaks a sequential page. key_count=" << static_cast<int>(key_count);
+      out->mid_slice_ = target_->get_slice(key_count / 2);
     }
+    return;
+  }
 
-    ASSERT_ND(first_tide_broken);
-    if (!both_tides_broken) {
-      DVLOG(0) << "Yay, figured out two-tides meeting in a page.";
-      out->mid_slice_ = second_tide_min;
-      return;
+  // Interleaved-sequential pattern: two or more tides, each of them long enough.
+  // Such tides usually come from the boundary of largely independent partitions
+  // (eg multiple threads inserting keys of their partition). We never break a tide.
+  // Each tide will eventually be in its own page, which then receives only sequential inserts
+  // and gets no-record splits. Breaking a tide in the middle would leave its left half-page
+  // with no future inserts, so the page stays half-empty forever.
+  // Among the tide boundaries, we pick the one closest to the middle.
+  const SlotIndex kMinTideLength = 4;
+  if ((tide_count + 1U) * kMinTideLength <= key_count) {
+    const int32_t middle = key_count / 2U;
+    SlotIndex best = tide_starts[0];
+    for (SlotIndex i = 1; i < tide_count; ++i) {
+      if (std::abs(tide_starts[i] - middle) < std::abs(best - middle)) {
+        best = tide_starts[i];
+      }
     }
+    DVLOG(0) << "Yay, figured out " << (tide_count + 1U) << " tides meeting in a page.";
+    out->mid_slice_ = sorted[best].slice_;
+    return;
   }
 
-
-  // now we have to pick separator. as we don't sort in-page, this is approximate median selection.
-  // there are a few smart algorithm out there, but we don't need that much accuracy.
-  // just randomly pick a few. good enough.
-  assorted::UniformRandom uniform_random(12345);
-  const SlotIndex kSamples = 7;
-  KeySlice choices[kSamples];
-  for (uint8_t i = 0; i < kSamples; ++i) {
-    choices[i] = target_->get_slice(uniform_random.uniform_within(0, key_count - 1));
+  // Append-heavy pattern: the latest insert was the largest key and the trigger goes beyond it.
+  // Most keys come in ascending order, but occasionally keys go to the middle.
+  // A 50/50 split would leave the left half-page mostly empty, and a no-record split would
+  // immediately split the left page again on the next stray key. We leave a bit of room.
+  SlotIndex desired;
+  if (!disable_no_record_split_
+    && trigger_ > out->largest_slice_
+    && target_->get_slice(key_count - 1U) == out->largest_slice_) {
+    DVLOG(1) << "Append-heavy page. 90/10 split. key_count=" << static_cast<int>(key_count);
+    desired = std::max<SlotIndex>(key_count * 9U / 10U, 1U);
+  } else {
+    // Random pattern. Now that we have sorted the keys, we exactly pick the median.
+    desired = key_count / 2U;
   }
-  std::sort(choices, choices + kSamples);
-  out->mid_slice_ = choices[kSamples / 2];
-
-  // scan through again to make sure the new separator is not used multiple times as key.
-  // this is required for the invariant "same slices must be in same page"
-  while (true) {
-    bool observed = false;
-    bool retry = false;
-    for (SlotIndex i = 0; i < key_count; ++i) {
-      const KeySlice this_slice = target_->get_slice(i);
-      if (this_slice == out->mid_slice_) {
-        if (observed) {
-          // the key appeared twice! let's try another slice.
-          ++out->mid_slice_;
-          retry = true;
-          break;
-        } else {
-          observed = true;
-        }
-      }
-    }
-    if (retry) {
-      continue;
-    } else {
-      break;
-    }
+  const SlotIndex position = find_separator_position(sorted, key_count, desired);
+  if (position < key_count) {
+    out->mid_slice_ = sorted[position].slice_;
+  } else {
+    // all slices are the same. The right twin receives nothing.
+    out->mid_slice_ = out->largest_slice_ + 1;
   }
 }
 
@@ -397,8 +386,13 @@ void SplitBorder::migrate_records(
       prev_slice = from_slice;
       prev_remainder = to_remainder;
 
-      // we migh shrink the physical record size.
-      const DataOffset record_length = MasstreeBorderPage::to_record_length(to_remainder, payload);
+      // We keep the physical payload capacity of the record. Some transaction might have
+      // reserved the space (eg reserve_record() for an expansion) and is going to write up to
+      // that length at commit. Shrinking it here would let the write overflow the record.
+      // Only when the record is now a next-layer pointer, we can shrink it to the pointer.
+      const PayloadLength capacity
+        = from_suffix != to_suffix ? payload : copy_from.get_max_payload_length(i);
+      const DataOffset record_length = MasstreeBorderPage::to_record_length(to_remainder, capacity);
       ASSERT_ND(record_length % 8 == 0);
       ASSERT_ND(record_length <= from_slot->lengthes_.components.physical_record_length_);
       to_slot->lengthes_.components.physical_record_length_ = record_length;
@@ -244,6 +244,96 @@ PayloadLength adjust_payload_hint(
   return physical_payload_hint;
 }
 
+/** Errors that are reported per key in batched APIs rather than failing the whole batch */
+inline bool is_key_specific_error(ErrorCode code) {
+  return code == kErrorCodeOk
+    || code == kErrorCodeStrKeyNotFound
+    || code == kErrorCodeStrKeyAlreadyExists
+    || code == kErrorCodeStrTooSmallPayloadBuffer;
+}
+
+ErrorCode MasstreeStorage::get_record_batch(
+  thread::Thread* context,
+  uint16_t batch_size,
+  const void* const* keys,
+  const KeyLength* key_lengths,
+  void* const* payloads,
+  PayloadLength* payload_capacities,
+  ErrorCode* results,
+  bool read_only) {
+  MasstreeStoragePimpl pimpl(this);
+  RecordLocation locations[MasstreeStoragePimpl::kBatchMax];
+  for (uint16_t cur = 0; cur < batch_size;) {
+    uint16_t chunk = batch_size - cur;
+    if (chunk > MasstreeStoragePimpl::kBatchMax) {
+      chunk = MasstreeStoragePimpl::kBatchMax;
+    }
+    CHECK_ERROR_CODE(pimpl.locate_record_batch(
+      context,
+      chunk,
+      &keys[cur],
+      &key_lengths[cur],
+      !read_only,
+      locations,
+      &results[cur]));
+    for (uint16_t i = 0; i < chunk; ++i) {
+      if (results[cur + i] == kErrorCodeOk) {
+        ErrorCode code = pimpl.retrieve_general(
+          context,
+          locations[i],
+          payloads[cur + i],
+          &payload_capacities[cur + i]);
+        if (!is_key_specific_error(code)) {
+          return code;
+        }
+        results[cur + i] = code;
+      }
+    }
+    cur += chunk;
+  }
+  return kErrorCodeOk;
+}
+
+ErrorCode MasstreeStorage::get_record_normalized_batch(
+  thread::Thread* context,
+  uint16_t batch_size,
+  const KeySlice* keys,
+  void* const* payloads,
+  PayloadLength* payload_capacities,
+  ErrorCode* results,
+  bool read_only) {
+  MasstreeStoragePimpl pimpl(this);
+  RecordLocation locations[MasstreeStoragePimpl::kBatchMax];
+  for (uint16_t cur = 0; cur < batch_size;) {
+    uint16_t chunk = batch_size - cur;
+    if (chunk > MasstreeStoragePimpl::kBatchMax) {
+      chunk = MasstreeStoragePimpl::kBatchMax;
+    }
+    CHECK_ERROR_CODE(pimpl.locate_record_normalized_batch(
+      context,
+      chunk,
+      &keys[cur],
+      !read_only,
+      locations,
+      &results[cur]));
+    for (uint16_t i = 0; i < chunk; ++i) {
+      if (results[cur + i] == kErrorCodeOk) {
+        ErrorCode code = pimpl.retrieve_general(
+          context,
+          locations[i],
+          payloads[cur + i],
+          &payload_capacities[cur + i]);
+        if (!is_key_specific_error(code)) {
+          return code;
+        }
+        results[cur + i] = code;
+      }
+    }
+    cur += chunk;
+  }
+  return kErrorCodeOk;
+}
+
 ErrorCode MasstreeStorage::insert_record(
   thread::Thread* context,
   const void* key,
@@ -309,6 +399,52 @@ ErrorCode MasstreeStorage::insert_record_normalized(
     payload_count);
 }
 
+ErrorCode MasstreeStorage::insert_record_normalized_batch(
+  thread::Thread* context,
+  uint16_t batch_size,
+  const KeySlice* keys,
+  const void* const* payloads,
+  PayloadLength payload_count,
+  ErrorCode* results,
+  PayloadLength physical_payload_hint) {
+  if (UNLIKELY(payload_count > kMaxPayloadLength)) {
+    return kErrorCodeStrTooLongPayload;
+  }
+  physical_payload_hint = adjust_payload_hint(payload_count, physical_payload_hint);
+  MasstreeStoragePimpl pimpl(this);
+  RecordLocation locations[MasstreeStoragePimpl::kReserveBatchMax];
+  for (uint16_t cur = 0; cur < batch_size;) {
+    uint16_t chunk = batch_size - cur;
+    if (chunk > MasstreeStoragePimpl::kReserveBatchMax) {
+      chunk = MasstreeStoragePimpl::kReserveBatchMax;
+    }
+    CHECK_ERROR_CODE(pimpl.reserve_record_normalized_batch(
+      context,
+      chunk,
+      &keys[cur],
+      payload_count,
+      physical_payload_hint,
+      locations));
+    for (uint16_t i = 0; i < chunk; ++i) {
+      ASSERT_ND(locations[i].is_found());  // contract of reserve_record
+      uint64_t be_key = assorted::htobe<uint64_t>(keys[cur + i]);
+      ErrorCode code = pimpl.insert_general(
+        context,
+        locations[i],
+        &be_key,
+        sizeof(be_key),
+        payloads[cur + i],
+        payload_count);
+      if (!is_key_specific_error(code)) {
+        return code;
+      }
+      results[cur + i] = code;
+    }
+    cur += chunk;
+  }
+  return kErrorCodeOk;
+}
+
 ErrorCode MasstreeStorage::delete_record(
   thread::Thread* context,
   const void* key,
@@ -572,6 +708,101 @@ ErrorCode MasstreeStorage::increment_record_normalized(
     payload_offset);
 }
 
+ErrorCode MasstreeStorage::extend_record(
+  thread::Thread* context,
+  const void* key,
+  KeyLength key_length,
+  const void* payload,
+  PayloadLength payload_count,
+  PayloadLength physical_payload_hint) {
+  return MasstreeStoragePimpl(this).resize_general(
+    context,
+    key,
+    key_length,
+    true,
+    payload,
+    0,
+    payload_count,
+    physical_payload_hint);
+}
+
+ErrorCode MasstreeStorage::extend_record_normalized(
+  thread::Thread* context,
+  KeySlice key,
+  const void* payload,
+  PayloadLength payload_count,
+  PayloadLength physical_payload_hint) {
+  uint64_t be_key = assorted::htobe<uint64_t>(key);
+  return extend_record(
+    context,
+    &be_key,
+    sizeof(be_key),
+    payload,
+    payload_count,
+    physical_payload_hint);
+}
+
+ErrorCode MasstreeStorage::truncate_record(
+  thread::Thread* context,
+  const void* key,
+  KeyLength key_length,
+  PayloadLength payload_count) {
+  return MasstreeStoragePimpl(this).resize_general(
+    context,
+    key,
+    key_length,
+    false,
+    CXX11_NULLPTR,
+    payload_count,
+    0,
+    0);
+}
+
+ErrorCode MasstreeStorage::truncate_record_normalized(
+  thread::Thread* context,
+  KeySlice key,
+  PayloadLength payload_count) {
+  uint64_t be_key = assorted::htobe<uint64_t>(key);
+  return truncate_record(context, &be_key, sizeof(be_key), payload_count);
+}
+
+ErrorCode MasstreeStorage::replace_record(
+  thread::Thread* context,
+  const void* key,
+  KeyLength key_length,
+  const void* payload,
+  PayloadLength payload_count,
+  PayloadLength physical_payload_hint) {
+  if (UNLIKELY(payload_count > kMaxPayloadLength)) {
+    return kErrorCodeStrTooLongPayload;
+  }
+  return MasstreeStoragePimpl(this).resize_general(
+    context,
+    key,
+    key_length,
+    false,
+    payload,
+    0,
+    payload_count,
+    physical_payload_hint);
+}
+
+ErrorCode MasstreeStorage::replace_record_normalized(
+  thread::Thread* context,
+  KeySlice key,
+  const void* payload,
+  PayloadLength payload_count,
+  PayloadLength physical_payload_hint) {
+  uint64_t be_key = assorted::htobe<uint64_t>(key);
+  return replace_record(
+    context,
+    &be_key,
+    sizeof(be_key),
+    payload,
+    payload_count,
+    physical_payload_hint);
+}
+
 ErrorStack MasstreeStorage::verify_single_thread(thread::Thread* context) {
   return MasstreeStoragePimpl(this).verify_single_thread(context);
 }
@@ -609,6 +840,21 @@ ErrorStack MasstreeStorage::fatify_first_root(
   return impl.fatify_first_root(context, desired_count, disable_no_record_split);
 }
 
+ErrorStack MasstreeStorage::adopt_foster_twins(thread::Thread* context, uint32_t* adopted_count) {
+  MasstreeStoragePimpl impl(this);
+  return impl.adopt_foster_twins(context, adopted_count);
+}
+
+ErrorStack MasstreeStorage::bulk_load_normalized(
+  thread::Thread* context,
+  uint64_t count,
+  const KeySlice* keys,
+  const void* payloads,
+  PayloadLength payload_count) {
+  MasstreeStoragePimpl impl(this);
+  return impl.bulk_load_normalized(context, count, keys, payloads, payload_count);
+}
+
 SlotIndex MasstreeStorage::estimate_records_per_page(
   Layer layer,
   KeyLength key_length,
@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include "foedus/storage/masstree/masstree_storage_pimpl.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "foedus/assert_nd.hpp"
+#include "foedus/engine.hpp"
+#include "foedus/engine_options.hpp"
+#include "foedus/assorted/atomic_fences.hpp"
+#include "foedus/assorted/endianness.hpp"
+#include "foedus/debugging/stop_watch.hpp"
+#include "foedus/log/thread_log_buffer.hpp"
+#include "foedus/memory/engine_memory.hpp"
+#include "foedus/memory/numa_core_memory.hpp"
+#include "foedus/memory/numa_node_memory.hpp"
+#include "foedus/memory/page_pool.hpp"
+#include "foedus/storage/masstree/masstree_log_types.hpp"
+#include "foedus/thread/numa_thread_scope.hpp"
+#include "foedus/xct/in_commit_epoch_guard.hpp"
+#include "foedus/xct/xct.hpp"
+#include "foedus/xct/xct_manager.hpp"
+
+namespace foedus {
+namespace storage {
+namespace masstree {
+
+MasstreeBorderPage* MasstreeStoragePimpl::get_bulk_load_target(
+  thread::Thread* context,
+  MasstreeIntermediatePage* root) {
+  // Exactly the state load_empty() creates: one intermediate root with one empty border page.
+  if (get_first_root_pointer().snapshot_pointer_ != 0
+    || root->is_moved()
+    || root->get_btree_level() != 1U
+    || root->get_key_count() != 0
+    || root->get_minipage(0).key_count_ != 0) {
+    return nullptr;
+  }
+  const DualPagePointer& pointer = root->get_minipage(0).pointers_[0];
+  if (pointer.snapshot_pointer_ != 0 || pointer.volatile_pointer_.is_null()) {
+    return nullptr;
+  }
+  MasstreePage* child = reinterpret_cast<MasstreePage*>(
+    context->resolve(pointer.volatile_pointer_));
+  if (!child->is_border() || child->is_moved() || child->get_key_count() != 0) {
+    return nullptr;
+  }
+  return reinterpret_cast<MasstreeBorderPage*>(child);
+}
+
+void MasstreeStoragePimpl::fill_intermediate_bulk(
+  MasstreeIntermediatePage* page,
+  uint32_t child_count,
+  const KeySlice* child_low_fences,
+  const VolatilePagePointer* child_pointers) {
+  ASSERT_ND(child_count > 0);
+  ASSERT_ND(child_count <= kMaxIntermediatePointers);
+  const uint32_t kPointersPerMini = kMaxIntermediateMiniSeparators + 1U;
+  const uint32_t minipage_count = (child_count + kPointersPerMini - 1U) / kPointersPerMini;
+  ASSERT_ND(minipage_count <= kMaxIntermediateSeparators + 1U);
+  for (uint32_t m = 0; m < minipage_count; ++m) {
+    const uint32_t from = m * kPointersPerMini;
+    const uint32_t to = std::min<uint32_t>(from + kPointersPerMini, child_count);
+    if (m > 0) {
+      page->set_separator(m - 1U, child_low_fences[from]);
+    }
+    MasstreeIntermediatePage::MiniPage& minipage = page->get_minipage(m);
+    minipage.key_count_ = to - from - 1U;
+    for (uint32_t i = from; i < to; ++i) {
+      if (i > from) {
+        minipage.separators_[i - from - 1U] = child_low_fences[i];
+      }
+      minipage.pointers_[i - from].snapshot_pointer_ = 0;
+      minipage.pointers_[i - from].volatile_pointer_ = child_pointers[i];
+    }
+  }
+  page->set_key_count(minipage_count - 1U);
+}
+
+void MasstreeStoragePimpl::publish_bulk_load_logs(
+  thread::Thread* context,
+  MasstreeBorderPage* page) {
+  // Each page is published like one committed transaction that inserted its records.
+  // Like a transaction, we write logs first. Reserving log space might wait for loggers,
+  // which must not happen while we announce an in-commit epoch.
+  log::ThreadLogBuffer& log_buffer = context->get_thread_log_buffer();
+  const SlotIndex key_count = page->get_key_count();
+  MasstreeInsertLogType* log_entries[kBorderPageMaxSlots];
+  for (SlotIndex i = 0; i < key_count; ++i) {
+    const PayloadLength payload_count = page->get_payload_length(i);
+    const uint16_t log_length
+      = MasstreeInsertLogType::calculate_log_length(sizeof(KeySlice), payload_count);
+    uint64_t be_key = assorted::htobe<uint64_t>(page->get_slice(i));
+    log_entries[i] = reinterpret_cast<MasstreeInsertLogType*>(
+      log_buffer.reserve_new_log(log_length));
+    log_entries[i]->populate(
+      get_id(),
+      &be_key,
+      sizeof(be_key),
+      page->get_record_payload(i),
+      payload_count);
+  }
+
+  // Then, same as precommit_xct_readwrite().
+  xct::XctManager* xct_manager = engine_->get_xct_manager();
+  Epoch conservative_epoch = xct_manager->get_current_global_epoch_weak();
+  xct::InCommitEpochGuard guard(context->get_in_commit_epoch_address(), conservative_epoch);
+  assorted::memory_fence_acq_rel();
+  Epoch commit_epoch = xct_manager->get_current_global_epoch_weak();
+
+  xct::XctId max_xct_id;
+  max_xct_id.set(Epoch::kEpochInitialDurable, 1);
+  xct::Xct& current_xct = context->get_current_xct();
+  current_xct.issue_next_id(max_xct_id, &commit_epoch);
+  xct::XctId new_xct_id = current_xct.get_id();
+  new_xct_id.clear_status_bits();
+  for (SlotIndex i = 0; i < key_count; ++i) {
+    page->get_owner_id(i)->xct_id_ = new_xct_id;
+    log_entries[i]->header_.set_xct_id(new_xct_id);
+  }
+
+  assorted::memory_fence_release();
+  if (engine_->get_options().log_.emulation_.null_device_) {
+    log_buffer.discard_current_xct_log();
+  } else {
+    log_buffer.publish_committed_log(commit_epoch);
+  }
+}
+
+ErrorStack MasstreeStoragePimpl::bulk_load_sort(
+  uint64_t count,
+  const KeySlice* keys,
+  std::vector<uint64_t>* order) {
+  // Most callers give sorted keys. In that case we don't need the permutation at all.
+  bool sorted = true;
+  for (uint64_t i = 1; i < count; ++i) {
+    if (keys[i - 1U] >= keys[i]) {
+      sorted = false;
+      break;
+    }
+  }
+  if (sorted) {
+    order->clear();
+    return kRetOk;
+  }
+
+  // Each NUMA node sorts one run of the permutation, then we merge the runs pairwise.
+  const uint16_t nodes = engine_->get_soc_count();
+  order->resize(count);
+  for (uint64_t i = 0; i < count; ++i) {
+    (*order)[i] = i;
+  }
+  auto key_less = [keys](uint64_t left, uint64_t right) { return keys[left] < keys[right]; };
+  std::vector<uint64_t> run_begins(nodes + 1U);
+  for (uint16_t node = 0; node <= nodes; ++node) {
+    run_begins[node] = count * node / nodes;
+  }
+  uint64_t* base = &(*order)[0];
+  std::vector< std::thread > threads;
+  for (uint16_t node = 0; node < nodes; ++node) {
+    threads.emplace_back([node, base, &run_begins, &key_less]() {
+      thread::NumaThreadScope scope(node);
+      std::sort(base + run_begins[node], base + run_begins[node + 1U], key_less);
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  for (uint16_t width = 1; width < nodes; width *= 2U) {
+    for (uint16_t node = 0; node + width < nodes; node += width * 2U) {
+      const uint16_t last = std::min<uint16_t>(node + width * 2U, nodes);
+      std::inplace_merge(
+        base + run_begins[node],
+        base + run_begins[node + width],
+        base + run_begins[last],
+        key_less);
+    }
+  }
+
+  for (uint64_t i = 1; i < count; ++i) {
+    if (keys[base[i - 1U]] == keys[base[i]]) {
+      LOG(ERROR) << "Masstree-" << get_name() << ": bulk-loaded keys must be unique."
+        << " keys[" << base[i - 1U] << "]=keys[" << base[i] << "]=" << keys[base[i]];
+      return ERROR_STACK(kErrorCodeInvalidParameter);
+    }
+  }
+  return kRetOk;
+}
+
+ErrorStack MasstreeStoragePimpl::bulk_load_normalized(
+  thread::Thread* context,
+  uint64_t count,
+  const KeySlice* keys,
+  const void* payloads,
+  PayloadLength payload_count) {
+  if (context->is_running_xct()) {
+    return ERROR_STACK(kErrorCodeXctAlreadyRunning);
+  } else if (payload_count > kMaxPayloadLength) {
+    return ERROR_STACK(kErrorCodeStrTooLongPayload);
+  } else if (count == 0) {
+    return kRetOk;
+  }
+
+  MasstreeIntermediatePage* root;
+  WRAP_ERROR_CODE(get_first_root(context, true, &root));
+  MasstreeBorderPage* old_child = get_bulk_load_target(context, root);
+  if (old_child == nullptr) {
+    LOG(ERROR) << "Masstree-" << get_name() << " is not empty. Bulk-loading requires an empty"
+      << " volatile tree without snapshot";
+    return ERROR_STACK(kErrorCodeStrMasstreeNotEmpty);
+  }
+
+  LOG(INFO) << "Masstree-" << get_name() << " being bulk-loaded with " << count << " records";
+  debugging::StopWatch watch;
+
+  // order[i] is the index of the i-th smallest key, or empty if keys are already sorted.
+  std::vector<uint64_t> order;
+  CHECK_ERROR(bulk_load_sort(count, keys, &order));
+  const uint64_t* sorted = order.empty() ? nullptr : &order[0];
+
+  // All records are of the same size, so every border page except the last one receives
+  // exactly this many records. No space is left for future inserts, as in a snapshot page.
+  const SlotIndex records_per_page
+    = MasstreeStorage::estimate_records_per_page(0, sizeof(KeySlice), payload_count);
+  ASSERT_ND(records_per_page > 0);
+  const uint64_t border_count = (count + records_per_page - 1U) / records_per_page;
+
+  // Border pages are range-partitioned to NUMA nodes, and each node builds its own range on
+  // its own memory. Intermediate pages come from this thread's NUMA node.
+  const uint16_t nodes = engine_->get_soc_count();
+  std::vector<uint64_t> node_begins(nodes + 1U);
+  for (uint16_t node = 0; node <= nodes; ++node) {
+    node_begins[node] = border_count * node / nodes;
+  }
+  uint64_t page_count = border_count;
+  for (uint64_t level_count = border_count; level_count > kMaxIntermediatePointers;) {
+    level_count = (level_count + kMaxIntermediatePointers - 1U) / kMaxIntermediatePointers;
+    page_count += level_count;
+  }
+
+  // Grab all pages beforehand, so that we can give up without leaving anything on failure.
+  std::vector<VolatilePagePointer> new_pages;
+  new_pages.reserve(page_count);
+  ErrorCode grab_result = kErrorCodeOk;
+  memory::EngineMemory* engine_memory = engine_->get_memory_manager();
+  memory::PagePoolOffsetChunk chunk;
+  for (uint16_t node = 0; node < nodes && grab_result == kErrorCodeOk; ++node) {
+    memory::PagePool* pool = engine_memory->get_node_memory(node)->get_volatile_pool();
+    for (uint64_t p = node_begins[node]; p < node_begins[node + 1U];) {
+      const uint64_t remaining = node_begins[node + 1U] - p;
+      chunk.clear();
+      grab_result = pool->grab(std::min<uint64_t>(remaining, chunk.capacity()), &chunk);
+      if (grab_result != kErrorCodeOk) {
+        break;
+      }
+      for (; !chunk.empty(); ++p) {
+        VolatilePagePointer pointer;
+        pointer.set(node, chunk.pop_back());
+        new_pages.push_back(pointer);
+      }
+    }
+  }
+  memory::NumaCoreMemory* memory = context->get_thread_memory();
+  while (grab_result == kErrorCodeOk && new_pages.size() < page_count) {
+    VolatilePagePointer pointer = memory->grab_free_volatile_page_pointer();
+    if (pointer.is_null()) {
+      grab_result = kErrorCodeMemoryNoFreePages;
+      break;
+    }
+    new_pages.push_back(pointer);
+  }
+  if (grab_result != kErrorCodeOk) {
+    memory::PageReleaseBatch release_batch(engine_);
+    for (const VolatilePagePointer& grabbed : new_pages) {
+      release_batch.release(grabbed);
+    }
+    release_batch.release_all();
+    return ERROR_STACK(grab_result);
+  }
+  ASSERT_ND(new_pages.size() == page_count);
+
+  // Border pages, each node in parallel.
+  std::vector<KeySlice> low_fences(border_count);
+  const StorageId storage_id = get_id();
+  const char* payload_bytes = reinterpret_cast<const char*>(payloads);
+  const memory::GlobalVolatilePageResolver& resolver
+    = engine_memory->get_global_volatile_page_resolver();
+  std::vector< std::thread > threads;
+  for (uint16_t node = 0; node < nodes; ++node) {
+    threads.emplace_back([&, node]() {
+      thread::NumaThreadScope scope(node);
+      for (uint64_t p = node_begins[node]; p < node_begins[node + 1U]; ++p) {
+        const uint64_t from = p * records_per_page;
+        const uint64_t to = std::min<uint64_t>(from + records_per_page, count);
+        low_fences[p] = p == 0 ? kInfimumSlice : keys[sorted ? sorted[from] : from];
+        const KeySlice high_fence = to == count ? kSupremumSlice : keys[sorted ? sorted[to] : to];
+        MasstreeBorderPage* page = reinterpret_cast<MasstreeBorderPage*>(
+          resolver.resolve_offset_newpage(new_pages[p]));
+        page->initialize_volatile_page(storage_id, new_pages[p], 0, low_fences[p], high_fence);
+        for (uint64_t i = from; i < to; ++i) {
+          const uint64_t index = sorted ? sorted[i] : i;
+          page->append_record_bulk(
+            xct::XctId(),
+            keys[index],
+            payload_bytes + index * payload_count,
+            payload_count);
+        }
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  // Logs must go through this thread's log buffer, so we publish them here.
+  // The pages are not reachable yet, so no one sees them before their XctIds are stamped.
+  for (uint64_t p = 0; p < border_count; ++p) {
+    publish_bulk_load_logs(
+      context,
+      reinterpret_cast<MasstreeBorderPage*>(context->resolve_newpage(new_pages[p])));
+  }
+
+  // Intermediate pages, bottom-up, until the children fit in the first root.
+  uint64_t next_page = border_count;
+  uint64_t level_begin = 0;
+  uint64_t level_count = border_count;
+  uint8_t level = 0;
+  while (level_count > kMaxIntermediatePointers) {
+    const uint64_t parent_count
+      = (level_count + kMaxIntermediatePointers - 1U) / kMaxIntermediatePointers;
+    std::vector<KeySlice> parent_low_fences(parent_count);
+    for (uint64_t p = 0; p < parent_count; ++p) {
+      // Distribute children evenly rather than leaving a tiny page at the end.
+      const uint64_t from = level_count * p / parent_count;
+      const uint64_t to = level_count * (p + 1U) / parent_count;
+      parent_low_fences[p] = low_fences[from];
+      const KeySlice high_fence = to == level_count ? kSupremumSlice : low_fences[to];
+      const VolatilePagePointer pointer = new_pages[next_page + p];
+      MasstreeIntermediatePage* page = reinterpret_cast<MasstreeIntermediatePage*>(
+        context->resolve_newpage(pointer));
+      page->initialize_volatile_page(
+        get_id(),
+        pointer,
+        0,
+        level + 1U,
+        parent_low_fences[p],
+        high_fence);
+      fill_intermediate_bulk(
+        page,
+        to - from,
+        &low_fences[from],
+        &new_pages[level_begin + from]);
+    }
+    low_fences.swap(parent_low_fences);
+    level_begin = next_page;
+    next_page += parent_count;
+    level_count = parent_count;
+    ++level;
+  }
+  ASSERT_ND(next_page == page_count);
+
+  // Finally, re-initialize the first root in place. The root pointer itself never changes.
+  assorted::memory_fence_release();
+  const VolatilePagePointer root_pointer = root->get_volatile_page_id();
+  const VolatilePagePointer old_child_pointer = old_child->get_volatile_page_id();
+  root->initialize_volatile_page(
+    get_id(),
+    root_pointer,
+    0,
+    level + 1U,
+    kInfimumSlice,
+    kSupremumSlice);
+  fill_intermediate_bulk(root, level_count, &low_fences[0], &new_pages[level_begin]);
+  assorted::memory_fence_release();
+  // Same as GrowFirstLayerRoot. The old empty child is not moved, but no longer reachable.
+  old_child->get_version_address()->status_.status_ |= PageVersionStatus::kRetiredBit;
+  context->collect_retired_volatile_page(old_child_pointer);
+
+  watch.stop();
+  LOG(INFO) << "Masstree-" << get_name() << " bulk-loaded " << count << " records in "
+    << border_count << " border pages and " << (page_count - border_count + 1U)
+    << " intermediate pages. " << watch.elapsed_ms() << "ms";
+  return kRetOk;
+}
+
+}  // namespace masstree
+}  // namespace storage
+}  // namespace foedus
@@ -179,6 +179,118 @@ ErrorStack MasstreeStoragePimpl::fatify_first_root_double(
 
   return kRetOk;
 }
+
+ErrorStack MasstreeStoragePimpl::adopt_foster_twins(
+  thread::Thread* context,
+  uint32_t* adopted_count) {
+  *adopted_count = 0;
+  debugging::StopWatch watch;
+  watch.start();
+  MasstreeIntermediatePage* root;
+  WRAP_ERROR_CODE(get_first_root(context, true, &root));
+  WRAP_ERROR_CODE(adopt_foster_twins_recurse(context, root, adopted_count));
+  watch.stop();
+  VLOG(0) << "Masstree-" << get_name() << " adopted " << *adopted_count << " pages in "
+    << watch.elapsed_us() << "us";
+  return kRetOk;
+}
+
+ErrorCode MasstreeStoragePimpl::adopt_foster_twins_recurse(
+  thread::Thread* context,
+  MasstreePage* page,
+  uint32_t* adopted_count) {
+  ASSERT_ND(!page->header().snapshot_);
+  // Like other physical-only methods, this reads pages without locks. If a concurrent thread
+  // changes the page, we might miss some children, which is fine because this is just
+  // an opportunistic maintenance. The sysxcts take locks and re-check everything.
+  if (page->is_moved()) {
+    // Nothing to adopt here. Its parent adopts it. Let's take care of the foster twins.
+    MasstreePage* minor = context->resolve_cast<MasstreePage>(page->get_foster_minor());
+    MasstreePage* major = context->resolve_cast<MasstreePage>(page->get_foster_major());
+    CHECK_ERROR_CODE(adopt_foster_twins_recurse(context, minor, adopted_count));
+    CHECK_ERROR_CODE(adopt_foster_twins_recurse(context, major, adopted_count));
+    return kErrorCodeOk;
+  }
+
+  if (page->is_border()) {
+    // Border pages have nothing to adopt, but their next layers might.
+    MasstreeBorderPage* border = reinterpret_cast<MasstreeBorderPage*>(page);
+    const SlotIndex key_count = border->get_key_count();
+    assorted::memory_fence_acquire();
+    for (SlotIndex i = 0; i < key_count; ++i) {
+      if (!border->does_point_to_layer(i)) {
+        continue;
+      }
+      const VolatilePagePointer pointer = border->get_next_layer(i)->volatile_pointer_;
+      if (!pointer.is_null()) {
+        MasstreePage* next_root = context->resolve_cast<MasstreePage>(pointer);
+        CHECK_ERROR_CODE(adopt_foster_twins_recurse(context, next_root, adopted_count));
+      }
+    }
+    return kErrorCodeOk;
+  }
+
+  // First, adopt moved children of this page in batches.
+  MasstreeIntermediatePage* parent = reinterpret_cast<MasstreeIntermediatePage*>(page);
+  MasstreePage* olds[AdoptBatch::kMaxBatch];
+  uint16_t old_count = 0;
+  for (uint16_t i = 0; i <= parent->get_key_count(); ++i) {
+    const MasstreeIntermediatePage::MiniPage& minipage = parent->get_minipage(i);
+    for (uint16_t j = 0; j <= minipage.key_count_; ++j) {
+      const VolatilePagePointer pointer = minipage.pointers_[j].volatile_pointer_;
+      if (pointer.is_null()) {
+        continue;
+      }
+      MasstreePage* child = context->resolve_cast<MasstreePage>(pointer);
+      if (child->is_moved() && !child->is_retired()) {
+        olds[old_count] = child;
+        ++old_count;
+        if (old_count == AdoptBatch::kMaxBatch) {
+          CHECK_ERROR_CODE(adopt_foster_twins_flush(
+            context,
+            parent,
+            olds,
+            &old_count,
+            adopted_count));
+        }
+      }
+    }
+  }
+  CHECK_ERROR_CODE(adopt_foster_twins_flush(context, parent, olds, &old_count, adopted_count));
+
+  // Then, recurse. If an adoption split this page, recursing into the foster twins instead.
+  if (parent->is_moved()) {
+    return adopt_foster_twins_recurse(context, parent, adopted_count);
+  }
+  for (uint16_t i = 0; i <= parent->get_key_count(); ++i) {
+    const MasstreeIntermediatePage::MiniPage& minipage = parent->get_minipage(i);
+    for (uint16_t j = 0; j <= minipage.key_count_; ++j) {
+      const VolatilePagePointer pointer = minipage.pointers_[j].volatile_pointer_;
+      if (!pointer.is_null()) {
+        MasstreePage* child = context->resolve_cast<MasstreePage>(pointer);
+        CHECK_ERROR_CODE(adopt_foster_twins_recurse(context, child, adopted_count));
+      }
+    }
+  }
+  return kErrorCodeOk;
+}
+
+ErrorCode MasstreeStoragePimpl::adopt_foster_twins_flush(
+  thread::Thread* context,
+  MasstreeIntermediatePage* parent,
+  MasstreePage** olds,
+  uint16_t* old_count,
+  uint32_t* adopted_count) {
+  if (*old_count == 0 || parent->is_moved()) {
+    *old_count = 0;
+    return kErrorCodeOk;
+  }
+  AdoptBatch adopt(context, parent, olds, *old_count);
+  CHECK_ERROR_CODE(context->run_nested_sysxct(&adopt, 2U));
+  *adopted_count += adopt.out_adopted_count_;
+  *old_count = 0;
+  return kErrorCodeOk;
+}
 }  // namespace masstree
 }  // namespace storage
 }  // namespace foedus
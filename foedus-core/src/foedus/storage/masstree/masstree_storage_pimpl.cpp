@@ -210,6 +210,87 @@ ErrorStack MasstreeStoragePimpl::load(const StorageControlBlock& snapshot_block)
 ///  Record-wise or page-wise operations
 ///
 /////////////////////////////////////////////////////////////////////////////
+inline bool MasstreeStoragePimpl::is_border_reached(const MasstreePage* page) {
+  return page->is_border() && LIKELY(!page->has_foster_child());
+}
+
+inline ErrorCode MasstreeStoragePimpl::add_key_to_range_set(
+  xct::Xct* cur_xct,
+  const MasstreeBorderPage* border,
+  PageVersionStatus observed,
+  SlotIndex observed_key_count,
+  KeySlice slice) {
+  if (border->header().snapshot_) {
+    return kErrorCodeOk;  // snapshot pages are immutable
+  }
+  return cur_xct->add_to_range_set(
+    border->header().storage_id_,
+    border->get_version_address(),
+    observed,
+    observed_key_count,
+    slice,
+    slice);
+}
+
+inline ErrorCode MasstreeStoragePimpl::find_border_physical_step(
+  thread::Thread* context,
+  bool      for_writes,
+  KeySlice  slice,
+  MasstreePage** page) {
+  MasstreePage* cur = *page;
+  ASSERT_ND(!is_border_reached(cur));
+  if (cur->is_border()) {
+    // We follow foster-twins only in border pages.
+    // In intermediate pages, Master-Tree invariant tells us that we don't have to.
+    // Furthermore, if we do, we need to handle the case of empty-range intermediate pages.
+    // Rather we just do this only in border pages.
+    ASSERT_ND(cur->has_foster_child());
+    // follow one of foster-twin.
+    if (cur->within_foster_minor(slice)) {
+      cur = reinterpret_cast<MasstreePage*>(context->resolve(cur->get_foster_minor()));
+    } else {
+      cur = reinterpret_cast<MasstreePage*>(context->resolve(cur->get_foster_major()));
+    }
+    ASSERT_ND(cur->within_fences(slice));
+    *page = cur;
+    return kErrorCodeOk;
+  }
+
+  MasstreeIntermediatePage* parent = reinterpret_cast<MasstreeIntermediatePage*>(cur);
+  uint8_t minipage_index = parent->find_minipage(slice);
+  MasstreeIntermediatePage::MiniPage& minipage = parent->get_minipage(minipage_index);
+
+  minipage.prefetch();
+  uint8_t pointer_index = minipage.find_pointer(slice);
+  DualPagePointer& pointer = minipage.pointers_[pointer_index];
+  MasstreePage* next;
+  CHECK_ERROR_CODE(follow_page(context, for_writes, &pointer, &next));
+  next->prefetch_general();
+  if (LIKELY(next->within_fences(slice))) {
+    if (next->has_foster_child() && !cur->is_moved()) {
+      // oh, the page has foster child, so we should adopt it.
+      // Whether Adopt actually adopted it or not,
+      // we follow the "old" next page. Master-Tree invariant guarantees that it's safe.
+      // This is beneficial when we lazily give up adoption in the method, eg other threads
+      // holding locks in the intermediate page.
+      if (!next->is_locked() && !cur->is_locked()) {
+        // Let's try adopting. No need to try many times. Adopt can be delayed
+        Adopt functor(context, parent, next);
+        CHECK_ERROR_CODE(context->run_nested_sysxct(&functor, 2));
+      } else {
+        // We don't have to adopt it right away. Do it when it's not contended
+        DVLOG(1) << "Someone else seems doing something there.. already adopting? skip it";
+      }
+    }
+    *page = next;
+  } else {
+    // even in this case, local retry suffices thanks to foster-twin
+    DVLOG(0) << "Interesting. concurrent thread affected the search. local retry";
+    assorted::memory_fence_acquire();
+  }
+  return kErrorCodeOk;
+}
+
 inline ErrorCode MasstreeStoragePimpl::find_border_physical(
   thread::Thread* context,
   MasstreePage* layer_root,
@@ -226,57 +307,11 @@ inline ErrorCode MasstreeStoragePimpl::find_border_physical(
     assert_aligned_page(cur);
     ASSERT_ND(cur->get_layer() == current_layer);
     ASSERT_ND(cur->within_fences(slice));
-    if (cur->is_border()) {
-      // We follow foster-twins only in border pages.
-      // In intermediate pages, Master-Tree invariant tells us that we don't have to.
-      // Furthermore, if we do, we need to handle the case of empty-range intermediate pages.
-      // Rather we just do this only in border pages.
-      if (UNLIKELY(cur->has_foster_child())) {
-        // follow one of foster-twin.
-        if (cur->within_foster_minor(slice)) {
-          cur = reinterpret_cast<MasstreePage*>(context->resolve(cur->get_foster_minor()));
-        } else {
-          cur = reinterpret_cast<MasstreePage*>(context->resolve(cur->get_foster_major()));
-        }
-        ASSERT_ND(cur->within_fences(slice));
-        continue;
-      }
+    if (is_border_reached(cur)) {
       *border = reinterpret_cast<MasstreeBorderPage*>(cur);
       return kErrorCodeOk;
-    } else {
-      MasstreeIntermediatePage* page = reinterpret_cast<MasstreeIntermediatePage*>(cur);
-      uint8_t minipage_index = page->find_minipage(slice);
-      MasstreeIntermediatePage::MiniPage& minipage = page->get_minipage(minipage_index);
-
-      minipage.prefetch();
-      uint8_t pointer_index = minipage.find_pointer(slice);
-      DualPagePointer& pointer = minipage.pointers_[pointer_index];
-      MasstreePage* next;
-      CHECK_ERROR_CODE(follow_page(context, for_writes, &pointer, &next));
-      next->prefetch_general();
-      if (LIKELY(next->within_fences(slice))) {
-        if (next->has_foster_child() && !cur->is_moved()) {
-          // oh, the page has foster child, so we should adopt it.
-          // Whether Adopt actually adopted it or not,
-          // we follow the "old" next page. Master-Tree invariant guarantees that it's safe.
-          // This is beneficial when we lazily give up adoption in the method, eg other threads
-          // holding locks in the intermediate page.
-          if (!next->is_locked() && !cur->is_locked()) {
-            // Let's try adopting. No need to try many times. Adopt can be delayed
-            Adopt functor(context, page, next);
-            CHECK_ERROR_CODE(context->run_nested_sysxct(&functor, 2));
-          } else {
-            // We don't have to adopt it right away. Do it when it's not contended
-            DVLOG(1) << "Someone else seems doing something there.. already adopting? skip it";
-          }
-        }
-        cur = next;
-      } else {
-        // even in this case, local retry suffices thanks to foster-twin
-        DVLOG(0) << "Interesting. concurrent thread affected the search. local retry";
-        assorted::memory_fence_acquire();
-      }
     }
+    CHECK_ERROR_CODE(find_border_physical_step(context, for_writes, slice, &cur));
   }
 }
 
@@ -309,17 +344,14 @@ ErrorCode MasstreeStoragePimpl::locate_record(
       &border));
     PageVersionStatus border_version = border->get_version().status_;
     assorted::memory_fence_consume();
+    // find_key() sees at least this many records. New records after it are checked at precommit.
+    const SlotIndex key_count = border->get_key_count();
+    assorted::memory_fence_consume();
     SlotIndex index = border->find_key(slice, suffix, remainder_length);
 
     if (index == kBorderPageMaxSlots) {
-      // this means not found. add it to page version set to protect the lack of record
-      if (!border->header().snapshot_) {
-        CHECK_ERROR_CODE(cur_xct->add_to_page_version_set(
-          border->get_version_address(),
-          border_version));
-      }
-      // So far we just use page-version set to protect this non-existence.
-      // TASK(Hideaki) range lock rather than page-set to improve concurrency?
+      // this means not found. add it to range set to protect the lack of record
+      CHECK_ERROR_CODE(add_key_to_range_set(cur_xct, border, border_version, key_count, slice));
       result->clear();
       return kErrorCodeStrKeyNotFound;
     }
@@ -345,16 +377,14 @@ ErrorCode MasstreeStoragePimpl::locate_record_normalized(
   MasstreeIntermediatePage* layer_root;
   CHECK_ERROR_CODE(get_first_root(context, for_writes, &layer_root));
   CHECK_ERROR_CODE(find_border_physical(context, layer_root, 0, for_writes, key, &border));
-  SlotIndex index = border->find_key_normalized(0, border->get_key_count(), key);
   PageVersionStatus border_version = border->get_version().status_;
+  assorted::memory_fence_consume();
+  const SlotIndex key_count = border->get_key_count();
+  assorted::memory_fence_consume();
+  SlotIndex index = border->find_key_normalized(0, key_count, key);
   if (index == kBorderPageMaxSlots) {
     // this means not found
-    if (!border->header().snapshot_) {
-      CHECK_ERROR_CODE(cur_xct->add_to_page_version_set(
-        border->get_version_address(),
-        border_version));
-    }
-    // TASK(Hideaki) range lock
+    CHECK_ERROR_CODE(add_key_to_range_set(cur_xct, border, border_version, key_count, key));
     result->clear();
     return kErrorCodeStrKeyNotFound;
   }
@@ -409,6 +439,128 @@ inline ErrorCode MasstreeStoragePimpl::follow_layer(
   return kErrorCodeOk;
 }
 
+ErrorCode MasstreeStoragePimpl::locate_record_batch(
+  thread::Thread* context,
+  uint16_t batch_size,
+  const void* const* keys,
+  const KeyLength* key_lengths,
+  bool for_writes,
+  RecordLocation* results,
+  ErrorCode* result_codes) {
+  ASSERT_ND(batch_size <= kBatchMax);
+  xct::Xct* cur_xct = &context->get_current_xct();
+  MasstreeIntermediatePage* first_root;
+  CHECK_ERROR_CODE(get_first_root(context, for_writes, &first_root));
+
+  // AMAC-style group lookup. Each key advances by at most one page per round, and the page
+  // it moved to is prefetched (find_border_physical_step()/follow_layer() do it).
+  // By the time we come back to the key in the next round, the page is hopefully in cache.
+  MasstreePage* cur[kBatchMax];
+  uint8_t layers[kBatchMax];
+  uint16_t remaining = batch_size;
+  for (uint16_t i = 0; i < batch_size; ++i) {
+    ASSERT_ND(key_lengths[i] <= kMaxKeyLength);
+    results[i].clear();
+    result_codes[i] = kErrorCodeOk;
+    cur[i] = first_root;
+    layers[i] = 0;
+  }
+  while (remaining > 0) {
+    for (uint16_t i = 0; i < batch_size; ++i) {
+      if (cur[i] == nullptr) {
+        continue;  // already done
+      }
+      const uint8_t layer = layers[i];
+      const KeySlice slice = slice_layer(keys[i], key_lengths[i], layer);
+      if (!is_border_reached(cur[i])) {
+        CHECK_ERROR_CODE(find_border_physical_step(context, for_writes, slice, cur + i));
+        continue;
+      }
+
+      MasstreeBorderPage* border = reinterpret_cast<MasstreeBorderPage*>(cur[i]);
+      const KeyLength remainder_length = key_lengths[i] - layer * 8;
+      const void* suffix = reinterpret_cast<const char*>(keys[i]) + (layer + 1) * 8;
+      PageVersionStatus border_version = border->get_version().status_;
+      assorted::memory_fence_consume();
+      const SlotIndex key_count = border->get_key_count();
+      assorted::memory_fence_consume();
+      SlotIndex index = border->find_key(slice, suffix, remainder_length);
+      if (index != kBorderPageMaxSlots && border->does_point_to_layer(index)) {
+        CHECK_ERROR_CODE(follow_layer(context, for_writes, border, index, cur + i));
+        cur[i]->prefetch_general();
+        ++layers[i];
+        continue;
+      }
+
+      if (index == kBorderPageMaxSlots) {
+        // same as locate_record(). range set protects the lack of record
+        CHECK_ERROR_CODE(add_key_to_range_set(cur_xct, border, border_version, key_count, slice));
+        result_codes[i] = kErrorCodeStrKeyNotFound;
+      } else {
+        CHECK_ERROR_CODE(results[i].populate_logical(cur_xct, border, index, for_writes));
+      }
+      cur[i] = nullptr;
+      --remaining;
+    }
+  }
+  return kErrorCodeOk;
+}
+
+ErrorCode MasstreeStoragePimpl::locate_record_normalized_batch(
+  thread::Thread* context,
+  uint16_t batch_size,
+  const KeySlice* keys,
+  bool for_writes,
+  RecordLocation* results,
+  ErrorCode* result_codes) {
+  ASSERT_ND(batch_size <= kBatchMax);
+  xct::Xct* cur_xct = &context->get_current_xct();
+  MasstreeIntermediatePage* root;
+  CHECK_ERROR_CODE(get_first_root(context, for_writes, &root));
+
+  // Same as locate_record_batch(), but we never go to second layer
+  MasstreePage* cur[kBatchMax];
+  uint16_t remaining = batch_size;
+  for (uint16_t i = 0; i < batch_size; ++i) {
+    results[i].clear();
+    result_codes[i] = kErrorCodeOk;
+    cur[i] = root;
+  }
+  while (remaining > 0) {
+    for (uint16_t i = 0; i < batch_size; ++i) {
+      if (cur[i] == nullptr) {
+        continue;
+      }
+      if (!is_border_reached(cur[i])) {
+        CHECK_ERROR_CODE(find_border_physical_step(context, for_writes, keys[i], cur + i));
+        continue;
+      }
+
+      MasstreeBorderPage* border = reinterpret_cast<MasstreeBorderPage*>(cur[i]);
+      PageVersionStatus border_version = border->get_version().status_;
+      assorted::memory_fence_consume();
+      const SlotIndex key_count = border->get_key_count();
+      assorted::memory_fence_consume();
+      SlotIndex index = border->find_key_normalized(0, key_count, keys[i]);
+      if (index == kBorderPageMaxSlots) {
+        CHECK_ERROR_CODE(add_key_to_range_set(
+          cur_xct,
+          border,
+          border_version,
+          key_count,
+          keys[i]));
+        result_codes[i] = kErrorCodeStrKeyNotFound;
+      } else {
+        ASSERT_ND(!border->does_point_to_layer(index));
+        CHECK_ERROR_CODE(results[i].populate_logical(cur_xct, border, index, for_writes));
+      }
+      cur[i] = nullptr;
+      --remaining;
+    }
+  }
+  return kErrorCodeOk;
+}
+
 ErrorCode MasstreeStoragePimpl::reserve_record(
   thread::Thread* context,
   const void* key,
@@ -586,6 +738,71 @@ ErrorCode MasstreeStoragePimpl::reserve_record_normalized(
   }
 }
 
+ErrorCode MasstreeStoragePimpl::reserve_record_normalized_batch(
+  thread::Thread* context,
+  uint16_t batch_size,
+  const KeySlice* keys,
+  PayloadLength payload_count,
+  PayloadLength physical_payload_hint,
+  RecordLocation* results) {
+  ASSERT_ND(batch_size <= kReserveBatchMax);
+  xct::Xct* cur_xct = &context->get_current_xct();
+  for (uint16_t cur = 0; cur < batch_size;) {
+    MasstreeIntermediatePage* layer_root;
+    CHECK_ERROR_CODE(get_first_root(context, true, &layer_root));
+    MasstreeBorderPage* border;
+    CHECK_ERROR_CODE(find_border_physical(context, layer_root, 0, true, keys[cur], &border));
+    while (border->has_foster_child()) {
+      if (border->within_foster_minor(keys[cur])) {
+        border = context->resolve_cast<MasstreeBorderPage>(border->get_foster_minor());
+      } else {
+        border = context->resolve_cast<MasstreeBorderPage>(border->get_foster_major());
+      }
+    }
+
+    ReserveRecordsBatch reserve(
+      context,
+      border,
+      keys + cur,
+      batch_size - cur,
+      physical_payload_hint);  // let's allocate conservatively, as reserve_record() does
+    CHECK_ERROR_CODE(context->run_nested_sysxct(&reserve, 2U));
+    const uint16_t reserved = reserve.out_reserved_count_;
+    if (reserved == 0) {
+      // The first key needs something complex. Let the usual path handle it.
+      CHECK_ERROR_CODE(reserve_record_normalized(
+        context,
+        keys[cur],
+        payload_count,
+        physical_payload_hint,
+        results + cur));
+      ++cur;
+      continue;
+    }
+
+    // The keys are now physically in the page, and keys in border pages are immutable.
+    // Finalize the XIDs as reserve_record_normalized() does.
+    const SlotIndex count = border->get_key_count();
+    assorted::memory_fence_acquire();
+    for (uint16_t i = cur; i < cur + reserved; ++i) {
+      const SlotIndex index = border->find_key_normalized(0, count, keys[i]);
+      ASSERT_ND(index != kBorderPageMaxSlots);
+      CHECK_ERROR_CODE(results[i].populate_logical(cur_xct, border, index, true));
+      if (results[i].observed_.is_moved()) {
+        VLOG(0) << "Interesting. Moved by concurrent transaction";
+        CHECK_ERROR_CODE(reserve_record_normalized(
+          context,
+          keys[i],
+          payload_count,
+          physical_payload_hint,
+          results + i));
+      }
+    }
+    cur += reserved;
+  }
+  return kErrorCodeOk;
+}
+
 inline ErrorCode MasstreeStoragePimpl::check_next_layer_bit(xct::XctId observed) {
   if (UNLIKELY(observed.is_next_layer())) {
     // this should have been checked before this method and resolved as abort or retry,
@@ -838,6 +1055,93 @@ ErrorCode MasstreeStoragePimpl::increment_general(
   return register_record_write_log(context, location, log_entry);
 }
 
+ErrorCode MasstreeStoragePimpl::resize_general(
+  thread::Thread* context,
+  const void* be_key,
+  KeyLength key_length,
+  bool append,
+  const void* payload,
+  PayloadLength payload_offset,
+  PayloadLength payload_count,
+  PayloadLength physical_payload_hint) {
+  const bool normalized = (key_length == sizeof(KeySlice));
+  const KeySlice normalized_key = normalized ? normalize_be_bytes_full(be_key) : 0;
+  RecordLocation location;
+  if (normalized) {
+    CHECK_ERROR_CODE(locate_record_normalized(context, normalized_key, true, &location));
+  } else {
+    CHECK_ERROR_CODE(locate_record(context, be_key, key_length, true, &location));
+  }
+  if (location.observed_.is_deleted()) {
+    // in this case, we don't need a page-version set. the physical record is surely there.
+    return kErrorCodeStrKeyNotFound;
+  }
+  CHECK_ERROR_CODE(check_next_layer_bit(location.observed_));
+
+  // The payload length is protected by the read-set. Any change to it changes the TID.
+  const PayloadLength cur_length = location.page_->get_payload_length(location.index_);
+  if (append) {
+    payload_offset = cur_length;
+  } else if (payload_offset > cur_length) {
+    return kErrorCodeStrTooShortPayload;
+  }
+  const uint32_t new_length = static_cast<uint32_t>(payload_offset) + payload_count;
+  if (UNLIKELY(new_length > kMaxPayloadLength)) {
+    return kErrorCodeStrTooLongPayload;
+  }
+
+  if (location.page_->get_max_payload_length(location.index_) < new_length) {
+    // The record is physically too small. Expand it first. Usually this just uses the free
+    // space in the page. In the worst case, it splits the page.
+    if (physical_payload_hint < new_length) {
+      physical_payload_hint = new_length;
+    } else if (physical_payload_hint > kMaxPayloadLength) {
+      physical_payload_hint = kMaxPayloadLength;
+    }
+    physical_payload_hint = assorted::align8(physical_payload_hint);
+    if (normalized) {
+      CHECK_ERROR_CODE(reserve_record_normalized(
+        context,
+        normalized_key,
+        new_length,
+        physical_payload_hint,
+        &location));
+    } else {
+      CHECK_ERROR_CODE(reserve_record(
+        context,
+        be_key,
+        key_length,
+        new_length,
+        physical_payload_hint,
+        &location));
+    }
+    ASSERT_ND(location.is_found());  // contract of reserve_record
+    // reserve_record() took the record as read-set again. Someone might have changed it
+    // in between, in which case the first read-set will anyway abort us at commit.
+    if (location.observed_.is_deleted()) {
+      return kErrorCodeStrKeyNotFound;
+    }
+    CHECK_ERROR_CODE(check_next_layer_bit(location.observed_));
+    if (location.page_->get_payload_length(location.index_) != cur_length) {
+      return kErrorCodeXctRaceAbort;
+    }
+  }
+  ASSERT_ND(location.page_->get_max_payload_length(location.index_) >= new_length);
+
+  uint16_t log_length = MasstreeResizeLogType::calculate_log_length(key_length, payload_count);
+  MasstreeResizeLogType* log_entry = reinterpret_cast<MasstreeResizeLogType*>(
+    context->get_thread_log_buffer().reserve_new_log(log_length));
+  log_entry->populate(
+    get_id(),
+    be_key,
+    key_length,
+    payload,
+    payload_offset,
+    payload_count);
+  location.page_->header().stat_last_updater_node_ = context->get_numa_node();
+  return register_record_write_log(context, location, log_entry);
+}
+
 // Defines MasstreeStorage methods so that we can inline implementation calls
 xct::TrackMovedRecordResult MasstreeStorage::track_moved_record(
   xct::RwLockableXctId* old_address,
@@ -845,6 +1149,12 @@ xct::TrackMovedRecordResult MasstreeStorage::track_moved_record(
   return MasstreeStoragePimpl(this).track_moved_record(old_address, write_set);
 }
 
+bool MasstreeStorage::verify_range_access(
+  const xct::RangeXctAccess& access,
+  const xct::CurrentLockList* own_locks) {
+  return MasstreeStoragePimpl(this).verify_range_access(access, own_locks);
+}
+
 inline xct::TrackMovedRecordResult MasstreeStoragePimpl::track_moved_record(
   xct::RwLockableXctId* old_address,
   xct::WriteXctAccess* write_set) {
@@ -856,6 +1166,25 @@ inline xct::TrackMovedRecordResult MasstreeStoragePimpl::track_moved_record(
   return page->track_moved_record(engine_, old_address, write_set);
 }
 
+inline bool MasstreeStoragePimpl::verify_range_access(
+  const xct::RangeXctAccess& access,
+  const xct::CurrentLockList* own_locks) {
+  const MasstreeBorderPage* page = reinterpret_cast<const MasstreeBorderPage*>(
+    to_page(access.address_));
+  ASSERT_ND(page->is_border());
+  ASSERT_ND(page->get_version_address() == access.address_);
+  if (page->get_version().status_ != access.observed_) {
+    // Moved (split). Records in the range might be now in another page.
+    DVLOG(1) << "The page of a range set was split. will abort";
+    return false;
+  }
+  return !page->has_new_record_in_range(
+    access.observed_key_count_,
+    access.low_,
+    access.high_,
+    own_locks);
+}
+
 // Explicit instantiations for each payload type
 // @cond DOXYGEN_IGNORE
 #define EXPIN_5(x) template ErrorCode MasstreeStoragePimpl::increment_general< x > \
@@ -34,6 +34,7 @@
 #include "foedus/log/meta_log_buffer.hpp"
 #include "foedus/log/thread_log_buffer.hpp"
 #include "foedus/memory/engine_memory.hpp"
+#include "foedus/memory/page_pool.hpp"
 #include "foedus/savepoint/savepoint_manager.hpp"
 #include "foedus/snapshot/snapshot_manager.hpp"
 #include "foedus/snapshot/snapshot_metadata.hpp"
@@ -46,7 +47,9 @@
 #include "foedus/storage/storage_options.hpp"
 #include "foedus/storage/array/array_log_types.hpp"
 #include "foedus/storage/array/array_metadata.hpp"
+#include "foedus/storage/array/array_page_impl.hpp"
 #include "foedus/storage/array/array_storage.hpp"
+#include "foedus/storage/array/array_storage_pimpl.hpp"
 #include "foedus/storage/hash/hash_log_types.hpp"
 #include "foedus/storage/hash/hash_metadata.hpp"
 #include "foedus/storage/hash/hash_storage.hpp"
@@ -57,6 +60,7 @@
 #include "foedus/storage/sequential/sequential_metadata.hpp"
 #include "foedus/storage/sequential/sequential_storage.hpp"
 #include "foedus/thread/thread_pool.hpp"
+#include "foedus/xct/xct_access.hpp"
 #include "foedus/xct/xct_manager.hpp"
 
 namespace foedus {
@@ -189,6 +193,22 @@ ErrorStack StorageManagerPimpl::reinitialize_for_recovered_snapshot() {
     // Here, we assume that the initially-allocated volatile root page does NOT have
     // any child volatile page (it shouldn't!). Otherwise, the following overwrite
     // will cause leaked volatile pages.
+    // The only exception is ArrayStorage::extend() redone in this restart, which makes the pages
+    // on the path to the previous last record volatile. Their records don't reflect the logs
+    // applied by the recovered snapshot, so we just release them.
+    if (block->meta_.type_ == kArrayStorage) {
+      const array::ArrayPage* root = reinterpret_cast<const array::ArrayPage*>(volatile_page);
+      if (!root->is_leaf()) {
+        memory::PageReleaseBatch release_batch(engine_);
+        for (uint16_t i = 0; i < array::kInteriorFanout; ++i) {
+          VolatilePagePointer child = root->get_interior_record(i).volatile_pointer_;
+          if (!child.is_null()) {
+            array::ArrayStoragePimpl::release_pages_recursive(resolver, &release_batch, child);
+          }
+        }
+        release_batch.release_all();
+      }
+    }
     WRAP_ERROR_CODE(fileset.read_page(snapshot_page_id, volatile_page));
     ASSERT_ND(volatile_page->get_header().snapshot_);
     ASSERT_ND(volatile_page->get_header().storage_id_ == id);
@@ -270,6 +290,7 @@ ErrorStack StorageManagerPimpl::drop_storage(StorageId id, Epoch *commit_epoch)
 
   StorageName name = block->meta_.name_;
   LOG(INFO) << "Dropping storage " << id << "(" << name << ")";
+  unregister_secondary_indexes(id);
   StorageType type = block->meta_.type_;
   if (type == kArrayStorage) {
     CHECK_ERROR(array::ArrayStorage(engine_, block).drop());
@@ -467,6 +488,26 @@ xct::TrackMovedRecordResult StorageManagerPimpl::track_moved_record(
   }
 }
 
+bool StorageManager::verify_range_access(
+  const xct::RangeXctAccess& access,
+  const xct::CurrentLockList* own_locks) {
+  return pimpl_->verify_range_access(access, own_locks);
+}
+
+bool StorageManagerPimpl::verify_range_access(
+  const xct::RangeXctAccess& access,
+  const xct::CurrentLockList* own_locks) {
+  StorageControlBlock* block = storages_ + access.storage_id_;
+  ASSERT_ND(block->exists());
+  StorageType type = block->meta_.type_;
+  if (type == kMasstreeStorage) {
+    return masstree::MasstreeStorage(engine_, block).verify_range_access(access, own_locks);
+  } else {
+    LOG(ERROR) << "Unexpected storage type for a range set. Bug? type=" << type;
+    return false;
+  }
+}
+
 ErrorStack StorageManagerPimpl::clone_all_storage_metadata(
   snapshot::SnapshotMetadata *metadata) {
   debugging::StopWatch stop_watch;
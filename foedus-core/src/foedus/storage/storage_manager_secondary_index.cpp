@@ -0,0 +1,881 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "foedus/engine.hpp"
+#include "foedus/error_stack_batch.hpp"
+#include "foedus/assorted/assorted_func.hpp"
+#include "foedus/assorted/atomic_fences.hpp"
+#include "foedus/assorted/endianness.hpp"
+#include "foedus/assorted/raw_atomics.hpp"
+#include "foedus/proc/proc_id.hpp"
+#include "foedus/proc/proc_manager.hpp"
+#include "foedus/storage/secondary_index.hpp"
+#include "foedus/storage/storage.hpp"
+#include "foedus/storage/storage_manager.hpp"
+#include "foedus/storage/storage_manager_pimpl.hpp"
+#include "foedus/storage/masstree/masstree_cursor.hpp"
+#include "foedus/storage/masstree/masstree_id.hpp"
+#include "foedus/storage/masstree/masstree_storage.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/xct/xct.hpp"
+#include "foedus/xct/xct_access.hpp"
+#include "foedus/xct/xct_id.hpp"
+#include "foedus/xct/xct_manager.hpp"
+
+namespace foedus {
+namespace storage {
+
+ErrorStack StorageManager::register_secondary_index(
+  StorageId base_id,
+  StorageId index_id,
+  const proc::ProcName& extractor) {
+  return pimpl_->register_secondary_index(base_id, index_id, extractor);
+}
+void StorageManager::unregister_secondary_indexes(StorageId id) {
+  pimpl_->unregister_secondary_indexes(id);
+}
+ErrorCode StorageManager::apply_secondary_index_insert(
+  thread::Thread* context,
+  StorageId base_id,
+  const void* key,
+  uint16_t key_length,
+  const void* payload,
+  uint16_t payload_count) {
+  return pimpl_->apply_secondary_index_insert(
+    context,
+    base_id,
+    key,
+    key_length,
+    payload,
+    payload_count);
+}
+ErrorCode StorageManager::apply_secondary_index_delete(
+  thread::Thread* context,
+  StorageId base_id,
+  const void* key,
+  uint16_t key_length,
+  const void* payload,
+  uint16_t payload_count) {
+  return pimpl_->apply_secondary_index_delete(
+    context,
+    base_id,
+    key,
+    key_length,
+    payload,
+    payload_count);
+}
+ErrorCode StorageManager::apply_secondary_index_update(
+  thread::Thread* context,
+  StorageId base_id,
+  const void* key,
+  uint16_t key_length,
+  const void* old_payload,
+  uint16_t old_payload_count,
+  const void* new_payload,
+  uint16_t new_payload_count) {
+  return pimpl_->apply_secondary_index_update(
+    context,
+    base_id,
+    key,
+    key_length,
+    old_payload,
+    old_payload_count,
+    new_payload,
+    new_payload_count);
+}
+bool StorageManager::verify_secondary_index_maintenance(const xct::Xct& xct) const {
+  return pimpl_->verify_secondary_index_maintenance(xct);
+}
+ErrorStack StorageManager::build_secondary_index(
+  thread::Thread* context,
+  StorageId index_id,
+  uint16_t partition,
+  uint16_t partition_count) {
+  return pimpl_->build_secondary_index(context, index_id, partition, partition_count);
+}
+ErrorStack StorageManager::finish_secondary_index_build(
+  thread::Thread* context,
+  StorageId index_id) {
+  return pimpl_->finish_secondary_index_build(context, index_id);
+}
+
+namespace {
+/**
+ * Starts modifying a registration entry. The caller holds mod_lock_.
+ * Lock-free readers retry while the version is odd.
+ */
+void begin_entry_modification(SecondaryIndex* entry) {
+  ASSERT_ND(entry->version_ % 2U == 0);
+  ++entry->version_;
+  assorted::memory_fence_release();
+}
+
+void end_entry_modification(SecondaryIndex* entry) {
+  assorted::memory_fence_release();
+  ++entry->version_;
+  ASSERT_ND(entry->version_ % 2U == 0);
+}
+}  // anonymous namespace
+
+ErrorStack StorageManagerPimpl::register_secondary_index(
+  StorageId base_id,
+  StorageId index_id,
+  const proc::ProcName& extractor) {
+  if (base_id == 0 || index_id == 0 || base_id == index_id || extractor.empty()) {
+    return ERROR_STACK(kErrorCodeInvalidParameter);
+  }
+  StorageControlBlock* base_block = get_storage(base_id);
+  StorageControlBlock* index_block = get_storage(index_id);
+  if (!base_block->exists() || !index_block->exists()) {
+    return ERROR_STACK(kErrorCodeStrAlreadyDropped);
+  }
+  // The build scans the base with MasstreeCursor, so the base must be a Masstree, too.
+  if (base_block->meta_.type_ != kMasstreeStorage
+    || index_block->meta_.type_ != kMasstreeStorage) {
+    return ERROR_STACK(kErrorCodeStrWrongMetadataType);
+  }
+  // Fail here rather than in every transaction if the extractor doesn't exist.
+  proc::Proc extractor_proc;
+  CHECK_ERROR(engine_->get_proc_manager()->get_proc(extractor, &extractor_proc));
+
+  soc::SharedMutexScope guard(&control_block_->mod_lock_);
+  const uint32_t count = control_block_->secondary_index_count_;
+  uint32_t slot = count;
+  for (uint32_t i = 0; i < count; ++i) {
+    const SecondaryIndex& entry = control_block_->secondary_indexes_[i];
+    if (!entry.is_valid()) {
+      slot = std::min(slot, i);
+    } else if (entry.index_id_ == index_id) {
+      LOG(ERROR) << "Storage-" << index_id << " is already registered as a secondary index";
+      return ERROR_STACK(kErrorCodeStrAlreadyExists);
+    }
+  }
+  if (slot >= SecondaryIndex::kMaxSecondaryIndexes) {
+    return ERROR_STACK(kErrorCodeStrTooManySecondaryIndexes);
+  }
+
+  SecondaryIndex* entry = control_block_->secondary_indexes_ + slot;
+  begin_entry_modification(entry);
+  entry->state_ = SecondaryIndex::kBuilding;
+  entry->base_id_ = base_id;
+  entry->index_id_ = index_id;
+  entry->extractor_ = extractor;
+  end_entry_modification(entry);
+  if (slot == count) {
+    // fill the entry first, then publish it by incrementing the count.
+    assorted::memory_fence_release();
+    control_block_->secondary_index_count_ = count + 1U;
+  }
+  LOG(INFO) << "Registered storage-" << index_id << " as a secondary index of storage-" << base_id
+    << ". extractor=" << extractor << ", slot=" << slot;
+  return kRetOk;
+}
+
+void StorageManagerPimpl::unregister_secondary_indexes(StorageId id) {
+  soc::SharedMutexScope guard(&control_block_->mod_lock_);
+  for (uint32_t i = 0; i < control_block_->secondary_index_count_; ++i) {
+    SecondaryIndex* entry = control_block_->secondary_indexes_ + i;
+    if (entry->is_valid() && (entry->base_id_ == id || entry->index_id_ == id)) {
+      LOG(INFO) << "Unregistered storage-" << entry->index_id_ << " as a secondary index of"
+        << " storage-" << entry->base_id_;
+      begin_entry_modification(entry);
+      entry->state_ = SecondaryIndex::kFree;
+      entry->base_id_ = 0;
+      entry->index_id_ = 0;
+      end_entry_modification(entry);
+    }
+  }
+}
+
+bool StorageManagerPimpl::read_secondary_index(
+  uint32_t slot,
+  StorageId base_id,
+  SecondaryIndex* out) const {
+  const SecondaryIndex& entry = control_block_->secondary_indexes_[slot];
+  while (true) {
+    if (entry.base_id_ != base_id) {
+      // Racy, but it's fine. If the entry is being registered now, this transaction began
+      // before the registration, which finish_secondary_index_build() takes care of.
+      return false;
+    }
+    const uint32_t version = entry.version_;
+    assorted::memory_fence_acquire();
+    if (version % 2U != 0) {
+      assorted::spinlock_yield();  // being modified
+      continue;
+    }
+    *out = entry;
+    assorted::memory_fence_acquire();
+    if (entry.version_ == version) {
+      return out->is_valid() && out->base_id_ == base_id;
+    }
+  }
+}
+
+ErrorStack StorageManagerPimpl::find_secondary_index(
+  StorageId index_id,
+  uint32_t* slot,
+  SecondaryIndex* out) {
+  soc::SharedMutexScope guard(&control_block_->mod_lock_);
+  for (uint32_t i = 0; i < control_block_->secondary_index_count_; ++i) {
+    const SecondaryIndex& entry = control_block_->secondary_indexes_[i];
+    if (entry.is_valid() && entry.index_id_ == index_id) {
+      *slot = i;
+      *out = entry;
+      return kRetOk;
+    }
+  }
+  return ERROR_STACK_MSG(kErrorCodeInvalidParameter, "Not registered as a secondary index");
+}
+
+ErrorCode StorageManagerPimpl::resolve_extractor(
+  uint32_t slot,
+  const SecondaryIndex& index,
+  proc::Proc* out) {
+  ASSERT_ND(index.is_valid());
+  ASSERT_ND(index.version_ % 2U == 0);
+  CachedExtractor* cache = extractor_cache_ + slot;
+  const uint32_t cached_version = cache->version_;
+  assorted::memory_fence_acquire();
+  if (cached_version == index.version_) {
+    *out = cache->proc_;
+    assorted::memory_fence_acquire();
+    if (cache->version_ == cached_version) {
+      return kErrorCodeOk;
+    }
+  }
+
+  // The first use of this registration in this process.
+  ErrorStack lookup = engine_->get_proc_manager()->get_proc(index.extractor_, out);
+  if (lookup.is_error()) {
+    return lookup.get_error_code();
+  }
+  // If another thread is filling the cache, just let it do so.
+  uint32_t expected = cached_version;
+  if (cached_version != CachedExtractor::kFilling
+    && assorted::raw_atomic_compare_exchange_strong<uint32_t>(
+      &cache->version_,
+      &expected,
+      CachedExtractor::kFilling)) {
+    cache->proc_ = *out;
+    assorted::memory_fence_release();
+    cache->version_ = index.version_;
+  }
+  return kErrorCodeOk;
+}
+
+namespace {
+/**
+ * Invokes the extractor and composes the index key, which is the secondary key followed by
+ * the base key. index_key must be kMaxKeyLength or larger. index_key_length becomes 0 when
+ * the extractor says the record is not indexed.
+ */
+ErrorCode make_index_key(
+  thread::Thread* context,
+  const SecondaryIndex& index,
+  proc::Proc extractor,
+  const void* key,
+  uint16_t key_length,
+  const void* payload,
+  uint16_t payload_count,
+  char* index_key,
+  masstree::KeyLength* index_key_length) {
+  *index_key_length = 0;
+  if (key_length >= masstree::kMaxKeyLength) {
+    return kErrorCodeStrSecondaryKeyTooLong;
+  }
+
+  SecondaryIndexExtractorInput input;
+  input.base_id_ = index.base_id_;
+  input.index_id_ = index.index_id_;
+  input.key_ = key;
+  input.payload_ = payload;
+  input.key_length_ = key_length;
+  input.payload_count_ = payload_count;
+  const uint32_t capacity = masstree::kMaxKeyLength - key_length;
+  uint32_t used = 0;
+  proc::ProcArguments args = {
+    context->get_engine(),
+    context,
+    &input,
+    sizeof(input),
+    index_key,
+    capacity,
+    &used };
+  ErrorStack extracted = extractor(args);
+  if (extracted.is_error()) {
+    return extracted.get_error_code();
+  } else if (used == 0) {
+    return kErrorCodeOk;  // not indexed
+  } else if (used > capacity) {
+    return kErrorCodeStrSecondaryKeyTooLong;
+  }
+
+  std::memcpy(index_key + used, key, key_length);
+  *index_key_length = used + key_length;
+  return kErrorCodeOk;
+}
+
+/**
+ * @param[in] tolerant whether to ignore an index record that already exists, which happens
+ * while the index is being built.
+ */
+ErrorCode insert_index_record(
+  thread::Thread* context,
+  const SecondaryIndex& index,
+  proc::Proc extractor,
+  masstree::MasstreeStorage* index_storage,
+  const void* key,
+  uint16_t key_length,
+  const void* payload,
+  uint16_t payload_count,
+  bool tolerant) {
+  char index_key[masstree::kMaxKeyLength];
+  masstree::KeyLength index_key_length;
+  CHECK_ERROR_CODE(make_index_key(
+    context,
+    index,
+    extractor,
+    key,
+    key_length,
+    payload,
+    payload_count,
+    index_key,
+    &index_key_length));
+  if (index_key_length == 0) {
+    return kErrorCodeOk;
+  }
+  ErrorCode code = index_storage->insert_record(
+    context,
+    index_key,
+    index_key_length,
+    key,
+    key_length);
+  if (tolerant && code == kErrorCodeStrKeyAlreadyExists) {
+    return kErrorCodeOk;
+  }
+  return code;
+}
+
+/**
+ * @param[in] tolerant whether to ignore a missing index record, which happens while the index
+ * is being built.
+ */
+ErrorCode delete_index_record(
+  thread::Thread* context,
+  const SecondaryIndex& index,
+  proc::Proc extractor,
+  masstree::MasstreeStorage* index_storage,
+  const void* key,
+  uint16_t key_length,
+  const void* payload,
+  uint16_t payload_count,
+  bool tolerant) {
+  char index_key[masstree::kMaxKeyLength];
+  masstree::KeyLength index_key_length;
+  CHECK_ERROR_CODE(make_index_key(
+    context,
+    index,
+    extractor,
+    key,
+    key_length,
+    payload,
+    payload_count,
+    index_key,
+    &index_key_length));
+  if (index_key_length == 0) {
+    return kErrorCodeOk;
+  }
+  ErrorCode code = index_storage->delete_record(context, index_key, index_key_length);
+  if (tolerant && code == kErrorCodeStrKeyNotFound) {
+    return kErrorCodeOk;
+  }
+  return code;
+}
+
+/**
+ * Scans [low_key, high_key) of a Masstree and calls handler(cursor, key, key_length) for each
+ * record. Records are processed in small transactions so that we don't block concurrent
+ * transactions nor overflow read/range sets. Each transaction resumes from the last key of the
+ * previous one, and is retried from the same key when it aborts due to a race.
+ * Null high_key means the end of the storage.
+ */
+template <typename HANDLER>
+ErrorStack scan_in_small_xcts(
+  thread::Thread* context,
+  const masstree::MasstreeStorage& storage,
+  bool for_writes,
+  const char* low_key,
+  masstree::KeyLength low_length,
+  const char* high_key,
+  masstree::KeyLength high_length,
+  HANDLER handler,
+  uint64_t* scanned,
+  uint32_t* retries) {
+  char resume_key[masstree::kMaxKeyLength];
+  masstree::KeyLength resume_length = low_length;
+  bool resume_inclusive = true;
+  if (low_length > 0) {
+    std::memcpy(resume_key, low_key, low_length);
+  }
+
+  const uint32_t kRecordsPerXct = 256;
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  *scanned = 0;
+  *retries = 0;
+  while (true) {
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    masstree::MasstreeCursor cursor(storage, context);
+    ErrorCode code = cursor.open(
+      resume_length > 0 ? resume_key : nullptr,
+      resume_length,
+      high_key,
+      high_length,
+      true,
+      for_writes,
+      resume_inclusive,
+      false);
+    char last_key[masstree::kMaxKeyLength];
+    masstree::KeyLength last_length = 0;
+    uint32_t processed = 0;
+    while (code == kErrorCodeOk && cursor.is_valid_record() && processed < kRecordsPerXct) {
+      last_length = cursor.get_key_length();
+      cursor.copy_combined_key(last_key);
+      code = handler(&cursor, last_key, last_length);
+      ++processed;
+      if (code == kErrorCodeOk) {
+        code = cursor.next();
+      }
+    }
+    const bool finished = code == kErrorCodeOk && !cursor.is_valid_record();
+
+    if (code == kErrorCodeOk) {
+      Epoch commit_epoch;
+      code = xct_manager->precommit_xct(context, &commit_epoch);
+    } else {
+      WRAP_ERROR_CODE(xct_manager->abort_xct(context));
+    }
+
+    if (code == kErrorCodeXctRaceAbort || code == kErrorCodeXctLockAbort) {
+      ++(*retries);
+      continue;  // retry from the same key
+    } else if (code != kErrorCodeOk) {
+      return ERROR_STACK(code);
+    }
+
+    *scanned += processed;
+    if (finished) {
+      break;
+    }
+    ASSERT_ND(processed > 0);
+    std::memcpy(resume_key, last_key, last_length);
+    resume_length = last_length;
+    resume_inclusive = false;
+  }
+  return kRetOk;
+}
+}  // anonymous namespace
+
+ErrorCode StorageManagerPimpl::apply_secondary_index_insert(
+  thread::Thread* context,
+  StorageId base_id,
+  const void* key,
+  uint16_t key_length,
+  const void* payload,
+  uint16_t payload_count) {
+  context->get_current_xct().increment_secondary_index_maintenance_count();
+  const uint32_t count = control_block_->secondary_index_count_;
+  assorted::memory_fence_acquire();
+  for (uint32_t i = 0; i < count; ++i) {
+    SecondaryIndex index;
+    if (!read_secondary_index(i, base_id, &index)) {
+      continue;
+    }
+    proc::Proc extractor;
+    CHECK_ERROR_CODE(resolve_extractor(i, index, &extractor));
+    masstree::MasstreeStorage index_storage(engine_, get_storage(index.index_id_));
+    CHECK_ERROR_CODE(insert_index_record(
+      context,
+      index,
+      extractor,
+      &index_storage,
+      key,
+      key_length,
+      payload,
+      payload_count,
+      index.is_building()));
+  }
+  return kErrorCodeOk;
+}
+
+ErrorCode StorageManagerPimpl::apply_secondary_index_delete(
+  thread::Thread* context,
+  StorageId base_id,
+  const void* key,
+  uint16_t key_length,
+  const void* payload,
+  uint16_t payload_count) {
+  context->get_current_xct().increment_secondary_index_maintenance_count();
+  const uint32_t count = control_block_->secondary_index_count_;
+  assorted::memory_fence_acquire();
+  for (uint32_t i = 0; i < count; ++i) {
+    SecondaryIndex index;
+    if (!read_secondary_index(i, base_id, &index)) {
+      continue;
+    }
+    proc::Proc extractor;
+    CHECK_ERROR_CODE(resolve_extractor(i, index, &extractor));
+    masstree::MasstreeStorage index_storage(engine_, get_storage(index.index_id_));
+    CHECK_ERROR_CODE(delete_index_record(
+      context,
+      index,
+      extractor,
+      &index_storage,
+      key,
+      key_length,
+      payload,
+      payload_count,
+      index.is_building()));
+  }
+  return kErrorCodeOk;
+}
+
+ErrorCode StorageManagerPimpl::apply_secondary_index_update(
+  thread::Thread* context,
+  StorageId base_id,
+  const void* key,
+  uint16_t key_length,
+  const void* old_payload,
+  uint16_t old_payload_count,
+  const void* new_payload,
+  uint16_t new_payload_count) {
+  context->get_current_xct().increment_secondary_index_maintenance_count();
+  const uint32_t count = control_block_->secondary_index_count_;
+  assorted::memory_fence_acquire();
+  for (uint32_t i = 0; i < count; ++i) {
+    SecondaryIndex index;
+    if (!read_secondary_index(i, base_id, &index)) {
+      continue;
+    }
+    proc::Proc extractor;
+    CHECK_ERROR_CODE(resolve_extractor(i, index, &extractor));
+    char old_key[masstree::kMaxKeyLength];
+    char new_key[masstree::kMaxKeyLength];
+    masstree::KeyLength old_length;
+    masstree::KeyLength new_length;
+    CHECK_ERROR_CODE(make_index_key(
+      context,
+      index,
+      extractor,
+      key,
+      key_length,
+      old_payload,
+      old_payload_count,
+      old_key,
+      &old_length));
+    CHECK_ERROR_CODE(make_index_key(
+      context,
+      index,
+      extractor,
+      key,
+      key_length,
+      new_payload,
+      new_payload_count,
+      new_key,
+      &new_length));
+    if (old_length == new_length && std::memcmp(old_key, new_key, old_length) == 0) {
+      continue;  // the secondary key didn't change. nothing to do for this index.
+    }
+
+    masstree::MasstreeStorage index_storage(engine_, get_storage(index.index_id_));
+    if (old_length > 0) {
+      ErrorCode code = index_storage.delete_record(context, old_key, old_length);
+      if (code != kErrorCodeOk && !(index.is_building() && code == kErrorCodeStrKeyNotFound)) {
+        return code;
+      }
+    }
+    if (new_length > 0) {
+      ErrorCode code = index_storage.insert_record(context, new_key, new_length, key, key_length);
+      if (code != kErrorCodeOk
+        && !(index.is_building() && code == kErrorCodeStrKeyAlreadyExists)) {
+        return code;
+      }
+    }
+  }
+  return kErrorCodeOk;
+}
+
+bool StorageManagerPimpl::verify_secondary_index_maintenance(const xct::Xct& xct) const {
+  const uint32_t count = control_block_->secondary_index_count_;
+  if (count == 0) {
+    return true;
+  }
+  assorted::memory_fence_acquire();
+  // Racy, but it's fine. Each field is written atomically, and a registration that changes
+  // during this transaction is handled by finish_secondary_index_build() anyway.
+  StorageId bases[SecondaryIndex::kMaxSecondaryIndexes];
+  uint32_t base_count = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    const SecondaryIndex& entry = control_block_->secondary_indexes_[i];
+    if (entry.state_ == SecondaryIndex::kReady) {
+      bases[base_count] = entry.base_id_;
+      ++base_count;
+    }
+  }
+  if (base_count == 0) {
+    return true;
+  }
+
+  const xct::WriteXctAccess* write_set = xct.get_write_set();
+  uint32_t base_writes = 0;
+  for (uint32_t i = 0; i < xct.get_write_set_size(); ++i) {
+    if (std::find(bases, bases + base_count, write_set[i].storage_id_) != bases + base_count) {
+      ++base_writes;
+    }
+  }
+  return base_writes <= xct.get_secondary_index_maintenance_count();
+}
+
+ErrorStack StorageManagerPimpl::build_secondary_index(
+  thread::Thread* context,
+  StorageId index_id,
+  uint16_t partition,
+  uint16_t partition_count) {
+  if (partition_count == 0 || partition >= partition_count) {
+    return ERROR_STACK(kErrorCodeInvalidParameter);
+  }
+  if (context->is_running_xct()) {
+    return ERROR_STACK(kErrorCodeXctAlreadyRunning);
+  }
+
+  uint32_t slot;
+  SecondaryIndex index;
+  CHECK_ERROR(find_secondary_index(index_id, &slot, &index));
+  StorageControlBlock* base_block = get_storage(index.base_id_);
+  ASSERT_ND(base_block->meta_.type_ == kMasstreeStorage);
+  proc::Proc extractor;
+  WRAP_ERROR_CODE(resolve_extractor(slot, index, &extractor));
+  masstree::MasstreeStorage base(engine_, base_block);
+  masstree::MasstreeStorage index_storage(engine_, get_storage(index_id));
+
+  // Divide the first layer by the boundaries of volatile border pages. This is just a hint
+  // to balance the partitions. Whatever the boundaries are, the partitions cover all keys.
+  const uint32_t kBoundaryCapacity = 1024;
+  masstree::KeySlice boundaries[kBoundaryCapacity];
+  uint32_t boundary_count = 0;
+  masstree::MasstreeStorage::PeekBoundariesArguments args = {
+    nullptr,
+    0,
+    kBoundaryCapacity,
+    masstree::kInfimumSlice,
+    masstree::kSupremumSlice,
+    boundaries,
+    &boundary_count };
+  WRAP_ERROR_CODE(base.peek_volatile_page_boundaries(engine_, args));
+  boundary_count = std::min(boundary_count, kBoundaryCapacity);
+  const bool has_low = partition > 0 && boundary_count > 0;
+  const bool has_high = partition + 1U < partition_count && boundary_count > 0;
+  if (partition > 0 && !has_low) {
+    return kRetOk;  // the storage is too small to partition. partition-0 does everything.
+  }
+  masstree::KeySlice low_be = 0;
+  masstree::KeySlice high_be = 0;
+  if (has_low) {
+    uint32_t pos = static_cast<uint32_t>(partition) * boundary_count / partition_count;
+    low_be = assorted::htobe<masstree::KeySlice>(boundaries[pos]);
+  }
+  if (has_high) {
+    uint32_t pos = (static_cast<uint32_t>(partition) + 1U) * boundary_count / partition_count;
+    high_be = assorted::htobe<masstree::KeySlice>(boundaries[pos]);
+    if (has_low && high_be == low_be) {
+      return kRetOk;  // empty partition
+    }
+  }
+
+  LOG(INFO) << "Building secondary index storage-" << index_id << ", partition-" << partition
+    << "/" << partition_count;
+  // A concurrent transaction might have already indexed the record, so this is tolerant.
+  auto index_base_record = [&](
+    masstree::MasstreeCursor* cursor,
+    const char* key,
+    masstree::KeyLength key_length) -> ErrorCode {
+    return insert_index_record(
+      context,
+      index,
+      extractor,
+      &index_storage,
+      key,
+      key_length,
+      cursor->get_payload(),
+      cursor->get_payload_length(),
+      true);
+  };
+  uint64_t indexed;
+  uint32_t retries;
+  CHECK_ERROR(scan_in_small_xcts(
+    context,
+    base,
+    false,
+    has_low ? reinterpret_cast<const char*>(&low_be) : nullptr,
+    has_low ? sizeof(low_be) : 0,
+    has_high ? reinterpret_cast<const char*>(&high_be) : nullptr,
+    has_high ? sizeof(high_be) : 0,
+    index_base_record,
+    &indexed,
+    &retries));
+
+  LOG(INFO) << "Built secondary index storage-" << index_id << ", partition-" << partition
+    << "/" << partition_count << ". scanned " << indexed << " records, " << retries << " retries";
+  return kRetOk;
+}
+
+ErrorStack StorageManagerPimpl::finish_secondary_index_build(
+  thread::Thread* context,
+  StorageId index_id) {
+  if (context->is_running_xct()) {
+    return ERROR_STACK(kErrorCodeXctAlreadyRunning);
+  }
+
+  uint32_t slot;
+  SecondaryIndex index;
+  CHECK_ERROR(find_secondary_index(index_id, &slot, &index));
+  StorageControlBlock* base_block = get_storage(index.base_id_);
+  ASSERT_ND(base_block->meta_.type_ == kMasstreeStorage);
+  proc::Proc extractor;
+  WRAP_ERROR_CODE(resolve_extractor(slot, index, &extractor));
+  masstree::MasstreeStorage base(engine_, base_block);
+  masstree::MasstreeStorage index_storage(engine_, get_storage(index_id));
+
+  // A transaction that checked the registrations before register_secondary_index() does not
+  // maintain the index even if it commits afterwards. Pause new transactions and wait for
+  // such transactions to finish. Transactions that begin from now on see the registration.
+  LOG(INFO) << "Finishing secondary index storage-" << index_id << ". Waiting for transactions"
+    << " that began before the registration..";
+  xct::XctManager* xct_manager = engine_->get_xct_manager();
+  xct_manager->pause_accepting_xct();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));  // almost forever in OLTP xcts.
+  xct_manager->resume_accepting_xct();
+
+  // Catch-up 1: index base records that such transactions inserted or updated.
+  auto index_base_record = [&](
+    masstree::MasstreeCursor* cursor,
+    const char* key,
+    masstree::KeyLength key_length) -> ErrorCode {
+    return insert_index_record(
+      context,
+      index,
+      extractor,
+      &index_storage,
+      key,
+      key_length,
+      cursor->get_payload(),
+      cursor->get_payload_length(),
+      true);
+  };
+  uint64_t base_scanned;
+  uint32_t base_retries;
+  CHECK_ERROR(scan_in_small_xcts(
+    context,
+    base,
+    false,
+    nullptr,
+    0,
+    nullptr,
+    0,
+    index_base_record,
+    &base_scanned,
+    &base_retries));
+
+  // Catch-up 2: delete index records whose base record such transactions deleted or updated.
+  auto delete_stale_record = [&](
+    masstree::MasstreeCursor* cursor,
+    const char* key,
+    masstree::KeyLength key_length) -> ErrorCode {
+    // The payload of an index record is the base key
+    const void* base_key = cursor->get_payload();
+    const masstree::PayloadLength base_key_length = cursor->get_payload_length();
+    char payload[masstree::kMaxPayloadLength];
+    masstree::PayloadLength payload_length = sizeof(payload);
+    ErrorCode code = base.get_record(
+      context,
+      base_key,
+      base_key_length,
+      payload,
+      &payload_length,
+      true);
+    if (code == kErrorCodeOk) {
+      char expected_key[masstree::kMaxKeyLength];
+      masstree::KeyLength expected_length;
+      CHECK_ERROR_CODE(make_index_key(
+        context,
+        index,
+        extractor,
+        base_key,
+        base_key_length,
+        payload,
+        payload_length,
+        expected_key,
+        &expected_length));
+      if (expected_length == key_length && std::memcmp(expected_key, key, key_length) == 0) {
+        return kErrorCodeOk;
+      }
+    } else if (code != kErrorCodeStrKeyNotFound) {
+      return code;
+    }
+    return cursor->delete_record();
+  };
+  uint64_t index_scanned;
+  uint32_t index_retries;
+  CHECK_ERROR(scan_in_small_xcts(
+    context,
+    index_storage,
+    true,
+    nullptr,
+    0,
+    nullptr,
+    0,
+    delete_stale_record,
+    &index_scanned,
+    &index_retries));
+
+  {
+    soc::SharedMutexScope guard(&control_block_->mod_lock_);
+    SecondaryIndex* entry = control_block_->secondary_indexes_ + slot;
+    if (entry->version_ != index.version_) {
+      return ERROR_STACK_MSG(kErrorCodeStrAlreadyDropped, "Unregistered during the build");
+    }
+    if (entry->is_building()) {
+      begin_entry_modification(entry);
+      entry->state_ = SecondaryIndex::kReady;
+      end_entry_modification(entry);
+    }
+  }
+  LOG(INFO) << "Secondary index storage-" << index_id << " is ready. scanned " << base_scanned
+    << " base records and " << index_scanned << " index records, "
+    << (base_retries + index_retries) << " retries";
+  return kRetOk;
+}
+
+}  // namespace storage
+}  // namespace foedus
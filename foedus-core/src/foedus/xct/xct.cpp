@@ -66,6 +66,8 @@ Xct::Xct(Engine* engine, thread::Thread* context, thread::ThreadId thread_id)
   max_lock_free_write_set_size_ = 0;
   pointer_set_size_ = 0;
   page_version_set_size_ = 0;
+  range_set_size_ = 0;
+  secondary_index_maintenance_count_ = 0;
   isolation_level_ = kSerializable;
   mcs_block_current_ = nullptr;
   mcs_rw_async_mapping_current_ = nullptr;
@@ -112,6 +114,8 @@ void Xct::initialize(
   pointer_set_size_ = 0;
   page_version_set_ = reinterpret_cast<PageVersionAccess*>(pieces.xct_page_version_memory_);
   page_version_set_size_ = 0;
+  range_set_ = reinterpret_cast<RangeXctAccess*>(pieces.xct_range_access_memory_);
+  range_set_size_ = 0;
   mcs_block_current_ = mcs_block_current;
   *mcs_block_current_ = 0;
   mcs_rw_async_mapping_current_ = mcs_rw_async_mapping_current;
@@ -184,6 +188,7 @@ std::ostream& operator<<(std::ostream& o, const Xct& v) {
       << "<write_set_size>" << v.get_write_set_size() << "</write_set_size>"
       << "<pointer_set_size>" << v.get_pointer_set_size() << "</pointer_set_size>"
       << "<page_version_set_size>" << v.get_page_version_set_size() << "</page_version_set_size>"
+      << "<range_set_size>" << v.get_range_set_size() << "</range_set_size>"
       << "<lock_free_read_set_size>" << v.get_lock_free_read_set_size()
         << "</lock_free_read_set_size>"
       << "<lock_free_write_set_size>" << v.get_lock_free_write_set_size()
@@ -255,6 +260,32 @@ ErrorCode Xct::add_to_page_version_set(
   return kErrorCodeOk;
 }
 
+ErrorCode Xct::add_to_range_set(
+  storage::StorageId storage_id,
+  const storage::PageVersion* version_address,
+  storage::PageVersionStatus observed,
+  uint16_t observed_key_count,
+  uint64_t low,
+  uint64_t high) {
+  ASSERT_ND(version_address);
+  ASSERT_ND(low <= high);
+  if (isolation_level_ != kSerializable) {
+    return kErrorCodeOk;
+  } else if (UNLIKELY(range_set_size_ >= kMaxRangeSets)) {
+    return kErrorCodeXctRangeSetOverflow;
+  }
+
+  RangeXctAccess* access = range_set_ + range_set_size_;
+  access->storage_id_ = storage_id;
+  access->observed_key_count_ = observed_key_count;
+  access->observed_ = observed;
+  access->address_ = version_address;
+  access->low_ = low;
+  access->high_ = high;
+  ++range_set_size_;
+  return kErrorCodeOk;
+}
+
 ErrorCode Xct::on_record_read(
   bool intended_for_write,
   RwLockableXctId* tid_address,
@@ -41,6 +41,16 @@ std::ostream& operator<<(std::ostream& o, const PageVersionAccess& v) {
   return o;
 }
 
+std::ostream& operator<<(std::ostream& o, const RangeXctAccess& v) {
+  o << "<RangeXctAccess><storage>" << v.storage_id_ << "</storage>"
+    << "<address>" << v.address_ << "</address>"
+    << "<observed>" << v.observed_ << "</observed>"
+    << "<observed_key_count>" << v.observed_key_count_ << "</observed_key_count>"
+    << "<low>" << assorted::Hex(v.low_, 16) << "</low>"
+    << "<high>" << assorted::Hex(v.high_, 16) << "</high></RangeXctAccess>";
+  return o;
+}
+
 std::ostream& operator<<(std::ostream& o, const ReadXctAccess& v) {
   o << "<ReadXctAccess><storage>" << v.storage_id_ << "</storage>"
 //    << "<current_lock_position_>" << v.current_lock_position_ << "</current_lock_position_>"
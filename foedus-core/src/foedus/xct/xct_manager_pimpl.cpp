@@ -351,6 +351,10 @@ ErrorCode XctManagerPimpl::precommit_xct(thread::Thread* context, Epoch *commit_
   bool read_only = context->get_current_xct().is_read_only();
   if (read_only) {
     result = precommit_xct_readonly(context, commit_epoch);
+  } else if (!engine_->get_storage_manager()->verify_secondary_index_maintenance(current_xct)) {
+    LOG(WARNING) << *context << " wrote to a storage with a secondary index without maintaining"
+      << " the index. Aborting";
+    result = kErrorCodeXctSecondaryIndexNotMaintained;
   } else {
     result = precommit_xct_readwrite(context, commit_epoch);
   }
@@ -630,6 +634,14 @@ moved_retry:
         if (r->owner_id_address_->xct_id_ != r->related_read_->observed_owner_id_) {
           return kErrorCodeXctRaceAbort;
         }
+      } else if (r->log_entry_->header_.get_type() == log::kLogCodeHashIncrement) {
+        // Oneshot increments in hash take no read-set so that they don't abort each other.
+        // Instead, we check the existence and payload length here, under the lock.
+        const storage::hash::HashIncrementLogType* increment
+          = reinterpret_cast<const storage::hash::HashIncrementLogType*>(r->log_entry_);
+        if (!increment->is_applicable(r->owner_id_address_)) {
+          return kErrorCodeXctRaceAbort;
+        }
       }
     }
   }
@@ -723,6 +735,8 @@ bool XctManagerPimpl::precommit_xct_verify_readonly(thread::Thread* context, Epo
     return false;
   } else if (!precommit_xct_verify_page_version_set(context)) {
     return false;
+  } else if (!precommit_xct_verify_range_set(context)) {
+    return false;
   } else {
     return true;
   }
@@ -820,6 +834,8 @@ bool XctManagerPimpl::precommit_xct_verify_readwrite(thread::Thread* context, Xc
     return false;
   } else if (!precommit_xct_verify_page_version_set(context)) {
     return false;
+  } else if (!precommit_xct_verify_range_set(context)) {
+    return false;
   } else {
     return true;
   }
@@ -864,6 +880,26 @@ bool XctManagerPimpl::precommit_xct_verify_page_version_set(thread::Thread* cont
   }
   return true;
 }
+bool XctManagerPimpl::precommit_xct_verify_range_set(thread::Thread* context) {
+  const Xct& current_xct = context->get_current_xct();
+  const RangeXctAccess*   range_set = current_xct.get_range_set();
+  const uint32_t          range_set_size = current_xct.get_range_set_size();
+  storage::StorageManager* st = engine_->get_storage_manager();
+  for (uint32_t i = 0; i < range_set_size; ++i) {
+    if (i % kReadsetPrefetchBatch == 0) {
+      for (uint32_t j = i; j < i + kReadsetPrefetchBatch && j < range_set_size; ++j) {
+        assorted::prefetch_cacheline(range_set[j].address_);
+      }
+    }
+    const RangeXctAccess& access = range_set[i];
+    if (!st->verify_range_access(access, current_xct.get_current_lock_list())) {
+      DLOG(WARNING) << *context << " a new record is inserted in the range. will abort."
+        << access;
+      return false;
+    }
+  }
+  return true;
+}
 
 void XctManagerPimpl::precommit_xct_apply(
   thread::Thread* context,
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include "foedus/test_common.hpp"
+#include "foedus/assorted/simd_aggregate.hpp"
+#include "foedus/assorted/uniform_random.hpp"
+
+namespace foedus {
+namespace assorted {
+
+DEFINE_TEST_CASE_PACKAGE(SimdAggregateTest, foedus.assorted);
+
+const uint32_t kArraySize = 100;
+/** Elements are a field of 56-byte structs, like array records with 40-byte payloads. */
+const int32_t kStride = 7;
+
+template <typename T>
+SimdAggregate<T> naive(const T* array, uint32_t from, uint32_t to) {
+  SimdAggregate<T> ret;
+  for (uint32_t i = from; i < to; ++i) {
+    ++ret.count_;
+    ret.sum_ += array[i];
+    ret.min_ = std::min(ret.min_, array[i]);
+    ret.max_ = std::max(ret.max_, array[i]);
+  }
+  return ret;
+}
+
+template <typename T>
+void verify(SimdLevel level, const T* array, T other_fields) {
+  T structs[kArraySize * kStride];
+  for (uint32_t i = 0; i < kArraySize * kStride; ++i) {
+    structs[i] = other_fields;  // other fields must be ignored.
+  }
+  for (uint32_t i = 0; i < kArraySize; ++i) {
+    structs[i * kStride] = array[i];
+  }
+  // All combinations of from/to to cover both vector bodies and remainders.
+  for (uint32_t from = 0; from <= kArraySize; ++from) {
+    for (uint32_t to = from; to <= kArraySize; to += 3) {
+      const SimdAggregate<T> expected = naive(array, from, to);
+      SimdAggregate<T> result;
+      simd_aggregate_strided_with(level, structs + from * kStride, kStride, to - from, &result);
+      EXPECT_EQ(expected.count_, result.count_) << to_simd_level_string(level) << ":" << from;
+      EXPECT_EQ(expected.sum_, result.sum_) << to_simd_level_string(level) << ":" << from;
+      EXPECT_EQ(expected.min_, result.min_) << to_simd_level_string(level) << ":" << from;
+      EXPECT_EQ(expected.max_, result.max_) << to_simd_level_string(level) << ":" << from;
+
+      // aggregating twice is same as merging two aggregates
+      SimdAggregate<T> twice = result;
+      simd_aggregate_strided_with(level, structs + from * kStride, kStride, to - from, &twice);
+      EXPECT_EQ(expected.count_ * 2U, twice.count_);
+      EXPECT_EQ(static_cast<T>(expected.sum_ * 2), twice.sum_);
+      EXPECT_EQ(expected.min_, twice.min_);
+      EXPECT_EQ(expected.max_, twice.max_);
+    }
+  }
+}
+
+/** Integer sums wrap around, without relying on signed overflow. */
+template <typename T>
+T add(T left, T right) { return left + right; }
+template <>
+int64_t add(int64_t left, int64_t right) {
+  return static_cast<int64_t>(static_cast<uint64_t>(left) + static_cast<uint64_t>(right));
+}
+
+template <typename T>
+void verify_add(SimdLevel level, const T* array) {
+  // Adds array[i] to the (i * 37 % kArraySize)-th element, which are distinct for any count.
+  uint16_t indexes[kArraySize];
+  for (uint32_t i = 0; i < kArraySize; ++i) {
+    indexes[i] = i * 37U % kArraySize;
+  }
+  for (uint32_t count = 0; count <= kArraySize; count += 3) {
+    T structs[kArraySize * kStride];
+    T expected[kArraySize * kStride];
+    for (uint32_t i = 0; i < kArraySize * kStride; ++i) {
+      structs[i] = static_cast<T>(i);
+      expected[i] = static_cast<T>(i);
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+      expected[indexes[i] * kStride] = add<T>(expected[indexes[i] * kStride], array[i]);
+    }
+    simd_add_scattered_with(level, structs, kStride, indexes, array, count);
+    for (uint32_t i = 0; i < kArraySize * kStride; ++i) {
+      EXPECT_EQ(expected[i], structs[i]) << to_simd_level_string(level) << ":" << count;
+    }
+  }
+}
+
+void test_level(SimdLevel level) {
+  UniformRandom rnd(1234L);
+  uint64_t unsigned_array[kArraySize];
+  int64_t signed_array[kArraySize];
+  double double_array[kArraySize];
+  for (uint32_t i = 0; i < kArraySize; ++i) {
+    // Values with the sign bit on, and sums that overflow.
+    unsigned_array[i] = rnd.next_uint64();
+    if (i % 7 == 0) {
+      unsigned_array[i] |= (1ULL << 63);
+    } else if (i % 3 == 0) {
+      unsigned_array[i] &= ~(1ULL << 63);
+    }
+    signed_array[i] = static_cast<int64_t>(unsigned_array[i]);
+    // Integers, so that sums are exact regardless of the order of additions.
+    double_array[i] = static_cast<double>(static_cast<int32_t>(rnd.next_uint32()));
+  }
+  verify<uint64_t>(level, unsigned_array, 0);
+  verify<uint64_t>(level, unsigned_array, 0xFFFFFFFFFFFFFFFFULL);
+  verify<int64_t>(level, signed_array, 0);
+  verify<int64_t>(level, signed_array, (1LL << 62));
+  verify<double>(level, double_array, 0);
+  verify<double>(level, double_array, 1.0e300);
+  verify_add<int64_t>(level, signed_array);
+  verify_add<double>(level, double_array);
+}
+
+TEST(SimdAggregateTest, Scalar) { test_level(kSimdScalar); }
+TEST(SimdAggregateTest, Avx2) { test_level(kSimdAvx2); }  // falls back if not supported
+TEST(SimdAggregateTest, Avx512) { test_level(kSimdAvx512); }
+TEST(SimdAggregateTest, Detected) {
+  const SimdLevel level = get_simd_level();
+  std::cout << "Detected SIMD level: " << to_simd_level_string(level) << std::endl;
+  test_level(level);
+  int64_t array[6] = {-3, 100, 5, -200, 7, 300};
+  SimdAggregate<int64_t> result;
+  simd_aggregate_strided(array, 2, 3, &result);
+  EXPECT_EQ(3U, result.count_);
+  EXPECT_EQ(9, result.sum_);
+  EXPECT_EQ(-3, result.min_);
+  EXPECT_EQ(7, result.max_);
+  simd_aggregate_strided(array + 1, 2, 3, &result);
+  EXPECT_EQ(6U, result.count_);
+  EXPECT_EQ(209, result.sum_);
+  EXPECT_EQ(-200, result.min_);
+  EXPECT_EQ(300, result.max_);
+
+  uint64_t counters[6] = {1, 100, 2, 200, 3, 300};
+  const uint16_t indexes[2] = {2, 0};
+  const uint64_t addenda[2] = {10, 0xFFFFFFFFFFFFFFFFULL};
+  simd_add_scattered(counters, 2, indexes, addenda, 2);
+  EXPECT_EQ(0U, counters[0]);  // wraps around
+  EXPECT_EQ(2U, counters[2]);
+  EXPECT_EQ(13U, counters[4]);
+  EXPECT_EQ(100U, counters[1]);
+}
+
+}  // namespace assorted
+}  // namespace foedus
+
+TEST_MAIN_CAPTURE_SIGNALS(SimdAggregateTest, foedus.assorted);
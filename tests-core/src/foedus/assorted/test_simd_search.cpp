@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include "foedus/test_common.hpp"
+#include "foedus/assorted/simd_search.hpp"
+#include "foedus/assorted/uniform_random.hpp"
+
+namespace foedus {
+namespace assorted {
+
+DEFINE_TEST_CASE_PACKAGE(SimdSearchTest, foedus.assorted);
+
+const uint16_t kArraySize = 100;
+
+uint16_t naive_equal(const uint64_t* array, uint16_t from, uint16_t to, uint64_t value) {
+  for (uint16_t i = from; i < to; ++i) {
+    if (array[i] == value) {
+      return i;
+    }
+  }
+  return to;
+}
+
+uint16_t naive_greater(const uint64_t* array, uint16_t from, uint16_t to, uint64_t value) {
+  for (uint16_t i = from; i < to; ++i) {
+    if (array[i] > value) {
+      return i;
+    }
+  }
+  return to;
+}
+
+void verify(SimdLevel level, const uint64_t* array, uint64_t value) {
+  // All combinations of from/to to cover both vector bodies and remainders.
+  for (uint16_t from = 0; from <= kArraySize; ++from) {
+    for (uint16_t to = from; to <= kArraySize; to += 3) {
+      EXPECT_EQ(
+        naive_equal(array, from, to, value),
+        simd_find_first_equal_with(level, array, from, to, value))
+        << to_simd_level_string(level) << ":" << from << "-" << to << ":" << value;
+      EXPECT_EQ(
+        naive_greater(array, from, to, value),
+        simd_find_first_greater_with(level, array, from, to, value))
+        << to_simd_level_string(level) << ":" << from << "-" << to << ":" << value;
+    }
+  }
+}
+
+/** Same elements laid out as a field of 32-byte structs, both forward and backward. */
+void verify_strided(SimdLevel level, const uint64_t* array, uint64_t value) {
+  const int32_t kStride = 4;
+  uint64_t structs[kArraySize * kStride];
+  for (uint16_t i = 0; i < kArraySize * kStride; ++i) {
+    structs[i] = value;  // other fields have the value. they must be ignored.
+  }
+  for (uint16_t i = 0; i < kArraySize; ++i) {
+    structs[i * kStride] = array[i];
+  }
+  uint64_t backward[kArraySize * kStride];
+  for (uint16_t i = 0; i < kArraySize * kStride; ++i) {
+    backward[i] = value;
+  }
+  const uint64_t* backward_base = backward + (kArraySize - 1) * kStride + 3;
+  for (uint16_t i = 0; i < kArraySize; ++i) {
+    backward[(kArraySize - 1 - i) * kStride + 3] = array[i];
+  }
+  ASSERT_EQ(array[0], backward_base[0]);
+  for (uint16_t from = 0; from <= kArraySize; ++from) {
+    for (uint16_t to = from; to <= kArraySize; to += 3) {
+      const uint16_t expected = naive_equal(array, from, to, value);
+      EXPECT_EQ(expected, simd_find_first_equal_strided_with(
+        level, structs, kStride, from, to, value))
+        << to_simd_level_string(level) << ":" << from << "-" << to << ":" << value;
+      EXPECT_EQ(expected, simd_find_first_equal_strided_with(
+        level, backward_base, -kStride, from, to, value))
+        << to_simd_level_string(level) << ":" << from << "-" << to << ":" << value;
+    }
+  }
+}
+
+void test_level(SimdLevel level) {
+  UniformRandom rnd(1234L);
+  uint64_t array[kArraySize];
+  for (uint16_t i = 0; i < kArraySize; ++i) {
+    // Small values so that we have many duplicates, and also values with the sign bit on.
+    array[i] = rnd.next_uint32() % 16U;
+    if (i % 7 == 0) {
+      array[i] |= (1ULL << 63);
+    }
+  }
+  const uint64_t kValues[] = {0, 3, 15, 16, (1ULL << 63), (1ULL << 63) + 4, 0xFFFFFFFFFFFFFFFFULL};
+  for (uint64_t value : kValues) {
+    verify(level, array, value);
+    verify_strided(level, array, value);
+  }
+
+  // Sorted version, which is how separators and snapshot slices look like
+  std::sort(array, array + kArraySize);
+  for (uint64_t value : kValues) {
+    verify(level, array, value);
+  }
+}
+
+TEST(SimdSearchTest, Scalar) { test_level(kSimdScalar); }
+TEST(SimdSearchTest, Avx2) { test_level(kSimdAvx2); }  // falls back if not supported
+TEST(SimdSearchTest, Avx512) { test_level(kSimdAvx512); }
+TEST(SimdSearchTest, Detected) {
+  const SimdLevel level = get_simd_level();
+  std::cout << "Detected SIMD level: " << to_simd_level_string(level) << std::endl;
+  test_level(level);
+  uint64_t array[4] = {1, 5, 9, 9};
+  EXPECT_EQ(2U, simd_find_first_equal(array, 0, 4, 9));
+  EXPECT_EQ(3U, simd_find_first_equal(array, 3, 4, 9));
+  EXPECT_EQ(4U, simd_find_first_equal(array, 0, 4, 7));
+  EXPECT_EQ(1U, simd_find_first_greater(array, 0, 4, 1));
+  EXPECT_EQ(4U, simd_find_first_greater(array, 0, 4, 9));
+  EXPECT_EQ(1U, simd_find_first_equal_strided(array, 2, 0, 2, 9));
+  EXPECT_EQ(1U, simd_find_first_equal_strided(array + 3, -3, 0, 2, 1));
+}
+
+}  // namespace assorted
+}  // namespace foedus
+
+TEST_MAIN_CAPTURE_SIGNALS(SimdSearchTest, foedus.assorted);
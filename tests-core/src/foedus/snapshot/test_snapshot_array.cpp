@@ -135,6 +135,79 @@ ErrorStack increments_twice_task(const proc::ProcArguments& args) {
   return kRetOk;
 }
 
+// Increments and overwrites on the same records. The composer adds up increments before
+// applying them, but must not reorder them with overwrites.
+ErrorStack increments_overwrites_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(kInput, args.input_len_);
+  const TaskInput* input = reinterpret_cast<const TaskInput*>(args.input_buffer_);
+  const uint32_t records = input->records;
+  uint32_t id = input->id;
+  EXPECT_NE(id, 2U);
+
+  thread::Thread* context = args.context_;
+  storage::array::ArrayStorage array(args.engine_, kName);
+  ASSERT_ND(array.exists());
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  Epoch commit_epoch;
+  for (uint32_t round = 0; round < 3U; ++round) {
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    for (uint32_t i = 0; i < records / 2U; ++i) {
+      storage::array::ArrayOffset rec = id * records / 2U + i;
+      if (round == 1U) {
+        storage::array::ArrayOffset value = rec - 3U;  // might wrap around. that's fine.
+        WRAP_ERROR_CODE(array.overwrite_record(context, rec, &value, 0, sizeof(value)));
+      } else {
+        // +5 is overwritten in the 2nd round, +3 makes it rec.
+        uint64_t addendum = round == 0 ? 5U : 3U;
+        WRAP_ERROR_CODE(array.increment_record_oneshot<uint64_t>(context, rec, addendum, 0));
+      }
+    }
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  }
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+// Exactly representable, with 2.0 between adjacent doubles.
+const double kDoubleBase = 1.0e16;
+const double kDoubleAddendum = 0.5;
+const uint32_t kDoubleIncrements = 4;
+
+// Double increments that round differently if added up before being applied.
+// Applied one by one, each +0.5 is less than half of the gap, so the value stays the same.
+// Summed first, the +2.0 changes the value. The snapshot must do the former like transactions.
+ErrorStack increments_double_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(kInput, args.input_len_);
+  const TaskInput* input = reinterpret_cast<const TaskInput*>(args.input_buffer_);
+  const uint32_t records = input->records;
+  uint32_t id = input->id;
+  EXPECT_NE(id, 2U);
+
+  thread::Thread* context = args.context_;
+  storage::array::ArrayStorage array(args.engine_, kName);
+  ASSERT_ND(array.exists());
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint32_t i = 0; i < records / 2U; ++i) {
+    storage::array::ArrayOffset rec = id * records / 2U + i;
+    double value = kDoubleBase + rec * 2.0;
+    WRAP_ERROR_CODE(array.overwrite_record(context, rec, &value, 0, sizeof(value)));
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  for (uint32_t round = 0; round < kDoubleIncrements; ++round) {
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    for (uint32_t i = 0; i < records / 2U; ++i) {
+      storage::array::ArrayOffset rec = id * records / 2U + i;
+      double addendum = kDoubleAddendum;
+      WRAP_ERROR_CODE(array.increment_record_oneshot<double>(context, rec, addendum, 0));
+    }
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  }
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
 ErrorStack two_arrays_task(const proc::ProcArguments& args) {
   EXPECT_EQ(kInput, args.input_len_);
   const TaskInput* input = reinterpret_cast<const TaskInput*>(args.input_buffer_);
@@ -243,9 +316,34 @@ ErrorStack verify_holes_task(const proc::ProcArguments& args) {
   return kRetOk;
 }
 
+ErrorStack verify_double_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(kInput, args.input_len_);
+  const TaskInput* input = reinterpret_cast<const TaskInput*>(args.input_buffer_);
+  const uint32_t records = input->records;
+
+  thread::Thread* context = args.context_;
+  storage::array::ArrayStorage array(args.engine_, kName);
+  ASSERT_ND(array.exists());
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  EXPECT_NE(kDoubleBase, kDoubleBase + kDoubleAddendum * kDoubleIncrements);
+  for (uint32_t i = 0; i < records; ++i) {
+    storage::array::ArrayOffset rec = i;
+    double data = 0;
+    WRAP_ERROR_CODE(array.get_record(context, rec, &data, 0, sizeof(data)));
+    EXPECT_EQ(kDoubleBase + rec * 2.0, data) << i;
+  }
+
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  return kRetOk;
+}
+
 const proc::ProcName kOv("overwrites_task");
 const proc::ProcName kInc("increments_task");
 const proc::ProcName kInc2("increments_twice_task");
+const proc::ProcName kIncOv("increments_overwrites_task");
+const proc::ProcName kIncDouble("increments_double_task");
 const proc::ProcName kTwo("two_arrays_task");
 const proc::ProcName kHoles("overwrites_holes_task");
 
@@ -274,12 +372,21 @@ void test_run(
 
   const uint32_t records = (levels == 1 ? k1LvRecords : kMoreRecords);
   TaskInput input = {0, records};
-  proc::Proc verify_proc = proc_name == kHoles ? verify_holes_task : verify_task;
+  proc::Proc verify_proc = verify_task;
+  if (proc_name == kHoles) {
+    verify_proc = verify_holes_task;
+  } else if (proc_name == kIncDouble) {
+    verify_proc = verify_double_task;
+  }
   {
     Engine engine(options);
     engine.get_proc_manager()->pre_register("overwrites_task", overwrites_task);
     engine.get_proc_manager()->pre_register("increments_task", increments_task);
     engine.get_proc_manager()->pre_register("increments_twice_task", increments_twice_task);
+    engine.get_proc_manager()->pre_register(
+      "increments_overwrites_task",
+      increments_overwrites_task);
+    engine.get_proc_manager()->pre_register("increments_double_task", increments_double_task);
     engine.get_proc_manager()->pre_register("two_arrays_task", two_arrays_task);
     engine.get_proc_manager()->pre_register("overwrites_holes_task", overwrites_holes_task);
     engine.get_proc_manager()->pre_register("verify", verify_proc);
@@ -346,6 +453,12 @@ TEST(SnapshotArrayTest, IncrementsTwoPartitions) { test_run(kInc, true, true, 1)
 TEST(SnapshotArrayTest, IncrementsTwiceOneLogger) { test_run(kInc2, false, false, 1); }
 TEST(SnapshotArrayTest, IncrementsTwiceTwoLoggers) { test_run(kInc2, true, false, 1); }
 TEST(SnapshotArrayTest, IncrementsTwiceTwoPartitions) { test_run(kInc2, true, true, 1); }
+TEST(SnapshotArrayTest, IncOverwritesOneLogger) { test_run(kIncOv, false, false, 1); }
+TEST(SnapshotArrayTest, IncOverwritesTwoLoggers) { test_run(kIncOv, true, false, 1); }
+TEST(SnapshotArrayTest, IncOverwritesTwoPartitions) { test_run(kIncOv, true, true, 1); }
+TEST(SnapshotArrayTest, IncDoubleOneLogger) { test_run(kIncDouble, false, false, 1); }
+TEST(SnapshotArrayTest, IncDoubleTwoLoggers) { test_run(kIncDouble, true, false, 1); }
+TEST(SnapshotArrayTest, IncDoubleTwoPartitions) { test_run(kIncDouble, true, true, 1); }
 TEST(SnapshotArrayTest, TwoArraysOneLogger) { test_run(kTwo, false, false, 1); }
 TEST(SnapshotArrayTest, TwoArraysTwoLoggers) { test_run(kTwo, true, false, 1); }
 TEST(SnapshotArrayTest, TwoArraysTwoPartitions) { test_run(kTwo, true, true, 1); }
@@ -362,6 +475,12 @@ TEST(SnapshotArrayTest, IncrementsTwoPartitions2Lv) { test_run(kInc, true, true,
 TEST(SnapshotArrayTest, IncrementsTwiceOneLogger2Lv) { test_run(kInc2, false, false, 2); }
 TEST(SnapshotArrayTest, IncrementsTwiceTwoLoggers2Lv) { test_run(kInc2, true, false, 2); }
 TEST(SnapshotArrayTest, IncrementsTwiceTwoPartitions2Lv) { test_run(kInc2, true, true, 2); }
+TEST(SnapshotArrayTest, IncOverwritesOneLogger2Lv) { test_run(kIncOv, false, false, 2); }
+TEST(SnapshotArrayTest, IncOverwritesTwoLoggers2Lv) { test_run(kIncOv, true, false, 2); }
+TEST(SnapshotArrayTest, IncOverwritesTwoPartitions2Lv) { test_run(kIncOv, true, true, 2); }
+TEST(SnapshotArrayTest, IncDoubleOneLogger2Lv) { test_run(kIncDouble, false, false, 2); }
+TEST(SnapshotArrayTest, IncDoubleTwoLoggers2Lv) { test_run(kIncDouble, true, false, 2); }
+TEST(SnapshotArrayTest, IncDoubleTwoPartitions2Lv) { test_run(kIncDouble, true, true, 2); }
 TEST(SnapshotArrayTest, TwoArraysOneLogger2Lv) { test_run(kTwo, false, false, 2); }
 TEST(SnapshotArrayTest, TwoArraysTwoLoggers2Lv) { test_run(kTwo, true, false, 2); }
 TEST(SnapshotArrayTest, TwoArraysTwoPartitions2Lv) { test_run(kTwo, true, true, 2); }
@@ -378,6 +497,12 @@ TEST(SnapshotArrayTest, IncrementsTwoPartitions3Lv) { test_run(kInc, true, true,
 TEST(SnapshotArrayTest, IncrementsTwiceOneLogger3Lv) { test_run(kInc2, false, false, 3); }
 TEST(SnapshotArrayTest, IncrementsTwiceTwoLoggers3Lv) { test_run(kInc2, true, false, 3); }
 TEST(SnapshotArrayTest, IncrementsTwiceTwoPartitions3Lv) { test_run(kInc2, true, true, 3); }
+TEST(SnapshotArrayTest, IncOverwritesOneLogger3Lv) { test_run(kIncOv, false, false, 3); }
+TEST(SnapshotArrayTest, IncOverwritesTwoLoggers3Lv) { test_run(kIncOv, true, false, 3); }
+TEST(SnapshotArrayTest, IncOverwritesTwoPartitions3Lv) { test_run(kIncOv, true, true, 3); }
+TEST(SnapshotArrayTest, IncDoubleOneLogger3Lv) { test_run(kIncDouble, false, false, 3); }
+TEST(SnapshotArrayTest, IncDoubleTwoLoggers3Lv) { test_run(kIncDouble, true, false, 3); }
+TEST(SnapshotArrayTest, IncDoubleTwoPartitions3Lv) { test_run(kIncDouble, true, true, 3); }
 TEST(SnapshotArrayTest, TwoArraysOneLogger3Lv) { test_run(kTwo, false, false, 3); }
 TEST(SnapshotArrayTest, TwoArraysTwoLoggers3Lv) { test_run(kTwo, true, false, 3); }
 TEST(SnapshotArrayTest, TwoArraysTwoPartitions3Lv) { test_run(kTwo, true, true, 3); }
@@ -230,6 +230,168 @@ void test_run(
   cleanup_test(options);
 }
 
+/**
+ * Modifications while a resize is pending. Phase-0 inserts the first half, phase-1 overwrites
+ * and inserts, phase-2 deletes, overwrites, upserts, and inserts the rest.
+ * @see verify_resized_task()
+ */
+ErrorStack resize_modify_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(uint32_t), args.input_len_);
+  uint32_t phase = *reinterpret_cast<const uint32_t*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  storage::hash::HashStorage hash(args.engine_, kName);
+  ASSERT_ND(hash.exists());
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+
+  if (phase == 0) {
+    for (uint64_t key = 0; key < kRecords / 2U; ++key) {
+      uint64_t data = key + kDataAddendum;
+      WRAP_ERROR_CODE(hash.insert_record(context, &key, sizeof(key), &data, sizeof(data)));
+    }
+  } else if (phase == 1) {
+    for (uint64_t key = 0; key < kRecords / 8U; ++key) {
+      uint64_t data = key + kDataAddendum * 2U;
+      WRAP_ERROR_CODE(hash.overwrite_record(context, &key, sizeof(key), &data, 0, sizeof(data)));
+    }
+    for (uint64_t key = kRecords / 2U; key < kRecords * 3U / 4U; ++key) {
+      uint64_t data = key + kDataAddendum;
+      WRAP_ERROR_CODE(hash.insert_record(context, &key, sizeof(key), &data, sizeof(data)));
+    }
+  } else {
+    EXPECT_EQ(2U, phase);
+    for (uint64_t key = kRecords / 8U; key < kRecords * 3U / 16U; ++key) {
+      WRAP_ERROR_CODE(hash.delete_record(context, &key, sizeof(key)));
+    }
+    for (uint64_t key = kRecords * 3U / 16U; key < kRecords / 4U; ++key) {
+      uint64_t data = key + kDataAddendum * 2U;
+      WRAP_ERROR_CODE(hash.overwrite_record(context, &key, sizeof(key), &data, 0, sizeof(data)));
+    }
+    for (uint64_t key = kRecords / 4U; key < kRecords * 5U / 16U; ++key) {
+      uint64_t data = key + kDataAddendum * 2U;
+      WRAP_ERROR_CODE(hash.upsert_record(context, &key, sizeof(key), &data, sizeof(data)));
+    }
+    for (uint64_t key = kRecords * 3U / 4U; key < kRecords; ++key) {
+      uint64_t data = key + kDataAddendum;
+      WRAP_ERROR_CODE(hash.insert_record(context, &key, sizeof(key), &data, sizeof(data)));
+    }
+  }
+
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack verify_resized_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(uint8_t), args.input_len_);
+  uint8_t bin_bits = *reinterpret_cast<const uint8_t*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  storage::hash::HashStorage hash(args.engine_, kName);
+  ASSERT_ND(hash.exists());
+  EXPECT_EQ(bin_bits, hash.get_bin_bits());
+  CHECK_ERROR(hash.verify_single_thread(context));
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+
+  for (uint64_t key = 0; key < kRecords; ++key) {
+    uint64_t data;
+    uint16_t capacity = sizeof(data);
+    ErrorCode ret = hash.get_record(context, &key, sizeof(key), &data, &capacity, true);
+    if (key >= kRecords / 8U && key < kRecords * 3U / 16U) {
+      EXPECT_EQ(kErrorCodeStrKeyNotFound, ret) << key;
+    } else if (key < kRecords * 5U / 16U) {
+      EXPECT_EQ(kErrorCodeOk, ret) << key;
+      EXPECT_EQ(key + kDataAddendum * 2U, data) << key;
+    } else {
+      EXPECT_EQ(kErrorCodeOk, ret) << key;
+      EXPECT_EQ(key + kDataAddendum, data) << key;
+    }
+  }
+
+  Epoch commit_epoch;
+  ErrorCode committed = xct_manager->precommit_xct(context, &commit_epoch);
+  EXPECT_EQ(kErrorCodeOk, committed);
+  return kRetOk;
+}
+
+/**
+ * Requests a resize after the first snapshot, then takes a snapshot in the middle of
+ * modifications so that the switch must carry records newer than the snapshot.
+ */
+void test_resize(uint8_t bin_bits, uint8_t new_bin_bits, bool multiple_partitions) {
+  EngineOptions options = get_tiny_options();
+  if (multiple_partitions) {
+    options.thread_.thread_count_per_group_ = 1;
+    options.thread_.group_count_ = 2;
+  }
+  options.log_.loggers_per_node_ = 1;
+  options.memory_.page_pool_size_mb_per_node_ = 20;
+  options.cache_.snapshot_cache_size_mb_per_node_ = 20;
+
+  {
+    Engine engine(options);
+    engine.get_proc_manager()->pre_register("resize_modify_task", resize_modify_task);
+    engine.get_proc_manager()->pre_register("verify_resized_task", verify_resized_task);
+    COERCE_ERROR(engine.initialize());
+    {
+      UninitializeGuard guard(&engine);
+      storage::hash::HashStorage out;
+      Epoch commit_epoch;
+      storage::hash::HashMetadata meta(kName, bin_bits);
+      COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &out, &commit_epoch));
+      EXPECT_TRUE(out.exists());
+      thread::ThreadPool* pool = engine.get_thread_pool();
+      xct::XctManager* xct_manager = engine.get_xct_manager();
+      SnapshotManager* snapshot_manager = engine.get_snapshot_manager();
+
+      uint32_t phase = 0;
+      COERCE_ERROR(pool->impersonate_synchronous("resize_modify_task", &phase, sizeof(phase)));
+      snapshot_manager->trigger_snapshot_immediate(true);
+
+      EXPECT_TRUE(out.request_resize(bin_bits).is_error());
+      COERCE_ERROR(out.request_resize(new_bin_bits));
+      EXPECT_EQ(bin_bits, out.get_bin_bits());
+
+      phase = 1;
+      COERCE_ERROR(pool->impersonate_synchronous("resize_modify_task", &phase, sizeof(phase)));
+      Epoch snapshot_epoch = xct_manager->get_current_global_epoch();
+      xct_manager->advance_current_global_epoch();
+      phase = 2;
+      COERCE_ERROR(pool->impersonate_synchronous("resize_modify_task", &phase, sizeof(phase)));
+
+      // phase-2 is not in this snapshot. The switch must move them to the new bins.
+      snapshot_manager->trigger_snapshot_immediate(true, snapshot_epoch);
+      EXPECT_EQ(new_bin_bits, out.get_bin_bits());
+      COERCE_ERROR(pool->impersonate_synchronous(
+        "verify_resized_task",
+        &new_bin_bits,
+        sizeof(new_bin_bits)));
+
+      snapshot_manager->trigger_snapshot_immediate(true);
+      COERCE_ERROR(pool->impersonate_synchronous(
+        "verify_resized_task",
+        &new_bin_bits,
+        sizeof(new_bin_bits)));
+      COERCE_ERROR(engine.uninitialize());
+    }
+  }
+  {
+    Engine engine(options);
+    engine.get_proc_manager()->pre_register("verify_resized_task", verify_resized_task);
+    COERCE_ERROR(engine.initialize());
+    {
+      UninitializeGuard guard(&engine);
+      COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous(
+        "verify_resized_task",
+        &new_bin_bits,
+        sizeof(new_bin_bits)));
+      COERCE_ERROR(engine.uninitialize());
+    }
+  }
+  cleanup_test(options);
+}
+
 // the hash composer logic significantly differs if it's 1-level. test them separately.
 // 2Lv <-> 3Lv is also slightly different. maybe we should separate it too
 const uint8_t k1Lv = 7;
@@ -260,6 +422,10 @@ TEST(SnapshotHashTest, InsertsVarlenTwoLoggers2Lv) { test_run(kInsV, kVerV, k2Lv
 TEST(SnapshotHashTest, InsertsVarlenTwoPartitions1Lv) { test_run(kInsV, kVerV, k1Lv, true, true); }
 TEST(SnapshotHashTest, InsertsVarlenTwoPartitions2Lv) { test_run(kInsV, kVerV, k2Lv, true, true); }
 
+TEST(SnapshotHashTest, Resize1LvTo2Lv) { test_resize(k1Lv, k2Lv, false); }
+TEST(SnapshotHashTest, ResizeWithinLevel) { test_resize(k1Lv + 1U, k2Lv, false); }
+TEST(SnapshotHashTest, ResizeTwoPartitions) { test_resize(k1Lv, k1Lv + 3U, true); }
+
 }  // namespace snapshot
 }  // namespace foedus
 
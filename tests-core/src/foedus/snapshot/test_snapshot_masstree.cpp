@@ -68,6 +68,29 @@ ErrorStack inserts_normalized_task(const proc::ProcArguments& args) {
   return kRetOk;
 }
 
+/** The first thread bulk-loads the first half, then the second thread inserts the rest. */
+ErrorStack inserts_bulk_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(uint32_t), args.input_len_);
+  uint32_t id = *reinterpret_cast<const uint32_t*>(args.input_buffer_);
+  if (id > 0) {
+    return inserts_normalized_task(args);
+  }
+
+  thread::Thread* context = args.context_;
+  storage::masstree::MasstreeStorage masstree(args.engine_, kName);
+  ASSERT_ND(masstree.exists());
+  storage::masstree::KeySlice slices[kRecords / 2U];
+  uint64_t recs[kRecords / 2U];
+  for (uint32_t i = 0; i < kRecords / 2U; ++i) {
+    recs[i] = i;
+    slices[i] = storage::masstree::normalize_primitive<uint64_t>(recs[i]);
+  }
+  CHECK_ERROR(masstree.bulk_load_normalized(context, kRecords / 2U, slices, recs, sizeof(recs[0])));
+  Epoch durable_epoch = args.engine_->get_xct_manager()->get_current_global_epoch();
+  WRAP_ERROR_CODE(args.engine_->get_xct_manager()->wait_for_commit(durable_epoch));
+  return kRetOk;
+}
+
 ErrorStack verify_task(const proc::ProcArguments& args) {
   thread::Thread* context = args.context_;
   storage::masstree::MasstreeStorage masstree(args.engine_, kName);
@@ -166,6 +189,83 @@ ErrorStack verify_varlen_task(const proc::ProcArguments& args) {
   return kRetOk;
 }
 
+/** The payload of each record after inserts_resize_task. 1, 2, or 3 uint64_t. */
+uint16_t get_resized_count(uint64_t rec) { return (rec % 3U) + 1U; }
+
+ErrorStack inserts_resize_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(uint32_t), args.input_len_);
+  uint32_t id = *reinterpret_cast<const uint32_t*>(args.input_buffer_);
+  EXPECT_NE(id, 2U);
+
+  thread::Thread* context = args.context_;
+  storage::masstree::MasstreeStorage masstree(args.engine_, kName);
+  ASSERT_ND(masstree.exists());
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  Epoch commit_epoch;
+
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint32_t i = 0; i < kRecords / 2U; ++i) {
+    uint64_t rec = id * kRecords / 2U + i;
+    storage::masstree::KeySlice slice = storage::masstree::normalize_primitive<uint64_t>(rec);
+    WRAP_ERROR_CODE(masstree.insert_record_normalized(context, slice, &rec, sizeof(rec)));
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+
+  // Extend all of them. The records are physically too small, so this expands them.
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint32_t i = 0; i < kRecords / 2U; ++i) {
+    uint64_t rec = id * kRecords / 2U + i;
+    storage::masstree::KeySlice slice = storage::masstree::normalize_primitive<uint64_t>(rec);
+    uint64_t appended = rec * 2U;
+    WRAP_ERROR_CODE(masstree.extend_record_normalized(context, slice, &appended, sizeof(rec)));
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+
+  // Then truncate or replace some of them
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint32_t i = 0; i < kRecords / 2U; ++i) {
+    uint64_t rec = id * kRecords / 2U + i;
+    storage::masstree::KeySlice slice = storage::masstree::normalize_primitive<uint64_t>(rec);
+    if (get_resized_count(rec) == 1U) {
+      WRAP_ERROR_CODE(masstree.truncate_record_normalized(context, slice, sizeof(rec)));
+    } else if (get_resized_count(rec) == 3U) {
+      uint64_t data[3] = {rec, rec * 2U, rec * 3U};
+      WRAP_ERROR_CODE(masstree.replace_record_normalized(context, slice, data, sizeof(data)));
+    }
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack verify_resize_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  storage::masstree::MasstreeStorage masstree(args.engine_, kName);
+  ASSERT_ND(masstree.exists());
+  CHECK_ERROR(masstree.verify_single_thread(context));
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+
+  for (uint32_t i = 0; i < kRecords; ++i) {
+    uint64_t rec = i;
+    storage::masstree::KeySlice slice = storage::masstree::normalize_primitive<uint64_t>(rec);
+    uint64_t data[4];
+    uint16_t capacity = sizeof(data);
+    ErrorCode ret = masstree.get_record_normalized(context, slice, data, &capacity, true);
+    EXPECT_EQ(kErrorCodeOk, ret) << i;
+    const uint16_t count = get_resized_count(rec);
+    EXPECT_EQ(sizeof(uint64_t) * count, capacity) << i;
+    for (uint16_t j = 0; j < count && j * sizeof(uint64_t) < capacity; ++j) {
+      EXPECT_EQ(rec * (j + 1U), data[j]) << i << ":" << j;
+    }
+  }
+
+  Epoch commit_epoch;
+  ErrorCode committed = xct_manager->precommit_xct(context, &commit_epoch);
+  EXPECT_EQ(kErrorCodeOk, committed);
+  return kRetOk;
+}
+
 void test_run(
   const proc::ProcName& proc_name,
   const proc::ProcName& verify_name,
@@ -186,8 +286,11 @@ void test_run(
     Engine engine(options);
     engine.get_proc_manager()->pre_register("inserts_normalized_task", inserts_normalized_task);
     engine.get_proc_manager()->pre_register("inserts_varlen_task", inserts_varlen_task);
+    engine.get_proc_manager()->pre_register("inserts_bulk_task", inserts_bulk_task);
     engine.get_proc_manager()->pre_register("verify_task", verify_task);
     engine.get_proc_manager()->pre_register("verify_varlen_task", verify_varlen_task);
+    engine.get_proc_manager()->pre_register("inserts_resize_task", inserts_resize_task);
+    engine.get_proc_manager()->pre_register("verify_resize_task", verify_resize_task);
     COERCE_ERROR(engine.initialize());
     {
       UninitializeGuard guard(&engine);
@@ -220,6 +323,7 @@ void test_run(
     Engine engine(options);
     engine.get_proc_manager()->pre_register("verify_task", verify_task);
     engine.get_proc_manager()->pre_register("verify_varlen_task", verify_varlen_task);
+    engine.get_proc_manager()->pre_register("verify_resize_task", verify_resize_task);
     COERCE_ERROR(engine.initialize());
     {
       UninitializeGuard guard(&engine);
@@ -234,12 +338,21 @@ const proc::ProcName kInsN("inserts_normalized_task");
 const proc::ProcName kInsV("inserts_varlen_task");
 const proc::ProcName kVerN("verify_task");
 const proc::ProcName kVerV("verify_varlen_task");
+const proc::ProcName kInsR("inserts_resize_task");
+const proc::ProcName kInsB("inserts_bulk_task");
+const proc::ProcName kVerR("verify_resize_task");
 TEST(SnapshotMasstreeTest, InsertsNormalizedOneLogger) { test_run(kInsN, kVerN, false, false); }
 TEST(SnapshotMasstreeTest, InsertsNormalizedTwoLoggers) { test_run(kInsN, kVerN, true, false); }
 TEST(SnapshotMasstreeTest, InsertsNormalizedTwoPartitions) { test_run(kInsN, kVerN, true, true); }
 TEST(SnapshotMasstreeTest, InsertsVarlenOneLogger) { test_run(kInsV, kVerV, false, false); }
 TEST(SnapshotMasstreeTest, InsertsVarlenTwoLoggers) { test_run(kInsV, kVerV, true, false); }
 TEST(SnapshotMasstreeTest, InsertsVarlenTwoPartitions) { test_run(kInsV, kVerV, true, true); }
+TEST(SnapshotMasstreeTest, ResizeOneLogger) { test_run(kInsR, kVerR, false, false); }
+TEST(SnapshotMasstreeTest, ResizeTwoLoggers) { test_run(kInsR, kVerR, true, false); }
+TEST(SnapshotMasstreeTest, ResizeTwoPartitions) { test_run(kInsR, kVerR, true, true); }
+TEST(SnapshotMasstreeTest, BulkLoadOneLogger) { test_run(kInsB, kVerN, false, false); }
+TEST(SnapshotMasstreeTest, BulkLoadTwoLoggers) { test_run(kInsB, kVerN, true, false); }
+TEST(SnapshotMasstreeTest, BulkLoadTwoPartitions) { test_run(kInsB, kVerN, true, true); }
 }  // namespace snapshot
 }  // namespace foedus
 
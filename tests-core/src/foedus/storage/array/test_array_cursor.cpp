@@ -0,0 +1,482 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "foedus/engine.hpp"
+#include "foedus/engine_options.hpp"
+#include "foedus/epoch.hpp"
+#include "foedus/test_common.hpp"
+#include "foedus/assorted/assorted_func.hpp"
+#include "foedus/assorted/simd_aggregate.hpp"
+#include "foedus/proc/proc_manager.hpp"
+#include "foedus/snapshot/snapshot_manager.hpp"
+#include "foedus/storage/storage_manager.hpp"
+#include "foedus/storage/array/array_cursor.hpp"
+#include "foedus/storage/array/array_metadata.hpp"
+#include "foedus/storage/array/array_route.hpp"
+#include "foedus/storage/array/array_storage.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/thread/thread_pool.hpp"
+#include "foedus/xct/xct_manager.hpp"
+
+/**
+ * @file test_array_cursor.cpp
+ * Range scans and aggregates with ArrayCursor.
+ */
+namespace foedus {
+namespace storage {
+namespace array {
+DEFINE_TEST_CASE_PACKAGE(ArrayCursorTest, foedus.storage.array);
+
+/** 3 levels with this payload */
+const ArrayOffset kRecords = 20000;
+const StorageName kName("test");
+
+/** Payload of each record. 36 bytes, so the record stride is 56 bytes. */
+struct Payload {
+  uint64_t  counter_;
+  int64_t   delta_;
+  double    amount_;
+  char      filler_[12];
+};
+const uint16_t kPayload = sizeof(Payload);
+const uint16_t kCounterOffset = 0;
+const uint16_t kDeltaOffset = 8;
+const uint16_t kAmountOffset = 16;
+
+/** Values with the sign bit and negative values, to check unsigned/signed comparisons. */
+Payload make_payload(ArrayOffset offset, uint64_t addendum) {
+  Payload payload;
+  std::memset(&payload, 0, sizeof(payload));
+  payload.counter_ = offset * 3U + addendum;
+  if (offset % 5U == 0) {
+    payload.counter_ |= (1ULL << 63);
+  }
+  payload.delta_ = static_cast<int64_t>(offset) * ((offset % 2U) ? -7 : 7);
+  payload.amount_ = offset / 2.0;
+  return payload;
+}
+
+/** Input of scan_task */
+struct ScanParams {
+  xct::IsolationLevel isolation_;
+  ArrayRange          range_;
+  /** added to counter_ of offsets [modified_.begin_, modified_.end_) */
+  ArrayRange          modified_;
+  uint64_t            addendum_;
+};
+
+/** Output of scan_task */
+struct ScanResult {
+  uint32_t  snapshot_pages_;
+  uint32_t  volatile_pages_;
+};
+
+ErrorStack populate_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(ScanParams), args.input_len_);
+  const ScanParams* params = reinterpret_cast<const ScanParams*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  ArrayStorage array(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  const ArrayOffset kBatch = 2000;
+  for (ArrayOffset from = params->modified_.begin_; from < params->modified_.end_; from += kBatch) {
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    for (ArrayOffset offset = from; offset < from + kBatch && offset < params->modified_.end_;
+        ++offset) {
+      Payload payload = make_payload(offset, params->addendum_);
+      WRAP_ERROR_CODE(array.overwrite_record(context, offset, &payload));
+    }
+    Epoch commit_epoch;
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+    WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  }
+  return kRetOk;
+}
+
+uint64_t expected_addendum(const ScanParams& params, ArrayOffset offset) {
+  return params.modified_.contains(offset) ? params.addendum_ : 0;
+}
+
+ErrorStack scan_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(ScanParams), args.input_len_);
+  const ScanParams* params = reinterpret_cast<const ScanParams*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  ArrayStorage array(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, params->isolation_));
+
+  ScanResult* result = reinterpret_cast<ScanResult*>(args.output_buffer_);
+  EXPECT_GE(args.output_buffer_size_, sizeof(ScanResult));
+  result->snapshot_pages_ = 0;
+  result->volatile_pages_ = 0;
+
+  ArrayCursor cursor(context, array);
+  WRAP_ERROR_CODE(cursor.open(params->range_));
+  ArrayOffset next = params->range_.begin_;
+  while (cursor.is_valid_page()) {
+    const ArrayRange& page_range = cursor.get_page_range();
+    EXPECT_EQ(next, page_range.begin_);
+    EXPECT_LT(page_range.begin_, page_range.end_);
+    EXPECT_LE(page_range.end_, params->range_.end_);
+    EXPECT_EQ(page_range.end_ - page_range.begin_, cursor.get_record_count());
+    if (cursor.is_snapshot_page()) {
+      ++result->snapshot_pages_;
+    } else {
+      ++result->volatile_pages_;
+    }
+    for (uint16_t i = 0; i < cursor.get_record_count(); ++i) {
+      const ArrayOffset offset = page_range.begin_ + i;
+      Payload payload;
+      std::memcpy(&payload, cursor.get_payload(i), sizeof(payload));
+      Payload expected = make_payload(offset, expected_addendum(*params, offset));
+      EXPECT_EQ(expected.counter_, payload.counter_) << offset;
+      EXPECT_EQ(expected.delta_, payload.delta_) << offset;
+      EXPECT_EQ(expected.amount_, payload.amount_) << offset;
+      if (i > 0) {
+        EXPECT_EQ(cursor.get_payload(i - 1) + cursor.get_record_stride(), cursor.get_payload(i));
+      }
+    }
+    next = page_range.end_;
+    WRAP_ERROR_CODE(cursor.next_page());
+  }
+  EXPECT_EQ(params->range_.end_, next);
+  EXPECT_FALSE(cursor.is_valid_page());
+
+  assorted::SimdAggregate<uint64_t> counters;
+  assorted::SimdAggregate<int64_t> deltas;
+  assorted::SimdAggregate<double> amounts;
+  WRAP_ERROR_CODE(cursor.open(params->range_));
+  WRAP_ERROR_CODE(cursor.aggregate(kCounterOffset, &counters));
+  EXPECT_FALSE(cursor.is_valid_page());
+  WRAP_ERROR_CODE(cursor.open(params->range_));
+  WRAP_ERROR_CODE(cursor.aggregate(kDeltaOffset, &deltas));
+  WRAP_ERROR_CODE(cursor.open(params->range_));
+  WRAP_ERROR_CODE(cursor.aggregate(kAmountOffset, &amounts));
+
+  assorted::SimdAggregate<uint64_t> expected_counters;
+  assorted::SimdAggregate<int64_t> expected_deltas;
+  assorted::SimdAggregate<double> expected_amounts;
+  for (ArrayOffset offset = params->range_.begin_; offset < params->range_.end_; ++offset) {
+    Payload expected = make_payload(offset, expected_addendum(*params, offset));
+    expected_counters.sum_ += expected.counter_;
+    expected_counters.min_ = std::min(expected_counters.min_, expected.counter_);
+    expected_counters.max_ = std::max(expected_counters.max_, expected.counter_);
+    expected_deltas.sum_ += expected.delta_;
+    expected_deltas.min_ = std::min(expected_deltas.min_, expected.delta_);
+    expected_deltas.max_ = std::max(expected_deltas.max_, expected.delta_);
+    expected_amounts.sum_ += expected.amount_;
+    expected_amounts.min_ = std::min(expected_amounts.min_, expected.amount_);
+    expected_amounts.max_ = std::max(expected_amounts.max_, expected.amount_);
+  }
+  const uint64_t count = params->range_.end_ - params->range_.begin_;
+  EXPECT_EQ(count, counters.count_);
+  EXPECT_EQ(count, deltas.count_);
+  EXPECT_EQ(count, amounts.count_);
+  EXPECT_EQ(expected_counters.sum_, counters.sum_);
+  EXPECT_EQ(expected_deltas.sum_, deltas.sum_);
+  EXPECT_EQ(expected_amounts.sum_, amounts.sum_);  // all values are exact in double
+  if (count > 0) {
+    EXPECT_EQ(expected_counters.min_, counters.min_);
+    EXPECT_EQ(expected_counters.max_, counters.max_);
+    EXPECT_EQ(expected_deltas.min_, deltas.min_);
+    EXPECT_EQ(expected_deltas.max_, deltas.max_);
+    EXPECT_EQ(expected_amounts.min_, amounts.min_);
+    EXPECT_EQ(expected_amounts.max_, amounts.max_);
+  }
+
+  Epoch commit_epoch;
+  EXPECT_EQ(kErrorCodeOk, xct_manager->precommit_xct(context, &commit_epoch));
+  *args.output_used_ = sizeof(ScanResult);
+  return kRetOk;
+}
+
+ErrorStack invalid_range_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  ArrayStorage array(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  ArrayCursor cursor(context, array);
+  EXPECT_EQ(kErrorCodeInvalidParameter, cursor.open(ArrayRange(0, kRecords + 1U)));
+  EXPECT_EQ(kErrorCodeInvalidParameter, cursor.open(ArrayRange(10, 9)));
+  EXPECT_FALSE(cursor.is_valid_page());
+  WRAP_ERROR_CODE(cursor.open(ArrayRange(kRecords, kRecords)));
+  EXPECT_FALSE(cursor.is_valid_page());
+  WRAP_ERROR_CODE(cursor.next_page());
+  EXPECT_FALSE(cursor.is_valid_page());
+  assorted::SimdAggregate<uint64_t> counters;
+  WRAP_ERROR_CODE(cursor.aggregate(kCounterOffset, &counters));
+  EXPECT_EQ(0U, counters.count_);
+  WRAP_ERROR_CODE(xct_manager->abort_xct(context));
+  return kRetOk;
+}
+
+ScanResult scan(Engine* engine, const ScanParams& params) {
+  thread::ImpersonateSession session;
+  EXPECT_TRUE(engine->get_thread_pool()->impersonate(
+    "scan_task",
+    &params,
+    sizeof(params),
+    &session));
+  COERCE_ERROR(session.get_result());
+  ScanResult result;
+  EXPECT_EQ(sizeof(result), session.get_output_size());
+  session.get_output(&result);
+  session.release();
+  return result;
+}
+
+/** Scans the whole array and a few partial ranges in each isolation level. */
+void scan_all(Engine* engine, const ArrayRange& modified, uint64_t addendum) {
+  const ArrayRange kRanges[] = {
+    ArrayRange(0, kRecords),
+    ArrayRange(0, 1),
+    ArrayRange(kRecords - 1U, kRecords),
+    ArrayRange(123, 4567),
+    ArrayRange(7777, 7777),
+  };
+  const xct::IsolationLevel kIsolations[] = {xct::kSerializable, xct::kSnapshot, xct::kDirtyRead};
+  for (const ArrayRange& range : kRanges) {
+    for (xct::IsolationLevel isolation : kIsolations) {
+      ScanParams params = {isolation, range, modified, addendum};
+      scan(engine, params);
+    }
+  }
+}
+
+void populate(Engine* engine, const ArrayRange& modified, uint64_t addendum) {
+  ScanParams params = {xct::kSerializable, ArrayRange(), modified, addendum};
+  COERCE_ERROR(engine->get_thread_pool()->impersonate_synchronous(
+    "populate_task",
+    &params,
+    sizeof(params)));
+}
+
+EngineOptions make_options() {
+  EngineOptions options = get_tiny_options();
+  options.log_.loggers_per_node_ = 1;
+  options.memory_.page_pool_size_mb_per_node_ = 20;
+  options.cache_.snapshot_cache_size_mb_per_node_ = 20;
+  // so that the logs of all records fit in one reducer buffer
+  options.snapshot_.log_reducer_buffer_mb_ = 16;
+  // a serializable scan over all records takes read-set for each of them
+  options.xct_.max_read_set_size_ = kRecords * 4U;
+  return options;
+}
+
+void register_tasks(Engine* engine);
+
+/** Creates the array. Keeps only the root volatile page after snapshots. */
+void create(Engine* engine) {
+  ArrayMetadata meta(kName, kPayload, kRecords);
+  meta.snapshot_drop_volatile_pages_threshold_ = 1;
+  ArrayStorage storage;
+  Epoch epoch;
+  COERCE_ERROR(engine->get_storage_manager()->create_array(&meta, &storage, &epoch));
+  EXPECT_EQ(3U, storage.get_levels());
+}
+
+TEST(ArrayCursorTest, Empty) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create(&engine);
+    thread::ImpersonateSession session;
+    EXPECT_TRUE(engine.get_thread_pool()->impersonate(
+      "invalid_range_task",
+      nullptr,
+      0,
+      &session));
+    COERCE_ERROR(session.get_result());
+    session.release();
+    ScanParams params = {xct::kSerializable, ArrayRange(0, 0), ArrayRange(), 0};
+    ScanResult result = scan(&engine, params);
+    EXPECT_EQ(0U, result.snapshot_pages_ + result.volatile_pages_);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(ArrayCursorTest, Volatile) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create(&engine);
+    const ArrayRange all(0, kRecords);
+    populate(&engine, all, 0);
+    scan_all(&engine, all, 0);
+    ScanParams params = {xct::kSerializable, all, all, 0};
+    ScanResult result = scan(&engine, params);
+    EXPECT_EQ(0U, result.snapshot_pages_);
+    EXPECT_EQ(assorted::int_div_ceil(kRecords, to_records_in_leaf(kPayload)),
+      result.volatile_pages_);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(ArrayCursorTest, Snapshot) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create(&engine);
+    const ArrayRange all(0, kRecords);
+    populate(&engine, all, 0);
+    engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+    // volatile pages except the root are dropped now. all records are read from snapshot pages.
+    scan_all(&engine, all, 0);
+    ScanParams params = {xct::kSerializable, all, all, 0};
+    ScanResult result = scan(&engine, params);
+    EXPECT_EQ(0U, result.volatile_pages_);
+    EXPECT_GT(result.snapshot_pages_, 0U);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(ArrayCursorTest, Mixed) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create(&engine);
+    const ArrayRange all(0, kRecords);
+    populate(&engine, all, 0);
+    engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+
+    // then some pages get volatile pages again.
+    const uint64_t kAddendum = 1000;
+    const ArrayRange modified(5000, 5300);
+    populate(&engine, modified, kAddendum);
+    scan_all(&engine, modified, kAddendum);
+    ScanParams params = {xct::kSerializable, all, modified, kAddendum};
+    ScanResult result = scan(&engine, params);
+    EXPECT_GT(result.volatile_pages_, 0U);
+    EXPECT_GT(result.snapshot_pages_, 0U);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+std::atomic<int> concurrent_phase;  // 0: started, 1: scanned, 2: overwritten
+ErrorCode concurrent_result;
+
+ErrorStack concurrent_scan_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  ArrayStorage array(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  ArrayCursor cursor(context, array);
+  WRAP_ERROR_CODE(cursor.open(ArrayRange(1000, 2000)));
+  assorted::SimdAggregate<uint64_t> counters;
+  WRAP_ERROR_CODE(cursor.aggregate(kCounterOffset, &counters));
+  EXPECT_EQ(1000U, counters.count_);
+
+  concurrent_phase.store(1);
+  while (concurrent_phase.load() != 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  Epoch commit_epoch;
+  concurrent_result = xct_manager->precommit_xct(context, &commit_epoch);
+  return kRetOk;
+}
+
+ErrorStack concurrent_overwrite_task(const proc::ProcArguments& args) {
+  while (concurrent_phase.load() != 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const ArrayOffset offset = *reinterpret_cast<const ArrayOffset*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  ArrayStorage array(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  WRAP_ERROR_CODE(array.overwrite_record_primitive<uint64_t>(context, offset, 42U, 0));
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  concurrent_phase.store(2);
+  return kRetOk;
+}
+
+void test_concurrent(ArrayOffset offset, ErrorCode expected) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create(&engine);
+    populate(&engine, ArrayRange(0, kRecords), 0);
+
+    concurrent_phase.store(0);
+    concurrent_result = kErrorCodeOk;
+    thread::ImpersonateSession scan_session;
+    thread::ImpersonateSession overwrite_session;
+    EXPECT_TRUE(engine.get_thread_pool()->impersonate(
+      "concurrent_scan_task",
+      nullptr,
+      0,
+      &scan_session));
+    EXPECT_TRUE(engine.get_thread_pool()->impersonate(
+      "concurrent_overwrite_task",
+      &offset,
+      sizeof(offset),
+      &overwrite_session));
+    COERCE_ERROR(scan_session.get_result());
+    COERCE_ERROR(overwrite_session.get_result());
+    scan_session.release();
+    overwrite_session.release();
+    EXPECT_EQ(expected, concurrent_result);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(ArrayCursorTest, ConflictInRange) { test_concurrent(1999, kErrorCodeXctRaceAbort); }
+TEST(ArrayCursorTest, ConflictOutOfRange) { test_concurrent(2000, kErrorCodeOk); }
+
+void register_tasks(Engine* engine) {
+  engine->get_proc_manager()->pre_register("populate_task", populate_task);
+  engine->get_proc_manager()->pre_register("scan_task", scan_task);
+  engine->get_proc_manager()->pre_register("invalid_range_task", invalid_range_task);
+  engine->get_proc_manager()->pre_register("concurrent_scan_task", concurrent_scan_task);
+  engine->get_proc_manager()->pre_register("concurrent_overwrite_task", concurrent_overwrite_task);
+}
+
+}  // namespace array
+}  // namespace storage
+}  // namespace foedus
+
+TEST_MAIN_CAPTURE_SIGNALS(ArrayCursorTest, foedus.storage.array);
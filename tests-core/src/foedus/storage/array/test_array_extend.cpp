@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <gtest/gtest.h>
+
+#include "foedus/engine.hpp"
+#include "foedus/engine_options.hpp"
+#include "foedus/epoch.hpp"
+#include "foedus/test_common.hpp"
+#include "foedus/proc/proc_manager.hpp"
+#include "foedus/snapshot/snapshot_manager.hpp"
+#include "foedus/storage/storage_manager.hpp"
+#include "foedus/storage/array/array_metadata.hpp"
+#include "foedus/storage/array/array_storage.hpp"
+#include "foedus/storage/array/array_storage_pimpl.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/thread/thread_pool.hpp"
+#include "foedus/xct/xct_manager.hpp"
+
+/**
+ * @file test_array_extend.cpp
+ * ArrayStorage::extend() on volatile pages, snapshot pages, and after restart.
+ */
+namespace foedus {
+namespace storage {
+namespace array {
+DEFINE_TEST_CASE_PACKAGE(ArrayExtendTest, foedus.storage.array);
+
+const uint16_t kPayload = sizeof(ArrayOffset);
+const uint64_t kRecordsInLeaf = to_records_in_leaf(kPayload);
+const StorageName kName("test");
+
+/** [begin, end) of the records to write or verify */
+struct TaskInput {
+  ArrayOffset begin;
+  ArrayOffset end;
+};
+const uint32_t kInput = sizeof(TaskInput);
+
+ErrorStack write_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(kInput, args.input_len_);
+  const TaskInput* input = reinterpret_cast<const TaskInput*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  ArrayStorage array(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (ArrayOffset i = input->begin; i < input->end; ++i) {
+    ArrayOffset value = i * 3U + 1U;
+    WRAP_ERROR_CODE(array.overwrite_record_primitive<ArrayOffset>(context, i, value, 0));
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack verify_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(kInput, args.input_len_);
+  const TaskInput* input = reinterpret_cast<const TaskInput*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  ArrayStorage array(args.engine_, kName);
+  EXPECT_EQ(input->end, array.get_array_size());
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (ArrayOffset i = input->begin; i < input->end; ++i) {
+    ArrayOffset value = 0;
+    WRAP_ERROR_CODE(array.get_record_primitive<ArrayOffset>(context, i, &value, 0));
+    EXPECT_EQ(i * 3U + 1U, value) << i;
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  return kRetOk;
+}
+
+/**
+ * Writes all records, extends the array, then writes all records in the new range.
+ * @param snapshot_before whether we take a snapshot before extend()
+ */
+void test_run(ArrayOffset old_size, ArrayOffset new_size, bool snapshot_before) {
+  EngineOptions options = get_tiny_options();
+  options.log_.log_buffer_kb_ = 1 << 10;
+  TaskInput old_range = {0, old_size};
+  TaskInput new_range = {old_size, new_size};
+  TaskInput all_range = {0, new_size};
+  {
+    Engine engine(options);
+    engine.get_proc_manager()->pre_register("write_task", write_task);
+    engine.get_proc_manager()->pre_register("verify_task", verify_task);
+    COERCE_ERROR(engine.initialize());
+    {
+      UninitializeGuard guard(&engine);
+      ArrayMetadata meta(kName, kPayload, old_size);
+      ArrayStorage storage;
+      Epoch epoch;
+      COERCE_ERROR(engine.get_storage_manager()->create_array(&meta, &storage, &epoch));
+      const uint8_t old_levels = storage.get_levels();
+      thread::ThreadPool* pool = engine.get_thread_pool();
+      COERCE_ERROR(pool->impersonate_synchronous("write_task", &old_range, kInput));
+      if (snapshot_before) {
+        engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+      }
+
+      COERCE_ERROR(storage.extend(new_size, &epoch));
+      EXPECT_TRUE(epoch.is_valid());
+      EXPECT_EQ(new_size, storage.get_array_size());
+      EXPECT_EQ(calculate_levels(new_size, kPayload), storage.get_levels());
+      EXPECT_GE(storage.get_levels(), old_levels);
+      EXPECT_TRUE(storage.extend(old_size, &epoch).is_error());  // can't shrink
+
+      COERCE_ERROR(pool->impersonate_synchronous("write_task", &new_range, kInput));
+      COERCE_ERROR(pool->impersonate_synchronous("verify_task", &all_range, kInput));
+      engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+      COERCE_ERROR(pool->impersonate_synchronous("verify_task", &all_range, kInput));
+      COERCE_ERROR(engine.uninitialize());
+    }
+  }
+  {
+    Engine engine(options);
+    engine.get_proc_manager()->pre_register("verify_task", verify_task);
+    COERCE_ERROR(engine.initialize());
+    {
+      UninitializeGuard guard(&engine);
+      COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous(
+        "verify_task",
+        &all_range,
+        kInput));
+      COERCE_ERROR(engine.uninitialize());
+    }
+  }
+  cleanup_test(options);
+}
+
+const ArrayOffset k1LvSize = kRecordsInLeaf / 2U;
+const ArrayOffset k2LvSize = kRecordsInLeaf * 3U + kRecordsInLeaf / 2U;
+const ArrayOffset k2LvLargerSize = kRecordsInLeaf * 10U + 7U;
+const ArrayOffset k3LvSize = kRecordsInLeaf * kInteriorFanout + kRecordsInLeaf * 2U + 3U;
+
+TEST(ArrayExtendTest, SameLevels) { test_run(k2LvSize, k2LvLargerSize, false); }
+TEST(ArrayExtendTest, SameLevelsSnapshot) { test_run(k2LvSize, k2LvLargerSize, true); }
+TEST(ArrayExtendTest, SingleLevel) { test_run(k1LvSize, k1LvSize + 5U, true); }
+TEST(ArrayExtendTest, AddLevel) { test_run(k1LvSize, k2LvSize, false); }
+TEST(ArrayExtendTest, AddLevelSnapshot) { test_run(k1LvSize, k2LvSize, true); }
+TEST(ArrayExtendTest, AddTwoLevelsSnapshot) { test_run(k1LvSize, k3LvSize, true); }
+TEST(ArrayExtendTest, AddLevelFromTwoLevelsSnapshot) { test_run(k2LvSize, k3LvSize, true); }
+
+}  // namespace array
+}  // namespace storage
+}  // namespace foedus
+
+TEST_MAIN_CAPTURE_SIGNALS(ArrayExtendTest, foedus.storage.array);
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <gtest/gtest.h>
+
+#include "foedus/engine.hpp"
+#include "foedus/engine_options.hpp"
+#include "foedus/epoch.hpp"
+#include "foedus/test_common.hpp"
+#include "foedus/memory/engine_memory.hpp"
+#include "foedus/memory/page_resolver.hpp"
+#include "foedus/proc/proc_manager.hpp"
+#include "foedus/snapshot/snapshot_manager.hpp"
+#include "foedus/storage/storage_manager.hpp"
+#include "foedus/storage/array/array_metadata.hpp"
+#include "foedus/storage/array/array_page_impl.hpp"
+#include "foedus/storage/array/array_storage.hpp"
+#include "foedus/storage/array/array_storage_pimpl.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/thread/thread_pool.hpp"
+#include "foedus/xct/xct_manager.hpp"
+
+/**
+ * @file test_array_placement.cpp
+ * Placement policies of ArrayStorage: which NUMA node holds each volatile page.
+ */
+namespace foedus {
+namespace storage {
+namespace array {
+DEFINE_TEST_CASE_PACKAGE(ArrayPlacementTest, foedus.storage.array);
+
+const uint16_t kPayload = 3000;  // 1 record per page.
+const ArrayOffset kSize = 100;  // 2 levels. root has 100 direct children, one leaf each.
+const StorageName kName("test");
+
+/** [begin, end) of the records to write or verify */
+struct TaskInput {
+  ArrayOffset begin;
+  ArrayOffset end;
+};
+const uint32_t kInput = sizeof(TaskInput);
+
+ErrorStack write_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(kInput, args.input_len_);
+  const TaskInput* input = reinterpret_cast<const TaskInput*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  ArrayStorage array(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (ArrayOffset i = input->begin; i < input->end; ++i) {
+    uint64_t value = i * 3U + 1U;
+    WRAP_ERROR_CODE(array.overwrite_record_primitive<uint64_t>(context, i, value, 0));
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack verify_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(kInput, args.input_len_);
+  const TaskInput* input = reinterpret_cast<const TaskInput*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  ArrayStorage array(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (ArrayOffset i = input->begin; i < input->end; ++i) {
+    uint64_t value = 0;
+    WRAP_ERROR_CODE(array.get_record_primitive<uint64_t>(context, i, &value, 0));
+    EXPECT_EQ(i * 3U + 1U, value) << i;
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  return kRetOk;
+}
+
+/** Number of volatile leaf pages on each node, and how many of them are not on the owner. */
+struct Placement {
+  uint64_t on_node_[2];
+  uint64_t misplaced_;
+};
+
+Placement count_leaves(Engine* engine, ArrayStorage* storage) {
+  Placement ret = {{0, 0}, 0};
+  ArrayStoragePimpl pimpl(storage);
+  const memory::GlobalVolatilePageResolver& resolver
+    = engine->get_memory_manager()->get_global_volatile_page_resolver();
+  VolatilePagePointer root_ptr
+    = storage->get_control_block()->root_page_pointer_.volatile_pointer_;
+  ArrayPage* root = reinterpret_cast<ArrayPage*>(resolver.resolve_offset(root_ptr));
+  EXPECT_EQ(1U, root->get_level());
+  for (uint16_t i = 0; i < kInteriorFanout; ++i) {
+    VolatilePagePointer pointer = root->get_interior_record(i).volatile_pointer_;
+    if (pointer.is_null()) {
+      continue;
+    }
+    ArrayPage* page = reinterpret_cast<ArrayPage*>(resolver.resolve_offset(pointer));
+    EXPECT_FALSE(page->header().snapshot_);
+    EXPECT_EQ(pointer.word, page->header().page_id_);
+    ++ret.on_node_[pointer.get_numa_node()];
+    if (storage->get_array_metadata()->has_placement()
+      && pimpl.get_owner_node(page->get_array_range().begin_) != pointer.get_numa_node()) {
+      ++ret.misplaced_;
+    }
+  }
+  return ret;
+}
+
+/** All writes come from node-0. Pages go to node-1 only when the placement says so. */
+void test_run(ArrayPlacement placement, ArrayOffset extend_size) {
+  EngineOptions options = get_tiny_options();
+  options.log_.log_buffer_kb_ = 1 << 10;
+  options.thread_.group_count_ = 2;
+  options.memory_.page_pool_size_mb_per_node_ = 4;
+  const ArrayOffset final_size = extend_size ? extend_size : kSize;
+  TaskInput old_range = {0, kSize};
+  TaskInput new_range = {kSize, final_size};
+  TaskInput all_range = {0, final_size};
+  {
+    Engine engine(options);
+    engine.get_proc_manager()->pre_register("write_task", write_task);
+    engine.get_proc_manager()->pre_register("verify_task", verify_task);
+    COERCE_ERROR(engine.initialize());
+    {
+      UninitializeGuard guard(&engine);
+      ArrayMetadata meta(kName, kPayload, kSize);
+      meta.placement_ = placement;
+      ArrayStorage storage;
+      Epoch epoch;
+      COERCE_ERROR(engine.get_storage_manager()->create_array(&meta, &storage, &epoch));
+      EXPECT_EQ(2U, storage.get_levels());
+      thread::ThreadPool* pool = engine.get_thread_pool();
+      COERCE_ERROR(pool->impersonate_on_numa_node_synchronous(0, "write_task", &old_range, kInput));
+      Placement before = count_leaves(&engine, &storage);
+      if (placement == kArrayPlacementFirstTouch) {
+        EXPECT_EQ(kSize, before.on_node_[0]);
+        EXPECT_EQ(0U, before.on_node_[1]);
+      } else {
+        EXPECT_EQ(kSize / 2U, before.on_node_[0]);
+        EXPECT_EQ(kSize / 2U, before.on_node_[1]);
+      }
+      EXPECT_EQ(0U, before.misplaced_);
+
+      if (extend_size) {
+        // With more direct children in the root page, the upper half of the old pages now
+        // belongs to node-0. The snapshot below moves them.
+        COERCE_ERROR(storage.extend(extend_size, &epoch));
+        Placement extended = count_leaves(&engine, &storage);
+        EXPECT_EQ(kSize / 2U, extended.misplaced_);
+        COERCE_ERROR(pool->impersonate_on_numa_node_synchronous(
+          0,
+          "write_task",
+          &new_range,
+          kInput));
+      }
+
+      engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+      if (placement == kArrayPlacementPartitioner && !extend_size) {
+        EXPECT_TRUE(storage.get_control_block()->placement_owners_valid_);
+      }
+      Placement after = count_leaves(&engine, &storage);
+      EXPECT_EQ(final_size, after.on_node_[0] + after.on_node_[1]);
+      if (placement != kArrayPlacementFirstTouch) {
+        EXPECT_EQ(final_size / 2U, after.on_node_[0]);
+        EXPECT_EQ(final_size / 2U, after.on_node_[1]);
+      }
+      EXPECT_EQ(0U, after.misplaced_);
+      COERCE_ERROR(pool->impersonate_on_numa_node_synchronous(
+        0,
+        "verify_task",
+        &all_range,
+        kInput));
+      COERCE_ERROR(engine.uninitialize());
+    }
+  }
+  {
+    Engine engine(options);
+    engine.get_proc_manager()->pre_register("write_task", write_task);
+    engine.get_proc_manager()->pre_register("verify_task", verify_task);
+    COERCE_ERROR(engine.initialize());
+    {
+      UninitializeGuard guard(&engine);
+      ArrayStorage storage(&engine, kName);
+      EXPECT_EQ(static_cast<int>(placement), storage.get_array_metadata()->placement_);
+      thread::ThreadPool* pool = engine.get_thread_pool();
+      COERCE_ERROR(pool->impersonate_on_numa_node_synchronous(0, "write_task", &all_range, kInput));
+      EXPECT_EQ(0U, count_leaves(&engine, &storage).misplaced_);
+      COERCE_ERROR(pool->impersonate_on_numa_node_synchronous(
+        0,
+        "verify_task",
+        &all_range,
+        kInput));
+      COERCE_ERROR(engine.uninitialize());
+    }
+  }
+  cleanup_test(options);
+}
+
+TEST(ArrayPlacementTest, FirstTouch) { test_run(kArrayPlacementFirstTouch, 0); }
+TEST(ArrayPlacementTest, Range) { test_run(kArrayPlacementRange, 0); }
+TEST(ArrayPlacementTest, RangeExtend) { test_run(kArrayPlacementRange, kSize * 2U); }
+TEST(ArrayPlacementTest, Partitioner) { test_run(kArrayPlacementPartitioner, 0); }
+
+}  // namespace array
+}  // namespace storage
+}  // namespace foedus
+
+TEST_MAIN_CAPTURE_SIGNALS(ArrayPlacementTest, foedus.storage.array);
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "foedus/engine.hpp"
+#include "foedus/engine_options.hpp"
+#include "foedus/epoch.hpp"
+#include "foedus/test_common.hpp"
+#include "foedus/proc/proc_manager.hpp"
+#include "foedus/snapshot/snapshot_manager.hpp"
+#include "foedus/storage/storage_manager.hpp"
+#include "foedus/storage/array/array_cursor.hpp"
+#include "foedus/storage/array/array_metadata.hpp"
+#include "foedus/storage/array/array_storage.hpp"
+#include "foedus/storage/array/array_storage_pimpl.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/thread/thread_pool.hpp"
+#include "foedus/xct/xct_manager.hpp"
+
+/**
+ * @file test_array_sparse.cpp
+ * Sparse ArrayStorage: never-written pages are not materialized and read as the default value.
+ */
+namespace foedus {
+namespace storage {
+namespace array {
+DEFINE_TEST_CASE_PACKAGE(ArraySparseTest, foedus.storage.array);
+
+const uint16_t kPayload = sizeof(ArrayOffset);
+const uint64_t kRecordsInLeaf = to_records_in_leaf(kPayload);
+const StorageName kName("test");
+const uint64_t kDefault = 0x0102030405060708ULL;
+/** We write one record in every kWriteEvery-th leaf page */
+const uint64_t kWriteEvery = 5U;
+const uint16_t kIndexInPage = 3U;
+
+/** [begin, end) of the offsets to write or verify */
+struct TaskInput {
+  ArrayOffset begin;
+  ArrayOffset end;
+};
+const uint32_t kInput = sizeof(TaskInput);
+
+bool is_written(ArrayOffset offset) {
+  return (offset / kRecordsInLeaf) % kWriteEvery == 1U && offset % kRecordsInLeaf == kIndexInPage;
+}
+
+ErrorStack write_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(kInput, args.input_len_);
+  const TaskInput* input = reinterpret_cast<const TaskInput*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  ArrayStorage array(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (ArrayOffset i = input->begin; i < input->end; ++i) {
+    if (is_written(i)) {
+      ArrayOffset value = i * 3U + 1U;
+      WRAP_ERROR_CODE(array.overwrite_record_primitive<ArrayOffset>(context, i, value, 0));
+    }
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack verify_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(kInput, args.input_len_);
+  const TaskInput* input = reinterpret_cast<const TaskInput*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  ArrayStorage array(args.engine_, kName);
+  EXPECT_TRUE(array.get_array_metadata()->is_sparse());
+  EXPECT_EQ(kDefault, array.get_array_metadata()->default_value_);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  uint64_t written_pages = 0;
+  for (ArrayOffset i = input->begin; i < input->end; ++i) {
+    ArrayOffset value = 0;
+    WRAP_ERROR_CODE(array.get_record_primitive<ArrayOffset>(context, i, &value, 0));
+    if (is_written(i)) {
+      EXPECT_EQ(i * 3U + 1U, value) << i;
+      ++written_pages;
+    } else {
+      EXPECT_EQ(kDefault, value) << i;
+    }
+  }
+
+  // the cursor visits only the pages we have written.
+  ArrayCursor cursor(context, array);
+  WRAP_ERROR_CODE(cursor.open(ArrayRange(input->begin, input->end)));
+  uint64_t visited_pages = 0;
+  ArrayOffset prev_end = input->begin;
+  while (cursor.is_valid_page()) {
+    const ArrayRange& page_range = cursor.get_page_range();
+    EXPECT_GE(page_range.begin_, prev_end);
+    for (uint16_t i = 0; i < cursor.get_record_count(); ++i) {
+      const ArrayOffset offset = page_range.begin_ + i;
+      ArrayOffset value;
+      std::memcpy(&value, cursor.get_payload(i), sizeof(value));
+      if (is_written(offset)) {
+        EXPECT_EQ(offset * 3U + 1U, value) << offset;
+      } else {
+        EXPECT_EQ(kDefault, value) << offset;
+      }
+    }
+    ++visited_pages;
+    prev_end = page_range.end_;
+    WRAP_ERROR_CODE(cursor.next_page());
+  }
+  EXPECT_EQ(written_pages, visited_pages);
+
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  return kRetOk;
+}
+
+/**
+ * Writes a few records in a sparse array and reads all of them back.
+ * @param snapshot whether we take a snapshot and verify again after restart
+ * @param extend_size if non-zero, we extend() the array after the snapshot
+ */
+void test_run(ArrayOffset size, bool snapshot, ArrayOffset extend_size) {
+  EngineOptions options = get_tiny_options();
+  options.log_.log_buffer_kb_ = 1 << 10;
+  const ArrayOffset final_size = extend_size ? extend_size : size;
+  TaskInput old_range = {0, size};
+  TaskInput new_range = {size, final_size};
+  TaskInput all_range = {0, final_size};
+  {
+    Engine engine(options);
+    engine.get_proc_manager()->pre_register("write_task", write_task);
+    engine.get_proc_manager()->pre_register("verify_task", verify_task);
+    COERCE_ERROR(engine.initialize());
+    {
+      UninitializeGuard guard(&engine);
+      ArrayMetadata meta(kName, kPayload, size);
+      meta.sparse_ = 1;
+      meta.default_value_ = kDefault;
+      ArrayStorage storage;
+      Epoch epoch;
+      COERCE_ERROR(engine.get_storage_manager()->create_array(&meta, &storage, &epoch));
+      thread::ThreadPool* pool = engine.get_thread_pool();
+      COERCE_ERROR(pool->impersonate_synchronous("verify_task", &old_range, kInput));
+      COERCE_ERROR(pool->impersonate_synchronous("write_task", &old_range, kInput));
+      COERCE_ERROR(pool->impersonate_synchronous("verify_task", &old_range, kInput));
+      if (snapshot) {
+        engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+        COERCE_ERROR(pool->impersonate_synchronous("verify_task", &old_range, kInput));
+      }
+      if (extend_size) {
+        COERCE_ERROR(storage.extend(extend_size, &epoch));
+        COERCE_ERROR(pool->impersonate_synchronous("write_task", &new_range, kInput));
+        COERCE_ERROR(pool->impersonate_synchronous("verify_task", &all_range, kInput));
+        engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+        COERCE_ERROR(pool->impersonate_synchronous("verify_task", &all_range, kInput));
+      }
+      COERCE_ERROR(engine.uninitialize());
+    }
+  }
+  if (snapshot) {
+    Engine engine(options);
+    engine.get_proc_manager()->pre_register("verify_task", verify_task);
+    COERCE_ERROR(engine.initialize());
+    {
+      UninitializeGuard guard(&engine);
+      COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous(
+        "verify_task",
+        &all_range,
+        kInput));
+      COERCE_ERROR(engine.uninitialize());
+    }
+  }
+  cleanup_test(options);
+}
+
+const ArrayOffset k2LvSize = kRecordsInLeaf * 20U + 7U;
+const ArrayOffset k3LvSize = kRecordsInLeaf * kInteriorFanout + kRecordsInLeaf * 12U + 3U;
+
+TEST(ArraySparseTest, Volatile) { test_run(k2LvSize, false, 0); }
+TEST(ArraySparseTest, Snapshot) { test_run(k2LvSize, true, 0); }
+TEST(ArraySparseTest, SnapshotThreeLevels) { test_run(k3LvSize, true, 0); }
+TEST(ArraySparseTest, Extend) { test_run(k2LvSize, true, k2LvSize + kRecordsInLeaf * 10U); }
+TEST(ArraySparseTest, ExtendAddLevel) { test_run(k2LvSize, true, k3LvSize); }
+
+}  // namespace array
+}  // namespace storage
+}  // namespace foedus
+
+TEST_MAIN_CAPTURE_SIGNALS(ArraySparseTest, foedus.storage.array);
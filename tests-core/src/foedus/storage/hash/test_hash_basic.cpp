@@ -19,12 +19,16 @@
 
 #include <cstring>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 #include "foedus/engine.hpp"
 #include "foedus/engine_options.hpp"
 #include "foedus/epoch.hpp"
 #include "foedus/test_common.hpp"
 #include "foedus/proc/proc_manager.hpp"
+#include "foedus/snapshot/snapshot_manager.hpp"
+#include "foedus/soc/shared_rendezvous.hpp"
 #include "foedus/storage/storage_manager.hpp"
 #include "foedus/storage/hash/hash_metadata.hpp"
 #include "foedus/storage/hash/hash_storage.hpp"
@@ -330,6 +334,289 @@ void test_expand(bool update_case) {
 
 TEST(HashBasicTest, ExpandInsert) { test_expand(false); }
 TEST(HashBasicTest, ExpandUpdate) { test_expand(true); }
+ErrorStack get_record_batch_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  HashStorage hash = context->get_engine()->get_storage_manager()->get_hash("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  const uint16_t kKeys = 200;
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint64_t key = 0; key < kKeys; key += 2U) {
+    uint64_t data = key * 3U;
+    CHECK_ERROR(hash.insert_record(context, &key, sizeof(key), &data, sizeof(data)));
+  }
+  Epoch commit_epoch;
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+
+  // more keys than HashStoragePimpl::kBatchMax, half of them not found
+  uint64_t keys[kKeys];
+  const void* key_pointers[kKeys];
+  uint16_t key_lengths[kKeys];
+  uint64_t data[kKeys];
+  void* payloads[kKeys];
+  uint16_t capacities[kKeys];
+  ErrorCode results[kKeys];
+  for (uint16_t i = 0; i < kKeys; ++i) {
+    keys[i] = kKeys - 1U - i;
+    key_pointers[i] = &keys[i];
+    key_lengths[i] = sizeof(keys[i]);
+    data[i] = 0;
+    payloads[i] = &data[i];
+    capacities[i] = sizeof(data[i]);
+  }
+  const uint16_t kSmallBuffer = 1;  // keys[1] = 198 exists
+  capacities[kSmallBuffer] = 4;
+
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  CHECK_ERROR(hash.get_record_batch(
+    context,
+    kKeys,
+    key_pointers,
+    key_lengths,
+    payloads,
+    capacities,
+    results,
+    true));
+  for (uint16_t i = 0; i < kKeys; ++i) {
+    if (i == kSmallBuffer) {
+      EXPECT_EQ(kErrorCodeStrTooSmallPayloadBuffer, results[i]);
+      EXPECT_EQ(sizeof(uint64_t), capacities[i]);
+    } else if (keys[i] % 2U == 0) {
+      EXPECT_EQ(kErrorCodeOk, results[i]) << keys[i];
+      EXPECT_EQ(sizeof(uint64_t), capacities[i]) << keys[i];
+      EXPECT_EQ(keys[i] * 3U, data[i]) << keys[i];
+    } else {
+      EXPECT_EQ(kErrorCodeStrKeyNotFound, results[i]) << keys[i];
+    }
+  }
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+  CHECK_ERROR(xct_manager->wait_for_commit(commit_epoch));
+  return foedus::kRetOk;
+}
+
+TEST(HashBasicTest, GetRecordBatch) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("task", get_record_batch_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta("ggg", 10);  // 2 levels, and many empty bins
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("task"));
+    COERCE_ERROR(storage.verify_single_thread(&engine));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+/** Payload of increment_oneshot tests. Fields of various types and unaligned offsets. */
+struct IncrementPayload {
+  int64_t   i64_;   // +0
+  uint32_t  u32_;   // +8
+  int16_t   i16_;   // +12
+  uint8_t   u8_;    // +14
+  uint8_t   pad_;   // +15
+  double    dbl_;   // +16
+};
+const uint32_t kIncrementKeys = 16;
+const uint32_t kIncrementRounds = 10;
+
+ErrorStack increment_oneshot_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  HashStorage hash = context->get_engine()->get_storage_manager()->get_hash("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  Epoch commit_epoch;
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint64_t key = 0; key < kIncrementKeys; ++key) {
+    IncrementPayload data = {100, 200U, 300, 10U, 0, 0.5};
+    CHECK_ERROR(hash.insert_record(context, key, &data, sizeof(data)));
+  }
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+
+  // increments in separate xcts and within the same xct
+  const int64_t i64_addendum = -3;
+  const int16_t i16_addendum[2] = {2, 5};
+  const uint8_t u8_addendum = 1;
+  const double dbl_addendum = 0.25;
+  for (uint32_t round = 0; round < kIncrementRounds; ++round) {
+    CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+    for (uint64_t key = 0; key < kIncrementKeys; ++key) {
+      const uint32_t u32_addendum = key;
+      CHECK_ERROR(hash.increment_record_oneshot(context, key, i64_addendum, 0));
+      CHECK_ERROR(hash.increment_record_oneshot(context, key, u32_addendum, 8));
+      CHECK_ERROR(hash.increment_record_oneshot(context, key, i16_addendum[0], 12));
+      CHECK_ERROR(hash.increment_record_oneshot(context, key, i16_addendum[1], 12));
+      CHECK_ERROR(hash.increment_record_oneshot(context, key, u8_addendum, 14));
+      CHECK_ERROR(hash.increment_record_oneshot(context, key, dbl_addendum, 16));
+    }
+    CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+  }
+
+  // error cases
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  const uint64_t missing_key = kIncrementKeys;
+  ErrorCode missing_ret = hash.increment_record_oneshot(context, missing_key, i64_addendum, 0);
+  EXPECT_EQ(kErrorCodeStrKeyNotFound, missing_ret);
+  const uint64_t existing_key = 0;
+  ErrorCode short_ret = hash.increment_record_oneshot(context, existing_key, i64_addendum, 20);
+  EXPECT_EQ(kErrorCodeStrTooShortPayload, short_ret);
+  CHECK_ERROR(xct_manager->abort_xct(context));
+
+  CHECK_ERROR(xct_manager->wait_for_commit(commit_epoch));
+  return foedus::kRetOk;
+}
+
+ErrorStack increment_oneshot_verify_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  HashStorage hash = context->get_engine()->get_storage_manager()->get_hash("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  EXPECT_EQ(sizeof(xct::IsolationLevel), args.input_len_);
+  xct::IsolationLevel isolation = *reinterpret_cast<const xct::IsolationLevel*>(args.input_buffer_);
+  CHECK_ERROR(xct_manager->begin_xct(context, isolation));
+  for (uint64_t key = 0; key < kIncrementKeys; ++key) {
+    IncrementPayload data;
+    uint16_t capacity = sizeof(data);
+    CHECK_ERROR(hash.get_record(context, key, &data, &capacity, true));
+    EXPECT_EQ(sizeof(data), capacity);
+    EXPECT_EQ(100 - 3 * static_cast<int64_t>(kIncrementRounds), data.i64_) << key;
+    EXPECT_EQ(200U + key * kIncrementRounds, data.u32_) << key;
+    EXPECT_EQ(300 + 7 * kIncrementRounds, data.i16_) << key;
+    EXPECT_EQ(10U + kIncrementRounds, data.u8_) << key;
+    EXPECT_EQ(0, data.pad_) << key;
+    EXPECT_DOUBLE_EQ(0.5 + 0.25 * kIncrementRounds, data.dbl_) << key;
+  }
+  Epoch commit_epoch;
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+  return foedus::kRetOk;
+}
+
+TEST(HashBasicTest, IncrementOneshot) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("task", increment_oneshot_task);
+  engine.get_proc_manager()->pre_register("verify", increment_oneshot_verify_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta("ggg", 8);
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("task"));
+    xct::IsolationLevel isolation = xct::kSerializable;
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous(
+      "verify",
+      &isolation,
+      sizeof(isolation)));
+
+    // the log gleaner composes the increment logs into snapshot pages
+    engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+    isolation = xct::kSnapshot;
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous(
+      "verify",
+      &isolation,
+      sizeof(isolation)));
+    COERCE_ERROR(storage.verify_single_thread(&engine));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+const uint32_t kContentionThreads = 4;
+const uint32_t kContentionRounds = 200;
+soc::SharedRendezvous contention_rendezvous;
+
+/** Every oneshot increment on the one hot key must commit. No read-set, so no race-abort. */
+ErrorStack increment_oneshot_contention_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  HashStorage hash = context->get_engine()->get_storage_manager()->get_hash("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  const uint64_t key = 0;
+  const uint64_t addendum = 1;
+  contention_rendezvous.wait();
+  Epoch commit_epoch;
+  for (uint32_t round = 0; round < kContentionRounds; ++round) {
+    CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+    CHECK_ERROR(hash.increment_record_oneshot(context, key, addendum, 0));
+    CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+  }
+  CHECK_ERROR(xct_manager->wait_for_commit(commit_epoch));
+  return foedus::kRetOk;
+}
+
+ErrorStack increment_oneshot_contention_init_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  HashStorage hash = context->get_engine()->get_storage_manager()->get_hash("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  Epoch commit_epoch;
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  const uint64_t key = 0;
+  const uint64_t data = 0;
+  CHECK_ERROR(hash.insert_record(context, key, &data, sizeof(data)));
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+  CHECK_ERROR(xct_manager->wait_for_commit(commit_epoch));
+  return foedus::kRetOk;
+}
+
+ErrorStack increment_oneshot_contention_verify_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  HashStorage hash = context->get_engine()->get_storage_manager()->get_hash("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  const uint64_t key = 0;
+  uint64_t data = 0;
+  uint16_t capacity = sizeof(data);
+  CHECK_ERROR(hash.get_record(context, key, &data, &capacity, true));
+  EXPECT_EQ(sizeof(data), capacity);
+  EXPECT_EQ(kContentionThreads * kContentionRounds, data);
+  Epoch commit_epoch;
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+  return foedus::kRetOk;
+}
+
+TEST(HashBasicTest, IncrementOneshotContended) {
+  EngineOptions options = get_tiny_options();
+  options.thread_.group_count_ = 1;
+  options.thread_.thread_count_per_group_ = kContentionThreads;
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("init", increment_oneshot_contention_init_task);
+  engine.get_proc_manager()->pre_register("task", increment_oneshot_contention_task);
+  engine.get_proc_manager()->pre_register("verify", increment_oneshot_contention_verify_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta("ggg", 8);
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("init"));
+
+    contention_rendezvous.initialize();
+    std::vector<thread::ImpersonateSession> sessions;
+    for (uint32_t i = 0; i < kContentionThreads; ++i) {
+      thread::ImpersonateSession session;
+      EXPECT_TRUE(engine.get_thread_pool()->impersonate("task", nullptr, 0, &session));
+      sessions.emplace_back(std::move(session));
+    }
+    contention_rendezvous.signal();
+    for (uint32_t i = 0; i < kContentionThreads; ++i) {
+      COERCE_ERROR(sessions[i].get_result());
+      sessions[i].release();
+    }
+    contention_rendezvous.uninitialize();
+
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("verify"));
+    COERCE_ERROR(storage.verify_single_thread(&engine));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
 // TASK(Hideaki): we don't have multi-thread cases here. it's not a "basic" test.
 // no multi-key cases either. we have to make sure the keys hit the same bucket..
 
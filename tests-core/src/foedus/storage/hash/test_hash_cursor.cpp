@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include "foedus/engine.hpp"
+#include "foedus/engine_options.hpp"
+#include "foedus/epoch.hpp"
+#include "foedus/test_common.hpp"
+#include "foedus/proc/proc_manager.hpp"
+#include "foedus/snapshot/snapshot_manager.hpp"
+#include "foedus/storage/storage_manager.hpp"
+#include "foedus/storage/hash/hash_cursor.hpp"
+#include "foedus/storage/hash/hash_hashinate.hpp"
+#include "foedus/storage/hash/hash_metadata.hpp"
+#include "foedus/storage/hash/hash_storage.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/thread/thread_pool.hpp"
+#include "foedus/xct/xct_manager.hpp"
+
+/**
+ * @file test_hash_cursor.cpp
+ * Full and partitioned scans with HashCursor.
+ */
+namespace foedus {
+namespace storage {
+namespace hash {
+DEFINE_TEST_CASE_PACKAGE(HashCursorTest, foedus.storage.hash);
+
+const uint32_t kRecords = 2048;
+const uint64_t kDataAddendum = 42U;
+const StorageName kName("test");
+/** 2 levels of intermediate pages */
+const uint8_t kBinBits = 10;
+
+/** Input of scan_task */
+struct ScanParams {
+  xct::IsolationLevel isolation_;
+  /** number of partitions to scan separately */
+  uint32_t partitions_;
+  /** keys below this have been deleted */
+  uint32_t deleted_below_;
+  /** keys [0, records_) are expected */
+  uint32_t records_;
+};
+
+ErrorStack insert_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(uint32_t) * 2U, args.input_len_);
+  const uint32_t* range = reinterpret_cast<const uint32_t*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint64_t key = range[0]; key < range[1]; ++key) {
+    uint64_t data = key + kDataAddendum;
+    WRAP_ERROR_CODE(hash.insert_record(context, &key, sizeof(key), &data, sizeof(data)));
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack delete_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(uint32_t), args.input_len_);
+  const uint32_t count = *reinterpret_cast<const uint32_t*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint64_t key = 0; key < count; ++key) {
+    WRAP_ERROR_CODE(hash.delete_record(context, &key, sizeof(key)));
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack scan_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(ScanParams), args.input_len_);
+  const ScanParams* params = reinterpret_cast<const ScanParams*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, params->isolation_));
+
+  std::vector<bool> found(params->records_, false);
+  HashBin prev_end = 0;
+  for (uint32_t p = 0; p < params->partitions_; ++p) {
+    HashBinRange range = HashCursor::get_partition_range(hash, p, params->partitions_);
+    EXPECT_EQ(prev_end, range.begin_);
+    prev_end = range.end_;
+
+    HashCursor cursor(context, hash);
+    WRAP_ERROR_CODE(cursor.open(range));
+    HashBin prev_bin = range.begin_;
+    while (cursor.is_valid_record()) {
+      EXPECT_TRUE(range.contains(cursor.get_bin()));
+      EXPECT_LE(prev_bin, cursor.get_bin());
+      prev_bin = cursor.get_bin();
+      EXPECT_EQ(sizeof(uint64_t), cursor.get_key_length());
+      EXPECT_EQ(sizeof(uint64_t), cursor.get_payload_length());
+      uint64_t key;
+      uint64_t data;
+      std::memcpy(&key, cursor.get_key(), sizeof(key));
+      std::memcpy(&data, cursor.get_payload(), sizeof(data));
+      EXPECT_EQ(key + kDataAddendum, data) << key;
+      EXPECT_EQ(hashinate(&key, sizeof(key)), cursor.get_hash()) << key;
+      const HashBin bin = hash.get_hash_metadata()->extract_bin(cursor.get_hash());
+      EXPECT_EQ(bin, cursor.get_bin()) << key;
+      EXPECT_GE(key, params->deleted_below_);
+      EXPECT_LT(key, params->records_);
+      if (key < params->records_) {
+        EXPECT_FALSE(found[key]) << key;
+        found[key] = true;
+      }
+      WRAP_ERROR_CODE(cursor.next());
+    }
+    EXPECT_FALSE(cursor.is_valid_record());
+  }
+  EXPECT_EQ(hash.get_bin_count(), prev_end);
+  for (uint32_t i = params->deleted_below_; i < params->records_; ++i) {
+    EXPECT_TRUE(found[i]) << i;
+  }
+
+  Epoch commit_epoch;
+  EXPECT_EQ(kErrorCodeOk, xct_manager->precommit_xct(context, &commit_epoch));
+  return kRetOk;
+}
+
+void scan(Engine* engine, const ScanParams& params) {
+  COERCE_ERROR(engine->get_thread_pool()->impersonate_synchronous(
+    "scan_task",
+    &params,
+    sizeof(params)));
+}
+
+void scan_all(Engine* engine, uint32_t deleted_below, uint32_t records, bool snapshot) {
+  const uint32_t kPartitions[] = {1, 3, 16};
+  for (uint32_t partitions : kPartitions) {
+    ScanParams params = {xct::kSerializable, partitions, deleted_below, records};
+    scan(engine, params);
+    params.isolation_ = xct::kDirtyRead;
+    scan(engine, params);
+    if (snapshot) {
+      params.isolation_ = xct::kSnapshot;
+      scan(engine, params);
+    }
+  }
+}
+
+void insert(Engine* engine, uint32_t from, uint32_t to) {
+  uint32_t range[2] = {from, to};
+  COERCE_ERROR(engine->get_thread_pool()->impersonate_synchronous(
+    "insert_task",
+    range,
+    sizeof(range)));
+}
+
+EngineOptions make_options() {
+  EngineOptions options = get_tiny_options();
+  options.log_.loggers_per_node_ = 1;
+  options.memory_.page_pool_size_mb_per_node_ = 20;
+  options.cache_.snapshot_cache_size_mb_per_node_ = 20;
+  return options;
+}
+
+void register_tasks(Engine* engine) {
+  engine->get_proc_manager()->pre_register("insert_task", insert_task);
+  engine->get_proc_manager()->pre_register("delete_task", delete_task);
+  engine->get_proc_manager()->pre_register("scan_task", scan_task);
+}
+
+TEST(HashCursorTest, Empty) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta(kName, kBinBits);
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    scan_all(&engine, 0, 0, true);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(HashCursorTest, Volatile) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta(kName, kBinBits);
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    insert(&engine, 0, kRecords);
+    scan_all(&engine, 0, kRecords, false);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(HashCursorTest, Deleted) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta(kName, kBinBits);
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    insert(&engine, 0, kRecords);
+    uint32_t deleted = kRecords / 4U;
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous(
+      "delete_task",
+      &deleted,
+      sizeof(deleted)));
+    scan_all(&engine, deleted, kRecords, false);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(HashCursorTest, Snapshot) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta(kName, kBinBits);
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    insert(&engine, 0, kRecords);
+    engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+    // volatile pages are dropped now. everything is read from snapshot pages.
+    scan_all(&engine, 0, kRecords, true);
+
+    // then some bins get volatile pages again.
+    insert(&engine, kRecords, kRecords + kRecords / 8U);
+    ScanParams params = {xct::kSerializable, 4, 0, kRecords + kRecords / 8U};
+    scan(&engine, params);
+    params.isolation_ = xct::kSnapshot;
+    params.records_ = kRecords;
+    scan(&engine, params);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+}  // namespace hash
+}  // namespace storage
+}  // namespace foedus
+
+TEST_MAIN_CAPTURE_SIGNALS(HashCursorTest, foedus.storage.hash);
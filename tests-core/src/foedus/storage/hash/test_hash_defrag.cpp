@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "foedus/engine.hpp"
+#include "foedus/engine_options.hpp"
+#include "foedus/epoch.hpp"
+#include "foedus/test_common.hpp"
+#include "foedus/proc/proc_manager.hpp"
+#include "foedus/storage/storage_manager.hpp"
+#include "foedus/storage/hash/hash_cursor.hpp"
+#include "foedus/storage/hash/hash_metadata.hpp"
+#include "foedus/storage/hash/hash_storage.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/thread/thread_pool.hpp"
+#include "foedus/xct/xct_manager.hpp"
+
+/**
+ * @file test_hash_defrag.cpp
+ * HashStorage::defrag_volatile_bins() and transactions running across it.
+ */
+namespace foedus {
+namespace storage {
+namespace hash {
+DEFINE_TEST_CASE_PACKAGE(HashDefragTest, foedus.storage.hash);
+
+/** 16 bins of 128 records each, which is 2 pages per bin. */
+const uint32_t kRecords = 2048;
+const uint8_t kBinBits = 4;
+const uint64_t kDataAddendum = 42U;
+const StorageName kName("test");
+
+/** Keys that are not multiples of this are deleted. */
+const uint64_t kSurvivorInterval = 4;
+inline bool is_survivor(uint64_t key) { return key % kSurvivorInterval == 0; }
+
+/** Input of insert_task and verify_task */
+struct KeyRange {
+  uint32_t from_;
+  uint32_t to_;
+  /** for verify_task. whether the non-survivors are expected to be deleted */
+  bool     deleted_;
+};
+
+ErrorStack insert_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(KeyRange), args.input_len_);
+  const KeyRange* range = reinterpret_cast<const KeyRange*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint64_t key = range->from_; key < range->to_; ++key) {
+    if (range->deleted_ && is_survivor(key)) {
+      continue;
+    }
+    uint64_t data = key + kDataAddendum;
+    WRAP_ERROR_CODE(hash.insert_record(context, &key, sizeof(key), &data, sizeof(data)));
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack delete_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint64_t key = 0; key < kRecords; ++key) {
+    if (!is_survivor(key)) {
+      WRAP_ERROR_CODE(hash.delete_record(context, &key, sizeof(key)));
+    }
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  // so that the deletions are older than the current epoch when we defragment
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack verify_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(KeyRange), args.input_len_);
+  const KeyRange* range = reinterpret_cast<const KeyRange*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint64_t key = range->from_; key < range->to_; ++key) {
+    if (key % 256U == 0 && key != range->from_) {
+      // each miss-search takes a page-version set entry. let's not overflow it.
+      WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+      WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    }
+    uint64_t data = 0;
+    uint16_t capacity = sizeof(data);
+    ErrorCode ret = hash.get_record(context, &key, sizeof(key), &data, &capacity, true);
+    if (range->deleted_ && !is_survivor(key)) {
+      EXPECT_EQ(kErrorCodeStrKeyNotFound, ret) << key;
+    } else {
+      EXPECT_EQ(kErrorCodeOk, ret) << key;
+      EXPECT_EQ(key + kDataAddendum, data) << key;
+    }
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  CHECK_ERROR(hash.verify_single_thread(context));
+  return kRetOk;
+}
+
+ErrorStack defrag_task(const proc::ProcArguments& args) {
+  EXPECT_GE(args.output_buffer_size_, sizeof(HashDefragStatistics));
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  HashDefragStatistics* stat = reinterpret_cast<HashDefragStatistics*>(args.output_buffer_);
+  HashBinRange range(0, hash.get_bin_count());
+  WRAP_ERROR_CODE(hash.defrag_volatile_bins(context, range, stat));
+  *args.output_used_ = sizeof(HashDefragStatistics);
+  return kRetOk;
+}
+
+void insert(Engine* engine, uint32_t from, uint32_t to, bool deleted) {
+  KeyRange range = {from, to, deleted};
+  COERCE_ERROR(engine->get_thread_pool()->impersonate_synchronous(
+    "insert_task",
+    &range,
+    sizeof(range)));
+}
+
+void verify(Engine* engine, uint32_t from, uint32_t to, bool deleted) {
+  KeyRange range = {from, to, deleted};
+  COERCE_ERROR(engine->get_thread_pool()->impersonate_synchronous(
+    "verify_task",
+    &range,
+    sizeof(range)));
+}
+
+HashDefragStatistics defrag(Engine* engine) {
+  thread::ImpersonateSession session;
+  EXPECT_TRUE(engine->get_thread_pool()->impersonate("defrag_task", nullptr, 0, &session));
+  COERCE_ERROR(session.get_result());
+  HashDefragStatistics stat;
+  EXPECT_EQ(sizeof(stat), session.get_output_size());
+  session.get_output(&stat);
+  session.release();
+  return stat;
+}
+
+EngineOptions make_options() {
+  EngineOptions options = get_tiny_options();
+  options.log_.loggers_per_node_ = 1;
+  options.memory_.page_pool_size_mb_per_node_ = 20;
+  return options;
+}
+
+void register_tasks(Engine* engine);
+
+void create_and_delete(Engine* engine, bool hot_directory) {
+  HashMetadata meta(kName, kBinBits);
+  meta.hot_directory_ = hot_directory ? 4U : 0;  // multiple pages to invalidate entries in
+  HashStorage storage;
+  Epoch epoch;
+  COERCE_ERROR(engine->get_storage_manager()->create_hash(&meta, &storage, &epoch));
+  insert(engine, 0, kRecords, false);
+  COERCE_ERROR(engine->get_thread_pool()->impersonate_synchronous("delete_task"));
+  verify(engine, 0, kRecords, true);
+}
+
+void test_delete_most(bool hot_directory) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create_and_delete(&engine, hot_directory);
+
+    HashDefragStatistics stat = defrag(&engine);
+    EXPECT_EQ(1U << kBinBits, stat.examined_bins_);
+    EXPECT_EQ(stat.examined_bins_, stat.defragmented_bins_);
+    EXPECT_EQ(0U, stat.skipped_bins_);
+    EXPECT_GE(stat.freed_pages_, stat.defragmented_bins_);
+    EXPECT_EQ(kRecords - kRecords / kSurvivorInterval, stat.dropped_records_);
+    verify(&engine, 0, kRecords, true);
+
+    // nothing to do any more
+    stat = defrag(&engine);
+    EXPECT_EQ(1U << kBinBits, stat.examined_bins_);
+    EXPECT_EQ(0U, stat.defragmented_bins_);
+    EXPECT_EQ(0U, stat.freed_pages_);
+    EXPECT_EQ(0U, stat.dropped_records_);
+
+    // the dropped keys can be inserted again
+    insert(&engine, 0, kRecords, true);
+    verify(&engine, 0, kRecords, false);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(HashDefragTest, DeleteMost) { test_delete_most(false); }
+TEST(HashDefragTest, DeleteMostHotDirectory) { test_delete_most(true); }
+
+TEST(HashDefragTest, NoDeletes) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta(kName, kBinBits);
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    insert(&engine, 0, kRecords, false);
+    HashDefragStatistics stat = defrag(&engine);
+    EXPECT_EQ(1U << kBinBits, stat.examined_bins_);
+    EXPECT_EQ(0U, stat.defragmented_bins_);
+    verify(&engine, 0, kRecords, false);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+// A transaction reads or writes before defragmentation and commits after it.
+enum ConcurrentMode {
+  kReadSurvivor = 0,
+  kReadDropped,
+  kOverwriteSurvivor,
+  kScan,
+};
+
+std::atomic<int> concurrent_phase;  // 0: started, 1: xct has accessed, 2: defragmented
+ErrorCode concurrent_result;
+
+ErrorStack concurrent_xct_task(const proc::ProcArguments& args) {
+  const ConcurrentMode mode = *reinterpret_cast<const ConcurrentMode*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  uint64_t key = (mode == kReadDropped) ? 1U : 0U;
+  uint64_t data = 0;
+  uint16_t capacity = sizeof(data);
+  if (mode == kReadSurvivor) {
+    WRAP_ERROR_CODE(hash.get_record(context, &key, sizeof(key), &data, &capacity, true));
+    EXPECT_EQ(key + kDataAddendum, data);
+  } else if (mode == kReadDropped) {
+    ErrorCode ret = hash.get_record(context, &key, sizeof(key), &data, &capacity, true);
+    EXPECT_EQ(kErrorCodeStrKeyNotFound, ret);
+  } else if (mode == kOverwriteSurvivor) {
+    data = key + kDataAddendum;
+    WRAP_ERROR_CODE(hash.overwrite_record(context, &key, sizeof(key), &data, 0, sizeof(data)));
+  } else {
+    HashCursor cursor(context, hash);
+    WRAP_ERROR_CODE(cursor.open());
+    uint32_t count = 0;
+    while (cursor.is_valid_record()) {
+      ++count;
+      WRAP_ERROR_CODE(cursor.next());
+    }
+    EXPECT_EQ(kRecords / kSurvivorInterval, count);
+  }
+
+  concurrent_phase.store(1);
+  while (concurrent_phase.load() != 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  Epoch commit_epoch;
+  concurrent_result = xct_manager->precommit_xct(context, &commit_epoch);
+  return kRetOk;
+}
+
+ErrorStack concurrent_defrag_task(const proc::ProcArguments& args) {
+  while (concurrent_phase.load() != 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  HashStorage hash(args.engine_, kName);
+  HashDefragStatistics stat;
+  WRAP_ERROR_CODE(hash.defrag_volatile_bins(
+    args.context_,
+    HashBinRange(0, hash.get_bin_count()),
+    &stat));
+  EXPECT_EQ(1U << kBinBits, stat.defragmented_bins_);
+  concurrent_phase.store(2);
+  return kRetOk;
+}
+
+void test_concurrent(ConcurrentMode mode, ErrorCode expected) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create_and_delete(&engine, false);
+
+    concurrent_phase.store(0);
+    concurrent_result = kErrorCodeOk;
+    thread::ImpersonateSession xct_session;
+    thread::ImpersonateSession defrag_session;
+    EXPECT_TRUE(engine.get_thread_pool()->impersonate(
+      "concurrent_xct_task",
+      &mode,
+      sizeof(mode),
+      &xct_session));
+    EXPECT_TRUE(engine.get_thread_pool()->impersonate(
+      "concurrent_defrag_task",
+      nullptr,
+      0,
+      &defrag_session));
+    COERCE_ERROR(xct_session.get_result());
+    COERCE_ERROR(defrag_session.get_result());
+    xct_session.release();
+    defrag_session.release();
+    EXPECT_EQ(expected, concurrent_result);
+
+    verify(&engine, 0, kRecords, true);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(HashDefragTest, ReadSurvivor) { test_concurrent(kReadSurvivor, kErrorCodeOk); }
+TEST(HashDefragTest, ReadDropped) { test_concurrent(kReadDropped, kErrorCodeXctRaceAbort); }
+TEST(HashDefragTest, OverwriteSurvivor) { test_concurrent(kOverwriteSurvivor, kErrorCodeOk); }
+TEST(HashDefragTest, Scan) { test_concurrent(kScan, kErrorCodeXctRaceAbort); }
+
+void register_tasks(Engine* engine) {
+  engine->get_proc_manager()->pre_register("insert_task", insert_task);
+  engine->get_proc_manager()->pre_register("delete_task", delete_task);
+  engine->get_proc_manager()->pre_register("verify_task", verify_task);
+  engine->get_proc_manager()->pre_register("defrag_task", defrag_task);
+  engine->get_proc_manager()->pre_register("concurrent_xct_task", concurrent_xct_task);
+  engine->get_proc_manager()->pre_register("concurrent_defrag_task", concurrent_defrag_task);
+}
+
+}  // namespace hash
+}  // namespace storage
+}  // namespace foedus
+
+TEST_MAIN_CAPTURE_SIGNALS(HashDefragTest, foedus.storage.hash);
@@ -42,6 +42,34 @@ TEST(HashHashinateTest, Primitives) {
   EXPECT_NE(hashinate(u64), hashinate<uint64_t>(0ULL));
 }
 
+TEST(HashHashinateTest, Prefixed) {
+  struct CompositeKey {
+    uint32_t tenant_;
+    uint32_t id_;
+  };
+  const uint8_t kPrefixBits = 5;
+  const HashValue kPrefixMask = ~0ULL << (64U - kPrefixBits);
+  for (uint32_t tenant = 0; tenant < 16U; ++tenant) {
+    const HashValue tenant_hash = hashinate(&tenant, sizeof(tenant));
+    for (uint32_t id = 0; id < 64U; ++id) {
+      CompositeKey key = {tenant, id};
+      const HashValue full_hash = hashinate(&key, sizeof(key));
+      const HashValue hash = hashinate_prefixed(&key, sizeof(key), sizeof(tenant), kPrefixBits);
+      EXPECT_EQ(tenant_hash & kPrefixMask, hash & kPrefixMask) << tenant << "," << id;
+      EXPECT_EQ(full_hash & ~kPrefixMask, hash & ~kPrefixMask) << tenant << "," << id;
+      EXPECT_TRUE(is_hash_of_key(hash, &key, sizeof(key)));
+      // no prefix means the usual hash
+      EXPECT_EQ(full_hash, hashinate_prefixed(&key, sizeof(key), 0, kPrefixBits));
+      EXPECT_EQ(full_hash, hashinate_prefixed(&key, sizeof(key), sizeof(tenant), 0));
+    }
+  }
+  // a key shorter than the prefix uses the whole key as the prefix
+  uint32_t short_key = 42;
+  EXPECT_EQ(
+    hashinate(&short_key, sizeof(short_key)),
+    hashinate_prefixed(&short_key, sizeof(short_key), 8U, kHashMaxPrefixBits));
+}
+
 #ifndef NDEBUG
 const uint64_t kCollisionReps = 1 << 16;
 #else  // NDEBUG
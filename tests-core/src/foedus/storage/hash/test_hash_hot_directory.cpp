@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "foedus/engine.hpp"
+#include "foedus/engine_options.hpp"
+#include "foedus/epoch.hpp"
+#include "foedus/test_common.hpp"
+#include "foedus/memory/aligned_memory.hpp"
+#include "foedus/proc/proc_manager.hpp"
+#include "foedus/snapshot/snapshot_manager.hpp"
+#include "foedus/storage/storage_manager.hpp"
+#include "foedus/storage/hash/hash_hashinate.hpp"
+#include "foedus/storage/hash/hash_hot_directory_impl.hpp"
+#include "foedus/storage/hash/hash_metadata.hpp"
+#include "foedus/storage/hash/hash_storage.hpp"
+#include "foedus/storage/hash/hash_storage_pimpl.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/thread/thread_pool.hpp"
+#include "foedus/xct/xct.hpp"
+#include "foedus/xct/xct_manager.hpp"
+
+/**
+ * @file test_hash_hot_directory.cpp
+ * HashHotDirectoryPage itself and HashStorage with HashMetadata::hot_directory_.
+ */
+namespace foedus {
+namespace storage {
+namespace hash {
+DEFINE_TEST_CASE_PACKAGE(HashHotDirectoryTest, foedus.storage.hash);
+
+const uint32_t kRecords = 256;
+const StorageName kName("test");
+
+/** Input of read_task */
+struct ReadParams {
+  /** keys below this have been deleted */
+  uint32_t deleted_below_;
+  /** data = key + addendum_ */
+  uint64_t addendum_;
+  /** whether the directory of this node should have some entries after the reads */
+  bool     expect_entries_;
+  /** if expect_entries_, the directory of this node should have more entries than this */
+  uint32_t entries_more_than_;
+};
+
+/** @returns the number of entries in all directory pages of the node */
+uint32_t count_directory_entries(thread::Thread* context, HashStorage* hash) {
+  VolatilePagePointer root_pointer
+    = hash->get_control_block()->hot_directories_[context->get_numa_node()];
+  EXPECT_FALSE(root_pointer.is_null());
+  const HashHotDirectoryRootPage* root
+    = context->resolve_cast<HashHotDirectoryRootPage>(root_pointer);
+  EXPECT_EQ(kHashHotDirectoryRootPageType, root->header().get_page_type());
+  EXPECT_EQ(hash->get_hash_metadata()->hot_directory_, root->get_page_count());
+  uint32_t count = 0;
+  for (uint16_t i = 0; i < root->get_page_count(); ++i) {
+    const HashHotDirectoryPage* page
+      = context->resolve_cast<HashHotDirectoryPage>(root->get_page(i));
+    EXPECT_EQ(kHashHotDirectoryPageType, page->header().get_page_type());
+    count += page->count_entries();
+  }
+  return count;
+}
+
+TEST(HashHotDirectoryTest, AdmitLookupInvalidate) {
+  memory::AlignedMemory memory(kPageSize, kPageSize, memory::AlignedMemory::kNumaAllocOnnode, 0);
+  ASSERT_FALSE(memory.is_null());
+  HashHotDirectoryPage* page = reinterpret_cast<HashHotDirectoryPage*>(memory.get_block());
+  page->initialize_volatile_page(1, construct_volatile_page_pointer(123));
+  EXPECT_EQ(0U, page->count_entries());
+
+  const uint64_t loc1 = HashHotDirectoryPage::to_location(construct_volatile_page_pointer(5), 3);
+  const uint64_t loc2 = HashHotDirectoryPage::to_location(construct_volatile_page_pointer(6), 7);
+  EXPECT_EQ(5U, HashHotDirectoryPage::extract_page(loc1).word);
+  EXPECT_EQ(3U, HashHotDirectoryPage::extract_index(loc1));
+  EXPECT_EQ(6U, HashHotDirectoryPage::extract_page(loc2).word);
+  EXPECT_EQ(7U, HashHotDirectoryPage::extract_index(loc2));
+
+  const HashValue hash1 = hashinate("abc", 3);
+  const HashValue hash2 = hashinate("def", 3);
+  EXPECT_EQ(0U, page->lookup(hash1));
+  page->admit(hash1, loc1, 0);
+  EXPECT_EQ(loc1, page->lookup(hash1));
+  EXPECT_EQ(0U, page->lookup(hash2));
+  EXPECT_EQ(1U, page->count_entries());
+
+  // admitting the same hash again just updates the entry
+  page->admit(hash1, loc2, 0);
+  EXPECT_EQ(loc2, page->lookup(hash1));
+  EXPECT_EQ(1U, page->count_entries());
+
+  // invalidate does nothing if the location is stale
+  page->invalidate(hash1, loc1);
+  EXPECT_EQ(loc2, page->lookup(hash1));
+  page->invalidate(hash1, loc2);
+  EXPECT_EQ(0U, page->lookup(hash1));
+  EXPECT_EQ(0U, page->count_entries());
+
+  page->admit(hash1, loc1, 0);
+  page->admit(hash2, loc2, 0);
+  EXPECT_EQ(2U, page->count_entries());
+  page->clear();
+  EXPECT_EQ(0U, page->count_entries());
+  EXPECT_EQ(0U, page->lookup(hash1));
+  EXPECT_EQ(0U, page->lookup(hash2));
+}
+
+TEST(HashHotDirectoryTest, Replacement) {
+  memory::AlignedMemory memory(kPageSize, kPageSize, memory::AlignedMemory::kNumaAllocOnnode, 0);
+  ASSERT_FALSE(memory.is_null());
+  HashHotDirectoryPage* page = reinterpret_cast<HashHotDirectoryPage*>(memory.get_block());
+  page->initialize_volatile_page(1, construct_volatile_page_pointer(123));
+
+  // hash values that fall into the same bucket. the directory keeps only kWays of them.
+  const uint32_t kCount = HashHotDirectoryPage::kWays * 2U;
+  HashValue hashes[kCount];
+  for (uint32_t i = 0; i < kCount; ++i) {
+    hashes[i] = (static_cast<HashValue>(i + 1U) << 32) | 42U;
+    page->admit(
+      hashes[i],
+      HashHotDirectoryPage::to_location(construct_volatile_page_pointer(i + 1U), i),
+      i * 7U);
+    EXPECT_EQ(HashHotDirectoryPage::to_location(construct_volatile_page_pointer(i + 1U), i),
+      page->lookup(hashes[i])) << i;
+  }
+  EXPECT_EQ(static_cast<uint32_t>(HashHotDirectoryPage::kWays), page->count_entries());
+  uint32_t found = 0;
+  for (uint32_t i = 0; i < kCount; ++i) {
+    uint64_t location = page->lookup(hashes[i]);
+    if (location) {
+      ++found;
+      EXPECT_EQ(i, HashHotDirectoryPage::extract_index(location)) << i;
+    }
+  }
+  EXPECT_EQ(static_cast<uint32_t>(HashHotDirectoryPage::kWays), found);
+}
+
+TEST(HashHotDirectoryTest, PageIndex) {
+  // hash values in the same bucket of a page spread over pages, and vice versa
+  const uint16_t kPages = 5;
+  uint32_t counts[kPages];
+  std::memset(counts, 0, sizeof(counts));
+  for (uint32_t i = 0; i < HashHotDirectoryPage::kBuckets * kPages * 4U; ++i) {
+    const HashValue hash = (0xABCDULL << 48) | i;
+    const uint16_t index = HashHotDirectoryPage::get_page_index(hash, kPages);
+    ASSERT_LT(index, kPages);
+    ++counts[index];
+    EXPECT_EQ(0U, HashHotDirectoryPage::get_page_index(hash, 1));
+  }
+  for (uint16_t p = 0; p < kPages; ++p) {
+    EXPECT_EQ(HashHotDirectoryPage::kBuckets * 4U, counts[p]) << p;
+  }
+}
+
+ErrorStack insert_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint64_t key = 0; key < kRecords; ++key) {
+    uint64_t data = key;
+    WRAP_ERROR_CODE(hash.insert_record(context, &key, sizeof(key), &data, sizeof(data)));
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack read_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(ReadParams), args.input_len_);
+  const ReadParams* params = reinterpret_cast<const ReadParams*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  // read twice so that the second round hits the directory
+  for (uint32_t rep = 0; rep < 2U; ++rep) {
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    // every page is hot in this transaction
+    context->get_current_xct().set_hot_threshold_for_this_xct(0);
+    for (uint64_t key = 0; key < kRecords; ++key) {
+      uint64_t data = 0;
+      uint16_t capacity = sizeof(data);
+      ErrorCode ret = hash.get_record(context, &key, sizeof(key), &data, &capacity, true);
+      if (key < params->deleted_below_) {
+        EXPECT_EQ(kErrorCodeStrKeyNotFound, ret) << key;
+      } else {
+        EXPECT_EQ(kErrorCodeOk, ret) << key;
+        EXPECT_EQ(key + params->addendum_, data) << key;
+      }
+    }
+    Epoch commit_epoch;
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  }
+
+  const uint32_t entries = count_directory_entries(context, &hash);
+  if (params->expect_entries_) {
+    EXPECT_GT(entries, params->entries_more_than_);
+  } else {
+    EXPECT_EQ(0U, entries);
+  }
+  return kRetOk;
+}
+
+ErrorStack update_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(uint32_t), args.input_len_);
+  const uint32_t delete_below = *reinterpret_cast<const uint32_t*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  context->get_current_xct().set_hot_threshold_for_this_xct(0);
+  for (uint64_t key = 0; key < kRecords; ++key) {
+    if (key < delete_below) {
+      WRAP_ERROR_CODE(hash.delete_record(context, &key, sizeof(key)));
+    } else {
+      WRAP_ERROR_CODE(hash.increment_record_oneshot<uint64_t>(context, &key, sizeof(key), 1, 0));
+    }
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+void read(
+  Engine* engine,
+  uint32_t deleted_below,
+  uint64_t addendum,
+  bool expect_entries,
+  uint32_t entries_more_than = 0) {
+  ReadParams params = {deleted_below, addendum, expect_entries, entries_more_than};
+  COERCE_ERROR(engine->get_thread_pool()->impersonate_synchronous(
+    "read_task",
+    &params,
+    sizeof(params)));
+}
+
+EngineOptions make_options() {
+  EngineOptions options = get_tiny_options();
+  options.log_.loggers_per_node_ = 1;
+  options.memory_.page_pool_size_mb_per_node_ = 20;
+  options.cache_.snapshot_cache_size_mb_per_node_ = 20;
+  return options;
+}
+
+void register_tasks(Engine* engine) {
+  engine->get_proc_manager()->pre_register("insert_task", insert_task);
+  engine->get_proc_manager()->pre_register("read_task", read_task);
+  engine->get_proc_manager()->pre_register("update_task", update_task);
+}
+
+TEST(HashHotDirectoryTest, Disabled) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta(kName, 8);
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    for (uint16_t node = 0; node < soc::kMaxSocs; ++node) {
+      EXPECT_TRUE(storage.get_control_block()->hot_directories_[node].is_null()) << node;
+    }
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(HashHotDirectoryTest, Volatile) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta(kName, 8);
+    meta.hot_directory_ = 1;
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    EXPECT_FALSE(storage.get_control_block()->hot_directories_[0].is_null());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("insert_task"));
+    read(&engine, 0, 0, true);
+
+    // updates and deletes via the directory, then reads again
+    uint32_t delete_below = kRecords / 4U;
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous(
+      "update_task",
+      &delete_below,
+      sizeof(delete_below)));
+    read(&engine, delete_below, 1, true);
+    COERCE_ERROR(storage.verify_single_thread(&engine));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(HashHotDirectoryTest, ManyPages) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta(kName, 8);
+    meta.hot_directory_ = 8;
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("insert_task"));
+
+    // more hot keys than one page can hold
+    const uint32_t kOnePage = HashHotDirectoryPage::kBuckets * HashHotDirectoryPage::kWays;
+    ASSERT_GT(kRecords, kOnePage);
+    read(&engine, 0, 0, true, kOnePage);
+    COERCE_ERROR(storage.verify_single_thread(&engine));
+
+    // all pages are cleared by the snapshot
+    engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+    read(&engine, 0, 0, false);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(HashHotDirectoryTest, Snapshot) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta(kName, 8);
+    meta.hot_directory_ = 1;
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("insert_task"));
+    read(&engine, 0, 0, true);
+
+    // volatile pages are dropped, and so are the entries pointing to them.
+    // records are now read from snapshot pages, which are never admitted.
+    engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+    read(&engine, 0, 0, false);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+}  // namespace hash
+}  // namespace storage
+}  // namespace foedus
+
+TEST_MAIN_CAPTURE_SIGNALS(HashHotDirectoryTest, foedus.storage.hash);
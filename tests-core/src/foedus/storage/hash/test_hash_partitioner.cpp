@@ -192,6 +192,52 @@ struct Logs {
     ++cur_count_;
   }
 
+  void add_overwrite_log(
+    Epoch::EpochInteger epoch_int,
+    uint32_t ordinal,
+    uint64_t key,
+    uint16_t payload_offset,
+    uint16_t payload_count) {
+    HashOverwriteLogType* entry = reinterpret_cast<HashOverwriteLogType*>(memory_ + cur_pos_);
+    uint64_t data = key;
+    HashValue hash = hashinate(&key, sizeof(key));
+    entry->populate(
+      partitioner_.get_storage_id(),
+      &key,
+      sizeof(key),
+      kBinBits,
+      hash,
+      &data,
+      payload_offset,
+      payload_count);
+    entry->header_.xct_id_.set(epoch_int, ordinal);
+    positions_[cur_count_] = log_buffer_.compact(entry);
+    cur_pos_ += entry->header_.log_length_;
+    ++cur_count_;
+  }
+
+  void add_increment_log(
+    Epoch::EpochInteger epoch_int,
+    uint32_t ordinal,
+    uint64_t key,
+    uint32_t addendum,
+    uint16_t payload_offset) {
+    HashIncrementLogType* entry = reinterpret_cast<HashIncrementLogType*>(memory_ + cur_pos_);
+    HashValue hash = hashinate(&key, sizeof(key));
+    entry->populate<uint32_t>(
+      partitioner_.get_storage_id(),
+      &key,
+      sizeof(key),
+      kBinBits,
+      hash,
+      addendum,
+      payload_offset);
+    entry->header_.xct_id_.set(epoch_int, ordinal);
+    positions_[cur_count_] = log_buffer_.compact(entry);
+    cur_pos_ += entry->header_.log_length_;
+    ++cur_count_;
+  }
+
   void partition_batch() {
     Partitioner::PartitionBatchArguments args = {
       0,
@@ -287,6 +333,70 @@ void SortBasicFunctor(Partitioner partitioner, uint32_t /*records*/) {
       || (pre_bin == cur_bin && pre_ordinal <= cur_ordinal)) << i;
   }
 }
+void SortCompactFunctor(Partitioner partitioner, uint32_t /*records*/) {
+  std::unique_ptr< Logs<16> > logs(new Logs<16>(partitioner));
+  // all of them are on the same key and the same data region.
+  // all but the last log should be discarded away.
+  for (uint32_t i = 0; i < 16U; ++i) {
+    // epoch is ordered, but ordinal is reverse-ordered.
+    logs->add_overwrite_log(2 + i, 30 - i, 123, 0, 8);
+  }
+  EXPECT_EQ(1U, logs->sort_batch(2));
+  // as epoch is more significant than ordinal, [15] is the last log
+  EXPECT_EQ(logs->positions_[15], logs->sort_results_[0]);
+}
+
+void SortNoCompactFunctor(Partitioner partitioner, uint32_t /*records*/) {
+  std::unique_ptr< Logs<16> > logs(new Logs<16>(partitioner));
+  // Again on the same key, but data regions are different.
+  for (uint32_t i = 0; i < 16U; ++i) {
+    logs->add_overwrite_log(2 + i, 30 - i, 123, i, 1);
+  }
+  // all of them should not be compacted, and sorted by epoch
+  EXPECT_EQ(16U, logs->sort_batch(2));
+  for (uint32_t i = 0; i < 16U; ++i) {
+    EXPECT_EQ(logs->positions_[i], logs->sort_results_[i]);
+  }
+}
+
+void SortCompactIncrementFunctor(Partitioner partitioner, uint32_t /*records*/) {
+  // two keys in the same bin, so their logs are interleaved after sorting.
+  const uint64_t key_a = 123;
+  const HashBin bin = hashinate(key_a) >> (64 - kBinBits);
+  uint64_t key_b = key_a + 1U;
+  while ((hashinate(key_b) >> (64 - kBinBits)) != bin) {
+    ++key_b;
+  }
+
+  std::unique_ptr< Logs<32> > logs(new Logs<32>(partitioner));
+  for (uint32_t i = 0; i < 8U; ++i) {
+    logs->add_increment_log(2, i * 2 + 1, key_a, 1, 4);
+    logs->add_increment_log(2, i * 2 + 2, key_b, 10, 4);
+  }
+  // an insert on key_b is never compacted, and breaks the chain of increments before it.
+  logs->add_log(2, 17, key_b);
+  logs->add_increment_log(2, 18, key_b, 10, 4);
+  logs->add_increment_log(2, 19, key_b, 10, 4);
+  // an increment on another offset can't be merged.
+  logs->add_increment_log(2, 20, key_a, 1, 0);
+
+  EXPECT_EQ(5U, logs->sort_batch(2));
+  const HashIncrementLogType* results[5];
+  for (uint32_t i = 0; i < 5U; ++i) {
+    results[i] = reinterpret_cast<HashIncrementLogType*>(
+      logs->log_buffer_.resolve(logs->sort_results_[i]));
+  }
+  EXPECT_EQ(logs->positions_[14], logs->sort_results_[0]);
+  EXPECT_EQ(8U, *reinterpret_cast<const uint32_t*>(results[0]->get_addendum()));
+  EXPECT_EQ(logs->positions_[15], logs->sort_results_[1]);
+  EXPECT_EQ(80U, *reinterpret_cast<const uint32_t*>(results[1]->get_addendum()));
+  EXPECT_EQ(log::kLogCodeHashInsert, results[2]->header_.get_type());
+  EXPECT_EQ(logs->positions_[18], logs->sort_results_[3]);
+  EXPECT_EQ(20U, *reinterpret_cast<const uint32_t*>(results[3]->get_addendum()));
+  EXPECT_EQ(logs->positions_[19], logs->sort_results_[4]);
+  EXPECT_EQ(1U, *reinterpret_cast<const uint32_t*>(results[4]->get_addendum()));
+}
+
 TEST(HashPartitionerTest, Empty) { execute_test(&EmptyFunctor, 16); }
 TEST(HashPartitionerTest, EmptyMany) { execute_test(&EmptyFunctor, 1024); }
 
@@ -295,6 +405,11 @@ TEST(HashPartitionerTest, PartitionBasicMany) { execute_test(&PartitionBasicFunc
 
 // sorting has nothing with partitioning, so no need for "many" training inputs.
 TEST(HashPartitionerTest, SortBasic) { execute_test(&SortBasicFunctor, 16); }
+TEST(HashPartitionerTest, SortCompact) { execute_test(&SortCompactFunctor, 16); }
+TEST(HashPartitionerTest, SortNoCompact) { execute_test(&SortNoCompactFunctor, 16); }
+TEST(HashPartitionerTest, SortCompactIncrement) {
+  execute_test(&SortCompactIncrementFunctor, 16);
+}
 
 }  // namespace hash
 }  // namespace storage
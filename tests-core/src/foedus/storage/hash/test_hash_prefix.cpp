@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <cstring>
+
+#include "foedus/engine.hpp"
+#include "foedus/engine_options.hpp"
+#include "foedus/epoch.hpp"
+#include "foedus/test_common.hpp"
+#include "foedus/proc/proc_manager.hpp"
+#include "foedus/snapshot/snapshot_manager.hpp"
+#include "foedus/storage/storage_manager.hpp"
+#include "foedus/storage/hash/hash_combo.hpp"
+#include "foedus/storage/hash/hash_cursor.hpp"
+#include "foedus/storage/hash/hash_hashinate.hpp"
+#include "foedus/storage/hash/hash_metadata.hpp"
+#include "foedus/storage/hash/hash_storage.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/thread/thread_pool.hpp"
+#include "foedus/xct/xct_manager.hpp"
+
+/**
+ * @file test_hash_prefix.cpp
+ * Prefix-partitioned hash storages with (tenant, id) composite keys.
+ */
+namespace foedus {
+namespace storage {
+namespace hash {
+DEFINE_TEST_CASE_PACKAGE(HashPrefixTest, foedus.storage.hash);
+
+struct CompositeKey {
+  uint32_t tenant_;
+  uint32_t id_;
+};
+
+const uint32_t kTenants = 8;
+const StorageName kName("test");
+/** 2 levels of intermediate pages */
+const uint8_t kBinBits = 10;
+/** Each tenant has 128 bins, which is one level-0 intermediate page */
+const uint8_t kPrefixBits = 3;
+
+/** Input of verify_task */
+struct VerifyParams {
+  xct::IsolationLevel isolation_;
+  /** ids [0, ids_) of each tenant are expected */
+  uint32_t ids_;
+};
+
+uint64_t to_data(const CompositeKey& key) { return key.tenant_ * 100000ULL + key.id_; }
+
+HashMetadata make_metadata(uint8_t bin_bits, uint8_t prefix_bits) {
+  HashMetadata meta(kName, bin_bits);
+  meta.prefix_length_ = sizeof(uint32_t);
+  meta.prefix_bits_ = prefix_bits;
+  return meta;
+}
+
+TEST(HashPrefixTest, BinRange) {
+  const uint8_t kBinBitsArray[] = {kHashMinBinBits, kBinBits, 16, kHashMaxBinBits};
+  const uint8_t kPrefixBitsArray[] = {0, 1, kPrefixBits, 12, kHashMaxPrefixBits};
+  for (uint8_t bin_bits : kBinBitsArray) {
+    for (uint8_t prefix_bits : kPrefixBitsArray) {
+      if (prefix_bits >= bin_bits) {
+        continue;  // rejected by create(). see InvalidOption
+      }
+      HashMetadata meta = make_metadata(bin_bits, prefix_bits);
+      EXPECT_EQ(prefix_bits != 0, meta.is_prefix_partitioned());
+      for (uint32_t tenant = 0; tenant < kTenants; ++tenant) {
+        HashBinRange range = meta.get_prefix_bin_range(&tenant);
+        if (prefix_bits == 0) {
+          EXPECT_EQ(HashBinRange(0, meta.get_bin_count()), range);
+        } else {
+          EXPECT_EQ(1ULL << (bin_bits - prefix_bits), range.length());
+        }
+        for (uint32_t id = 0; id < 256U; ++id) {
+          CompositeKey key = {tenant, id};
+          HashCombo combo(&key, sizeof(key), meta);
+          EXPECT_EQ(meta.hashinate_key(&key, sizeof(key)), combo.hash_);
+          EXPECT_TRUE(range.contains(combo.bin_)) << tenant << "," << id << "," << meta;
+        }
+      }
+    }
+  }
+}
+
+ErrorStack insert_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(uint32_t) * 2U, args.input_len_);
+  const uint32_t* ids = reinterpret_cast<const uint32_t*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint32_t tenant = 0; tenant < kTenants; ++tenant) {
+    for (uint32_t id = ids[0]; id < ids[1]; ++id) {
+      CompositeKey key = {tenant, id};
+      uint64_t data = to_data(key);
+      WRAP_ERROR_CODE(hash.insert_record(context, &key, sizeof(key), &data, sizeof(data)));
+    }
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack verify_task(const proc::ProcArguments& args) {
+  EXPECT_EQ(sizeof(VerifyParams), args.input_len_);
+  const VerifyParams* params = reinterpret_cast<const VerifyParams*>(args.input_buffer_);
+  thread::Thread* context = args.context_;
+  HashStorage hash(args.engine_, kName);
+  EXPECT_TRUE(hash.get_hash_metadata()->is_prefix_partitioned());
+  xct::XctManager* xct_manager = args.engine_->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, params->isolation_));
+  for (uint32_t tenant = 0; tenant < kTenants; ++tenant) {
+    for (uint32_t id = 0; id < params->ids_; ++id) {
+      CompositeKey key = {tenant, id};
+      uint64_t data = 0;
+      uint16_t capacity = sizeof(data);
+      WRAP_ERROR_CODE(hash.get_record(context, &key, sizeof(key), &data, &capacity, true));
+      EXPECT_EQ(to_data(key), data) << tenant << "," << id;
+    }
+
+    // all records of the tenant are in its bins
+    HashBinRange range = hash.get_hash_metadata()->get_prefix_bin_range(&tenant);
+    HashCursor cursor(context, hash);
+    WRAP_ERROR_CODE(cursor.open(range));
+    uint32_t count = 0;
+    while (cursor.is_valid_record()) {
+      EXPECT_EQ(sizeof(CompositeKey), cursor.get_key_length());
+      CompositeKey key;
+      std::memcpy(&key, cursor.get_key(), sizeof(key));
+      if (key.tenant_ == tenant) {
+        ++count;
+      } else {
+        // another tenant is here only if its prefix has the same most significant bits
+        EXPECT_EQ(range, hash.get_hash_metadata()->get_prefix_bin_range(&key.tenant_));
+      }
+      WRAP_ERROR_CODE(cursor.next());
+    }
+    EXPECT_EQ(params->ids_, count) << tenant;
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  return kRetOk;
+}
+
+void insert(Engine* engine, uint32_t from, uint32_t to) {
+  uint32_t ids[2] = {from, to};
+  COERCE_ERROR(engine->get_thread_pool()->impersonate_synchronous(
+    "insert_task",
+    ids,
+    sizeof(ids)));
+}
+
+void verify(Engine* engine, xct::IsolationLevel isolation, uint32_t ids) {
+  VerifyParams params = {isolation, ids};
+  COERCE_ERROR(engine->get_thread_pool()->impersonate_synchronous(
+    "verify_task",
+    &params,
+    sizeof(params)));
+}
+
+EngineOptions make_options() {
+  EngineOptions options = get_tiny_options();
+  options.log_.loggers_per_node_ = 1;
+  options.memory_.page_pool_size_mb_per_node_ = 20;
+  options.cache_.snapshot_cache_size_mb_per_node_ = 20;
+  return options;
+}
+
+void register_tasks(Engine* engine) {
+  engine->get_proc_manager()->pre_register("insert_task", insert_task);
+  engine->get_proc_manager()->pre_register("verify_task", verify_task);
+}
+
+TEST(HashPrefixTest, InvalidOption) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashStorage storage;
+    Epoch epoch;
+    HashMetadata too_many = make_metadata(kHashMaxBinBits, kHashMaxPrefixBits + 1U);
+    EXPECT_TRUE(engine.get_storage_manager()->create_hash(&too_many, &storage, &epoch).is_error());
+    HashMetadata all_bins = make_metadata(kBinBits, kBinBits);
+    EXPECT_TRUE(engine.get_storage_manager()->create_hash(&all_bins, &storage, &epoch).is_error());
+    HashMetadata more_than_bins = make_metadata(kBinBits, kBinBits + 1U);
+    EXPECT_TRUE(
+      engine.get_storage_manager()->create_hash(&more_than_bins, &storage, &epoch).is_error());
+
+    // prefix_length_ == 0 ignores prefix_bits_
+    HashMetadata ignored = make_metadata(kBinBits, kBinBits + 1U);
+    ignored.prefix_length_ = 0;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&ignored, &storage, &epoch));
+    EXPECT_FALSE(storage.get_hash_metadata()->is_prefix_partitioned());
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(HashPrefixTest, Volatile) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta = make_metadata(kBinBits, kPrefixBits);
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    insert(&engine, 0, 64);
+    verify(&engine, xct::kSerializable, 64);
+    COERCE_ERROR(storage.verify_single_thread(&engine));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(HashPrefixTest, Snapshot) {
+  EngineOptions options = make_options();
+  Engine engine(options);
+  register_tasks(&engine);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    HashMetadata meta = make_metadata(kBinBits, kPrefixBits);
+    HashStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+    insert(&engine, 0, 64);
+    engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+    verify(&engine, xct::kSnapshot, 64);
+    verify(&engine, xct::kSerializable, 64);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(HashPrefixTest, Resize) {
+  EngineOptions options = make_options();
+  {
+    Engine engine(options);
+    register_tasks(&engine);
+    COERCE_ERROR(engine.initialize());
+    {
+      UninitializeGuard guard(&engine);
+      HashMetadata meta = make_metadata(kBinBits, kPrefixBits);
+      HashStorage storage;
+      Epoch epoch;
+      COERCE_ERROR(engine.get_storage_manager()->create_hash(&meta, &storage, &epoch));
+      insert(&engine, 0, 64);
+      engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+
+      // hash values do not depend on bin_bits, so a tenant stays in its (now larger) range
+      COERCE_ERROR(storage.request_resize(kBinBits + 2U));
+      insert(&engine, 64, 96);
+      engine.get_snapshot_manager()->trigger_snapshot_immediate(true);
+      EXPECT_EQ(kBinBits + 2U, storage.get_bin_bits());
+      verify(&engine, xct::kSnapshot, 96);
+      verify(&engine, xct::kSerializable, 96);
+      COERCE_ERROR(engine.uninitialize());
+    }
+  }
+  {
+    // the prefix options are restored from the savepoint
+    Engine engine(options);
+    register_tasks(&engine);
+    COERCE_ERROR(engine.initialize());
+    {
+      UninitializeGuard guard(&engine);
+      verify(&engine, xct::kSerializable, 96);
+      COERCE_ERROR(engine.uninitialize());
+    }
+  }
+  cleanup_test(options);
+}
+
+}  // namespace hash
+}  // namespace storage
+}  // namespace foedus
+
+TEST_MAIN_CAPTURE_SIGNALS(HashPrefixTest, foedus.storage.hash);
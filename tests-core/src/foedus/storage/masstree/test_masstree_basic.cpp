@@ -25,6 +25,7 @@
 #include "foedus/engine_options.hpp"
 #include "foedus/epoch.hpp"
 #include "foedus/test_common.hpp"
+#include "foedus/assorted/endianness.hpp"
 #include "foedus/assorted/uniform_random.hpp"
 #include "foedus/proc/proc_manager.hpp"
 #include "foedus/storage/storage_manager.hpp"
@@ -349,6 +350,219 @@ TEST(MasstreeBasicTest, NextLayer) {
   cleanup_test(options);
 }
 
+ErrorStack get_batch_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  MasstreeStorage masstree = context->get_engine()->get_storage_manager()->get_masstree("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  const bool normalized = *reinterpret_cast<const bool*>(args.input_buffer_);
+  // Insert even keys only, in many transactions to cause page splits and, for non-normalized
+  // keys, next layers because all keys share the first slice.
+  const uint32_t kKeys = 1000;
+  const KeyLength kKeyLength = 16;
+  char keys[kKeys][kKeyLength];
+  KeySlice slices[kKeys];
+  for (uint32_t i = 0; i < kKeys; ++i) {
+    std::memset(keys[i], 0x42, kKeyLength);
+    assorted::write_bigendian<uint64_t>(i, keys[i] + 8);
+    slices[i] = normalize_primitive<uint64_t>(i);
+  }
+  Epoch commit_epoch;
+  for (uint32_t i = 0; i < kKeys; i += 2) {
+    if (i % 100 == 0) {
+      WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    }
+    uint64_t data = i * 3ULL;
+    if (normalized) {
+      WRAP_ERROR_CODE(masstree.insert_record_normalized(context, slices[i], &data, sizeof(data)));
+    } else {
+      WRAP_ERROR_CODE(masstree.insert_record(context, keys[i], kKeyLength, &data, sizeof(data)));
+    }
+    if (i % 100 == 98) {
+      WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+    }
+  }
+
+  // Batch-read in a scrambled order, including non-existing keys and more than kBatchMax keys.
+  const uint16_t kBatch = 50;
+  const void* key_batch[kBatch];
+  KeyLength key_length_batch[kBatch];
+  KeySlice slice_batch[kBatch];
+  uint64_t data_batch[kBatch];
+  void* payload_batch[kBatch];
+  PayloadLength capacity_batch[kBatch];
+  ErrorCode result_batch[kBatch];
+  uint32_t index_batch[kBatch];
+  assorted::UniformRandom rnd(1234);
+  for (uint32_t rep = 0; rep < 10U; ++rep) {
+    for (uint16_t i = 0; i < kBatch; ++i) {
+      index_batch[i] = rnd.uniform_within(0, kKeys - 1);
+      key_batch[i] = keys[index_batch[i]];
+      key_length_batch[i] = kKeyLength;
+      slice_batch[i] = slices[index_batch[i]];
+      payload_batch[i] = data_batch + i;
+      // one of them has a too small buffer
+      capacity_batch[i] = (i == 7) ? 4U : sizeof(uint64_t);
+    }
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    if (normalized) {
+      WRAP_ERROR_CODE(masstree.get_record_normalized_batch(
+        context,
+        kBatch,
+        slice_batch,
+        payload_batch,
+        capacity_batch,
+        result_batch,
+        true));
+    } else {
+      WRAP_ERROR_CODE(masstree.get_record_batch(
+        context,
+        kBatch,
+        key_batch,
+        key_length_batch,
+        payload_batch,
+        capacity_batch,
+        result_batch,
+        true));
+    }
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+    for (uint16_t i = 0; i < kBatch; ++i) {
+      if (index_batch[i] % 2U != 0) {
+        EXPECT_EQ(kErrorCodeStrKeyNotFound, result_batch[i]) << i;
+      } else if (i == 7) {
+        EXPECT_EQ(kErrorCodeStrTooSmallPayloadBuffer, result_batch[i]) << i;
+        EXPECT_EQ(sizeof(uint64_t), capacity_batch[i]) << i;
+      } else {
+        EXPECT_EQ(kErrorCodeOk, result_batch[i]) << i;
+        EXPECT_EQ(sizeof(uint64_t), capacity_batch[i]) << i;
+        EXPECT_EQ(index_batch[i] * 3ULL, data_batch[i]) << i;
+      }
+    }
+  }
+
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  CHECK_ERROR(masstree.verify_single_thread(context));
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return foedus::kRetOk;
+}
+
+void test_get_batch(bool normalized) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("get_batch_task", get_batch_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    MasstreeMetadata meta("ggg");
+    MasstreeStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_masstree(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous(
+      "get_batch_task",
+      &normalized,
+      sizeof(normalized)));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(MasstreeBasicTest, GetBatch) { test_get_batch(false); }
+TEST(MasstreeBasicTest, GetBatchNormalized) { test_get_batch(true); }
+
+ErrorStack insert_batch_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  MasstreeStorage masstree = context->get_engine()->get_storage_manager()->get_masstree("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  const bool sorted = *reinterpret_cast<const bool*>(args.input_buffer_);
+  const uint32_t kKeys = 1000;
+  Epoch commit_epoch;
+
+  // Some of the keys already exist
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint32_t i = 0; i < kKeys; i += 10U) {
+    uint64_t data[2] = {i * 3ULL, i * 5ULL};
+    KeySlice key = normalize_primitive<uint64_t>(i);
+    WRAP_ERROR_CODE(masstree.insert_record_normalized(context, key, data, sizeof(data)));
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+
+  // Batches larger than kReserveBatchMax. 7 is coprime to kKeys, so i*7 scrambles the keys.
+  const uint16_t kBatch = 200;
+  KeySlice key_batch[kBatch];
+  uint64_t data_batch[kBatch][2];
+  const void* payload_batch[kBatch];
+  ErrorCode result_batch[kBatch];
+  uint32_t index_batch[kBatch];
+  for (uint32_t from = 0; from < kKeys; from += kBatch) {
+    for (uint16_t i = 0; i < kBatch; ++i) {
+      index_batch[i] = sorted ? from + i : ((from + i) * 7U) % kKeys;
+      key_batch[i] = normalize_primitive<uint64_t>(index_batch[i]);
+      data_batch[i][0] = index_batch[i] * 3ULL;
+      data_batch[i][1] = index_batch[i] * 5ULL;
+      payload_batch[i] = data_batch[i];
+    }
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    WRAP_ERROR_CODE(masstree.insert_record_normalized_batch(
+      context,
+      kBatch,
+      key_batch,
+      payload_batch,
+      sizeof(data_batch[0]),
+      result_batch));
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+    for (uint16_t i = 0; i < kBatch; ++i) {
+      if (index_batch[i] % 10U == 0) {
+        EXPECT_EQ(kErrorCodeStrKeyAlreadyExists, result_batch[i]) << index_batch[i];
+      } else {
+        EXPECT_EQ(kErrorCodeOk, result_batch[i]) << index_batch[i];
+      }
+    }
+  }
+
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint32_t i = 0; i < kKeys; ++i) {
+    uint64_t data[2];
+    PayloadLength capacity = sizeof(data);
+    KeySlice key = normalize_primitive<uint64_t>(i);
+    WRAP_ERROR_CODE(masstree.get_record_normalized(context, key, data, &capacity, true));
+    EXPECT_EQ(sizeof(data), capacity) << i;
+    EXPECT_EQ(i * 3ULL, data[0]) << i;
+    EXPECT_EQ(i * 5ULL, data[1]) << i;
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  CHECK_ERROR(masstree.verify_single_thread(context));
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return foedus::kRetOk;
+}
+
+void test_insert_batch(bool sorted) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("insert_batch_task", insert_batch_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    MasstreeMetadata meta("ggg");
+    MasstreeStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_masstree(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous(
+      "insert_batch_task",
+      &sorted,
+      sizeof(sorted)));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(MasstreeBasicTest, InsertBatch) { test_insert_batch(true); }
+TEST(MasstreeBasicTest, InsertBatchUnsorted) { test_insert_batch(false); }
+
 TEST(MasstreeBasicTest, CreateAndDrop) {
   EngineOptions options = get_tiny_options();
   Engine engine(options);
@@ -376,6 +590,8 @@ struct ExpandTaskInput {
   bool update_case_;
   bool normalized_case_;
   bool next_layer_case_;
+  /** If true, we expand the record with extend_record() rather than delete/insert or upsert */
+  bool extend_case_;
 };
 
 ErrorStack expand_task(const proc::ProcArguments& args) {
@@ -434,7 +650,17 @@ ErrorStack expand_task(const proc::ProcArguments& args) {
     for (int i = 0; i < 2; ++i) {
       KeySlice norm_key = kKeyNormalized[i];
       const char* key = kKey[i].data();
-      if (!inputs->update_case_) {
+      if (inputs->extend_case_) {
+        // in this case we append to an active record, using extend
+        CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+        const char* appended = data + len - kExpandLen;
+        if (inputs->normalized_case_) {
+          CHECK_ERROR(storage.extend_record_normalized(context, norm_key, appended, kExpandLen));
+        } else {
+          CHECK_ERROR(storage.extend_record(context, key, kKeyLen, appended, kExpandLen));
+        }
+        CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+      } else if (!inputs->update_case_) {
         // in this case we move a deleted record, using insert
         CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
         if (inputs->normalized_case_) {
@@ -509,7 +735,7 @@ ErrorStack expand_task(const proc::ProcArguments& args) {
   return foedus::kRetOk;
 }
 
-void test_expand(bool update_case, bool normalized, bool next_layer) {
+void test_expand(bool update_case, bool normalized, bool next_layer, bool extend_case) {
   EngineOptions options = get_tiny_options();
   Engine engine(options);
   engine.get_proc_manager()->pre_register("expand_task", expand_task);
@@ -521,7 +747,7 @@ void test_expand(bool update_case, bool normalized, bool next_layer) {
     Epoch epoch;
     COERCE_ERROR(engine.get_storage_manager()->create_masstree(&meta, &storage, &epoch));
     EXPECT_TRUE(storage.exists());
-    ExpandTaskInput inputs = { update_case, normalized, next_layer };
+    ExpandTaskInput inputs = { update_case, normalized, next_layer, extend_case };
     COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous(
       "expand_task",
       &inputs,
@@ -531,12 +757,112 @@ void test_expand(bool update_case, bool normalized, bool next_layer) {
   cleanup_test(options);
 }
 
-TEST(MasstreeBasicTest, ExpandInsert) { test_expand(false, false, false); }
-TEST(MasstreeBasicTest, ExpandInsertNextLayer) { test_expand(false, false, true); }
-TEST(MasstreeBasicTest, ExpandInsertNormalized) { test_expand(false, true, false); }
-TEST(MasstreeBasicTest, ExpandUpdate) { test_expand(true, false, false); }
-TEST(MasstreeBasicTest, ExpandUpdateNextLayer) { test_expand(true, false, true); }
-TEST(MasstreeBasicTest, ExpandUpdateNormalized) { test_expand(true, true, false); }
+TEST(MasstreeBasicTest, ExpandInsert) { test_expand(false, false, false, false); }
+TEST(MasstreeBasicTest, ExpandInsertNextLayer) { test_expand(false, false, true, false); }
+TEST(MasstreeBasicTest, ExpandInsertNormalized) { test_expand(false, true, false, false); }
+TEST(MasstreeBasicTest, ExpandUpdate) { test_expand(true, false, false, false); }
+TEST(MasstreeBasicTest, ExpandUpdateNextLayer) { test_expand(true, false, true, false); }
+TEST(MasstreeBasicTest, ExpandUpdateNormalized) { test_expand(true, true, false, false); }
+TEST(MasstreeBasicTest, ExpandExtend) { test_expand(false, false, false, true); }
+TEST(MasstreeBasicTest, ExpandExtendNextLayer) { test_expand(false, false, true, true); }
+TEST(MasstreeBasicTest, ExpandExtendNormalized) { test_expand(false, true, false, true); }
+
+ErrorStack truncate_replace_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  MasstreeStorage storage(args.engine_, "ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  Epoch commit_epoch;
+  const std::string kKey("key1234567890");
+  const std::string kMissingKey("key1234567891");
+  char data[kMaxPayloadLength];
+  for (PayloadLength c = 0; c < sizeof(data); ++c) {
+    data[c] = static_cast<char>(c * 3);
+  }
+  char retrieved[kMaxPayloadLength];
+  PayloadLength capacity;
+
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  CHECK_ERROR(storage.insert_record(context, kKey.data(), kKey.size(), data, 100));
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+
+  // truncate, then extending it again reuses the space
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  CHECK_ERROR(storage.truncate_record(context, kKey.data(), kKey.size(), 40));
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  EXPECT_EQ(
+    kErrorCodeStrTooShortPayload,
+    storage.truncate_record(context, kKey.data(), kKey.size(), 50));
+  capacity = sizeof(retrieved);
+  CHECK_ERROR(storage.get_record(context, kKey.data(), kKey.size(), retrieved, &capacity, true));
+  EXPECT_EQ(40U, capacity);
+  EXPECT_EQ(0, std::memcmp(data, retrieved, capacity));
+  CHECK_ERROR(storage.extend_record(context, kKey.data(), kKey.size(), data + 40, 20));
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  capacity = sizeof(retrieved);
+  CHECK_ERROR(storage.get_record(context, kKey.data(), kKey.size(), retrieved, &capacity, true));
+  EXPECT_EQ(60U, capacity);
+  EXPECT_EQ(0, std::memcmp(data, retrieved, capacity));
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+
+  // replace with a longer payload, then with a shorter one
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  CHECK_ERROR(storage.replace_record(context, kKey.data(), kKey.size(), data + 1, 300));
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  capacity = sizeof(retrieved);
+  CHECK_ERROR(storage.get_record(context, kKey.data(), kKey.size(), retrieved, &capacity, true));
+  EXPECT_EQ(300U, capacity);
+  EXPECT_EQ(0, std::memcmp(data + 1, retrieved, capacity));
+  CHECK_ERROR(storage.replace_record(context, kKey.data(), kKey.size(), data + 2, 10));
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+
+  CHECK_ERROR(xct_manager->begin_xct(context, xct::kSerializable));
+  capacity = sizeof(retrieved);
+  CHECK_ERROR(storage.get_record(context, kKey.data(), kKey.size(), retrieved, &capacity, true));
+  EXPECT_EQ(10U, capacity);
+  EXPECT_EQ(0, std::memcmp(data + 2, retrieved, capacity));
+
+  // errors
+  EXPECT_EQ(
+    kErrorCodeStrTooLongPayload,
+    storage.extend_record(context, kKey.data(), kKey.size(), data, kMaxPayloadLength));
+  EXPECT_EQ(
+    kErrorCodeStrKeyNotFound,
+    storage.extend_record(context, kMissingKey.data(), kMissingKey.size(), data, 10));
+  EXPECT_EQ(
+    kErrorCodeStrKeyNotFound,
+    storage.replace_record(context, kMissingKey.data(), kMissingKey.size(), data, 10));
+  EXPECT_EQ(
+    kErrorCodeStrKeyNotFound,
+    storage.truncate_record(context, kMissingKey.data(), kMissingKey.size(), 0));
+  CHECK_ERROR(xct_manager->precommit_xct(context, &commit_epoch));
+
+  CHECK_ERROR(storage.verify_single_thread(context));
+  return foedus::kRetOk;
+}
+
+TEST(MasstreeBasicTest, TruncateReplace) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("truncate_replace_task", truncate_replace_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    MasstreeMetadata meta("ggg");
+    MasstreeStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_masstree(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("truncate_replace_task"));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
 // TASK(Hideaki): we don't have multi-thread cases here. it's not a "basic" test.
 // no multi-key cases either.
 
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "foedus/engine.hpp"
+#include "foedus/engine_options.hpp"
+#include "foedus/epoch.hpp"
+#include "foedus/test_common.hpp"
+#include "foedus/assorted/uniform_random.hpp"
+#include "foedus/proc/proc_manager.hpp"
+#include "foedus/storage/storage_manager.hpp"
+#include "foedus/storage/masstree/masstree_metadata.hpp"
+#include "foedus/storage/masstree/masstree_storage.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/thread/thread_pool.hpp"
+#include "foedus/xct/xct_manager.hpp"
+
+namespace foedus {
+namespace storage {
+namespace masstree {
+DEFINE_TEST_CASE_PACKAGE(MasstreeBulkLoadTest, foedus.storage.masstree);
+
+struct BulkLoadTaskInput {
+  uint32_t      count_;
+  PayloadLength payload_count_;
+  bool          then_insert_;
+  /** Give the keys in a random order */
+  bool          shuffle_;
+};
+
+/** Bulk-loaded keys are even numbers. Each payload begins with the key. */
+void fill_payload(uint64_t key, PayloadLength payload_count, char* payload) {
+  std::memset(payload, static_cast<int>(key % 100U), payload_count);
+  std::memcpy(payload, &key, sizeof(key));
+}
+
+ErrorStack bulk_load_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  MasstreeStorage masstree = context->get_engine()->get_storage_manager()->get_masstree("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  const BulkLoadTaskInput* input = reinterpret_cast<const BulkLoadTaskInput*>(args.input_buffer_);
+  const uint32_t count = input->count_;
+  const PayloadLength payload_count = input->payload_count_;
+
+  std::vector<KeySlice> keys(count);
+  std::vector<char> payloads(static_cast<uint64_t>(count) * payload_count);
+  for (uint32_t i = 0; i < count; ++i) {
+    keys[i] = normalize_primitive<uint64_t>(i * 2ULL);
+    fill_payload(i * 2ULL, payload_count, &payloads[static_cast<uint64_t>(i) * payload_count]);
+  }
+  if (input->shuffle_) {
+    assorted::UniformRandom rnd(123456);
+    std::vector<char> tmp(payload_count);
+    for (uint32_t i = count - 1U; i > 0; --i) {
+      const uint32_t j = rnd.uniform_within(0, i);
+      std::swap(keys[i], keys[j]);
+      char* left = &payloads[static_cast<uint64_t>(i) * payload_count];
+      char* right = &payloads[static_cast<uint64_t>(j) * payload_count];
+      std::memcpy(&tmp[0], left, payload_count);
+      std::memcpy(left, right, payload_count);
+      std::memcpy(right, &tmp[0], payload_count);
+    }
+  }
+  CHECK_ERROR(masstree.bulk_load_normalized(
+    context,
+    count,
+    &keys[0],
+    &payloads[0],
+    payload_count));
+
+  Epoch commit_epoch;
+  if (input->then_insert_) {
+    // fully packed pages must split to receive odd keys.
+    std::vector<char> payload(payload_count);
+    for (uint32_t i = 0; i < count; ++i) {
+      WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+      fill_payload(i * 2ULL + 1U, payload_count, &payload[0]);
+      KeySlice key = normalize_primitive<uint64_t>(i * 2ULL + 1U);
+      WRAP_ERROR_CODE(masstree.insert_record_normalized(context, key, &payload[0], payload_count));
+      WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+    }
+  }
+
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  CHECK_ERROR(masstree.verify_single_thread(context));
+  std::vector<char> correct(payload_count);
+  std::vector<char> retrieved(payload_count);
+  for (uint64_t k = 0; k < count * 2ULL; ++k) {
+    if (k > 0 && k % 1000U == 0) {
+      WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+      WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    }
+    KeySlice key = normalize_primitive<uint64_t>(k);
+    PayloadLength capacity = payload_count;
+    ErrorCode ret = masstree.get_record_normalized(context, key, &retrieved[0], &capacity, true);
+    if (k % 2U == 1U && !input->then_insert_) {
+      EXPECT_EQ(kErrorCodeStrKeyNotFound, ret) << k;
+      continue;
+    }
+    EXPECT_EQ(kErrorCodeOk, ret) << k;
+    EXPECT_EQ(payload_count, capacity) << k;
+    fill_payload(k, payload_count, &correct[0]);
+    EXPECT_EQ(0, std::memcmp(&correct[0], &retrieved[0], payload_count)) << k;
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return foedus::kRetOk;
+}
+
+void test_bulk_load(
+  uint32_t count,
+  PayloadLength payload_count,
+  bool then_insert,
+  bool shuffle = false) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("bulk_load_task", bulk_load_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    MasstreeMetadata meta("ggg");
+    MasstreeStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_masstree(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    BulkLoadTaskInput input = {count, payload_count, then_insert, shuffle};
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous(
+      "bulk_load_task",
+      &input,
+      sizeof(input)));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(MasstreeBulkLoadTest, OnePage) { test_bulk_load(10, 16, false); }
+TEST(MasstreeBulkLoadTest, OneLevel) { test_bulk_load(2000, 16, false); }
+// about 7 records per page, so more border pages than one intermediate page can point to.
+TEST(MasstreeBulkLoadTest, TwoLevels) { test_bulk_load(1200, 500, false); }
+TEST(MasstreeBulkLoadTest, ThenInsert) { test_bulk_load(1000, 100, true); }
+TEST(MasstreeBulkLoadTest, Unsorted) { test_bulk_load(5000, 16, false, true); }
+TEST(MasstreeBulkLoadTest, UnsortedTwoLevels) { test_bulk_load(1200, 500, false, true); }
+
+ErrorStack reject_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  MasstreeStorage masstree = context->get_engine()->get_storage_manager()->get_masstree("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  uint64_t payloads[3] = {1, 2, 3};
+  KeySlice unsorted_duplicate[3] = {2, 1, 2};
+  ErrorStack ret = masstree.bulk_load_normalized(
+    context,
+    3,
+    unsorted_duplicate,
+    payloads,
+    sizeof(uint64_t));
+  EXPECT_EQ(kErrorCodeInvalidParameter, ret.get_error_code());
+
+  KeySlice duplicate[3] = {1, 2, 2};
+  ret = masstree.bulk_load_normalized(context, 3, duplicate, payloads, sizeof(uint64_t));
+  EXPECT_EQ(kErrorCodeInvalidParameter, ret.get_error_code());
+
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  KeySlice sorted[3] = {1, 2, 3};
+  ret = masstree.bulk_load_normalized(context, 3, sorted, payloads, sizeof(uint64_t));
+  EXPECT_EQ(kErrorCodeXctAlreadyRunning, ret.get_error_code());
+  WRAP_ERROR_CODE(masstree.insert_record_normalized(context, 5, payloads, sizeof(uint64_t)));
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+
+  ret = masstree.bulk_load_normalized(context, 3, sorted, payloads, sizeof(uint64_t));
+  EXPECT_EQ(kErrorCodeStrMasstreeNotEmpty, ret.get_error_code());
+
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  CHECK_ERROR(masstree.verify_single_thread(context));
+  uint64_t data;
+  PayloadLength capacity = sizeof(data);
+  EXPECT_EQ(
+    kErrorCodeStrKeyNotFound,
+    masstree.get_record_normalized(context, 1, &data, &capacity, true));
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return foedus::kRetOk;
+}
+
+TEST(MasstreeBulkLoadTest, Reject) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("reject_task", reject_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    MasstreeMetadata meta("ggg");
+    MasstreeStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_masstree(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("reject_task"));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+}  // namespace masstree
+}  // namespace storage
+}  // namespace foedus
+
+TEST_MAIN_CAPTURE_SIGNALS(MasstreeBulkLoadTest, foedus.storage.masstree);
@@ -17,23 +17,30 @@
  */
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
 #include <cstring>
 #include <iostream>
 #include <map>
 #include <string>
+#include <thread>
 
 #include "foedus/engine.hpp"
 #include "foedus/engine_options.hpp"
 #include "foedus/epoch.hpp"
 #include "foedus/test_common.hpp"
+#include "foedus/assorted/endianness.hpp"
 #include "foedus/assorted/uniform_random.hpp"
 #include "foedus/proc/proc_manager.hpp"
 #include "foedus/storage/storage_manager.hpp"
 #include "foedus/storage/masstree/masstree_cursor.hpp"
 #include "foedus/storage/masstree/masstree_metadata.hpp"
 #include "foedus/storage/masstree/masstree_storage.hpp"
+#include "foedus/thread/impersonate_session.hpp"
 #include "foedus/thread/thread.hpp"
 #include "foedus/thread/thread_pool.hpp"
+#include "foedus/xct/retrospective_lock_list.hpp"
+#include "foedus/xct/xct.hpp"
 #include "foedus/xct/xct_manager.hpp"
 
 namespace foedus {
@@ -159,6 +166,407 @@ TEST(MasstreeCursorTest, TwoLayers) {
   // TODO(Hideaki) write testcases!
 }
 
+// next_batch(): time-series-like keys of (entity, timestamp), both 8-byte big-endian.
+// Each entity has its own second layer, so every batch must stay within one entity.
+const uint64_t kBatchEntities = 4;
+const uint64_t kBatchTimestamps = 500;
+const uint16_t kBatchSize = 64;
+bool batch_backward = false;
+
+void make_batch_key(uint64_t entity, uint64_t timestamp, char* key) {
+  assorted::write_bigendian<uint64_t>(entity, key);
+  assorted::write_bigendian<uint64_t>(timestamp, key + sizeof(uint64_t));
+}
+
+/** Scans the given range with next_batch() and verifies it against expected keys. */
+ErrorStack verify_batch_scan(
+  MasstreeCursor* cursor,
+  uint64_t from_entity,
+  uint64_t from_timestamp,
+  uint64_t to_entity,
+  uint64_t to_timestamp) {
+  char from[16];
+  char to[16];
+  make_batch_key(from_entity, from_timestamp, from);
+  make_batch_key(to_entity, to_timestamp, to);
+  if (batch_backward) {
+    WRAP_ERROR_CODE(cursor->open(to, sizeof(to), from, sizeof(from), false, false, true, true));
+  } else {
+    WRAP_ERROR_CODE(cursor->open(from, sizeof(from), to, sizeof(to), true, false, true, true));
+  }
+
+  uint64_t entity = batch_backward ? to_entity : from_entity;
+  uint64_t timestamp = batch_backward ? to_timestamp : from_timestamp;
+  uint64_t total = 0;
+  uint32_t batches = 0;
+  MasstreeCursor::BatchRecord records[kBatchSize];
+  while (cursor->is_valid_record()) {
+    const KeySlice prefix = cursor->get_cur_route_prefix_slices()[0];
+    uint16_t count;
+    WRAP_ERROR_CODE(cursor->next_batch(kBatchSize, records, &count));
+    EXPECT_GT(count, 0);
+    EXPECT_LE(count, kBatchSize);
+    ++batches;
+    for (uint16_t i = 0; i < count; ++i) {
+      EXPECT_EQ(entity, prefix) << total;
+      EXPECT_EQ(timestamp, records[i].slice_) << total;
+      EXPECT_EQ(16U, records[i].key_length_) << total;
+      EXPECT_EQ(sizeof(uint64_t), records[i].payload_length_) << total;
+      uint64_t payload;
+      std::memcpy(&payload, records[i].payload_, sizeof(payload));
+      EXPECT_EQ(entity * kBatchTimestamps + timestamp, payload) << total;
+      ++total;
+      if (batch_backward) {
+        if (timestamp == 0) {
+          --entity;
+          timestamp = kBatchTimestamps - 1U;
+        } else {
+          --timestamp;
+        }
+      } else {
+        if (timestamp == kBatchTimestamps - 1U) {
+          ++entity;
+          timestamp = 0;
+        } else {
+          ++timestamp;
+        }
+      }
+    }
+  }
+  const uint64_t expected
+    = (to_entity * kBatchTimestamps + to_timestamp)
+      - (from_entity * kBatchTimestamps + from_timestamp) + 1U;
+  EXPECT_EQ(expected, total);
+  // batches never span two entities
+  EXPECT_GE(batches, to_entity - from_entity + 1U);
+  EXPECT_GE(batches, expected / kBatchSize);
+  uint16_t count;
+  WRAP_ERROR_CODE(cursor->next_batch(kBatchSize, records, &count));
+  EXPECT_EQ(0, count);
+  return kRetOk;
+}
+
+ErrorStack next_batch_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  MasstreeStorage masstree = context->get_engine()->get_storage_manager()->get_masstree("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  Epoch commit_epoch;
+  char key[16];
+  for (uint64_t entity = 0; entity < kBatchEntities; ++entity) {
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    for (uint64_t timestamp = 0; timestamp < kBatchTimestamps; ++timestamp) {
+      make_batch_key(entity, timestamp, key);
+      uint64_t payload = entity * kBatchTimestamps + timestamp;
+      WRAP_ERROR_CODE(masstree.insert_record(context, key, sizeof(key), &payload, sizeof(payload)));
+    }
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  }
+
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  MasstreeCursor cursor(masstree, context);
+  // whole storage
+  CHECK_ERROR(verify_batch_scan(&cursor, 0, 0, kBatchEntities - 1U, kBatchTimestamps - 1U));
+  // bounded in one prefix
+  CHECK_ERROR(verify_batch_scan(&cursor, 2, 10, 2, 450));
+  // spans two prefixes
+  CHECK_ERROR(verify_batch_scan(&cursor, 1, 300, 2, 100));
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  CHECK_ERROR(masstree.verify_single_thread(context));
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return foedus::kRetOk;
+}
+
+void test_next_batch(bool backward) {
+  batch_backward = backward;
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("next_batch_task", next_batch_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    MasstreeMetadata meta("ggg");
+    MasstreeStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_masstree(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("next_batch_task"));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(MasstreeCursorTest, NextBatch) { test_next_batch(false); }
+TEST(MasstreeCursorTest, NextBatchBackward) { test_next_batch(true); }
+
+// next_batch() over normalized keys with deleted records in the middle of border pages.
+ErrorStack next_batch_deleted_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  MasstreeStorage masstree = context->get_engine()->get_storage_manager()->get_masstree("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  Epoch commit_epoch;
+  const KeySlice kKeys = 1000;
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (KeySlice key = 0; key < kKeys; ++key) {
+    WRAP_ERROR_CODE(masstree.insert_record_normalized(context, key, &key, sizeof(key)));
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (KeySlice key = 0; key < kKeys; key += 3U) {
+    WRAP_ERROR_CODE(masstree.delete_record_normalized(context, key));
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+
+  const KeySlice kFrom = 9;
+  const KeySlice kTo = 900;
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  MasstreeCursor cursor(masstree, context);
+  if (batch_backward) {
+    WRAP_ERROR_CODE(cursor.open_normalized(kTo, kFrom, false));
+  } else {
+    WRAP_ERROR_CODE(cursor.open_normalized(kFrom, kTo));
+  }
+  KeySlice expected = batch_backward ? kTo - 1U : kFrom + 1U;  // both ends are deleted keys
+  uint32_t total = 0;
+  MasstreeCursor::BatchRecord records[kBatchSize];
+  while (cursor.is_valid_record()) {
+    uint16_t count;
+    WRAP_ERROR_CODE(cursor.next_batch(kBatchSize, records, &count));
+    EXPECT_GT(count, 0);
+    for (uint16_t i = 0; i < count; ++i) {
+      EXPECT_EQ(expected, records[i].slice_) << total;
+      EXPECT_EQ(sizeof(KeySlice), records[i].key_length_) << total;
+      KeySlice payload;
+      std::memcpy(&payload, records[i].payload_, sizeof(payload));
+      EXPECT_EQ(expected, payload) << total;
+      ++total;
+      if (batch_backward) {
+        expected -= (expected % 3U == 1U) ? 2U : 1U;
+      } else {
+        expected += (expected % 3U == 2U) ? 2U : 1U;
+      }
+    }
+  }
+  EXPECT_EQ((kTo - kFrom) * 2U / 3U, total);
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return foedus::kRetOk;
+}
+
+void test_next_batch_deleted(bool backward) {
+  batch_backward = backward;
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("next_batch_deleted_task", next_batch_deleted_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    MasstreeMetadata meta("ggg");
+    MasstreeStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_masstree(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("next_batch_deleted_task"));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(MasstreeCursorTest, NextBatchDeleted) { test_next_batch_deleted(false); }
+TEST(MasstreeCursorTest, NextBatchDeletedBackward) { test_next_batch_deleted(true); }
+
+// Range set: a reader scans (or point-queries) a range, then another thread inserts a key
+// into the same page before the reader commits. The reader must abort only if the key is
+// in the range it has read.
+// With hold_lock_, the writer stops in the middle of its precommit: the new record is
+// locked but its XID is not applied yet. The reader verifies its range at that moment.
+const KeySlice kRangeLow = 100;
+const KeySlice kRangeHigh = 200;
+const KeySlice kMissingKey = 150;
+
+struct RangeSetInput {
+  bool      point_query_;
+  /** The writer holds the lock of the new record while the reader commits. */
+  bool      hold_lock_;
+  /** The reader inserts kMissingKey itself after reading the range. */
+  bool      reader_inserts_;
+  KeySlice  insert_key_;
+};
+
+// 0: started, 1: reader has read, 2: writer committed or locked, 3: reader committed
+std::atomic<int> range_phase;
+ErrorCode range_reader_result;
+
+ErrorStack range_load_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  MasstreeStorage masstree = context->get_engine()->get_storage_manager()->get_masstree("test2");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (KeySlice key = 0; key <= 300U; key += 10U) {
+    if (key != kMissingKey) {
+      WRAP_ERROR_CODE(masstree.insert_record_normalized(context, key, &key, sizeof(key)));
+    }
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  return foedus::kRetOk;
+}
+
+ErrorStack range_reader_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  const RangeSetInput* input = reinterpret_cast<const RangeSetInput*>(args.input_buffer_);
+  MasstreeStorage masstree = context->get_engine()->get_storage_manager()->get_masstree("test2");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  if (input->point_query_) {
+    KeySlice payload;
+    PayloadLength capacity = sizeof(payload);
+    ErrorCode ret = masstree.get_record_normalized(context, kMissingKey, &payload, &capacity, true);
+    EXPECT_EQ(kErrorCodeStrKeyNotFound, ret);
+  } else {
+    MasstreeCursor cursor(masstree, context);
+    WRAP_ERROR_CODE(cursor.open_normalized(kRangeLow, kRangeHigh));
+    uint32_t count = 0;
+    while (cursor.is_valid_record()) {
+      EXPECT_NE(kMissingKey, cursor.get_normalized_key());
+      ++count;
+      WRAP_ERROR_CODE(cursor.next());
+    }
+    EXPECT_EQ(9U, count);  // 100-190 except 150
+  }
+  if (input->reader_inserts_) {
+    WRAP_ERROR_CODE(masstree.insert_record_normalized(
+      context,
+      kMissingKey,
+      &kMissingKey,
+      sizeof(KeySlice)));
+  }
+
+  range_phase.store(1);
+  while (range_phase.load() != 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  Epoch commit_epoch;
+  range_reader_result = xct_manager->precommit_xct(context, &commit_epoch);
+  range_phase.store(3);
+  return foedus::kRetOk;
+}
+
+ErrorStack range_writer_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  const RangeSetInput* input = reinterpret_cast<const RangeSetInput*>(args.input_buffer_);
+  MasstreeStorage masstree = context->get_engine()->get_storage_manager()->get_masstree("test2");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  while (range_phase.load() != 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  WRAP_ERROR_CODE(masstree.insert_record_normalized(
+    context,
+    input->insert_key_,
+    &input->insert_key_,
+    sizeof(KeySlice)));
+  if (input->hold_lock_) {
+    // Lock the new record like precommit does, then wait without applying the XID.
+    xct::Xct& current_xct = context->get_current_xct();
+    ASSERT_ND(current_xct.get_write_set_size() == 1U);
+    xct::RwLockableXctId* owner_id = current_xct.get_write_set()[0].owner_id_address_;
+    xct::CurrentLockList* cll = current_xct.get_current_lock_list();
+    xct::LockListPosition pos = cll->get_or_add_entry(
+      xct::xct_id_to_universal_lock_id(cll->get_volatile_page_resolver(), owner_id),
+      owner_id,
+      xct::kWriteLock);
+    WRAP_ERROR_CODE(context->cll_try_or_acquire_single_lock(pos));
+    range_phase.store(2);
+    while (range_phase.load() != 3) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    WRAP_ERROR_CODE(xct_manager->abort_xct(context));
+    return foedus::kRetOk;
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  range_phase.store(2);
+  return foedus::kRetOk;
+}
+
+void test_range_set(
+  bool point_query,
+  KeySlice insert_key,
+  ErrorCode expected,
+  bool hold_lock = false,
+  bool reader_inserts = false) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("range_load_task", range_load_task);
+  engine.get_proc_manager()->pre_register("range_reader_task", range_reader_task);
+  engine.get_proc_manager()->pre_register("range_writer_task", range_writer_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    MasstreeMetadata meta("test2");
+    MasstreeStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_masstree(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("range_load_task"));
+
+    range_phase.store(0);
+    range_reader_result = kErrorCodeOk;
+    RangeSetInput input;
+    input.point_query_ = point_query;
+    input.hold_lock_ = hold_lock;
+    input.reader_inserts_ = reader_inserts;
+    input.insert_key_ = insert_key;
+    thread::ImpersonateSession reader;
+    thread::ImpersonateSession writer;
+    EXPECT_TRUE(engine.get_thread_pool()->impersonate(
+      "range_reader_task",
+      &input,
+      sizeof(input),
+      &reader));
+    EXPECT_TRUE(engine.get_thread_pool()->impersonate(
+      "range_writer_task",
+      &input,
+      sizeof(input),
+      &writer));
+    COERCE_ERROR(reader.get_result());
+    COERCE_ERROR(writer.get_result());
+    reader.release();
+    writer.release();
+    EXPECT_EQ(expected, range_reader_result);
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(MasstreeCursorTest, RangeSetOutOfRange) {
+  test_range_set(false, 1000, kErrorCodeOk);
+}
+TEST(MasstreeCursorTest, RangeSetInRange) {
+  test_range_set(false, 155, kErrorCodeXctRaceAbort);
+}
+TEST(MasstreeCursorTest, RangeSetPointOutOfRange) {
+  test_range_set(true, 1000, kErrorCodeOk);
+}
+TEST(MasstreeCursorTest, RangeSetPointInRange) {
+  test_range_set(true, kMissingKey, kErrorCodeXctRaceAbort);
+}
+TEST(MasstreeCursorTest, RangeSetLockedInRange) {
+  test_range_set(false, 155, kErrorCodeXctRaceAbort, true);
+}
+TEST(MasstreeCursorTest, RangeSetLockedOutOfRange) {
+  test_range_set(false, 1000, kErrorCodeOk, true);
+}
+TEST(MasstreeCursorTest, RangeSetPointLockedInRange) {
+  test_range_set(true, kMissingKey, kErrorCodeXctRaceAbort, true);
+}
+TEST(MasstreeCursorTest, RangeSetOwnInsert) {
+  test_range_set(false, 1000, kErrorCodeOk, false, true);
+}
+
 }  // namespace masstree
 }  // namespace storage
 }  // namespace foedus
@@ -0,0 +1,634 @@
+/*
+ * Copyright (c) 2014-2015, Hewlett-Packard Development Company, LP.
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * HP designates this particular file as subject to the "Classpath" exception
+ * as provided by HP in the LICENSE.txt file that accompanied this code.
+ */
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+#include "foedus/engine.hpp"
+#include "foedus/engine_options.hpp"
+#include "foedus/epoch.hpp"
+#include "foedus/test_common.hpp"
+#include "foedus/assorted/endianness.hpp"
+#include "foedus/proc/proc_manager.hpp"
+#include "foedus/storage/secondary_index.hpp"
+#include "foedus/storage/storage_manager.hpp"
+#include "foedus/storage/hash/hash_metadata.hpp"
+#include "foedus/storage/hash/hash_storage.hpp"
+#include "foedus/storage/masstree/masstree_cursor.hpp"
+#include "foedus/storage/masstree/masstree_metadata.hpp"
+#include "foedus/storage/masstree/masstree_storage.hpp"
+#include "foedus/thread/thread.hpp"
+#include "foedus/thread/thread_pool.hpp"
+#include "foedus/xct/xct.hpp"
+#include "foedus/xct/xct_manager.hpp"
+
+namespace foedus {
+namespace storage {
+namespace masstree {
+DEFINE_TEST_CASE_PACKAGE(MasstreeSecondaryIndexTest, foedus.storage.masstree);
+
+/** Base records are keyed by 8-byte big-endian id. The index is on group_. */
+struct BaseRecord {
+  uint64_t id_;
+  uint32_t group_;
+  uint32_t dummy_;
+};
+
+/** Group 0 means "not indexed" to test partial indexes. */
+ErrorStack group_extractor(const proc::ProcArguments& args) {
+  const SecondaryIndexExtractorInput* input
+    = reinterpret_cast<const SecondaryIndexExtractorInput*>(args.input_buffer_);
+  EXPECT_EQ(sizeof(uint64_t), input->key_length_);
+  EXPECT_EQ(sizeof(BaseRecord), input->payload_count_);
+  const BaseRecord* record = reinterpret_cast<const BaseRecord*>(input->payload_);
+  if (record->group_ == 0) {
+    *args.output_used_ = 0;
+    return kRetOk;
+  }
+  EXPECT_GE(args.output_buffer_size_, sizeof(uint32_t));
+  uint32_t group_be = assorted::htobe<uint32_t>(record->group_);
+  std::memcpy(args.output_buffer_, &group_be, sizeof(group_be));
+  *args.output_used_ = sizeof(group_be);
+  return kRetOk;
+}
+
+uint32_t group_of(uint64_t id) { return id % 7U; }
+
+ErrorCode insert_base(thread::Thread* context, uint64_t id, uint32_t group) {
+  Engine* engine = context->get_engine();
+  StorageManager* storage_manager = engine->get_storage_manager();
+  MasstreeStorage base = storage_manager->get_masstree("base");
+  uint64_t key = assorted::htobe<uint64_t>(id);
+  BaseRecord record = {id, group, 0};
+  CHECK_ERROR_CODE(base.insert_record(context, &key, sizeof(key), &record, sizeof(record)));
+  return storage_manager->apply_secondary_index_insert(
+    context,
+    base.get_id(),
+    &key,
+    sizeof(key),
+    &record,
+    sizeof(record));
+}
+
+/** Checks that the index exactly corresponds to the base records. Returns # of entries. */
+ErrorStack verify_index(thread::Thread* context, uint64_t* entries) {
+  Engine* engine = context->get_engine();
+  MasstreeStorage base = engine->get_storage_manager()->get_masstree("base");
+  MasstreeStorage index = engine->get_storage_manager()->get_masstree("index");
+  xct::XctManager* xct_manager = engine->get_xct_manager();
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kDirtyRead));
+  uint64_t expected = 0;
+  {
+    MasstreeCursor cursor(base, context);
+    WRAP_ERROR_CODE(cursor.open());
+    while (cursor.is_valid_record()) {
+      const BaseRecord* record = reinterpret_cast<const BaseRecord*>(cursor.get_payload());
+      if (record->group_ != 0) {
+        ++expected;
+      }
+      WRAP_ERROR_CODE(cursor.next());
+    }
+  }
+
+  *entries = 0;
+  MasstreeCursor cursor(index, context);
+  WRAP_ERROR_CODE(cursor.open());
+  uint32_t prev_group = 0;
+  while (cursor.is_valid_record()) {
+    EXPECT_EQ(sizeof(uint32_t) + sizeof(uint64_t), cursor.get_key_length());
+    EXPECT_EQ(sizeof(uint64_t), cursor.get_payload_length());
+    char key[sizeof(uint32_t) + sizeof(uint64_t)];
+    cursor.copy_combined_key(key);
+    uint32_t group_be;
+    std::memcpy(&group_be, key, sizeof(group_be));
+    uint32_t group = assorted::betoh<uint32_t>(group_be);
+    EXPECT_GE(group, prev_group);
+    prev_group = group;
+    EXPECT_EQ(0, std::memcmp(key + sizeof(group_be), cursor.get_payload(), sizeof(uint64_t)));
+
+    BaseRecord record;
+    PayloadLength capacity = sizeof(record);
+    WRAP_ERROR_CODE(base.get_record(context, cursor.get_payload(), sizeof(uint64_t), &record,
+      &capacity, true));
+    EXPECT_EQ(group, record.group_) << record.id_;
+    ++(*entries);
+    WRAP_ERROR_CODE(cursor.next());
+  }
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  EXPECT_EQ(expected, *entries);
+  return kRetOk;
+}
+
+const uint32_t kMaintainRecords = 300;
+
+ErrorStack maintain_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  Engine* engine = context->get_engine();
+  StorageManager* storage_manager = engine->get_storage_manager();
+  MasstreeStorage base = storage_manager->get_masstree("base");
+  xct::XctManager* xct_manager = engine->get_xct_manager();
+  Epoch commit_epoch;
+  for (uint64_t id = 0; id < kMaintainRecords; ++id) {
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    WRAP_ERROR_CODE(insert_base(context, id, group_of(id)));
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  }
+  uint64_t entries;
+  CHECK_ERROR(verify_index(context, &entries));
+  EXPECT_EQ(kMaintainRecords - kMaintainRecords / 7U - 1U, entries);
+
+  // move every 3rd record to another group, including from/to the non-indexed group 0.
+  for (uint64_t id = 0; id < kMaintainRecords; id += 3U) {
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    uint64_t key = assorted::htobe<uint64_t>(id);
+    BaseRecord old_record = {id, group_of(id), 0};
+    BaseRecord new_record = {id, group_of(id + 1U), 0};
+    WRAP_ERROR_CODE(base.overwrite_record(context, &key, sizeof(key), &new_record, 0,
+      sizeof(new_record)));
+    WRAP_ERROR_CODE(storage_manager->apply_secondary_index_update(
+      context,
+      base.get_id(),
+      &key,
+      sizeof(key),
+      &old_record,
+      sizeof(old_record),
+      &new_record,
+      sizeof(new_record)));
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  }
+  CHECK_ERROR(verify_index(context, &entries));
+
+  // an update that doesn't change the secondary key doesn't touch the index.
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  uint64_t key = assorted::htobe<uint64_t>(1U);
+  BaseRecord old_record = {1U, group_of(1U), 0};
+  BaseRecord new_record = {1U, group_of(1U), 123};
+  WRAP_ERROR_CODE(storage_manager->apply_secondary_index_update(
+    context,
+    base.get_id(),
+    &key,
+    sizeof(key),
+    &old_record,
+    sizeof(old_record),
+    &new_record,
+    sizeof(new_record)));
+  EXPECT_EQ(0U, context->get_current_xct().get_write_set_size());
+  WRAP_ERROR_CODE(xct_manager->abort_xct(context));
+
+  // delete every 5th record.
+  for (uint64_t id = 1; id < kMaintainRecords; id += 5U) {
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    uint64_t key = assorted::htobe<uint64_t>(id);
+    BaseRecord record;
+    PayloadLength capacity = sizeof(record);
+    WRAP_ERROR_CODE(base.get_record(context, &key, sizeof(key), &record, &capacity, true));
+    WRAP_ERROR_CODE(base.delete_record(context, &key, sizeof(key)));
+    WRAP_ERROR_CODE(storage_manager->apply_secondary_index_delete(
+      context,
+      base.get_id(),
+      &key,
+      sizeof(key),
+      &record,
+      sizeof(record)));
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  }
+  CHECK_ERROR(verify_index(context, &entries));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+/** Creates "base" and "index" masstrees. */
+void create_storages(Engine* engine) {
+  MasstreeMetadata base_meta("base");
+  MasstreeStorage base;
+  MasstreeMetadata index_meta("index");
+  MasstreeStorage index;
+  Epoch epoch;
+  COERCE_ERROR(engine->get_storage_manager()->create_masstree(&base_meta, &base, &epoch));
+  COERCE_ERROR(engine->get_storage_manager()->create_masstree(&index_meta, &index, &epoch));
+  EXPECT_TRUE(base.exists());
+  EXPECT_TRUE(index.exists());
+}
+
+TEST(MasstreeSecondaryIndexTest, Maintain) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("group_extractor", group_extractor);
+  engine.get_proc_manager()->pre_register("maintain_task", maintain_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create_storages(&engine);
+    StorageManager* storage_manager = engine.get_storage_manager();
+    COERCE_ERROR(storage_manager->register_secondary_index(
+      storage_manager->get_masstree("base").get_id(),
+      storage_manager->get_masstree("index").get_id(),
+      "group_extractor"));
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("maintain_task"));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+const uint32_t kBuildInitialRecords = 4000;
+const uint32_t kBuildConcurrentRecords = 500;
+const uint16_t kBuildPartitions = 2;
+
+ErrorStack load_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  Epoch commit_epoch;
+  // no index is registered yet, so this doesn't touch the index.
+  for (uint64_t id = 0; id < kBuildInitialRecords; ++id) {
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    WRAP_ERROR_CODE(insert_base(context, id * 2U, group_of(id)));
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  }
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack build_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  StorageManager* storage_manager = context->get_engine()->get_storage_manager();
+  uint16_t partition = *reinterpret_cast<const uint16_t*>(args.input_buffer_);
+  return storage_manager->build_secondary_index(
+    context,
+    storage_manager->get_masstree("index").get_id(),
+    partition,
+    kBuildPartitions);
+}
+
+/** Runs concurrently with the build, inserting odd ids with the index maintained. */
+ErrorStack concurrent_insert_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  Epoch commit_epoch;
+  for (uint64_t id = 0; id < kBuildConcurrentRecords; ++id) {
+    while (true) {
+      WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+      ErrorCode ret = insert_base(context, id * 2U + 1U, group_of(id));
+      if (ret == kErrorCodeOk) {
+        ret = xct_manager->precommit_xct(context, &commit_epoch);
+      } else {
+        WRAP_ERROR_CODE(xct_manager->abort_xct(context));
+      }
+      if (ret == kErrorCodeOk) {
+        break;
+      } else if (ret != kErrorCodeXctRaceAbort) {
+        return ERROR_STACK(ret);
+      }
+    }
+  }
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack finish_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  StorageManager* storage_manager = context->get_engine()->get_storage_manager();
+  return storage_manager->finish_secondary_index_build(
+    context,
+    storage_manager->get_masstree("index").get_id());
+}
+
+ErrorStack verify_task(const proc::ProcArguments& args) {
+  uint64_t entries;
+  CHECK_ERROR(verify_index(args.context_, &entries));
+  uint64_t expected_initial = kBuildInitialRecords - (kBuildInitialRecords + 6U) / 7U;
+  uint64_t expected_concurrent = kBuildConcurrentRecords - (kBuildConcurrentRecords + 6U) / 7U;
+  EXPECT_EQ(expected_initial + expected_concurrent, entries);
+  return kRetOk;
+}
+
+TEST(MasstreeSecondaryIndexTest, Build) {
+  EngineOptions options = get_tiny_options();
+  options.thread_.thread_count_per_group_ = kBuildPartitions + 1U;
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("group_extractor", group_extractor);
+  engine.get_proc_manager()->pre_register("load_task", load_task);
+  engine.get_proc_manager()->pre_register("build_task", build_task);
+  engine.get_proc_manager()->pre_register("concurrent_insert_task", concurrent_insert_task);
+  engine.get_proc_manager()->pre_register("finish_task", finish_task);
+  engine.get_proc_manager()->pre_register("verify_task", verify_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create_storages(&engine);
+    thread::ThreadPool* pool = engine.get_thread_pool();
+    COERCE_ERROR(pool->impersonate_synchronous("load_task"));
+
+    StorageManager* storage_manager = engine.get_storage_manager();
+    COERCE_ERROR(storage_manager->register_secondary_index(
+      storage_manager->get_masstree("base").get_id(),
+      storage_manager->get_masstree("index").get_id(),
+      "group_extractor"));
+    thread::ImpersonateSession writer;
+    thread::ImpersonateSession builders[kBuildPartitions];
+    EXPECT_TRUE(pool->impersonate("concurrent_insert_task", nullptr, 0, &writer));
+    for (uint16_t i = 0; i < kBuildPartitions; ++i) {
+      EXPECT_TRUE(pool->impersonate("build_task", &i, sizeof(i), builders + i));
+    }
+    COERCE_ERROR(writer.get_result());
+    writer.release();
+    for (uint16_t i = 0; i < kBuildPartitions; ++i) {
+      COERCE_ERROR(builders[i].get_result());
+      builders[i].release();
+    }
+    COERCE_ERROR(pool->impersonate_synchronous("finish_task"));
+    COERCE_ERROR(pool->impersonate_synchronous("verify_task"));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+const uint32_t kCatchUpRecords = 1000;
+
+/**
+ * Emulates transactions that began before the registration and committed after the build
+ * scanned their records. They modify the base without maintaining the index.
+ */
+ErrorStack straggler_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  Engine* engine = context->get_engine();
+  MasstreeStorage base = engine->get_storage_manager()->get_masstree("base");
+  xct::XctManager* xct_manager = engine->get_xct_manager();
+  Epoch commit_epoch;
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  for (uint64_t id = 0; id < kCatchUpRecords; id += 10U) {
+    // insert odd ids, delete some even ids, move other even ids to another group.
+    uint64_t new_key = assorted::htobe<uint64_t>(id * 2U + 1U);
+    BaseRecord new_record = {id * 2U + 1U, group_of(id), 0};
+    WRAP_ERROR_CODE(base.insert_record(context, &new_key, sizeof(new_key), &new_record,
+      sizeof(new_record)));
+    uint64_t deleted_key = assorted::htobe<uint64_t>(id * 2U);
+    WRAP_ERROR_CODE(base.delete_record(context, &deleted_key, sizeof(deleted_key)));
+    uint64_t moved_key = assorted::htobe<uint64_t>(id * 2U + 2U);
+    BaseRecord moved_record = {id * 2U + 2U, group_of(id + 2U), 0};
+    WRAP_ERROR_CODE(base.overwrite_record(context, &moved_key, sizeof(moved_key), &moved_record,
+      0, sizeof(moved_record)));
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+ErrorStack catch_up_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  Engine* engine = context->get_engine();
+  StorageManager* storage_manager = engine->get_storage_manager();
+  xct::XctManager* xct_manager = engine->get_xct_manager();
+  Epoch commit_epoch;
+  for (uint64_t id = 0; id < kCatchUpRecords; ++id) {
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    WRAP_ERROR_CODE(insert_base(context, id * 2U, group_of(id)));
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  }
+  StorageId index_id = storage_manager->get_masstree("index").get_id();
+  CHECK_ERROR(storage_manager->build_secondary_index(context, index_id, 0, 1));
+  CHECK_ERROR(straggler_task(args));
+
+  // while building, a duplicate index record is tolerated.
+  uint64_t key = assorted::htobe<uint64_t>(4U);
+  BaseRecord record = {4U, group_of(2U), 0};
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  WRAP_ERROR_CODE(storage_manager->apply_secondary_index_insert(
+    context,
+    storage_manager->get_masstree("base").get_id(),
+    &key,
+    sizeof(key),
+    &record,
+    sizeof(record)));
+  WRAP_ERROR_CODE(xct_manager->abort_xct(context));
+
+  CHECK_ERROR(storage_manager->finish_secondary_index_build(context, index_id));
+  uint64_t entries;
+  CHECK_ERROR(verify_index(context, &entries));
+
+  // once ready, it is an error.
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  EXPECT_EQ(kErrorCodeStrKeyAlreadyExists, storage_manager->apply_secondary_index_insert(
+    context,
+    storage_manager->get_masstree("base").get_id(),
+    &key,
+    sizeof(key),
+    &record,
+    sizeof(record)));
+  WRAP_ERROR_CODE(xct_manager->abort_xct(context));
+  return kRetOk;
+}
+
+TEST(MasstreeSecondaryIndexTest, CatchUp) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("group_extractor", group_extractor);
+  engine.get_proc_manager()->pre_register("catch_up_task", catch_up_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create_storages(&engine);
+    StorageManager* storage_manager = engine.get_storage_manager();
+    COERCE_ERROR(storage_manager->register_secondary_index(
+      storage_manager->get_masstree("base").get_id(),
+      storage_manager->get_masstree("index").get_id(),
+      "group_extractor"));
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("catch_up_task"));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+ErrorStack unmaintained_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  Engine* engine = context->get_engine();
+  StorageManager* storage_manager = engine->get_storage_manager();
+  MasstreeStorage base = storage_manager->get_masstree("base");
+  xct::XctManager* xct_manager = engine->get_xct_manager();
+  CHECK_ERROR(storage_manager->finish_secondary_index_build(
+    context,
+    storage_manager->get_masstree("index").get_id()));
+
+  // a base write without maintenance is caught at precommit, which aborts the transaction.
+  Epoch commit_epoch;
+  uint64_t key = assorted::htobe<uint64_t>(1U);
+  BaseRecord record = {1U, group_of(1U), 0};
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  WRAP_ERROR_CODE(base.insert_record(context, &key, sizeof(key), &record, sizeof(record)));
+  EXPECT_EQ(
+    kErrorCodeXctSecondaryIndexNotMaintained,
+    xct_manager->precommit_xct(context, &commit_epoch));
+  EXPECT_FALSE(context->is_running_xct());
+
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  WRAP_ERROR_CODE(insert_base(context, 1U, group_of(1U)));
+  WRAP_ERROR_CODE(insert_base(context, 2U, group_of(2U)));
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+
+  // two writes to the base, but only one of them maintained.
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  BaseRecord new_record = {1U, group_of(2U), 0};
+  WRAP_ERROR_CODE(base.overwrite_record(context, &key, sizeof(key), &new_record, 0,
+    sizeof(new_record)));
+  WRAP_ERROR_CODE(storage_manager->apply_secondary_index_update(
+    context,
+    base.get_id(),
+    &key,
+    sizeof(key),
+    &record,
+    sizeof(record),
+    &new_record,
+    sizeof(new_record)));
+  uint64_t other_key = assorted::htobe<uint64_t>(2U);
+  WRAP_ERROR_CODE(base.delete_record(context, &other_key, sizeof(other_key)));
+  EXPECT_EQ(
+    kErrorCodeXctSecondaryIndexNotMaintained,
+    xct_manager->precommit_xct(context, &commit_epoch));
+
+  uint64_t entries;
+  CHECK_ERROR(verify_index(context, &entries));
+  EXPECT_EQ(2U, entries);
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return kRetOk;
+}
+
+TEST(MasstreeSecondaryIndexTest, Unmaintained) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("group_extractor", group_extractor);
+  engine.get_proc_manager()->pre_register("unmaintained_task", unmaintained_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create_storages(&engine);
+    StorageManager* storage_manager = engine.get_storage_manager();
+    COERCE_ERROR(storage_manager->register_secondary_index(
+      storage_manager->get_masstree("base").get_id(),
+      storage_manager->get_masstree("index").get_id(),
+      "group_extractor"));
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("unmaintained_task"));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(MasstreeSecondaryIndexTest, ReuseSlots) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("group_extractor", group_extractor);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create_storages(&engine);
+    StorageManager* storage_manager = engine.get_storage_manager();
+    StorageId base_id = storage_manager->get_masstree("base").get_id();
+    StorageId indexes[SecondaryIndex::kMaxSecondaryIndexes + 1U];
+    for (uint32_t i = 0; i <= SecondaryIndex::kMaxSecondaryIndexes; ++i) {
+      std::string name = "index_" + std::to_string(i);
+      MasstreeMetadata meta(name.c_str());
+      MasstreeStorage storage;
+      Epoch epoch;
+      COERCE_ERROR(storage_manager->create_masstree(&meta, &storage, &epoch));
+      indexes[i] = storage.get_id();
+    }
+    for (uint32_t i = 0; i < SecondaryIndex::kMaxSecondaryIndexes; ++i) {
+      COERCE_ERROR(storage_manager->register_secondary_index(
+        base_id,
+        indexes[i],
+        "group_extractor"));
+    }
+    const uint32_t kLast = SecondaryIndex::kMaxSecondaryIndexes;
+    EXPECT_EQ(
+      kErrorCodeStrTooManySecondaryIndexes,
+      storage_manager->register_secondary_index(
+        base_id,
+        indexes[kLast],
+        "group_extractor").get_error_code());
+
+    // unregistered entries are reused, many times.
+    for (uint32_t i = 0; i < SecondaryIndex::kMaxSecondaryIndexes * 2U; ++i) {
+      storage_manager->unregister_secondary_indexes(indexes[3]);
+      COERCE_ERROR(storage_manager->register_secondary_index(
+        base_id,
+        indexes[kLast],
+        "group_extractor"));
+      storage_manager->unregister_secondary_indexes(indexes[kLast]);
+      COERCE_ERROR(storage_manager->register_secondary_index(
+        base_id,
+        indexes[3],
+        "group_extractor"));
+    }
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+TEST(MasstreeSecondaryIndexTest, Reject) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("ext", group_extractor);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    create_storages(&engine);
+    StorageManager* storage_manager = engine.get_storage_manager();
+    hash::HashMetadata hash_meta("hash", 8);
+    hash::HashStorage hash;
+    Epoch epoch;
+    COERCE_ERROR(storage_manager->create_hash(&hash_meta, &hash, &epoch));
+    StorageId base_id = storage_manager->get_masstree("base").get_id();
+    StorageId index_id = storage_manager->get_masstree("index").get_id();
+
+    // the index must be a masstree
+    EXPECT_EQ(
+      kErrorCodeStrWrongMetadataType,
+      storage_manager->register_secondary_index(base_id, hash.get_id(), "ext").get_error_code());
+    EXPECT_EQ(
+      kErrorCodeInvalidParameter,
+      storage_manager->register_secondary_index(base_id, base_id, "ext").get_error_code());
+    // the extractor must exist
+    EXPECT_EQ(
+      kErrorCodeProcNotFound,
+      storage_manager->register_secondary_index(base_id, index_id, "no_ext").get_error_code());
+    // the base must be a masstree, too
+    EXPECT_EQ(
+      kErrorCodeStrWrongMetadataType,
+      storage_manager->register_secondary_index(hash.get_id(), index_id, "ext").get_error_code());
+
+    MasstreeMetadata other_meta("other");
+    MasstreeStorage other;
+    COERCE_ERROR(storage_manager->create_masstree(&other_meta, &other, &epoch));
+    COERCE_ERROR(storage_manager->register_secondary_index(other.get_id(), index_id, "ext"));
+    EXPECT_EQ(
+      kErrorCodeStrAlreadyExists,
+      storage_manager->register_secondary_index(base_id, index_id, "ext").get_error_code());
+
+    // dropping the base unregisters the index, so it can be registered again.
+    COERCE_ERROR(storage_manager->drop_storage(other.get_id(), &epoch));
+    COERCE_ERROR(storage_manager->register_secondary_index(base_id, index_id, "ext"));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+}  // namespace masstree
+}  // namespace storage
+}  // namespace foedus
+
+TEST_MAIN_CAPTURE_SIGNALS(MasstreeSecondaryIndexTest, foedus.storage.masstree);
@@ -294,6 +294,150 @@ TEST(MasstreeSplitTest, SplitIntermediateSequentialWithHint) {
   test_split_intermediate_sequential(true);
 }
 
+/**
+ * Many clients, each appending its own ascending key range, interleave in the same pages.
+ * Splitting such a page in half leaves the left half-page empty forever.
+ */
+ErrorStack split_border_interleaved_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  Engine* engine = context->get_engine();
+  MasstreeStorage masstree = engine->get_storage_manager()->get_masstree("ggg");
+  xct::XctManager* xct_manager = engine->get_xct_manager();
+  const uint32_t kClients = 16;
+  const uint32_t kAppends = 128;
+  const PayloadLength kPayload = 16;
+  char data[kPayload];
+  std::memset(data, 0, kPayload);
+  Epoch commit_epoch;
+  for (uint32_t i = 0; i < kAppends; ++i) {
+    for (uint32_t c = 0; c < kClients; ++c) {
+      KeySlice key = normalize_primitive<uint64_t>((static_cast<uint64_t>(c) << 32) + i);
+      WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+      WRAP_ERROR_CODE(masstree.insert_record_normalized(context, key, data, kPayload));
+      WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+    }
+  }
+
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  CHECK_ERROR(masstree.verify_single_thread(context));
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+
+  const uint32_t kCapacity = 1024;
+  KeySlice boundaries[kCapacity];
+  uint32_t found = 0;
+  MasstreeStorage::PeekBoundariesArguments peek_args = {
+    nullptr, 0, kCapacity, kInfimumSlice, kSupremumSlice, boundaries, &found };
+  WRAP_ERROR_CODE(masstree.peek_volatile_page_boundaries(engine, peek_args));
+  const uint32_t per_page
+    = MasstreeStorage::estimate_records_per_page(0, sizeof(KeySlice), kPayload);
+  const uint32_t ideal_pages = (kClients * kAppends + per_page - 1U) / per_page;
+  std::cout << "Interleaved appends: " << (found + 1U) << " border pages. ideal="
+    << ideal_pages << std::endl;
+  // Each client's range is eventually in its own pages, which then receive only appends.
+  // Splitting pages in half here used to take about 1.5x of the ideal.
+  EXPECT_LE(found + 1U, ideal_pages * 9U / 8U);
+
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return foedus::kRetOk;
+}
+
+TEST(MasstreeSplitTest, SplitBorderInterleaved) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("the_task", split_border_interleaved_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    MasstreeMetadata meta("ggg");
+    MasstreeStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_masstree(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("the_task"));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
+ErrorStack adopt_foster_twins_task(const proc::ProcArguments& args) {
+  thread::Thread* context = args.context_;
+  MasstreeStorage masstree = context->get_engine()->get_storage_manager()->get_masstree("ggg");
+  xct::XctManager* xct_manager = context->get_engine()->get_xct_manager();
+  Epoch commit_epoch;
+  // Same as split_intermediate_sequential_task, but with batched inserts.
+  const uint32_t kKeys = 400;
+  const uint16_t kBatch = 40;
+  KeySlice keys[kBatch];
+  const void* payloads[kBatch];
+  ErrorCode results[kBatch];
+  char data[kBatch][1000];
+  for (uint32_t from = 0; from < kKeys; from += kBatch) {
+    for (uint16_t i = 0; i < kBatch; ++i) {
+      keys[i] = normalize_primitive<uint64_t>(from + i);
+      std::memset(data[i], 0, 1000);
+      std::memcpy(data[i] + 123, keys + i, sizeof(KeySlice));
+      payloads[i] = data[i];
+    }
+    WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+    WRAP_ERROR_CODE(masstree.insert_record_normalized_batch(
+      context,
+      kBatch,
+      keys,
+      payloads,
+      1000,
+      results));
+    WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+    for (uint16_t i = 0; i < kBatch; ++i) {
+      EXPECT_EQ(kErrorCodeOk, results[i]) << (from + i);
+    }
+  }
+
+  // Each call adopts one level of foster twins. Eventually there is nothing to adopt.
+  uint32_t adopted_count = 0;
+  for (uint32_t rep = 0; rep < 10U; ++rep) {
+    CHECK_ERROR(masstree.adopt_foster_twins(context, &adopted_count));
+    if (adopted_count == 0) {
+      break;
+    }
+  }
+  EXPECT_EQ(0, adopted_count);
+
+  WRAP_ERROR_CODE(xct_manager->begin_xct(context, xct::kSerializable));
+  CHECK_ERROR(masstree.verify_single_thread(context));
+  for (uint32_t rep = 0; rep < kKeys; ++rep) {
+    KeySlice key = normalize_primitive<uint64_t>(rep);
+    char retrieved[1000];
+    uint16_t capacity = 1000;
+    WRAP_ERROR_CODE(masstree.get_record_normalized(context, key, retrieved, &capacity, true));
+    EXPECT_EQ(1000, capacity);
+    char correct_data[1000];
+    std::memset(correct_data, 0, 1000);
+    std::memcpy(correct_data + 123, &key, sizeof(key));
+    EXPECT_EQ(std::string(correct_data, 1000), std::string(retrieved, capacity)) << rep;
+  }
+  WRAP_ERROR_CODE(xct_manager->precommit_xct(context, &commit_epoch));
+  WRAP_ERROR_CODE(xct_manager->wait_for_commit(commit_epoch));
+  return foedus::kRetOk;
+}
+
+TEST(MasstreeSplitTest, AdoptFosterTwins) {
+  EngineOptions options = get_tiny_options();
+  Engine engine(options);
+  engine.get_proc_manager()->pre_register("the_task", adopt_foster_twins_task);
+  COERCE_ERROR(engine.initialize());
+  {
+    UninitializeGuard guard(&engine);
+    MasstreeMetadata meta("ggg");
+    MasstreeStorage storage;
+    Epoch epoch;
+    COERCE_ERROR(engine.get_storage_manager()->create_masstree(&meta, &storage, &epoch));
+    EXPECT_TRUE(storage.exists());
+    COERCE_ERROR(engine.get_thread_pool()->impersonate_synchronous("the_task"));
+    COERCE_ERROR(engine.uninitialize());
+  }
+  cleanup_test(options);
+}
+
 }  // namespace masstree
 }  // namespace storage
 }  // namespace foedus